@@ -0,0 +1,719 @@
+// Host benchmark and regression harness for the DSP modules
+//
+// Runs subsonic, pre-gain, equalizer and limiter, and the full chain in every
+// execution mode (staged and fused again with true-peak limiting), the band
+// split, convolver, crossover, multiband processor and delay line, on
+// synthetic signals. Reports throughput per unit and
+// compares every output with the golden file for this build variant, then
+// checks the band split, delay line and convolver against their ideal
+// responses.
+//
+// Usage: host_bench [--iterations N] [--golden FILE] [--update-golden] [--strict]
+
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "band_split.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "dsp_chain.h"
+#include "coeff_bank.h"
+#include "audio_config.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+// Globals the chain operates on (defined in esp-dsp.cpp on the target)
+subsonic_t subsonic;
+pregain_t pregain;
+equalizer_t equalizer;
+limiter_t limiter;
+convolver_t convolver;
+crossover_t crossover;
+multiband_t multiband;
+delay_line_t delay_line;
+
+// One second of stereo audio per signal
+#define SIGNAL_FRAMES       SAMPLE_RATE
+#define SIGNAL_SAMPLES      (SIGNAL_FRAMES * I2S_NUM_CHANNELS)
+
+#define FULL_SCALE          8388607         // 24-bit peak
+
+// Outputs whose hash differs but whose level is this close count as drift
+#define GOLDEN_RMS_TOL_DB   0.01
+#define GOLDEN_PEAK_TOL     64
+
+#ifdef HOST_BENCH_EQ_SIMD_KERNEL
+#define VARIANT_NAME        "simd"
+#else
+#define VARIANT_NAME        "scalar"
+#endif
+
+#define DEFAULT_ITERATIONS  20
+#define MAX_RESULTS         64
+
+// Accuracy limits: deviation of the summed bands from the input level at any
+// frequency, error of a fractional delay of a 1 kHz tone relative to the
+// tone, and error of the convolver with a unit impulse (24-bit LSBs)
+#define SPLIT_FLAT_TOL_DB   0.05
+#define DELAY_ERROR_TOL_DB  -80.0
+#define CONV_IDENTITY_TOL   4
+
+// Band split unit: three bands, summed back
+#define SPLIT_BANDS         3
+static const float s_split_freq[SPLIT_BANDS - 1] = { 200.0f, 2000.0f };
+
+// Convolver unit response: taps per channel
+#define CONV_TAPS           1024
+
+// Way outputs of the crossover, all frames of a signal
+#define WAYS_SAMPLES        (SIGNAL_FRAMES * CROSSOVER_OUT_CHANNELS)
+
+typedef enum {
+    SIGNAL_SWEEP = 0,   // Log sine sweep 20 Hz - 20 kHz, -6 dBFS
+    SIGNAL_PINK,        // Pink noise, about -12 dBFS RMS
+    SIGNAL_SQUARE,      // 1 kHz full-scale square
+    SIGNAL_COUNT
+} signal_id_t;
+
+static const char *s_signal_names[SIGNAL_COUNT] = { "sweep", "pink", "square" };
+
+typedef enum {
+    UNIT_SUBSONIC = 0,
+    UNIT_PREGAIN,
+    UNIT_EQUALIZER,
+    UNIT_LIMITER,
+    UNIT_CHAIN_STAGED,
+    UNIT_CHAIN_FUSED,
+    UNIT_CHAIN_FLOAT,
+    UNIT_LIMITER_TP,        // Limiter with true-peak detection
+    UNIT_STAGED_TP,         // Staged chain, true-peak limiter
+    UNIT_FUSED_TP,          // Fused chain, true-peak limiter
+    UNIT_BAND_SPLIT,        // Band split (equalizer's kernel), bands summed
+    UNIT_CONVOLVER,         // Convolver with a decaying stereo response
+    UNIT_CROSSOVER,         // 3-way crossover, all way outputs
+    UNIT_MULTIBAND,         // Multiband dynamics, default bands
+    UNIT_DELAY_LINE,        // Delay line, integer and fractional delay
+    UNIT_COUNT
+} unit_id_t;
+
+static const char *s_unit_names[UNIT_COUNT] = {
+    "subsonic", "pregain", "equalizer", "limiter", "chain_staged", "chain_fused",
+    "chain_float", "limiter_tp", "staged_tp", "fused_tp", "band_split", "convolver",
+    "crossover", "multiband", "delay_line",
+};
+
+// Outputs of one unit on one signal
+typedef struct {
+    unit_id_t unit;
+    signal_id_t signal;
+    uint64_t hash;          // FNV-1a over the output samples
+    double rms_db;          // Output RMS in dBFS
+    int32_t peak;           // Largest absolute sample (24-bit scale)
+    double best_ns;         // Fastest iteration, processing time only
+} bench_result_t;
+
+// Golden entry as read from file
+typedef struct {
+    char unit[32];
+    char signal[32];
+    uint64_t hash;
+    double rms_db;
+    int32_t peak;
+} golden_entry_t;
+
+static int32_t s_signals[SIGNAL_COUNT][SIGNAL_SAMPLES];
+static int32_t s_output[SIGNAL_SAMPLES];
+static int32_t s_ways[WAYS_SAMPLES];
+
+static band_split_coeffs_t s_split;
+static band_split_state_t s_split_state;
+static float s_conv_taps[2 * CONV_TAPS];
+
+static uint32_t lcg_next(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed;
+}
+
+// White noise in [-1, 1)
+static float lcg_white(uint32_t *seed)
+{
+    return (int32_t)lcg_next(seed) / 2147483648.0f;
+}
+
+static int32_t to_sample(double v)
+{
+    if (v > 1.0) v = 1.0;
+    if (v < -1.0) v = -1.0;
+    return (int32_t)lrint(v * FULL_SCALE);
+}
+
+static void generate_signals(void)
+{
+    // Exponential sweep; right channel 0.9x left so the channels differ
+    const double f0 = 20.0, f1 = 20000.0;
+    const double T = (double)SIGNAL_FRAMES / SAMPLE_RATE;
+    const double k = log(f1 / f0);
+    for (int n = 0; n < SIGNAL_FRAMES; n++) {
+        double t = (double)n / SAMPLE_RATE;
+        double phase = 2.0 * M_PI * f0 * T / k * (exp(t / T * k) - 1.0);
+        double v = 0.5 * sin(phase);
+        s_signals[SIGNAL_SWEEP][2 * n] = to_sample(v);
+        s_signals[SIGNAL_SWEEP][2 * n + 1] = to_sample(0.9 * v);
+    }
+
+    // Pink noise (Paul Kellet's filter), independent per channel
+    for (int ch = 0; ch < I2S_NUM_CHANNELS; ch++) {
+        uint32_t seed = 0x12345678u + ch;
+        float b0 = 0, b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0, b6 = 0;
+        for (int n = 0; n < SIGNAL_FRAMES; n++) {
+            float white = lcg_white(&seed);
+            b0 = 0.99886f * b0 + white * 0.0555179f;
+            b1 = 0.99332f * b1 + white * 0.0750759f;
+            b2 = 0.96900f * b2 + white * 0.1538520f;
+            b3 = 0.86650f * b3 + white * 0.3104856f;
+            b4 = 0.55000f * b4 + white * 0.5329522f;
+            b5 = -0.7616f * b5 - white * 0.0168980f;
+            float pink = b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f;
+            b6 = white * 0.115926f;
+            s_signals[SIGNAL_PINK][2 * n + ch] = to_sample(pink * 0.1);
+        }
+    }
+
+    // Full-scale square; right channel inverted
+    const int half_period = SAMPLE_RATE / 2000;
+    for (int n = 0; n < SIGNAL_FRAMES; n++) {
+        int32_t v = ((n / half_period) & 1) ? -FULL_SCALE : FULL_SCALE;
+        s_signals[SIGNAL_SQUARE][2 * n] = v;
+        s_signals[SIGNAL_SQUARE][2 * n + 1] = -v;
+    }
+}
+
+// Split a block into the bands and sum them back, with the kernel the
+// crossover and multiband processor use in this build
+static void split_and_sum(int32_t *block, int n)
+{
+#if EQUALIZER_BLOCK_KERNEL
+    static float input[DMA_BUFFER_SIZE], bands[SPLIT_BANDS][DMA_BUFFER_SIZE];
+    float *const outputs[SPLIT_BANDS] = { bands[0], bands[1], bands[2] };
+    for (int i = 0; i < n; i++) {
+        input[i] = (float)block[i];
+    }
+    band_split_process_f32(&s_split, &s_split_state, input, outputs, n);
+    for (int i = 0; i < n; i++) {
+        block[i] = (int32_t)lrintf(bands[0][i] + bands[1][i] + bands[2][i]);
+    }
+#else
+    static int32_t input[DMA_BUFFER_SIZE], bands[SPLIT_BANDS][DMA_BUFFER_SIZE];
+    int32_t *const outputs[SPLIT_BANDS] = { bands[0], bands[1], bands[2] };
+    memcpy(input, block, n * sizeof(int32_t));
+    band_split_process(&s_split, &s_split_state, input, outputs, n);
+    for (int i = 0; i < n; i++) {
+        block[i] = bands[0][i] + bands[1][i] + bands[2][i];
+    }
+#endif
+}
+
+// Decaying noise per channel, with a direct sound that differs between the
+// channels (full scale = 1.0, left then right)
+static void generate_response(void)
+{
+    for (int ch = 0; ch < 2; ch++) {
+        uint32_t seed = 0x5eed0000u + ch;
+        for (int n = 0; n < CONV_TAPS; n++) {
+            s_conv_taps[ch * CONV_TAPS + n] = 0.1f * lcg_white(&seed) * expf(-n / 160.0f);
+        }
+        s_conv_taps[ch * CONV_TAPS + 3 * ch] += 0.5f;
+    }
+}
+
+static esp_err_t load_response(const float *taps, uint32_t num_taps, int channels)
+{
+    convolver_ir_header_t header = {};
+    header.magic = CONVOLVER_IR_MAGIC;
+    header.taps = num_taps;
+    header.channels = (uint16_t)channels;
+    esp_err_t err = convolver_ir_begin(&convolver, &header);
+    if (err == ESP_OK) {
+        err = convolver_ir_write(&convolver, 0, taps, num_taps * channels * sizeof(float));
+    }
+    if (err == ESP_OK) {
+        err = convolver_ir_commit(&convolver, false);
+    }
+    return err;
+}
+
+// Fresh modules with the settings every run of a unit uses
+static void configure_modules(unit_id_t unit, bool true_peak)
+{
+    subsonic_init(&subsonic, SAMPLE_RATE);
+    subsonic_set_enabled(&subsonic, true);
+
+    pregain_init(&pregain);
+    pregain_set_gain(&pregain, 6.0f);
+    pregain_set_enabled(&pregain, true);
+
+    equalizer_init(&equalizer, SAMPLE_RATE);
+    const float gains[EQ_DEFAULT_BANDS] = { 6.0f, -3.0f, 2.0f, 4.0f, -6.0f };
+    for (int i = 0; i < EQ_DEFAULT_BANDS; i++) {
+        equalizer_set_band_gain(&equalizer, i, gains[i], SAMPLE_RATE);
+    }
+    equalizer_set_enabled(&equalizer, true);
+
+    limiter_init(&limiter, SAMPLE_RATE);
+    limiter_set_threshold(&limiter, -3.0f);
+    limiter_set_true_peak(&limiter, true_peak);
+    limiter_set_enabled(&limiter, true);
+
+    // The optional stages allocate their state in init (once on the target);
+    // they start bypassed, so the chains run as without them
+    heap_caps_free(convolver.fdl);
+    heap_caps_free(convolver.history);
+    convolver_init(&convolver, SAMPLE_RATE);
+    heap_caps_free(crossover.state);
+    crossover_init(&crossover, SAMPLE_RATE);
+    heap_caps_free(multiband.state);
+    multiband_init(&multiband, SAMPLE_RATE);
+    heap_caps_free(delay_line.line);
+    delay_line_init(&delay_line, SAMPLE_RATE);
+
+    switch (unit) {
+        case UNIT_BAND_SPLIT:
+            band_split_design(&s_split, SPLIT_BANDS, s_split_freq, SAMPLE_RATE);
+            band_split_reset(&s_split_state);
+            break;
+        case UNIT_CONVOLVER:
+            load_response(s_conv_taps, CONV_TAPS, 2);
+            convolver_set_gain(&convolver, -3.0f);
+            break;
+        case UNIT_CROSSOVER:
+            crossover_set_gain(&crossover, 0, -2.0f);
+            crossover_set_delay(&crossover, 1, 0.25f);
+            crossover_set_gain(&crossover, 2, 1.5f);
+            crossover_set_invert(&crossover, 2, true);
+            break;
+        case UNIT_MULTIBAND:
+            multiband_set_enabled(&multiband, true);
+            break;
+        case UNIT_DELAY_LINE:
+            delay_line_set_delay(&delay_line, 0, 1.25f);
+            delay_line_set_delay(&delay_line, 1, 0.5078f);
+            delay_line_set_enabled(&delay_line, true);
+            break;
+        default:
+            break;
+    }
+}
+
+static void process_block(unit_id_t unit, int pos, int n)
+{
+    int32_t *block = &s_output[pos];
+    switch (unit) {
+        case UNIT_SUBSONIC:     subsonic_process(&subsonic, block, n); break;
+        case UNIT_PREGAIN:      pregain_process(&pregain, block, n); break;
+        case UNIT_EQUALIZER:    equalizer_process(&equalizer, block, n); break;
+        case UNIT_LIMITER:
+        case UNIT_LIMITER_TP:   limiter_process(&limiter, block, n); break;
+        case UNIT_CHAIN_STAGED:
+        case UNIT_STAGED_TP:    dsp_chain_process_staged(block, n); break;
+        case UNIT_CHAIN_FUSED:
+        case UNIT_FUSED_TP:     dsp_chain_process_fused(block, n); break;
+        case UNIT_CHAIN_FLOAT:  dsp_chain_process_float(block, n); break;
+        case UNIT_BAND_SPLIT:   split_and_sum(block, n); break;
+        case UNIT_CONVOLVER:    convolver_process(&convolver, block, n); break;
+        case UNIT_CROSSOVER:
+            crossover_process(&crossover, block, &s_ways[pos / I2S_NUM_CHANNELS * CROSSOVER_OUT_CHANNELS], n);
+            break;
+        case UNIT_MULTIBAND:    multiband_process(&multiband, block, n); break;
+        case UNIT_DELAY_LINE:   delay_line_process(&delay_line, block, n); break;
+        default: break;
+    }
+}
+
+// Chains (and the crossover after them) take left-justified I2S words;
+// single modules take 24-bit samples
+static bool unit_is_chain(unit_id_t unit)
+{
+    return unit == UNIT_CHAIN_STAGED || unit == UNIT_CHAIN_FUSED || unit == UNIT_CHAIN_FLOAT ||
+           unit == UNIT_STAGED_TP || unit == UNIT_FUSED_TP || unit == UNIT_CROSSOVER;
+}
+
+static bool unit_is_true_peak(unit_id_t unit)
+{
+    return unit == UNIT_LIMITER_TP || unit == UNIT_STAGED_TP || unit == UNIT_FUSED_TP;
+}
+
+static void run_unit(unit_id_t unit, signal_id_t signal, int iterations, bench_result_t *result)
+{
+    using clock = std::chrono::steady_clock;
+    const int32_t *input = s_signals[signal];
+    const bool chain = unit_is_chain(unit);
+
+    result->unit = unit;
+    result->signal = signal;
+    result->best_ns = 1e30;
+
+    for (int it = 0; it < iterations; it++) {
+        configure_modules(unit, unit_is_true_peak(unit));
+
+        for (int i = 0; i < SIGNAL_SAMPLES; i++) {
+            s_output[i] = chain ? (input[i] << 8) : input[i];
+        }
+
+        // Time block by block, as audio_task calls the chain
+        double ns = 0;
+        for (int pos = 0; pos < SIGNAL_SAMPLES; pos += DMA_BUFFER_SIZE) {
+            int n = SIGNAL_SAMPLES - pos < DMA_BUFFER_SIZE ? SIGNAL_SAMPLES - pos : DMA_BUFFER_SIZE;
+            auto t0 = clock::now();
+            process_block(unit, pos, n);
+            auto t1 = clock::now();
+            ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        }
+        if (ns < result->best_ns) {
+            result->best_ns = ns;
+        }
+    }
+
+    // Every iteration starts from the same state, so the last output stands
+    // for all; the crossover's output is its ways
+    const int32_t *output = (unit == UNIT_CROSSOVER) ? s_ways : s_output;
+    const int output_samples = (unit == UNIT_CROSSOVER) ? WAYS_SAMPLES : SIGNAL_SAMPLES;
+    uint64_t hash = 1469598103934665603ULL;
+    double sum_sq = 0;
+    int32_t peak = 0;
+    for (int i = 0; i < output_samples; i++) {
+        int32_t s = chain ? (output[i] >> 8) : output[i];
+        hash ^= (uint32_t)s;
+        hash *= 1099511628211ULL;
+        sum_sq += (double)s * s;
+        int32_t a = s < 0 ? -s : s;
+        if (a > peak) {
+            peak = a;
+        }
+    }
+    result->hash = hash;
+    result->peak = peak;
+    double rms = sqrt(sum_sq / output_samples) / FULL_SCALE;
+    result->rms_db = rms > 0 ? 20.0 * log10(rms) : -200.0;
+}
+
+// Run a whole signal through a unit, block by block
+static void process_signal(unit_id_t unit)
+{
+    for (int pos = 0; pos < SIGNAL_SAMPLES; pos += DMA_BUFFER_SIZE) {
+        int n = SIGNAL_SAMPLES - pos < DMA_BUFFER_SIZE ? SIGNAL_SAMPLES - pos : DMA_BUFFER_SIZE;
+        process_block(unit, pos, n);
+    }
+}
+
+// Stereo sine of the given amplitude, same on both channels
+static void generate_tone(int32_t *dst, double freq, double amplitude)
+{
+    for (int n = 0; n < SIGNAL_FRAMES; n++) {
+        int32_t v = to_sample(amplitude * sin(2.0 * M_PI * freq * n / SAMPLE_RATE));
+        dst[2 * n] = v;
+        dst[2 * n + 1] = v;
+    }
+}
+
+// Tones across the band through the split and back: the bands are in phase,
+// so the sum must keep the level (largest deviation in dB, measured over the
+// second half, after the filters settled)
+static double check_band_split(void)
+{
+    static const double freqs[] = { 30, 100, 200, 630, 2000, 6300, 16000 };
+    static int32_t input[SIGNAL_SAMPLES];
+    double worst = 0;
+    for (double freq : freqs) {
+        configure_modules(UNIT_BAND_SPLIT, false);
+        generate_tone(input, freq, 0.5);
+        memcpy(s_output, input, sizeof(s_output));
+        process_signal(UNIT_BAND_SPLIT);
+
+        double in_sq = 0, out_sq = 0;
+        for (int i = SIGNAL_SAMPLES / 2; i < SIGNAL_SAMPLES; i++) {
+            in_sq += (double)input[i] * input[i];
+            out_sq += (double)s_output[i] * s_output[i];
+        }
+        double dev = 10.0 * log10(out_sq / in_sq);
+        if (fabs(dev) > fabs(worst)) {
+            worst = dev;
+        }
+    }
+    return worst;
+}
+
+// 1 kHz tone through the delay line: the left channel (whole frames) must be
+// the input exactly, the right one (fractional) the tone at the delay set,
+// within the interpolator's error. Returns the right channel's error
+// relative to the tone in dB; *left_error is the largest left difference.
+static double check_delay_line(int32_t *left_error)
+{
+    static int32_t input[SIGNAL_SAMPLES];
+    const double freq = 1000.0, amplitude = 0.5;
+    configure_modules(UNIT_DELAY_LINE, false);
+    generate_tone(input, freq, amplitude);
+    memcpy(s_output, input, sizeof(s_output));
+    process_signal(UNIT_DELAY_LINE);
+
+    // Delays include the interpolator's frame; skip the first blocks
+    // (enabling crossfades in from silence)
+    const int left = (int)lrintf(delay_line_get_frames(&delay_line, 0)) + 1;
+    const double right = delay_line_get_frames(&delay_line, 1) + 1.0;
+    double err_sq = 0, ref_sq = 0;
+    *left_error = 0;
+    for (int n = 4 * DMA_BUFFER_SIZE; n < SIGNAL_FRAMES; n++) {
+        int32_t e = s_output[2 * n] - input[2 * (n - left)];
+        if (abs(e) > *left_error) {
+            *left_error = abs(e);
+        }
+        double ref = amplitude * FULL_SCALE * sin(2.0 * M_PI * freq * (n - right) / SAMPLE_RATE);
+        double d = s_output[2 * n + 1] - ref;
+        err_sq += d * d;
+        ref_sq += ref * ref;
+    }
+    return 10.0 * log10(err_sq / ref_sq);
+}
+
+// Pink noise through a unit impulse at tap `delay`: the output must be the
+// input delayed by that many frames (largest difference in LSB)
+static int32_t check_convolver(int delay)
+{
+    static float taps[CONV_TAPS];
+    memset(taps, 0, sizeof(taps));
+    taps[delay] = 1.0f;
+    configure_modules(UNIT_COUNT, false);   // No unit's settings: 0 dB, no response yet
+    if (load_response(taps, delay + 1, 1) != ESP_OK) {
+        return INT32_MAX;
+    }
+    memcpy(s_output, s_signals[SIGNAL_PINK], sizeof(s_output));
+    process_signal(UNIT_CONVOLVER);
+
+    int32_t worst = 0;
+    for (int i = 0; i < SIGNAL_SAMPLES; i++) {
+        int32_t expected = (i >= delay * I2S_NUM_CHANNELS) ? s_signals[SIGNAL_PINK][i - delay * I2S_NUM_CHANNELS] : 0;
+        int32_t e = abs(s_output[i] - expected);
+        if (e > worst) {
+            worst = e;
+        }
+    }
+    return worst;
+}
+
+static int load_golden(const char *path, golden_entry_t *entries, int max_entries)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    int count = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL && count < max_entries) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        golden_entry_t *e = &entries[count];
+        unsigned long long hash;
+        if (sscanf(line, "%31s %31s %llx %lf %d", e->unit, e->signal, &hash, &e->rms_db, &e->peak) == 5) {
+            e->hash = hash;
+            count++;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static bool save_golden(const char *path, const bench_result_t *results, int count)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    fprintf(f, "# host_bench golden outputs (variant: %s, ramp: %d frames)\n",
+            VARIANT_NAME, PARAM_RAMP_FRAMES);
+    fprintf(f, "# unit signal fnv1a64 rms_dbfs peak\n");
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(f, "%s %s %016llx %.4f %d\n", s_unit_names[r->unit], s_signal_names[r->signal],
+                (unsigned long long)r->hash, r->rms_db, r->peak);
+    }
+    fclose(f);
+    return true;
+}
+
+static const golden_entry_t *find_golden(const golden_entry_t *entries, int count, const bench_result_t *r)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(entries[i].unit, s_unit_names[r->unit]) == 0 &&
+            strcmp(entries[i].signal, s_signal_names[r->signal]) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [--iterations N] [--golden FILE] [--update-golden] [--strict]\n", prog);
+    printf("  --iterations N   Timed runs per unit and signal, best is reported (default %d)\n",
+           DEFAULT_ITERATIONS);
+    printf("  --golden FILE    Golden file (default %s/%s.txt)\n", HOST_BENCH_GOLDEN_DIR, VARIANT_NAME);
+    printf("  --update-golden  Write the current outputs as the new golden file\n");
+    printf("  --strict         Treat numeric drift (same level, different bits) as failure\n");
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = DEFAULT_ITERATIONS;
+    const char *golden_path = HOST_BENCH_GOLDEN_DIR "/" VARIANT_NAME ".txt";
+    bool update_golden = false;
+    bool strict = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            if (iterations < 1) {
+                iterations = 1;
+            }
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_path = argv[++i];
+        } else if (strcmp(argv[i], "--update-golden") == 0) {
+            update_golden = true;
+        } else if (strcmp(argv[i], "--strict") == 0) {
+            strict = true;
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    coeff_bank_init();
+    generate_signals();
+    generate_response();
+
+    printf("ESP-DSP host benchmark (%s EQ kernel, %d Hz, %d-sample blocks, best of %d)\n\n",
+           equalizer_kernel_name(), SAMPLE_RATE, DMA_BUFFER_SIZE, iterations);
+    printf("  %-13s| %-7s| %9s | %12s | %9s\n", "Unit", "Signal", "ns/sample", "samples/s", "realtime");
+    printf("  -------------|--------|-----------|--------------|----------\n");
+
+    bench_result_t results[MAX_RESULTS];
+    int count = 0;
+    for (int u = 0; u < UNIT_COUNT; u++) {
+        for (int s = 0; s < SIGNAL_COUNT; s++) {
+            bench_result_t *r = &results[count++];
+            run_unit((unit_id_t)u, (signal_id_t)s, iterations, r);
+
+            double ns_per_sample = r->best_ns / SIGNAL_SAMPLES;
+            double samples_per_sec = 1e9 / ns_per_sample;
+            printf("  %-13s| %-7s| %9.2f | %12.0f | %8.0fx\n", s_unit_names[u], s_signal_names[s],
+                   ns_per_sample, samples_per_sec,
+                   samples_per_sec / (SAMPLE_RATE * I2S_NUM_CHANNELS));
+        }
+    }
+    printf("\n");
+
+    int failures = 0;
+
+    // Fused and staged must agree exactly, whatever the golden file says
+    const unit_id_t pairs[][2] = {
+        { UNIT_CHAIN_STAGED, UNIT_CHAIN_FUSED },
+        { UNIT_STAGED_TP, UNIT_FUSED_TP },
+    };
+    for (const auto &pair : pairs) {
+        for (int s = 0; s < SIGNAL_COUNT; s++) {
+            const bench_result_t *staged = &results[pair[0] * SIGNAL_COUNT + s];
+            const bench_result_t *fused = &results[pair[1] * SIGNAL_COUNT + s];
+            if (staged->hash != fused->hash) {
+                printf("FAIL: %s differs from %s on %s\n", s_unit_names[pair[1]],
+                       s_unit_names[pair[0]], s_signal_names[s]);
+                failures++;
+            }
+        }
+    }
+
+    // Modules with a known ideal response
+    printf("Accuracy checks:\n");
+    const double split_dev = check_band_split();
+    const bool split_ok = fabs(split_dev) <= SPLIT_FLAT_TOL_DB;
+    printf("  band_split    bands sum flat         %-4s deviation %+8.4f dB (limit %.2f dB)\n",
+           split_ok ? "OK" : "FAIL", split_dev, SPLIT_FLAT_TOL_DB);
+
+    int32_t left_error;
+    const double delay_err = check_delay_line(&left_error);
+    const bool delay_ok = left_error == 0 && delay_err <= DELAY_ERROR_TOL_DB;
+    printf("  delay_line    whole / fractional     %-4s exact %s, error %7.1f dB (limit %.0f dB)\n",
+           delay_ok ? "OK" : "FAIL", left_error == 0 ? "yes" : "no", delay_err, DELAY_ERROR_TOL_DB);
+
+    const int conv_delays[] = { 0, 300 };
+    bool conv_ok = true;
+    int32_t conv_err = 0;
+    for (int delay : conv_delays) {
+        int32_t e = check_convolver(delay);
+        conv_ok = conv_ok && e <= CONV_IDENTITY_TOL;
+        if (e > conv_err) {
+            conv_err = e;
+        }
+    }
+    printf("  convolver     unit impulse           %-4s error %d LSB (limit %d LSB)\n",
+           conv_ok ? "OK" : "FAIL", (int)conv_err, CONV_IDENTITY_TOL);
+    printf("\n");
+    failures += !split_ok + !delay_ok + !conv_ok;
+
+    if (update_golden) {
+        if (!save_golden(golden_path, results, count)) {
+            printf("Error: Cannot write %s\n", golden_path);
+            return 1;
+        }
+        printf("Golden file written: %s\n", golden_path);
+        return failures ? 1 : 0;
+    }
+
+    golden_entry_t golden[MAX_RESULTS];
+    int golden_count = load_golden(golden_path, golden, MAX_RESULTS);
+    if (golden_count < 0) {
+        printf("Error: Cannot read %s (run with --update-golden to create it)\n", golden_path);
+        return 1;
+    }
+
+    int drifts = 0;
+    printf("Golden check (%s):\n", golden_path);
+    for (int i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        const golden_entry_t *g = find_golden(golden, golden_count, r);
+        const char *status;
+        if (g == NULL) {
+            status = "MISSING";
+            failures++;
+        } else if (g->hash == r->hash) {
+            status = "OK";
+        } else if (fabs(g->rms_db - r->rms_db) <= GOLDEN_RMS_TOL_DB &&
+                   abs(g->peak - r->peak) <= GOLDEN_PEAK_TOL) {
+            status = "DRIFT";
+            drifts++;
+        } else {
+            status = "FAIL";
+            failures++;
+        }
+        printf("  %-13s %-7s %-8s rms %8.3f dBFS  peak %8d", s_unit_names[r->unit],
+               s_signal_names[r->signal], status, r->rms_db, (int)r->peak);
+        if (g != NULL && g->hash != r->hash) {
+            printf("  (golden %8.3f dBFS, %8d)", g->rms_db, (int)g->peak);
+        }
+        printf("\n");
+    }
+
+    if (strict) {
+        failures += drifts;
+    }
+    printf("\n%d failed, %d drifted, %d checked\n", failures, drifts, count);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,9 @@
+#ifndef HOST_DRIVER_I2S_STD_H
+#define HOST_DRIVER_I2S_STD_H
+
+// Host stand-in for ESP-IDF driver/i2s_std.h (the channel handle type in
+// the I/O task declarations; the benchmark drives no I2S)
+
+typedef struct i2s_channel_obj_t *i2s_chan_handle_t;
+
+#endif // HOST_DRIVER_I2S_STD_H
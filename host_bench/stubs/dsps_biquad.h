@@ -0,0 +1,19 @@
+#ifndef HOST_DSPS_BIQUAD_H
+#define HOST_DSPS_BIQUAD_H
+
+// Host stand-in for esp-dsp dsps_biquad.h (ANSI reference kernels)
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t dsps_biquad_f32(const float *input, float *output, int len, float *coef, float *w);
+esp_err_t dsps_biquad_sf32(const float *input, float *output, int len, float *coef, float *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_DSPS_BIQUAD_H
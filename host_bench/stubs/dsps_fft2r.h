@@ -0,0 +1,23 @@
+#ifndef HOST_DSPS_FFT2R_H
+#define HOST_DSPS_FFT2R_H
+
+// Host stand-in for esp-dsp dsps_fft2r.h (radix-2 complex FFT, ANSI
+// reference kernels): forward transform in place with the output in
+// bit-reversed order, as the library's, until dsps_bit_rev_fc32
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t dsps_fft2r_init_fc32(float *fft_table_buff, int table_size);
+void dsps_fft2r_deinit_fc32(void);
+esp_err_t dsps_fft2r_fc32(float *data, int N);
+esp_err_t dsps_bit_rev_fc32(float *data, int N);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_DSPS_FFT2R_H
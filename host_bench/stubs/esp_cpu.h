@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+// Host stand-in for ESP-IDF esp_cpu.h (only reached with CONFIG_DSP_PERF)
+
+#include <stdint.h>
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return 0;
+}
+
+#endif // HOST_ESP_CPU_H
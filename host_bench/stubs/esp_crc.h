@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_CRC_H
+#define HOST_ESP_CRC_H
+
+// Host stand-in for ESP-IDF esp_crc.h (the ROM CRC routines)
+
+#include <stdint.h>
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_ESP_CRC_H
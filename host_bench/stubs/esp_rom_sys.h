@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+
+// Host stand-in for ESP-IDF esp_rom_sys.h
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 240;
+}
+
+#endif // HOST_ESP_ROM_SYS_H
@@ -0,0 +1,11 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+// Host stand-in for ESP-IDF esp_timer.h
+
+#include <stdint.h>
+
+// Microseconds since start (steady clock)
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_ESP_TIMER_H
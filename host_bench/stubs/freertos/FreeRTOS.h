@@ -0,0 +1,19 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Host stand-in for FreeRTOS.h
+// The benchmark is single-threaded, so locks and delays are no-ops.
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define portMAX_DELAY       ((TickType_t)0xffffffffu)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+#endif // HOST_FREERTOS_H
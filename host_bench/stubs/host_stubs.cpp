@@ -0,0 +1,210 @@
+#include "esp_err.h"
+#include "nvs.h"
+#include "dsps_biquad.h"
+#include "dsps_fft2r.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdlib.h>
+#include <chrono>
+
+// Implementations behind the host stand-in headers
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default:                    return "ESP_ERR";
+    }
+}
+
+// NVS: no storage on the host
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+esp_err_t nvs_commit(nvs_handle_t handle) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) { return ESP_ERR_NVS_NOT_FOUND; }
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) { return ESP_ERR_NVS_NOT_FOUND; }
+
+// FreeRTOS: single-threaded host, nothing to wait for
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static int mutex;
+    return &mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) { return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { return pdTRUE; }
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    static int mutex;
+    return &mutex;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) { return pdTRUE; }
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return pdTRUE; }
+void vTaskDelay(TickType_t ticks) {}
+
+// Timer, partitions, CRC
+
+int64_t esp_timer_get_time(void)
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) { return ESP_ERR_NOT_FOUND; }
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) { return ESP_ERR_NOT_FOUND; }
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) { return ESP_ERR_NOT_FOUND; }
+
+// Same convention as the ROM routine: crc is the previous result (0 to start)
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+// esp-dsp reference kernels (same arithmetic as the library's ANSI versions;
+// the target uses the AES3/PIE assembly, so host timings are not comparable)
+
+esp_err_t dsps_biquad_f32(const float *input, float *output, int len, float *coef, float *w)
+{
+    for (int i = 0; i < len; i++) {
+        float d0 = input[i] - coef[3] * w[0] - coef[4] * w[1];
+        output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+        w[1] = w[0];
+        w[0] = d0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_biquad_sf32(const float *input, float *output, int len, float *coef, float *w)
+{
+    for (int i = 0; i < len; i++) {
+        float d0 = input[i * 2 + 0] - coef[3] * w[0] - coef[4] * w[1];
+        output[i * 2 + 0] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+        w[1] = w[0];
+        w[0] = d0;
+
+        d0 = input[i * 2 + 1] - coef[3] * w[2] - coef[4] * w[3];
+        output[i * 2 + 1] = coef[0] * d0 + coef[1] * w[2] + coef[2] * w[3];
+        w[3] = w[2];
+        w[2] = d0;
+    }
+    return ESP_OK;
+}
+
+// Twiddle table for the largest transform (cos, sin of -2 pi k / size), as
+// the library keeps one table for all sizes
+static float *s_fft_table = NULL;
+static int s_fft_table_size = 0;
+
+esp_err_t dsps_fft2r_init_fc32(float *fft_table_buff, int table_size)
+{
+    if (s_fft_table != NULL) {
+        return ESP_OK;
+    }
+    if (table_size < 2 || (table_size & (table_size - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_fft_table = (float *)malloc(table_size * sizeof(float));
+    if (s_fft_table == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int k = 0; k < table_size / 2; k++) {
+        s_fft_table[2 * k] = (float)cos(2.0 * M_PI * k / table_size);
+        s_fft_table[2 * k + 1] = (float)-sin(2.0 * M_PI * k / table_size);
+    }
+    s_fft_table_size = table_size;
+    return ESP_OK;
+}
+
+void dsps_fft2r_deinit_fc32(void)
+{
+    free(s_fft_table);
+    s_fft_table = NULL;
+    s_fft_table_size = 0;
+}
+
+// Decimation in frequency: natural order in, bit-reversed order out
+esp_err_t dsps_fft2r_fc32(float *data, int N)
+{
+    if (s_fft_table == NULL || N > s_fft_table_size || (N & (N - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int len = N; len >= 2; len >>= 1) {
+        const int half = len / 2;
+        const int stride = s_fft_table_size / len;
+        for (int base = 0; base < N; base += len) {
+            for (int j = 0; j < half; j++) {
+                float *a = &data[2 * (base + j)];
+                float *b = &data[2 * (base + j + half)];
+                const float wr = s_fft_table[2 * j * stride];
+                const float wi = s_fft_table[2 * j * stride + 1];
+                const float dr = a[0] - b[0];
+                const float di = a[1] - b[1];
+                a[0] += b[0];
+                a[1] += b[1];
+                b[0] = dr * wr - di * wi;
+                b[1] = dr * wi + di * wr;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_bit_rev_fc32(float *data, int N)
+{
+    for (int i = 1, j = 0; i < N; i++) {
+        int bit = N >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float t = data[2 * i];
+            data[2 * i] = data[2 * j];
+            data[2 * j] = t;
+            t = data[2 * i + 1];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j + 1] = t;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,39 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// Host build configuration (mirrors the Kconfig defaults in main/Kconfig.projbuild)
+// CMake options select the variants: HOST_BENCH_EQ_SIMD_KERNEL,
+// HOST_BENCH_RAMP_FRAMES.
+
+#define CONFIG_AUDIO_BUFFER_SIZE        480
+#define CONFIG_AUDIO_FUSED_CHAIN        1
+#define CONFIG_EQ_MAX_BANDS             16
+
+#ifdef HOST_BENCH_RAMP_FRAMES
+#define CONFIG_DSP_PARAM_RAMP_FRAMES    HOST_BENCH_RAMP_FRAMES
+#else
+#define CONFIG_DSP_PARAM_RAMP_FRAMES    480
+#endif
+
+// The optional stages, so the benchmark covers them; they start disabled
+// (the convolver without a response), so the chain units run the same
+// stages as without them. The convolver tail runs inline: the host is
+// single-threaded.
+#define CONFIG_CONVOLVER                1
+#define CONFIG_CONVOLVER_MAX_TAPS       2048
+#define CONFIG_CROSSOVER                1
+#define CONFIG_CROSSOVER_OUTPUT_TDM     1
+#define CONFIG_CROSSOVER_WAYS           3
+#define CONFIG_MULTIBAND                1
+#define CONFIG_DELAY_LINE               1
+#define CONFIG_DELAY_LINE_MAX_MS        100
+
+// esp-dsp is replaced by its portable reference implementation (host_stubs.cpp)
+#ifdef HOST_BENCH_EQ_SIMD_KERNEL
+#define CONFIG_EQ_SIMD_KERNEL           1
+#endif
+
+// The on-target profiler reads the Xtensa/RISC-V cycle counter; not on the host
+#undef CONFIG_DSP_PERF
+
+#endif // HOST_SDKCONFIG_H
@@ -2,12 +2,14 @@
 #define AUDIO_CONFIG_H
 
 #include "driver/gpio.h"
+#include "sdkconfig.h"
 
 // Audio Configuration
-#define SAMPLE_RATE     48000  // Can be changed to 44100, 48000, 96000, 192000
+#define SAMPLE_RATE     48000  // Rate at first boot; the running rate is audio_rate_get()
 #define I2S_NUM_CHANNELS 2
 #define DMA_BUFFER_COUNT 8     // Number of DMA descriptors for better buffering
-#define DMA_BUFFER_SIZE  480   // Number of samples per buffer (max 1024/4 = 256, but 512 works)
+#define DMA_BUFFER_SIZE  CONFIG_AUDIO_BUFFER_SIZE   // Samples per block, both channels (default 480)
+static_assert((DMA_BUFFER_SIZE % 2) == 0, "AUDIO_BUFFER_SIZE must be even");
 
 // Bit depth configuration
 // WM8782 supports up to 24-bit
@@ -24,4 +26,9 @@
 // ADC (WM8782) is SLAVE - receives clocks from DAC
 #define I2S_ADC_DIN     GPIO_NUM_4   // Data in from WM8782
 
+// Second DAC of the 2-way crossover on I2S1 (slave of the BCK/WS above)
+#ifdef CONFIG_CROSSOVER_AUX_DOUT_GPIO
+#define I2S_AUX_DOUT    ((gpio_num_t)CONFIG_CROSSOVER_AUX_DOUT_GPIO)
+#endif
+
 #endif // AUDIO_CONFIG_H
@@ -0,0 +1,398 @@
+#include "audio_i2s.h"
+#include "audio_config.h"
+#include "audio_rate.h"
+#include "dsp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#if CROSSOVER_OUTPUT_TDM
+#include "driver/i2s_tdm.h"
+#endif
+#if CROSSOVER_OUTPUT_I2S1
+#include "driver/gpio.h"
+#include "soc/i2s_periph.h"
+#include "esp_rom_gpio.h"
+#endif
+
+static const char *TAG = "AUDIO_I2S";
+
+// Output frame: 32-bit slots, two per crossover way on TDM
+#if CROSSOVER_OUTPUT_TDM
+#define FRAME_SLOTS     CROSSOVER_OUT_CHANNELS
+#else
+#define FRAME_SLOTS     I2S_NUM_CHANNELS
+#endif
+#define FRAME_BITS      (FRAME_SLOTS * 32)
+
+// Largest DMA buffer the driver accepts per descriptor
+#define DMA_MAX_BYTES   4092
+
+#if CROSSOVER_OUTPUT_I2S1
+// Second DAC (crossover way 1), slave of the I2S_NUM_0 clocks
+static i2s_chan_handle_t s_aux_tx = NULL;
+#endif
+
+// MCLK multiple per rate: 384 x fs up to 48 kHz (18.432 MHz), then lower
+// multiples so that MCLK stays within what the WM8782 accepts (256 x fs at
+// 96 kHz, 128 x fs at 192 kHz; both 24.576 MHz). TDM frames are longer:
+// MCLK is raised to a multiple of the frame of at least 3 x BCLK, which the
+// TDM driver needs to derive BCLK.
+static i2s_mclk_multiple_t mclk_multiple(uint32_t sample_rate)
+{
+    uint32_t multiple;
+    if (sample_rate <= 48000) {
+        multiple = 384;
+    } else if (sample_rate <= 96000) {
+        multiple = 256;
+    } else {
+        multiple = 128;
+    }
+#if CROSSOVER_OUTPUT_TDM
+    if (multiple < 3 * FRAME_BITS) {
+        multiple = 3 * FRAME_BITS;
+    }
+    multiple = (multiple + FRAME_BITS - 1) / FRAME_BITS * FRAME_BITS;
+#endif
+    return (i2s_mclk_multiple_t)multiple;
+}
+
+static i2s_std_clk_config_t clock_config(uint32_t sample_rate)
+{
+    i2s_std_clk_config_t clk_cfg = {
+        .sample_rate_hz = sample_rate,
+        .clk_src = I2S_CLK_SRC_DEFAULT,
+        .ext_clk_freq_hz = 0, // No external clock
+        .mclk_multiple = mclk_multiple(sample_rate),
+    };
+    return clk_cfg;
+}
+
+#if CROSSOVER_OUTPUT_TDM
+static i2s_tdm_clk_config_t tdm_clock_config(uint32_t sample_rate)
+{
+    i2s_tdm_clk_config_t clk_cfg = I2S_TDM_CLK_DEFAULT_CONFIG(sample_rate);
+    clk_cfg.mclk_multiple = mclk_multiple(sample_rate);
+    return clk_cfg;
+}
+
+// Philips TDM frame of FRAME_SLOTS slots with WS high for half of it, so
+// that a stereo I2S device sees an ordinary LRCK (and its data in the
+// first slot of each half)
+static i2s_tdm_slot_config_t tdm_slot_config(uint32_t slot_mask)
+{
+    i2s_tdm_slot_config_t slot_cfg = I2S_TDM_PHILIPS_SLOT_DEFAULT_CONFIG(
+        I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO, (i2s_tdm_slot_mask_t)slot_mask);
+    slot_cfg.total_slot = FRAME_SLOTS;
+    slot_cfg.ws_width = FRAME_BITS / 2;
+    return slot_cfg;
+}
+
+static esp_err_t init_channels(i2s_chan_handle_t tx, i2s_chan_handle_t rx)
+{
+    i2s_tdm_config_t tdm_cfg = {
+        .clk_cfg = tdm_clock_config(audio_rate_get()),
+        .slot_cfg = tdm_slot_config((1u << FRAME_SLOTS) - 1),
+        .gpio_cfg = {
+            .mclk = I2S_MCLK,
+            .bclk = I2S_DAC_BCLK,
+            .ws = I2S_DAC_WS,
+            .dout = I2S_DAC_DOUT,
+            .din = I2S_ADC_DIN,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        },
+    };
+
+    // TX: every slot, two per way
+    esp_err_t ret = i2s_channel_init_tdm_mode(tx, &tdm_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2S TX (TDM): %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // RX: the ADC's left and right words start each half of the frame
+    tdm_cfg.slot_cfg = tdm_slot_config(1u | (1u << (FRAME_SLOTS / 2)));
+    ret = i2s_channel_init_tdm_mode(rx, &tdm_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2S RX (TDM): %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t reconfig_clock(i2s_chan_handle_t chan, uint32_t sample_rate)
+{
+    const i2s_tdm_clk_config_t clk_cfg = tdm_clock_config(sample_rate);
+    return i2s_channel_reconfig_tdm_clock(chan, &clk_cfg);
+}
+
+#else
+
+static esp_err_t init_channels(i2s_chan_handle_t tx, i2s_chan_handle_t rx)
+{
+    // Configure RX channel without MCLK
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = clock_config(audio_rate_get()),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_MCLK, 
+            .bclk = I2S_DAC_BCLK,
+            .ws = I2S_DAC_WS,
+            .dout = I2S_DAC_DOUT,
+            .din = I2S_ADC_DIN,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        },
+    };
+    
+    // Initialize TX channel
+    esp_err_t ret = i2s_channel_init_std_mode(tx, &std_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2S TX: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // Initialize RX channel with SAME config (clocks already shared)
+    ret = i2s_channel_init_std_mode(rx, &std_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2S RX: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t reconfig_clock(i2s_chan_handle_t chan, uint32_t sample_rate)
+{
+    const i2s_std_clk_config_t clk_cfg = clock_config(sample_rate);
+    return i2s_channel_reconfig_std_clock(chan, &clk_cfg);
+}
+
+#endif
+
+#if CROSSOVER_OUTPUT_I2S1
+// The slave init made a clock pin an input of I2S_NUM_1; drive it from the
+// I2S_NUM_0 master again and keep feeding it to the slave
+static void share_clock_pin(gpio_num_t pin, uint32_t master_out, uint32_t slave_in)
+{
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT);
+    esp_rom_gpio_connect_out_signal(pin, master_out, false, false);
+    esp_rom_gpio_connect_in_signal(pin, slave_in, false);
+}
+
+static esp_err_t create_aux(uint32_t desc_num, uint32_t frame_num)
+{
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_SLAVE);
+    chan_cfg.dma_desc_num = desc_num;
+    chan_cfg.dma_frame_num = frame_num;
+    chan_cfg.auto_clear = true;
+
+    esp_err_t ret = i2s_new_channel(&chan_cfg, &s_aux_tx, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2S1 channel: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = clock_config(audio_rate_get()),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = I2S_DAC_BCLK,
+            .ws = I2S_DAC_WS,
+            .dout = I2S_AUX_DOUT,
+            .din = I2S_GPIO_UNUSED,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        },
+    };
+    ret = i2s_channel_init_std_mode(s_aux_tx, &std_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2S1 TX: %s", esp_err_to_name(ret));
+        i2s_del_channel(s_aux_tx);
+        s_aux_tx = NULL;
+        return ret;
+    }
+
+    share_clock_pin(I2S_DAC_BCLK, i2s_periph_signal[I2S_NUM_0].m_tx_bck_sig,
+                    i2s_periph_signal[I2S_NUM_1].s_tx_bck_sig);
+    share_clock_pin(I2S_DAC_WS, i2s_periph_signal[I2S_NUM_0].m_tx_ws_sig,
+                    i2s_periph_signal[I2S_NUM_1].s_tx_ws_sig);
+    ESP_LOGI(TAG, "Second DAC on I2S1, data on GPIO %d", (int)I2S_AUX_DOUT);
+    return ESP_OK;
+}
+#endif
+
+bool audio_i2s_rate_supported(uint32_t sample_rate)
+{
+    return (uint64_t)sample_rate * mclk_multiple(sample_rate) <= AUDIO_I2S_MAX_MCLK_HZ;
+}
+
+esp_err_t audio_i2s_create(uint32_t desc_num, uint32_t frame_num,
+                           i2s_chan_handle_t *tx, i2s_chan_handle_t *rx)
+{
+    ESP_LOGI(TAG, "Initializing I2S channels (%lu x %lu frames)...",
+             (unsigned long)desc_num, (unsigned long)frame_num);
+    
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = desc_num;
+    chan_cfg.dma_frame_num = frame_num;
+    chan_cfg.auto_clear = true;
+    
+    // TDM frames are wider: keep each descriptor within what the DMA takes
+    const uint32_t max_frames = DMA_MAX_BYTES / (FRAME_SLOTS * sizeof(int32_t));
+    if (chan_cfg.dma_frame_num > max_frames) {
+        chan_cfg.dma_frame_num = max_frames;
+    }
+    
+    esp_err_t ret = i2s_new_channel(&chan_cfg, tx, rx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2S channels: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "I2S channels created - RX: %p, TX: %p", *rx, *tx);
+    
+    ret = init_channels(*tx, *rx);
+    if (ret != ESP_OK) {
+        audio_i2s_delete(*tx, *rx, false);
+        return ret;
+    }
+    
+#if CROSSOVER_OUTPUT_I2S1
+    // After TX, whose pins the second channel shares
+    ret = create_aux(desc_num, frame_num);
+    if (ret != ESP_OK) {
+        audio_i2s_delete(*tx, *rx, false);
+        return ret;
+    }
+#elif CROSSOVER_OUTPUT_TDM
+    ESP_LOGI(TAG, "TDM: %d slots of 32 bits (%d ways), %lu frames per DMA buffer", FRAME_SLOTS,
+             CROSSOVER_WAYS, (unsigned long)chan_cfg.dma_frame_num);
+#endif
+    
+    return ESP_OK;
+}
+
+esp_err_t audio_i2s_enable(i2s_chan_handle_t tx, i2s_chan_handle_t rx)
+{
+    esp_err_t ret;
+#if CROSSOVER_OUTPUT_I2S1
+    // The slave first, so that it starts on the master's first frame
+    ret = i2s_channel_enable(s_aux_tx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable I2S1 TX: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+    
+    // Enable TX first, then RX
+    ret = i2s_channel_enable(tx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable I2S TX: %s", esp_err_to_name(ret));
+#if CROSSOVER_OUTPUT_I2S1
+        i2s_channel_disable(s_aux_tx);
+#endif
+        return ret;
+    }
+    
+    ret = i2s_channel_enable(rx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable I2S RX: %s", esp_err_to_name(ret));
+        i2s_channel_disable(tx);
+#if CROSSOVER_OUTPUT_I2S1
+        i2s_channel_disable(s_aux_tx);
+#endif
+        return ret;
+    }
+    
+    const uint32_t rate = audio_rate_get();
+    ESP_LOGI(TAG, "I2S initialized successfully with shared clock domain and MCLK");
+    ESP_LOGI(TAG, "MCLK: %lu Hz (%lu Hz * %d)", (unsigned long)(rate * mclk_multiple(rate)),
+             (unsigned long)rate, (int)mclk_multiple(rate));
+    return ESP_OK;
+}
+
+esp_err_t audio_i2s_set_sample_rate(i2s_chan_handle_t tx, i2s_chan_handle_t rx, uint32_t sample_rate)
+{
+    if (!audio_i2s_rate_supported(sample_rate)) {
+        ESP_LOGE(TAG, "%lu Hz needs a faster MCLK than the TDM outputs allow", (unsigned long)sample_rate);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    // RX first: it runs on the clocks TX generates
+    i2s_channel_disable(rx);
+    i2s_channel_disable(tx);
+#if CROSSOVER_OUTPUT_I2S1
+    i2s_channel_disable(s_aux_tx);
+#endif
+    
+    esp_err_t ret = reconfig_clock(tx, sample_rate);
+    if (ret == ESP_OK) {
+        ret = reconfig_clock(rx, sample_rate);
+    }
+#if CROSSOVER_OUTPUT_I2S1
+    if (ret == ESP_OK) {
+        const i2s_std_clk_config_t clk_cfg = clock_config(sample_rate);
+        ret = i2s_channel_reconfig_std_clock(s_aux_tx, &clk_cfg);
+    }
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set I2S clock to %lu Hz: %s", (unsigned long)sample_rate, esp_err_to_name(ret));
+    }
+    
+    // Running again either way, at the old clock if the new one failed
+    esp_err_t en = audio_i2s_enable(tx, rx);
+    return (ret != ESP_OK) ? ret : en;
+}
+
+esp_err_t DSP_HOT audio_i2s_write_output(i2s_chan_handle_t tx, const int32_t *output, int num_frames)
+{
+    size_t bytes_written = 0;
+#if CROSSOVER_OUTPUT_I2S1
+    // Way 1 first: a slave queue that runs dry plays silence out of step
+    const size_t bytes = (size_t)num_frames * I2S_NUM_CHANNELS * sizeof(int32_t);
+    esp_err_t ret = i2s_channel_write(s_aux_tx, output + num_frames * I2S_NUM_CHANNELS, bytes,
+                                      &bytes_written, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return i2s_channel_write(tx, output, bytes, &bytes_written, portMAX_DELAY);
+#else
+    const size_t bytes = (size_t)num_frames * FRAME_SLOTS * sizeof(int32_t);
+    return i2s_channel_write(tx, output, bytes, &bytes_written, portMAX_DELAY);
+#endif
+}
+
+void audio_i2s_delete(i2s_chan_handle_t tx, i2s_chan_handle_t rx, bool enabled)
+{
+    if (enabled) {
+        // RX first: it runs on the clocks TX generates
+        if (rx != NULL) {
+            i2s_channel_disable(rx);
+        }
+        if (tx != NULL) {
+            i2s_channel_disable(tx);
+        }
+    }
+    if (rx != NULL) {
+        i2s_del_channel(rx);
+    }
+    if (tx != NULL) {
+        i2s_del_channel(tx);
+    }
+#if CROSSOVER_OUTPUT_I2S1
+    if (s_aux_tx != NULL) {
+        if (enabled) {
+            i2s_channel_disable(s_aux_tx);
+        }
+        i2s_del_channel(s_aux_tx);
+        s_aux_tx = NULL;
+    }
+#endif
+}
@@ -0,0 +1,103 @@
+#ifndef AUDIO_I2S_H
+#define AUDIO_I2S_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2s_std.h"
+#include "crossover.h"
+
+// I2S duplex channel pair
+// TX (PCM5102A, clock master) and RX (WM8782, clock slave) share I2S_NUM_0
+// and therefore one clock domain. The DMA geometry is a parameter so that the
+// low-latency I/O mode can rebuild the channels at runtime; the sample rate
+// is the current audio_rate_get().
+//
+// With the crossover the outputs carry its ways: with CROSSOVER_OUTPUT_TDM
+// both channels of I2S_NUM_0 run in TDM mode (TX on every slot, RX on the
+// first slot of each word select half, so the ADC still sees a 50% LRCK);
+// with CROSSOVER_OUTPUT_I2S1 a second TX channel on I2S_NUM_1 runs as a
+// slave of the same BCLK/WS pins and plays way 1. Blocks for the outputs go
+// through audio_i2s_write_output in either case.
+
+// Samples of one output block in the layout of audio_i2s_write_output
+#if CROSSOVER_ENABLED
+#define AUDIO_I2S_OUT_SAMPLES   CROSSOVER_OUT_SAMPLES
+#else
+#define AUDIO_I2S_OUT_SAMPLES   DMA_BUFFER_SIZE
+#endif
+
+// Highest MCLK the channels are clocked with (384 x 96 kHz). TDM frames
+// need MCLK at 3 x BCLK or more, which caps the rates of the TDM outputs
+#define AUDIO_I2S_MAX_MCLK_HZ   36864000
+
+/**
+ * Create and configure the TX/RX channel pair (not yet enabled)
+ *
+ * The interrupt of both channels is allocated on the calling core.
+ *
+ * @param desc_num DMA descriptors per direction
+ * @param frame_num Stereo frames per DMA descriptor
+ * @param tx Set to the TX channel handle
+ * @param rx Set to the RX channel handle
+ * @return ESP_OK or the driver error (nothing is left allocated on failure)
+ */
+esp_err_t audio_i2s_create(uint32_t desc_num, uint32_t frame_num,
+                           i2s_chan_handle_t *tx, i2s_chan_handle_t *rx);
+
+/**
+ * Check whether the outputs can be clocked at a rate
+ *
+ * @param sample_rate Rate in Hz
+ * @return false if the MCLK would exceed AUDIO_I2S_MAX_MCLK_HZ (TDM outputs only)
+ */
+bool audio_i2s_rate_supported(uint32_t sample_rate);
+
+/**
+ * Start both channels, TX first
+ *
+ * @param tx TX channel handle
+ * @param rx RX channel handle
+ * @return ESP_OK or the driver error
+ */
+esp_err_t audio_i2s_enable(i2s_chan_handle_t tx, i2s_chan_handle_t rx);
+
+/**
+ * Change the sample rate of the running channel pair
+ *
+ * Both channels are stopped, reclocked (MCLK multiple adapted to the rate)
+ * and started again; the caller must not read or write meanwhile. The
+ * channels are restarted on failure too; set the previous rate again to
+ * get a consistent clock.
+ *
+ * @param tx TX channel handle (enabled)
+ * @param rx RX channel handle (enabled)
+ * @param sample_rate New rate in Hz
+ * @return ESP_OK or the driver error
+ */
+esp_err_t audio_i2s_set_sample_rate(i2s_chan_handle_t tx, i2s_chan_handle_t rx, uint32_t sample_rate);
+
+/**
+ * Write one output block (blocks until there is room in the DMA queue)
+ *
+ * Without the crossover this is the stereo block from the chain; with it,
+ * the block from crossover_process (TDM frames, or the I2S0 block followed
+ * by the I2S1 block).
+ *
+ * @param tx TX channel handle
+ * @param output AUDIO_I2S_OUT_SAMPLES words or fewer, for num_frames frames
+ * @param num_frames Frames in the block
+ * @return ESP_OK or the driver error
+ */
+esp_err_t audio_i2s_write_output(i2s_chan_handle_t tx, const int32_t *output, int num_frames);
+
+/**
+ * Stop and delete both channels
+ *
+ * @param tx TX channel handle (may be NULL)
+ * @param rx RX channel handle (may be NULL)
+ * @param enabled true if the channels were enabled
+ */
+void audio_i2s_delete(i2s_chan_handle_t tx, i2s_chan_handle_t rx, bool enabled);
+
+#endif // AUDIO_I2S_H
@@ -0,0 +1,496 @@
+#include "audio_lowlat.h"
+#include "audio_i2s.h"
+#include "audio_rate.h"
+#include "dsp_chain.h"
+#include "dsp_perf.h"
+#include "dsp_attr.h"
+#include "dsp_bench.h"
+#include "audio_xrun.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include <nvs.h>
+#include <string.h>
+#include <limits.h>
+
+static const char *TAG = "AUDIO_LL";
+
+// NVS storage keys
+#define NVS_NAMESPACE "audio_io"
+#define NVS_KEY_FRAMES "ll_frames"
+#define NVS_KEY_DESCS "ll_descs"
+
+#if AUDIO_LOWLAT_ENABLED
+
+// Wake up at least this often without DMA events (watchdog, requests)
+#define LOWLAT_IDLE_MS      100
+
+// Most recent DMA event of one direction (written by the I2S interrupt)
+typedef struct {
+    void *buf;                  // DMA buffer that filled (RX) or finished playing (TX)
+    int64_t time_us;            // esp_timer time of the interrupt
+    uint32_t seq;               // Events since the channels were enabled
+} dma_event_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static dma_event_t s_rx_event;
+static dma_event_t s_tx_event;
+
+static i2s_chan_handle_t s_rx = NULL;
+static i2s_chan_handle_t s_tx = NULL;
+static TaskHandle_t s_task = NULL;
+
+// Current geometry (written by the I/O task only)
+static volatile uint32_t s_frames = CONFIG_AUDIO_LOW_LATENCY_FRAMES;
+static volatile uint32_t s_descs = CONFIG_AUDIO_LOW_LATENCY_DESCS;
+static int64_t s_period_us = 0;
+
+// Geometry change handshake between a control task and the I/O task
+static SemaphoreHandle_t s_req_lock = NULL;
+static SemaphoreHandle_t s_req_done = NULL;
+static uint32_t s_req_frames = 0;
+static uint32_t s_req_descs = 0;
+static volatile bool s_req_pending = false;
+static esp_err_t s_req_result = ESP_OK;
+
+// Statistics (written by the I/O task only)
+static volatile bool s_stats_reset = false;
+static volatile uint32_t s_blocks = 0;
+static volatile uint32_t s_missed = 0;
+static volatile uint32_t s_late = 0;
+static volatile int32_t s_latency_us = 0;
+static volatile int32_t s_latency_min_us = INT32_MAX;
+static volatile int32_t s_latency_max_us = 0;
+static volatile int32_t s_min_slack_us = INT32_MAX;
+
+static DSP_HOT_INLINE void *event_buffer(const i2s_event_data_t *event)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0)
+    return event->dma_buf;
+#else
+    // Older drivers pass the address of the descriptor's buffer pointer
+    return *(void **)event->data;
+#endif
+}
+
+static bool IRAM_ATTR on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    portENTER_CRITICAL_ISR(&s_lock);
+    s_rx_event.buf = event_buffer(event);
+    s_rx_event.time_us = esp_timer_get_time();
+    s_rx_event.seq++;
+    portEXIT_CRITICAL_ISR(&s_lock);
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    return woken == pdTRUE;
+}
+
+static bool IRAM_ATTR on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    // The driver zeroes the buffer (auto_clear) before the task can run, so a
+    // block that is not processed in time plays as silence, not stale audio
+    BaseType_t woken = pdFALSE;
+    portENTER_CRITICAL_ISR(&s_lock);
+    s_tx_event.buf = event_buffer(event);
+    s_tx_event.time_us = esp_timer_get_time();
+    s_tx_event.seq++;
+    portEXIT_CRITICAL_ISR(&s_lock);
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    return woken == pdTRUE;
+}
+
+static void clear_stats(void)
+{
+    s_blocks = 0;
+    s_missed = 0;
+    s_late = 0;
+    s_latency_us = 0;
+    s_latency_min_us = INT32_MAX;
+    s_latency_max_us = 0;
+    s_min_slack_us = INT32_MAX;
+}
+
+// Create, hook up and start the channels (I/O task only, so that the
+// interrupt is allocated on its core)
+static esp_err_t open_channels(uint32_t frames, uint32_t descs)
+{
+    esp_err_t err = audio_i2s_create(descs, frames, &s_tx, &s_rx);
+    if (err != ESP_OK) {
+        s_tx = NULL;
+        s_rx = NULL;
+        return err;
+    }
+
+    i2s_event_callbacks_t rx_cbs;
+    memset(&rx_cbs, 0, sizeof(rx_cbs));
+    rx_cbs.on_recv = on_recv;
+    i2s_event_callbacks_t tx_cbs;
+    memset(&tx_cbs, 0, sizeof(tx_cbs));
+    tx_cbs.on_sent = on_sent;
+
+    err = i2s_channel_register_event_callback(s_rx, &rx_cbs, NULL);
+    if (err == ESP_OK) {
+        err = i2s_channel_register_event_callback(s_tx, &tx_cbs, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register I2S callbacks: %s", esp_err_to_name(err));
+        audio_i2s_delete(s_tx, s_rx, false);
+        s_tx = NULL;
+        s_rx = NULL;
+        return err;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_rx_event, 0, sizeof(s_rx_event));
+    memset(&s_tx_event, 0, sizeof(s_tx_event));
+    portEXIT_CRITICAL(&s_lock);
+
+    s_frames = frames;
+    s_descs = descs;
+    s_period_us = (int64_t)frames * 1000000 / audio_rate_get();
+    clear_stats();
+
+    err = audio_i2s_enable(s_tx, s_rx);
+    if (err != ESP_OK) {
+        audio_i2s_delete(s_tx, s_rx, false);
+        s_tx = NULL;
+        s_rx = NULL;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Low-latency I/O: %lu x %lu frames, %.2f ms nominal round trip",
+             (unsigned long)descs, (unsigned long)frames,
+             1000.0f * descs * frames / audio_rate_get());
+    return ESP_OK;
+}
+
+static void apply_geometry(void)
+{
+    const uint32_t old_frames = s_frames;
+    const uint32_t old_descs = s_descs;
+
+    audio_i2s_delete(s_tx, s_rx, true);
+    esp_err_t err = open_channels(s_req_frames, s_req_descs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Keeping %lu x %lu frames", (unsigned long)old_descs, (unsigned long)old_frames);
+        if (open_channels(old_frames, old_descs) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to restore I2S, audio stopped");
+        }
+    }
+
+    s_req_result = err;
+    __atomic_store_n(&s_req_pending, false, __ATOMIC_SEQ_CST);
+    xSemaphoreGive(s_req_done);
+}
+
+static void DSP_HOT process_block(const dma_event_t *rx, const dma_event_t *tx, uint32_t missed)
+{
+    const int num_samples = (int)s_frames * I2S_NUM_CHANNELS;
+    int32_t *block = (int32_t *)tx->buf;
+
+    // The queue overflow callbacks mean nothing here (this path never uses
+    // the driver queues), so dropouts are the periods this task missed
+    audio_xrun_block_begin();
+    audio_xrun_report(AUDIO_XRUN_TX_UNDERRUN, missed);
+
+    dsp_perf_block_begin(s_frames);
+
+    // The only copy: RX DMA buffer → TX DMA buffer, then the chain in place
+    uint32_t t_copy = dsp_perf_now();
+    memcpy(block, rx->buf, num_samples * sizeof(int32_t));
+    dsp_perf_record(DSP_PERF_I2S_READ, dsp_perf_now() - t_copy);
+
+    // Unpack → Subsonic → Pre-Gain → Equalizer → Limiter → repack
+    dsp_chain_process(block, num_samples);
+
+    dsp_perf_block_end();
+    audio_xrun_block_end(block, num_samples);
+
+    // The TX buffer plays again once the other (descs - 1) buffers have been
+    // sent; its input started to fill one period before on_recv
+    const int64_t done = esp_timer_get_time();
+    const int64_t due = tx->time_us + (int64_t)(s_descs - 1) * s_period_us;
+    const int32_t latency = (int32_t)(due - (rx->time_us - s_period_us));
+    const int32_t slack = (int32_t)(due - done);
+
+    s_latency_us = latency;
+    if (latency < s_latency_min_us) {
+        s_latency_min_us = latency;
+    }
+    if (latency > s_latency_max_us) {
+        s_latency_max_us = latency;
+    }
+    if (slack < s_min_slack_us) {
+        s_min_slack_us = slack;
+    }
+    if (slack < 0) {
+        // The buffer started playing before it was filled
+        s_late++;
+        audio_xrun_report(AUDIO_XRUN_TX_UNDERRUN, 1);
+    }
+    s_blocks++;
+}
+
+static void DSP_HOT lowlat_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Low-latency I/O task started on core %d", xPortGetCoreID());
+
+    s_req_result = open_channels(s_frames, s_descs);
+    xSemaphoreGive(s_req_done);
+    if (s_req_result != ESP_OK) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    esp_task_wdt_add(NULL);
+
+    uint32_t last_rx = 0;
+    uint32_t last_tx = 0;
+    bool resync = true;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOWLAT_IDLE_MS));
+        esp_task_wdt_reset();
+
+        if (__atomic_load_n(&s_req_pending, __ATOMIC_SEQ_CST)) {
+            audio_xrun_suspend();
+            apply_geometry();
+            resync = true;
+            continue;
+        }
+
+        // Sample rate changes reclock the channels in place
+        if (audio_rate_pending()) {
+            audio_xrun_suspend();
+            audio_rate_service(s_tx, s_rx);
+            s_period_us = (int64_t)s_frames * 1000000 / audio_rate_get();
+            clear_stats();
+            resync = true;
+            continue;
+        }
+
+        // 'bench run' measurements replace live blocks while they run; the
+        // DMA keeps playing the auto-cleared buffers meanwhile
+        if (dsp_bench_pending()) {
+            audio_xrun_suspend();
+            dsp_bench_service();
+            resync = true;
+            continue;
+        }
+
+        if (s_stats_reset) {
+            clear_stats();
+            s_stats_reset = false;
+        }
+
+        dma_event_t rx;
+        dma_event_t tx;
+        portENTER_CRITICAL(&s_lock);
+        rx = s_rx_event;
+        tx = s_tx_event;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (resync) {
+            // Start over with the next pair of events
+            last_rx = rx.seq;
+            last_tx = tx.seq;
+            resync = false;
+            continue;
+        }
+
+        // A block needs a new input buffer and a freed output buffer; the two
+        // interrupts of a period arrive in either order
+        const uint32_t new_rx = rx.seq - last_rx;
+        const uint32_t new_tx = tx.seq - last_tx;
+        if (new_rx == 0 || new_tx == 0) {
+            continue;
+        }
+        last_rx = rx.seq;
+        last_tx = tx.seq;
+
+        // Periods skipped entirely played as silence
+        const uint32_t periods = new_rx > new_tx ? new_rx : new_tx;
+        if (periods > 1) {
+            s_missed += periods - 1;
+        }
+
+        process_block(&rx, &tx, periods - 1);
+    }
+}
+
+static void load_settings(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+        }
+        return;
+    }
+
+    uint16_t frames = 0;
+    uint16_t descs = 0;
+    if (nvs_get_u16(nvs_handle, NVS_KEY_FRAMES, &frames) == ESP_OK &&
+        nvs_get_u16(nvs_handle, NVS_KEY_DESCS, &descs) == ESP_OK) {
+        if (frames >= AUDIO_LOWLAT_MIN_FRAMES && frames <= AUDIO_LOWLAT_MAX_FRAMES &&
+            descs >= AUDIO_LOWLAT_MIN_DESCS && descs <= AUDIO_LOWLAT_MAX_DESCS) {
+            s_frames = frames;
+            s_descs = descs;
+            ESP_LOGI(TAG, "Geometry loaded from flash: %u x %u frames", descs, frames);
+        } else {
+            ESP_LOGW(TAG, "Ignoring saved geometry %u x %u frames", descs, frames);
+        }
+    }
+    nvs_close(nvs_handle);
+}
+
+esp_err_t audio_lowlat_start(void)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // The Kconfig range cannot follow AUDIO_BUFFER_SIZE
+    if (s_frames > AUDIO_LOWLAT_MAX_FRAMES) {
+        ESP_LOGW(TAG, "%lu frames per buffer exceeds the chain block, using %d",
+                 (unsigned long)s_frames, AUDIO_LOWLAT_MAX_FRAMES);
+        s_frames = AUDIO_LOWLAT_MAX_FRAMES;
+    }
+    load_settings();
+
+    s_req_lock = xSemaphoreCreateMutex();
+    s_req_done = xSemaphoreCreateBinary();
+    if (s_req_lock == NULL || s_req_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(lowlat_task, "audio_ll", 4096, NULL,
+                                                 configMAX_PRIORITIES - 1, &s_task,
+                                                 AUDIO_LOWLAT_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create low-latency I/O task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The task reports whether the channels came up
+    xSemaphoreTake(s_req_done, portMAX_DELAY);
+    if (s_req_result != ESP_OK) {
+        s_task = NULL;
+    }
+    return s_req_result;
+}
+
+esp_err_t audio_lowlat_set_geometry(uint32_t frames, uint32_t descs)
+{
+    if (frames < AUDIO_LOWLAT_MIN_FRAMES || frames > AUDIO_LOWLAT_MAX_FRAMES ||
+        descs < AUDIO_LOWLAT_MIN_DESCS || descs > AUDIO_LOWLAT_MAX_DESCS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_req_lock, portMAX_DELAY);
+    s_req_frames = frames;
+    s_req_descs = descs;
+    __atomic_store_n(&s_req_pending, true, __ATOMIC_SEQ_CST);
+    xTaskNotifyGive(s_task);
+
+    // The task wakes up at least every LOWLAT_IDLE_MS
+    xSemaphoreTake(s_req_done, portMAX_DELAY);
+    esp_err_t err = s_req_result;
+    xSemaphoreGive(s_req_lock);
+    return err;
+}
+
+void audio_lowlat_get_stats(audio_lowlat_stats_t *stats)
+{
+    const bool measured = (s_blocks > 0);
+
+    stats->running = (s_task != NULL);
+    stats->frames = s_frames;
+    stats->descs = s_descs;
+    stats->nominal_ms = 1000.0f * s_descs * s_frames / audio_rate_get();
+    stats->blocks = s_blocks;
+    stats->missed = s_missed;
+    stats->late = s_late;
+    stats->latency_ms = s_latency_us / 1000.0f;
+    stats->latency_min_ms = measured ? s_latency_min_us / 1000.0f : 0.0f;
+    stats->latency_max_ms = s_latency_max_us / 1000.0f;
+    stats->min_slack_ms = measured ? s_min_slack_us / 1000.0f : 0.0f;
+}
+
+void audio_lowlat_reset_stats(void)
+{
+    s_stats_reset = true;
+}
+
+esp_err_t audio_lowlat_save_settings(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    // Open NVS
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_u16(nvs_handle, NVS_KEY_FRAMES, (uint16_t)s_frames);
+    if (err == ESP_OK) {
+        err = nvs_set_u16(nvs_handle, NVS_KEY_DESCS, (uint16_t)s_descs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving geometry: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    // Commit changes to flash
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error committing to NVS: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Low-latency I/O geometry saved to flash");
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+#else
+
+esp_err_t audio_lowlat_start(void)
+{
+    ESP_LOGE(TAG, "Low-latency I/O not enabled (CONFIG_AUDIO_LOW_LATENCY)");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_lowlat_set_geometry(uint32_t frames, uint32_t descs)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void audio_lowlat_get_stats(audio_lowlat_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void audio_lowlat_reset_stats(void)
+{
+}
+
+esp_err_t audio_lowlat_save_settings(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
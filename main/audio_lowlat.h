@@ -0,0 +1,94 @@
+#ifndef AUDIO_LOWLAT_H
+#define AUDIO_LOWLAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_config.h"
+
+// Low-latency I/O
+// Instead of blocking in i2s_channel_read/write behind a deep DMA queue, the
+// I2S on_recv/on_sent interrupt callbacks hand the task the RX buffer that
+// just filled and the TX buffer that just played. The task copies the input
+// straight into that TX DMA buffer and runs the chain on it in place, so a
+// block is heard (descriptors - 1) blocks after it was freed. Round-trip
+// latency is about descriptors x frames (4 ms at 3 x 64 frames and 48 kHz)
+// instead of the ~80 ms queued by the blocking path. The geometry can be
+// changed at runtime ('io geometry') and is kept in NVS.
+
+#ifdef CONFIG_AUDIO_LOW_LATENCY
+#define AUDIO_LOWLAT_ENABLED    1
+#else
+#define AUDIO_LOWLAT_ENABLED    0
+#endif
+
+// Core of the I/O task; the I2S interrupt is allocated on the same core
+#define AUDIO_LOWLAT_CORE       0
+
+// Geometry limits: one DMA buffer is one chain block, so it must fit the
+// chain's DMA_BUFFER_SIZE work buffers
+#define AUDIO_LOWLAT_MIN_FRAMES 16
+#define AUDIO_LOWLAT_MAX_FRAMES (DMA_BUFFER_SIZE / I2S_NUM_CHANNELS)
+#define AUDIO_LOWLAT_MIN_DESCS  2
+#define AUDIO_LOWLAT_MAX_DESCS  8
+
+typedef struct {
+    bool running;               // Low-latency I/O task started
+    uint32_t frames;            // Stereo frames per DMA buffer (= per block)
+    uint32_t descs;             // DMA buffers per direction
+    float nominal_ms;           // descs x frames at the current sample rate
+    uint32_t blocks;            // Blocks processed since the last geometry change
+    uint32_t missed;            // Blocks lost because the task woke too late
+    uint32_t late;              // Blocks finished after their TX buffer started playing
+    float latency_ms;           // Measured input-to-output latency, last block
+    float latency_min_ms;       // Lowest measured latency
+    float latency_max_ms;       // Highest measured latency
+    float min_slack_ms;         // Least time left before a TX buffer was due
+} audio_lowlat_stats_t;
+
+/**
+ * Create the I2S channels and start the low-latency I/O task
+ *
+ * Replaces init_i2s and audio_task when CONFIG_AUDIO_LOW_LATENCY is set; the
+ * task creates the channels itself so that their interrupt shares its core.
+ * The geometry comes from NVS, or from the Kconfig defaults.
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM if the task could not be created,
+ *         ESP_ERR_NOT_SUPPORTED if the mode is compiled out
+ */
+esp_err_t audio_lowlat_start(void);
+
+/**
+ * Rebuild the I2S channels with a new DMA geometry
+ *
+ * Audio stops for a few milliseconds while the channels are recreated. If
+ * the new geometry cannot be applied the previous one is restored.
+ *
+ * @param frames Stereo frames per DMA buffer (AUDIO_LOWLAT_MIN/MAX_FRAMES)
+ * @param descs DMA buffers per direction (AUDIO_LOWLAT_MIN/MAX_DESCS)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if out of range, ESP_ERR_INVALID_STATE
+ *         if the task is not running, or the driver error
+ */
+esp_err_t audio_lowlat_set_geometry(uint32_t frames, uint32_t descs);
+
+/**
+ * Get geometry and latency statistics
+ *
+ * @param stats Destination (running is false when the mode is not used)
+ */
+void audio_lowlat_get_stats(audio_lowlat_stats_t *stats);
+
+/**
+ * Clear the block counters and latency extremes
+ */
+void audio_lowlat_reset_stats(void);
+
+/**
+ * Save the current geometry to NVS
+ *
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t audio_lowlat_save_settings(void);
+
+#endif // AUDIO_LOWLAT_H
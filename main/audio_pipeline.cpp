@@ -0,0 +1,265 @@
+#include "audio_pipeline.h"
+#include "block_ring.h"
+#include "dsp_chain.h"
+#include "dsp_perf.h"
+#include "dsp_attr.h"
+#include "dsp_bench.h"
+#include "audio_xrun.h"
+#include "audio_config.h"
+#include "audio_rate.h"
+#include "audio_i2s.h"
+#include "crossover.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_task_wdt.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "AUDIO_PIPE";
+
+#if AUDIO_PIPELINE_ENABLED
+
+// Silence queued before the first real block: the same margin as the
+// single-task path, plus one block for every block held in the pipeline
+#define TX_PREFILL_BLOCKS   (4 + AUDIO_PIPELINE_DEPTH - 1)
+
+// One DMA block and what the I/O task measured for the profiler
+typedef struct {
+    int32_t samples[DMA_BUFFER_SIZE] __attribute__((aligned(16)));
+#if CROSSOVER_ENABLED
+    int32_t output[AUDIO_I2S_OUT_SAMPLES] __attribute__((aligned(16)));    // The crossover ways, in the layout of the I2S outputs
+#endif
+    int num_samples;
+    uint32_t read_cycles;       // I2S read wait for this block
+    uint32_t write_cycles;      // Most recent I2S write wait (0 before the first write)
+} audio_block_t;
+
+static audio_block_t s_blocks[AUDIO_PIPELINE_DEPTH];
+static block_ring_t s_to_dsp;   // I/O task → DSP task
+static block_ring_t s_to_io;    // DSP task → I/O task
+
+static i2s_chan_handle_t s_rx = NULL;
+static i2s_chan_handle_t s_tx = NULL;
+static TaskHandle_t s_io_task = NULL;
+static TaskHandle_t s_dsp_task = NULL;
+
+#if CROSSOVER_ENABLED
+extern crossover_t crossover;
+#endif
+
+// Written by the I/O task only
+static volatile uint32_t s_blocks_written = 0;
+static volatile uint32_t s_late = 0;
+static volatile uint32_t s_max_queued = 0;
+
+// Queue silence ahead of the first block (no block may be in flight)
+static void prefill_tx(void)
+{
+#if CROSSOVER_ENABLED
+    int32_t *silence = s_blocks[0].output;
+#else
+    int32_t *silence = s_blocks[0].samples;
+#endif
+    memset(silence, 0, AUDIO_I2S_OUT_SAMPLES * sizeof(int32_t));
+    for (int i = 0; i < TX_PREFILL_BLOCKS; i++) {
+        audio_i2s_write_output(s_tx, silence, DMA_BUFFER_SIZE / I2S_NUM_CHANNELS);
+    }
+}
+
+static void DSP_HOT io_task(void *pvParameters)
+{
+    size_t bytes_read = 0;
+
+    ESP_LOGI(TAG, "I/O task started on core %d", xPortGetCoreID());
+
+    // Clock stabilization, then pre-fill TX with silence (as audio_task does)
+    vTaskDelay(pdMS_TO_TICKS(500));
+    prefill_tx();
+
+    esp_task_wdt_add(NULL);
+
+    // Blocks are processed and written in order, so they are reused round robin
+    int next = 0;
+    int in_flight = 0;
+    uint32_t write_cycles = 0;
+
+    while (1) {
+        // Sample rate changes: the DSP task must be idle while the chain is
+        // reconfigured, so collect (and drop) the blocks still in flight
+        if (audio_rate_pending()) {
+            while (in_flight > 0) {
+                uint8_t done;
+                while (!block_ring_pop(&s_to_io, &done)) {
+                    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                }
+                in_flight--;
+            }
+            write_cycles = 0;
+            audio_xrun_suspend();
+            audio_rate_service(s_tx, s_rx);
+            prefill_tx();
+            esp_task_wdt_reset();
+            continue;
+        }
+
+        audio_block_t *block = &s_blocks[next];
+
+        uint32_t t_read = dsp_perf_now();
+        esp_err_t ret = i2s_channel_read(s_rx, block->samples, sizeof(block->samples),
+                                         &bytes_read, portMAX_DELAY);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "I2S read error: %s", esp_err_to_name(ret));
+            continue;
+        }
+        block->num_samples = bytes_read / sizeof(int32_t);
+        block->read_cycles = dsp_perf_now() - t_read;
+        block->write_cycles = write_cycles;
+
+        // Cannot fail: at most AUDIO_PIPELINE_DEPTH blocks are ever in flight
+        block_ring_push(&s_to_dsp, (uint8_t)next);
+        xTaskNotifyGive(s_dsp_task);
+        next = (next + 1) % AUDIO_PIPELINE_DEPTH;
+        in_flight++;
+
+        uint32_t queued = block_ring_count(&s_to_dsp);
+        if (queued > s_max_queued) {
+            s_max_queued = queued;
+        }
+
+        esp_task_wdt_reset();
+
+        // Still filling the pipeline
+        if (in_flight < AUDIO_PIPELINE_DEPTH) {
+            continue;
+        }
+
+        // Write the oldest block; waiting here means the DSP task used up the
+        // slack of the whole pipeline
+        uint8_t done;
+        if (!block_ring_pop(&s_to_io, &done)) {
+            s_late++;
+            while (!block_ring_pop(&s_to_io, &done)) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+        }
+
+#if CROSSOVER_ENABLED
+        const int32_t *output = s_blocks[done].output;
+#else
+        const int32_t *output = s_blocks[done].samples;
+#endif
+        uint32_t t_write = dsp_perf_now();
+        ret = audio_i2s_write_output(s_tx, output, s_blocks[done].num_samples / I2S_NUM_CHANNELS);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "I2S write error: %s", esp_err_to_name(ret));
+        }
+        write_cycles = dsp_perf_now() - t_write;
+        in_flight--;
+        s_blocks_written++;
+    }
+}
+
+static void DSP_HOT dsp_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "DSP task started on core %d", xPortGetCoreID());
+
+    while (1) {
+        // 'bench run' measurements take the place of live blocks while they run
+        if (dsp_bench_pending()) {
+            audio_xrun_suspend();
+            dsp_bench_service();
+            continue;
+        }
+
+        uint8_t index;
+        if (!block_ring_pop(&s_to_dsp, &index)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        audio_block_t *block = &s_blocks[index];
+
+        // This task is the profiler's only writer; the I/O task's waits
+        // travel with the block
+        audio_xrun_block_begin();
+        dsp_perf_block_begin(block->num_samples / I2S_NUM_CHANNELS);
+        dsp_perf_record(DSP_PERF_I2S_READ, block->read_cycles);
+
+        // Unpack → Subsonic → Pre-Gain → Equalizer → Limiter → repack
+        dsp_chain_process(block->samples, block->num_samples);
+
+        // Dropouts the I/O task's channels reported so far; a fade lands on
+        // this block, up to the pipeline depth after the gap
+        audio_xrun_block_end(block->samples, block->num_samples);
+
+#if CROSSOVER_ENABLED
+        // Split into the output ways (after the fade, which works on stereo)
+        uint32_t t_xover = dsp_perf_now();
+        crossover_process(&crossover, block->samples, block->output, block->num_samples);
+        dsp_perf_record(DSP_PERF_XOVER, dsp_perf_now() - t_xover);
+#endif
+
+        if (block->write_cycles != 0) {
+            dsp_perf_record(DSP_PERF_I2S_WRITE, block->write_cycles);
+        }
+        dsp_perf_block_end();
+
+        block_ring_push(&s_to_io, index);
+        xTaskNotifyGive(s_io_task);
+    }
+}
+
+esp_err_t audio_pipeline_start(i2s_chan_handle_t rx, i2s_chan_handle_t tx)
+{
+    s_rx = rx;
+    s_tx = tx;
+    block_ring_init(&s_to_dsp);
+    block_ring_init(&s_to_io);
+
+    // The DSP task first, so the I/O task always has someone to notify
+    BaseType_t created = xTaskCreatePinnedToCore(dsp_task, "audio_dsp", 4096, NULL,
+                                                 configMAX_PRIORITIES - 1, &s_dsp_task,
+                                                 AUDIO_PIPELINE_DSP_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create DSP task");
+        return ESP_ERR_NO_MEM;
+    }
+    created = xTaskCreatePinnedToCore(io_task, "audio_io", 3072, NULL,
+                                      configMAX_PRIORITIES - 1, &s_io_task,
+                                      AUDIO_PIPELINE_IO_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create I/O task");
+        vTaskDelete(s_dsp_task);
+        s_dsp_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Dual-core pipeline: I/O on core %d, DSP on core %d, depth %d (+%.1f ms latency)",
+             AUDIO_PIPELINE_IO_CORE, AUDIO_PIPELINE_DSP_CORE, AUDIO_PIPELINE_DEPTH,
+             1000.0f * (AUDIO_PIPELINE_DEPTH - 1) * (DMA_BUFFER_SIZE / I2S_NUM_CHANNELS) / audio_rate_get());
+    return ESP_OK;
+}
+
+void audio_pipeline_get_stats(audio_pipeline_stats_t *stats)
+{
+    stats->running = (s_io_task != NULL);
+    stats->depth = AUDIO_PIPELINE_DEPTH;
+    stats->blocks = s_blocks_written;
+    stats->late = s_late;
+    stats->max_queued = s_max_queued;
+}
+
+#else
+
+esp_err_t audio_pipeline_start(i2s_chan_handle_t rx, i2s_chan_handle_t tx)
+{
+    ESP_LOGE(TAG, "Dual-core pipeline not enabled (CONFIG_AUDIO_DUAL_CORE)");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void audio_pipeline_get_stats(audio_pipeline_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->depth = AUDIO_PIPELINE_DEPTH;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef AUDIO_PIPELINE_H
+#define AUDIO_PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "driver/i2s_std.h"
+
+// Two-core audio pipeline
+// An I/O task on core 0 (next to WiFi/MQTT) only moves DMA blocks: it reads
+// a block from I2S, passes it to the DSP task on core 1 through a lock-free
+// ring (block_ring.h) and writes back the oldest processed block. The DSP
+// task runs the whole chain. The chain therefore gets a full core to itself,
+// and network interrupts on core 0 can no longer delay it. In exchange,
+// output latency grows by (depth - 1) blocks.
+
+#ifdef CONFIG_AUDIO_DUAL_CORE
+#define AUDIO_PIPELINE_ENABLED  1
+#define AUDIO_PIPELINE_DEPTH    CONFIG_AUDIO_PIPELINE_DEPTH
+#else
+#define AUDIO_PIPELINE_ENABLED  0
+#define AUDIO_PIPELINE_DEPTH    1
+#endif
+
+// Cores the two stages are pinned to
+#define AUDIO_PIPELINE_IO_CORE  0
+#define AUDIO_PIPELINE_DSP_CORE 1
+
+typedef struct {
+    bool running;               // Pipeline tasks started
+    int depth;                  // Blocks in flight between read and write
+    uint32_t blocks;            // Blocks written since start
+    uint32_t late;              // Writes that had to wait for the DSP task
+    uint32_t max_queued;        // Most blocks waiting for the DSP task at once
+} audio_pipeline_stats_t;
+
+/**
+ * Start the I/O and DSP tasks
+ *
+ * Replaces the single audio_task when CONFIG_AUDIO_DUAL_CORE is set.
+ *
+ * @param rx I2S RX channel (enabled)
+ * @param tx I2S TX channel (enabled)
+ * @return ESP_OK, ESP_ERR_NO_MEM if a task could not be created,
+ *         ESP_ERR_NOT_SUPPORTED if the pipeline is compiled out
+ */
+esp_err_t audio_pipeline_start(i2s_chan_handle_t rx, i2s_chan_handle_t tx);
+
+/**
+ * Get pipeline statistics
+ *
+ * @param stats Destination (running is false when the pipeline is not used)
+ */
+void audio_pipeline_get_stats(audio_pipeline_stats_t *stats);
+
+#endif // AUDIO_PIPELINE_H
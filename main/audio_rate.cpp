@@ -0,0 +1,227 @@
+#include "audio_rate.h"
+#include "audio_config.h"
+#include "audio_i2s.h"
+#include "subsonic.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "dsp_perf.h"
+#include "level_meter.h"
+#include "spectrum.h"
+#include "audio_tap.h"
+#include "audio_xrun.h"
+#include "coeff_bank.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <nvs.h>
+
+static const char *TAG = "AUDIO_RATE";
+
+// NVS storage keys
+#define NVS_NAMESPACE "audio_rate"
+#define NVS_KEY_RATE "rate"
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+extern convolver_t convolver;
+extern crossover_t crossover;
+extern multiband_t multiband;
+extern delay_line_t delay_line;
+
+static const uint32_t s_rates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+
+// Rate change handshake between a control task and the I/O task. The I/O
+// task only reclocks the channels and parks; the control task redesigns the
+// chain meanwhile, holding the coeff_bank writer lock from before the
+// request, so the I/O task never takes it or waits for another writer.
+typedef enum {
+    REQ_IDLE = 0,
+    REQ_REQUESTED,      // Set by the control task
+    REQ_RUNNING,        // Claimed by the I/O task
+} req_state_t;
+
+static volatile uint32_t s_rate = SAMPLE_RATE;
+static volatile int s_req_state = REQ_IDLE;
+static uint32_t s_req_rate = 0;
+static esp_err_t s_req_result = ESP_OK;
+static SemaphoreHandle_t s_req_lock = NULL;
+static SemaphoreHandle_t s_req_done = NULL;
+static SemaphoreHandle_t s_req_resume = NULL;
+
+// Every rate-dependent coefficient and time constant of the chain (pre-gain
+// has none), while the I/O task is parked
+static void redesign(uint32_t old_rate, uint32_t rate)
+{
+    const int64_t start = esp_timer_get_time();
+    subsonic_set_frequency(&subsonic, subsonic_get_frequency(&subsonic), rate);
+    equalizer_set_sample_rate(&equalizer, rate);
+    limiter_set_sample_rate(&limiter, rate);
+    convolver_set_sample_rate(&convolver, rate);
+    crossover_set_sample_rate(&crossover, rate);
+    multiband_set_sample_rate(&multiband, rate);
+    delay_line_set_sample_rate(&delay_line, rate);
+    dsp_perf_set_sample_rate(rate);
+    level_meter_set_sample_rate(rate);
+    spectrum_set_sample_rate(rate);
+    audio_tap_set_sample_rate(rate);
+    audio_xrun_set_sample_rate(rate);
+    s_rate = rate;
+    ESP_LOGI(TAG, "Sample rate %lu -> %lu Hz (chain redesigned in %lu us)", (unsigned long)old_rate,
+             (unsigned long)rate, (unsigned long)(esp_timer_get_time() - start));
+}
+
+void audio_rate_init(void)
+{
+    s_req_lock = xSemaphoreCreateMutex();
+    s_req_done = xSemaphoreCreateBinary();
+    s_req_resume = xSemaphoreCreateBinary();
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+        }
+        return;
+    }
+
+    uint32_t rate = 0;
+    if (nvs_get_u32(nvs_handle, NVS_KEY_RATE, &rate) == ESP_OK) {
+        if (audio_rate_is_supported(rate)) {
+            s_rate = rate;
+            ESP_LOGI(TAG, "Sample rate loaded from flash: %lu Hz", (unsigned long)rate);
+        } else {
+            ESP_LOGW(TAG, "Ignoring saved sample rate %lu Hz", (unsigned long)rate);
+        }
+    }
+    nvs_close(nvs_handle);
+}
+
+uint32_t audio_rate_get(void)
+{
+    return s_rate;
+}
+
+bool audio_rate_is_supported(uint32_t sample_rate)
+{
+    for (size_t i = 0; i < sizeof(s_rates) / sizeof(s_rates[0]); i++) {
+        if (s_rates[i] == sample_rate) {
+            return audio_i2s_rate_supported(sample_rate);
+        }
+    }
+    return false;
+}
+
+esp_err_t audio_rate_set(uint32_t sample_rate)
+{
+    if (!audio_rate_is_supported(sample_rate)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_req_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_req_lock, portMAX_DELAY);
+    if (sample_rate == s_rate) {
+        xSemaphoreGive(s_req_lock);
+        return ESP_OK;
+    }
+
+    // Any other writer finishes first, while audio still runs
+    coeff_bank_lock();
+    const uint32_t old_rate = s_rate;
+    s_req_rate = sample_rate;
+    __atomic_store_n(&s_req_state, REQ_REQUESTED, __ATOMIC_SEQ_CST);
+
+    esp_err_t err;
+    if (xSemaphoreTake(s_req_done, pdMS_TO_TICKS(AUDIO_RATE_TIMEOUT_MS)) == pdTRUE) {
+        err = s_req_result;
+    } else {
+        int expected = REQ_REQUESTED;
+        if (__atomic_compare_exchange_n(&s_req_state, &expected, REQ_IDLE, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            ESP_LOGE(TAG, "Audio I/O task did not apply the sample rate");
+            err = ESP_ERR_TIMEOUT;
+        } else {
+            // Claimed just in time: the reclock is bounded, so wait for it
+            xSemaphoreTake(s_req_done, portMAX_DELAY);
+            err = s_req_result;
+        }
+    }
+
+    // The I/O task is parked after a successful reclock
+    if (err == ESP_OK) {
+        redesign(old_rate, sample_rate);
+        xSemaphoreGive(s_req_resume);
+    }
+    coeff_bank_unlock();
+    xSemaphoreGive(s_req_lock);
+    return err;
+}
+
+bool audio_rate_pending(void)
+{
+    return __atomic_load_n(&s_req_state, __ATOMIC_SEQ_CST) == REQ_REQUESTED;
+}
+
+void audio_rate_service(i2s_chan_handle_t tx, i2s_chan_handle_t rx)
+{
+    int expected = REQ_REQUESTED;
+    if (!__atomic_compare_exchange_n(&s_req_state, &expected, REQ_RUNNING, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    const uint32_t old_rate = s_rate;
+    const uint32_t rate = s_req_rate;
+
+    esp_err_t err = audio_i2s_set_sample_rate(tx, rx, rate);
+    if (err != ESP_OK && audio_i2s_set_sample_rate(tx, rx, old_rate) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore the I2S clock at %lu Hz", (unsigned long)old_rate);
+    }
+
+    s_req_result = err;
+    __atomic_store_n(&s_req_state, REQ_IDLE, __ATOMIC_SEQ_CST);
+    xSemaphoreGive(s_req_done);
+
+    // Parked until the requesting task has redesigned the chain: it already
+    // holds every lock that takes, so the wait is bounded by the redesign
+    if (err == ESP_OK) {
+        xSemaphoreTake(s_req_resume, portMAX_DELAY);
+    }
+}
+
+esp_err_t audio_rate_save_settings(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    // Open NVS
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_u32(nvs_handle, NVS_KEY_RATE, s_rate);
+    if (err == ESP_OK) {
+        // Commit changes to flash
+        err = nvs_commit(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving sample rate: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Sample rate saved to flash");
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
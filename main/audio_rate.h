@@ -0,0 +1,85 @@
+#ifndef AUDIO_RATE_H
+#define AUDIO_RATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2s_std.h"
+
+// Runtime sample rate
+// SAMPLE_RATE (audio_config.h) is only the default; the rate the chain runs
+// at can be switched between 44.1 and 192 kHz without a reboot. A control
+// task posts the new rate, and the task that owns the I2S channels
+// (audio_task, audio_io with the dual-core pipeline, audio_ll with
+// low-latency I/O) picks it up between two blocks: it stops both channels,
+// reclocks them and parks, while the requesting task recomputes every
+// filter and time constant of the chain at the new rate, then starts again.
+// The I/O task never takes the coeff_bank writer lock: the requesting task
+// holds it from before the request. Audio drops out for a few milliseconds.
+
+// Give up if the I/O task does not pick up a change within this time
+#define AUDIO_RATE_TIMEOUT_MS       2000
+
+/**
+ * Load the saved rate (at boot, before the I2S channels and the modules
+ * are created)
+ */
+void audio_rate_init(void);
+
+/**
+ * Get the current sample rate
+ *
+ * @return Rate in Hz
+ */
+uint32_t audio_rate_get(void);
+
+/**
+ * Check whether a rate is supported
+ *
+ * @param sample_rate Rate in Hz
+ * @return true for 44100, 48000, 88200, 96000, 176400 and 192000, as far as
+ *         the I2S outputs can be clocked at them (see audio_i2s_rate_supported)
+ */
+bool audio_rate_is_supported(uint32_t sample_rate);
+
+/**
+ * Switch the audio path to a new sample rate (control tasks only)
+ *
+ * Blocks until the I/O task has reclocked the channels and the chain has
+ * been redesigned (in the calling task). Not from inside a coeff_bank
+ * group: the redesign publishes on its own.
+ *
+ * @param sample_rate Rate in Hz
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the rate is not supported,
+ *         ESP_ERR_TIMEOUT if no I/O task is running, or the driver error
+ *         (the previous rate is kept)
+ */
+esp_err_t audio_rate_set(uint32_t sample_rate);
+
+/**
+ * Check for a pending rate change (I/O task only, once per block)
+ *
+ * @return true if audio_rate_service should be called before the next block
+ */
+bool audio_rate_pending(void);
+
+/**
+ * Apply the pending rate change (I/O task only)
+ *
+ * Reclocks the channels and, if that worked, waits for the requesting task
+ * to redesign the chain. No block may be in flight: the chain modules
+ * change while it waits.
+ *
+ * @param tx TX channel handle (enabled)
+ * @param rx RX channel handle (enabled)
+ */
+void audio_rate_service(i2s_chan_handle_t tx, i2s_chan_handle_t rx);
+
+/**
+ * Save the current rate to NVS
+ *
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t audio_rate_save_settings(void);
+
+#endif // AUDIO_RATE_H
@@ -0,0 +1,690 @@
+#include "audio_tap.h"
+#include "audio_config.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+static const char *s_point_names[AUDIO_TAP_POINT_COUNT] = { "post", "prelimiter" };
+static const char *s_format_names[AUDIO_TAP_FORMAT_COUNT] = { "L24", "L16" };
+
+#if AUDIO_TAP_ENABLED
+#include "wifi_manager.h"
+#include "lwip/sockets.h"
+#include "esp_random.h"
+#include "nvs.h"
+
+static const char *TAG = "AUDIO_TAP";
+
+static_assert((AUDIO_TAP_RING_BLOCKS & (AUDIO_TAP_RING_BLOCKS - 1)) == 0 && AUDIO_TAP_RING_BLOCKS >= 2,
+              "CONFIG_AUDIO_TAP_RING_BLOCKS must be a power of two");
+
+#define NVS_NAMESPACE       "audio_tap"
+#define NVS_KEY_SETTINGS    "settings"
+
+// How often the network task empties the ring (a block is 5 ms at the default size)
+#define POLL_MS             2
+
+// Wait before opening the socket again after a failure
+#define RETRY_MS            1000
+
+// Core that runs the chain; the network task takes the other one
+#if AUDIO_PIPELINE_ENABLED
+#define CHAIN_CORE          AUDIO_PIPELINE_DSP_CORE
+#elif AUDIO_LOWLAT_ENABLED
+#define CHAIN_CORE          AUDIO_LOWLAT_CORE
+#else
+#define CHAIN_CORE          0                       // audio_task
+#endif
+#ifdef CONFIG_FREERTOS_UNICORE
+#define TAP_CORE            0
+#else
+#define TAP_CORE            (1 - CHAIN_CORE)
+#endif
+
+// Decimation low-pass: 8th-order Butterworth at 0.4 times the stream rate
+#define FILTER_SECTIONS     4
+#define CUTOFF_RATIO        0.4f
+
+#define RTP_HEADER_SIZE     12
+#define RTP_VERSION         0x80
+#define RTP_MARKER          0x80
+
+// DSCP EF (expedited forwarding): the WiFi voice access category
+#define TOS_EF              0xB8
+
+#define SAMPLE_MAX          8388607
+#define SAMPLE_MIN          -8388608
+
+// How the samples of a slot are stored
+typedef enum {
+    WORDS_I2S = 0,                          // Left-justified 32-bit words (post)
+    WORDS_24,                               // 24-bit right-justified, may exceed 24 bits (staged chain)
+    WORDS_F32,                              // Float at 24-bit scale (float chain)
+} words_t;
+
+typedef struct {
+    int32_t samples[DMA_BUFFER_SIZE];       // Floats for WORDS_F32
+    uint32_t frame;                         // Index of the first frame (dropped blocks count too)
+    uint32_t rate;                          // Sample rate of the block
+    uint16_t num_samples;
+    uint8_t words;                          // words_t
+} slot_t;
+
+typedef struct {
+    float b0, b1, b2, a1, a2;
+} section_t;
+
+// Block ring: the audio task produces, the network task consumes; head and
+// tail are free-running and each written by one side only (as block_ring.h)
+static slot_t s_ring[AUDIO_TAP_RING_BLOCKS];
+static volatile uint32_t s_head = 0;
+static volatile uint32_t s_tail = 0;
+
+// Feed state (audio task)
+static uint32_t s_frame = 0;
+static uint32_t s_rate = SAMPLE_RATE;
+static volatile uint32_t s_blocks = 0;
+static volatile uint32_t s_dropped_blocks = 0;
+
+// Point being streamed, -1 while not streaming (network task writes it)
+static volatile int s_live_point = -1;
+
+// Settings (control tasks, under s_lock); the network task takes a copy
+// whenever s_generation changes
+static audio_tap_settings_t s_settings = {
+    false, 0, AUDIO_TAP_DEFAULT_PORT, AUDIO_TAP_POST, AUDIO_TAP_L24, 1,
+};
+static volatile uint32_t s_generation = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+// Stream (network task)
+static audio_tap_settings_t s_stream;       // Settings being streamed
+static uint32_t s_configured = 0;           // s_generation of s_stream
+static int s_socket = -1;
+static struct sockaddr_in s_dest;
+static TickType_t s_retry_at = 0;
+static uint32_t s_source_rate = 0;          // Rate the filter is designed for (0 = new stream)
+static uint32_t s_next_frame = 0;           // Frame expected in the next slot
+static uint32_t s_phase = 0;                // Input frames since the last output frame
+static section_t s_sections[FILTER_SECTIONS];
+static float s_z[2][FILTER_SECTIONS][2];    // Transposed direct form II state per channel
+static uint32_t s_out_frame = 0;            // Stream frames so far (RTP clock)
+static uint8_t s_packet[RTP_HEADER_SIZE + AUDIO_TAP_MAX_PAYLOAD];
+static int s_bytes_per_frame = 6;
+static int s_frames_per_packet = AUDIO_TAP_MAX_PAYLOAD / 6;
+static int s_packet_frames = 0;
+static uint32_t s_packet_timestamp = 0;
+static uint16_t s_seq = 0;
+static bool s_marker = true;
+static uint32_t s_ssrc = 0;
+static uint32_t s_payload_bytes = 0;        // Below 1 KiB, carried into s_kbytes
+
+static volatile bool s_streaming = false;
+static volatile uint32_t s_stream_rate = 0;
+static volatile uint32_t s_packets = 0;
+static volatile uint32_t s_dropped_packets = 0;
+static volatile uint32_t s_kbytes = 0;
+
+static TaskHandle_t s_task = NULL;
+
+static bool decimation_valid(uint32_t decimation)
+{
+    return decimation >= 1 && decimation <= AUDIO_TAP_MAX_DECIMATION && decimation != 5;
+}
+
+static bool is_multicast(uint32_t addr)
+{
+    return (addr >> 28) == 0xE;
+}
+
+/* Audio task */
+
+static DSP_HOT_INLINE void push(const void *samples, int num_samples, uint8_t words)
+{
+    if (num_samples > DMA_BUFFER_SIZE) {
+        num_samples = DMA_BUFFER_SIZE;
+    }
+    const uint32_t frame = s_frame;
+    s_frame = frame + (uint32_t)num_samples / 2;
+
+    const uint32_t head = s_head;
+    if (head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE) >= AUDIO_TAP_RING_BLOCKS) {
+        // Network task behind: never wait, lose the block
+        s_dropped_blocks++;
+        return;
+    }
+    slot_t *slot = &s_ring[head % AUDIO_TAP_RING_BLOCKS];
+    memcpy(slot->samples, samples, (size_t)num_samples * sizeof(int32_t));
+    slot->frame = frame;
+    slot->rate = s_rate;
+    slot->num_samples = (uint16_t)num_samples;
+    slot->words = words;
+    // The slot must be visible before the consumer sees the new head
+    __atomic_store_n(&s_head, head + 1, __ATOMIC_RELEASE);
+    s_blocks++;
+}
+
+void DSP_HOT audio_tap_feed(const int32_t *buffer, int num_samples)
+{
+    if (s_live_point != AUDIO_TAP_POST) {
+        return;
+    }
+    push(buffer, num_samples, WORDS_I2S);
+}
+
+void DSP_HOT audio_tap_feed_pre_limiter(const int32_t *samples, int num_samples)
+{
+    if (s_live_point != AUDIO_TAP_PRE_LIMITER) {
+        return;
+    }
+    push(samples, num_samples, WORDS_24);
+}
+
+void DSP_HOT audio_tap_feed_pre_limiter_f32(const float *block, int num_samples)
+{
+    static_assert(sizeof(float) == sizeof(int32_t), "slots hold floats in place of words");
+    if (s_live_point != AUDIO_TAP_PRE_LIMITER) {
+        return;
+    }
+    push(block, num_samples, WORDS_F32);
+}
+
+bool DSP_HOT audio_tap_pre_limiter_active(void)
+{
+    return s_live_point == AUDIO_TAP_PRE_LIMITER;
+}
+
+void audio_tap_set_sample_rate(uint32_t sample_rate)
+{
+    // Slots carry their rate, so the network task sees the change in order
+    s_rate = sample_rate;
+}
+
+/* Network task */
+
+// RBJ low-pass sections of a Butterworth filter, Q of each pole pair
+static void design_filter(uint32_t source_rate, uint32_t decimation)
+{
+    const float w0 = 2.0f * (float)M_PI * CUTOFF_RATIO / (float)decimation;
+    const float cos_w0 = cosf(w0);
+    const float sin_w0 = sinf(w0);
+    for (int k = 0; k < FILTER_SECTIONS; k++) {
+        const float q = 1.0f / (2.0f * cosf((float)M_PI * (2 * k + 1) / (4 * FILTER_SECTIONS)));
+        const float alpha = sin_w0 / (2.0f * q);
+        const float a0 = 1.0f + alpha;
+        section_t *s = &s_sections[k];
+        s->b0 = (1.0f - cos_w0) / 2.0f / a0;
+        s->b1 = (1.0f - cos_w0) / a0;
+        s->b2 = s->b0;
+        s->a1 = -2.0f * cos_w0 / a0;
+        s->a2 = (1.0f - alpha) / a0;
+    }
+    memset(s_z, 0, sizeof(s_z));
+    (void)source_rate;
+}
+
+static inline float filter(int channel, float x)
+{
+    for (int k = 0; k < FILTER_SECTIONS; k++) {
+        const section_t *s = &s_sections[k];
+        float *z = s_z[channel][k];
+        const float y = s->b0 * x + z[0];
+        z[0] = s->b1 * x - s->a1 * y + z[1];
+        z[1] = s->b2 * x - s->a2 * y;
+        x = y;
+    }
+    return x;
+}
+
+static int32_t saturate(int32_t v)
+{
+    return v > SAMPLE_MAX ? SAMPLE_MAX : (v < SAMPLE_MIN ? SAMPLE_MIN : v);
+}
+
+static int32_t round_float(float v)
+{
+    if (v > (float)SAMPLE_MAX) {
+        return SAMPLE_MAX;
+    }
+    if (v < (float)SAMPLE_MIN) {
+        return SAMPLE_MIN;
+    }
+    return (int32_t)lrintf(v);
+}
+
+static void send_packet(void)
+{
+    uint8_t *h = s_packet;
+    h[0] = RTP_VERSION;
+    h[1] = (uint8_t)((s_marker ? RTP_MARKER : 0) |
+                     (s_stream.format == AUDIO_TAP_L16 ? AUDIO_TAP_PT_L16 : AUDIO_TAP_PT_L24));
+    h[2] = (uint8_t)(s_seq >> 8);
+    h[3] = (uint8_t)s_seq;
+    h[4] = (uint8_t)(s_packet_timestamp >> 24);
+    h[5] = (uint8_t)(s_packet_timestamp >> 16);
+    h[6] = (uint8_t)(s_packet_timestamp >> 8);
+    h[7] = (uint8_t)s_packet_timestamp;
+    h[8] = (uint8_t)(s_ssrc >> 24);
+    h[9] = (uint8_t)(s_ssrc >> 16);
+    h[10] = (uint8_t)(s_ssrc >> 8);
+    h[11] = (uint8_t)s_ssrc;
+
+    // Never block: a packet the stack cannot take now is lost (the sequence
+    // number still advances, so the receiver sees the loss)
+    const size_t payload = (size_t)s_packet_frames * s_bytes_per_frame;
+    const int sent = sendto(s_socket, s_packet, RTP_HEADER_SIZE + payload, MSG_DONTWAIT,
+                            (const struct sockaddr *)&s_dest, sizeof(s_dest));
+    if (sent < 0) {
+        s_dropped_packets++;
+    } else {
+        s_packets++;
+        s_payload_bytes += payload;
+        s_kbytes += s_payload_bytes / 1024;
+        s_payload_bytes %= 1024;
+    }
+    s_seq++;
+    s_marker = false;
+    s_packet_frames = 0;
+}
+
+static void flush_packet(void)
+{
+    if (s_packet_frames > 0) {
+        send_packet();
+    }
+}
+
+static void put_frame(int32_t l, int32_t r)
+{
+    if (s_packet_frames == 0) {
+        s_packet_timestamp = s_out_frame;
+    }
+    uint8_t *p = s_packet + RTP_HEADER_SIZE + s_packet_frames * s_bytes_per_frame;
+    if (s_stream.format == AUDIO_TAP_L16) {
+        // Round to 16 bits
+        l = (saturate(l) + 128) >> 8;
+        r = (saturate(r) + 128) >> 8;
+        l = l > 32767 ? 32767 : l;
+        r = r > 32767 ? 32767 : r;
+        p[0] = (uint8_t)(l >> 8);
+        p[1] = (uint8_t)l;
+        p[2] = (uint8_t)(r >> 8);
+        p[3] = (uint8_t)r;
+    } else {
+        l = saturate(l);
+        r = saturate(r);
+        p[0] = (uint8_t)(l >> 16);
+        p[1] = (uint8_t)(l >> 8);
+        p[2] = (uint8_t)l;
+        p[3] = (uint8_t)(r >> 16);
+        p[4] = (uint8_t)(r >> 8);
+        p[5] = (uint8_t)r;
+    }
+    s_out_frame++;
+    if (++s_packet_frames == s_frames_per_packet) {
+        send_packet();
+    }
+}
+
+static void stream_slot(const slot_t *slot)
+{
+    const uint32_t decimation = s_stream.decimation;
+    const int frames = slot->num_samples / 2;
+
+    if (slot->rate != s_source_rate) {
+        // New stream or new rate: the RTP clock changes, start a talkspurt
+        flush_packet();
+        design_filter(slot->rate, decimation);
+        s_source_rate = slot->rate;
+        s_stream_rate = slot->rate / decimation;
+        s_phase = 0;
+        s_marker = true;
+    } else if (slot->frame != s_next_frame) {
+        // Blocks the ring had no room for: skip their time in the stream
+        flush_packet();
+        s_out_frame += (slot->frame - s_next_frame + s_phase) / decimation;
+        s_phase = 0;
+        s_marker = true;
+    }
+    s_next_frame = slot->frame + (uint32_t)frames;
+
+    const int32_t *w = slot->samples;
+    const float *f = (const float *)slot->samples;
+    for (int i = 0; i < frames; i++) {
+        if (decimation == 1) {
+            if (slot->words == WORDS_F32) {
+                put_frame(round_float(f[2 * i]), round_float(f[2 * i + 1]));
+            } else if (slot->words == WORDS_I2S) {
+                put_frame(w[2 * i] >> 8, w[2 * i + 1] >> 8);
+            } else {
+                put_frame(w[2 * i], w[2 * i + 1]);
+            }
+            continue;
+        }
+
+        float l, r;
+        if (slot->words == WORDS_F32) {
+            l = f[2 * i];
+            r = f[2 * i + 1];
+        } else if (slot->words == WORDS_I2S) {
+            l = (float)(w[2 * i] >> 8);
+            r = (float)(w[2 * i + 1] >> 8);
+        } else {
+            l = (float)saturate(w[2 * i]);
+            r = (float)saturate(w[2 * i + 1]);
+        }
+        l = filter(0, l);
+        r = filter(1, r);
+        if (++s_phase == decimation) {
+            s_phase = 0;
+            put_frame(round_float(l), round_float(r));
+        }
+    }
+}
+
+static void stop_stream(void)
+{
+    s_live_point = -1;
+    s_streaming = false;
+    if (s_socket >= 0) {
+        flush_packet();
+        close(s_socket);
+        s_socket = -1;
+        ESP_LOGI(TAG, "Stream stopped");
+    }
+}
+
+static void start_stream(void)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        s_retry_at = xTaskGetTickCount() + pdMS_TO_TICKS(RETRY_MS);
+        return;
+    }
+    int tos = TOS_EF;
+    setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    if (is_multicast(s_stream.host)) {
+        uint8_t ttl = 1;                    // Stay on the local network
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons(s_stream.port);
+    s_dest.sin_addr.s_addr = htonl(s_stream.host);
+    s_socket = sock;
+
+    s_bytes_per_frame = (s_stream.format == AUDIO_TAP_L16) ? 4 : 6;
+    s_frames_per_packet = AUDIO_TAP_MAX_PAYLOAD / s_bytes_per_frame;
+    s_packet_frames = 0;
+    s_source_rate = 0;
+    s_stream_rate = s_rate / s_stream.decimation;
+
+    // Drop what was queued for an earlier stream before the audio task starts copying
+    __atomic_store_n(&s_tail, __atomic_load_n(&s_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    s_live_point = s_stream.point;
+    s_streaming = true;
+
+    char host[16];
+    audio_tap_format_host(s_stream.host, host);
+    ESP_LOGI(TAG, "Streaming %s %s/%lu to %s:%u (SSRC %08lx)", s_point_names[s_stream.point],
+             s_format_names[s_stream.format], (unsigned long)s_stream_rate, host,
+             (unsigned)s_stream.port, (unsigned long)s_ssrc);
+}
+
+static void tap_task(void *pvParameters)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+
+        const uint32_t gen = __atomic_load_n(&s_generation, __ATOMIC_SEQ_CST);
+        if (gen != s_configured) {
+            s_configured = gen;
+            stop_stream();
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stream = s_settings;
+            xSemaphoreGive(s_lock);
+        }
+
+        const bool wanted = s_stream.enabled && s_stream.host != 0 && wifi_manager_is_connected();
+        if (!wanted && s_socket >= 0) {
+            stop_stream();
+        } else if (wanted && s_socket < 0 &&
+                   (int32_t)(xTaskGetTickCount() - s_retry_at) >= 0) {
+            start_stream();
+        }
+
+        while (__atomic_load_n(&s_head, __ATOMIC_ACQUIRE) != s_tail) {
+            const uint32_t tail = s_tail;
+            if (s_socket >= 0) {
+                stream_slot(&s_ring[tail % AUDIO_TAP_RING_BLOCKS]);
+            }
+            __atomic_store_n(&s_tail, tail + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+esp_err_t audio_tap_init(uint32_t sample_rate)
+{
+    s_rate = sample_rate;
+    s_ssrc = esp_random();
+    s_seq = (uint16_t)esp_random();
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        audio_tap_settings_t saved;
+        size_t size = sizeof(saved);
+        if (nvs_get_blob(nvs_handle, NVS_KEY_SETTINGS, &saved, &size) == ESP_OK &&
+            size == sizeof(saved) && saved.port != 0 && saved.point < AUDIO_TAP_POINT_COUNT &&
+            saved.format < AUDIO_TAP_FORMAT_COUNT && decimation_valid(saved.decimation)) {
+            s_settings = saved;
+        }
+        nvs_close(nvs_handle);
+    }
+    s_stream = s_settings;
+
+    BaseType_t created = xTaskCreatePinnedToCore(tap_task, "audio_tap", 4096, NULL,
+                                                 tskIDLE_PRIORITY + 2, &s_task, TAP_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create tap task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    char host[16];
+    audio_tap_format_host(s_settings.host, host);
+    ESP_LOGI(TAG, "Audio tap: %d block ring on core %d, %s (%s:%u)", AUDIO_TAP_RING_BLOCKS, TAP_CORE,
+             s_settings.enabled ? "streaming when WiFi is up" : "off", host, (unsigned)s_settings.port);
+    return ESP_OK;
+}
+
+void audio_tap_get_settings(audio_tap_settings_t *settings)
+{
+    if (s_lock == NULL) {
+        *settings = s_settings;
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *settings = s_settings;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t audio_tap_apply_settings(const audio_tap_settings_t *settings)
+{
+    if (settings->port == 0 || settings->point >= AUDIO_TAP_POINT_COUNT ||
+        settings->format >= AUDIO_TAP_FORMAT_COUNT || !decimation_valid(settings->decimation)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool changed = memcmp(&s_settings, settings, sizeof(*settings)) != 0;
+    s_settings = *settings;
+    xSemaphoreGive(s_lock);
+    if (changed) {
+        __atomic_fetch_add(&s_generation, 1, __ATOMIC_SEQ_CST);
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_tap_save_settings(void)
+{
+    audio_tap_settings_t settings;
+    audio_tap_get_settings(&settings);
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, NVS_KEY_SETTINGS, &settings, sizeof(settings));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Tap settings saved to NVS");
+    } else {
+        ESP_LOGE(TAG, "Failed to save tap settings: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void audio_tap_get_stats(audio_tap_stats_t *stats)
+{
+    stats->streaming = s_streaming;
+    stats->stream_rate = s_stream_rate;
+    stats->blocks = s_blocks;
+    stats->dropped_blocks = s_dropped_blocks;
+    stats->packets = s_packets;
+    stats->dropped_packets = s_dropped_packets;
+    stats->kbytes = s_kbytes;
+}
+
+esp_err_t audio_tap_get_sdp(char *buf, size_t size)
+{
+    audio_tap_settings_t settings;
+    audio_tap_get_settings(&settings);
+
+    char origin[16] = "0.0.0.0";
+    wifi_manager_get_ip(origin);
+    char host[16];
+    audio_tap_format_host(settings.host, host);
+    const int pt = (settings.format == AUDIO_TAP_L16) ? AUDIO_TAP_PT_L16 : AUDIO_TAP_PT_L24;
+
+    const int len = snprintf(buf, size,
+                             "v=0\r\n"
+                             "o=- %lu %lu IN IP4 %s\r\n"
+                             "s=ESP-DSP audio tap (%s)\r\n"
+                             "c=IN IP4 %s%s\r\n"
+                             "t=0 0\r\n"
+                             "m=audio %u RTP/AVP %d\r\n"
+                             "a=rtpmap:%d %s/%lu/2\r\n",
+                             (unsigned long)s_ssrc, (unsigned long)s_generation, origin,
+                             s_point_names[settings.point], host,
+                             is_multicast(settings.host) ? "/1" : "",
+                             (unsigned)settings.port, pt,
+                             pt, s_format_names[settings.format],
+                             (unsigned long)(s_rate / settings.decimation));
+    return (len > 0 && (size_t)len < size) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+#else
+
+esp_err_t audio_tap_init(uint32_t sample_rate)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void audio_tap_get_settings(audio_tap_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->port = AUDIO_TAP_DEFAULT_PORT;
+    settings->decimation = 1;
+}
+
+esp_err_t audio_tap_apply_settings(const audio_tap_settings_t *settings)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_tap_save_settings(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void audio_tap_get_stats(audio_tap_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+esp_err_t audio_tap_get_sdp(char *buf, size_t size)
+{
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+bool audio_tap_parse_host(const char *s, size_t len, uint32_t *addr)
+{
+    uint32_t value = 0;
+    int parts = 0;
+    size_t i = 0;
+    while (parts < 4) {
+        uint32_t octet = 0;
+        size_t digits = 0;
+        while (i < len && s[i] >= '0' && s[i] <= '9' && digits < 3) {
+            octet = octet * 10 + (uint32_t)(s[i] - '0');
+            i++;
+            digits++;
+        }
+        if (digits == 0 || octet > 255) {
+            return false;
+        }
+        value = (value << 8) | octet;
+        parts++;
+        if (parts < 4) {
+            if (i >= len || s[i] != '.') {
+                return false;
+            }
+            i++;
+        }
+    }
+    if (i != len) {
+        return false;
+    }
+    *addr = value;
+    return true;
+}
+
+void audio_tap_format_host(uint32_t addr, char *buf)
+{
+    snprintf(buf, 16, "%u.%u.%u.%u", (unsigned)(addr >> 24), (unsigned)((addr >> 16) & 0xFF),
+             (unsigned)((addr >> 8) & 0xFF), (unsigned)(addr & 0xFF));
+}
+
+const char *audio_tap_point_name(audio_tap_point_t point)
+{
+    return (point >= 0 && point < AUDIO_TAP_POINT_COUNT) ? s_point_names[point] : "unknown";
+}
+
+const char *audio_tap_format_name(audio_tap_format_t format)
+{
+    return (format >= 0 && format < AUDIO_TAP_FORMAT_COUNT) ? s_format_names[format] : "unknown";
+}
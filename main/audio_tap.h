@@ -0,0 +1,226 @@
+#ifndef AUDIO_TAP_H
+#define AUDIO_TAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "dsp_attr.h"
+
+// Network audio tap (remote listen-in)
+// Streams the audio of the chain as RTP over UDP to one host (or multicast
+// group), for checking what a system plays from a laptop running VLC,
+// ffplay or GStreamer. The audio task copies each block, as it is at the tap
+// point, into the next free slot of a static ring: one memcpy, no waiting,
+// no allocation, and the block is dropped if the ring is full. A
+// low-priority task on the other core empties the ring, decimates (8th-order
+// Butterworth low-pass, in float) and packs the frames into RTP packets
+// (L24 or L16, big-endian, RFC 3190 / RFC 3551), which it sends without
+// blocking: if the network cannot keep up, packets are dropped, never audio.
+// Dropped blocks show as a timestamp jump in the stream and the receiver
+// plays silence for them.
+//
+// Tap points:
+//   post         The block leaving the chain (after limiter and output
+//                delay, ahead of the crossover): what the level meter shows
+//   prelimiter   The block as the limiter gets it, before any gain
+//                reduction (saturated to 24 bits in the stream). The fused
+//                chain has no block boundary there, so while this tap runs
+//                the chain is processed staged (bit-identical, slower)
+//
+// Receivers need the session description (audio_tap_get_sdp), which
+// changes with the format, the decimation and the sample rate.
+
+#ifdef CONFIG_AUDIO_TAP
+#define AUDIO_TAP_ENABLED       1
+#define AUDIO_TAP_RING_BLOCKS   CONFIG_AUDIO_TAP_RING_BLOCKS
+#define AUDIO_TAP_DEFAULT_PORT  CONFIG_AUDIO_TAP_PORT
+#else
+#define AUDIO_TAP_ENABLED       0
+#define AUDIO_TAP_RING_BLOCKS   0
+#define AUDIO_TAP_DEFAULT_PORT  5004
+#endif
+
+// Largest decimation factor; 1, 2, 3, 4 and 6 divide every supported rate,
+// so the stream clock is always a whole number of Hz
+#define AUDIO_TAP_MAX_DECIMATION    6
+
+// RTP payload bytes per packet (fits one WiFi frame with the headers)
+#define AUDIO_TAP_MAX_PAYLOAD       1200
+
+// Dynamic RTP payload types (described by the SDP)
+#define AUDIO_TAP_PT_L24            96
+#define AUDIO_TAP_PT_L16            97
+
+typedef enum {
+    AUDIO_TAP_POST = 0,                     // Chain output
+    AUDIO_TAP_PRE_LIMITER,                  // Limiter input
+    AUDIO_TAP_POINT_COUNT
+} audio_tap_point_t;
+
+typedef enum {
+    AUDIO_TAP_L24 = 0,                      // 24-bit linear PCM
+    AUDIO_TAP_L16,                          // 16-bit linear PCM (2/3 of the bandwidth)
+    AUDIO_TAP_FORMAT_COUNT
+} audio_tap_format_t;
+
+typedef struct {
+    bool enabled;
+    uint32_t host;                          // IPv4 address, host byte order (a.b.c.d = a << 24 | ...)
+    uint16_t port;                          // UDP port (even, RTP convention)
+    uint8_t point;                          // audio_tap_point_t
+    uint8_t format;                         // audio_tap_format_t
+    uint8_t decimation;                     // 1, 2, 3, 4 or 6
+} audio_tap_settings_t;
+
+typedef struct {
+    bool streaming;                         // Enabled, WiFi up and the socket open
+    uint32_t stream_rate;                   // RTP clock (sample rate / decimation) in Hz
+    uint32_t blocks;                        // Blocks taken from the audio task
+    uint32_t dropped_blocks;                // Blocks lost because the ring was full
+    uint32_t packets;                       // Packets sent
+    uint32_t dropped_packets;               // Packets the network stack did not take
+    uint32_t kbytes;                        // UDP payload sent, in KiB
+} audio_tap_stats_t;
+
+/**
+ * Load the saved settings and start the network task (before the audio
+ * task starts)
+ *
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK, ESP_ERR_NO_MEM if the task could not be created, or
+ *         ESP_ERR_NOT_SUPPORTED without AUDIO_TAP
+ */
+esp_err_t audio_tap_init(uint32_t sample_rate);
+
+#if AUDIO_TAP_ENABLED
+
+/**
+ * Copy one block leaving the chain into the tap ring (audio task only)
+ *
+ * @param buffer Left-justified 32-bit I2S words (interleaved stereo)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void audio_tap_feed(const int32_t *buffer, int num_samples);
+
+/**
+ * Copy the limiter input into the tap ring (audio task, staged chain)
+ *
+ * @param samples 24-bit right-justified samples (interleaved stereo)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void audio_tap_feed_pre_limiter(const int32_t *samples, int num_samples);
+
+/**
+ * Copy the limiter input into the tap ring (audio task, float chain)
+ *
+ * @param block Float samples at 24-bit scale (interleaved stereo)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void audio_tap_feed_pre_limiter_f32(const float *block, int num_samples);
+
+/**
+ * Check whether the limiter input is being streamed (audio task, once per
+ * block: the fused chain is run staged while it is)
+ *
+ * @return true if the pre-limiter tap is streaming
+ */
+bool audio_tap_pre_limiter_active(void);
+
+/**
+ * Switch the tap to a new rate
+ *
+ * Only while no block is being processed (audio_rate_set, with the I/O task parked).
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void audio_tap_set_sample_rate(uint32_t sample_rate);
+
+#else
+
+static inline void audio_tap_feed(const int32_t *buffer, int num_samples) { (void)buffer; (void)num_samples; }
+static inline void audio_tap_feed_pre_limiter(const int32_t *samples, int num_samples) { (void)samples; (void)num_samples; }
+static inline void audio_tap_feed_pre_limiter_f32(const float *block, int num_samples) { (void)block; (void)num_samples; }
+static inline bool audio_tap_pre_limiter_active(void) { return false; }
+static inline void audio_tap_set_sample_rate(uint32_t sample_rate) { (void)sample_rate; }
+
+#endif
+
+/**
+ * Get the tap settings
+ *
+ * @param settings Destination
+ */
+void audio_tap_get_settings(audio_tap_settings_t *settings);
+
+/**
+ * Apply new tap settings (any control task; the network task picks them up
+ * within a few milliseconds)
+ *
+ * @param settings New settings
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an invalid port, point, format or
+ *         decimation, or ESP_ERR_NOT_SUPPORTED without AUDIO_TAP
+ */
+esp_err_t audio_tap_apply_settings(const audio_tap_settings_t *settings);
+
+/**
+ * Save the tap settings to NVS (restored at boot, streaming included)
+ *
+ * @return ESP_OK, the NVS error, or ESP_ERR_NOT_SUPPORTED without AUDIO_TAP
+ */
+esp_err_t audio_tap_save_settings(void);
+
+/**
+ * Get the stream counters
+ *
+ * @param stats Destination
+ */
+void audio_tap_get_stats(audio_tap_stats_t *stats);
+
+/**
+ * Write the SDP session description of the current stream, for receivers
+ * (e.g. saved as tap.sdp: ffplay -protocol_whitelist file,udp,rtp tap.sdp)
+ *
+ * @param buf Destination
+ * @param size Size of buf
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if buf is too small, or
+ *         ESP_ERR_NOT_SUPPORTED without AUDIO_TAP
+ */
+esp_err_t audio_tap_get_sdp(char *buf, size_t size);
+
+/**
+ * Parse a dotted IPv4 address
+ *
+ * @param s Text (not necessarily NUL-terminated)
+ * @param len Length of s
+ * @param addr Set to the address, host byte order
+ * @return true if s is a valid address
+ */
+bool audio_tap_parse_host(const char *s, size_t len, uint32_t *addr);
+
+/**
+ * Format an IPv4 address ("192.168.1.20")
+ *
+ * @param addr Address, host byte order
+ * @param buf Destination (at least 16 bytes)
+ */
+void audio_tap_format_host(uint32_t addr, char *buf);
+
+/**
+ * Get the printable name of a tap point
+ *
+ * @param point Tap point
+ * @return "post" or "prelimiter"
+ */
+const char *audio_tap_point_name(audio_tap_point_t point);
+
+/**
+ * Get the printable name of a stream format
+ *
+ * @param format Format
+ * @return "L24" or "L16"
+ */
+const char *audio_tap_format_name(audio_tap_format_t format);
+
+#endif // AUDIO_TAP_H
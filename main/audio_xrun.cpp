@@ -0,0 +1,358 @@
+#include "audio_xrun.h"
+#include "audio_config.h"
+#include "dsp_perf.h"
+#include "dsp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *s_type_names[AUDIO_XRUN_TYPE_COUNT] = {
+    "rx_overflow", "tx_underrun", "deadline",
+};
+
+#if AUDIO_XRUN_ENABLED
+
+static const char *TAG = "AUDIO_XRUN";
+
+// Event log task: poll interval, and lines per poll before summarizing
+#define XRUN_LOG_POLL_MS        200
+#define XRUN_LOG_MAX_LINES      4
+
+// Buffers the I2S interrupts counted since the task last looked
+typedef struct {
+    uint32_t count;
+    int64_t first_us;           // esp_timer time of the first one
+} isr_pending_t;
+
+static portMUX_TYPE s_isr_lock = portMUX_INITIALIZER_UNLOCKED;
+static isr_pending_t s_pending[AUDIO_XRUN_DEADLINE];   // RX overflow, TX underrun
+static bool s_armed = false;                            // Under s_isr_lock
+
+// Counters and event log, written only by the task running the chain
+static audio_xrun_snapshot_t s_stats;
+
+// Sequence lock: odd while s_stats is being updated
+static volatile uint32_t s_seq = 0;
+
+// Set by audio_xrun_reset, serviced at the next block
+static volatile bool s_reset_pending = true;
+
+// Sample rate the block period is computed for
+static volatile uint32_t s_sample_rate = SAMPLE_RATE;
+
+// Block period for the current block size and rate
+static int s_period_frames = 0;
+static uint32_t s_period_rate = 0;
+
+// Current block (task running the chain only)
+static int64_t s_block_start = 0;
+
+// Fade-in: requested by a dropout or restart, started at the next block end
+static bool s_fade_pending = false;
+static int s_fade_frames = 0;
+static int s_fade_pos = 0;
+
+static TaskHandle_t s_log_task = NULL;
+
+static bool IRAM_ATTR count_isr(audio_xrun_type_t type)
+{
+    portENTER_CRITICAL_ISR(&s_isr_lock);
+    if (s_armed) {
+        isr_pending_t *p = &s_pending[type];
+        if (p->count == 0) {
+            p->first_us = esp_timer_get_time();
+        }
+        p->count++;
+    }
+    portEXIT_CRITICAL_ISR(&s_isr_lock);
+    return false;
+}
+
+static bool IRAM_ATTR on_recv_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    // The RX queue was full: the driver dropped the oldest block
+    return count_isr(AUDIO_XRUN_RX_OVERFLOW);
+}
+
+static bool IRAM_ATTR on_send_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    // Every TX buffer is free: the DMA is replaying auto-cleared silence
+    return count_isr(AUDIO_XRUN_TX_UNDERRUN);
+}
+
+static DSP_HOT_INLINE void write_begin(void)
+{
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+    if (s_reset_pending) {
+        s_reset_pending = false;
+        memset(&s_stats, 0, sizeof(s_stats));
+        s_period_frames = 0;
+    }
+}
+
+static DSP_HOT_INLINE void write_end(void)
+{
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+}
+
+// Inside write_begin / write_end
+static void DSP_HOT add_event(audio_xrun_type_t type, int64_t time_us, uint32_t count,
+                              uint32_t late_us, dsp_perf_stage_t stage)
+{
+    audio_xrun_event_t *ev = &s_stats.log[s_stats.total % AUDIO_XRUN_LOG_SIZE];
+    ev->time_us = time_us;
+    ev->count = count;
+    ev->late_us = late_us;
+    ev->type = (uint8_t)type;
+    ev->stage = (uint8_t)stage;
+
+    s_stats.total++;
+    s_stats.events[type]++;
+    s_stats.lost[type] += count;
+    s_stats.last_us[type] = time_us;
+
+    // Lost audio leaves a step to or from silence; a late block alone is
+    // absorbed by the DMA queue
+    if (type != AUDIO_XRUN_DEADLINE) {
+        s_fade_pending = true;
+    }
+}
+
+static void DSP_HOT apply_fade(int32_t *buffer, int num_samples)
+{
+    const float step = 1.0f / (float)s_fade_frames;
+    for (int i = 0; i < num_samples && s_fade_pos < s_fade_frames; i += I2S_NUM_CHANNELS) {
+        const float g = (float)s_fade_pos * step;
+        buffer[i] = (int32_t)((float)(buffer[i] >> 8) * g) << 8;
+        buffer[i + 1] = (int32_t)((float)(buffer[i + 1] >> 8) * g) << 8;
+        s_fade_pos++;
+    }
+}
+
+void audio_xrun_add_callbacks(i2s_event_callbacks_t *rx_cbs, i2s_event_callbacks_t *tx_cbs)
+{
+    rx_cbs->on_recv_q_ovf = on_recv_q_ovf;
+    tx_cbs->on_send_q_ovf = on_send_q_ovf;
+}
+
+esp_err_t audio_xrun_attach(i2s_chan_handle_t tx, i2s_chan_handle_t rx)
+{
+    i2s_event_callbacks_t rx_cbs;
+    memset(&rx_cbs, 0, sizeof(rx_cbs));
+    i2s_event_callbacks_t tx_cbs;
+    memset(&tx_cbs, 0, sizeof(tx_cbs));
+    audio_xrun_add_callbacks(&rx_cbs, &tx_cbs);
+
+    esp_err_t err = i2s_channel_register_event_callback(rx, &rx_cbs, NULL);
+    if (err == ESP_OK) {
+        err = i2s_channel_register_event_callback(tx, &tx_cbs, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register I2S overflow callbacks: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void audio_xrun_suspend(void)
+{
+    portENTER_CRITICAL(&s_isr_lock);
+    s_armed = false;
+    portEXIT_CRITICAL(&s_isr_lock);
+    s_block_start = 0;
+}
+
+void DSP_HOT audio_xrun_block_begin(void)
+{
+    bool restart = false;
+    portENTER_CRITICAL(&s_isr_lock);
+    if (!s_armed) {
+        // Whatever was lost during the gap was intended
+        memset(s_pending, 0, sizeof(s_pending));
+        s_armed = true;
+        restart = true;
+    }
+    portEXIT_CRITICAL(&s_isr_lock);
+
+    if (restart) {
+        s_fade_pending = true;
+    }
+    s_block_start = esp_timer_get_time();
+}
+
+void DSP_HOT audio_xrun_block_end(int32_t *buffer, int num_samples)
+{
+    const int64_t now = esp_timer_get_time();
+    const int num_frames = num_samples / I2S_NUM_CHANNELS;
+
+    write_begin();
+
+    // Only recomputed when the block size or sample rate changes
+    const uint32_t rate = s_sample_rate;
+    if ((num_frames != s_period_frames || rate != s_period_rate) && num_frames > 0) {
+        s_period_frames = num_frames;
+        s_period_rate = rate;
+        s_stats.period_us = (uint32_t)((uint64_t)num_frames * 1000000u / rate);
+    }
+    s_stats.blocks++;
+
+    if (s_block_start != 0 && now - s_block_start > (int64_t)s_stats.period_us) {
+        const uint32_t late_us = (uint32_t)(now - s_block_start - s_stats.period_us);
+        if (late_us > s_stats.max_late_us) {
+            s_stats.max_late_us = late_us;
+        }
+        add_event(AUDIO_XRUN_DEADLINE, s_block_start + s_stats.period_us, 1, late_us,
+                  dsp_perf_late_stage());
+    }
+    s_block_start = 0;
+
+    // Buffers the interrupts counted since the last block
+    isr_pending_t pending[AUDIO_XRUN_DEADLINE];
+    portENTER_CRITICAL(&s_isr_lock);
+    memcpy(pending, s_pending, sizeof(pending));
+    memset(s_pending, 0, sizeof(s_pending));
+    portEXIT_CRITICAL(&s_isr_lock);
+    for (int t = 0; t < AUDIO_XRUN_DEADLINE; t++) {
+        if (pending[t].count != 0) {
+            add_event((audio_xrun_type_t)t, pending[t].first_us, pending[t].count, 0,
+                      DSP_PERF_STAGE_COUNT);
+        }
+    }
+
+    if (s_fade_pending) {
+        s_fade_pending = false;
+        s_fade_frames = (int)((uint64_t)AUDIO_XRUN_FADE_MS * rate / 1000u);
+        s_fade_pos = 0;
+        s_stats.fades++;
+    }
+
+    write_end();
+
+    if (s_fade_pos < s_fade_frames) {
+        apply_fade(buffer, num_samples);
+    }
+}
+
+void DSP_HOT audio_xrun_report(audio_xrun_type_t type, uint32_t count)
+{
+    if (count == 0 || type >= AUDIO_XRUN_TYPE_COUNT) {
+        return;
+    }
+    write_begin();
+    add_event(type, esp_timer_get_time(), count, 0, DSP_PERF_STAGE_COUNT);
+    write_end();
+}
+
+void audio_xrun_set_sample_rate(uint32_t sample_rate)
+{
+    // Dropouts stay counted across rate changes; only the period changes
+    s_sample_rate = sample_rate;
+}
+
+void audio_xrun_reset(void)
+{
+    s_reset_pending = true;
+}
+
+esp_err_t audio_xrun_get_snapshot(audio_xrun_snapshot_t *snapshot)
+{
+    // A block takes milliseconds and the copy microseconds, so a retry is rare
+    for (int attempt = 0; attempt < 8; attempt++) {
+        uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_SEQ_CST);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(snapshot, &s_stats, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s_seq, __ATOMIC_SEQ_CST) == seq) {
+            // Before the first block: report "nothing recorded" consistently
+            if (s_reset_pending || seq == 0) {
+                memset(snapshot, 0, sizeof(*snapshot));
+            }
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static void log_event(const audio_xrun_event_t *ev)
+{
+    const long long ms = (long long)(ev->time_us / 1000);
+    if (ev->type == AUDIO_XRUN_DEADLINE) {
+        ESP_LOGW(TAG, "Deadline missed at %lld ms: %lu us late in %s", ms,
+                 (unsigned long)ev->late_us, dsp_perf_stage_name((dsp_perf_stage_t)ev->stage));
+    } else {
+        ESP_LOGW(TAG, "%s at %lld ms: %lu DMA buffer(s)",
+                 ev->type == AUDIO_XRUN_RX_OVERFLOW ? "RX overflow" : "TX underrun", ms,
+                 (unsigned long)ev->count);
+    }
+}
+
+// Logs new events from a normal-priority task: the audio path never writes
+// to the console
+static void xrun_log_task(void *pvParameters)
+{
+    audio_xrun_snapshot_t snap;
+    uint32_t logged = 0;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(XRUN_LOG_POLL_MS));
+        if (audio_xrun_get_snapshot(&snap) != ESP_OK) {
+            continue;
+        }
+        if (snap.total < logged) {
+            // Reset since the last poll
+            logged = 0;
+        }
+        if (snap.total - logged > XRUN_LOG_MAX_LINES) {
+            ESP_LOGW(TAG, "%lu dropouts in %d ms (rx %lu, tx %lu, deadline %lu in total)",
+                     (unsigned long)(snap.total - logged), XRUN_LOG_POLL_MS,
+                     (unsigned long)snap.events[AUDIO_XRUN_RX_OVERFLOW],
+                     (unsigned long)snap.events[AUDIO_XRUN_TX_UNDERRUN],
+                     (unsigned long)snap.events[AUDIO_XRUN_DEADLINE]);
+            logged = snap.total - 1;
+        }
+        for (; logged < snap.total; logged++) {
+            log_event(&snap.log[logged % AUDIO_XRUN_LOG_SIZE]);
+        }
+    }
+}
+
+esp_err_t audio_xrun_init(void)
+{
+    if (s_log_task != NULL) {
+        return ESP_OK;
+    }
+    BaseType_t created = xTaskCreate(xrun_log_task, "xrun_log", 2560, NULL,
+                                     tskIDLE_PRIORITY + 1, &s_log_task);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create xrun log task");
+        s_log_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+#else
+
+void audio_xrun_reset(void)
+{
+}
+
+esp_err_t audio_xrun_get_snapshot(audio_xrun_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+const char *audio_xrun_type_name(audio_xrun_type_t type)
+{
+    if (type < 0 || type >= AUDIO_XRUN_TYPE_COUNT) {
+        return "unknown";
+    }
+    return s_type_names[type];
+}
@@ -0,0 +1,172 @@
+#ifndef AUDIO_XRUN_H
+#define AUDIO_XRUN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "driver/i2s_std.h"
+
+// Xrun monitor
+// Counts the ways a block can fail on its way through the audio path:
+//  - RX overflow: the driver dropped input because nobody read it in time
+//    (I2S on_recv_q_ovf)
+//  - TX underrun: the TX DMA ran out of audio and played auto-cleared
+//    silence (on_send_q_ovf; with low-latency I/O, periods the task missed
+//    or finished too late)
+//  - Deadline miss: processing a block took longer than the block period;
+//    the profiler (dsp_perf.h) tells which stage was running when the
+//    deadline passed
+// The interrupt callbacks only count. The task that runs the chain turns new
+// counts into timestamped events (esp_timer time, the clock of the log
+// lines, so dropouts line up with WiFi/MQTT messages) and publishes counters
+// and the most recent events through a sequence lock, as in dsp_perf. A
+// low-priority task logs every new event. After a dropout the next block
+// fades in over AUDIO_XRUN_FADE_MS instead of jumping from silence to full
+// level.
+
+#ifdef CONFIG_AUDIO_XRUN
+#define AUDIO_XRUN_ENABLED      1
+#define AUDIO_XRUN_FADE_MS      CONFIG_AUDIO_XRUN_FADE_MS
+#else
+#define AUDIO_XRUN_ENABLED      0
+#define AUDIO_XRUN_FADE_MS      0
+#endif
+
+// Most recent events kept for serial / MQTT
+#define AUDIO_XRUN_LOG_SIZE     16
+
+typedef enum {
+    AUDIO_XRUN_RX_OVERFLOW = 0, // Input lost
+    AUDIO_XRUN_TX_UNDERRUN,     // Output played silence
+    AUDIO_XRUN_DEADLINE,        // Block processed slower than real time
+    AUDIO_XRUN_TYPE_COUNT
+} audio_xrun_type_t;
+
+// One dropout (a burst of DMA buffers lost between two blocks counts once)
+typedef struct {
+    int64_t time_us;            // esp_timer time of the first lost buffer / of the late block
+    uint32_t count;             // DMA buffers lost, or 1 for a deadline miss
+    uint32_t late_us;           // Deadline miss: processing time beyond the block period
+    uint8_t type;               // audio_xrun_type_t
+    uint8_t stage;              // Deadline miss: dsp_perf_stage_t running at the deadline
+                                // (DSP_PERF_STAGE_COUNT if unknown, or not a deadline miss)
+} audio_xrun_event_t;
+
+typedef struct {
+    uint32_t blocks;                            // Blocks checked since the last reset
+    uint32_t events[AUDIO_XRUN_TYPE_COUNT];     // Dropouts per type
+    uint32_t lost[AUDIO_XRUN_TYPE_COUNT];       // DMA buffers lost (overflow, underrun) or late blocks
+    int64_t last_us[AUDIO_XRUN_TYPE_COUNT];     // esp_timer time of the most recent dropout (0 = none)
+    uint32_t max_late_us;                       // Longest deadline overshoot
+    uint32_t fades;                             // Fade-ins after a dropout or restart
+    uint32_t period_us;                         // Block period the deadline is checked against
+    uint32_t total;                             // Events logged since the last reset
+    audio_xrun_event_t log[AUDIO_XRUN_LOG_SIZE]; // Most recent events; event n is log[n % AUDIO_XRUN_LOG_SIZE]
+} audio_xrun_snapshot_t;
+
+#if AUDIO_XRUN_ENABLED
+
+/**
+ * Start the event log task (before the audio task starts)
+ *
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t audio_xrun_init(void);
+
+/**
+ * Add the queue overflow callbacks to a callback set (before it is registered)
+ *
+ * For I/O paths that register callbacks of their own.
+ *
+ * @param rx_cbs RX channel callbacks
+ * @param tx_cbs TX channel callbacks
+ */
+void audio_xrun_add_callbacks(i2s_event_callbacks_t *rx_cbs, i2s_event_callbacks_t *tx_cbs);
+
+/**
+ * Register the queue overflow callbacks on a channel pair (before it is
+ * enabled; blocking read/write paths only)
+ *
+ * @param tx TX channel handle
+ * @param rx RX channel handle
+ * @return ESP_OK or the driver error
+ */
+esp_err_t audio_xrun_attach(i2s_chan_handle_t tx, i2s_chan_handle_t rx);
+
+/**
+ * Stop counting before an intentional gap (start-up, rate or geometry change,
+ * benchmark; I/O task only)
+ *
+ * Counting resumes with the next audio_xrun_block_begin, whose block fades in.
+ */
+void audio_xrun_suspend(void);
+
+/**
+ * Start the deadline of one block (task running the chain, once its input
+ * is available)
+ */
+void audio_xrun_block_begin(void);
+
+/**
+ * Finish one block: check its deadline, log new dropouts and apply a pending
+ * fade-in (task running the chain, before the block is written)
+ *
+ * @param buffer Processed block, left-justified 32-bit I2S words
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void audio_xrun_block_end(int32_t *buffer, int num_samples);
+
+/**
+ * Record a dropout the I/O path detected itself (task running the chain)
+ *
+ * @param type Dropout type
+ * @param count DMA buffers lost
+ */
+void audio_xrun_report(audio_xrun_type_t type, uint32_t count);
+
+/**
+ * Set the sample rate the block period is computed for (audio_rate_set)
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void audio_xrun_set_sample_rate(uint32_t sample_rate);
+
+#else
+
+static inline esp_err_t audio_xrun_init(void) { return ESP_OK; }
+static inline void audio_xrun_add_callbacks(i2s_event_callbacks_t *rx_cbs, i2s_event_callbacks_t *tx_cbs) { (void)rx_cbs; (void)tx_cbs; }
+static inline esp_err_t audio_xrun_attach(i2s_chan_handle_t tx, i2s_chan_handle_t rx) { (void)tx; (void)rx; return ESP_OK; }
+static inline void audio_xrun_suspend(void) {}
+static inline void audio_xrun_block_begin(void) {}
+static inline void audio_xrun_block_end(int32_t *buffer, int num_samples) { (void)buffer; (void)num_samples; }
+static inline void audio_xrun_report(audio_xrun_type_t type, uint32_t count) { (void)type; (void)count; }
+static inline void audio_xrun_set_sample_rate(uint32_t sample_rate) { (void)sample_rate; }
+
+#endif
+
+/**
+ * Clear the counters and the event log (takes effect at the next block)
+ */
+void audio_xrun_reset(void);
+
+/**
+ * Copy the counters and the most recent events
+ *
+ * Never blocks the audio task; retries if a block finished during the copy.
+ *
+ * @param snapshot Destination
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if the monitor is compiled out,
+ *         ESP_ERR_TIMEOUT if no consistent copy could be taken
+ */
+esp_err_t audio_xrun_get_snapshot(audio_xrun_snapshot_t *snapshot);
+
+/**
+ * Get the printable name of a dropout type
+ *
+ * @param type Dropout type
+ * @return "rx_overflow", "tx_underrun" or "deadline"
+ */
+const char *audio_xrun_type_name(audio_xrun_type_t type);
+
+#endif // AUDIO_XRUN_H
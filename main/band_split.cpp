@@ -0,0 +1,146 @@
+#include "band_split.h"
+#include "dsp_attr.h"
+#include "dsps_biquad.h"
+#include <string.h>
+#include <math.h>
+
+// Filter sections of one LR4 slope, or an allpass that keeps a band in
+// phase with the sum of the bands above it
+typedef enum {
+    SECTION_LOWPASS,
+    SECTION_HIGHPASS,
+    SECTION_ALLPASS,
+} section_type_t;
+
+/* Design */
+
+static void store_section(band_split_cascade_t *c, int s, float a0,
+                          float b0, float b1, float b2, float a1, float a2)
+{
+    float *f = c->coeffs_f32[s];
+    f[0] = b0 / a0;
+    f[1] = b1 / a0;
+    f[2] = b2 / a0;
+    f[3] = a1 / a0;
+    f[4] = a2 / a0;
+
+    // Q24 fixed-point (multiply by 2^24)
+    c->coeffs[s].b0 = (int32_t)(f[0] * 16777216.0f);
+    c->coeffs[s].b1 = (int32_t)(f[1] * 16777216.0f);
+    c->coeffs[s].b2 = (int32_t)(f[2] * 16777216.0f);
+    c->coeffs[s].a1 = (int32_t)(f[3] * 16777216.0f);
+    c->coeffs[s].a2 = (int32_t)(f[4] * 16777216.0f);
+}
+
+/**
+ * Calculate one Butterworth section (RBJ Audio EQ Cookbook, Q = 1/sqrt(2))
+ */
+static void design_section(band_split_cascade_t *c, section_type_t type, float freq, float sample_rate)
+{
+    const float limit = BAND_SPLIT_MAX_FREQ_RATIO * sample_rate;
+    if (freq > limit) {
+        freq = limit;
+    }
+    const float w0 = 2.0f * (float)M_PI * freq / sample_rate;
+    const float cos_w0 = cosf(w0);
+    const float alpha = sinf(w0) / (2.0f * BAND_SPLIT_BUTTERWORTH_Q);
+    const int s = c->sections++;
+
+    switch (type) {
+        case SECTION_LOWPASS:
+            store_section(c, s, 1.0f + alpha, (1.0f - cos_w0) * 0.5f, 1.0f - cos_w0,
+                          (1.0f - cos_w0) * 0.5f, -2.0f * cos_w0, 1.0f - alpha);
+            break;
+        case SECTION_HIGHPASS:
+            store_section(c, s, 1.0f + alpha, (1.0f + cos_w0) * 0.5f, -(1.0f + cos_w0),
+                          (1.0f + cos_w0) * 0.5f, -2.0f * cos_w0, 1.0f - alpha);
+            break;
+        case SECTION_ALLPASS:
+            store_section(c, s, 1.0f + alpha, 1.0f - alpha, -2.0f * cos_w0,
+                          1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+            break;
+    }
+}
+
+void band_split_design(band_split_coeffs_t *coeffs, int bands, const float *freq, uint32_t sample_rate)
+{
+    if (bands < 2) bands = 2;
+    if (bands > BAND_SPLIT_MAX_BANDS) bands = BAND_SPLIT_MAX_BANDS;
+    memset(coeffs, 0, sizeof(*coeffs));
+    coeffs->bands = (uint8_t)bands;
+
+    const float fs = (float)sample_rate;
+    const int points = bands - 1;
+    for (int p = 0; p < points; p++) {
+        // Band p: lowpass of the rest, plus the allpass of every point above
+        band_split_cascade_t *low = &coeffs->cascades[2 * p];
+        design_section(low, SECTION_LOWPASS, freq[p], fs);
+        design_section(low, SECTION_LOWPASS, freq[p], fs);
+        for (int q = p + 1; q < points; q++) {
+            design_section(low, SECTION_ALLPASS, freq[q], fs);
+        }
+
+        // The rest above point p
+        band_split_cascade_t *high = &coeffs->cascades[2 * p + 1];
+        design_section(high, SECTION_HIGHPASS, freq[p], fs);
+        design_section(high, SECTION_HIGHPASS, freq[p], fs);
+    }
+}
+
+/* Audio path */
+
+static void DSP_HOT run_cascade_q24(const band_split_cascade_t *c, biquad_state_t (*state)[2],
+                                    const int32_t *src, int32_t *dst, int num_samples)
+{
+    for (int s = 0; s < c->sections; s++) {
+        const int32_t *in = (s == 0) ? src : dst;
+        biquad_state_t *state_l = &state[s][0];
+        biquad_state_t *state_r = &state[s][1];
+        for (int i = 0; i < num_samples; i += 2) {
+            dst[i] = biquad_q24_process(&c->coeffs[s], state_l, in[i]);
+            dst[i + 1] = biquad_q24_process(&c->coeffs[s], state_r, in[i + 1]);
+        }
+    }
+}
+
+static void DSP_HOT run_cascade_f32(const band_split_cascade_t *c, float (*state)[4],
+                                    const float *src, float *dst, int num_samples)
+{
+    for (int s = 0; s < c->sections; s++) {
+        // esp-dsp takes a non-const coefficient pointer but only reads it
+        dsps_biquad_sf32(s == 0 ? src : dst, dst, num_samples / 2,
+                         (float *)c->coeffs_f32[s], state[s]);
+    }
+}
+
+// The rest above each point is built in the top band's buffer: split off
+// band p, then replace the rest by its highpass (in this order)
+void DSP_HOT band_split_process(const band_split_coeffs_t *coeffs, band_split_state_t *state,
+                                const int32_t *input, int32_t *const *bands, int num_samples)
+{
+    const int top = coeffs->bands - 1;
+    const int32_t *rest = input;
+    for (int p = 0; p < top; p++) {
+        run_cascade_q24(&coeffs->cascades[2 * p], state->state[2 * p], rest, bands[p], num_samples);
+        run_cascade_q24(&coeffs->cascades[2 * p + 1], state->state[2 * p + 1], rest, bands[top], num_samples);
+        rest = bands[top];
+    }
+}
+
+void DSP_HOT band_split_process_f32(const band_split_coeffs_t *coeffs, band_split_state_t *state,
+                                    const float *input, float *const *bands, int num_samples)
+{
+    const int top = coeffs->bands - 1;
+    const float *rest = input;
+    for (int p = 0; p < top; p++) {
+        run_cascade_f32(&coeffs->cascades[2 * p], state->state_f32[2 * p], rest, bands[p], num_samples);
+        run_cascade_f32(&coeffs->cascades[2 * p + 1], state->state_f32[2 * p + 1], rest, bands[top], num_samples);
+        rest = bands[top];
+    }
+}
+
+void band_split_reset(band_split_state_t *state)
+{
+    memset(state->state, 0, sizeof(state->state));
+    memset(state->state_f32, 0, sizeof(state->state_f32));
+}
@@ -0,0 +1,97 @@
+#ifndef BAND_SPLIT_H
+#define BAND_SPLIT_H
+
+#include <stdint.h>
+#include "biquad.h"
+
+// Linkwitz-Riley band split
+// Splits a stereo block into 2 to BAND_SPLIT_MAX_BANDS bands with 4th-order
+// Linkwitz-Riley slopes (two cascaded Butterworth biquads each), arranged as
+// a tree: band 0 is the lowpass of point 0, the highpass of point 0 is split
+// again at point 1, and so on; the last band is the remaining highpass.
+// Every band below a point also gets that point's second-order allpass, so
+// the bands are in phase and sum to a flat magnitude response. N bands cost
+// 2 (N - 1) cascades, not one bandpass pair per band.
+//
+// Shared by the crossover and the multiband dynamics processor. Coefficients
+// are designed on the control side (band_split_design) and published by the
+// owner inside its own parameter set; the audio task runs the tree one pass
+// per biquad section over both channels, with the Q24 biquad (int32 blocks)
+// or the esp-dsp stereo float biquad (float blocks). Each kernel keeps its
+// own filter state.
+
+#define BAND_SPLIT_MAX_BANDS        4
+#define BAND_SPLIT_MAX_POINTS       (BAND_SPLIT_MAX_BANDS - 1)
+#define BAND_SPLIT_MAX_CASCADES     (2 * BAND_SPLIT_MAX_POINTS)
+// Lowest band: the LR4 lowpass plus one allpass per higher point
+#define BAND_SPLIT_MAX_SECTIONS     (BAND_SPLIT_MAX_POINTS + 1)
+
+// Butterworth Q of each half of an LR4 slope
+#define BAND_SPLIT_BUTTERWORTH_Q    0.70710678f
+
+// Points are designed at no more than this fraction of the sample rate
+#define BAND_SPLIT_MAX_FREQ_RATIO   0.45f
+
+// Filter sections of one cascade
+typedef struct {
+    biquad_coeffs_t coeffs[BAND_SPLIT_MAX_SECTIONS];    // Q24 kernel
+    float coeffs_f32[BAND_SPLIT_MAX_SECTIONS][5];       // esp-dsp kernel (b0, b1, b2, a1, a2)
+    uint8_t sections;
+} band_split_cascade_t;
+
+// Coefficients of the whole tree: cascade 2p produces band p, cascade 2p + 1
+// the band above point p
+typedef struct {
+    band_split_cascade_t cascades[BAND_SPLIT_MAX_CASCADES];
+    uint8_t bands;
+} band_split_coeffs_t;
+
+// Filter history (audio task only)
+typedef struct {
+    biquad_state_t state[BAND_SPLIT_MAX_CASCADES][BAND_SPLIT_MAX_SECTIONS][2];      // Q24: L, R
+    float state_f32[BAND_SPLIT_MAX_CASCADES][BAND_SPLIT_MAX_SECTIONS][4];           // esp-dsp: L w0, L w1, R w0, R w1
+} band_split_state_t;
+
+/**
+ * Design the split for a set of points
+ *
+ * @param coeffs Destination
+ * @param bands Number of bands (2 to BAND_SPLIT_MAX_BANDS)
+ * @param freq bands - 1 points in Hz, ascending (each limited to
+ *             BAND_SPLIT_MAX_FREQ_RATIO of the sample rate)
+ * @param sample_rate Sample rate in Hz
+ */
+void band_split_design(band_split_coeffs_t *coeffs, int bands, const float *freq, uint32_t sample_rate);
+
+/**
+ * Split a block of 24-bit samples with the Q24 kernel
+ *
+ * @param coeffs Coefficients from band_split_design
+ * @param state Filter history
+ * @param input Interleaved stereo block (not one of the band buffers)
+ * @param bands coeffs->bands destination blocks, lowest band first
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void band_split_process(const band_split_coeffs_t *coeffs, band_split_state_t *state,
+                        const int32_t *input, int32_t *const *bands, int num_samples);
+
+/**
+ * Split a float block with the esp-dsp kernel
+ *
+ * @param coeffs Coefficients from band_split_design
+ * @param state Filter history
+ * @param input Interleaved stereo block (not one of the band buffers)
+ * @param bands coeffs->bands destination blocks, lowest band first
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void band_split_process_f32(const band_split_coeffs_t *coeffs, band_split_state_t *state,
+                            const float *input, float *const *bands, int num_samples);
+
+/**
+ * Clear the filter history of both kernels
+ *
+ * @param state Filter history
+ */
+void band_split_reset(band_split_state_t *state);
+
+#endif // BAND_SPLIT_H
@@ -0,0 +1,50 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stdint.h>
+#include "dsp_attr.h"
+
+// Biquad filter coefficients structure (Q24 fixed-point format)
+typedef struct {
+    int32_t b0, b1, b2;  // Feedforward coefficients (Q24 fixed-point)
+    int32_t a1, a2;      // Feedback coefficients (Q24 fixed-point, a0 is normalized to 1)
+} biquad_coeffs_t;
+
+// Biquad filter state (one per channel per filter)
+typedef struct {
+    int32_t x1, x2;    // Previous input samples
+    int32_t y1, y2;    // Previous output samples
+} biquad_state_t;
+
+/**
+ * Run one sample through a Q24 biquad (direct form I)
+ *
+ * Shared by the equalizer, the subsonic filter and the fused DSP chain so
+ * that every path produces bit-identical output.
+ *
+ * @param c Filter coefficients
+ * @param s Filter state for this channel
+ * @param input Input sample (24-bit right-justified)
+ * @return Filtered output sample
+ */
+static DSP_HOT_INLINE int32_t biquad_q24_process(const biquad_coeffs_t *c, biquad_state_t *s, int32_t input)
+{
+    // Coefficients are Q24, shift right by 24 after multiplication
+    int64_t temp = ((int64_t)c->b0 * input) >> 24;
+    temp += ((int64_t)c->b1 * s->x1) >> 24;
+    temp += ((int64_t)c->b2 * s->x2) >> 24;
+    temp -= ((int64_t)c->a1 * s->y1) >> 24;
+    temp -= ((int64_t)c->a2 * s->y2) >> 24;
+
+    int32_t output = (int32_t)temp;
+
+    // Update state
+    s->x2 = s->x1;
+    s->x1 = input;
+    s->y2 = s->y1;
+    s->y1 = output;
+
+    return output;
+}
+
+#endif // BIQUAD_H
@@ -0,0 +1,86 @@
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dsp_attr.h"
+
+// Lock-free single-producer / single-consumer ring of audio block indices
+//
+// Used to hand DMA blocks between the I2S task and the DSP task on the other
+// core. Exactly one task pushes and exactly one task pops; head and tail are
+// free-running counters, each written by one side only, so no lock or
+// compare-and-swap is needed.
+
+// Slots in the ring (power of two, at least the deepest pipeline)
+#define BLOCK_RING_CAPACITY     8
+
+typedef struct {
+    volatile uint32_t head;                 // Pushes so far (producer only)
+    volatile uint32_t tail;                 // Pops so far (consumer only)
+    uint8_t slots[BLOCK_RING_CAPACITY];     // Block indices
+} block_ring_t;
+
+/**
+ * Empty the ring
+ *
+ * Only call while neither side is using it.
+ *
+ * @param ring Pointer to ring
+ */
+static inline void block_ring_init(block_ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * Number of blocks in the ring (either side)
+ *
+ * @param ring Pointer to ring
+ * @return Blocks pushed and not yet popped
+ */
+static DSP_HOT_INLINE uint32_t block_ring_count(const block_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Append a block index (producer only)
+ *
+ * @param ring Pointer to ring
+ * @param block Block index
+ * @return false if the ring is full
+ */
+static DSP_HOT_INLINE bool block_ring_push(block_ring_t *ring, uint8_t block)
+{
+    const uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= BLOCK_RING_CAPACITY) {
+        return false;
+    }
+    ring->slots[head % BLOCK_RING_CAPACITY] = block;
+    // The slot must be visible before the consumer sees the new head
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Take the oldest block index (consumer only)
+ *
+ * @param ring Pointer to ring
+ * @param block Set to the block index
+ * @return false if the ring is empty
+ */
+static DSP_HOT_INLINE bool block_ring_pop(block_ring_t *ring, uint8_t *block)
+{
+    const uint32_t tail = ring->tail;
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return false;
+    }
+    *block = ring->slots[tail % BLOCK_RING_CAPACITY];
+    // Hand the slot back only after it has been read
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif // BLOCK_RING_H
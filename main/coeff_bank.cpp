@@ -0,0 +1,230 @@
+#include "coeff_bank.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "COEFF_BANK";
+
+// Serializes writers (MQTT handler, serial task, ...); never taken by audio_task
+// or the I/O task (a rate change redesigns the chain in the requesting task).
+// Recursive, so that a group holds it across the module setters it calls.
+static SemaphoreHandle_t s_writer_mutex = NULL;
+
+// Group publish handshake with the audio task
+enum {
+    GROUP_IDLE = 0,
+    GROUP_COMMITTED,        // Staged and waiting for a block boundary
+    GROUP_SWAPPING,         // Claimed by the audio task
+};
+
+// The open group (writer side, under the writer lock)
+typedef struct {
+    coeff_bank_t *banks[COEFF_BANK_GROUP_BANKS];
+    volatile bool *flags[COEFF_BANK_GROUP_FLAGS];
+    bool values[COEFF_BANK_GROUP_FLAGS];
+    int num_banks;
+    int num_flags;
+    int depth;                  // Nested group_begin calls
+    bool open;
+} group_t;
+
+static group_t s_group = {};
+static volatile int s_group_state = GROUP_IDLE;
+
+static void writer_lock(void)
+{
+    // Before coeff_bank_init (single-threaded boot) there is nothing to serialize
+    if (s_writer_mutex != NULL) {
+        xSemaphoreTakeRecursive(s_writer_mutex, portMAX_DELAY);
+    }
+}
+
+static void writer_unlock(void)
+{
+    if (s_writer_mutex != NULL) {
+        xSemaphoreGiveRecursive(s_writer_mutex);
+    }
+}
+
+static bool group_has_bank(const coeff_bank_t *bank)
+{
+    for (int i = 0; i < s_group.num_banks; i++) {
+        if (s_group.banks[i] == bank) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Publish every staged set and flag (audio task at a block boundary, or the
+// writer when the chain is not running)
+static void DSP_HOT group_swap(void)
+{
+    for (int i = 0; i < s_group.num_banks; i++) {
+        coeff_bank_t *bank = s_group.banks[i];
+        __atomic_store_n(&bank->published, bank->writing, __ATOMIC_SEQ_CST);
+    }
+    for (int i = 0; i < s_group.num_flags; i++) {
+        *s_group.flags[i] = s_group.values[i];
+    }
+}
+
+void coeff_bank_init(void)
+{
+    if (s_writer_mutex == NULL) {
+        s_writer_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+}
+
+void coeff_bank_lock(void)
+{
+    writer_lock();
+}
+
+void coeff_bank_unlock(void)
+{
+    writer_unlock();
+}
+
+void coeff_bank_reset(coeff_bank_t *bank)
+{
+    bank->published = 0;
+    bank->in_use = COEFF_BANK_IDLE;
+    bank->writing = 0;
+}
+
+void *coeff_bank_begin_write(coeff_bank_t *bank, void *sets, size_t set_size)
+{
+    writer_lock();
+
+    // Edited again in the same group: continue on the staged set
+    uint8_t *base = (uint8_t *)sets;
+    if (s_group.open && group_has_bank(bank)) {
+        return base + bank->writing * set_size;
+    }
+
+    int current = __atomic_load_n(&bank->published, __ATOMIC_SEQ_CST);
+    int shadow = 1 - current;
+
+    // The audio task may still be finishing a block on the shadow copy if it
+    // latched it just before our previous publish. That lasts at most one
+    // block's processing time.
+    int waited_ms = 0;
+    while (__atomic_load_n(&bank->in_use, __ATOMIC_SEQ_CST) == shadow) {
+        if (waited_ms >= COEFF_BANK_ACK_TIMEOUT_MS) {
+            ESP_LOGW(TAG, "Audio task did not release parameter set %d after %d ms",
+                     shadow, waited_ms);
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+        waited_ms++;
+    }
+
+    memcpy(base + shadow * set_size, base + current * set_size, set_size);
+    bank->writing = shadow;
+    return base + shadow * set_size;
+}
+
+void coeff_bank_publish(coeff_bank_t *bank)
+{
+    if (!s_group.open) {
+        __atomic_store_n(&bank->published, bank->writing, __ATOMIC_SEQ_CST);
+    } else if (!group_has_bank(bank)) {
+        if (s_group.num_banks < COEFF_BANK_GROUP_BANKS) {
+            s_group.banks[s_group.num_banks++] = bank;
+        } else {
+            ESP_LOGW(TAG, "Group full: parameter set published on its own");
+            __atomic_store_n(&bank->published, bank->writing, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    writer_unlock();
+}
+
+void coeff_bank_group_begin(void)
+{
+    writer_lock();
+    if (s_group.depth++ == 0) {
+        s_group.num_banks = 0;
+        s_group.num_flags = 0;
+        s_group.open = true;
+    }
+}
+
+void coeff_bank_set_flag(volatile bool *flag, bool value)
+{
+    writer_lock();
+    if (!s_group.open) {
+        *flag = value;
+    } else {
+        // A flag staged twice takes the last value
+        int i = 0;
+        while (i < s_group.num_flags && s_group.flags[i] != flag) {
+            i++;
+        }
+        if (i < s_group.num_flags) {
+            s_group.values[i] = value;
+        } else if (s_group.num_flags < COEFF_BANK_GROUP_FLAGS) {
+            s_group.flags[i] = flag;
+            s_group.values[i] = value;
+            s_group.num_flags++;
+        } else {
+            ESP_LOGW(TAG, "Group full: flag written on its own");
+            *flag = value;
+        }
+    }
+    writer_unlock();
+}
+
+bool coeff_bank_group_commit(void)
+{
+    // An inner group only stages: the outer commit makes the swap
+    if (--s_group.depth > 0) {
+        writer_unlock();
+        return true;
+    }
+
+    bool swapped = true;
+    if (s_group.num_banks > 0 || s_group.num_flags > 0) {
+        __atomic_store_n(&s_group_state, GROUP_COMMITTED, __ATOMIC_SEQ_CST);
+
+        int waited_ms = 0;
+        while (__atomic_load_n(&s_group_state, __ATOMIC_SEQ_CST) != GROUP_IDLE &&
+               waited_ms < COEFF_BANK_ACK_TIMEOUT_MS) {
+            vTaskDelay(pdMS_TO_TICKS(1));
+            waited_ms++;
+        }
+
+        int expected = GROUP_COMMITTED;
+        if (__atomic_compare_exchange_n(&s_group_state, &expected, GROUP_IDLE, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            // No block boundary came: the chain is not running
+            group_swap();
+            swapped = false;
+        } else {
+            // Claimed just in time: the swap is a few stores, wait for it
+            while (__atomic_load_n(&s_group_state, __ATOMIC_SEQ_CST) != GROUP_IDLE) {
+                vTaskDelay(pdMS_TO_TICKS(1));
+            }
+        }
+    }
+
+    s_group.open = false;
+    writer_unlock();
+    return swapped;
+}
+
+void DSP_HOT coeff_bank_block_boundary(void)
+{
+    if (__atomic_load_n(&s_group_state, __ATOMIC_SEQ_CST) != GROUP_COMMITTED) {
+        return;
+    }
+    int expected = GROUP_COMMITTED;
+    if (__atomic_compare_exchange_n(&s_group_state, &expected, GROUP_SWAPPING, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        group_swap();
+        __atomic_store_n(&s_group_state, GROUP_IDLE, __ATOMIC_SEQ_CST);
+    }
+}
@@ -0,0 +1,161 @@
+#ifndef COEFF_BANK_H
+#define COEFF_BANK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "dsp_attr.h"
+
+// Double-buffered parameter sets shared between control tasks and audio_task
+//
+// Each DSP module keeps two copies of the parameters its process function
+// reads (coefficients, linear gains, ...). Control tasks bake a new set into
+// the copy the audio task is not using and publish it with one atomic store;
+// the audio task latches the published copy at the start of each block and
+// releases it at the end. The audio side never blocks or takes a lock.
+
+// in_use value while the audio task is between blocks
+#define COEFF_BANK_IDLE         (-1)
+
+// Give up waiting for the audio task to leave a copy after this long
+#define COEFF_BANK_ACK_TIMEOUT_MS   100
+
+// Banks, and flags (enables, pending resets), one group can publish
+// together. A dsp_control batch is the largest group: see the accounting
+// next to its static_assert.
+#define COEFF_BANK_GROUP_BANKS  12
+#define COEFF_BANK_GROUP_FLAGS  20
+
+typedef struct {
+    volatile int published;     // Index (0/1) of the latest complete parameter set
+    volatile int in_use;        // Index latched by the audio task, or COEFF_BANK_IDLE
+    int writing;                // Shadow index between begin_write and publish (writer side only)
+} coeff_bank_t;
+
+/**
+ * Initialize the writer lock shared by all control tasks
+ *
+ * Call once from app_main before any module is configured.
+ */
+void coeff_bank_init(void);
+
+/**
+ * Hold the writer lock across a sequence of writes (control tasks only)
+ *
+ * audio_rate_set takes it before the audio path parks for a rate change,
+ * so that the redesign never waits behind another writer while audio is
+ * stopped. Recursive: the setters called in between take it again.
+ */
+void coeff_bank_lock(void);
+
+/**
+ * Release the lock taken by coeff_bank_lock
+ */
+void coeff_bank_unlock(void);
+
+/**
+ * Reset a bank to "set 0 published, audio idle"
+ *
+ * Only call while no audio task is processing that module (e.g. from *_init).
+ *
+ * @param bank Pointer to bank
+ */
+void coeff_bank_reset(coeff_bank_t *bank);
+
+/**
+ * Start editing a module's parameters (control tasks only)
+ *
+ * Takes the writer lock, waits until the audio task is not reading the
+ * shadow copy, and pre-fills the shadow with the currently published set.
+ * Must be followed by coeff_bank_publish.
+ *
+ * @param bank Pointer to bank
+ * @param sets Pointer to the module's two-element parameter array
+ * @param set_size sizeof one parameter set
+ * @return Pointer to the shadow set to modify
+ */
+void *coeff_bank_begin_write(coeff_bank_t *bank, void *sets, size_t set_size);
+
+/**
+ * Publish the shadow set and release the writer lock
+ *
+ * The audio task picks it up at its next block boundary.
+ *
+ * @param bank Pointer to bank
+ */
+void coeff_bank_publish(coeff_bank_t *bank);
+
+/**
+ * Start a group publish (control tasks only)
+ *
+ * Takes the writer lock until coeff_bank_group_commit. Module setters are
+ * called as usual in between: their coeff_bank_publish only stages the set,
+ * and a second edit of the same bank continues on the staged set. A group
+ * begun inside an open one joins it (preset_bank_recall in a dsp_control
+ * batch): everything is swapped in at the outer commit.
+ */
+void coeff_bank_group_begin(void);
+
+/**
+ * Set a flag the audio task reads once per block (enable, reset request)
+ *
+ * Inside a group the store is made together with the group's sets,
+ * otherwise at once. A flag set twice in one group keeps the last value;
+ * past COEFF_BANK_GROUP_FLAGS the store is made at once (and logged).
+ *
+ * @param flag Flag in a module structure
+ * @param value New value
+ */
+void coeff_bank_set_flag(volatile bool *flag, bool value);
+
+/**
+ * Publish the group's sets and flags and release the writer lock
+ *
+ * Waits until the live chain has swapped them in at its next block
+ * boundary. If the chain does not run (audio stopped for a sample rate
+ * change, or not started yet), they are published here after
+ * COEFF_BANK_ACK_TIMEOUT_MS.
+ *
+ * @return true if the swap was made at a block boundary (always true for a
+ *         joined inner group, whose sets the outer commit swaps in)
+ */
+bool coeff_bank_group_commit(void);
+
+/**
+ * Swap in a committed group (audio task only)
+ *
+ * Called by the live chain once per block, before any stage latches its
+ * parameters; a single load when no group is waiting.
+ */
+void coeff_bank_block_boundary(void);
+
+/**
+ * Latch the published set for one block (audio task only)
+ *
+ * Lock-free and wait-free apart from a retry when a publish lands between
+ * the two loads, which can happen at most once per concurrent writer.
+ *
+ * @param bank Pointer to bank
+ * @return Index of the set to use until coeff_bank_release
+ */
+static DSP_HOT_INLINE int coeff_bank_acquire(coeff_bank_t *bank)
+{
+    int idx;
+    do {
+        idx = __atomic_load_n(&bank->published, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&bank->in_use, idx, __ATOMIC_SEQ_CST);
+    } while (idx != __atomic_load_n(&bank->published, __ATOMIC_SEQ_CST));
+    return idx;
+}
+
+/**
+ * Release the set latched by coeff_bank_acquire (audio task only)
+ *
+ * @param bank Pointer to bank
+ */
+static DSP_HOT_INLINE void coeff_bank_release(coeff_bank_t *bank)
+{
+    __atomic_store_n(&bank->in_use, COEFF_BANK_IDLE, __ATOMIC_SEQ_CST);
+}
+
+#endif // COEFF_BANK_H
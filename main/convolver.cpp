@@ -0,0 +1,817 @@
+#include "convolver.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "CONVOLVER";
+
+#if CONVOLVER_ENABLED
+#include "dsps_fft2r.h"
+#include "spectrum.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "dsp_tables.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define PART_FRAMES     CONVOLVER_PARTITION_FRAMES
+#define FFT_SIZE        CONVOLVER_FFT_SIZE
+#define BINS            CONVOLVER_BINS
+#define MAX_PARTS       CONVOLVER_MAX_PARTITIONS
+#define HISTORY_FRAMES  (FFT_SIZE - PART_FRAMES)        // Input kept for the next window
+#define CHANNEL_FLOATS  (2 * BINS)                      // One half spectrum (re, im)
+#define SLOT_FLOATS     (2 * CHANNEL_FLOATS)            // Both channels of one block
+
+static_assert(PART_FRAMES * 2 == DMA_BUFFER_SIZE, "one partition per audio block");
+static_assert(FFT_SIZE >= 2 * PART_FRAMES, "overlap-save needs an FFT of at least two partitions");
+
+// esp-dsp keeps one twiddle table for all radix-2 FFTs and the first init
+// sizes it, so it must hold the largest transform of any user
+#if SPECTRUM_ENABLED && SPECTRUM_FFT_SIZE > FFT_SIZE
+#define FFT_TABLE_SIZE  SPECTRUM_FFT_SIZE
+#else
+#define FFT_TABLE_SIZE  FFT_SIZE
+#endif
+
+// Core that runs the chain; the worker takes the other one
+#if AUDIO_PIPELINE_ENABLED
+#define CHAIN_CORE      AUDIO_PIPELINE_DSP_CORE
+#elif AUDIO_LOWLAT_ENABLED
+#define CHAIN_CORE      AUDIO_LOWLAT_CORE
+#else
+#define CHAIN_CORE      0                           // audio_task
+#endif
+#define WORKER_CORE     (1 - CHAIN_CORE)
+
+// How long the audio task waits for a late worker before summing inline
+#define WORKER_WAIT_US  100
+
+// Largest float below 2^31 (the int path saturates like pregain_apply_sample)
+#define SAMPLE_MAX      2147483520.0f
+#define SAMPLE_MIN      -2147483648.0f
+
+// Transform buffers of the audio task (16-byte aligned for esp-dsp)
+static float s_fft[2 * FFT_SIZE] __attribute__((aligned(16)));
+static float s_acc[SLOT_FLOATS] __attribute__((aligned(16)));
+
+// Partition spectra: params[].spectra points into one of these. Only the one
+// no parameter set references is ever rewritten (see retire)
+static float *s_spectra[2] = { NULL, NULL };
+static size_t s_spectra_bytes[2] = { 0, 0 };
+static size_t s_history_bytes = 0;
+static uint32_t s_generation = 0;
+
+// Upload in progress (under s_lock)
+static SemaphoreHandle_t s_lock = NULL;
+static convolver_ir_header_t s_upload;
+static float *s_staging = NULL;
+static uint32_t s_received = 0;                     // Bytes of tap data so far
+static bool s_stored = false;                       // Flash partition holds a valid response
+
+#if CONVOLVER_WORKER_ENABLED
+// Tail of the next block: sum over partitions 1..P-1, which only involve
+// blocks already in the delay line. The audio task hands a job over only
+// while the worker is idle (s_done_seq == s_job_seq) and adds the result
+// only if it matches the block and response it is processing.
+typedef struct {
+    const float *spectra;
+    const float *fdl;
+    int base;                                       // fdl slot partition 0 will use
+    int partitions;
+    int channels;
+    uint32_t generation;
+} tail_job_t;
+
+static tail_job_t s_job;
+static volatile uint32_t s_job_seq = 0;             // Jobs handed over (audio task)
+static volatile uint32_t s_done_seq = 0;            // Jobs finished (worker)
+static uint32_t s_expected = 0;                     // Job whose tail the next block adds, 0 = none
+static float s_tail[SLOT_FLOATS] __attribute__((aligned(16)));
+static TaskHandle_t s_worker = NULL;
+#endif
+
+static void *alloc_prefer(size_t bytes, uint32_t first, uint32_t fallback)
+{
+    void *p = heap_caps_aligned_calloc(16, 1, bytes, first);
+    if (p == NULL) {
+        p = heap_caps_aligned_calloc(16, 1, bytes, fallback);
+    }
+    return p;
+}
+
+/* Audio path */
+
+// acc += sum over partitions [first, count) of block (base - q) times partition q
+static void DSP_HOT mac_partitions(float *acc, const float *fdl, int base, const float *spectra,
+                                   int first, int count, int channels)
+{
+    for (int q = first; q < count; q++) {
+        int slot = base - q;
+        if (slot < 0) {
+            slot += MAX_PARTS;
+        }
+        const float *x = fdl + slot * SLOT_FLOATS;
+        const float *h = spectra + q * channels * CHANNEL_FLOATS;
+        for (int ch = 0; ch < 2; ch++) {
+            const float *xc = x + ch * CHANNEL_FLOATS;
+            const float *hc = h + ((channels == 2) ? ch : 0) * CHANNEL_FLOATS;
+            float *a = acc + ch * CHANNEL_FLOATS;
+            for (int k = 0; k < 2 * BINS; k += 2) {
+                const float xr = xc[k];
+                const float xi = xc[k + 1];
+                const float hr = hc[k];
+                const float hi = hc[k + 1];
+                a[k] += xr * hr - xi * hi;
+                a[k + 1] += xr * hi + xi * hr;
+            }
+        }
+    }
+}
+
+static void clear_history(convolver_t *cv)
+{
+    memset(cv->fdl, 0, MAX_PARTS * SLOT_FLOATS * sizeof(float));
+    memset(cv->history, 0, HISTORY_FRAMES * 2 * sizeof(float));
+    cv->head = 0;
+#if CONVOLVER_WORKER_ENABLED
+    s_expected = 0;
+#endif
+}
+
+static inline float load_sample(int32_t v) { return (float)v; }
+static inline float load_sample(float v) { return v; }
+
+static DSP_HOT_INLINE void store_sample(int32_t *dst, float y)
+{
+    if (y > SAMPLE_MAX) y = SAMPLE_MAX;
+    if (y < SAMPLE_MIN) y = SAMPLE_MIN;
+    *dst = (int32_t)lrintf(y);
+}
+
+static DSP_HOT_INLINE void store_sample(float *dst, float y)
+{
+    *dst = y;
+}
+
+// One overlap-save block: window = last HISTORY_FRAMES input frames + this
+// block, left in the real and right in the imaginary parts
+template <typename T>
+static DSP_HOT_INLINE void convolve(convolver_t *cv, const convolver_params_t *p, T *buffer)
+{
+    float *w = s_fft;
+    if (cv->reset_pending) {
+        cv->reset_pending = false;
+        clear_history(cv);
+    }
+
+    memcpy(w, cv->history, HISTORY_FRAMES * 2 * sizeof(float));
+    for (int i = 0; i < PART_FRAMES; i++) {
+        w[2 * (HISTORY_FRAMES + i)] = load_sample(buffer[2 * i]);
+        w[2 * (HISTORY_FRAMES + i) + 1] = load_sample(buffer[2 * i + 1]);
+    }
+    memcpy(cv->history, w + 2 * PART_FRAMES, HISTORY_FRAMES * 2 * sizeof(float));
+    dsps_fft2r_fc32(w, FFT_SIZE);
+    dsps_bit_rev_fc32(w, FFT_SIZE);
+
+    // Separate the two real spectra into the newest delay line slot:
+    // L[k] = (X[k] + X*[N-k]) / 2, R[k] = (X[k] - X*[N-k]) / 2j
+    const int head = (cv->head + 1 == MAX_PARTS) ? 0 : cv->head + 1;
+    cv->head = head;
+    float *xl = cv->fdl + head * SLOT_FLOATS;
+    float *xr = xl + CHANNEL_FLOATS;
+    for (int k = 0; k < BINS; k++) {
+        const int m = (FFT_SIZE - k) & (FFT_SIZE - 1);
+        const float ar = w[2 * k];
+        const float ai = w[2 * k + 1];
+        const float br = w[2 * m];
+        const float bi = -w[2 * m + 1];
+        xl[2 * k] = 0.5f * (ar + br);
+        xl[2 * k + 1] = 0.5f * (ai + bi);
+        xr[2 * k] = 0.5f * (ai - bi);
+        xr[2 * k + 1] = -0.5f * (ar - br);
+    }
+
+    // All older blocks (the tail), then the newest block times the first
+    // partition; the worker's tail is summed in the same order, so the output
+    // does not depend on which of the two computed it
+    bool have_tail = false;
+#if CONVOLVER_WORKER_ENABLED
+    if (s_expected != 0) {
+        const int64_t start = esp_timer_get_time();
+        while (__atomic_load_n(&s_done_seq, __ATOMIC_SEQ_CST) != s_expected &&
+               esp_timer_get_time() - start < WORKER_WAIT_US) {
+        }
+        if (__atomic_load_n(&s_done_seq, __ATOMIC_SEQ_CST) == s_expected) {
+            if (s_job.generation == p->generation) {
+                memcpy(s_acc, s_tail, sizeof(s_acc));
+                have_tail = true;
+            }
+        } else {
+            cv->late++;
+        }
+        s_expected = 0;
+    }
+#endif
+    if (!have_tail) {
+        memset(s_acc, 0, sizeof(s_acc));
+        mac_partitions(s_acc, cv->fdl, head, p->spectra, 1, p->partitions, p->channels);
+    }
+    mac_partitions(s_acc, cv->fdl, head, p->spectra, 0, 1, p->channels);
+
+#if CONVOLVER_WORKER_ENABLED
+    // Start on the next block's tail while this block goes out (the worker
+    // reads slots head .. head - P + 2; the next block writes head + 1)
+    if (p->partitions > 1 && __atomic_load_n(&s_done_seq, __ATOMIC_SEQ_CST) == s_job_seq) {
+        s_job.spectra = p->spectra;
+        s_job.fdl = cv->fdl;
+        s_job.base = (head + 1 == MAX_PARTS) ? 0 : head + 1;
+        s_job.partitions = p->partitions;
+        s_job.channels = p->channels;
+        s_job.generation = p->generation;
+        s_expected = __atomic_add_fetch(&s_job_seq, 1, __ATOMIC_SEQ_CST);
+        xTaskNotifyGive(s_worker);
+    }
+#endif
+
+    // Recombine: y = l + j r has spectrum W = L + j R; transforming conj(W)
+    // forward gives conj(y) (1/N is folded into the partition spectra)
+    const float *yl = s_acc;
+    const float *yr = s_acc + CHANNEL_FLOATS;
+    for (int k = 0; k < BINS; k++) {
+        const float a = yl[2 * k];
+        const float b = yl[2 * k + 1];
+        const float c = yr[2 * k];
+        const float d = yr[2 * k + 1];
+        w[2 * k] = a - d;
+        w[2 * k + 1] = -(b + c);
+        if (k > 0 && k < FFT_SIZE / 2) {
+            w[2 * (FFT_SIZE - k)] = a + d;
+            w[2 * (FFT_SIZE - k) + 1] = b - c;
+        }
+    }
+    dsps_fft2r_fc32(w, FFT_SIZE);
+    dsps_bit_rev_fc32(w, FFT_SIZE);
+
+    // The last PART_FRAMES outputs are the valid (non-wrapped) ones
+    const float *out = w + 2 * HISTORY_FRAMES;
+    if (param_ramp_retarget(&cv->ramp, p->gain_linear)) {
+        param_ramp_t ramp = cv->ramp;
+        for (int i = 0; i < PART_FRAMES; i++) {
+            const float g = param_ramp_next(&ramp);
+            store_sample(&buffer[2 * i], g * out[2 * i]);
+            store_sample(&buffer[2 * i + 1], -g * out[2 * i + 1]);
+        }
+        cv->ramp = ramp;
+    } else {
+        const float g = p->gain_linear;
+        for (int i = 0; i < PART_FRAMES; i++) {
+            store_sample(&buffer[2 * i], g * out[2 * i]);
+            store_sample(&buffer[2 * i + 1], -g * out[2 * i + 1]);
+        }
+    }
+    cv->blocks++;
+}
+
+#if CONVOLVER_WORKER_ENABLED
+static void DSP_HOT worker_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const uint32_t seq = __atomic_load_n(&s_job_seq, __ATOMIC_SEQ_CST);
+        const tail_job_t job = s_job;
+        memset(s_tail, 0, sizeof(s_tail));
+        mac_partitions(s_tail, job.fdl, job.base, job.spectra, 1, job.partitions, job.channels);
+        __atomic_store_n(&s_done_seq, seq, __ATOMIC_SEQ_CST);
+    }
+}
+#endif
+
+bool DSP_HOT convolver_block_active(const convolver_t *convolver, const convolver_params_t *params)
+{
+    return convolver->enabled && params->spectra != NULL &&
+           (params->sample_rate == 0 || params->sample_rate == convolver->sample_rate);
+}
+
+DSP_HOT const convolver_params_t *convolver_begin_block(convolver_t *convolver)
+{
+    const convolver_params_t *p = &convolver->params[coeff_bank_acquire(&convolver->bank)];
+    if (!convolver_block_active(convolver, p)) {
+        // Start from silence once a response (or the matching rate) arrives
+        convolver->reset_pending = true;
+        if (convolver->enabled && p->spectra != NULL) {
+            convolver->skipped++;
+        }
+    }
+    return p;
+}
+
+void DSP_HOT convolver_end_block(convolver_t *convolver)
+{
+    coeff_bank_release(&convolver->bank);
+}
+
+void DSP_HOT convolver_process_block(convolver_t *convolver, const convolver_params_t *params,
+                                     int32_t *buffer, int num_samples)
+{
+    if (num_samples != DMA_BUFFER_SIZE) {
+        convolver->reset_pending = true;
+        convolver->skipped++;
+        return;
+    }
+    convolve(convolver, params, buffer);
+}
+
+void DSP_HOT convolver_process(convolver_t *convolver, int32_t *buffer, int num_samples)
+{
+    if (!convolver->enabled) {
+        return;  // Bypass
+    }
+
+    const convolver_params_t *p = convolver_begin_block(convolver);
+    if (convolver_block_active(convolver, p)) {
+        convolver_process_block(convolver, p, buffer, num_samples);
+    }
+    convolver_end_block(convolver);
+}
+
+void DSP_HOT convolver_process_f32(convolver_t *convolver, float *buffer, int num_samples)
+{
+    if (!convolver->enabled) {
+        return;  // Bypass
+    }
+
+    const convolver_params_t *p = convolver_begin_block(convolver);
+    if (convolver_block_active(convolver, p)) {
+        if (num_samples == DMA_BUFFER_SIZE) {
+            convolve(convolver, p, buffer);
+        } else {
+            convolver->reset_pending = true;
+            convolver->skipped++;
+        }
+    }
+    convolver_end_block(convolver);
+}
+
+void convolver_set_sample_rate(convolver_t *convolver, uint32_t sample_rate)
+{
+    convolver->sample_rate = sample_rate;
+    convolver->reset_pending = true;
+}
+
+/* Control */
+
+// Wait until the worker has finished the job it was last handed, if that
+// job reads the given spectra (NULL: whatever it reads)
+static void wait_worker(const float *spectra)
+{
+#if CONVOLVER_WORKER_ENABLED
+    for (int waited = 0; waited < COEFF_BANK_ACK_TIMEOUT_MS &&
+                         __atomic_load_n(&s_done_seq, __ATOMIC_SEQ_CST) !=
+                         __atomic_load_n(&s_job_seq, __ATOMIC_SEQ_CST) &&
+                         (spectra == NULL || s_job.spectra == spectra); waited++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+#else
+    (void)spectra;
+#endif
+}
+
+// Publish the current set again, so both sets reference the live spectra;
+// returns the other spectra buffer, which no set, block or worker job uses
+static int retire(convolver_t *cv)
+{
+    convolver_params_t *p = (convolver_params_t *)coeff_bank_begin_write(
+        &cv->bank, cv->params, sizeof(convolver_params_t));
+    const int spare = (p->spectra == s_spectra[0]) ? 1 : 0;
+    coeff_bank_publish(&cv->bank);
+
+    // A job handed over before the publish may still read the spare buffer
+    wait_worker(s_spectra[spare]);
+    return spare;
+}
+
+// Allocate the delay line on first use (the audio path only reads it once a
+// response is published)
+static esp_err_t ensure_history(convolver_t *cv)
+{
+    if (cv->fdl != NULL) {
+        return ESP_OK;
+    }
+    const size_t fdl_bytes = MAX_PARTS * SLOT_FLOATS * sizeof(float);
+    const size_t history_bytes = HISTORY_FRAMES * 2 * sizeof(float);
+    float *fdl = (float *)alloc_prefer(fdl_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM);
+    float *history = (float *)alloc_prefer(history_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM);
+    if (fdl == NULL || history == NULL) {
+        heap_caps_free(fdl);
+        heap_caps_free(history);
+        return ESP_ERR_NO_MEM;
+    }
+    cv->history = history;
+    cv->fdl = fdl;
+    s_history_bytes = fdl_bytes + history_bytes;
+    return ESP_OK;
+}
+
+// Transform a response (taps per channel, left then right) and swap it in
+static esp_err_t design(convolver_t *cv, const float *taps, const convolver_ir_header_t *header)
+{
+    const int parts = (int)((header->taps + PART_FRAMES - 1) / PART_FRAMES);
+    const int channels = header->channels;
+    const size_t bytes = (size_t)parts * channels * CHANNEL_FLOATS * sizeof(float);
+
+    esp_err_t err = ensure_history(cv);
+    if (err != ESP_OK) {
+        return err;
+    }
+    float *work = (float *)heap_caps_aligned_alloc(16, 2 * FFT_SIZE * sizeof(float), MALLOC_CAP_8BIT);
+    if (work == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Spectra are large and read sequentially: PSRAM is fine
+    const int slot = retire(cv);
+    heap_caps_free(s_spectra[slot]);
+    s_spectra_bytes[slot] = 0;
+    s_spectra[slot] = (float *)alloc_prefer(bytes, MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT);
+    if (s_spectra[slot] == NULL) {
+        heap_caps_free(work);
+        return ESP_ERR_NO_MEM;
+    }
+    s_spectra_bytes[slot] = bytes;
+
+    const float scale = 1.0f / FFT_SIZE;
+    float *spectra = s_spectra[slot];
+    for (int q = 0; q < parts; q++) {
+        for (int ch = 0; ch < channels; ch++) {
+            const float *h = taps + (size_t)ch * header->taps + (size_t)q * PART_FRAMES;
+            const uint32_t n = (header->taps - q * PART_FRAMES < PART_FRAMES) ?
+                               header->taps - q * PART_FRAMES : PART_FRAMES;
+            memset(work, 0, 2 * FFT_SIZE * sizeof(float));
+            for (uint32_t i = 0; i < n; i++) {
+                work[2 * i] = h[i] * scale;
+            }
+            dsps_fft2r_fc32(work, FFT_SIZE);
+            dsps_bit_rev_fc32(work, FFT_SIZE);
+            memcpy(spectra + (q * channels + ch) * CHANNEL_FLOATS, work, CHANNEL_FLOATS * sizeof(float));
+        }
+    }
+    heap_caps_free(work);
+
+    convolver_params_t *p = (convolver_params_t *)coeff_bank_begin_write(
+        &cv->bank, cv->params, sizeof(convolver_params_t));
+    p->spectra = spectra;
+    p->partitions = parts;
+    p->channels = channels;
+    p->taps = header->taps;
+    p->sample_rate = header->sample_rate;
+    p->generation = ++s_generation;
+    coeff_bank_publish(&cv->bank);
+
+    ESP_LOGI(TAG, "Impulse response: %lu taps x %d channel(s), %d partitions of %d frames (%u bytes)",
+             (unsigned long)header->taps, channels, parts, PART_FRAMES, (unsigned)bytes);
+    return ESP_OK;
+}
+
+static bool header_valid(const convolver_ir_header_t *header)
+{
+    return header->magic == CONVOLVER_IR_MAGIC && header->taps >= 1 &&
+           header->taps <= CONVOLVER_MAX_TAPS && (header->channels == 1 || header->channels == 2);
+}
+
+static size_t tap_bytes(const convolver_ir_header_t *header)
+{
+    return (size_t)header->taps * header->channels * sizeof(float);
+}
+
+static const esp_partition_t *ir_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    CONVOLVER_IR_PARTITION);
+}
+
+static esp_err_t save_to_flash(const convolver_ir_header_t *header, const float *taps)
+{
+    const esp_partition_t *part = ir_partition();
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition in the partition table", CONVOLVER_IR_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    const size_t size = sizeof(*header) + tap_bytes(header);
+    if (size > part->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const size_t erase = (size + part->erase_size - 1) / part->erase_size * part->erase_size;
+    s_stored = false;
+    esp_err_t err = esp_partition_erase_range(part, 0, erase);
+    if (err == ESP_OK) {
+        err = esp_partition_write(part, sizeof(*header), taps, tap_bytes(header));
+    }
+    if (err == ESP_OK) {
+        // Header last: a save cut short leaves no valid response behind
+        err = esp_partition_write(part, 0, header, sizeof(*header));
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store impulse response: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_stored = true;
+    ESP_LOGI(TAG, "Impulse response stored (%u bytes)", (unsigned)size);
+    return ESP_OK;
+}
+
+static void release_staging(void)
+{
+    heap_caps_free(s_staging);
+    s_staging = NULL;
+    s_received = 0;
+}
+
+static esp_err_t load_from_flash(convolver_t *cv)
+{
+    const esp_partition_t *part = ir_partition();
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    convolver_ir_header_t header;
+    esp_err_t err = esp_partition_read(part, 0, &header, sizeof(header));
+    if (err != ESP_OK || header.magic == 0xFFFFFFFFu) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!header_valid(&header) || sizeof(header) + tap_bytes(&header) > part->size) {
+        ESP_LOGW(TAG, "Stored impulse response not recognized");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    float *taps = (float *)alloc_prefer(tap_bytes(&header), MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT);
+    if (taps == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = esp_partition_read(part, sizeof(header), taps, tap_bytes(&header));
+    if (err == ESP_OK && esp_crc32_le(0, (const uint8_t *)taps, tap_bytes(&header)) != header.crc32) {
+        ESP_LOGW(TAG, "Stored impulse response CRC mismatch");
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err == ESP_OK) {
+        s_stored = true;
+        err = design(cv, taps, &header);
+    }
+    heap_caps_free(taps);
+    return err;
+}
+
+esp_err_t convolver_init(convolver_t *convolver, uint32_t sample_rate)
+{
+    memset(convolver, 0, sizeof(convolver_t));
+    coeff_bank_reset(&convolver->bank);
+    convolver->gain_db = CONVOLVER_DEFAULT_DB;
+    convolver->params[0].gain_linear = 1.0f;
+    param_ramp_init(&convolver->ramp, 1.0f);
+    convolver->sample_rate = sample_rate;
+    convolver->reset_pending = true;
+    convolver->enabled = true;
+
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+    }
+    esp_err_t err = dsps_fft2r_init_fc32(NULL, FFT_TABLE_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize FFT tables: %s", esp_err_to_name(err));
+        return err;
+    }
+
+#if CONVOLVER_WORKER_ENABLED
+    BaseType_t created = xTaskCreatePinnedToCore(worker_task, "conv_worker", 3072, NULL,
+                                                 configMAX_PRIORITIES - 2, &s_worker, WORKER_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create convolver worker task");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    err = load_from_flash(convolver);
+    xSemaphoreGive(s_lock);
+    if (err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGI(TAG, "No impulse response stored, passing audio through");
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Stored impulse response not loaded: %s", esp_err_to_name(err));
+    }
+
+    ESP_LOGI(TAG, "Convolver: %d-point FFT, %d-frame partitions, up to %d taps%s",
+             FFT_SIZE, PART_FRAMES, CONVOLVER_MAX_TAPS,
+             CONVOLVER_WORKER_ENABLED ? ", tail on the second core" : "");
+    return (err == ESP_ERR_NO_MEM) ? err : ESP_OK;
+}
+
+void convolver_set_gain(convolver_t *convolver, float gain_db)
+{
+    if (gain_db < CONVOLVER_MIN_DB) gain_db = CONVOLVER_MIN_DB;
+    if (gain_db > CONVOLVER_MAX_DB) gain_db = CONVOLVER_MAX_DB;
+    convolver->gain_db = gain_db;
+
+    convolver_params_t *p = (convolver_params_t *)coeff_bank_begin_write(
+        &convolver->bank, convolver->params, sizeof(convolver_params_t));
+    p->gain_linear = dsp_db_to_linear(gain_db);
+    coeff_bank_publish(&convolver->bank);
+}
+
+void convolver_set_enabled(convolver_t *convolver, bool enabled)
+{
+    if (enabled && !convolver->enabled) {
+        coeff_bank_set_flag(&convolver->reset_pending, true);
+    }
+    coeff_bank_set_flag(&convolver->enabled, enabled);
+}
+
+void convolver_reset(convolver_t *convolver)
+{
+    coeff_bank_set_flag(&convolver->reset_pending, true);
+}
+
+esp_err_t convolver_ir_begin(convolver_t *convolver, const convolver_ir_header_t *header)
+{
+    if (!header_valid(header)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    release_staging();
+    s_staging = (float *)alloc_prefer(tap_bytes(header), MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT);
+    esp_err_t err = ESP_OK;
+    if (s_staging == NULL) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        s_upload = *header;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t convolver_ir_write(convolver_t *convolver, uint32_t offset, const void *data, size_t len)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_staging == NULL || offset != s_received) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (len > tap_bytes(&s_upload) - s_received) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy((uint8_t *)s_staging + offset, data, len);
+        s_received += len;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t convolver_ir_commit(convolver_t *convolver, bool save)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_staging == NULL) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (s_received != tap_bytes(&s_upload)) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        const uint32_t crc = esp_crc32_le(0, (const uint8_t *)s_staging, s_received);
+        if (s_upload.crc32 != 0 && s_upload.crc32 != crc) {
+            err = ESP_ERR_INVALID_CRC;
+        } else {
+            s_upload.crc32 = crc;
+            err = design(convolver, s_staging, &s_upload);
+            if (err == ESP_OK && save) {
+                err = save_to_flash(&s_upload, s_staging);
+            }
+        }
+    }
+    if (err != ESP_ERR_INVALID_STATE) {
+        release_staging();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void convolver_ir_abort(convolver_t *convolver)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    release_staging();
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t convolver_ir_clear(convolver_t *convolver, bool erase)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    convolver_params_t *p = (convolver_params_t *)coeff_bank_begin_write(
+        &convolver->bank, convolver->params, sizeof(convolver_params_t));
+    p->spectra = NULL;
+    p->partitions = 0;
+    p->channels = 0;
+    p->taps = 0;
+    p->sample_rate = 0;
+    p->generation = ++s_generation;
+    coeff_bank_publish(&convolver->bank);
+
+    // Once the cleared set is in both slots no block reads the spectra; a
+    // job handed over before that may still read either buffer, so wait for
+    // the worker to finish it whichever it uses (retire's spare index means
+    // nothing here, the live set has no spectra)
+    retire(convolver);
+    wait_worker(NULL);
+    for (int i = 0; i < 2; i++) {
+        heap_caps_free(s_spectra[i]);
+        s_spectra[i] = NULL;
+        s_spectra_bytes[i] = 0;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (erase) {
+        const esp_partition_t *part = ir_partition();
+        if (part != NULL) {
+            err = esp_partition_erase_range(part, 0, part->erase_size);
+            if (err == ESP_OK) {
+                s_stored = false;
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Impulse response cleared%s", (erase && err == ESP_OK) ? " and erased" : "");
+    return err;
+}
+
+void convolver_get_info(const convolver_t *convolver, convolver_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    const convolver_params_t *p = &convolver->params[convolver->bank.published];
+    info->loaded = (p->spectra != NULL);
+    info->stored = s_stored;
+    info->taps = p->taps;
+    info->channels = p->channels;
+    info->partitions = p->partitions;
+    info->sample_rate = p->sample_rate;
+    info->rate_mismatch = info->loaded && p->sample_rate != 0 && p->sample_rate != convolver->sample_rate;
+    info->memory = s_spectra_bytes[0] + s_spectra_bytes[1] + s_history_bytes;
+    info->blocks = convolver->blocks;
+    info->skipped = convolver->skipped;
+    info->late = convolver->late;
+}
+
+void convolver_get_settings(const convolver_t *convolver, convolver_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->gain_db = convolver->gain_db;
+    settings->enabled = convolver->enabled ? 1 : 0;
+}
+
+void convolver_apply_settings(convolver_t *convolver, const convolver_settings_t *settings)
+{
+    convolver_set_gain(convolver, settings->gain_db);
+    convolver_set_enabled(convolver, settings->enabled != 0);
+}
+
+#else
+
+void convolver_set_gain(convolver_t *convolver, float gain_db) {}
+void convolver_set_enabled(convolver_t *convolver, bool enabled) {}
+void convolver_reset(convolver_t *convolver) {}
+
+esp_err_t convolver_ir_begin(convolver_t *convolver, const convolver_ir_header_t *header)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t convolver_ir_write(convolver_t *convolver, uint32_t offset, const void *data, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t convolver_ir_commit(convolver_t *convolver, bool save)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void convolver_ir_abort(convolver_t *convolver) {}
+
+esp_err_t convolver_ir_clear(convolver_t *convolver, bool erase)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void convolver_get_info(const convolver_t *convolver, convolver_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+}
+
+void convolver_get_settings(const convolver_t *convolver, convolver_settings_t *settings)
+{
+    // The defaults of a build with the convolver, so switching builds keeps them
+    memset(settings, 0, sizeof(*settings));
+    settings->gain_db = CONVOLVER_DEFAULT_DB;
+    settings->enabled = 1;
+}
+
+void convolver_apply_settings(convolver_t *convolver, const convolver_settings_t *settings) {}
+
+#endif
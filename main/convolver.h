@@ -0,0 +1,313 @@
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_config.h"
+#include "coeff_bank.h"
+#include "param_ramp.h"
+
+// FIR convolver (room correction)
+// Runs impulse responses of up to CONVOLVER_MAX_TAPS taps per channel with
+// uniformly partitioned overlap-save FFT convolution. One partition is one
+// audio block (DMA_BUFFER_SIZE / 2 frames), so the stage adds no latency:
+// each block is transformed once (left and right in one complex FFT), its
+// spectrum enters a frequency-domain delay line, and the output is the
+// inverse transform of the delay line multiplied by the partition spectra of
+// the impulse response. With CONVOLVER_WORKER the partitions that only need
+// past blocks are summed on the other core while the next block is being
+// captured; the audio task then only adds the newest block times the first
+// partition.
+//
+// Impulse responses are uploaded in pieces (MQTT esp-dsp/conv/ir, serial
+// 'conv ir'), transformed by the uploading task and swapped in at a block
+// boundary through the coeff_bank. They can be stored in the "ir" flash
+// partition and are loaded from it at boot.
+
+#ifdef CONFIG_CONVOLVER
+#define CONVOLVER_ENABLED           1
+#define CONVOLVER_MAX_TAPS          CONFIG_CONVOLVER_MAX_TAPS
+#else
+#define CONVOLVER_ENABLED           0
+#define CONVOLVER_MAX_TAPS          2048
+#endif
+
+#if CONVOLVER_ENABLED && defined(CONFIG_CONVOLVER_WORKER) && !defined(CONFIG_FREERTOS_UNICORE)
+#define CONVOLVER_WORKER_ENABLED    1
+#else
+#define CONVOLVER_WORKER_ENABLED    0
+#endif
+
+// Partition length (frames) and FFT size (next power of two >= 2 partitions)
+#define CONVOLVER_PARTITION_FRAMES  (DMA_BUFFER_SIZE / 2)
+#define CONVOLVER_FFT_SIZE          (CONVOLVER_PARTITION_FRAMES <= 32 ? 64 :    \
+                                     CONVOLVER_PARTITION_FRAMES <= 64 ? 128 :   \
+                                     CONVOLVER_PARTITION_FRAMES <= 128 ? 256 :  \
+                                     CONVOLVER_PARTITION_FRAMES <= 256 ? 512 : 1024)
+#define CONVOLVER_BINS              (CONVOLVER_FFT_SIZE / 2 + 1)
+#define CONVOLVER_MAX_PARTITIONS    ((CONVOLVER_MAX_TAPS + CONVOLVER_PARTITION_FRAMES - 1) / CONVOLVER_PARTITION_FRAMES)
+
+// Output gain (typically negative: correction filters boost some bands)
+#define CONVOLVER_MIN_DB            -24.0f
+#define CONVOLVER_MAX_DB            12.0f
+#define CONVOLVER_DEFAULT_DB        0.0f
+
+// Impulse response upload / flash format
+#define CONVOLVER_IR_MAGIC          0x31524946u     // "FIR1"
+#define CONVOLVER_IR_PARTITION      "ir"            // Data partition (partitions.csv)
+
+typedef struct {
+    uint32_t magic;                         // CONVOLVER_IR_MAGIC
+    uint32_t taps;                          // Taps per channel (1..CONVOLVER_MAX_TAPS)
+    uint16_t channels;                      // 1: same response on both channels, 2: left then right
+    uint16_t reserved;
+    uint32_t sample_rate;                   // Rate the response was measured for, 0 = any
+    uint32_t crc32;                         // CRC-32 of the tap data, 0 = not checked (upload only)
+} convolver_ir_header_t;
+// Followed by channels * taps little-endian float32 taps (full scale = 1.0)
+
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
+typedef struct {
+    const float *spectra;                   // [partition][channel][bin][re, im], 1/N scaled; NULL = no response
+    int partitions;                         // Partitions in use (ceil(taps / CONVOLVER_PARTITION_FRAMES))
+    int channels;                           // Spectra per partition (1 or 2)
+    uint32_t taps;
+    uint32_t sample_rate;                   // As convolver_ir_header_t
+    uint32_t generation;                    // Bumped by every response swap
+    float gain_linear;                      // Output gain
+} convolver_params_t;
+
+// Convolver structure
+typedef struct {
+    convolver_params_t params[2];           // Published / shadow parameter sets
+    coeff_bank_t bank;                      // Publish state for params
+    param_ramp_t ramp;                      // Gain actually applied (audio task only)
+    float gain_db;                          // Output gain in dB
+    bool enabled;                           // Enable/disable convolution
+    volatile bool reset_pending;            // Clear the history at the next block
+    uint32_t sample_rate;                   // Current chain rate (audio task)
+    // Block history (allocated with the first response, audio task only)
+    float *fdl;                             // Spectra of the last CONVOLVER_MAX_PARTITIONS blocks
+    float *history;                         // Last FFT_SIZE - PARTITION_FRAMES input frames (L, R)
+    int head;                               // fdl slot of the newest block
+    // Statistics
+    volatile uint32_t blocks;               // Blocks convolved
+    volatile uint32_t skipped;              // Blocks passed through (block size or rate mismatch)
+    volatile uint32_t late;                 // Blocks the worker had not finished in time
+} convolver_t;
+
+// What is loaded (convolver_get_info)
+typedef struct {
+    bool loaded;                            // A response is active
+    bool stored;                            // The flash partition holds a valid response
+    uint32_t taps;
+    int channels;
+    int partitions;
+    uint32_t sample_rate;                   // Of the loaded response, 0 = any
+    bool rate_mismatch;                     // Loaded for a different rate: bypassed
+    size_t memory;                          // Bytes allocated for spectra and history
+    uint32_t blocks;
+    uint32_t skipped;
+    uint32_t late;
+} convolver_info_t;
+
+// Persistent settings (packed into the settings blob, see settings_blob.h);
+// the response itself is stored in its flash partition
+typedef struct {
+    float gain_db;                          // Output gain in dB
+    uint8_t enabled;                        // Convolution enabled
+    uint8_t reserved[3];
+} convolver_settings_t;
+
+#if CONVOLVER_ENABLED
+
+/**
+ * Initialize the convolver and load the stored impulse response
+ *
+ * Starts the worker task with CONVOLVER_WORKER.
+ *
+ * @param convolver Pointer to convolver structure
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK (also when no response is stored), or ESP_ERR_NO_MEM
+ */
+esp_err_t convolver_init(convolver_t *convolver, uint32_t sample_rate);
+
+/**
+ * Follow a sample rate change (while the audio path is parked, see audio_rate.h)
+ *
+ * Responses measured for another rate are bypassed until one for this rate
+ * is loaded.
+ *
+ * @param convolver Pointer to convolver structure
+ * @param sample_rate New rate in Hz
+ */
+void convolver_set_sample_rate(convolver_t *convolver, uint32_t sample_rate);
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ *
+ * Must be paired with convolver_end_block.
+ *
+ * @param convolver Pointer to convolver structure
+ * @return Parameters to use for this block
+ */
+const convolver_params_t *convolver_begin_block(convolver_t *convolver);
+
+/**
+ * Release the parameters latched by convolver_begin_block (audio task only)
+ *
+ * @param convolver Pointer to convolver structure
+ */
+void convolver_end_block(convolver_t *convolver);
+
+/**
+ * Check whether a block with these parameters is convolved
+ *
+ * @param convolver Pointer to convolver structure
+ * @param params Parameters from convolver_begin_block
+ * @return true if enabled with a response for the current rate
+ */
+bool convolver_block_active(const convolver_t *convolver, const convolver_params_t *params);
+
+/**
+ * Convolve one block with latched parameters (24-bit samples, in place)
+ *
+ * Shared by convolver_process and the fused DSP chain. Blocks of another
+ * size than DMA_BUFFER_SIZE (low-latency I/O periods) are passed through
+ * and counted as skipped.
+ *
+ * @param convolver Pointer to convolver structure
+ * @param params Parameters from convolver_begin_block
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void convolver_process_block(convolver_t *convolver, const convolver_params_t *params,
+                             int32_t *buffer, int num_samples);
+
+/**
+ * Process audio through the convolver
+ *
+ * @param convolver Pointer to convolver structure
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void convolver_process(convolver_t *convolver, int32_t *buffer, int num_samples);
+
+/**
+ * Process a float block through the convolver (float32 chain)
+ *
+ * @param convolver Pointer to convolver structure
+ * @param buffer Audio buffer (interleaved stereo, 24-bit scale)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void convolver_process_f32(convolver_t *convolver, float *buffer, int num_samples);
+
+#else
+
+static inline esp_err_t convolver_init(convolver_t *convolver, uint32_t sample_rate) { (void)convolver; (void)sample_rate; return ESP_OK; }
+static inline void convolver_set_sample_rate(convolver_t *convolver, uint32_t sample_rate) { (void)convolver; (void)sample_rate; }
+
+#endif
+
+/**
+ * Set the output gain
+ *
+ * @param convolver Pointer to convolver structure
+ * @param gain_db Gain in dB (clamped to CONVOLVER_MIN_DB..CONVOLVER_MAX_DB)
+ */
+void convolver_set_gain(convolver_t *convolver, float gain_db);
+
+/**
+ * Enable or disable convolution (enabling starts from a clear history)
+ *
+ * @param convolver Pointer to convolver structure
+ * @param enabled true to enable, false to bypass
+ */
+void convolver_set_enabled(convolver_t *convolver, bool enabled);
+
+/**
+ * Clear the block history (next block)
+ *
+ * @param convolver Pointer to convolver structure
+ */
+void convolver_reset(convolver_t *convolver);
+
+/**
+ * Start an impulse response upload
+ *
+ * Allocates the staging buffer; an upload already in progress is discarded.
+ *
+ * @param convolver Pointer to convolver structure
+ * @param header Response format (magic, taps, channels, rate, optional CRC)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unsupported format, ESP_ERR_NO_MEM,
+ *         ESP_ERR_NOT_SUPPORTED if the convolver is compiled out
+ */
+esp_err_t convolver_ir_begin(convolver_t *convolver, const convolver_ir_header_t *header);
+
+/**
+ * Add tap data to the upload (in order)
+ *
+ * @param convolver Pointer to convolver structure
+ * @param offset Byte offset in the tap data; must equal the bytes received so far
+ * @param data Little-endian float32 taps (may end between two taps)
+ * @param len Bytes
+ * @return ESP_OK, ESP_ERR_INVALID_STATE without an upload or out of order,
+ *         ESP_ERR_INVALID_SIZE past the end of the response
+ */
+esp_err_t convolver_ir_write(convolver_t *convolver, uint32_t offset, const void *data, size_t len);
+
+/**
+ * Finish the upload: transform the response and swap it in
+ *
+ * @param convolver Pointer to convolver structure
+ * @param save Also write the response to the flash partition
+ * @return ESP_OK, ESP_ERR_INVALID_STATE without an upload, ESP_ERR_INVALID_SIZE
+ *         if data is missing, ESP_ERR_INVALID_CRC, ESP_ERR_NO_MEM, or the
+ *         flash error (the response is active even if saving failed)
+ */
+esp_err_t convolver_ir_commit(convolver_t *convolver, bool save);
+
+/**
+ * Discard an upload in progress
+ *
+ * @param convolver Pointer to convolver structure
+ */
+void convolver_ir_abort(convolver_t *convolver);
+
+/**
+ * Unload the response (the convolver passes audio through)
+ *
+ * @param convolver Pointer to convolver structure
+ * @param erase Also erase the stored response
+ * @return ESP_OK, the flash error, or ESP_ERR_NOT_SUPPORTED if compiled out
+ */
+esp_err_t convolver_ir_clear(convolver_t *convolver, bool erase);
+
+/**
+ * Get the loaded response and statistics
+ *
+ * @param convolver Pointer to convolver structure
+ * @param info Destination (all zero if compiled out)
+ */
+void convolver_get_info(const convolver_t *convolver, convolver_info_t *info);
+
+/**
+ * Copy the persistent settings
+ *
+ * @param convolver Pointer to convolver structure
+ * @param settings Destination
+ */
+void convolver_get_settings(const convolver_t *convolver, convolver_settings_t *settings);
+
+/**
+ * Apply persistent settings
+ *
+ * @param convolver Pointer to convolver structure
+ * @param settings Settings from convolver_get_settings
+ */
+void convolver_apply_settings(convolver_t *convolver, const convolver_settings_t *settings);
+
+#endif // CONVOLVER_H
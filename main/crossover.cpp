@@ -0,0 +1,474 @@
+#include "crossover.h"
+#include "dsp_attr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "CROSSOVER";
+
+#if CROSSOVER_ENABLED
+#include "dsp_tables.h"
+#include "esp_heap_caps.h"
+
+static_assert(CROSSOVER_WAYS >= 2 && CROSSOVER_WAYS <= CROSSOVER_SETTINGS_WAYS, "2 or 3 ways");
+static_assert(CROSSOVER_WAYS <= BAND_SPLIT_MAX_BANDS, "one band per way");
+static_assert(!CROSSOVER_OUTPUT_I2S1 || CROSSOVER_WAYS == 2, "the second I2S port carries one way");
+static_assert((CROSSOVER_DELAY_FRAMES & (CROSSOVER_DELAY_FRAMES - 1)) == 0, "delay line length must be a power of two");
+
+#define FRAMES          (DMA_BUFFER_SIZE / 2)
+#define DELAY_MASK      (CROSSOVER_DELAY_FRAMES - 1)
+
+// 24-bit output range
+#define OUT_MAX         8388607
+#define OUT_MIN         (-8388608)
+
+// Default points
+#define DEFAULT_FREQ_2WAY   2000.0f
+#define DEFAULT_FREQ_LOW    300.0f
+#define DEFAULT_FREQ_HIGH   3000.0f
+
+#if CROSSOVER_WAYS == 2
+static const char *const s_way_names[CROSSOVER_WAYS] = { "low", "high" };
+#else
+static const char *const s_way_names[CROSSOVER_WAYS] = { "low", "mid", "high" };
+#endif
+
+/* Audio path */
+
+static void clear_history(crossover_state_t *st)
+{
+    band_split_reset(&st->split);
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        memset(st->ways[w].delay, 0, sizeof(st->ways[w].delay));
+    }
+    st->delay_pos = 0;
+}
+
+static DSP_HOT_INLINE crossover_sample_t apply_gain(crossover_sample_t x, float g)
+{
+#if CROSSOVER_FLOAT_KERNEL
+    return g * x;
+#else
+    float y = g * (float)x;
+    if (y > 2147483520.0f) y = 2147483520.0f;
+    if (y < -2147483648.0f) y = -2147483648.0f;
+    return (int32_t)lrintf(y);
+#endif
+}
+
+static DSP_HOT_INLINE int32_t pack_sample(crossover_sample_t x)
+{
+#if CROSSOVER_FLOAT_KERNEL
+    long v = lrintf(x);
+#else
+    int32_t v = x;
+#endif
+    if (v > OUT_MAX) v = OUT_MAX;
+    if (v < OUT_MIN) v = OUT_MIN;
+    return (int32_t)((uint32_t)v << 8);
+}
+
+// Gain (ramped, sign = polarity) and delay of one way, in place. A delay
+// change crossfades from the old tap to the new one over the block.
+static void DSP_HOT gain_and_delay(crossover_way_t *way, float gain, int delay, int *delay_now,
+                                   int pos, int num_frames)
+{
+    crossover_sample_t *x = way->block;
+    param_ramp_t ramp = way->gain;
+    const bool ramping = param_ramp_retarget(&ramp, gain);
+    const int old_delay = *delay_now;
+    const float fade_step = 1.0f / (float)num_frames;
+
+    for (int i = 0; i < num_frames; i++) {
+        const float g = ramping ? param_ramp_next(&ramp) : gain;
+        const int w = (pos + i) & DELAY_MASK;
+        way->delay[2 * w] = apply_gain(x[2 * i], g);
+        way->delay[2 * w + 1] = apply_gain(x[2 * i + 1], g);
+
+        const int r = (pos + i - delay) & DELAY_MASK;
+        if (old_delay == delay) {
+            x[2 * i] = way->delay[2 * r];
+            x[2 * i + 1] = way->delay[2 * r + 1];
+        } else {
+            const int o = (pos + i - old_delay) & DELAY_MASK;
+            const float t = (float)(i + 1) * fade_step;
+#if CROSSOVER_FLOAT_KERNEL
+            x[2 * i] = t * way->delay[2 * r] + (1.0f - t) * way->delay[2 * o];
+            x[2 * i + 1] = t * way->delay[2 * r + 1] + (1.0f - t) * way->delay[2 * o + 1];
+#else
+            x[2 * i] = (int32_t)lrintf(t * (float)way->delay[2 * r] + (1.0f - t) * (float)way->delay[2 * o]);
+            x[2 * i + 1] = (int32_t)lrintf(t * (float)way->delay[2 * r + 1] + (1.0f - t) * (float)way->delay[2 * o + 1]);
+#endif
+        }
+    }
+    way->gain = ramp;
+    *delay_now = delay;
+}
+
+void DSP_HOT crossover_process(crossover_t *crossover, const int32_t *input, int32_t *output, int num_samples)
+{
+    crossover_state_t *st = crossover->state;
+    const int num_frames = num_samples / 2;
+    if (st == NULL) {
+        // Nothing to drive the ways with: keep every output silent
+        memset(output, 0, (size_t)num_frames * CROSSOVER_OUT_CHANNELS * sizeof(int32_t));
+        return;
+    }
+    if (crossover->reset_pending) {
+        crossover->reset_pending = false;
+        clear_history(st);
+    }
+
+    // 24-bit right-justified, like the chain's processing format
+    for (int i = 0; i < num_samples; i++) {
+        st->input[i] = (crossover_sample_t)(input[i] >> 8);
+    }
+
+    const crossover_params_t *p = &crossover->params[coeff_bank_acquire(&crossover->bank)];
+    crossover_sample_t *bands[CROSSOVER_WAYS];
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        bands[w] = st->ways[w].block;
+    }
+#if CROSSOVER_FLOAT_KERNEL
+    band_split_process_f32(&p->split, &st->split, st->input, bands, num_samples);
+#else
+    band_split_process(&p->split, &st->split, st->input, bands, num_samples);
+#endif
+
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        crossover_way_t *way = &st->ways[w];
+        gain_and_delay(way, p->gain_linear[w], p->delay_frames[w], &st->delay_now[w],
+                       st->delay_pos, num_frames);
+#if CROSSOVER_FLOAT_KERNEL
+        limiter_process_f32(&way->limiter, way->block, num_samples);
+#else
+        limiter_process(&way->limiter, way->block, num_samples);
+#endif
+
+#if CROSSOVER_OUTPUT_TDM
+        int32_t *out = output + 2 * w;
+        for (int i = 0; i < num_frames; i++) {
+            out[i * CROSSOVER_OUT_CHANNELS] = pack_sample(way->block[2 * i]);
+            out[i * CROSSOVER_OUT_CHANNELS + 1] = pack_sample(way->block[2 * i + 1]);
+        }
+#else
+        int32_t *out = output + w * num_samples;
+        for (int i = 0; i < num_samples; i++) {
+            out[i] = pack_sample(way->block[i]);
+        }
+#endif
+    }
+    coeff_bank_release(&crossover->bank);
+    st->delay_pos = (st->delay_pos + num_frames) & DELAY_MASK;
+}
+
+/* Control */
+
+static uint16_t delay_frames(float delay_ms, uint32_t sample_rate)
+{
+    long frames = lrintf(delay_ms * (float)sample_rate / 1000.0f);
+    if (frames > CROSSOVER_DELAY_FRAMES - 1) frames = CROSSOVER_DELAY_FRAMES - 1;
+    if (frames < 0) frames = 0;
+    return (uint16_t)frames;
+}
+
+// Bake the whole parameter set from the configuration
+static void bake(const crossover_t *crossover, crossover_params_t *p)
+{
+    const crossover_settings_t *cfg = &crossover->config;
+    band_split_design(&p->split, CROSSOVER_WAYS, cfg->freq, crossover->sample_rate);
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        const crossover_way_settings_t *way = &cfg->ways[w];
+        const float g = dsp_db_to_linear(way->gain_db);
+        p->gain_linear[w] = way->invert ? -g : g;
+        p->delay_frames[w] = delay_frames(way->delay_ms, crossover->sample_rate);
+    }
+}
+
+static void publish(crossover_t *crossover)
+{
+    crossover_params_t *p = (crossover_params_t *)coeff_bank_begin_write(
+        &crossover->bank, crossover->params, sizeof(crossover_params_t));
+    bake(crossover, p);
+    coeff_bank_publish(&crossover->bank);
+}
+
+static void default_settings(crossover_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+#if CROSSOVER_WAYS == 2
+    settings->freq[0] = DEFAULT_FREQ_2WAY;
+    settings->freq[1] = DEFAULT_FREQ_HIGH;
+#else
+    settings->freq[0] = DEFAULT_FREQ_LOW;
+    settings->freq[1] = DEFAULT_FREQ_HIGH;
+#endif
+    for (int w = 0; w < CROSSOVER_SETTINGS_WAYS; w++) {
+        settings->ways[w].limit_db = LIMITER_THRESHOLD_DB;
+#ifdef CONFIG_LIMITER_TRUE_PEAK
+        settings->ways[w].true_peak = 1;
+#endif
+    }
+    settings->num_ways = CROSSOVER_WAYS;
+}
+
+static void *alloc_prefer(size_t bytes, uint32_t first, uint32_t fallback)
+{
+    void *p = heap_caps_aligned_calloc(16, 1, bytes, first);
+    if (p == NULL) {
+        p = heap_caps_aligned_calloc(16, 1, bytes, fallback);
+    }
+    return p;
+}
+
+esp_err_t crossover_init(crossover_t *crossover, uint32_t sample_rate)
+{
+    memset(crossover, 0, sizeof(crossover_t));
+    coeff_bank_reset(&crossover->bank);
+    default_settings(&crossover->config);
+    crossover->sample_rate = sample_rate;
+    bake(crossover, &crossover->params[0]);
+    crossover->reset_pending = true;
+
+    // Read every block: internal RAM if it fits
+    crossover_state_t *st = (crossover_state_t *)alloc_prefer(
+        sizeof(crossover_state_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM);
+    if (st == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes of crossover state, outputs muted",
+                 (unsigned)sizeof(crossover_state_t));
+        return ESP_ERR_NO_MEM;
+    }
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        crossover_way_t *way = &st->ways[w];
+        limiter_init(&way->limiter, sample_rate);
+        limiter_set_threshold(&way->limiter, crossover->config.ways[w].limit_db);
+        limiter_set_true_peak(&way->limiter, crossover->config.ways[w].true_peak != 0);
+        param_ramp_init(&way->gain, crossover->params[0].gain_linear[w]);
+        st->delay_now[w] = crossover->params[0].delay_frames[w];
+    }
+    crossover->state = st;
+
+    ESP_LOGI(TAG, "%d-way Linkwitz-Riley crossover on %s outputs (%u bytes of state)",
+             CROSSOVER_WAYS, crossover_output_name(), (unsigned)sizeof(crossover_state_t));
+    return ESP_OK;
+}
+
+void crossover_set_sample_rate(crossover_t *crossover, uint32_t sample_rate)
+{
+    crossover->sample_rate = sample_rate;
+    publish(crossover);
+    if (crossover->state != NULL) {
+        for (int w = 0; w < CROSSOVER_WAYS; w++) {
+            limiter_set_sample_rate(&crossover->state->ways[w].limiter, sample_rate);
+        }
+    }
+    crossover->reset_pending = true;
+}
+
+static bool freq_valid(const crossover_t *crossover, int point, float freq)
+{
+    if (point < 0 || point >= CROSSOVER_POINTS) {
+        return false;
+    }
+    if (freq < CROSSOVER_MIN_FREQ || freq > CROSSOVER_MAX_FREQ ||
+        freq > BAND_SPLIT_MAX_FREQ_RATIO * (float)crossover->sample_rate) {
+        return false;
+    }
+    if (point > 0 && freq <= crossover->config.freq[point - 1]) {
+        return false;
+    }
+    if (point < CROSSOVER_POINTS - 1 && freq >= crossover->config.freq[point + 1]) {
+        return false;
+    }
+    return true;
+}
+
+bool crossover_set_freq(crossover_t *crossover, int point, float freq)
+{
+    if (!freq_valid(crossover, point, freq)) {
+        return false;
+    }
+    crossover->config.freq[point] = freq;
+    publish(crossover);
+    return true;
+}
+
+bool crossover_set_gain(crossover_t *crossover, int way, float gain_db)
+{
+    if (way < 0 || way >= CROSSOVER_WAYS) {
+        return false;
+    }
+    if (gain_db < CROSSOVER_MIN_DB) gain_db = CROSSOVER_MIN_DB;
+    if (gain_db > CROSSOVER_MAX_DB) gain_db = CROSSOVER_MAX_DB;
+    crossover->config.ways[way].gain_db = gain_db;
+    publish(crossover);
+    return true;
+}
+
+bool crossover_set_delay(crossover_t *crossover, int way, float delay_ms)
+{
+    if (way < 0 || way >= CROSSOVER_WAYS) {
+        return false;
+    }
+    if (delay_ms < 0.0f) delay_ms = 0.0f;
+    if (delay_ms > CROSSOVER_MAX_DELAY_MS) delay_ms = CROSSOVER_MAX_DELAY_MS;
+    crossover->config.ways[way].delay_ms = delay_ms;
+    publish(crossover);
+    return true;
+}
+
+bool crossover_set_invert(crossover_t *crossover, int way, bool invert)
+{
+    if (way < 0 || way >= CROSSOVER_WAYS) {
+        return false;
+    }
+    crossover->config.ways[way].invert = invert ? 1 : 0;
+    publish(crossover);
+    return true;
+}
+
+bool crossover_set_limit(crossover_t *crossover, int way, float threshold_db, bool true_peak)
+{
+    if (way < 0 || way >= CROSSOVER_WAYS || isnan(threshold_db)) {
+        return false;
+    }
+    crossover_way_settings_t *cfg = &crossover->config.ways[way];
+    if (crossover->state != NULL) {
+        limiter_t *limiter = &crossover->state->ways[way].limiter;
+        if (!limiter_set_threshold(limiter, threshold_db)) {
+            return false;
+        }
+        limiter_set_true_peak(limiter, true_peak);
+        cfg->limit_db = limiter_get_threshold(limiter);
+    } else {
+        cfg->limit_db = threshold_db;
+    }
+    cfg->true_peak = true_peak ? 1 : 0;
+    return true;
+}
+
+void crossover_reset(crossover_t *crossover)
+{
+    if (crossover->state != NULL) {
+        for (int w = 0; w < CROSSOVER_WAYS; w++) {
+            limiter_reset(&crossover->state->ways[w].limiter);
+        }
+    }
+    coeff_bank_set_flag(&crossover->reset_pending, true);
+}
+
+esp_err_t crossover_get_way_info(const crossover_t *crossover, int way, crossover_way_info_t *info)
+{
+    if (way < 0 || way >= CROSSOVER_WAYS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(info, 0, sizeof(*info));
+    info->name = s_way_names[way];
+    info->low_hz = (way > 0) ? crossover->config.freq[way - 1] : 0.0f;
+    info->high_hz = (way < CROSSOVER_WAYS - 1) ? crossover->config.freq[way] : 0.0f;
+    info->delay_frames = crossover->params[crossover->bank.published].delay_frames[way];
+    if (crossover->state != NULL) {
+        limiter_t *limiter = &crossover->state->ways[way].limiter;
+        info->peak_reduction_db = limiter_get_peak_reduction(limiter);
+        info->clips_prevented = limiter_get_clips_prevented(limiter);
+    }
+    return ESP_OK;
+}
+
+const char *crossover_output_name(void)
+{
+    return CROSSOVER_OUTPUT_I2S1 ? "i2s1" : "tdm";
+}
+
+void crossover_get_settings(const crossover_t *crossover, crossover_settings_t *settings)
+{
+    *settings = crossover->config;
+}
+
+void crossover_apply_settings(crossover_t *crossover, const crossover_settings_t *settings)
+{
+    if (settings->num_ways != CROSSOVER_WAYS) {
+        // The ways drive different speakers: keep the defaults
+        ESP_LOGW(TAG, "Settings are for %u ways, keeping the %d-way defaults",
+                 (unsigned)settings->num_ways, CROSSOVER_WAYS);
+        return;
+    }
+
+    // Clamp, then restore the order (the audio path relies on it)
+    float freq[CROSSOVER_POINTS];
+    for (int i = 0; i < CROSSOVER_POINTS; i++) {
+        float f = settings->freq[i];
+        if (!(f >= CROSSOVER_MIN_FREQ)) f = CROSSOVER_MIN_FREQ;
+        if (f > CROSSOVER_MAX_FREQ) f = CROSSOVER_MAX_FREQ;
+        freq[i] = f;
+    }
+    for (int i = 1; i < CROSSOVER_POINTS; i++) {
+        for (int j = i; j > 0 && freq[j] < freq[j - 1]; j--) {
+            const float t = freq[j];
+            freq[j] = freq[j - 1];
+            freq[j - 1] = t;
+        }
+    }
+    for (int i = 0; i < CROSSOVER_POINTS; i++) {
+        crossover->config.freq[i] = freq[i];
+    }
+
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        const crossover_way_settings_t *way = &settings->ways[w];
+        crossover_way_settings_t *cfg = &crossover->config.ways[w];
+        float gain_db = way->gain_db;
+        if (!(gain_db >= CROSSOVER_MIN_DB)) gain_db = CROSSOVER_MIN_DB;
+        if (gain_db > CROSSOVER_MAX_DB) gain_db = CROSSOVER_MAX_DB;
+        float delay_ms = way->delay_ms;
+        if (!(delay_ms >= 0.0f)) delay_ms = 0.0f;
+        if (delay_ms > CROSSOVER_MAX_DELAY_MS) delay_ms = CROSSOVER_MAX_DELAY_MS;
+        cfg->gain_db = gain_db;
+        cfg->delay_ms = delay_ms;
+        cfg->invert = way->invert ? 1 : 0;
+        // The way limiter publishes on its own bank: only when it changes
+        if (way->limit_db != cfg->limit_db || (way->true_peak != 0) != (cfg->true_peak != 0)) {
+            crossover_set_limit(crossover, w, way->limit_db, way->true_peak != 0);
+        }
+    }
+    publish(crossover);
+}
+
+#else
+
+bool crossover_set_freq(crossover_t *crossover, int point, float freq) { return false; }
+bool crossover_set_gain(crossover_t *crossover, int way, float gain_db) { return false; }
+bool crossover_set_delay(crossover_t *crossover, int way, float delay_ms) { return false; }
+bool crossover_set_invert(crossover_t *crossover, int way, bool invert) { return false; }
+
+bool crossover_set_limit(crossover_t *crossover, int way, float threshold_db, bool true_peak)
+{
+    return false;
+}
+
+void crossover_reset(crossover_t *crossover) {}
+
+esp_err_t crossover_get_way_info(const crossover_t *crossover, int way, crossover_way_info_t *info)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+const char *crossover_output_name(void)
+{
+    return "none";
+}
+
+void crossover_get_settings(const crossover_t *crossover, crossover_settings_t *settings)
+{
+    // The 2-way defaults of a build with the crossover; num_ways 0 marks
+    // them as not configured, so a crossover build keeps its own defaults
+    memset(settings, 0, sizeof(*settings));
+    settings->freq[0] = 2000.0f;
+    settings->freq[1] = 3000.0f;
+    for (int w = 0; w < CROSSOVER_SETTINGS_WAYS; w++) {
+        settings->ways[w].limit_db = LIMITER_THRESHOLD_DB;
+    }
+}
+
+void crossover_apply_settings(crossover_t *crossover, const crossover_settings_t *settings) {}
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef CROSSOVER_H
+#define CROSSOVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_config.h"
+#include "band_split.h"
+#include "coeff_bank.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "param_ramp.h"
+
+// Active crossover (multi-way output)
+// Splits the output of the DSP chain into 2 or 3 frequency bands ("ways")
+// with 4th-order Linkwitz-Riley filters (two cascaded Butterworth biquads per
+// slope), so the ways sum back to a flat magnitude response. Each way then has
+// its own gain, polarity, delay (driver time alignment) and limiter, and goes
+// to its own stereo output: TDM slots 2w and 2w + 1 on I2S0, or with
+// CROSSOVER_OUTPUT_I2S1 way 0 on I2S0 and way 1 on I2S1.
+//
+// The chain runs once per block; the crossover only filters its output. The
+// ways are filtered block by block by the shared band split (band_split.h),
+// with the kernel the equalizer uses (the esp-dsp stereo float biquad with
+// CONFIG_EQ_SIMD_KERNEL, the Q24 biquad otherwise).
+
+#ifdef CONFIG_CROSSOVER
+#define CROSSOVER_ENABLED           1
+#define CROSSOVER_WAYS              CONFIG_CROSSOVER_WAYS
+#else
+#define CROSSOVER_ENABLED           0
+#define CROSSOVER_WAYS              2
+#endif
+
+#if CROSSOVER_ENABLED && defined(CONFIG_CROSSOVER_OUTPUT_I2S1)
+#define CROSSOVER_OUTPUT_I2S1       1
+#else
+#define CROSSOVER_OUTPUT_I2S1       0
+#endif
+#if CROSSOVER_ENABLED && !CROSSOVER_OUTPUT_I2S1
+#define CROSSOVER_OUTPUT_TDM        1
+#else
+#define CROSSOVER_OUTPUT_TDM        0
+#endif
+
+// Filter kernel: follows the equalizer's
+#define CROSSOVER_FLOAT_KERNEL      EQUALIZER_BLOCK_KERNEL
+
+// Output block: 2 channels per way. TDM frames carry all ways interleaved
+// (L0 R0 L1 R1 ...); for I2S1 the block holds one stereo block per port,
+// way 0 first
+#define CROSSOVER_OUT_CHANNELS      (2 * CROSSOVER_WAYS)
+#define CROSSOVER_OUT_SAMPLES       (DMA_BUFFER_SIZE / I2S_NUM_CHANNELS * CROSSOVER_OUT_CHANNELS)
+
+// Crossover points
+#define CROSSOVER_POINTS            (CROSSOVER_WAYS - 1)
+
+// Parameter ranges
+#define CROSSOVER_MIN_FREQ          40.0f
+#define CROSSOVER_MAX_FREQ          16000.0f
+#define CROSSOVER_MIN_DB            -24.0f
+#define CROSSOVER_MAX_DB            6.0f
+#define CROSSOVER_MAX_DELAY_MS      5.0f        // 960 frames at 192 kHz
+#define CROSSOVER_DELAY_FRAMES      1024        // Delay line length (power of two)
+
+#if CROSSOVER_FLOAT_KERNEL
+typedef float crossover_sample_t;       // 24-bit scale
+#else
+typedef int32_t crossover_sample_t;     // 24-bit right-justified
+#endif
+
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
+typedef struct {
+    band_split_coeffs_t split;                          // Way filters
+    float gain_linear[CROSSOVER_WAYS];                  // Negative with inverted polarity
+    uint16_t delay_frames[CROSSOVER_WAYS];
+} crossover_params_t;
+
+// Audio state of one way (allocated by crossover_init)
+typedef struct {
+    limiter_t limiter;                                  // Always on: keeps the ways equally delayed
+    crossover_sample_t block[DMA_BUFFER_SIZE] __attribute__((aligned(16)));
+    crossover_sample_t delay[CROSSOVER_DELAY_FRAMES * 2];
+    param_ramp_t gain;                                  // Gain actually applied
+} crossover_way_t;
+
+// Audio state of the filters (allocated by crossover_init)
+typedef struct {
+    crossover_way_t ways[CROSSOVER_WAYS];
+    crossover_sample_t input[DMA_BUFFER_SIZE] __attribute__((aligned(16)));
+    band_split_state_t split;                           // Way filter history
+    int delay_pos;                                      // Delay line write position (frames)
+    int delay_now[CROSSOVER_WAYS];                      // Delay applied to the last block
+} crossover_state_t;
+
+// Persistent configuration of one way
+typedef struct {
+    float gain_db;                          // Way gain in dB
+    float delay_ms;                         // Delay in ms
+    float limit_db;                         // Limiter threshold in dB
+    uint8_t invert;                         // Inverted polarity
+    uint8_t true_peak;                      // Limiter true-peak detection
+    uint8_t reserved[2];
+} crossover_way_settings_t;
+
+// Ways in the persistent settings: the largest build, so that the settings
+// blob layout does not depend on CONFIG_CROSSOVER_WAYS
+#define CROSSOVER_SETTINGS_WAYS     3
+
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float freq[CROSSOVER_SETTINGS_WAYS - 1];            // Crossover points in Hz, ascending
+    crossover_way_settings_t ways[CROSSOVER_SETTINGS_WAYS];
+    uint8_t num_ways;                                   // Ways the settings were saved for
+    uint8_t reserved[3];
+} crossover_settings_t;
+
+// Crossover structure
+typedef struct {
+    crossover_params_t params[2];           // Published / shadow parameter sets
+    coeff_bank_t bank;                      // Publish state for params
+    crossover_settings_t config;            // Current configuration (control side)
+    uint32_t sample_rate;                   // Rate the parameters are designed for
+    crossover_state_t *state;               // NULL until crossover_init succeeded
+    volatile bool reset_pending;            // Clear filter and delay history at the next block
+} crossover_t;
+
+// Per-way statistics (crossover_get_way_info)
+typedef struct {
+    const char *name;                       // "low", "mid" or "high"
+    float low_hz;                           // Band edges, 0 = open
+    float high_hz;
+    uint32_t delay_frames;                  // Delay at the current rate
+    float peak_reduction_db;                // Largest limiter gain reduction
+    uint32_t clips_prevented;               // Limiter activations
+} crossover_way_info_t;
+
+#if CROSSOVER_ENABLED
+
+/**
+ * Initialize the crossover with default points and allocate the way state
+ *
+ * @param crossover Pointer to crossover structure
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t crossover_init(crossover_t *crossover, uint32_t sample_rate);
+
+/**
+ * Split one processed block into the way outputs (audio task only)
+ *
+ * @param crossover Pointer to crossover structure
+ * @param input Output of the DSP chain, left-justified 32-bit I2S words
+ *              (interleaved stereo: L, R, L, R, ...)
+ * @param output CROSSOVER_OUT_SAMPLES words in the layout of the I2S ports
+ * @param num_samples Number of input samples (total, not per channel, at most DMA_BUFFER_SIZE)
+ */
+void crossover_process(crossover_t *crossover, const int32_t *input, int32_t *output, int num_samples);
+
+/**
+ * Redesign the filters and delays for a new sample rate (audio path parked)
+ *
+ * @param crossover Pointer to crossover structure
+ * @param sample_rate New rate in Hz
+ */
+void crossover_set_sample_rate(crossover_t *crossover, uint32_t sample_rate);
+
+#else
+
+static inline esp_err_t crossover_init(crossover_t *crossover, uint32_t sample_rate) { (void)crossover; (void)sample_rate; return ESP_OK; }
+static inline void crossover_set_sample_rate(crossover_t *crossover, uint32_t sample_rate) { (void)crossover; (void)sample_rate; }
+
+#endif
+
+/**
+ * Set a crossover point
+ *
+ * @param crossover Pointer to crossover structure
+ * @param point 0 (low/high, or low/mid) to CROSSOVER_POINTS - 1
+ * @param freq Frequency in Hz (CROSSOVER_MIN_FREQ..CROSSOVER_MAX_FREQ, below 45% of the sample rate)
+ * @return true if successful, false if out of range, not above the point
+ *         below or not below the point above, or compiled out
+ */
+bool crossover_set_freq(crossover_t *crossover, int point, float freq);
+
+/**
+ * Set the gain of a way
+ *
+ * @param crossover Pointer to crossover structure
+ * @param way 0 (low) to CROSSOVER_WAYS - 1
+ * @param gain_db Gain in dB (clamped to CROSSOVER_MIN_DB..CROSSOVER_MAX_DB)
+ * @return true if successful, false if the way is invalid
+ */
+bool crossover_set_gain(crossover_t *crossover, int way, float gain_db);
+
+/**
+ * Set the delay of a way (time alignment)
+ *
+ * @param crossover Pointer to crossover structure
+ * @param way 0 (low) to CROSSOVER_WAYS - 1
+ * @param delay_ms Delay in ms (clamped to 0..CROSSOVER_MAX_DELAY_MS)
+ * @return true if successful, false if the way is invalid
+ */
+bool crossover_set_delay(crossover_t *crossover, int way, float delay_ms);
+
+/**
+ * Invert the polarity of a way
+ *
+ * @param crossover Pointer to crossover structure
+ * @param way 0 (low) to CROSSOVER_WAYS - 1
+ * @param invert true for inverted polarity
+ * @return true if successful, false if the way is invalid
+ */
+bool crossover_set_invert(crossover_t *crossover, int way, bool invert);
+
+/**
+ * Configure the limiter of a way
+ *
+ * @param crossover Pointer to crossover structure
+ * @param way 0 (low) to CROSSOVER_WAYS - 1
+ * @param threshold_db Threshold in dB (as limiter_set_threshold)
+ * @param true_peak true for true-peak detection
+ * @return true if successful, false if the way or threshold is invalid
+ */
+bool crossover_set_limit(crossover_t *crossover, int way, float threshold_db, bool true_peak);
+
+/**
+ * Clear the filter, delay and limiter history of every way (next block)
+ *
+ * @param crossover Pointer to crossover structure
+ */
+void crossover_reset(crossover_t *crossover);
+
+/**
+ * Get the band and statistics of a way
+ *
+ * @param crossover Pointer to crossover structure
+ * @param way 0 (low) to CROSSOVER_WAYS - 1
+ * @param info Destination
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the way is invalid,
+ *         ESP_ERR_NOT_SUPPORTED if compiled out
+ */
+esp_err_t crossover_get_way_info(const crossover_t *crossover, int way, crossover_way_info_t *info);
+
+/**
+ * Get the printable name of the output layout
+ *
+ * @return "tdm", "i2s1" or "none"
+ */
+const char *crossover_output_name(void);
+
+/**
+ * Copy the persistent settings
+ *
+ * @param crossover Pointer to crossover structure
+ * @param settings Destination
+ */
+void crossover_get_settings(const crossover_t *crossover, crossover_settings_t *settings);
+
+/**
+ * Apply persistent settings
+ *
+ * Points are clamped and sorted. Settings saved for another number of ways
+ * are ignored: the ways would drive different speakers.
+ *
+ * @param crossover Pointer to crossover structure
+ * @param settings Settings from crossover_get_settings
+ */
+void crossover_apply_settings(crossover_t *crossover, const crossover_settings_t *settings);
+
+#endif // CROSSOVER_H
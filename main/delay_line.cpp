@@ -0,0 +1,314 @@
+#include "delay_line.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "DELAY";
+
+static DSP_HOT_INLINE float clampf(float x, float lo, float hi)
+{
+    return fminf(fmaxf(x, lo), hi);
+}
+
+#if DELAY_LINE_ENABLED
+
+#define LENGTH          DELAY_LINE_LENGTH
+#define TAPS            DELAY_LINE_TAPS
+#define MAX_FRAMES      (DMA_BUFFER_SIZE / 2)
+
+static_assert(DELAY_LINE_CHANNELS == I2S_NUM_CHANNELS, "one line per output channel");
+
+// Block buffers in internal RAM (audio task only): the input of one channel,
+// and the span read back for the current and, while crossfading, the
+// previous delay
+static float s_input[MAX_FRAMES];
+static float s_span[MAX_FRAMES + TAPS - 1];
+static float s_old_span[MAX_FRAMES + TAPS - 1];
+
+/* Audio path */
+
+static DSP_HOT_INLINE float load_sample(int32_t v) { return (float)v; }
+static DSP_HOT_INLINE float load_sample(float v) { return v; }
+
+// Back to 24 bits: the interpolator can overshoot full scale slightly
+static DSP_HOT_INLINE void store_sample(int32_t *dst, float y)
+{
+    *dst = (int32_t)lrintf(clampf(y, -8388608.0f, 8388607.0f));
+}
+
+static DSP_HOT_INLINE void store_sample(float *dst, float y)
+{
+    *dst = y;
+}
+
+// Copy a block into a ring at pos (two spans if it wraps)
+static void DSP_HOT write_span(float *ring, int32_t pos, const float *src, int n)
+{
+    const int first = (n < LENGTH - pos) ? n : LENGTH - pos;
+    memcpy(ring + pos, src, first * sizeof(float));
+    if (first < n) {
+        memcpy(ring, src + first, (n - first) * sizeof(float));
+    }
+}
+
+// Copy the n + TAPS - 1 frames the interpolator needs for a block written at
+// pos with a delay of frames, oldest first. Frames from before the last reset
+// ("filled" counts the frames written since, this block included) are read
+// as silence without touching the ring.
+static void DSP_HOT read_span(const float *ring, int32_t pos, int32_t frames, int n, int32_t filled, float *dst)
+{
+    const int count = n + TAPS - 1;
+    int zeros = n - filled + frames + TAPS - 1;
+    if (zeros < 0) {
+        zeros = 0;
+    } else if (zeros > count) {
+        zeros = count;
+    }
+    memset(dst, 0, zeros * sizeof(float));
+
+    int32_t start = pos - frames - (TAPS - 1) + zeros;
+    if (start < 0) {
+        start += LENGTH;
+    } else if (start >= LENGTH) {
+        start -= LENGTH;
+    }
+    const int rest = count - zeros;
+    const int first = (rest < LENGTH - start) ? rest : LENGTH - start;
+    memcpy(dst + zeros, ring + start, first * sizeof(float));
+    if (first < rest) {
+        memcpy(dst + zeros + first, ring, (rest - first) * sizeof(float));
+    }
+}
+
+template <typename T>
+static DSP_HOT_INLINE void run(delay_line_t *dl, const delay_line_params_t *p, T *buffer, int num_samples)
+{
+    if (num_samples > DMA_BUFFER_SIZE) {
+        num_samples = DMA_BUFFER_SIZE;
+    }
+    const int n = num_samples / 2;
+    const int32_t filled = (dl->filled + n < LENGTH) ? dl->filled + n : LENGTH;
+    const float inv_n = 1.0f / (float)n;
+
+    for (int c = 0; c < DELAY_LINE_CHANNELS; c++) {
+        float *ring = dl->line + c * LENGTH;
+        for (int i = 0; i < n; i++) {
+            s_input[i] = load_sample(buffer[2 * i + c]);
+        }
+        write_span(ring, dl->pos, s_input, n);
+        read_span(ring, dl->pos, p->frames[c], n, filled, s_span);
+
+        const float *h = p->taps[c];
+        const bool changed = p->frames[c] != dl->last.frames[c] ||
+                             memcmp(h, dl->last.taps[c], sizeof(p->taps[c])) != 0;
+        if (!changed) {
+            for (int i = 0; i < n; i++) {
+                const float *s = &s_span[i];
+                store_sample(&buffer[2 * i + c], h[0] * s[0] + h[1] * s[1] + h[2] * s[2] + h[3] * s[3]);
+            }
+        } else {
+            // Crossfade from the previous delay over this block
+            read_span(ring, dl->pos, dl->last.frames[c], n, filled, s_old_span);
+            const float *o = dl->last.taps[c];
+            for (int i = 0; i < n; i++) {
+                const float *s = &s_span[i];
+                const float *q = &s_old_span[i];
+                const float t = (float)(i + 1) * inv_n;
+                const float y = h[0] * s[0] + h[1] * s[1] + h[2] * s[2] + h[3] * s[3];
+                const float y_old = o[0] * q[0] + o[1] * q[1] + o[2] * q[2] + o[3] * q[3];
+                store_sample(&buffer[2 * i + c], y_old + t * (y - y_old));
+            }
+        }
+    }
+
+    dl->pos += n;
+    if (dl->pos >= LENGTH) {
+        dl->pos -= LENGTH;
+    }
+    dl->filled = filled;
+    dl->last = *p;
+}
+
+bool DSP_HOT delay_line_block_active(const delay_line_t *delay)
+{
+    return delay->enabled && delay->line != NULL;
+}
+
+DSP_HOT const delay_line_params_t *delay_line_begin_block(delay_line_t *delay)
+{
+    const delay_line_params_t *p = &delay->params[coeff_bank_acquire(&delay->bank)];
+    if (delay->reset_pending) {
+        delay->reset_pending = false;
+        delay->filled = 0;
+        delay->last = *p;   // Nothing to crossfade from
+    }
+    return p;
+}
+
+void DSP_HOT delay_line_end_block(delay_line_t *delay)
+{
+    coeff_bank_release(&delay->bank);
+}
+
+void DSP_HOT delay_line_process_block(delay_line_t *delay, const delay_line_params_t *params,
+                                      int32_t *buffer, int num_samples)
+{
+    run(delay, params, buffer, num_samples);
+}
+
+void DSP_HOT delay_line_process(delay_line_t *delay, int32_t *buffer, int num_samples)
+{
+    if (!delay_line_block_active(delay)) {
+        return;  // Bypass
+    }
+
+    const delay_line_params_t *p = delay_line_begin_block(delay);
+    delay_line_process_block(delay, p, buffer, num_samples);
+    delay_line_end_block(delay);
+}
+
+void DSP_HOT delay_line_process_f32(delay_line_t *delay, float *buffer, int num_samples)
+{
+    if (!delay_line_block_active(delay)) {
+        return;  // Bypass
+    }
+
+    const delay_line_params_t *p = delay_line_begin_block(delay);
+    run(delay, p, buffer, num_samples);
+    delay_line_end_block(delay);
+}
+
+/* Control */
+
+// Delay in frames at the current rate
+static float delay_frames(const delay_line_t *dl, int channel)
+{
+    const float frames = dl->config.delay_ms[channel] * (float)dl->sample_rate / 1000.0f;
+    return clampf(frames, 0.0f, (float)DELAY_LINE_MAX_FRAMES);
+}
+
+// Whole frames and Lagrange interpolator of one delay. The taps sit at
+// delays frames .. frames + 3 and interpolate at frames + 1 + fraction, in
+// the middle of the interpolator, which is where the extra frame comes from.
+static void bake_channel(float frames, int32_t *whole, float *taps)
+{
+    const float base = floorf(frames);
+    const float x = 1.0f + (frames - base);
+    for (int k = 0; k < TAPS; k++) {
+        float h = 1.0f;
+        for (int j = 0; j < TAPS; j++) {
+            if (j != k) {
+                h *= (x - (float)j) / (float)(k - j);
+            }
+        }
+        taps[TAPS - 1 - k] = h;     // Oldest sample (delay frames + 3) first
+    }
+    *whole = (int32_t)base;
+}
+
+static void publish(delay_line_t *dl)
+{
+    delay_line_params_t *p = (delay_line_params_t *)coeff_bank_begin_write(
+        &dl->bank, dl->params, sizeof(delay_line_params_t));
+    for (int c = 0; c < DELAY_LINE_CHANNELS; c++) {
+        bake_channel(delay_frames(dl, c), &p->frames[c], p->taps[c]);
+    }
+    coeff_bank_publish(&dl->bank);
+}
+
+esp_err_t delay_line_init(delay_line_t *delay, uint32_t sample_rate)
+{
+    memset(delay, 0, sizeof(delay_line_t));
+    coeff_bank_reset(&delay->bank);
+    delay->sample_rate = sample_rate;
+    for (int c = 0; c < DELAY_LINE_CHANNELS; c++) {
+        bake_channel(0.0f, &delay->params[0].frames[c], delay->params[0].taps[c]);
+    }
+    delay->last = delay->params[0];
+    delay->reset_pending = true;
+
+    // PSRAM only: the lines are far too large for internal RAM, and only
+    // accessed in block copies. Not cleared: unwritten frames read as silence.
+    const size_t bytes = (size_t)DELAY_LINE_CHANNELS * LENGTH * sizeof(float);
+    delay->line = (float *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (delay->line == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes of PSRAM for the delay lines, bypassed",
+                 (unsigned)bytes);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Output delay: up to %d ms per channel (%u KB of PSRAM)",
+             DELAY_LINE_MAX_MS, (unsigned)(bytes / 1024));
+    return ESP_OK;
+}
+
+void delay_line_set_sample_rate(delay_line_t *delay, uint32_t sample_rate)
+{
+    delay->sample_rate = sample_rate;
+    publish(delay);
+    delay->reset_pending = true;
+}
+
+void delay_line_set_enabled(delay_line_t *delay, bool enabled)
+{
+    if (enabled && !delay->enabled) {
+        coeff_bank_set_flag(&delay->reset_pending, true);
+    }
+    coeff_bank_set_flag(&delay->enabled, enabled);
+    delay->config.enabled = enabled ? 1 : 0;
+}
+
+bool delay_line_set_delay(delay_line_t *delay, int channel, float delay_ms)
+{
+    if (channel < 0 || channel >= DELAY_LINE_CHANNELS) {
+        return false;
+    }
+    delay->config.delay_ms[channel] = clampf(delay_ms, 0.0f, (float)DELAY_LINE_MAX_MS);
+    publish(delay);
+    return true;
+}
+
+float delay_line_get_frames(const delay_line_t *delay, int channel)
+{
+    if (channel < 0 || channel >= DELAY_LINE_CHANNELS) {
+        return 0.0f;
+    }
+    return delay_frames(delay, channel);
+}
+
+void delay_line_reset(delay_line_t *delay)
+{
+    coeff_bank_set_flag(&delay->reset_pending, true);
+}
+
+void delay_line_get_settings(const delay_line_t *delay, delay_line_settings_t *settings)
+{
+    *settings = delay->config;
+}
+
+void delay_line_apply_settings(delay_line_t *delay, const delay_line_settings_t *settings)
+{
+    for (int c = 0; c < DELAY_LINE_CHANNELS; c++) {
+        // fmaxf also turns a NaN from a corrupt blob into 0
+        delay->config.delay_ms[c] = clampf(settings->delay_ms[c], 0.0f, (float)DELAY_LINE_MAX_MS);
+    }
+    publish(delay);
+    delay_line_set_enabled(delay, settings->enabled != 0);
+}
+
+#else
+
+void delay_line_set_enabled(delay_line_t *delay, bool enabled) {}
+bool delay_line_set_delay(delay_line_t *delay, int channel, float delay_ms) { return false; }
+float delay_line_get_frames(const delay_line_t *delay, int channel) { return 0.0f; }
+void delay_line_reset(delay_line_t *delay) {}
+
+void delay_line_get_settings(const delay_line_t *delay, delay_line_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+}
+
+void delay_line_apply_settings(delay_line_t *delay, const delay_line_settings_t *settings) {}
+
+#endif
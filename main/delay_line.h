@@ -0,0 +1,206 @@
+#ifndef DELAY_LINE_H
+#define DELAY_LINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_config.h"
+#include "coeff_bank.h"
+
+// Output delay (time alignment)
+// Delays the left and right channel independently, up to
+// CONFIG_DELAY_LINE_MAX_MS at the highest sample rate, e.g. to align the
+// speakers of an off-centre listening position. Runs as the last stage of
+// the chain, after the limiter. Fractional delays are interpolated with a
+// 4-tap Lagrange (3rd order) interpolator, which adds one frame of latency
+// to both channels.
+//
+// The delay lines live in PSRAM and are only touched with block copies:
+// each block is written once and each channel read once, as at most two
+// contiguous spans (the ring wraps at most once per block), into block
+// buffers in internal RAM where the interpolation runs. PSRAM traffic is
+// therefore the same for every delay, and the per-sample loop never
+// computes a ring index. A delay change is crossfaded over one block (one
+// extra read span per changed channel in that block).
+
+#ifdef CONFIG_DELAY_LINE
+#define DELAY_LINE_ENABLED          1
+#define DELAY_LINE_MAX_MS           CONFIG_DELAY_LINE_MAX_MS
+#else
+#define DELAY_LINE_ENABLED          0
+#define DELAY_LINE_MAX_MS           100
+#endif
+
+#define DELAY_LINE_CHANNELS         2
+#define DELAY_LINE_MAX_RATE         192000      // Lines are sized for the highest rate
+#define DELAY_LINE_TAPS             4           // Interpolator length
+
+// Longest delay in frames (at DELAY_LINE_MAX_RATE)
+#define DELAY_LINE_MAX_FRAMES       (DELAY_LINE_MAX_MS * (DELAY_LINE_MAX_RATE / 1000))
+
+// Ring length per channel: the longest delay, the interpolator and one block
+#define DELAY_LINE_LENGTH           (DELAY_LINE_MAX_FRAMES + DELAY_LINE_TAPS + DMA_BUFFER_SIZE / 2)
+
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
+typedef struct {
+    int32_t frames[DELAY_LINE_CHANNELS];                // Whole frames of delay
+    float taps[DELAY_LINE_CHANNELS][DELAY_LINE_TAPS];   // Interpolator, oldest sample first
+} delay_line_params_t;
+
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float delay_ms[DELAY_LINE_CHANNELS];    // Left, right
+    uint8_t enabled;
+    uint8_t reserved[3];
+} delay_line_settings_t;
+
+// Delay line structure
+typedef struct {
+    delay_line_params_t params[2];          // Published / shadow parameter sets
+    coeff_bank_t bank;                      // Publish state for params
+    delay_line_params_t last;               // Parameters of the last block (audio task)
+    delay_line_settings_t config;           // Current configuration (control side)
+    uint32_t sample_rate;                   // Rate the parameters are designed for
+    bool enabled;                           // Enable/disable processing
+    volatile bool reset_pending;            // Forget the line contents at the next block
+    float *line;                            // DELAY_LINE_CHANNELS rings of DELAY_LINE_LENGTH (PSRAM), NULL if not allocated
+    int32_t pos;                            // Write position (frames)
+    int32_t filled;                         // Frames written since the last reset (up to DELAY_LINE_LENGTH)
+} delay_line_t;
+
+#if DELAY_LINE_ENABLED
+
+/**
+ * Initialize the delay (disabled, no delay) and allocate the lines in PSRAM
+ *
+ * @param delay Pointer to delay structure
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK or ESP_ERR_NO_MEM (the delay then stays bypassed)
+ */
+esp_err_t delay_line_init(delay_line_t *delay, uint32_t sample_rate);
+
+/**
+ * Recompute the delays for a new sample rate (between blocks)
+ *
+ * The line contents are forgotten: they were recorded at the old rate.
+ *
+ * @param delay Pointer to delay structure
+ * @param sample_rate New rate in Hz
+ */
+void delay_line_set_sample_rate(delay_line_t *delay, uint32_t sample_rate);
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ *
+ * Must be paired with delay_line_end_block.
+ *
+ * @param delay Pointer to delay structure
+ * @return Parameters to use for this block
+ */
+const delay_line_params_t *delay_line_begin_block(delay_line_t *delay);
+
+/**
+ * Release the parameters latched by delay_line_begin_block (audio task only)
+ *
+ * @param delay Pointer to delay structure
+ */
+void delay_line_end_block(delay_line_t *delay);
+
+/**
+ * Check whether blocks are processed
+ *
+ * @param delay Pointer to delay structure
+ * @return true if enabled and the lines are allocated
+ */
+bool delay_line_block_active(const delay_line_t *delay);
+
+/**
+ * Process one block with latched parameters (24-bit samples, in place)
+ *
+ * Shared by delay_line_process and the fused DSP chain.
+ *
+ * @param delay Pointer to delay structure
+ * @param params Parameters from delay_line_begin_block
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void delay_line_process_block(delay_line_t *delay, const delay_line_params_t *params,
+                              int32_t *buffer, int num_samples);
+
+/**
+ * Process audio through the delay
+ *
+ * @param delay Pointer to delay structure
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void delay_line_process(delay_line_t *delay, int32_t *buffer, int num_samples);
+
+/**
+ * Process a float block through the delay (float32 chain)
+ *
+ * @param delay Pointer to delay structure
+ * @param buffer Audio buffer (interleaved stereo, 24-bit scale)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void delay_line_process_f32(delay_line_t *delay, float *buffer, int num_samples);
+
+#else
+
+static inline esp_err_t delay_line_init(delay_line_t *delay, uint32_t sample_rate) { (void)delay; (void)sample_rate; return ESP_OK; }
+static inline void delay_line_set_sample_rate(delay_line_t *delay, uint32_t sample_rate) { (void)delay; (void)sample_rate; }
+
+#endif
+
+/**
+ * Enable or disable the delay (enabling starts from silence)
+ *
+ * @param delay Pointer to delay structure
+ * @param enabled true to enable, false to bypass
+ */
+void delay_line_set_enabled(delay_line_t *delay, bool enabled);
+
+/**
+ * Set the delay of one channel
+ *
+ * @param delay Pointer to delay structure
+ * @param channel 0 (left) or 1 (right)
+ * @param delay_ms Delay in ms (clamped to 0..DELAY_LINE_MAX_MS)
+ * @return true if successful, false if the channel is invalid or compiled out
+ */
+bool delay_line_set_delay(delay_line_t *delay, int channel, float delay_ms);
+
+/**
+ * Get the delay of one channel in frames at the current rate
+ *
+ * @param delay Pointer to delay structure
+ * @param channel 0 (left) or 1 (right)
+ * @return Delay in frames, without the interpolator's frame (0 if compiled out)
+ */
+float delay_line_get_frames(const delay_line_t *delay, int channel);
+
+/**
+ * Forget the line contents (next block)
+ *
+ * @param delay Pointer to delay structure
+ */
+void delay_line_reset(delay_line_t *delay);
+
+/**
+ * Copy the persistent settings
+ *
+ * @param delay Pointer to delay structure
+ * @param settings Destination
+ */
+void delay_line_get_settings(const delay_line_t *delay, delay_line_settings_t *settings);
+
+/**
+ * Apply persistent settings (delays are clamped)
+ *
+ * @param delay Pointer to delay structure
+ * @param settings Settings from delay_line_get_settings
+ */
+void delay_line_apply_settings(delay_line_t *delay, const delay_line_settings_t *settings);
+
+#endif // DELAY_LINE_H
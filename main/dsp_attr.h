@@ -0,0 +1,51 @@
+#ifndef DSP_ATTR_H
+#define DSP_ATTR_H
+
+#include "esp_attr.h"
+#include "sdkconfig.h"
+
+// Memory placement of the audio hot path
+//
+// With CONFIG_AUDIO_HOT_PATH_IRAM every function the audio task runs per
+// block is linked into internal instruction RAM instead of being executed
+// from flash through the cache, so its timing no longer depends on what the
+// WiFi/MQTT tasks on the other core have evicted. Three mechanisms, each
+// where it fits:
+//
+// - DSP_HOT on the per-block functions of modules that also contain control
+//   code (design, settings, NVS), which stays in flash
+// - DSP_HOT_INLINE on the small helpers in headers (biquad, coeff_bank,
+//   limiter, ...): always inlined, so no flash copy is left behind in any
+//   object that calls them. Also on function templates, which GCC emits in
+//   .text whatever their section attribute: each instantiation is inlined
+//   into its one DSP_HOT caller
+// - linker.lf for whole objects: dsp_chain (template instantiations, where
+//   section attributes do not apply reliably) and the esp-dsp kernels
+//
+// DSP_HOT_RODATA moves the lookup tables the hot path reads into internal
+// RAM as well. Without the profile all three are plain (inline) definitions
+// and the build is unchanged.
+//
+// Data layout (all builds): the module instances are globals in internal
+// DRAM (esp-dsp.cpp), never PSRAM. Their structs put what the audio task
+// works on first: the double-buffered parameter sets, then the per-channel
+// filter state, each starting on a 16-byte boundary so the esp-dsp kernels
+// get aligned 128-bit loads, with the state of the two channels adjacent.
+// The settings the control side writes (dB values, band configuration, the
+// enabled flag the audio task checks once per block) follow at the end.
+//
+// tools/placement_report.py checks the result in the linker map.
+
+#ifdef CONFIG_AUDIO_HOT_PATH_IRAM
+#define DSP_HOT_PATH_IRAM       1
+#define DSP_HOT                 IRAM_ATTR
+#define DSP_HOT_INLINE          inline __attribute__((always_inline))
+#define DSP_HOT_RODATA          DRAM_ATTR
+#else
+#define DSP_HOT_PATH_IRAM       0
+#define DSP_HOT
+#define DSP_HOT_INLINE          inline
+#define DSP_HOT_RODATA
+#endif
+
+#endif // DSP_ATTR_H
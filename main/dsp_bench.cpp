@@ -0,0 +1,240 @@
+#include "dsp_bench.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "limiter.h"
+#include "coeff_bank.h"
+#include "audio_config.h"
+#include "audio_rate.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "DSP_BENCH";
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern pregain_t pregain;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+
+// Measurement handshake between the control task and audio_task
+typedef enum {
+    JOB_IDLE = 0,
+    JOB_REQUESTED,      // Set by the control task
+    JOB_RUNNING,        // Claimed by audio_task
+} job_state_t;
+
+typedef struct {
+    const dsp_chain_modules_t *modules;
+    dsp_chain_mode_t mode;
+    int warmup_blocks;
+    dsp_bench_timing_t timing;
+} bench_job_t;
+
+static volatile int s_job_state = JOB_IDLE;
+static bench_job_t s_job;
+static SemaphoreHandle_t s_job_done = NULL;
+static volatile bool s_running = false;
+
+// Module snapshots and test signal (static: limiter_t is too large for a task stack)
+#define SIGNAL_BLOCKS   2
+static subsonic_t s_sub;
+static pregain_t s_gain;
+static equalizer_t s_eq;
+static limiter_t s_lim;
+static int32_t s_signal[SIGNAL_BLOCKS][DMA_BUFFER_SIZE];
+static int32_t s_work[DMA_BUFFER_SIZE];
+
+static void generate_signal(void)
+{
+    // Full-scale noise so that the limiter works as hard as it ever does
+    uint32_t seed = 0x12345678u;
+    for (int b = 0; b < SIGNAL_BLOCKS; b++) {
+        for (int i = 0; i < DMA_BUFFER_SIZE; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            s_signal[b][i] = (int32_t)(seed & 0xFFFFFF00u);
+        }
+    }
+}
+
+static void take_snapshot(void)
+{
+    s_sub = subsonic;
+    s_gain = pregain;
+    s_eq = equalizer;
+    s_lim = limiter;
+    s_lim.trigger_cb = NULL;
+
+    // The copy may have been taken while audio_task held a parameter set
+    s_sub.bank.in_use = COEFF_BANK_IDLE;
+    s_gain.bank.in_use = COEFF_BANK_IDLE;
+    s_eq.bank.in_use = COEFF_BANK_IDLE;
+    s_lim.bank.in_use = COEFF_BANK_IDLE;
+}
+
+// Spread n peaking bands over the audio range, the rest disabled
+static void configure_bands(int active)
+{
+    s_eq.enabled = true;
+    for (int b = 0; b < EQ_MAX_BANDS; b++) {
+        eq_band_t config;
+        config.type = EQ_FILTER_PEAKING;
+        config.freq = 40.0f * powf(16000.0f / 40.0f, (float)b / (EQ_MAX_BANDS - 1));
+        config.q = 1.0f;
+        config.gain_db = (b & 1) ? -3.0f : 3.0f;
+        config.enabled = (b < active);
+        equalizer_set_band(&s_eq, b, &config, audio_rate_get());
+    }
+}
+
+static esp_err_t measure(const dsp_chain_modules_t *modules, dsp_chain_mode_t mode,
+                         dsp_bench_timing_t *timing)
+{
+    s_job.modules = modules;
+    s_job.mode = mode;
+    // Let parameter ramps started by the snapshot settle before timing
+    s_job.warmup_blocks = PARAM_RAMP_FRAMES / (DMA_BUFFER_SIZE / I2S_NUM_CHANNELS) + 2;
+    __atomic_store_n(&s_job_state, JOB_REQUESTED, __ATOMIC_SEQ_CST);
+
+    if (xSemaphoreTake(s_job_done, pdMS_TO_TICKS(DSP_BENCH_TIMEOUT_MS)) != pdTRUE) {
+        int expected = JOB_REQUESTED;
+        if (__atomic_compare_exchange_n(&s_job_state, &expected, JOB_IDLE, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            ESP_LOGE(TAG, "Audio task did not run the benchmark");
+            return ESP_ERR_TIMEOUT;
+        }
+        // Claimed just in time: the job is bounded, so wait for it
+        xSemaphoreTake(s_job_done, portMAX_DELAY);
+    }
+
+    *timing = s_job.timing;
+    return ESP_OK;
+}
+
+static uint32_t rate_within_budget(const dsp_bench_result_t *result, const dsp_bench_timing_t *timing)
+{
+    if (timing->max_cycles == 0) {
+        return 0;
+    }
+    uint64_t budget_cycles_per_sec = (uint64_t)result->cpu_mhz * 1000000u * DSP_BENCH_BUDGET_PCT / 100;
+    return (uint32_t)(budget_cycles_per_sec * result->block_frames / timing->max_cycles);
+}
+
+esp_err_t dsp_bench_run(dsp_bench_result_t *result)
+{
+    if (s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_running = true;
+
+    if (s_job_done == NULL) {
+        s_job_done = xSemaphoreCreateBinary();
+    }
+    generate_signal();
+
+    memset(result, 0, sizeof(*result));
+    result->cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+    result->block_frames = DMA_BUFFER_SIZE / I2S_NUM_CHANNELS;
+    result->deadline_cycles = (uint32_t)((uint64_t)result->block_frames * result->cpu_mhz * 1000000u / audio_rate_get());
+    result->psram_bytes = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    result->mode = dsp_chain_get_mode();
+
+    // Without the convolver, multiband processor and delay: their state
+    // cannot be snapshotted (their live cost shows in 'perf' as "conv", "mb"
+    // and "delay")
+    const dsp_chain_modules_t modules = { &s_sub, &s_gain, &s_eq, &s_lim, NULL, NULL, NULL, false, false };
+    esp_err_t err;
+
+    // Current settings in both modes
+    take_snapshot();
+    err = measure(&modules, DSP_CHAIN_MODE_STAGED, &result->staged);
+    if (err == ESP_OK) {
+        take_snapshot();
+        err = measure(&modules, DSP_CHAIN_MODE_FUSED, &result->fused);
+    }
+    if (err == ESP_OK) {
+        take_snapshot();
+        err = measure(&modules, DSP_CHAIN_MODE_FLOAT, &result->float32);
+    }
+
+    // Band sweep in the current mode with the other stages as configured
+    result->max_bands = -1;
+    for (int n = 0; err == ESP_OK && n <= EQ_MAX_BANDS; n++) {
+        take_snapshot();
+        configure_bands(n);
+        err = measure(&modules, result->mode, &result->bands[n]);
+        if (err == ESP_OK && result->max_bands == n - 1 &&
+            dsp_bench_load(result, &result->bands[n], true) <= DSP_BENCH_BUDGET_PCT) {
+            result->max_bands = n;
+        }
+    }
+
+    if (err == ESP_OK) {
+        const dsp_bench_timing_t *current = &result->staged;
+        if (result->mode == DSP_CHAIN_MODE_FUSED) {
+            current = &result->fused;
+        } else if (result->mode == DSP_CHAIN_MODE_FLOAT) {
+            current = &result->float32;
+        }
+        result->max_sample_rate = rate_within_budget(result, current);
+        ESP_LOGI(TAG, "Chain load %.1f%% (worst block), max %lu Hz, max %d bands",
+                 dsp_bench_load(result, current, true), (unsigned long)result->max_sample_rate,
+                 result->max_bands);
+    }
+
+    s_running = false;
+    return err;
+}
+
+bool dsp_bench_pending(void)
+{
+    return __atomic_load_n(&s_job_state, __ATOMIC_SEQ_CST) == JOB_REQUESTED;
+}
+
+void dsp_bench_service(void)
+{
+    int expected = JOB_REQUESTED;
+    if (!__atomic_compare_exchange_n(&s_job_state, &expected, JOB_RUNNING, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    uint64_t total = 0;
+    uint32_t worst = 0;
+    const int blocks = s_job.warmup_blocks + DSP_BENCH_BLOCKS;
+    for (int b = 0; b < blocks; b++) {
+        memcpy(s_work, s_signal[b % SIGNAL_BLOCKS], sizeof(s_work));
+
+        uint32_t start = (uint32_t)esp_cpu_get_cycle_count();
+        dsp_chain_process_modules(s_job.modules, s_job.mode, s_work, DMA_BUFFER_SIZE);
+        uint32_t cycles = (uint32_t)esp_cpu_get_cycle_count() - start;
+
+        if (b >= s_job.warmup_blocks) {
+            total += cycles;
+            if (cycles > worst) {
+                worst = cycles;
+            }
+        }
+    }
+
+    s_job.timing.avg_cycles = (uint32_t)(total / DSP_BENCH_BLOCKS);
+    s_job.timing.max_cycles = worst;
+
+    __atomic_store_n(&s_job_state, JOB_IDLE, __ATOMIC_SEQ_CST);
+    xSemaphoreGive(s_job_done);
+}
+
+float dsp_bench_load(const dsp_bench_result_t *result, const dsp_bench_timing_t *timing, bool worst)
+{
+    if (result->deadline_cycles == 0) {
+        return 0.0f;
+    }
+    uint32_t cycles = worst ? timing->max_cycles : timing->avg_cycles;
+    return 100.0f * (float)cycles / (float)result->deadline_cycles;
+}
@@ -0,0 +1,82 @@
+#ifndef DSP_BENCH_H
+#define DSP_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "equalizer.h"
+#include "dsp_chain.h"
+
+// On-target benchmark
+// Measures how much of the block deadline the DSP chain needs on this board
+// (CPU clock, cache and PSRAM configuration as built). The control task
+// prepares snapshots of the modules; the task that runs the live chain
+// (audio_task, audio_dsp with the dual-core pipeline, audio_ll with
+// low-latency I/O) runs them from an in-RAM test signal instead of I2S, on
+// its own core and priority, so the numbers match the live chain. Live module state is never touched, but audio is
+// interrupted while each measurement runs.
+
+// Blocks timed per measurement (after warm-up)
+#define DSP_BENCH_BLOCKS            100
+
+// Share of the block deadline the chain may use and still count as
+// sustainable; the rest is left for I2S, WiFi and the other tasks
+#define DSP_BENCH_BUDGET_PCT        80
+
+// Give up if audio_task does not pick up a measurement within this time
+#define DSP_BENCH_TIMEOUT_MS        2000
+
+// Cycles per block for one measurement
+typedef struct {
+    uint32_t avg_cycles;
+    uint32_t max_cycles;
+} dsp_bench_timing_t;
+
+typedef struct {
+    uint32_t cpu_mhz;                               // Cycle counter frequency
+    int block_frames;                               // Stereo frames per block
+    uint32_t deadline_cycles;                       // Cycles per block at the current sample rate
+    size_t psram_bytes;                             // PSRAM in the heap (0 = none)
+    dsp_chain_mode_t mode;                          // Mode used for the band sweep
+    dsp_bench_timing_t staged;                      // Current settings, staged chain
+    dsp_bench_timing_t fused;                       // Current settings, fused chain
+    dsp_bench_timing_t float32;                     // Current settings, float32 chain
+    dsp_bench_timing_t bands[EQ_MAX_BANDS + 1];     // n active peaking bands, other stages as configured
+    uint32_t max_sample_rate;                       // Highest rate within budget (current settings and mode)
+    int max_bands;                                  // Most bands within budget at the current rate (-1 = none)
+} dsp_bench_result_t;
+
+/**
+ * Run the benchmark (control tasks only)
+ *
+ * Blocks for roughly a second while audio_task performs the measurements.
+ *
+ * @param result Filled with the measurements
+ * @return ESP_OK, ESP_ERR_TIMEOUT if audio_task is not running,
+ *         ESP_ERR_INVALID_STATE if a benchmark is already running
+ */
+esp_err_t dsp_bench_run(dsp_bench_result_t *result);
+
+/**
+ * Check for a pending measurement (audio task only, once per block)
+ *
+ * @return true if dsp_bench_service should be called instead of processing I2S
+ */
+bool dsp_bench_pending(void);
+
+/**
+ * Perform the pending measurement (audio task only)
+ */
+void dsp_bench_service(void);
+
+/**
+ * Load of a measurement as a percentage of the block deadline
+ *
+ * @param result Benchmark result
+ * @param timing Measurement from that result
+ * @param worst true for the slowest block, false for the average
+ * @return Load in percent
+ */
+float dsp_bench_load(const dsp_bench_result_t *result, const dsp_bench_timing_t *timing, bool worst);
+
+#endif // DSP_BENCH_H
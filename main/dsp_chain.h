@@ -0,0 +1,180 @@
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "convolver.h"
+#include "multiband.h"
+#include "limiter.h"
+#include "delay_line.h"
+
+// Processing order: unpack (>> 8) → stages → repack (<< 8)
+// The stages run in the order chosen at build time (AUDIO_CHAIN_ORDER,
+// default Subsonic → Pre-Gain → Equalizer → Limiter, with the FIR convolver
+// after the equalizer when CONVOLVER is enabled, the multiband dynamics
+// before the limiter when MULTIBAND is enabled and the output delay after it
+// when DELAY_LINE is enabled); see dsp_stage.h for the stage interface. The
+// float32 mode converts to float at unpack and back (with saturation) at
+// repack; every stage in between runs on the float block.
+
+// Chain execution mode
+typedef enum {
+    DSP_CHAIN_MODE_STAGED = 0,   // One pass over the buffer per stage (reference path)
+    DSP_CHAIN_MODE_FUSED,        // All stages in a single pass per stereo frame
+    DSP_CHAIN_MODE_FLOAT,        // Float32 block per stage (esp-dsp biquads)
+} dsp_chain_mode_t;
+
+// Chain stages
+typedef enum {
+    DSP_STAGE_SUBSONIC = 0,
+    DSP_STAGE_PREGAIN,
+    DSP_STAGE_EQUALIZER,
+    DSP_STAGE_CONVOLVER,        // Only in the chain with CONVOLVER
+    DSP_STAGE_MULTIBAND,        // Only in the chain with MULTIBAND
+    DSP_STAGE_LIMITER,
+    DSP_STAGE_DELAY,            // Only in the chain with DELAY_LINE
+    DSP_STAGE_COUNT
+} dsp_stage_id_t;
+
+// Set of module instances a chain pass operates on (live globals or snapshots)
+typedef struct {
+    subsonic_t *subsonic;
+    pregain_t *pregain;
+    equalizer_t *equalizer;
+    limiter_t *limiter;
+    convolver_t *convolver; // NULL: pass through (snapshots)
+    multiband_t *multiband; // NULL: pass through (snapshots)
+    delay_line_t *delay;    // NULL: pass through (snapshots)
+    bool profile;           // Record per-stage timings (live chain only)
+    bool tap;               // Feed the pre-limiter audio tap (live chain only)
+} dsp_chain_modules_t;
+
+/**
+ * Initialize the DSP chain (selects the default mode from Kconfig)
+ */
+void dsp_chain_init(void);
+
+/**
+ * Process one block of raw I2S samples through the whole chain
+ *
+ * Input and output are left-justified 32-bit I2S words; the chain handles
+ * the 24-bit unpack/repack itself. Audio task only: timings are recorded in
+ * the profiler (dsp_perf.h) for the block opened by dsp_perf_block_begin,
+ * and the output is metered (level_meter.h) and copied to the spectrum
+ * analyzer (spectrum.h).
+ *
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void dsp_chain_process(int32_t *buffer, int num_samples);
+
+/**
+ * Process one block stage by stage (one buffer walk per stage)
+ *
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void dsp_chain_process_staged(int32_t *buffer, int num_samples);
+
+/**
+ * Process one block with all stages fused into a single pass
+ *
+ * Bit-identical to dsp_chain_process_staged.
+ *
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void dsp_chain_process_fused(int32_t *buffer, int num_samples);
+
+/**
+ * Process one block through the float32 pipeline
+ *
+ * Not bit-identical to the integer paths: no Q24 truncation, and headroom
+ * above full-scale is kept until the final conversion.
+ *
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void dsp_chain_process_float(int32_t *buffer, int num_samples);
+
+/**
+ * Process one block through an explicit set of module instances
+ *
+ * Used to run the chain on snapshots (verification, benchmarks) without
+ * touching the live modules. Must only be called by one task at a time per
+ * module set; float mode uses a shared block buffer and is for the audio
+ * task only.
+ *
+ * @param modules Module instances to use
+ * @param mode Execution mode for this block
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void dsp_chain_process_modules(const dsp_chain_modules_t *modules, dsp_chain_mode_t mode,
+                               int32_t *buffer, int num_samples);
+
+/**
+ * Select the chain execution mode (takes effect at the next block)
+ *
+ * Switching between the integer and float paths clears the filter and
+ * limiter history, since the two keep separate state.
+ *
+ * @param mode New mode
+ */
+void dsp_chain_set_mode(dsp_chain_mode_t mode);
+
+/**
+ * Get the current chain execution mode
+ *
+ * @return Current mode
+ */
+dsp_chain_mode_t dsp_chain_get_mode(void);
+
+/**
+ * Get a printable name for a chain mode
+ *
+ * @param mode Chain mode
+ * @return "staged", "fused" or "float"
+ */
+const char *dsp_chain_mode_name(dsp_chain_mode_t mode);
+
+/**
+ * Get the stage at a position of the processing order
+ *
+ * @param position 0 (first stage after unpack) to dsp_chain_stage_count() - 1
+ * @return Stage, or DSP_STAGE_COUNT if position is out of range
+ */
+dsp_stage_id_t dsp_chain_stage_at(int position);
+
+/**
+ * Get the number of stages in the chain of this build
+ *
+ * @return Number of stages (DSP_STAGE_COUNT, one less for each of CONVOLVER,
+ *         MULTIBAND and DELAY_LINE that is disabled)
+ */
+int dsp_chain_stage_count(void);
+
+/**
+ * Get the printable name of a stage
+ *
+ * @param stage Stage
+ * @return "subsonic", "pregain", "eq", "conv", "mb", "limiter" or "delay"
+ */
+const char *dsp_chain_stage_name(dsp_stage_id_t stage);
+
+/**
+ * Verify that the fused and staged paths produce identical output
+ *
+ * Runs both paths on snapshots of the live module state using a synthetic
+ * test signal; the live audio state is not touched.
+ *
+ * @param mismatch_index Set to the first differing sample index, or -1 if identical (may be NULL)
+ * @return ESP_OK if outputs are bit-identical, ESP_FAIL otherwise
+ */
+esp_err_t dsp_chain_verify(int *mismatch_index);
+
+#endif // DSP_CHAIN_H
@@ -0,0 +1,1466 @@
+#include "dsp_control.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "persist.h"
+#include "audio_rate.h"
+#include "dsp_perf.h"
+#include "level_meter.h"
+#include "spectrum.h"
+#include "audio_xrun.h"
+#include "preset_bank.h"
+#include "audio_tap.h"
+#include "coeff_bank.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "DSP_CONTROL";
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern pregain_t pregain;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+extern convolver_t convolver;
+extern crossover_t crossover;
+extern multiband_t multiband;
+extern delay_line_t delay_line;
+
+// Commands carried out at commit that are not chain settings
+#define ACTION_PERF_RESET       (1u << 0)
+#define ACTION_METER_RESET      (1u << 1)
+#define ACTION_SPECTRUM_ENABLE  (1u << 2)
+#define ACTION_SPECTRUM_RESET   (1u << 3)
+#define ACTION_XRUN_RESET       (1u << 4)
+#define ACTION_PRESET_RECALL    (1u << 5)
+#define ACTION_PRESET_STORE     (1u << 6)
+#define ACTION_PRESET_CLEAR     (1u << 7)
+#define ACTION_PRESET_CROSSFADE (1u << 8)
+#define ACTION_TAP_SAVE         (1u << 9)
+
+// Modules a preset slot holds
+#define PRESET_MODULES          (DSP_CONTROL_SUBSONIC | DSP_CONTROL_PREGAIN | \
+                                 DSP_CONTROL_EQUALIZER | DSP_CONTROL_LIMITER)
+
+// Settings a command touched: commit applies only these, through the
+// module's own setter (a band or a field, not the whole module)
+#define FIELD_SUBSONIC_FREQ     (1u << 0)
+#define FIELD_SUBSONIC_ENABLE   (1u << 1)
+#define FIELD_PREGAIN_GAIN      (1u << 2)
+#define FIELD_PREGAIN_ENABLE    (1u << 3)
+#define FIELD_EQ_ENABLE         (1u << 4)
+#define FIELD_LIMITER_THRESHOLD (1u << 5)
+#define FIELD_LIMITER_ENABLE    (1u << 6)
+#define FIELD_LIMITER_TRUE_PEAK (1u << 7)
+#define FIELD_CONV_GAIN         (1u << 8)
+#define FIELD_CONV_ENABLE       (1u << 9)
+#define FIELD_MB_ENABLE         (1u << 10)
+#define FIELD_MB_LAYOUT         (1u << 11)  // Band count or split points
+#define FIELD_DELAY_ENABLE      (1u << 12)
+#define FIELD_DELAY_LEFT        (1u << 13)
+#define FIELD_DELAY_RIGHT       (1u << 14)
+
+// Fields that belong to the preset modules
+#define PRESET_FIELDS           (FIELD_SUBSONIC_FREQ | FIELD_SUBSONIC_ENABLE | \
+                                 FIELD_PREGAIN_GAIN | FIELD_PREGAIN_ENABLE | FIELD_EQ_ENABLE | \
+                                 FIELD_LIMITER_THRESHOLD | FIELD_LIMITER_ENABLE | \
+                                 FIELD_LIMITER_TRUE_PEAK)
+
+static_assert(EQ_MAX_BANDS <= 32 && MULTIBAND_MAX_BANDS <= 32, "band masks are 32 bits");
+
+// The batch being built (one at a time, under s_lock)
+typedef struct {
+    subsonic_settings_t subsonic;
+    pregain_settings_t pregain;
+    equalizer_settings_t equalizer;
+    limiter_settings_t limiter;
+    convolver_settings_t convolver;
+    crossover_settings_t crossover;
+    multiband_settings_t multiband;
+    delay_line_settings_t delay;
+    audio_tap_settings_t tap;
+    uint32_t loaded;                        // DSP_CONTROL_* settings read from the module
+    uint32_t dirty;                         // DSP_CONTROL_* module flags
+    uint32_t fields;                        // FIELD_*
+    uint32_t eq_bands;                      // Equalizer bands edited (bit per band)
+    uint32_t mb_bands;                      // Multiband bands edited (bit per band)
+    uint32_t actions;                       // ACTION_*
+    uint32_t sample_rate;                   // Requested rate, 0 for no change
+    bool spectrum_enabled;                  // With ACTION_SPECTRUM_ENABLE
+    int preset_recall;                      // Slot, with ACTION_PRESET_RECALL (before the edits)
+    int preset_store;                       // Slot, with ACTION_PRESET_STORE (after the edits)
+    int preset_clear;                       // Slot, with ACTION_PRESET_CLEAR
+    char preset_name[PRESET_BANK_NAME_LEN + 1]; // Name for preset_store ("" = keep)
+    bool preset_crossfade;                  // With ACTION_PRESET_CROSSFADE
+} batch_t;
+
+static batch_t s_batch;
+static SemaphoreHandle_t s_lock = NULL;
+
+static const dsp_control_preset_t s_presets[] = {
+    { "flat",  "Flat",          {  0.0f,  0.0f,  0.0f,  0.0f,  0.0f }, true  },
+    { "bass",  "Bass Boost",    {  6.0f,  4.0f,  0.0f,  0.0f,  0.0f }, false },
+    { "vocal", "Vocal Clarity", { -2.0f,  0.0f,  3.0f,  5.0f,  2.0f }, false },
+    { "rock",  "Rock",          {  5.0f,  3.0f, -4.0f,  2.0f,  6.0f }, false },
+    { "jazz",  "Jazz",          {  2.0f,  1.0f,  0.0f,  1.0f,  3.0f }, false },
+};
+#define NUM_PRESETS (sizeof(s_presets) / sizeof(s_presets[0]))
+
+/* Value parsers: length-delimited, surrounding blanks ignored */
+
+static void trim(const char **s, size_t *n)
+{
+    while (*n > 0 && (**s == ' ' || **s == '\t' || **s == '\r' || **s == '\n')) {
+        (*s)++;
+        (*n)--;
+    }
+    while (*n > 0 && ((*s)[*n - 1] == ' ' || (*s)[*n - 1] == '\t' ||
+                      (*s)[*n - 1] == '\r' || (*s)[*n - 1] == '\n')) {
+        (*n)--;
+    }
+}
+
+static bool equals(const char *s, size_t n, const char *literal)
+{
+    return strlen(literal) == n && memcmp(s, literal, n) == 0;
+}
+
+static bool parse_float(const char *s, size_t n, float *out)
+{
+    static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+    trim(&s, &n);
+    size_t i = 0;
+    bool negative = false;
+    if (i < n && (s[i] == '-' || s[i] == '+')) {
+        negative = (s[i] == '-');
+        i++;
+    }
+
+    // Up to 9 significant digits in an integer mantissa, the rest as exponent
+    uint32_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; i < n && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        if (mantissa < 100000000u) {
+            mantissa = mantissa * 10 + (uint32_t)(s[i] - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (i < n && s[i] == '.') {
+        for (i++; i < n && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+            if (mantissa < 100000000u) {
+                mantissa = mantissa * 10 + (uint32_t)(s[i] - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        bool exp_negative = false;
+        if (i < n && (s[i] == '-' || s[i] == '+')) {
+            exp_negative = (s[i] == '-');
+            i++;
+        }
+        int e = 0;
+        int exp_digits = 0;
+        for (; i < n && s[i] >= '0' && s[i] <= '9'; i++, exp_digits++) {
+            if (e < 100) {
+                e = e * 10 + (s[i] - '0');
+            }
+        }
+        if (exp_digits == 0) {
+            return false;
+        }
+        exponent += exp_negative ? -e : e;
+    }
+    if (i != n) {
+        return false;
+    }
+
+    float value = (float)mantissa;
+    const int mag = (exponent < 0) ? -exponent : exponent;
+    const float scale = (mag <= 10) ? pow10[mag] : powf(10.0f, (float)mag);
+    value = (exponent < 0) ? value / scale : value * scale;
+    if (!isfinite(value)) {
+        return false;
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+static bool parse_uint(const char *s, size_t n, uint32_t *out)
+{
+    trim(&s, &n);
+    if (n == 0 || n > 9) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (uint32_t)(s[i] - '0');
+    }
+    *out = value;
+    return true;
+}
+
+static bool parse_bool(const char *s, size_t n, bool *out)
+{
+    trim(&s, &n);
+    if (equals(s, n, "true") || equals(s, n, "1") || equals(s, n, "on")) {
+        *out = true;
+        return true;
+    }
+    if (equals(s, n, "false") || equals(s, n, "0") || equals(s, n, "off")) {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+/* Command handlers: edit s_batch; index is the numeric path segment (or -1) */
+
+// Mark a module (and field) of the batch as edited; the module's settings
+// are read the first time a command of the batch touches it
+static void batch_touch(uint32_t module, uint32_t field)
+{
+    if (!(s_batch.loaded & module)) {
+        switch (module) {
+        case DSP_CONTROL_SUBSONIC:  subsonic_get_settings(&subsonic, &s_batch.subsonic); break;
+        case DSP_CONTROL_PREGAIN:   pregain_get_settings(&pregain, &s_batch.pregain); break;
+        case DSP_CONTROL_EQUALIZER: equalizer_get_settings(&equalizer, &s_batch.equalizer); break;
+        case DSP_CONTROL_LIMITER:   limiter_get_settings(&limiter, &s_batch.limiter); break;
+        case DSP_CONTROL_CONVOLVER: convolver_get_settings(&convolver, &s_batch.convolver); break;
+        case DSP_CONTROL_CROSSOVER: crossover_get_settings(&crossover, &s_batch.crossover); break;
+        case DSP_CONTROL_MULTIBAND: multiband_get_settings(&multiband, &s_batch.multiband); break;
+        case DSP_CONTROL_DELAY:     delay_line_get_settings(&delay_line, &s_batch.delay); break;
+        case DSP_CONTROL_TAP:       audio_tap_get_settings(&s_batch.tap); break;
+        default: break;
+        }
+        s_batch.loaded |= module;
+    }
+    s_batch.dirty |= module;
+    s_batch.fields |= field;
+}
+
+typedef esp_err_t (*handler_t)(int index, const char *value, size_t len);
+
+static esp_err_t set_subsonic_freq(int index, const char *value, size_t len)
+{
+    float freq;
+    if (!parse_float(value, len, &freq) || freq < SUBSONIC_MIN_FREQ || freq > SUBSONIC_MAX_FREQ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_SUBSONIC, FIELD_SUBSONIC_FREQ);
+    s_batch.subsonic.cutoff_freq = freq;
+    return ESP_OK;
+}
+
+static esp_err_t set_subsonic_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_SUBSONIC, FIELD_SUBSONIC_ENABLE);
+    s_batch.subsonic.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_pregain_gain(int index, const char *value, size_t len)
+{
+    float gain;
+    if (!parse_float(value, len, &gain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Clamped like pregain_set_gain
+    batch_touch(DSP_CONTROL_PREGAIN, FIELD_PREGAIN_GAIN);
+    s_batch.pregain.gain_db = gain;
+    return ESP_OK;
+}
+
+static esp_err_t set_pregain_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_PREGAIN, FIELD_PREGAIN_ENABLE);
+    s_batch.pregain.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+// Band of an eq/band/# path, or NULL; values are clamped when applied
+static eq_band_settings_t *batch_band(int index)
+{
+    if (index < 0 || index >= EQ_MAX_BANDS) {
+        return NULL;
+    }
+    batch_touch(DSP_CONTROL_EQUALIZER, 0);
+    s_batch.eq_bands |= 1u << index;
+    return &s_batch.equalizer.bands[index];
+}
+
+static esp_err_t set_eq_band_gain(int index, const char *value, size_t len)
+{
+    float gain;
+    eq_band_settings_t *band = batch_band(index);
+    if (band == NULL || !parse_float(value, len, &gain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->gain_db = gain;
+    return ESP_OK;
+}
+
+static esp_err_t set_eq_band_type(int index, const char *value, size_t len)
+{
+    eq_band_settings_t *band = batch_band(index);
+    if (band == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    trim(&value, &len);
+    for (int t = 0; t < EQ_FILTER_TYPE_COUNT; t++) {
+        if (equals(value, len, equalizer_type_name((eq_filter_type_t)t))) {
+            band->type = (uint8_t)t;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t set_eq_band_freq(int index, const char *value, size_t len)
+{
+    float freq;
+    eq_band_settings_t *band = batch_band(index);
+    if (band == NULL || !parse_float(value, len, &freq)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->freq = freq;
+    return ESP_OK;
+}
+
+static esp_err_t set_eq_band_q(int index, const char *value, size_t len)
+{
+    float q;
+    eq_band_settings_t *band = batch_band(index);
+    if (band == NULL || !parse_float(value, len, &q)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->q = q;
+    return ESP_OK;
+}
+
+static esp_err_t set_eq_band_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    eq_band_settings_t *band = batch_band(index);
+    if (band == NULL || !parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_eq_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_EQUALIZER, FIELD_EQ_ENABLE);
+    s_batch.equalizer.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_eq_preset(int index, const char *value, size_t len)
+{
+    trim(&value, &len);
+    const dsp_control_preset_t *preset = dsp_control_find_preset(value, len);
+    if (preset == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const int bands = preset->all_bands ? EQ_MAX_BANDS : EQ_DEFAULT_BANDS;
+    batch_touch(DSP_CONTROL_EQUALIZER, 0);
+    for (int i = 0; i < bands; i++) {
+        s_batch.equalizer.bands[i].gain_db = (i < EQ_DEFAULT_BANDS) ? preset->gains_db[i] : 0.0f;
+        s_batch.eq_bands |= 1u << i;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t set_limiter_threshold(int index, const char *value, size_t len)
+{
+    float threshold;
+    if (!parse_float(value, len, &threshold)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Clamped like limiter_set_threshold
+    batch_touch(DSP_CONTROL_LIMITER, FIELD_LIMITER_THRESHOLD);
+    s_batch.limiter.threshold_db = threshold;
+    return ESP_OK;
+}
+
+static esp_err_t set_limiter_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_LIMITER, FIELD_LIMITER_ENABLE);
+    s_batch.limiter.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_limiter_true_peak(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_LIMITER, FIELD_LIMITER_TRUE_PEAK);
+    s_batch.limiter.true_peak = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_conv_gain(int index, const char *value, size_t len)
+{
+    float gain;
+    if (!parse_float(value, len, &gain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Clamped like convolver_set_gain
+    batch_touch(DSP_CONTROL_CONVOLVER, FIELD_CONV_GAIN);
+    s_batch.convolver.gain_db = gain;
+    return ESP_OK;
+}
+
+static esp_err_t set_conv_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_CONVOLVER, FIELD_CONV_ENABLE);
+    s_batch.convolver.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_xover_freq(int index, const char *value, size_t len)
+{
+    float freq;
+    if (index < 0 || index >= CROSSOVER_POINTS || !parse_float(value, len, &freq) ||
+        freq < CROSSOVER_MIN_FREQ || freq > CROSSOVER_MAX_FREQ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Put in order when applied, so that both points can move in one batch
+    batch_touch(DSP_CONTROL_CROSSOVER, 0);
+    s_batch.crossover.freq[index] = freq;
+    return ESP_OK;
+}
+
+// Way of an xover/way/# path, or NULL; values are clamped when applied
+static crossover_way_settings_t *batch_way(int index)
+{
+    if (index < 0 || index >= CROSSOVER_WAYS) {
+        return NULL;
+    }
+    batch_touch(DSP_CONTROL_CROSSOVER, 0);
+    return &s_batch.crossover.ways[index];
+}
+
+static esp_err_t set_xover_way_gain(int index, const char *value, size_t len)
+{
+    float gain;
+    crossover_way_settings_t *way = batch_way(index);
+    if (way == NULL || !parse_float(value, len, &gain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    way->gain_db = gain;
+    return ESP_OK;
+}
+
+static esp_err_t set_xover_way_delay(int index, const char *value, size_t len)
+{
+    float delay;
+    crossover_way_settings_t *way = batch_way(index);
+    if (way == NULL || !parse_float(value, len, &delay)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    way->delay_ms = delay;
+    return ESP_OK;
+}
+
+static esp_err_t set_xover_way_invert(int index, const char *value, size_t len)
+{
+    bool invert;
+    crossover_way_settings_t *way = batch_way(index);
+    if (way == NULL || !parse_bool(value, len, &invert)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    way->invert = invert ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_xover_way_limit(int index, const char *value, size_t len)
+{
+    float threshold;
+    crossover_way_settings_t *way = batch_way(index);
+    if (way == NULL || !parse_float(value, len, &threshold)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Clamped like limiter_set_threshold
+    way->limit_db = threshold;
+    return ESP_OK;
+}
+
+static esp_err_t set_xover_way_true_peak(int index, const char *value, size_t len)
+{
+    bool enable;
+    crossover_way_settings_t *way = batch_way(index);
+    if (way == NULL || !parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    way->true_peak = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_MULTIBAND, FIELD_MB_ENABLE);
+    s_batch.multiband.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_bands(int index, const char *value, size_t len)
+{
+    uint32_t bands;
+    if (!parse_uint(value, len, &bands) || bands < MULTIBAND_MIN_BANDS || bands > MULTIBAND_MAX_BANDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_MULTIBAND, FIELD_MB_LAYOUT);
+    s_batch.multiband.num_bands = (uint8_t)bands;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_freq(int index, const char *value, size_t len)
+{
+    float freq;
+    if (index < 0 || index >= MULTIBAND_MAX_BANDS - 1 || !parse_float(value, len, &freq) ||
+        freq < MULTIBAND_MIN_FREQ || freq > MULTIBAND_MAX_FREQ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Put in order when applied, like the crossover points
+    batch_touch(DSP_CONTROL_MULTIBAND, FIELD_MB_LAYOUT);
+    s_batch.multiband.freq[index] = freq;
+    return ESP_OK;
+}
+
+// Band of an mb/band/# path, or NULL; values are clamped when applied
+static multiband_band_settings_t *batch_mb_band(int index)
+{
+    if (index < 0 || index >= MULTIBAND_MAX_BANDS) {
+        return NULL;
+    }
+    batch_touch(DSP_CONTROL_MULTIBAND, 0);
+    s_batch.mb_bands |= 1u << index;
+    return &s_batch.multiband.bands[index];
+}
+
+static esp_err_t set_mb_band_threshold(int index, const char *value, size_t len)
+{
+    float threshold;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &threshold)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->threshold_db = threshold;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_ratio(int index, const char *value, size_t len)
+{
+    float ratio;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &ratio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->ratio = ratio;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_attack(int index, const char *value, size_t len)
+{
+    float attack;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &attack)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->attack_ms = attack;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_release(int index, const char *value, size_t len)
+{
+    float release;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &release)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->release_ms = release;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_makeup(int index, const char *value, size_t len)
+{
+    float makeup;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &makeup)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->makeup_db = makeup;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_exp_threshold(int index, const char *value, size_t len)
+{
+    float exp_threshold;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &exp_threshold)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->exp_threshold_db = exp_threshold;
+    return ESP_OK;
+}
+
+static esp_err_t set_mb_band_exp_ratio(int index, const char *value, size_t len)
+{
+    float exp_ratio;
+    multiband_band_settings_t *band = batch_mb_band(index);
+    if (band == NULL || !parse_float(value, len, &exp_ratio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    band->exp_ratio = exp_ratio;
+    return ESP_OK;
+}
+
+static esp_err_t set_delay_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_DELAY, FIELD_DELAY_ENABLE);
+    s_batch.delay.enabled = enable ? 1 : 0;
+    return ESP_OK;
+}
+
+static esp_err_t set_delay_channel(int channel, const char *value, size_t len)
+{
+    float delay_ms;
+    if (!parse_float(value, len, &delay_ms) || delay_ms < 0.0f || delay_ms > (float)DELAY_LINE_MAX_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_DELAY, (channel == 0) ? FIELD_DELAY_LEFT : FIELD_DELAY_RIGHT);
+    s_batch.delay.delay_ms[channel] = delay_ms;
+    return ESP_OK;
+}
+
+static esp_err_t set_delay_left(int index, const char *value, size_t len)
+{
+    return set_delay_channel(0, value, len);
+}
+
+static esp_err_t set_delay_right(int index, const char *value, size_t len)
+{
+    return set_delay_channel(1, value, len);
+}
+
+static esp_err_t set_audio_rate(int index, const char *value, size_t len)
+{
+    uint32_t rate;
+    if (!parse_uint(value, len, &rate) || !audio_rate_is_supported(rate)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_batch.sample_rate = rate;
+    return ESP_OK;
+}
+
+static esp_err_t do_perf_reset(int index, const char *value, size_t len)
+{
+    s_batch.actions |= ACTION_PERF_RESET;
+    return ESP_OK;
+}
+
+static esp_err_t do_meter_reset(int index, const char *value, size_t len)
+{
+    s_batch.actions |= ACTION_METER_RESET;
+    return ESP_OK;
+}
+
+static esp_err_t set_spectrum_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_batch.spectrum_enabled = enable;
+    s_batch.actions |= ACTION_SPECTRUM_ENABLE;
+    return ESP_OK;
+}
+
+static esp_err_t do_spectrum_reset(int index, const char *value, size_t len)
+{
+    s_batch.actions |= ACTION_SPECTRUM_RESET;
+    return ESP_OK;
+}
+
+static esp_err_t do_xrun_reset(int index, const char *value, size_t len)
+{
+    s_batch.actions |= ACTION_XRUN_RESET;
+    return ESP_OK;
+}
+
+// Slot of a preset/recall or preset/clear value: a number or a slot name
+static esp_err_t parse_preset_slot(const char *value, size_t len, int *slot)
+{
+    if (!PRESET_BANK_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint32_t number;
+    trim(&value, &len);
+    if (parse_uint(value, len, &number)) {
+        *slot = ((int)number < PRESET_BANK_SLOTS) ? (int)number : -1;
+    } else {
+        *slot = preset_bank_find(value, len);
+    }
+    return (*slot >= 0) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t do_preset_recall(int index, const char *value, size_t len)
+{
+    int slot;
+    esp_err_t err = parse_preset_slot(value, len, &slot);
+    if (err != ESP_OK) {
+        return err;
+    }
+    const preset_bank_record_t *record = preset_bank_get_record(slot);
+    if (record == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The recall replaces earlier edits of its modules; later commands of
+    // the batch edit the recalled state
+    s_batch.subsonic = record->subsonic;
+    s_batch.pregain = record->pregain;
+    s_batch.equalizer = record->equalizer;
+    s_batch.limiter = record->limiter;
+    s_batch.loaded |= PRESET_MODULES;
+    s_batch.dirty &= ~PRESET_MODULES;
+    s_batch.fields &= ~PRESET_FIELDS;
+    s_batch.eq_bands = 0;
+    s_batch.preset_recall = slot;
+    s_batch.actions |= ACTION_PRESET_RECALL;
+    return ESP_OK;
+}
+
+static esp_err_t do_preset_store(int index, const char *value, size_t len)
+{
+    if (!PRESET_BANK_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint32_t number;
+    trim(&value, &len);
+    // A numeric name would read as a slot number in preset/recall
+    if (index < 0 || index >= PRESET_BANK_SLOTS || len > PRESET_BANK_NAME_LEN ||
+        (len > 0 && parse_uint(value, len, &number))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Printable, and nothing JSON would need escaped (preset/state)
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)value[i] < 0x20 || value[i] == 0x7f || value[i] == '"' || value[i] == '\\') {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    memset(s_batch.preset_name, 0, sizeof(s_batch.preset_name));
+    memcpy(s_batch.preset_name, value, len);
+    s_batch.preset_store = index;
+    s_batch.actions |= ACTION_PRESET_STORE;
+    return ESP_OK;
+}
+
+static esp_err_t do_preset_clear(int index, const char *value, size_t len)
+{
+    int slot;
+    esp_err_t err = parse_preset_slot(value, len, &slot);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_batch.preset_clear = slot;
+    s_batch.actions |= ACTION_PRESET_CLEAR;
+    return ESP_OK;
+}
+
+static esp_err_t set_preset_crossfade(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!PRESET_BANK_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_batch.preset_crossfade = enable;
+    s_batch.actions |= ACTION_PRESET_CROSSFADE;
+    return ESP_OK;
+}
+
+static esp_err_t set_tap_enable(int index, const char *value, size_t len)
+{
+    bool enable;
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!parse_bool(value, len, &enable)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_TAP, 0);
+    s_batch.tap.enabled = enable;
+    return ESP_OK;
+}
+
+static esp_err_t set_tap_host(int index, const char *value, size_t len)
+{
+    uint32_t host;
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    trim(&value, &len);
+    if (!audio_tap_parse_host(value, len, &host)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_TAP, 0);
+    s_batch.tap.host = host;
+    return ESP_OK;
+}
+
+static esp_err_t set_tap_port(int index, const char *value, size_t len)
+{
+    uint32_t port;
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!parse_uint(value, len, &port) || port == 0 || port > 65535) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_TAP, 0);
+    s_batch.tap.port = (uint16_t)port;
+    return ESP_OK;
+}
+
+static esp_err_t set_tap_point(int index, const char *value, size_t len)
+{
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    trim(&value, &len);
+    for (int p = 0; p < AUDIO_TAP_POINT_COUNT; p++) {
+        if (equals(value, len, audio_tap_point_name((audio_tap_point_t)p))) {
+            batch_touch(DSP_CONTROL_TAP, 0);
+            s_batch.tap.point = (uint8_t)p;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t set_tap_format(int index, const char *value, size_t len)
+{
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    trim(&value, &len);
+    for (int f = 0; f < AUDIO_TAP_FORMAT_COUNT; f++) {
+        // "L24" or "l24"
+        const char *name = audio_tap_format_name((audio_tap_format_t)f);
+        if (len == 3 && (value[0] == 'L' || value[0] == 'l') && memcmp(value + 1, name + 1, 2) == 0) {
+            batch_touch(DSP_CONTROL_TAP, 0);
+            s_batch.tap.format = (uint8_t)f;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t set_tap_decimation(int index, const char *value, size_t len)
+{
+    uint32_t decimation;
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!parse_uint(value, len, &decimation) || decimation == 0 || decimation == 5 ||
+        decimation > AUDIO_TAP_MAX_DECIMATION) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    batch_touch(DSP_CONTROL_TAP, 0);
+    s_batch.tap.decimation = (uint8_t)decimation;
+    return ESP_OK;
+}
+
+static esp_err_t do_tap_save(int index, const char *value, size_t len)
+{
+    if (!AUDIO_TAP_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    s_batch.actions |= ACTION_TAP_SAVE;
+    return ESP_OK;
+}
+
+/* Registry: '#' in a path matches one numeric segment (the handler's index) */
+
+typedef struct {
+    const char *path;
+    handler_t handler;
+} command_t;
+
+static const command_t s_commands[] = {
+    { "subsonic/freq",      set_subsonic_freq },
+    { "subsonic/enable",    set_subsonic_enable },
+    { "pregain/set",        set_pregain_gain },
+    { "pregain/enable",     set_pregain_enable },
+    { "eq/band/#",          set_eq_band_gain },
+    { "eq/band/#/type",     set_eq_band_type },
+    { "eq/band/#/freq",     set_eq_band_freq },
+    { "eq/band/#/q",        set_eq_band_q },
+    { "eq/band/#/enable",   set_eq_band_enable },
+    { "eq/enable",          set_eq_enable },
+    { "eq/preset",          set_eq_preset },
+    { "limiter/threshold",  set_limiter_threshold },
+    { "limiter/enable",     set_limiter_enable },
+    { "limiter/true_peak",  set_limiter_true_peak },
+    { "conv/gain",          set_conv_gain },
+    { "conv/enable",        set_conv_enable },
+    { "xover/freq/#",       set_xover_freq },
+    { "xover/way/#/gain",   set_xover_way_gain },
+    { "xover/way/#/delay",  set_xover_way_delay },
+    { "xover/way/#/invert", set_xover_way_invert },
+    { "xover/way/#/limit",  set_xover_way_limit },
+    { "xover/way/#/true_peak", set_xover_way_true_peak },
+    { "mb/enable",          set_mb_enable },
+    { "mb/bands",           set_mb_bands },
+    { "mb/freq/#",          set_mb_freq },
+    { "mb/band/#/threshold",     set_mb_band_threshold },
+    { "mb/band/#/ratio",         set_mb_band_ratio },
+    { "mb/band/#/attack",        set_mb_band_attack },
+    { "mb/band/#/release",       set_mb_band_release },
+    { "mb/band/#/makeup",        set_mb_band_makeup },
+    { "mb/band/#/exp_threshold", set_mb_band_exp_threshold },
+    { "mb/band/#/exp_ratio",     set_mb_band_exp_ratio },
+    { "delay/enable",       set_delay_enable },
+    { "delay/left",         set_delay_left },
+    { "delay/right",        set_delay_right },
+    { "audio/rate",         set_audio_rate },
+    { "perf/reset",         do_perf_reset },
+    { "meter/reset",        do_meter_reset },
+    { "spectrum/enable",    set_spectrum_enable },
+    { "spectrum/reset",     do_spectrum_reset },
+    { "xrun/reset",         do_xrun_reset },
+    { "preset/recall",      do_preset_recall },
+    { "preset/store/#",     do_preset_store },
+    { "preset/clear",       do_preset_clear },
+    { "preset/crossfade",   set_preset_crossfade },
+    { "tap/enable",         set_tap_enable },
+    { "tap/host",           set_tap_host },
+    { "tap/port",           set_tap_port },
+    { "tap/point",          set_tap_point },
+    { "tap/format",         set_tap_format },
+    { "tap/decimation",     set_tap_decimation },
+    { "tap/save",           do_tap_save },
+};
+#define NUM_COMMANDS (sizeof(s_commands) / sizeof(s_commands[0]))
+
+// Open-addressing hash index: slot holds command number + 1, 0 = empty
+#define INDEX_SLOTS     128
+#define INDEX_MASK      (INDEX_SLOTS - 1)
+static_assert(NUM_COMMANDS < INDEX_SLOTS / 2, "grow INDEX_SLOTS to keep the index sparse");
+static uint8_t s_index[INDEX_SLOTS];
+
+// FNV-1a of a path with every numeric segment hashed as '#'; also returns
+// the value of the first numeric segment (or -1)
+static uint32_t hash_path(const char *path, size_t len, int *index)
+{
+    uint32_t h = 2166136261u;
+    int value = -1;
+    size_t i = 0;
+    while (i < len) {
+        const bool segment_start = (i == 0 || path[i - 1] == '/');
+        if (segment_start && path[i] >= '0' && path[i] <= '9') {
+            size_t j = i;
+            int n = 0;
+            while (j < len && path[j] >= '0' && path[j] <= '9') {
+                if (n < 1000) {
+                    n = n * 10 + (path[j] - '0');
+                }
+                j++;
+            }
+            if (j == len || path[j] == '/') {
+                if (value < 0) {
+                    value = n;
+                }
+                h = (h ^ (uint8_t)'#') * 16777619u;
+                i = j;
+                continue;
+            }
+        }
+        h = (h ^ (uint8_t)path[i]) * 16777619u;
+        i++;
+    }
+    if (index) {
+        *index = value;
+    }
+    return h;
+}
+
+static bool path_matches(const char *pattern, const char *path, size_t len)
+{
+    size_t i = 0;
+    for (; *pattern != '\0'; pattern++) {
+        if (*pattern == '#') {
+            if (i >= len || path[i] < '0' || path[i] > '9') {
+                return false;
+            }
+            while (i < len && path[i] >= '0' && path[i] <= '9') {
+                i++;
+            }
+        } else if (i >= len || path[i++] != *pattern) {
+            return false;
+        }
+    }
+    return i == len;
+}
+
+static const command_t *find_command(const char *path, size_t len, int *index)
+{
+    uint32_t h = hash_path(path, len, index);
+    for (int probe = 0; probe < INDEX_SLOTS; probe++, h++) {
+        const uint8_t slot = s_index[h & INDEX_MASK];
+        if (slot == 0) {
+            return NULL;
+        }
+        const command_t *cmd = &s_commands[slot - 1];
+        if (path_matches(cmd->path, path, len)) {
+            return cmd;
+        }
+    }
+    return NULL;
+}
+
+void dsp_control_init(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+    }
+
+    memset(s_index, 0, sizeof(s_index));
+    for (size_t c = 0; c < NUM_COMMANDS; c++) {
+        const char *path = s_commands[c].path;
+        uint32_t h = hash_path(path, strlen(path), NULL);
+        while (s_index[h & INDEX_MASK] != 0) {
+            h++;
+        }
+        s_index[h & INDEX_MASK] = (uint8_t)(c + 1);
+    }
+}
+
+void dsp_control_begin(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    // Module settings are read when a command first touches them
+    memset(&s_batch, 0, sizeof(s_batch));
+}
+
+esp_err_t dsp_control_set(const char *path, size_t path_len, const char *value, size_t value_len)
+{
+    int index = -1;
+    const command_t *cmd = find_command(path, path_len, &index);
+    if (cmd == NULL) {
+        ESP_LOGW(TAG, "Unknown command: %.*s", (int)path_len, path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = cmd->handler(index, value, value_len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid value for %.*s: %.*s", (int)path_len, path, (int)value_len, value);
+    }
+    return err;
+}
+
+esp_err_t dsp_control_commit(uint32_t *changed, esp_err_t *action_err)
+{
+    uint32_t flags = 0;
+    esp_err_t err = ESP_OK;
+    esp_err_t action = ESP_OK;
+
+    if (s_batch.sample_rate != 0 && s_batch.sample_rate != audio_rate_get()) {
+        err = audio_rate_set(s_batch.sample_rate);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Batch discarded: sample rate %lu Hz not applied: %s",
+                     (unsigned long)s_batch.sample_rate, esp_err_to_name(err));
+            s_batch.dirty = 0;
+            s_batch.actions = 0;
+        } else {
+            flags |= DSP_CONTROL_RATE;
+        }
+    }
+
+    // Slots are baked for the rate they are recalled at
+    const uint32_t rate = audio_rate_get();
+    if (flags & DSP_CONTROL_RATE) {
+        preset_bank_set_sample_rate(rate);
+    }
+
+    // One group for all modules: every changed bank (and enable flag) is
+    // swapped in at the same block boundary, so no block runs with part of
+    // the batch. A recall joins it, so the recalled state and the edits on
+    // top of it arrive in the same block.
+    //
+    // Banks: subsonic, pre-gain, equalizer, limiter, convolver, multiband,
+    // delay line, the crossover and its per-way limiters. Flags: an enable
+    // and a pending reset for each module but pre-gain (enable only) and
+    // the crossover (reset only), and a reset per way limiter.
+    static_assert(COEFF_BANK_GROUP_BANKS >= 8 + CROSSOVER_WAYS,
+                  "a batch publishes every module bank and the crossover way limiters in one group");
+    static_assert(COEFF_BANK_GROUP_FLAGS >= 14 + CROSSOVER_WAYS,
+                  "a batch swaps every module enable and reset flag in one group");
+    const bool group = (s_batch.dirty & DSP_CONTROL_MODULES) != 0 ||
+                       (s_batch.actions & ACTION_PRESET_RECALL) != 0;
+    if (group) {
+        coeff_bank_group_begin();
+    }
+
+    // A recall comes first (no filter design); the edits continue on the
+    // recalled sets
+    if (s_batch.actions & ACTION_PRESET_RECALL) {
+        if (preset_bank_recall(s_batch.preset_recall, rate) == ESP_OK) {
+            persist_mark_dirty(PERSIST_SUBSONIC);
+            persist_mark_dirty(PERSIST_PREGAIN);
+            persist_mark_dirty(PERSIST_EQUALIZER);
+            persist_mark_dirty(PERSIST_LIMITER);
+            flags |= PRESET_MODULES | DSP_CONTROL_PRESET;
+        }
+    }
+
+    // Only what the batch's commands touched is applied again
+    const uint32_t fields = s_batch.fields;
+    if (s_batch.dirty & DSP_CONTROL_SUBSONIC) {
+        if (fields & FIELD_SUBSONIC_FREQ) {
+            subsonic_set_frequency(&subsonic, s_batch.subsonic.cutoff_freq, rate);
+        }
+        if (fields & FIELD_SUBSONIC_ENABLE) {
+            subsonic_set_enabled(&subsonic, s_batch.subsonic.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_SUBSONIC);
+    }
+    if (s_batch.dirty & DSP_CONTROL_PREGAIN) {
+        if (fields & FIELD_PREGAIN_GAIN) {
+            pregain_set_gain(&pregain, s_batch.pregain.gain_db);
+        }
+        if (fields & FIELD_PREGAIN_ENABLE) {
+            pregain_set_enabled(&pregain, s_batch.pregain.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_PREGAIN);
+    }
+    if (s_batch.dirty & DSP_CONTROL_EQUALIZER) {
+        equalizer_apply_bands(&equalizer, &s_batch.equalizer, s_batch.eq_bands, rate);
+        if (fields & FIELD_EQ_ENABLE) {
+            equalizer_set_enabled(&equalizer, s_batch.equalizer.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_EQUALIZER);
+    }
+    if (s_batch.dirty & DSP_CONTROL_LIMITER) {
+        if (fields & FIELD_LIMITER_THRESHOLD) {
+            limiter_set_threshold(&limiter, s_batch.limiter.threshold_db);
+        }
+        if (fields & FIELD_LIMITER_TRUE_PEAK) {
+            limiter_set_true_peak(&limiter, s_batch.limiter.true_peak != 0);
+        }
+        if (fields & FIELD_LIMITER_ENABLE) {
+            limiter_set_enabled(&limiter, s_batch.limiter.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_LIMITER);
+    }
+    if (s_batch.dirty & DSP_CONTROL_CONVOLVER) {
+        if (fields & FIELD_CONV_GAIN) {
+            convolver_set_gain(&convolver, s_batch.convolver.gain_db);
+        }
+        if (fields & FIELD_CONV_ENABLE) {
+            convolver_set_enabled(&convolver, s_batch.convolver.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_CONVOLVER);
+    }
+    if (s_batch.dirty & DSP_CONTROL_CROSSOVER) {
+        // One bake for the points and ways; a way limiter only if it changed
+        crossover_apply_settings(&crossover, &s_batch.crossover);
+        persist_mark_dirty(PERSIST_CROSSOVER);
+    }
+    if (s_batch.dirty & DSP_CONTROL_MULTIBAND) {
+        if (fields & FIELD_MB_LAYOUT) {
+            // Points are put in order together with the band count
+            multiband_apply_settings(&multiband, &s_batch.multiband);
+        } else {
+            for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+                if (s_batch.mb_bands & (1u << b)) {
+                    multiband_set_band(&multiband, b, &s_batch.multiband.bands[b]);
+                }
+            }
+            if (fields & FIELD_MB_ENABLE) {
+                multiband_set_enabled(&multiband, s_batch.multiband.enabled != 0);
+            }
+        }
+        persist_mark_dirty(PERSIST_MULTIBAND);
+    }
+    if (s_batch.dirty & DSP_CONTROL_DELAY) {
+        if (fields & FIELD_DELAY_LEFT) {
+            delay_line_set_delay(&delay_line, 0, s_batch.delay.delay_ms[0]);
+        }
+        if (fields & FIELD_DELAY_RIGHT) {
+            delay_line_set_delay(&delay_line, 1, s_batch.delay.delay_ms[1]);
+        }
+        if (fields & FIELD_DELAY_ENABLE) {
+            delay_line_set_enabled(&delay_line, s_batch.delay.enabled != 0);
+        }
+        persist_mark_dirty(PERSIST_DELAY);
+    }
+    if (group) {
+        coeff_bank_group_commit();
+    }
+    // Streaming settings, saved only on request (tap/save)
+    if (s_batch.dirty & DSP_CONTROL_TAP) {
+        audio_tap_apply_settings(&s_batch.tap);
+    }
+    flags |= s_batch.dirty;
+
+    // Saves can fail after the edits took effect: reported on their own
+    if (s_batch.actions & ACTION_TAP_SAVE) {
+        action = audio_tap_save_settings();
+    }
+    if (s_batch.actions & ACTION_PERF_RESET) {
+        dsp_perf_reset();
+    }
+    if (s_batch.actions & ACTION_METER_RESET) {
+        level_meter_reset();
+    }
+    if (s_batch.actions & ACTION_SPECTRUM_ENABLE) {
+        spectrum_set_enabled(s_batch.spectrum_enabled);
+    }
+    if (s_batch.actions & ACTION_SPECTRUM_RESET) {
+        spectrum_reset();
+    }
+    if (s_batch.actions & ACTION_XRUN_RESET) {
+        audio_xrun_reset();
+    }
+
+    // Stored last, so that the slot holds the result of the batch's edits
+    if (s_batch.actions & ACTION_PRESET_CLEAR) {
+        preset_bank_clear(s_batch.preset_clear);
+        flags |= DSP_CONTROL_PRESET;
+    }
+    if (s_batch.actions & ACTION_PRESET_STORE) {
+        esp_err_t store = preset_bank_store(s_batch.preset_store, s_batch.preset_name,
+                                            strlen(s_batch.preset_name), rate);
+        if (action == ESP_OK) {
+            action = store;
+        }
+        // Held in RAM even if the flash write failed
+        flags |= DSP_CONTROL_PRESET;
+    }
+    if (s_batch.actions & ACTION_PRESET_CROSSFADE) {
+        preset_bank_set_crossfade(s_batch.preset_crossfade);
+        flags |= DSP_CONTROL_PRESET;
+    }
+
+    xSemaphoreGive(s_lock);
+
+    if (changed) {
+        *changed = flags;
+    }
+    if (action_err) {
+        *action_err = action;
+    } else if (action != ESP_OK) {
+        ESP_LOGW(TAG, "Batch applied, but a save failed: %s", esp_err_to_name(action));
+    }
+    return err;
+}
+
+void dsp_control_abort(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t dsp_control_apply(const char *path, size_t path_len, const char *value, size_t value_len,
+                            uint32_t *changed)
+{
+    if (changed) {
+        *changed = 0;
+    }
+    dsp_control_begin();
+    esp_err_t err = dsp_control_set(path, path_len, value, value_len);
+    if (err != ESP_OK) {
+        dsp_control_abort();
+        return err;
+    }
+    esp_err_t action_err = ESP_OK;
+    err = dsp_control_commit(changed, &action_err);
+    return (err != ESP_OK) ? err : action_err;
+}
+
+/* Batch messages: one flat JSON object, strings without escapes */
+
+static size_t skip_blanks(const char *s, size_t len, size_t i)
+{
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) {
+        i++;
+    }
+    return i;
+}
+
+// Parse a string at s[i] == '"'; returns the index after the closing quote, or 0
+static size_t scan_string(const char *s, size_t len, size_t i, const char **start, size_t *n)
+{
+    size_t j = i + 1;
+    while (j < len && s[j] != '"') {
+        if (s[j] == '\\') {
+            return 0;
+        }
+        j++;
+    }
+    if (j >= len) {
+        return 0;
+    }
+    *start = s + i + 1;
+    *n = j - i - 1;
+    return j + 1;
+}
+
+static esp_err_t parse_batch(const char *json, size_t len, int *count)
+{
+    size_t i = skip_blanks(json, len, 0);
+    if (i >= len || json[i] != '{') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i = skip_blanks(json, len, i + 1);
+    if (i < len && json[i] == '}') {
+        return skip_blanks(json, len, i + 1) == len ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+
+    while (true) {
+        const char *path;
+        const char *value;
+        size_t path_len;
+        size_t value_len;
+
+        if (i >= len || json[i] != '"' || (i = scan_string(json, len, i, &path, &path_len)) == 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        i = skip_blanks(json, len, i);
+        if (i >= len || json[i] != ':') {
+            return ESP_ERR_INVALID_ARG;
+        }
+        i = skip_blanks(json, len, i + 1);
+        if (i < len && json[i] == '"') {
+            if ((i = scan_string(json, len, i, &value, &value_len)) == 0) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        } else {
+            // Number or literal, up to the next separator
+            value = json + i;
+            while (i < len && json[i] != ',' && json[i] != '}') {
+                if (json[i] == '{' || json[i] == '[' || json[i] == '"') {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                i++;
+            }
+            value_len = (size_t)(json + i - value);
+        }
+
+        if (*count >= DSP_CONTROL_MAX_BATCH) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        esp_err_t err = dsp_control_set(path, path_len, value, value_len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        (*count)++;
+
+        i = skip_blanks(json, len, i);
+        if (i < len && json[i] == ',') {
+            i = skip_blanks(json, len, i + 1);
+        } else if (i < len && json[i] == '}') {
+            return skip_blanks(json, len, i + 1) == len ? ESP_OK : ESP_ERR_INVALID_ARG;
+        } else {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+}
+
+esp_err_t dsp_control_apply_batch(const char *json, size_t len, uint32_t *changed, int *count)
+{
+    int n = 0;
+    if (changed) {
+        *changed = 0;
+    }
+
+    dsp_control_begin();
+    esp_err_t err = parse_batch(json, len, &n);
+    if (err != ESP_OK) {
+        dsp_control_abort();
+        ESP_LOGW(TAG, "Batch rejected after %d command(s): %s", n, esp_err_to_name(err));
+        n = 0;
+    } else {
+        // A failed save still leaves the batch's edits applied (and counted)
+        esp_err_t action_err = ESP_OK;
+        err = dsp_control_commit(changed, &action_err);
+        if (err != ESP_OK) {
+            n = 0;
+        } else {
+            err = action_err;
+        }
+    }
+
+    if (count) {
+        *count = n;
+    }
+    return err;
+}
+
+const dsp_control_preset_t *dsp_control_find_preset(const char *name, size_t len)
+{
+    for (size_t i = 0; i < NUM_PRESETS; i++) {
+        if (equals(name, len, s_presets[i].name)) {
+            return &s_presets[i];
+        }
+    }
+    return NULL;
+}
+
+const dsp_control_preset_t *dsp_control_get_preset(int index)
+{
+    return (index >= 0 && index < (int)NUM_PRESETS) ? &s_presets[index] : NULL;
+}
@@ -0,0 +1,160 @@
+#ifndef DSP_CONTROL_H
+#define DSP_CONTROL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "equalizer.h"
+
+// Command registry shared by MQTT and the serial console
+// Every remotely settable parameter has a path, the MQTT topic without the
+// "esp-dsp/" prefix ("pregain/set", "eq/band/3/freq", ...); a numeric path
+// segment is an index ("eq/band/#/freq"). Paths are found through a hash
+// index built at init, and paths and values are parsed where they lie
+// (length-delimited, no copy, no allocation), so an MQTT payload is handled
+// straight from the client's receive buffer.
+//
+// Commands are staged in a batch: the settings of a module (subsonic,
+// pre-gain, equalizer, convolver, limiter, crossover, multiband dynamics,
+// output delay) are copied when a command first touches it, edited by each
+// dsp_control_set and written back by dsp_control_commit through the
+// module's setters for just the fields and bands the batch touched, all
+// inside one coeff_bank group, so that every module the batch changed swaps
+// in its new parameters (and enable flags) at the same block boundary.
+// Nothing is applied unless every command of the batch parsed.
+//
+// Preset slots (preset_bank.h): preset/recall (slot number or name) is
+// carried out first at commit, inside the batch's group, and later commands
+// of the batch edit the recalled state, so the recall and the edits swap in
+// at the same block boundary; preset/store/# stores the state after all
+// edits.
+//
+// Audio tap settings (tap/..., audio_tap.h) are applied at commit but only
+// saved by tap/save.
+
+// Changed-state flags returned by dsp_control_commit (module bits match
+// persist_module_t)
+#define DSP_CONTROL_SUBSONIC    (1u << 0)
+#define DSP_CONTROL_PREGAIN     (1u << 1)
+#define DSP_CONTROL_EQUALIZER   (1u << 2)
+#define DSP_CONTROL_LIMITER     (1u << 3)
+#define DSP_CONTROL_CONVOLVER   (1u << 4)
+#define DSP_CONTROL_CROSSOVER   (1u << 5)
+#define DSP_CONTROL_MULTIBAND   (1u << 6)
+#define DSP_CONTROL_DELAY       (1u << 7)
+#define DSP_CONTROL_RATE        (1u << 8)
+#define DSP_CONTROL_PRESET      (1u << 9)   // Preset slots, recall mode or active slot
+#define DSP_CONTROL_TAP         (1u << 10)  // Audio tap settings
+#define DSP_CONTROL_MODULES     (DSP_CONTROL_SUBSONIC | DSP_CONTROL_PREGAIN | \
+                                 DSP_CONTROL_EQUALIZER | DSP_CONTROL_LIMITER | \
+                                 DSP_CONTROL_CONVOLVER | DSP_CONTROL_CROSSOVER | \
+                                 DSP_CONTROL_MULTIBAND | DSP_CONTROL_DELAY)
+
+// Commands in one batch message
+#define DSP_CONTROL_MAX_BATCH   64
+
+// Built-in equalizer gain presets (bands 0..EQ_DEFAULT_BANDS-1)
+typedef struct {
+    const char *name;                       // Command name ("bass")
+    const char *label;                      // Display name ("Bass Boost")
+    float gains_db[EQ_DEFAULT_BANDS];
+    bool all_bands;                         // Also zero the bands above EQ_DEFAULT_BANDS
+} dsp_control_preset_t;
+
+/**
+ * Build the path index and create the batch lock (before the command
+ * interfaces start)
+ */
+void dsp_control_init(void);
+
+/**
+ * Start a batch (takes the batch lock; end with commit or abort)
+ */
+void dsp_control_begin(void);
+
+/**
+ * Stage one command in the current batch
+ *
+ * Chain settings are only edited in the batch copy; the sample rate and the
+ * reset / analyzer commands are recorded and carried out at commit.
+ *
+ * @param path Path (not necessarily NUL-terminated)
+ * @param path_len Length of path
+ * @param value Value text (number, true/false/on/off/1/0 or name; not necessarily NUL-terminated)
+ * @param value_len Length of value
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for an unknown path, ESP_ERR_INVALID_ARG
+ *         for a value that does not parse or is out of range
+ */
+esp_err_t dsp_control_set(const char *path, size_t path_len, const char *value, size_t value_len);
+
+/**
+ * Apply the current batch and release the batch lock
+ *
+ * A sample rate change is carried out first; if it fails, nothing else is
+ * applied. Changed modules are marked for saving (persist.h). The saves of
+ * tap/save and preset/store/# run after the edits took effect, so their
+ * error is reported apart from the result.
+ *
+ * @param changed Set to the DSP_CONTROL_* flags of what changed (may be NULL)
+ * @param action_err Set to ESP_OK or the first audio_tap_save_settings /
+ *        preset_bank_store error (may be NULL: the error is only logged)
+ * @return ESP_OK (the batch is applied), or the audio_rate_set error
+ *         (nothing is applied)
+ */
+esp_err_t dsp_control_commit(uint32_t *changed, esp_err_t *action_err);
+
+/**
+ * Discard the current batch and release the batch lock
+ */
+void dsp_control_abort(void);
+
+/**
+ * Apply a single command (begin, set and commit)
+ *
+ * @param path Path
+ * @param path_len Length of path
+ * @param value Value text
+ * @param value_len Length of value
+ * @param changed Set to the DSP_CONTROL_* flags of what changed (may be NULL);
+ *        also set when a save failed after the command was applied
+ * @return As dsp_control_set, the dsp_control_commit error, or its
+ *         action_err
+ */
+esp_err_t dsp_control_apply(const char *path, size_t path_len, const char *value, size_t value_len,
+                            uint32_t *changed);
+
+/**
+ * Apply a batch message: a flat JSON object of path/value pairs, e.g.
+ * {"eq/band/0":6,"eq/band/0/q":0.9,"limiter/threshold":-1.5,"eq/enable":true}
+ *
+ * @param json Message (not necessarily NUL-terminated)
+ * @param len Length of json
+ * @param changed Set to the DSP_CONTROL_* flags of what changed (may be NULL)
+ * @param count Set to the number of commands applied (may be NULL)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the message does not parse or a
+ *         value is invalid, ESP_ERR_NOT_FOUND for an unknown path, or the
+ *         dsp_control_commit error (nothing is applied on these errors);
+ *         or the dsp_control_commit action_err, with the batch applied and
+ *         *changed and *count set
+ */
+esp_err_t dsp_control_apply_batch(const char *json, size_t len, uint32_t *changed, int *count);
+
+/**
+ * Look up a built-in equalizer preset
+ *
+ * @param name Preset name (not necessarily NUL-terminated)
+ * @param len Length of name
+ * @return Preset, or NULL if unknown
+ */
+const dsp_control_preset_t *dsp_control_find_preset(const char *name, size_t len);
+
+/**
+ * Get a built-in equalizer preset by position (for listings)
+ *
+ * @param index 0, 1, ...
+ * @return Preset, or NULL past the last one
+ */
+const dsp_control_preset_t *dsp_control_get_preset(int index);
+
+#endif // DSP_CONTROL_H
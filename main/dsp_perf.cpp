@@ -0,0 +1,193 @@
+#include "dsp_perf.h"
+#include "audio_config.h"
+#include "esp_rom_sys.h"
+#include <string.h>
+
+static const char *s_stage_names[DSP_PERF_STAGE_COUNT] = {
+    "i2s_read", "unpack", "subsonic", "pregain", "eq", "conv", "mb", "limiter", "true_peak", "delay", "pack", "chain", "xover", "i2s_write",
+};
+
+#if DSP_PERF_ENABLED
+
+// Statistics, written only by audio_task
+static dsp_perf_snapshot_t s_stats;
+
+// Sequence lock: odd while audio_task is updating s_stats
+static volatile uint32_t s_seq = 0;
+
+// Set by dsp_perf_reset, serviced by audio_task at the next block
+static volatile bool s_reset_pending = true;
+
+// Sample rate the deadline is computed for (dsp_perf_set_sample_rate)
+static volatile uint32_t s_sample_rate = SAMPLE_RATE;
+
+// Deadline for the current block size and rate, and one histogram bin of it
+static int s_deadline_frames = 0;
+static uint32_t s_deadline_rate = 0;
+static uint32_t s_bin_cycles = 1;
+
+// Chain sections of the current block so far, and the one that crossed the
+// deadline (DSP_PERF_STAGE_COUNT while in time)
+static uint32_t s_block_cycles = 0;
+static dsp_perf_stage_t s_late_stage = DSP_PERF_STAGE_COUNT;
+
+static void clear_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    for (int i = 0; i < DSP_PERF_STAGE_COUNT; i++) {
+        s_stats.stages[i].min = UINT32_MAX;
+    }
+    s_stats.cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+    s_deadline_frames = 0;
+}
+
+void DSP_HOT dsp_perf_block_begin(int num_frames)
+{
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+
+    if (s_reset_pending) {
+        s_reset_pending = false;
+        clear_stats();
+    }
+
+    // Only recomputed when the block size or sample rate changes
+    const uint32_t rate = s_sample_rate;
+    if ((num_frames != s_deadline_frames || rate != s_deadline_rate) && num_frames > 0) {
+        s_deadline_frames = num_frames;
+        s_deadline_rate = rate;
+        s_stats.deadline_cycles = (uint32_t)((uint64_t)num_frames * s_stats.cpu_mhz * 1000000u / rate);
+        s_bin_cycles = s_stats.deadline_cycles / (DSP_PERF_HIST_BINS - 1);
+        if (s_bin_cycles == 0) {
+            s_bin_cycles = 1;
+        }
+    }
+
+    s_block_cycles = 0;
+    s_late_stage = DSP_PERF_STAGE_COUNT;
+}
+
+void DSP_HOT dsp_perf_record(dsp_perf_stage_t stage, uint32_t cycles)
+{
+    dsp_perf_stage_stats_t *st = &s_stats.stages[stage];
+
+    st->count++;
+    st->last = cycles;
+    st->total += cycles;
+    if (cycles < st->min) {
+        st->min = cycles;
+    }
+    if (cycles > st->max) {
+        st->max = cycles;
+    }
+
+    uint32_t bin = cycles / s_bin_cycles;
+    if (bin >= DSP_PERF_HIST_BINS) {
+        bin = DSP_PERF_HIST_BINS - 1;
+    }
+    st->hist[bin]++;
+
+    if (stage == DSP_PERF_CHAIN && cycles > s_stats.deadline_cycles) {
+        s_stats.overruns++;
+    }
+
+    // The I2S waits are not part of the work, and the true-peak sidechain is
+    // already inside the limiter section
+    if (stage == DSP_PERF_CHAIN) {
+        if (s_late_stage == DSP_PERF_STAGE_COUNT && cycles > s_stats.deadline_cycles) {
+            s_late_stage = DSP_PERF_CHAIN;
+        }
+    } else if (stage != DSP_PERF_I2S_READ && stage != DSP_PERF_I2S_WRITE && stage != DSP_PERF_TRUE_PEAK) {
+        s_block_cycles += cycles;
+        if (s_late_stage == DSP_PERF_STAGE_COUNT && s_block_cycles > s_stats.deadline_cycles) {
+            s_late_stage = stage;
+        }
+    }
+}
+
+void DSP_HOT dsp_perf_block_end(void)
+{
+    s_stats.blocks++;
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+}
+
+dsp_perf_stage_t DSP_HOT dsp_perf_late_stage(void)
+{
+    return s_late_stage;
+}
+
+void dsp_perf_reset(void)
+{
+    s_reset_pending = true;
+}
+
+void dsp_perf_set_sample_rate(uint32_t sample_rate)
+{
+    // Loads measured against the old deadline no longer compare
+    s_sample_rate = sample_rate;
+    s_reset_pending = true;
+}
+
+esp_err_t dsp_perf_get_snapshot(dsp_perf_snapshot_t *snapshot)
+{
+    // A block takes milliseconds and the copy microseconds, so a retry is rare
+    for (int attempt = 0; attempt < 8; attempt++) {
+        uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_SEQ_CST);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(snapshot, &s_stats, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s_seq, __ATOMIC_SEQ_CST) == seq) {
+            // Before the first block: report "nothing recorded" consistently
+            if (s_reset_pending || seq == 0) {
+                memset(snapshot, 0, sizeof(*snapshot));
+                snapshot->cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+            }
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+#else
+
+void dsp_perf_reset(void)
+{
+}
+
+void dsp_perf_set_sample_rate(uint32_t sample_rate)
+{
+}
+
+esp_err_t dsp_perf_get_snapshot(dsp_perf_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+const char *dsp_perf_stage_name(dsp_perf_stage_t stage)
+{
+    if (stage < 0 || stage >= DSP_PERF_STAGE_COUNT) {
+        return "unknown";
+    }
+    return s_stage_names[stage];
+}
+
+float dsp_perf_avg_load(const dsp_perf_snapshot_t *snapshot, dsp_perf_stage_t stage)
+{
+    const dsp_perf_stage_stats_t *st = &snapshot->stages[stage];
+    if (st->count == 0 || snapshot->deadline_cycles == 0) {
+        return 0.0f;
+    }
+    return 100.0f * ((float)st->total / (float)st->count) / (float)snapshot->deadline_cycles;
+}
+
+float dsp_perf_cycles_to_us(const dsp_perf_snapshot_t *snapshot, uint64_t cycles)
+{
+    if (snapshot->cpu_mhz == 0) {
+        return 0.0f;
+    }
+    return (float)cycles / (float)snapshot->cpu_mhz;
+}
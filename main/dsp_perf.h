@@ -0,0 +1,175 @@
+#ifndef DSP_PERF_H
+#define DSP_PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "dsp_attr.h"
+
+// DSP profiler
+// audio_task samples the CPU cycle counter around every stage of a block and
+// around the I2S waits. Each record is a handful of integer operations, so
+// the profiler can stay enabled in production builds. Readers (serial, MQTT)
+// take consistent snapshots without ever blocking the audio task.
+
+#ifdef CONFIG_DSP_PERF
+#define DSP_PERF_ENABLED    1
+#else
+#define DSP_PERF_ENABLED    0
+#endif
+
+#if DSP_PERF_ENABLED
+#include "esp_cpu.h"
+#endif
+
+// Histogram: 10% steps of the block deadline, last bin = over the deadline
+#define DSP_PERF_HIST_BINS  11
+
+// Timed sections of one audio block
+typedef enum {
+    DSP_PERF_I2S_READ = 0,      // Waiting for the RX DMA block (low-latency I/O: copying it to TX)
+    DSP_PERF_UNPACK,            // >> 8 / int → float (staged and float modes)
+    DSP_PERF_SUBSONIC,          // Subsonic filter (staged and float modes)
+    DSP_PERF_PREGAIN,           // Pre-gain (staged and float modes)
+    DSP_PERF_EQ,                // Equalizer (staged and float modes)
+    DSP_PERF_CONV,              // FIR convolver (staged and float modes)
+    DSP_PERF_MULTIBAND,         // Multiband dynamics (staged and float modes)
+    DSP_PERF_LIMITER,           // Limiter (staged and float modes)
+    DSP_PERF_TRUE_PEAK,         // True-peak sidechain, part of limiter (staged and float modes)
+    DSP_PERF_DELAY,             // Output delay (staged and float modes)
+    DSP_PERF_PACK,              // << 8 / float → int (staged and float modes)
+    DSP_PERF_CHAIN,             // Whole DSP chain, any mode
+    DSP_PERF_XOVER,             // Crossover into the output ways (with CROSSOVER)
+    DSP_PERF_I2S_WRITE,         // Waiting for room in the TX DMA queue
+    DSP_PERF_STAGE_COUNT
+} dsp_perf_stage_t;
+
+// Statistics for one section (cycles)
+typedef struct {
+    uint32_t count;                         // Blocks recorded
+    uint32_t min;                           // Shortest
+    uint32_t max;                           // Longest
+    uint32_t last;                          // Most recent block
+    uint64_t total;                         // Sum, for the average
+    uint32_t hist[DSP_PERF_HIST_BINS];      // Blocks per 10% of the deadline
+} dsp_perf_stage_stats_t;
+
+// Consistent copy of all profiler statistics
+typedef struct {
+    dsp_perf_stage_stats_t stages[DSP_PERF_STAGE_COUNT];
+    uint32_t blocks;            // Blocks since the last reset
+    uint32_t overruns;          // Blocks whose DSP chain exceeded the deadline
+    uint32_t deadline_cycles;   // CPU cycles per block at the current block size
+    uint32_t cpu_mhz;           // Cycle counter frequency
+} dsp_perf_snapshot_t;
+
+#if DSP_PERF_ENABLED
+
+/**
+ * Read the CPU cycle counter
+ *
+ * @return Current cycle count (wraps; only differences are meaningful)
+ */
+static DSP_HOT_INLINE uint32_t dsp_perf_now(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+/**
+ * Start recording one block (audio task only)
+ *
+ * Services a pending dsp_perf_reset and sets the deadline for the block.
+ *
+ * @param num_frames Stereo frames in the block
+ */
+void dsp_perf_block_begin(int num_frames);
+
+/**
+ * Record the duration of one section of the current block (audio task only)
+ *
+ * @param stage Section that was timed
+ * @param cycles Elapsed cycles (difference of two dsp_perf_now values)
+ */
+void dsp_perf_record(dsp_perf_stage_t stage, uint32_t cycles);
+
+/**
+ * Finish the current block (audio task only)
+ *
+ * Makes the block's records visible to dsp_perf_get_snapshot.
+ */
+void dsp_perf_block_end(void);
+
+/**
+ * Get the section that was running when the current block passed its
+ * deadline (audio task only, after the chain ran)
+ *
+ * Per-stage sections are only timed in the staged and float chain modes;
+ * in fused mode a late block is attributed to DSP_PERF_CHAIN.
+ *
+ * @return Section, or DSP_PERF_STAGE_COUNT if the chain finished in time
+ */
+dsp_perf_stage_t dsp_perf_late_stage(void);
+
+#else
+
+static inline uint32_t dsp_perf_now(void) { return 0; }
+static inline void dsp_perf_block_begin(int num_frames) { (void)num_frames; }
+static inline void dsp_perf_record(dsp_perf_stage_t stage, uint32_t cycles) { (void)stage; (void)cycles; }
+static inline void dsp_perf_block_end(void) {}
+static inline dsp_perf_stage_t dsp_perf_late_stage(void) { return DSP_PERF_STAGE_COUNT; }
+
+#endif
+
+/**
+ * Clear all statistics (takes effect at the next block)
+ */
+void dsp_perf_reset(void);
+
+/**
+ * Set the sample rate the block deadline is computed for
+ *
+ * Also clears the statistics.
+ *
+ * @param sample_rate Rate in Hz
+ */
+void dsp_perf_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * Copy the current statistics
+ *
+ * Never blocks the audio task; retries if a block finished during the copy.
+ *
+ * @param snapshot Destination
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if the profiler is compiled out,
+ *         ESP_ERR_TIMEOUT if no consistent copy could be taken
+ */
+esp_err_t dsp_perf_get_snapshot(dsp_perf_snapshot_t *snapshot);
+
+/**
+ * Get the printable name of a section
+ *
+ * @param stage Section
+ * @return Name such as "eq" or "i2s_read"
+ */
+const char *dsp_perf_stage_name(dsp_perf_stage_t stage);
+
+/**
+ * Average duration of a section as a percentage of the block deadline
+ *
+ * @param snapshot Snapshot from dsp_perf_get_snapshot
+ * @param stage Section
+ * @return Average load in percent (0 if nothing was recorded)
+ */
+float dsp_perf_avg_load(const dsp_perf_snapshot_t *snapshot, dsp_perf_stage_t stage);
+
+/**
+ * Convert cycles to microseconds
+ *
+ * @param snapshot Snapshot from dsp_perf_get_snapshot
+ * @param cycles Cycle count
+ * @return Duration in microseconds
+ */
+float dsp_perf_cycles_to_us(const dsp_perf_snapshot_t *snapshot, uint64_t cycles);
+
+#endif // DSP_PERF_H
@@ -0,0 +1,557 @@
+#ifndef DSP_STAGE_H
+#define DSP_STAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dsp_chain.h"
+#include "dsp_perf.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "convolver.h"
+#include "multiband.h"
+#include "limiter.h"
+#include "delay_line.h"
+
+// Chain stage interface
+// Every stage of the DSP chain is described by one struct of static members,
+// so the chain (dsp_chain.cpp) can be instantiated from a list of stage types
+// at build time: each mode becomes one inlined call sequence, with no function
+// pointers and no enable checks in the sample loop.
+//
+//   id, name, perf          Stage identity (dsp_chain.h), printable name and
+//                           profiler section (dsp_perf.h)
+//   module_t, settings_t    Module instance / persistent settings types
+//   module(m)               The instance of a module set (dsp_chain_modules_t)
+//
+// Control (any task; the module publishes changes through its coeff_bank):
+//   enabled(s), set_enabled(s, on)          Runtime bypass
+//   reset(s)                                Clear history (next block)
+//   get_settings(s, out), apply_settings(s, in, sample_rate)
+//                                           Persistent settings (settings blob)
+//
+// Block paths (staged and float modes; the module checks its own enable):
+//   process(m, buffer, n), process_f32(m, block, n)
+//   record_perf(m)          Sub-sections the stage timed itself
+//
+// Fused path (audio task, one block):
+//   frame_t                 Block-local copies of parameters and state
+//   begin(m, f)             Latch parameters, start ramps; returns whether the
+//                           stage does anything this block
+//   frame(f, i, l, r)       One stereo frame (i = index of the left sample)
+//   block(f, buffer, n)     Whole block instead (stages with block_only set,
+//                           run between two frame loops on 24-bit samples)
+//   end(f)                  Write state back and release the parameters
+//
+// frame() must only touch f and the samples: it is inlined into one loop per
+// combination of active stages.
+
+#define DSP_STAGE_INLINE    inline __attribute__((always_inline))
+
+struct subsonic_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_SUBSONIC;
+    static constexpr const char *name = "subsonic";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_SUBSONIC;
+    static constexpr bool block_only = false;
+    typedef subsonic_t module_t;
+    typedef subsonic_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->subsonic; }
+
+    static bool enabled(module_t *s) { return subsonic_get_enabled(s); }
+    static void set_enabled(module_t *s, bool on) { subsonic_set_enabled(s, on); }
+    static void reset(module_t *s) { subsonic_reset(s); }
+    static void get_settings(const module_t *s, settings_t *out) { subsonic_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        subsonic_apply_settings(s, in, sample_rate);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n) { subsonic_process(m->subsonic, buffer, n); }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n) { subsonic_process_f32(m->subsonic, block, n); }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+    struct frame_t {
+        module_t *s;
+        bool active;
+        subsonic_biquad_coeffs_t c;
+        subsonic_biquad_state_t l;
+        subsonic_biquad_state_t r;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->subsonic;
+        const subsonic_params_t *p = subsonic_begin_block(f->s);
+        f->active = f->s->enabled;
+        f->c = p->coeffs;
+        f->l = f->s->state_left;
+        f->r = f->s->state_right;
+        return f->active;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r)
+    {
+        *l = biquad_q24_process(&f->c, &f->l, *l);
+        *r = biquad_q24_process(&f->c, &f->r, *r);
+    }
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n) {}
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        if (f->active) {
+            f->s->state_left = f->l;
+            f->s->state_right = f->r;
+        }
+        subsonic_end_block(f->s);
+    }
+};
+
+struct pregain_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_PREGAIN;
+    static constexpr const char *name = "pregain";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_PREGAIN;
+    static constexpr bool block_only = false;
+    typedef pregain_t module_t;
+    typedef pregain_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->pregain; }
+
+    static bool enabled(module_t *s) { return pregain_is_enabled(s); }
+    static void set_enabled(module_t *s, bool on) { pregain_set_enabled(s, on); }
+    static void reset(module_t *s) {}
+    static void get_settings(const module_t *s, settings_t *out) { pregain_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        pregain_apply_settings(s, in);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n) { pregain_process(m->pregain, buffer, n); }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n) { pregain_process_f32(m->pregain, block, n); }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+    struct frame_t {
+        module_t *s;
+        bool ramping;
+        float gain;
+        param_ramp_t ramp;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        // The ramp is started here, exactly as pregain_process does
+        f->s = m->pregain;
+        const pregain_params_t *p = pregain_begin_block(f->s);
+        f->ramping = f->s->enabled && pregain_ramp_begin(f->s, p);
+        f->gain = p->gain_linear;
+        f->ramp = f->s->ramp;
+        return f->s->enabled && (f->ramping || !p->unity);
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r)
+    {
+        const float g = f->ramping ? param_ramp_next(&f->ramp) : f->gain;
+        *l = pregain_apply_sample(g, *l);
+        *r = pregain_apply_sample(g, *r);
+    }
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n) {}
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        if (f->ramping) {
+            f->s->ramp = f->ramp;
+        }
+        pregain_end_block(f->s);
+    }
+};
+
+struct equalizer_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_EQUALIZER;
+    static constexpr const char *name = "eq";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_EQ;
+    // The SIMD kernel filters whole blocks, so the fused path splits around it
+    static constexpr bool block_only = EQUALIZER_BLOCK_KERNEL;
+    typedef equalizer_t module_t;
+    typedef equalizer_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->equalizer; }
+
+    static bool enabled(module_t *s) { return s->enabled; }
+    static void set_enabled(module_t *s, bool on) { equalizer_set_enabled(s, on); }
+    static void reset(module_t *s) { equalizer_reset(s); }
+    static void get_settings(const module_t *s, settings_t *out) { equalizer_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        equalizer_apply_settings(s, in, NULL, sample_rate);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n) { equalizer_process(m->equalizer, buffer, n); }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n) { equalizer_process_f32(m->equalizer, block, n); }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+#if EQUALIZER_BLOCK_KERNEL
+    struct frame_t {
+        module_t *s;
+        const equalizer_params_t *p;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        // equalizer_process_block resolves ramps and the flat bypass itself
+        f->s = m->equalizer;
+        f->p = equalizer_begin_block(f->s);
+        return f->s->enabled;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r) {}
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n)
+    {
+        equalizer_process_block(f->s, f->p, buffer, n);
+    }
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        equalizer_end_block(f->s);
+    }
+#else
+    // Only the bands in the cascade are copied, packed in processing order.
+    // While ramping, the first segment's coefficients are fetched up front;
+    // the ramp set keeps the same cascade for the whole block.
+    struct frame_t {
+        module_t *s;
+        const equalizer_params_t *p;
+        const equalizer_params_t *run;
+        bool ramping;
+        int n;
+        biquad_coeffs_t c[EQ_MAX_BANDS];
+        biquad_state_t l[EQ_MAX_BANDS];
+        biquad_state_t r[EQ_MAX_BANDS];
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->equalizer;
+        f->p = equalizer_begin_block(f->s);
+        f->ramping = f->s->enabled && equalizer_ramp_begin(f->s, f->p);
+        const bool active = f->s->enabled && (f->ramping || f->p->num_cascade > 0);
+        f->run = f->ramping ? equalizer_ramp_next(f->s, f->p) : f->p;
+        f->n = active ? f->run->num_cascade : 0;
+        for (int k = 0; k < f->n; k++) {
+            const int band = f->run->cascade[k];
+            f->c[k] = f->run->coeffs[band];
+            f->l[k] = f->s->state_left[band];
+            f->r[k] = f->s->state_right[band];
+        }
+        return active;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r)
+    {
+        // Same coefficient steps at the same frames as equalizer_process_block
+        if (f->ramping && i > 0 && ((i / 2) % PARAM_RAMP_SEGMENT_FRAMES) == 0) {
+            f->run = equalizer_ramp_next(f->s, f->p);
+            for (int k = 0; k < f->n; k++) {
+                f->c[k] = f->run->coeffs[f->run->cascade[k]];
+            }
+        }
+        int32_t xl = *l;
+        int32_t xr = *r;
+        for (int k = 0; k < f->n; k++) {
+            xl = biquad_q24_process(&f->c[k], &f->l[k], xl);
+            xr = biquad_q24_process(&f->c[k], &f->r[k], xr);
+        }
+        *l = xl;
+        *r = xr;
+    }
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n) {}
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        for (int k = 0; k < f->n; k++) {
+            const int band = f->run->cascade[k];
+            f->s->state_left[band] = f->l[k];
+            f->s->state_right[band] = f->r[k];
+        }
+        equalizer_end_block(f->s);
+    }
+#endif
+};
+
+#if CONVOLVER_ENABLED
+// Module sets without a convolver (snapshots for verification and benchmarks:
+// the delay line is far too large to copy) pass a NULL instance
+struct convolver_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_CONVOLVER;
+    static constexpr const char *name = "conv";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_CONV;
+    static constexpr bool block_only = true;
+    typedef convolver_t module_t;
+    typedef convolver_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->convolver; }
+
+    static bool enabled(module_t *s) { return s->enabled; }
+    static void set_enabled(module_t *s, bool on) { convolver_set_enabled(s, on); }
+    static void reset(module_t *s)
+    {
+        if (s) {
+            convolver_reset(s);
+        }
+    }
+    static void get_settings(const module_t *s, settings_t *out) { convolver_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        convolver_apply_settings(s, in);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n)
+    {
+        if (m->convolver) {
+            convolver_process(m->convolver, buffer, n);
+        }
+    }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n)
+    {
+        if (m->convolver) {
+            convolver_process_f32(m->convolver, block, n);
+        }
+    }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+    struct frame_t {
+        module_t *s;
+        const convolver_params_t *p;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->convolver;
+        if (f->s == NULL) {
+            return false;
+        }
+        f->p = convolver_begin_block(f->s);
+        return convolver_block_active(f->s, f->p);
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r) {}
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n)
+    {
+        convolver_process_block(f->s, f->p, buffer, n);
+    }
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        if (f->s) {
+            convolver_end_block(f->s);
+        }
+    }
+};
+#endif
+
+#if MULTIBAND_ENABLED
+// Module sets without the processor (snapshots: the state is allocated
+// once, a copy would share it) pass a NULL instance
+struct multiband_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_MULTIBAND;
+    static constexpr const char *name = "mb";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_MULTIBAND;
+    static constexpr bool block_only = true;
+    typedef multiband_t module_t;
+    typedef multiband_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->multiband; }
+
+    static bool enabled(module_t *s) { return s->enabled; }
+    static void set_enabled(module_t *s, bool on) { multiband_set_enabled(s, on); }
+    static void reset(module_t *s)
+    {
+        if (s) {
+            multiband_reset(s);
+        }
+    }
+    static void get_settings(const module_t *s, settings_t *out) { multiband_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        multiband_apply_settings(s, in);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n)
+    {
+        if (m->multiband) {
+            multiband_process(m->multiband, buffer, n);
+        }
+    }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n)
+    {
+        if (m->multiband) {
+            multiband_process_f32(m->multiband, block, n);
+        }
+    }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+    struct frame_t {
+        module_t *s;
+        const multiband_params_t *p;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->multiband;
+        if (f->s == NULL || !multiband_block_active(f->s)) {
+            f->s = NULL;
+            return false;
+        }
+        f->p = multiband_begin_block(f->s);
+        return true;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r) {}
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n)
+    {
+        multiband_process_block(f->s, f->p, buffer, n);
+    }
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        if (f->s) {
+            multiband_end_block(f->s);
+        }
+    }
+};
+#endif
+
+struct limiter_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_LIMITER;
+    static constexpr const char *name = "limiter";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_LIMITER;
+    static constexpr bool block_only = false;
+    typedef limiter_t module_t;
+    typedef limiter_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->limiter; }
+
+    static bool enabled(module_t *s) { return s->enabled; }
+    static void set_enabled(module_t *s, bool on) { limiter_set_enabled(s, on); }
+    static void reset(module_t *s) { limiter_reset(s); }
+    static void get_settings(const module_t *s, settings_t *out) { limiter_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        limiter_apply_settings(s, in);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n) { limiter_process(m->limiter, buffer, n); }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n) { limiter_process_f32(m->limiter, block, n); }
+
+    // The limiter times its true-peak sidechain itself (0 when it did not run)
+    static void record_perf(const dsp_chain_modules_t *m)
+    {
+        if (m->profile && m->limiter->tp_cycles != 0) {
+            dsp_perf_record(DSP_PERF_TRUE_PEAK, m->limiter->tp_cycles);
+        }
+    }
+
+    struct frame_t {
+        module_t *s;
+        const limiter_params_t *p;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->limiter;
+        f->p = limiter_begin_block(f->s);
+        return f->s->enabled;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r)
+    {
+        limiter_process_frame(f->s, f->p, l, r);
+    }
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n) {}
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        limiter_end_block(f->s);
+    }
+};
+
+#if DELAY_LINE_ENABLED
+// Module sets without the delay (snapshots: the lines are allocated once, a
+// copy would share them) pass a NULL instance
+struct delay_line_stage {
+    static constexpr dsp_stage_id_t id = DSP_STAGE_DELAY;
+    static constexpr const char *name = "delay";
+    static constexpr dsp_perf_stage_t perf = DSP_PERF_DELAY;
+    static constexpr bool block_only = true;
+    typedef delay_line_t module_t;
+    typedef delay_line_settings_t settings_t;
+
+    static module_t *module(const dsp_chain_modules_t *m) { return m->delay; }
+
+    static bool enabled(module_t *s) { return s->enabled; }
+    static void set_enabled(module_t *s, bool on) { delay_line_set_enabled(s, on); }
+    static void reset(module_t *s)
+    {
+        if (s) {
+            delay_line_reset(s);
+        }
+    }
+    static void get_settings(const module_t *s, settings_t *out) { delay_line_get_settings(s, out); }
+    static void apply_settings(module_t *s, const settings_t *in, uint32_t sample_rate)
+    {
+        delay_line_apply_settings(s, in);
+    }
+
+    static void process(const dsp_chain_modules_t *m, int32_t *buffer, int n)
+    {
+        if (m->delay) {
+            delay_line_process(m->delay, buffer, n);
+        }
+    }
+    static void process_f32(const dsp_chain_modules_t *m, float *block, int n)
+    {
+        if (m->delay) {
+            delay_line_process_f32(m->delay, block, n);
+        }
+    }
+    static void record_perf(const dsp_chain_modules_t *m) {}
+
+    struct frame_t {
+        module_t *s;
+        const delay_line_params_t *p;
+    };
+
+    static DSP_STAGE_INLINE bool begin(const dsp_chain_modules_t *m, frame_t *f)
+    {
+        f->s = m->delay;
+        if (f->s == NULL || !delay_line_block_active(f->s)) {
+            f->s = NULL;
+            return false;
+        }
+        f->p = delay_line_begin_block(f->s);
+        return true;
+    }
+
+    static DSP_STAGE_INLINE void frame(frame_t *f, int i, int32_t *l, int32_t *r) {}
+
+    static DSP_STAGE_INLINE void block(frame_t *f, int32_t *buffer, int n)
+    {
+        delay_line_process_block(f->s, f->p, buffer, n);
+    }
+
+    static DSP_STAGE_INLINE void end(frame_t *f)
+    {
+        if (f->s) {
+            delay_line_end_block(f->s);
+        }
+    }
+};
+#endif
+
+#endif // DSP_STAGE_H
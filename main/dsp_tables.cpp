@@ -0,0 +1,109 @@
+#include "dsp_tables.h"
+#include "dsp_attr.h"
+#include <math.h>
+
+// 10^(k/20) for whole dB, k = DSP_DB_TABLE_MIN ... DSP_DB_TABLE_MAX
+static const float s_db_coarse[DSP_DB_TABLE_MAX - DSP_DB_TABLE_MIN + 1] DSP_HOT_RODATA = {
+    1.00000005e-03f, 1.12201844e-03f, 1.25892542e-03f, 1.41253753e-03f, 1.58489321e-03f,
+    1.77827943e-03f, 1.99526222e-03f, 2.23872112e-03f, 2.51188641e-03f, 2.81838304e-03f,
+    3.16227763e-03f, 3.54813389e-03f, 3.98107152e-03f, 4.46683588e-03f, 5.01187239e-03f,
+    5.62341325e-03f, 6.30957354e-03f, 7.07945786e-03f, 7.94328190e-03f, 8.91250931e-03f,
+    9.99999978e-03f, 1.12201842e-02f, 1.25892544e-02f, 1.41253751e-02f, 1.58489328e-02f,
+    1.77827943e-02f, 1.99526232e-02f, 2.23872121e-02f, 2.51188651e-02f, 2.81838290e-02f,
+    3.16227749e-02f, 3.54813375e-02f, 3.98107171e-02f, 4.46683578e-02f, 5.01187220e-02f,
+    5.62341325e-02f, 6.30957335e-02f, 7.07945749e-02f, 7.94328228e-02f, 8.91250968e-02f,
+    1.00000001e-01f, 1.12201847e-01f, 1.25892535e-01f, 1.41253754e-01f, 1.58489317e-01f,
+    1.77827939e-01f, 1.99526235e-01f, 2.23872110e-01f, 2.51188636e-01f, 2.81838298e-01f,
+    3.16227764e-01f, 3.54813397e-01f, 3.98107171e-01f, 4.46683586e-01f, 5.01187205e-01f,
+    5.62341332e-01f, 6.30957365e-01f, 7.07945764e-01f, 7.94328213e-01f, 8.91250908e-01f,
+    1.00000000e+00f, 1.12201846e+00f, 1.25892544e+00f, 1.41253757e+00f, 1.58489323e+00f,
+    1.77827942e+00f, 1.99526227e+00f, 2.23872113e+00f, 2.51188636e+00f, 2.81838298e+00f,
+    3.16227770e+00f, 3.54813385e+00f, 3.98107171e+00f, 4.46683598e+00f, 5.01187229e+00f,
+    5.62341309e+00f, 6.30957365e+00f, 7.07945776e+00f, 7.94328213e+00f, 8.91250896e+00f,
+    1.00000000e+01f, 1.12201843e+01f, 1.25892544e+01f, 1.41253757e+01f, 1.58489323e+01f,
+};
+
+// 10^(j/(20 * DSP_DB_TABLE_FINE)) for the fraction of a dB, j = 0 ... DSP_DB_TABLE_FINE
+static const float s_db_fine[DSP_DB_TABLE_FINE + 1] DSP_HOT_RODATA = {
+    1.00000000e+00f, 1.00180054e+00f, 1.00360429e+00f, 1.00541127e+00f, 1.00722158e+00f,
+    1.00903499e+00f, 1.01085186e+00f, 1.01267183e+00f, 1.01449525e+00f, 1.01632178e+00f,
+    1.01815176e+00f, 1.01998496e+00f, 1.02182138e+00f, 1.02366126e+00f, 1.02550435e+00f,
+    1.02735078e+00f, 1.02920055e+00f, 1.03105366e+00f, 1.03290999e+00f, 1.03476977e+00f,
+    1.03663290e+00f, 1.03849936e+00f, 1.04036927e+00f, 1.04224241e+00f, 1.04411900e+00f,
+    1.04599893e+00f, 1.04788232e+00f, 1.04976904e+00f, 1.05165911e+00f, 1.05355263e+00f,
+    1.05544960e+00f, 1.05734992e+00f, 1.05925369e+00f, 1.06116092e+00f, 1.06307161e+00f,
+    1.06498563e+00f, 1.06690311e+00f, 1.06882417e+00f, 1.07074857e+00f, 1.07267642e+00f,
+    1.07460785e+00f, 1.07654262e+00f, 1.07848096e+00f, 1.08042288e+00f, 1.08236814e+00f,
+    1.08431697e+00f, 1.08626926e+00f, 1.08822513e+00f, 1.09018445e+00f, 1.09214735e+00f,
+    1.09411383e+00f, 1.09608376e+00f, 1.09805727e+00f, 1.10003436e+00f, 1.10201502e+00f,
+    1.10399914e+00f, 1.10598695e+00f, 1.10797834e+00f, 1.10997319e+00f, 1.11197174e+00f,
+    1.11397386e+00f, 1.11597955e+00f, 1.11798894e+00f, 1.12000191e+00f, 1.12201846e+00f,
+};
+
+float DSP_HOT dsp_db_to_linear(float db)
+{
+    if (!(db >= (float)DSP_DB_TABLE_MIN && db < (float)DSP_DB_TABLE_MAX)) {
+        return powf(10.0f, db / 20.0f);
+    }
+
+    // Whole dB from the coarse table, the fraction (exact for db = k + f)
+    // interpolated between fine steps
+    const float whole = floorf(db);
+    const float steps = (db - whole) * (float)DSP_DB_TABLE_FINE;
+    const int j = (int)steps;
+    const float t = steps - (float)j;
+    const float fine = s_db_fine[j] + (s_db_fine[j + 1] - s_db_fine[j]) * t;
+    return s_db_coarse[(int)whole - DSP_DB_TABLE_MIN] * fine;
+}
+
+// log2(1 + j/DSP_LOG2_TABLE_STEPS) for the mantissa, j = 0 ... DSP_LOG2_TABLE_STEPS
+static const float s_log2_mantissa[DSP_LOG2_TABLE_STEPS + 1] DSP_HOT_RODATA = {
+    0.00000000e+00f, 2.23678130e-02f, 4.43941194e-02f, 6.60891905e-02f, 8.74628413e-02f,
+    1.08524457e-01f, 1.29283017e-01f, 1.49747120e-01f, 1.69925001e-01f, 1.89824559e-01f,
+    2.09453366e-01f, 2.28818690e-01f, 2.47927513e-01f, 2.66786541e-01f, 2.85402219e-01f,
+    3.03780748e-01f, 3.21928095e-01f, 3.39850003e-01f, 3.57552005e-01f, 3.75039431e-01f,
+    3.92317423e-01f, 4.09390936e-01f, 4.26264755e-01f, 4.42943496e-01f, 4.59431619e-01f,
+    4.75733431e-01f, 4.91853096e-01f, 5.07794640e-01f, 5.23561956e-01f, 5.39158811e-01f,
+    5.54588852e-01f, 5.69855608e-01f, 5.84962501e-01f, 5.99912842e-01f, 6.14709844e-01f,
+    6.29356620e-01f, 6.43856190e-01f, 6.58211483e-01f, 6.72425342e-01f, 6.86500527e-01f,
+    7.00439718e-01f, 7.14245518e-01f, 7.27920455e-01f, 7.41466986e-01f, 7.54887502e-01f,
+    7.68184325e-01f, 7.81359714e-01f, 7.94415866e-01f, 8.07354922e-01f, 8.20178962e-01f,
+    8.32890014e-01f, 8.45490051e-01f, 8.57980995e-01f, 8.70364720e-01f, 8.82643049e-01f,
+    8.94817763e-01f, 9.06890596e-01f, 9.18863237e-01f, 9.30737338e-01f, 9.42514505e-01f,
+    9.54196310e-01f, 9.65784285e-01f, 9.77279923e-01f, 9.88684687e-01f, 1.00000000e+00f,
+};
+
+// 10 * log10(2): log2 to power dB
+#define DB_PER_OCTAVE_POWER     3.01029996f
+
+float DSP_HOT dsp_power_to_db(float power)
+{
+    // power = 2^e * (1 + m): the exponent straight from the float bits, the
+    // mantissa interpolated in the table. The floor also catches 0, negative
+    // values and NaN (fmaxf returns the other operand), so there is no branch.
+    union {
+        float f;
+        uint32_t u;
+    } v;
+    v.f = fmaxf(power, DSP_POWER_DB_FLOOR_LINEAR);
+    const int e = (int)(v.u >> 23) - 127;
+    const uint32_t m = v.u & 0x7FFFFFu;
+    const int j = (int)(m >> (23 - DSP_LOG2_TABLE_BITS));
+    const float t = (float)(m & ((1u << (23 - DSP_LOG2_TABLE_BITS)) - 1u)) *
+                    (1.0f / (float)(1u << (23 - DSP_LOG2_TABLE_BITS)));
+    const float log2 = (float)e + s_log2_mantissa[j] + (s_log2_mantissa[j + 1] - s_log2_mantissa[j]) * t;
+    return DB_PER_OCTAVE_POWER * log2;
+}
+
+bool dsp_trig_update(dsp_trig_t *trig, float freq, float sample_rate)
+{
+    if (trig->freq == freq && trig->sample_rate == sample_rate) {
+        return true;
+    }
+    float w0 = 2.0f * M_PI * freq / sample_rate;  // Normalized frequency
+    trig->cos_w0 = cosf(w0);
+    trig->sin_w0 = sinf(w0);
+    trig->freq = freq;
+    trig->sample_rate = sample_rate;
+    return false;
+}
@@ -0,0 +1,72 @@
+#ifndef DSP_TABLES_H
+#define DSP_TABLES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Lookup tables for the control path
+// Parameter changes (MQTT automation, ramps, presets, N-band redesign) would
+// otherwise call powf/cosf/sinf in full precision for every update. The
+// tables here replace the dB conversions; dsp_trig_t keeps a filter's
+// cos/sin(w0) so that a gain-only redesign skips the trigonometry. The dB
+// conversions are also cheap enough for the audio task (multiband gain
+// computer, a few calls per band and segment).
+
+// dsp_db_to_linear covers this range with tables (powf outside it)
+#define DSP_DB_TABLE_MIN    (-60)
+#define DSP_DB_TABLE_MAX    24
+
+// Table steps per dB (interpolated in between)
+#define DSP_DB_TABLE_FINE   64
+
+// dsp_power_to_db: mantissa table of 2^DSP_LOG2_TABLE_BITS steps (interpolated)
+#define DSP_LOG2_TABLE_BITS     6
+#define DSP_LOG2_TABLE_STEPS    (1 << DSP_LOG2_TABLE_BITS)
+
+// dsp_power_to_db returns no less than this (-140 dB)
+#define DSP_POWER_DB_FLOOR_LINEAR   1e-14f
+
+// cos/sin of the normalized frequency of one filter, kept while the
+// frequency and sample rate stay the same
+typedef struct {
+    float freq;                 // Frequency the values belong to (0 = empty)
+    float sample_rate;          // Sample rate the values belong to
+    float cos_w0;
+    float sin_w0;
+} dsp_trig_t;
+
+/**
+ * Convert dB to a linear amplitude factor, 10^(db/20)
+ *
+ * Within DSP_DB_TABLE_MIN...DSP_DB_TABLE_MAX the relative error is below
+ * 1e-6 (about 1e-5 dB).
+ *
+ * @param db Level in dB
+ * @return Linear factor
+ */
+float dsp_db_to_linear(float db);
+
+/**
+ * Convert a power ratio (mean square) to dB, 10 log10(power)
+ *
+ * Table based, without branches; the error is below 2e-4 dB. Values under
+ * DSP_POWER_DB_FLOOR_LINEAR (including 0 and NaN) give -140 dB.
+ *
+ * @param power Power relative to the reference
+ * @return Level in dB
+ */
+float dsp_power_to_db(float power);
+
+/**
+ * Bring a trig entry up to date for a frequency and sample rate
+ *
+ * cosf/sinf only run when either differs from the last call.
+ *
+ * @param trig Entry (zero-initialized before first use)
+ * @param freq Frequency in Hz
+ * @param sample_rate Sample rate in Hz
+ * @return true if the entry was already up to date
+ */
+bool dsp_trig_update(dsp_trig_t *trig, float freq, float sample_rate);
+
+#endif // DSP_TABLES_H
@@ -3,38 +3,62 @@
 #include <math.h>
 #include <nvs.h>
 #include "esp_log.h"
-
-// Quality factor for peaking filters
-#define Q_FACTOR 0.707f  // Butterworth response (wider bandwidth)
+#include "dsps_biquad.h"
 
 // NVS storage keys
 #define NVS_NAMESPACE "eq_settings"
 #define NVS_KEY_ENABLED "enabled"
-#define NVS_KEY_BAND_PREFIX "band_"
+#define NVS_KEY_BAND_PREFIX "band_"     // Gain in dB x100 (layout shared with 5-band firmware)
+#define NVS_KEY_TYPE_PREFIX "type_"     // eq_filter_type_t
+#define NVS_KEY_FREQ_PREFIX "freq_"     // Frequency in Hz x10
+#define NVS_KEY_Q_PREFIX    "q_"        // Q x1000
+#define NVS_KEY_ON_PREFIX   "on_"       // Band enabled
+
+// Samples converted to float per SIMD kernel call (stereo-aligned)
+#define EQ_SIMD_CHUNK 128
+
+// Full-scale of the 24-bit right-justified processing format
+#define EQ_FULL_SCALE 8388608.0f
 
 static const char *TAG = "EQUALIZER";
 
+// Identity (pass-through) coefficients
+#define Q24_ONE 16777216
+
+// Designed band filters, direct-mapped by band settings and sample rate.
+// Preset recalls and A/B switching repeat the same bands, and then copy
+// the coefficients instead of designing them again. Only used between
+// coeff_bank_begin_write and coeff_bank_publish, i.e. under the writer lock.
+#define EQ_COEFF_MEMO_SIZE 32
+
+typedef struct {
+    eq_filter_type_t type;
+    float freq;
+    float q;
+    float gain_db;
+    float sample_rate;          // 0 = empty
+    biquad_coeffs_t coeffs;
+    float coeffs_f32[5];
+} coeff_memo_entry_t;
+
+static coeff_memo_entry_t s_coeff_memo[EQ_COEFF_MEMO_SIZE];
+
+static const char *const s_type_names[EQ_FILTER_TYPE_COUNT] = {
+    "peaking", "lowshelf", "highshelf", "lowpass", "highpass", "notch"
+};
+
 /**
- * Calculate biquad peaking filter coefficients
- * This creates a peak/dip at the specified frequency
+ * Store normalized biquad coefficients in both kernel formats
  * Coefficients are converted to Q24 fixed-point format
  */
-static void calculate_peaking_filter(biquad_coeffs_t *coeffs, float freq, float gain_db, 
-                                     float sample_rate, float Q)
-{
-    float A = powf(10.0f, gain_db / 40.0f);  // Amplitude
-    float w0 = 2.0f * M_PI * freq / sample_rate;  // Normalized frequency
-    float cos_w0 = cosf(w0);
-    float sin_w0 = sinf(w0);
-    float alpha = sin_w0 / (2.0f * Q);
-    
-    // Peaking filter coefficients (floating-point)
-    float a0 = 1.0f + alpha / A;
-    float b0_f = (1.0f + alpha * A) / a0;
-    float b1_f = (-2.0f * cos_w0) / a0;
-    float b2_f = (1.0f - alpha * A) / a0;
-    float a1_f = (-2.0f * cos_w0) / a0;
-    float a2_f = (1.0f - alpha / A) / a0;
+static void store_coeffs(biquad_coeffs_t *coeffs, float *coeffs_f32, float a0,
+                         float b0, float b1, float b2, float a1, float a2)
+{
+    float b0_f = b0 / a0;
+    float b1_f = b1 / a0;
+    float b2_f = b2 / a0;
+    float a1_f = a1 / a0;
+    float a2_f = a2 / a0;
     
     // Convert to Q24 fixed-point (multiply by 2^24)
     coeffs->b0 = (int32_t)(b0_f * 16777216.0f);
@@ -42,176 +66,798 @@ static void calculate_peaking_filter(biquad_coeffs_t *coeffs, float freq, float
     coeffs->b2 = (int32_t)(b2_f * 16777216.0f);
     coeffs->a1 = (int32_t)(a1_f * 16777216.0f);
     coeffs->a2 = (int32_t)(a2_f * 16777216.0f);
+    
+    // Keep the unquantized set for the SIMD kernel
+    coeffs_f32[0] = b0_f;
+    coeffs_f32[1] = b1_f;
+    coeffs_f32[2] = b2_f;
+    coeffs_f32[3] = a1_f;
+    coeffs_f32[4] = a2_f;
 }
 
-void equalizer_init(equalizer_t *eq, uint32_t sample_rate)
+static void store_identity(biquad_coeffs_t *coeffs, float *coeffs_f32)
 {
-    memset(eq, 0, sizeof(equalizer_t));
+    coeffs->b0 = Q24_ONE;
+    coeffs->b1 = coeffs->b2 = coeffs->a1 = coeffs->a2 = 0;
+    coeffs_f32[0] = 1.0f;
+    coeffs_f32[1] = coeffs_f32[2] = coeffs_f32[3] = coeffs_f32[4] = 0.0f;
+}
+
+static bool is_identity(const biquad_coeffs_t *c)
+{
+    return c->b0 == Q24_ONE && c->b1 == 0 && c->b2 == 0 && c->a1 == 0 && c->a2 == 0;
+}
+
+/**
+ * Calculate biquad coefficients for one band (RBJ Audio EQ Cookbook)
+ * trig holds cos/sin(w0) for the band's frequency and sample rate
+ */
+static void calculate_band_filter(biquad_coeffs_t *coeffs, float *coeffs_f32,
+                                  const eq_band_t *band, const dsp_trig_t *trig)
+{
+    float A = dsp_db_to_linear(band->gain_db * 0.5f);  // Amplitude, 10^(gain/40)
+    float cos_w0 = trig->cos_w0;
+    float alpha = trig->sin_w0 / (2.0f * band->q);
     
-    // Set default gains to 0dB (no change)
-    for (int i = 0; i < EQ_BANDS; i++) {
-        eq->gain_db[i] = 0.0f;
+    switch (band->type) {
+        case EQ_FILTER_PEAKING:
+        default:
+            // This creates a peak/dip at the specified frequency
+            store_coeffs(coeffs, coeffs_f32, 1.0f + alpha / A,
+                         1.0f + alpha * A, -2.0f * cos_w0, 1.0f - alpha * A,
+                         -2.0f * cos_w0, 1.0f - alpha / A);
+            break;
+        case EQ_FILTER_LOW_SHELF: {
+            float sq = 2.0f * sqrtf(A) * alpha;
+            store_coeffs(coeffs, coeffs_f32, (A + 1.0f) + (A - 1.0f) * cos_w0 + sq,
+                         A * ((A + 1.0f) - (A - 1.0f) * cos_w0 + sq),
+                         2.0f * A * ((A - 1.0f) - (A + 1.0f) * cos_w0),
+                         A * ((A + 1.0f) - (A - 1.0f) * cos_w0 - sq),
+                         -2.0f * ((A - 1.0f) + (A + 1.0f) * cos_w0),
+                         (A + 1.0f) + (A - 1.0f) * cos_w0 - sq);
+            break;
+        }
+        case EQ_FILTER_HIGH_SHELF: {
+            float sq = 2.0f * sqrtf(A) * alpha;
+            store_coeffs(coeffs, coeffs_f32, (A + 1.0f) - (A - 1.0f) * cos_w0 + sq,
+                         A * ((A + 1.0f) + (A - 1.0f) * cos_w0 + sq),
+                         -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos_w0),
+                         A * ((A + 1.0f) + (A - 1.0f) * cos_w0 - sq),
+                         2.0f * ((A - 1.0f) - (A + 1.0f) * cos_w0),
+                         (A + 1.0f) - (A - 1.0f) * cos_w0 - sq);
+            break;
+        }
+        case EQ_FILTER_LOWPASS:
+            store_coeffs(coeffs, coeffs_f32, 1.0f + alpha,
+                         (1.0f - cos_w0) / 2.0f, 1.0f - cos_w0, (1.0f - cos_w0) / 2.0f,
+                         -2.0f * cos_w0, 1.0f - alpha);
+            break;
+        case EQ_FILTER_HIGHPASS:
+            store_coeffs(coeffs, coeffs_f32, 1.0f + alpha,
+                         (1.0f + cos_w0) / 2.0f, -(1.0f + cos_w0), (1.0f + cos_w0) / 2.0f,
+                         -2.0f * cos_w0, 1.0f - alpha);
+            break;
+        case EQ_FILTER_NOTCH:
+            store_coeffs(coeffs, coeffs_f32, 1.0f + alpha,
+                         1.0f, -2.0f * cos_w0, 1.0f,
+                         -2.0f * cos_w0, 1.0f - alpha);
+            break;
+    }
+}
+
+/**
+ * Whether a band has to be processed
+ * Peaking and shelf bands at exactly 0dB are unity and are left out
+ */
+static bool band_in_cascade(const eq_band_t *band)
+{
+    if (!band->enabled) {
+        return false;
+    }
+    switch (band->type) {
+        case EQ_FILTER_PEAKING:
+        case EQ_FILTER_LOW_SHELF:
+        case EQ_FILTER_HIGH_SHELF:
+            return band->gain_db != 0.0f;
+        default:
+            return true;
+    }
+}
+
+static coeff_memo_entry_t *coeff_memo_slot(const eq_band_t *band, float sample_rate)
+{
+    // FNV-1a over the bit patterns of the design inputs
+    uint32_t words[5];
+    words[0] = (uint32_t)band->type;
+    memcpy(&words[1], &band->freq, sizeof(float));
+    memcpy(&words[2], &band->q, sizeof(float));
+    memcpy(&words[3], &band->gain_db, sizeof(float));
+    memcpy(&words[4], &sample_rate, sizeof(float));
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 5; i++) {
+        hash = (hash ^ words[i]) * 16777619u;
+    }
+    return &s_coeff_memo[(hash ^ (hash >> 16)) % EQ_COEFF_MEMO_SIZE];
+}
+
+/**
+ * Compute one band slot's coefficients (identity if the band is not processed)
+ * trig is the slot's cos/sin entry (NULL: computed here); memo selects the
+ * shared coefficient memo (writer lock held)
+ */
+static void bake_band_coeffs(const eq_band_t *band, dsp_trig_t *trig, bool memo,
+                             biquad_coeffs_t *coeffs, float *coeffs_f32, float sample_rate)
+{
+    if (!band_in_cascade(band)) {
+        store_identity(coeffs, coeffs_f32);
+        return;
     }
     
-    // Calculate initial filter coefficients (all at 0dB = unity)
-    const float frequencies[] = {EQ_BAND_1_FREQ, EQ_BAND_2_FREQ, EQ_BAND_3_FREQ, 
-                                  EQ_BAND_4_FREQ, EQ_BAND_5_FREQ};
+    coeff_memo_entry_t *entry = memo ? coeff_memo_slot(band, sample_rate) : NULL;
+    if (entry != NULL && entry->sample_rate == sample_rate && entry->type == band->type &&
+        entry->freq == band->freq && entry->q == band->q && entry->gain_db == band->gain_db) {
+        *coeffs = entry->coeffs;
+        memcpy(coeffs_f32, entry->coeffs_f32, sizeof(entry->coeffs_f32));
+        return;
+    }
     
-    for (int i = 0; i < EQ_BANDS; i++) {
-        calculate_peaking_filter(&eq->coeffs[i], frequencies[i], 0.0f, 
-                                (float)sample_rate, Q_FACTOR);
+    dsp_trig_t local = {};
+    if (trig == NULL) {
+        trig = &local;
     }
+    dsp_trig_update(trig, band->freq, sample_rate);
+    calculate_band_filter(coeffs, coeffs_f32, band, trig);
+    
+    if (entry != NULL) {
+        entry->type = band->type;
+        entry->freq = band->freq;
+        entry->q = band->q;
+        entry->gain_db = band->gain_db;
+        entry->sample_rate = sample_rate;
+        entry->coeffs = *coeffs;
+        memcpy(entry->coeffs_f32, coeffs_f32, sizeof(entry->coeffs_f32));
+    }
+}
+
+/**
+ * Rebuild the cascade list: only active bands, in slot order
+ */
+static void rebuild_cascade(const equalizer_t *eq, equalizer_params_t *p)
+{
+    p->num_cascade = 0;
+    for (int b = 0; b < EQ_MAX_BANDS; b++) {
+        if (band_in_cascade(&eq->bands[b])) {
+            p->cascade[p->num_cascade++] = (uint8_t)b;
+        }
+    }
+}
+
+/**
+ * Bake one band slot into a parameter set and rebuild the cascade list
+ */
+static void bake_band(equalizer_t *eq, equalizer_params_t *p, int band, float sample_rate, bool memo)
+{
+    bake_band_coeffs(&eq->bands[band], &eq->trig[band], memo,
+                     &p->coeffs[band], p->coeffs_f32[band], sample_rate);
+    rebuild_cascade(eq, p);
+}
+
+static void clamp_band(eq_band_t *band, float sample_rate)
+{
+    const float max_freq = sample_rate * 0.45f;
+    if (band->freq < EQ_MIN_FREQ) band->freq = EQ_MIN_FREQ;
+    if (band->freq > max_freq) band->freq = max_freq;
+    if (band->q < EQ_MIN_Q) band->q = EQ_MIN_Q;
+    if (band->q > EQ_MAX_Q) band->q = EQ_MAX_Q;
+    if (band->gain_db < EQ_MIN_GAIN_DB) band->gain_db = EQ_MIN_GAIN_DB;
+    if (band->gain_db > EQ_MAX_GAIN_DB) band->gain_db = EQ_MAX_GAIN_DB;
+}
+
+/**
+ * Scalar Q24 kernel: one cascade pass per active band
+ */
+static void DSP_HOT process_q24(equalizer_t *eq, const equalizer_params_t *p, int32_t *buffer, int num_samples)
+{
+    for (int k = 0; k < p->num_cascade; k++) {
+        const int band = p->cascade[k];
+        const biquad_coeffs_t *c = &p->coeffs[band];
+        biquad_state_t *state_l = &eq->state_left[band];
+        biquad_state_t *state_r = &eq->state_right[band];
+        
+        // Process stereo interleaved samples
+        for (int i = 0; i < num_samples; i += 2) {
+            buffer[i] = biquad_q24_process(c, state_l, buffer[i]);
+            buffer[i + 1] = biquad_q24_process(c, state_r, buffer[i + 1]);
+        }
+    }
+}
+
+/**
+ * Run every band in the cascade over a float block with the stereo esp-dsp biquad
+ */
+static void DSP_HOT process_cascade_f32(equalizer_t *eq, const equalizer_params_t *p, float *buffer,
+                                        int num_samples)
+{
+    for (int k = 0; k < p->num_cascade; k++) {
+        const int band = p->cascade[k];
+        // esp-dsp takes a non-const coefficient pointer but only reads it
+        dsps_biquad_sf32(buffer, buffer, num_samples / 2, (float *)p->coeffs_f32[band], eq->state_f32[band]);
+    }
+}
+
+/**
+ * SIMD kernel: convert a chunk to float once, run every active band over it
+ * with the stereo esp-dsp biquad, convert back with rounding and saturation
+ * 
+ * @param scratch Float buffer of at least EQ_SIMD_CHUNK samples, 16-byte aligned
+ */
+static void DSP_HOT process_f32(equalizer_t *eq, const equalizer_params_t *p, int32_t *buffer,
+                                int num_samples, float *scratch)
+{
+    for (int offset = 0; offset < num_samples; offset += EQ_SIMD_CHUNK) {
+        int n = num_samples - offset;
+        if (n > EQ_SIMD_CHUNK) n = EQ_SIMD_CHUNK;
+        int32_t *chunk = buffer + offset;
+        
+        // 24-bit integers are exactly representable in float
+        for (int i = 0; i < n; i++) {
+            scratch[i] = (float)chunk[i];
+        }
+        
+        process_cascade_f32(eq, p, scratch, n);
+        
+        for (int i = 0; i < n; i++) {
+            float y = scratch[i];
+            if (y > 2147483520.0f) y = 2147483520.0f;
+            if (y < -2147483648.0f) y = -2147483648.0f;
+            chunk[i] = (int32_t)lrintf(y);
+        }
+    }
+}
+
+void equalizer_init(equalizer_t *eq, uint32_t sample_rate)
+{
+    memset(eq, 0, sizeof(equalizer_t));
+    coeff_bank_reset(&eq->bank);
+    
+    // Default layout: five peaking bands at 0dB (no change), rest of the pool unused
+    const float frequencies[EQ_DEFAULT_BANDS] = {EQ_BAND_1_FREQ, EQ_BAND_2_FREQ, EQ_BAND_3_FREQ, 
+                                                 EQ_BAND_4_FREQ, EQ_BAND_5_FREQ};
+    
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        eq->bands[i].type = EQ_FILTER_PEAKING;
+        eq->bands[i].freq = (i < EQ_DEFAULT_BANDS) ? frequencies[i] : 1000.0f;
+        eq->bands[i].q = EQ_DEFAULT_Q;
+        eq->bands[i].gain_db = 0.0f;
+        eq->bands[i].enabled = (i < EQ_DEFAULT_BANDS);
+        bake_band(eq, &eq->params[0], i, (float)sample_rate, false);
+    }
+    eq->ramp_current = eq->params[0];
+    eq->ramp_segment = PARAM_RAMP_SEGMENTS;
     
     eq->enabled = true;
 }
 
+bool equalizer_set_band(equalizer_t *eq, int band, const eq_band_t *config, uint32_t sample_rate)
+{
+    if (band < 0 || band >= EQ_MAX_BANDS || config->type >= EQ_FILTER_TYPE_COUNT) {
+        return false;
+    }
+    
+    eq_band_t b = *config;
+    clamp_band(&b, (float)sample_rate);
+    
+    // Bake the band into the shadow set (the other bands are carried over) and publish it
+    equalizer_params_t *p = (equalizer_params_t *)coeff_bank_begin_write(
+        &eq->bank, eq->params, sizeof(equalizer_params_t));
+    eq->bands[band] = b;
+    bake_band(eq, p, band, (float)sample_rate, true);
+    p->version++;
+    coeff_bank_publish(&eq->bank);
+    
+    return true;
+}
+
 bool equalizer_set_band_gain(equalizer_t *eq, int band, float gain_db, uint32_t sample_rate)
 {
-    if (band < 0 || band >= EQ_BANDS) {
+    if (band < 0 || band >= EQ_MAX_BANDS) {
         return false;
     }
     
-    // Clamp gain to reasonable range
-    if (gain_db < -12.0f) gain_db = -12.0f;
-    if (gain_db > 12.0f) gain_db = 12.0f;
+    eq_band_t b = eq->bands[band];
+    b.gain_db = gain_db;
+    return equalizer_set_band(eq, band, &b, sample_rate);
+}
+
+const eq_band_t *equalizer_get_band(const equalizer_t *eq, int band)
+{
+    if (band < 0 || band >= EQ_MAX_BANDS) {
+        return NULL;
+    }
+    return &eq->bands[band];
+}
+
+int equalizer_get_active_bands(const equalizer_t *eq)
+{
+    return eq->params[__atomic_load_n(&eq->bank.published, __ATOMIC_SEQ_CST)].num_cascade;
+}
+
+const char *equalizer_type_name(eq_filter_type_t type)
+{
+    return (type < EQ_FILTER_TYPE_COUNT) ? s_type_names[type] : "unknown";
+}
+
+bool equalizer_type_from_name(const char *name, eq_filter_type_t *type)
+{
+    for (int i = 0; i < EQ_FILTER_TYPE_COUNT; i++) {
+        if (strcmp(name, s_type_names[i]) == 0) {
+            *type = (eq_filter_type_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+DSP_HOT const equalizer_params_t *equalizer_begin_block(equalizer_t *eq)
+{
+    if (eq->reset_pending) {
+        eq->reset_pending = false;
+        memset(eq->state_left, 0, sizeof(eq->state_left));
+        memset(eq->state_right, 0, sizeof(eq->state_right));
+        memset(eq->state_f32, 0, sizeof(eq->state_f32));
+    }
+    return &eq->params[coeff_bank_acquire(&eq->bank)];
+}
+
+void DSP_HOT equalizer_end_block(equalizer_t *eq)
+{
+    coeff_bank_release(&eq->bank);
+}
+
+// k/n of the way from a to b, exact at both ends
+static DSP_HOT_INLINE int32_t lerp_q24(int32_t a, int32_t b, int32_t k, int32_t n)
+{
+    return a + (int32_t)(((int64_t)b - a) * k / n);
+}
+
+bool DSP_HOT equalizer_ramp_begin(equalizer_t *eq, const equalizer_params_t *params)
+{
+    if (params->version == eq->ramp_version) {
+        return eq->ramp_segment < PARAM_RAMP_SEGMENTS;
+    }
+    eq->ramp_version = params->version;
     
-    eq->gain_db[band] = gain_db;
+    // Applied bands: the current cascade minus slots that have already faded
+    // to identity (exact pass-through, so dropping them is seamless)
+    equalizer_params_t *cur = &eq->ramp_current;
+    bool applied[EQ_MAX_BANDS] = {false};
+    for (int k = 0; k < cur->num_cascade; k++) {
+        const int band = cur->cascade[k];
+        applied[band] = !is_identity(&cur->coeffs[band]);
+    }
     
-    // Recalculate filter coefficients for this band
-    const float frequencies[] = {EQ_BAND_1_FREQ, EQ_BAND_2_FREQ, EQ_BAND_3_FREQ, 
-                                  EQ_BAND_4_FREQ, EQ_BAND_5_FREQ};
+    // Slots entering the cascade start from silence
+    bool in_next[EQ_MAX_BANDS] = {false};
+    for (int k = 0; k < params->num_cascade; k++) {
+        const int band = params->cascade[k];
+        in_next[band] = true;
+        if (!applied[band]) {
+            memset(&eq->state_left[band], 0, sizeof(biquad_state_t));
+            memset(&eq->state_right[band], 0, sizeof(biquad_state_t));
+            memset(eq->state_f32[band], 0, sizeof(eq->state_f32[band]));
+        }
+    }
     
-    calculate_peaking_filter(&eq->coeffs[band], frequencies[band], gain_db, 
-                            (float)sample_rate, Q_FACTOR);
+    // Published without crossfade (preset recall): take it as the settled state
+    if (PARAM_RAMP_SEGMENTS == 0 || params->cut != eq->ramp_cut) {
+        eq->ramp_cut = params->cut;
+        *cur = *params;
+        eq->ramp_segment = PARAM_RAMP_SEGMENTS;
+        return false;
+    }
     
+    // Ramp over the union of both cascades so bands fade in and out
+    eq->ramp_from = *cur;
+    cur->num_cascade = 0;
+    for (int band = 0; band < EQ_MAX_BANDS; band++) {
+        if (applied[band] || in_next[band]) {
+            cur->cascade[cur->num_cascade++] = (uint8_t)band;
+        }
+    }
+    eq->ramp_segment = 0;
     return true;
 }
 
-void equalizer_process(equalizer_t *eq, int32_t *buffer, int num_samples)
+DSP_HOT const equalizer_params_t *equalizer_ramp_next(equalizer_t *eq, const equalizer_params_t *params)
+{
+    equalizer_params_t *cur = &eq->ramp_current;
+    if (eq->ramp_segment >= PARAM_RAMP_SEGMENTS) {
+        return cur;
+    }
+    
+    eq->ramp_segment++;
+    const equalizer_params_t *from = &eq->ramp_from;
+    
+    if (eq->ramp_segment == PARAM_RAMP_SEGMENTS) {
+        // Land exactly on the target set
+        for (int k = 0; k < cur->num_cascade; k++) {
+            const int band = cur->cascade[k];
+            cur->coeffs[band] = params->coeffs[band];
+            memcpy(cur->coeffs_f32[band], params->coeffs_f32[band], sizeof(cur->coeffs_f32[band]));
+        }
+        return cur;
+    }
+    
+    // Linear interpolation between the two baked sets; interpolating direct
+    // form coefficients keeps every intermediate filter stable because the
+    // biquad stability region is convex in (a1, a2)
+    const int32_t k = eq->ramp_segment;
+    const int32_t n = PARAM_RAMP_SEGMENTS;
+    const float t = (float)k / (float)n;
+    for (int i = 0; i < cur->num_cascade; i++) {
+        const int band = cur->cascade[i];
+        const biquad_coeffs_t *c0 = &from->coeffs[band];
+        const biquad_coeffs_t *c1 = &params->coeffs[band];
+        biquad_coeffs_t *c = &cur->coeffs[band];
+        c->b0 = lerp_q24(c0->b0, c1->b0, k, n);
+        c->b1 = lerp_q24(c0->b1, c1->b1, k, n);
+        c->b2 = lerp_q24(c0->b2, c1->b2, k, n);
+        c->a1 = lerp_q24(c0->a1, c1->a1, k, n);
+        c->a2 = lerp_q24(c0->a2, c1->a2, k, n);
+        for (int j = 0; j < 5; j++) {
+            cur->coeffs_f32[band][j] = from->coeffs_f32[band][j] +
+                (params->coeffs_f32[band][j] - from->coeffs_f32[band][j]) * t;
+        }
+    }
+    return cur;
+}
+
+// Run the selected kernel over part of a block
+static DSP_HOT_INLINE void process_kernel(equalizer_t *eq, const equalizer_params_t *params,
+                                          int32_t *buffer, int num_samples)
+{
+#if EQUALIZER_BLOCK_KERNEL
+    // On the caller's stack so concurrent callers (e.g. chain verify) never share it
+    float scratch[EQ_SIMD_CHUNK] __attribute__((aligned(16)));
+    process_f32(eq, params, buffer, num_samples, scratch);
+#else
+    process_q24(eq, params, buffer, num_samples);
+#endif
+}
+
+void DSP_HOT equalizer_process_block(equalizer_t *eq, const equalizer_params_t *params,
+                                     int32_t *buffer, int num_samples)
+{
+    if (!equalizer_ramp_begin(eq, params)) {
+        if (params->num_cascade == 0) {
+            return;  // No active bands (flat)
+        }
+        process_kernel(eq, params, buffer, num_samples);
+        return;
+    }
+    
+    // Ramping: step the coefficients every segment
+    const int segment = PARAM_RAMP_SEGMENT_FRAMES * 2;
+    for (int offset = 0; offset < num_samples; offset += segment) {
+        int n = num_samples - offset;
+        if (n > segment) n = segment;
+        process_kernel(eq, equalizer_ramp_next(eq, params), buffer + offset, n);
+    }
+}
+
+void DSP_HOT equalizer_process(equalizer_t *eq, int32_t *buffer, int num_samples)
 {
     if (!eq->enabled) {
         return;  // Bypass
     }
+    
+    const equalizer_params_t *p = equalizer_begin_block(eq);
+    equalizer_process_block(eq, p, buffer, num_samples);
+    equalizer_end_block(eq);
+}
 
-    // Quick optimization: if all band gains are exactly 0.0f then the filters
-    // are unity and we can skip processing entirely. This avoids costly
-    // multipass processing when equalizer is enabled but set to flat.
-    bool all_zero = true;
-    for (int b = 0; b < EQ_BANDS; ++b) {
-        if (eq->gain_db[b] != 0.0f) { all_zero = false; break; }
+void DSP_HOT equalizer_process_f32(equalizer_t *eq, float *buffer, int num_samples)
+{
+    if (!eq->enabled) {
+        return;  // Bypass
     }
-    if (all_zero) return;
     
-    // Process each band sequentially (cascade)
-    for (int band = 0; band < EQ_BANDS; band++) {
-        biquad_coeffs_t *c = &eq->coeffs[band];
-        biquad_state_t *state_l = &eq->state_left[band];
-        biquad_state_t *state_r = &eq->state_right[band];
+    const equalizer_params_t *p = equalizer_begin_block(eq);
+    
+    if (!equalizer_ramp_begin(eq, p)) {
+        process_cascade_f32(eq, p, buffer, num_samples);
+    } else {
+        // Same segment steps as equalizer_process_block
+        const int segment = PARAM_RAMP_SEGMENT_FRAMES * 2;
+        for (int offset = 0; offset < num_samples; offset += segment) {
+            int n = num_samples - offset;
+            if (n > segment) n = segment;
+            process_cascade_f32(eq, equalizer_ramp_next(eq, p), buffer + offset, n);
+        }
+    }
+    
+    equalizer_end_block(eq);
+}
+
+const char *equalizer_kernel_name(void)
+{
+#if EQUALIZER_BLOCK_KERNEL
+    return "esp-dsp f32 (SIMD)";
+#else
+    return "scalar Q24";
+#endif
+}
+
+esp_err_t equalizer_kernel_selftest(float *max_deviation_db)
+{
+    // Private instances (equalizer_t is too large to keep two on a task stack)
+    static equalizer_t s_ref;
+    static equalizer_t s_simd;
+    static int32_t s_buf_ref[EQ_SIMD_CHUNK];
+    static int32_t s_buf_simd[EQ_SIMD_CHUNK];
+    static float s_scratch[EQ_SIMD_CHUNK] __attribute__((aligned(16)));
+    
+    const uint32_t TEST_RATE = 48000;
+    const int SETTLE_CHUNKS = 40;   // ~53ms, well past the slowest band's decay
+    const int MEASURE_CHUNKS = 40;
+    const float test_gains[EQ_DEFAULT_BANDS] = {6.0f, -6.0f, 3.0f, -3.0f, 6.0f};
+    const float test_freqs[] = {40.0f, 60.0f, 125.0f, 250.0f, 500.0f, 1000.0f,
+                                2000.0f, 4000.0f, 8000.0f, 12000.0f, 16000.0f};
+    const int num_freqs = sizeof(test_freqs) / sizeof(test_freqs[0]);
+    
+    float worst_db = 0.0f;
+    float worst_freq = 0.0f;
+    
+    for (int f = 0; f < num_freqs; f++) {
+        equalizer_init(&s_ref, TEST_RATE);
+        for (int i = 0; i < EQ_DEFAULT_BANDS; i++) {
+            equalizer_set_band_gain(&s_ref, i, test_gains[i], TEST_RATE);
+        }
+        s_simd = s_ref;
         
-        // Process stereo interleaved samples
-        for (int i = 0; i < num_samples; i += 2) {
-            // Left channel
-            int32_t input_l = buffer[i];
-            
-            // Biquad direct form II (transposed)
-            // Coefficients are Q24, shift right by 24 after multiplication
-            int64_t temp_l = ((int64_t)c->b0 * input_l) >> 24;
-            temp_l += ((int64_t)c->b1 * state_l->x1) >> 24;
-            temp_l += ((int64_t)c->b2 * state_l->x2) >> 24;
-            temp_l -= ((int64_t)c->a1 * state_l->y1) >> 24;
-            temp_l -= ((int64_t)c->a2 * state_l->y2) >> 24;
-            
-            int32_t output_l = (int32_t)temp_l;
-            
-            // Update state
-            state_l->x2 = state_l->x1;
-            state_l->x1 = input_l;
-            state_l->y2 = state_l->y1;
-            state_l->y1 = output_l;
-            
-            buffer[i] = output_l;
+        // Quarter-scale sine (L) and its inverse (R); compare output energy once settled
+        const float step = 2.0f * (float)M_PI * test_freqs[f] / TEST_RATE;
+        float phase = 0.0f;
+        double energy_ref = 0.0;
+        double energy_simd = 0.0;
+        for (int chunk = 0; chunk < SETTLE_CHUNKS + MEASURE_CHUNKS; chunk++) {
+            for (int i = 0; i < EQ_SIMD_CHUNK; i += 2) {
+                int32_t sample = (int32_t)(0.25f * sinf(phase) * EQ_FULL_SCALE);
+                phase += step;
+                if (phase > 2.0f * (float)M_PI) phase -= 2.0f * (float)M_PI;
+                s_buf_ref[i] = s_buf_simd[i] = sample;
+                s_buf_ref[i + 1] = s_buf_simd[i + 1] = -sample;
+            }
             
-            // Right channel
-            int32_t input_r = buffer[i + 1];
+            process_q24(&s_ref, &s_ref.params[s_ref.bank.published], s_buf_ref, EQ_SIMD_CHUNK);
+            process_f32(&s_simd, &s_simd.params[s_simd.bank.published], s_buf_simd,
+                        EQ_SIMD_CHUNK, s_scratch);
             
-            int64_t temp_r = ((int64_t)c->b0 * input_r) >> 24;
-            temp_r += ((int64_t)c->b1 * state_r->x1) >> 24;
-            temp_r += ((int64_t)c->b2 * state_r->x2) >> 24;
-            temp_r -= ((int64_t)c->a1 * state_r->y1) >> 24;
-            temp_r -= ((int64_t)c->a2 * state_r->y2) >> 24;
-            
-            int32_t output_r = (int32_t)temp_r;
-            
-            // Update state
-            state_r->x2 = state_r->x1;
-            state_r->x1 = input_r;
-            state_r->y2 = state_r->y1;
-            state_r->y1 = output_r;
-            
-            buffer[i + 1] = output_r;
+            if (chunk >= SETTLE_CHUNKS) {
+                for (int i = 0; i < EQ_SIMD_CHUNK; i++) {
+                    energy_ref += (double)s_buf_ref[i] * s_buf_ref[i];
+                    energy_simd += (double)s_buf_simd[i] * s_buf_simd[i];
+                }
+            }
+        }
+        
+        float deviation_db = fabsf(10.0f * log10f((float)(energy_simd / energy_ref)));
+        if (!(deviation_db <= worst_db)) {  // also catches NaN
+            worst_db = deviation_db;
+            worst_freq = test_freqs[f];
         }
     }
+    
+    if (max_deviation_db) {
+        *max_deviation_db = worst_db;
+    }
+    
+    if (!(worst_db <= EQ_SELFTEST_MAX_DEVIATION_DB)) {
+        ESP_LOGE(TAG, "Kernel self-test FAILED: %.3f dB deviation at %.0f Hz (limit %.3f dB)",
+                 worst_db, worst_freq, EQ_SELFTEST_MAX_DEVIATION_DB);
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "Kernel self-test passed: max response deviation %.4f dB (at %.0f Hz)",
+             worst_db, worst_freq);
+    return ESP_OK;
 }
 
 void equalizer_set_enabled(equalizer_t *eq, bool enabled)
 {
-    eq->enabled = enabled;
+    coeff_bank_set_flag(&eq->enabled, enabled);
 }
 
-void equalizer_reset(equalizer_t *eq)
+void equalizer_set_sample_rate(equalizer_t *eq, uint32_t sample_rate)
 {
-    // Clear all filter state but keep coefficients
-    for (int i = 0; i < EQ_BANDS; i++) {
-        memset(&eq->state_left[i], 0, sizeof(biquad_state_t));
-        memset(&eq->state_right[i], 0, sizeof(biquad_state_t));
+    equalizer_params_t *p = (equalizer_params_t *)coeff_bank_begin_write(
+        &eq->bank, eq->params, sizeof(equalizer_params_t));
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        clamp_band(&eq->bands[i], (float)sample_rate);
+        bake_band_coeffs(&eq->bands[i], &eq->trig[i], true, &p->coeffs[i], p->coeffs_f32[i],
+                         (float)sample_rate);
     }
+    rebuild_cascade(eq, p);
+    p->version++;
+    
+    // The audio task is stopped: take the new set as the settled ramp state,
+    // a glide between coefficients of two rates would be meaningless
+    eq->ramp_current = *p;
+    eq->ramp_version = p->version;
+    eq->ramp_cut = p->cut;
+    eq->ramp_segment = PARAM_RAMP_SEGMENTS;
+    coeff_bank_publish(&eq->bank);
+    eq->reset_pending = true;
 }
 
-esp_err_t equalizer_save_settings(equalizer_t *eq)
+void equalizer_reset(equalizer_t *eq)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    // Clear all filter state but keep coefficients; the history belongs to
+    // the audio task, so it does the clearing at its next block
+    coeff_bank_set_flag(&eq->reset_pending, true);
+}
+
+// Returns true if any key of this band was found
+static bool load_band(nvs_handle_t nvs_handle, int index, eq_band_t *band)
+{
+    char key[16];
+    bool found = false;
+    int32_t value_i32;
+    uint8_t value_u8;
     
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
-        return err;
+    snprintf(key, sizeof(key), "%s%d", NVS_KEY_BAND_PREFIX, index);
+    if (nvs_get_i32(nvs_handle, key, &value_i32) == ESP_OK) {
+        // Convert from fixed-point back to float
+        band->gain_db = (float)value_i32 / 100.0f;
+        found = true;
     }
     
-    // Save enabled state
-    err = nvs_set_u8(nvs_handle, NVS_KEY_ENABLED, eq->enabled ? 1 : 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving enabled state: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
+    snprintf(key, sizeof(key), "%s%d", NVS_KEY_TYPE_PREFIX, index);
+    if (nvs_get_u8(nvs_handle, key, &value_u8) == ESP_OK && value_u8 < EQ_FILTER_TYPE_COUNT) {
+        band->type = (eq_filter_type_t)value_u8;
+        found = true;
     }
     
-    // Save band gains (convert float to int32 to store in NVS)
-    for (int i = 0; i < EQ_BANDS; i++) {
-        char key[16];
-        snprintf(key, sizeof(key), "%s%d", NVS_KEY_BAND_PREFIX, i);
-        
-        // Store gain as fixed-point (multiply by 100 to preserve 2 decimal places)
-        int32_t gain_fixed = (int32_t)(eq->gain_db[i] * 100.0f);
-        err = nvs_set_i32(nvs_handle, key, gain_fixed);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error saving band %d gain: %s", i, esp_err_to_name(err));
-            nvs_close(nvs_handle);
-            return err;
-        }
+    snprintf(key, sizeof(key), "%s%d", NVS_KEY_FREQ_PREFIX, index);
+    if (nvs_get_i32(nvs_handle, key, &value_i32) == ESP_OK) {
+        band->freq = (float)value_i32 / 10.0f;
+        found = true;
     }
     
-    // Commit changes to flash
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing to NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Equalizer settings saved to flash");
+    snprintf(key, sizeof(key), "%s%d", NVS_KEY_Q_PREFIX, index);
+    if (nvs_get_i32(nvs_handle, key, &value_i32) == ESP_OK) {
+        band->q = (float)value_i32 / 1000.0f;
+        found = true;
     }
     
-    nvs_close(nvs_handle);
-    return err;
+    snprintf(key, sizeof(key), "%s%d", NVS_KEY_ON_PREFIX, index);
+    if (nvs_get_u8(nvs_handle, key, &value_u8) == ESP_OK) {
+        band->enabled = (value_u8 != 0);
+        found = true;
+    }
+    
+    return found;
+}
+
+// Band from its persistent form, clamped as equalizer_set_band would
+static bool band_from_settings(const eq_band_settings_t *in, eq_band_t *band, float sample_rate)
+{
+    if (in->type >= EQ_FILTER_TYPE_COUNT) {
+        return false;
+    }
+    band->type = (eq_filter_type_t)in->type;
+    band->freq = in->freq;
+    band->q = in->q;
+    band->gain_db = in->gain_db;
+    band->enabled = (in->enabled != 0);
+    clamp_band(band, sample_rate);
+    return true;
+}
+
+static int settings_band_count(const equalizer_settings_t *settings)
+{
+    return (settings->num_bands < EQ_MAX_BANDS) ? settings->num_bands : EQ_MAX_BANDS;
+}
+
+void equalizer_get_settings(const equalizer_t *eq, equalizer_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        const eq_band_t *b = &eq->bands[i];
+        settings->bands[i].freq = b->freq;
+        settings->bands[i].q = b->q;
+        settings->bands[i].gain_db = b->gain_db;
+        settings->bands[i].type = (uint8_t)b->type;
+        settings->bands[i].enabled = b->enabled ? 1 : 0;
+    }
+    settings->num_bands = EQ_MAX_BANDS;
+    settings->enabled = eq->enabled ? 1 : 0;
+}
+
+void equalizer_bake_coeff_cache(const equalizer_settings_t *settings, uint32_t sample_rate,
+                                equalizer_coeff_cache_t *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+    const int n = settings_band_count(settings);
+    for (int i = 0; i < n; i++) {
+        eq_band_t band;
+        if (band_from_settings(&settings->bands[i], &band, (float)sample_rate)) {
+            bake_band_coeffs(&band, NULL, false, &cache->coeffs[i], cache->coeffs_f32[i],
+                             (float)sample_rate);
+        } else {
+            store_identity(&cache->coeffs[i], cache->coeffs_f32[i]);
+        }
+    }
+    cache->sample_rate = sample_rate;
+    cache->version = EQ_COEFF_CACHE_VERSION;
+    cache->num_bands = (uint8_t)n;
+}
+
+// Every band of the pool, as a band mask
+#define ALL_BANDS           ((uint32_t)((1ull << EQ_MAX_BANDS) - 1))
+
+/**
+ * Publish the bands of band_mask in one set (cut: without a ramp); returns
+ * whether the cache was used
+ */
+static bool publish_settings(equalizer_t *eq, const equalizer_settings_t *settings,
+                             const equalizer_coeff_cache_t *cache, uint32_t band_mask,
+                             uint32_t sample_rate, bool cut)
+{
+    const int n = settings_band_count(settings);
+    const bool cached = cache != NULL && cache->version == EQ_COEFF_CACHE_VERSION &&
+                        cache->sample_rate == sample_rate && cache->num_bands >= n;
+    
+    // All bands in one shadow set and one publish
+    equalizer_params_t *p = (equalizer_params_t *)coeff_bank_begin_write(
+        &eq->bank, eq->params, sizeof(equalizer_params_t));
+    for (int i = 0; i < n; i++) {
+        eq_band_t band;
+        if (!(band_mask & (1u << i)) ||
+            !band_from_settings(&settings->bands[i], &band, (float)sample_rate)) {
+            continue;
+        }
+        eq->bands[i] = band;
+        if (cached) {
+            p->coeffs[i] = cache->coeffs[i];
+            memcpy(p->coeffs_f32[i], cache->coeffs_f32[i], sizeof(p->coeffs_f32[i]));
+        } else {
+            bake_band_coeffs(&band, &eq->trig[i], true, &p->coeffs[i], p->coeffs_f32[i],
+                             (float)sample_rate);
+        }
+    }
+    rebuild_cascade(eq, p);
+    p->version++;
+    if (cut) {
+        p->cut++;
+    }
+    coeff_bank_publish(&eq->bank);
+    return cached;
+}
+
+bool equalizer_apply_settings(equalizer_t *eq, const equalizer_settings_t *settings,
+                              const equalizer_coeff_cache_t *cache, uint32_t sample_rate)
+{
+    const bool cached = publish_settings(eq, settings, cache, ALL_BANDS, sample_rate, false);
+    coeff_bank_set_flag(&eq->enabled, settings->enabled != 0);
+    return cached;
+}
+
+void equalizer_apply_bands(equalizer_t *eq, const equalizer_settings_t *settings,
+                           uint32_t band_mask, uint32_t sample_rate)
+{
+    if (band_mask & ALL_BANDS) {
+        publish_settings(eq, settings, NULL, band_mask, sample_rate, false);
+    }
+}
+
+bool equalizer_apply_baked(equalizer_t *eq, const equalizer_settings_t *settings,
+                           const equalizer_coeff_cache_t *cache, uint32_t sample_rate,
+                           bool crossfade)
+{
+    const bool cached = publish_settings(eq, settings, cache, ALL_BANDS, sample_rate, !crossfade);
+    coeff_bank_set_flag(&eq->enabled, settings->enabled != 0);
+    return cached;
 }
 
 esp_err_t equalizer_load_settings(equalizer_t *eq, uint32_t sample_rate)
@@ -239,17 +885,12 @@ esp_err_t equalizer_load_settings(equalizer_t *eq, uint32_t sample_rate)
     
     bool settings_loaded = false;
     
-    // Load band gains
-    for (int i = 0; i < EQ_BANDS; i++) {
-        char key[16];
-        snprintf(key, sizeof(key), "%s%d", NVS_KEY_BAND_PREFIX, i);
-        
-        int32_t gain_fixed = 0;
-        err = nvs_get_i32(nvs_handle, key, &gain_fixed);
-        if (err == ESP_OK) {
-            // Convert from fixed-point back to float
-            float gain_db = (float)gain_fixed / 100.0f;
-            equalizer_set_band_gain(eq, i, gain_db, sample_rate);
+    // Load bands; keys that are missing (e.g. settings saved by the 5-band
+    // firmware, which only stored gains) keep their defaults
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        eq_band_t band = eq->bands[i];
+        if (load_band(nvs_handle, i, &band)) {
+            equalizer_set_band(eq, i, &band, sample_rate);
             settings_loaded = true;
         }
     }
@@ -259,11 +900,13 @@ esp_err_t equalizer_load_settings(equalizer_t *eq, uint32_t sample_rate)
     if (settings_loaded) {
         ESP_LOGI(TAG, "Equalizer settings loaded from flash:");
         ESP_LOGI(TAG, "  Status: %s", eq->enabled ? "ENABLED" : "DISABLED");
-        ESP_LOGI(TAG, "  60Hz:   %.1f dB", eq->gain_db[0]);
-        ESP_LOGI(TAG, "  250Hz:  %.1f dB", eq->gain_db[1]);
-        ESP_LOGI(TAG, "  1kHz:   %.1f dB", eq->gain_db[2]);
-        ESP_LOGI(TAG, "  4kHz:   %.1f dB", eq->gain_db[3]);
-        ESP_LOGI(TAG, "  12kHz:  %.1f dB", eq->gain_db[4]);
+        for (int i = 0; i < EQ_MAX_BANDS; i++) {
+            const eq_band_t *b = &eq->bands[i];
+            if (b->enabled) {
+                ESP_LOGI(TAG, "  Band %d: %s %.0f Hz Q %.2f %+.1f dB", i,
+                         equalizer_type_name(b->type), b->freq, b->q, b->gain_db);
+            }
+        }
         return ESP_OK;
     }
     
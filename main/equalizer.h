@@ -4,40 +4,145 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include "biquad.h"
+#include "coeff_bank.h"
+#include "dsp_tables.h"
+#include "param_ramp.h"
 
-// 5-band equalizer frequencies (Hz)
+// Default 5-band layout frequencies (Hz)
 #define EQ_BAND_1_FREQ      60      // Sub-bass
 #define EQ_BAND_2_FREQ      250     // Bass
 #define EQ_BAND_3_FREQ      1000    // Mid
 #define EQ_BAND_4_FREQ      4000    // Upper mid
 #define EQ_BAND_5_FREQ      12000   // Treble
 
-// Number of bands
-#define EQ_BANDS            5
+// Band pool size (fixed at build time; unused bands cost no processing)
+#ifdef CONFIG_EQ_MAX_BANDS
+#define EQ_MAX_BANDS        CONFIG_EQ_MAX_BANDS
+#else
+#define EQ_MAX_BANDS        16
+#endif
 
-// Biquad filter coefficients structure (Q24 fixed-point format)
+// Bands enabled by equalizer_init (peaking, EQ_BAND_1_FREQ..EQ_BAND_5_FREQ)
+#define EQ_DEFAULT_BANDS    5
+
+// Per-band parameter ranges
+#define EQ_DEFAULT_Q        0.707f  // Butterworth response (wider bandwidth)
+#define EQ_MIN_Q            0.1f
+#define EQ_MAX_Q            20.0f
+#define EQ_MIN_FREQ         10.0f
+#define EQ_MIN_GAIN_DB      -12.0f
+#define EQ_MAX_GAIN_DB      12.0f
+
+// Filter type of a band
+typedef enum {
+    EQ_FILTER_PEAKING = 0,                      // Bell boost/cut (gain, Q)
+    EQ_FILTER_LOW_SHELF,                        // Shelf below freq (gain, Q = slope)
+    EQ_FILTER_HIGH_SHELF,                       // Shelf above freq (gain, Q = slope)
+    EQ_FILTER_LOWPASS,                          // 12dB/oct low-pass (gain ignored)
+    EQ_FILTER_HIGHPASS,                         // 12dB/oct high-pass (gain ignored)
+    EQ_FILTER_NOTCH,                            // Notch at freq (gain ignored)
+    EQ_FILTER_TYPE_COUNT
+} eq_filter_type_t;
+
+// User-facing configuration of one band
 typedef struct {
-    int32_t b0, b1, b2;  // Feedforward coefficients (Q24 fixed-point)
-    int32_t a1, a2;      // Feedback coefficients (Q24 fixed-point, a0 is normalized to 1)
-} biquad_coeffs_t;
+    eq_filter_type_t type;                      // Filter type
+    float freq;                                 // Centre / corner frequency in Hz
+    float q;                                    // Quality factor
+    float gain_db;                              // Gain in dB (peaking and shelves only)
+    bool enabled;                               // Band is part of the EQ
+} eq_band_t;
+
+// Build-time kernel selection
+// The esp-dsp float kernel (dsps_biquad_sf32, AES3/PIE assembly on ESP32-S3)
+// filters both stereo channels together but only works on whole blocks; the
+// scalar Q24 kernel can also be run one frame at a time (fused chain)
+#ifdef CONFIG_EQ_SIMD_KERNEL
+#define EQUALIZER_BLOCK_KERNEL  1
+#else
+#define EQUALIZER_BLOCK_KERNEL  0
+#endif
 
-// Biquad filter state (one per channel per band)
+// Maximum frequency-response deviation between the SIMD and Q24 kernels
+// accepted by the self-test (both are limited by ~24-bit coefficient precision)
+#define EQ_SELFTEST_MAX_DEVIATION_DB  0.05f
+
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
+// Coefficients are indexed by band slot; slots outside the cascade hold
+// identity coefficients so ramps can fade bands in and out.
 typedef struct {
-    int32_t x1, x2;    // Previous input samples
-    int32_t y1, y2;    // Previous output samples
-} biquad_state_t;
+    float coeffs_f32[EQ_MAX_BANDS][5] __attribute__((aligned(16)));    // Float coefficients for SIMD kernel / float32 chain (b0, b1, b2, a1, a2)
+    biquad_coeffs_t coeffs[EQ_MAX_BANDS];       // Filter coefficients for each band slot
+    uint8_t cascade[EQ_MAX_BANDS];              // Slots that are processed, in order
+    uint8_t num_cascade;                        // 0 = flat (processing skipped)
+    uint32_t version;                           // Bumped on every publish (starts a ramp)
+    uint8_t cut;                                // Bumped with version to apply without a ramp
+} equalizer_params_t;
 
-// Equalizer structure
+// Equalizer structure (audio task fields first, see dsp_attr.h)
 typedef struct {
-    biquad_coeffs_t coeffs[EQ_BANDS];           // Filter coefficients for each band
-    biquad_state_t state_left[EQ_BANDS];        // State for left channel
-    biquad_state_t state_right[EQ_BANDS];       // State for right channel
-    float gain_db[EQ_BANDS];                    // Gain in dB for each band (-12 to +12)
+    equalizer_params_t params[2];               // Published / shadow parameter sets
+    biquad_state_t state_left[EQ_MAX_BANDS] __attribute__((aligned(16)));  // State for left channel
+    biquad_state_t state_right[EQ_MAX_BANDS];   // State for right channel
+    float state_f32[EQ_MAX_BANDS][4] __attribute__((aligned(16)));        // SIMD kernel / float32 chain state (DF-II: L w0, L w1, R w0, R w1)
+    // Coefficient ramp (audio task only)
+    equalizer_params_t ramp_from;               // Coefficients when the current ramp started
+    equalizer_params_t ramp_current;            // Coefficients currently applied
+    uint32_t ramp_version;                      // params version the ramp is heading to
+    int ramp_segment;                           // Segments done (PARAM_RAMP_SEGMENTS = settled)
+    uint8_t ramp_cut;                           // params cut last taken
+    coeff_bank_t bank;                          // Publish state for params
+    volatile bool reset_pending;                // Clear filter history at next block
+    // Control side
+    eq_band_t bands[EQ_MAX_BANDS];              // Band configuration
+    dsp_trig_t trig[EQ_MAX_BANDS];              // cos/sin(w0) per band slot
     bool enabled;                                // Enable/disable equalizer
 } equalizer_t;
 
+// Bands in the persistent settings: the largest pool, so that the settings
+// blob layout does not depend on CONFIG_EQ_MAX_BANDS
+#define EQ_SETTINGS_BANDS   16
+
+// Bump whenever calculate_band_filter changes, so that coefficient caches
+// written by older firmware are recomputed
+#define EQ_COEFF_CACHE_VERSION  1
+
+// Persistent configuration of one band
+typedef struct {
+    float freq;                                 // Frequency in Hz
+    float q;                                    // Quality factor
+    float gain_db;                              // Gain in dB
+    uint8_t type;                               // eq_filter_type_t
+    uint8_t enabled;                            // Band enabled
+    uint8_t reserved[2];
+} eq_band_settings_t;
+
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    eq_band_settings_t bands[EQ_SETTINGS_BANDS];
+    uint8_t num_bands;                          // Valid entries in bands (EQ_MAX_BANDS when saved)
+    uint8_t enabled;                            // Equalizer enabled
+    uint8_t reserved[2];
+} equalizer_settings_t;
+
+// Coefficients baked from an equalizer_settings_t, stored next to it so that
+// boot can skip the filter design
+typedef struct {
+    uint32_t sample_rate;                       // Rate the coefficients were computed for
+    uint16_t version;                           // EQ_COEFF_CACHE_VERSION
+    uint8_t num_bands;                          // Valid entries
+    uint8_t reserved;
+    biquad_coeffs_t coeffs[EQ_SETTINGS_BANDS];  // Q24 coefficients per band slot
+    float coeffs_f32[EQ_SETTINGS_BANDS][5];     // Float coefficients per band slot
+} equalizer_coeff_cache_t;
+
 /**
- * Initialize equalizer with default settings (all bands at 0dB)
+ * Initialize equalizer with default settings
+ * 
+ * Enables the default 5-band peaking layout at 0dB; the remaining pool
+ * bands are disabled.
  * 
  * @param eq Pointer to equalizer structure
  * @param sample_rate Sample rate in Hz
@@ -48,13 +153,62 @@ void equalizer_init(equalizer_t *eq, uint32_t sample_rate);
  * Set gain for a specific band
  * 
  * @param eq Pointer to equalizer structure
- * @param band Band index (0-4)
+ * @param band Band index (0 to EQ_MAX_BANDS-1)
  * @param gain_db Gain in dB (-12.0 to +12.0)
  * @param sample_rate Sample rate in Hz
  * @return true if successful, false if parameters invalid
  */
 bool equalizer_set_band_gain(equalizer_t *eq, int band, float gain_db, uint32_t sample_rate);
 
+/**
+ * Configure a band (type, frequency, Q, gain and enable) in one update
+ * 
+ * Frequency, Q and gain are clamped to their valid ranges.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param band Band index (0 to EQ_MAX_BANDS-1)
+ * @param config New band configuration
+ * @param sample_rate Sample rate in Hz
+ * @return true if successful, false if band or type invalid
+ */
+bool equalizer_set_band(equalizer_t *eq, int band, const eq_band_t *config, uint32_t sample_rate);
+
+/**
+ * Get a band's configuration
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param band Band index (0 to EQ_MAX_BANDS-1)
+ * @return Band configuration, or NULL if band invalid
+ */
+const eq_band_t *equalizer_get_band(const equalizer_t *eq, int band);
+
+/**
+ * Get the number of bands the audio path currently processes
+ * 
+ * Disabled bands and peaking/shelf bands at exactly 0dB are not processed.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @return Number of bands in the published cascade
+ */
+int equalizer_get_active_bands(const equalizer_t *eq);
+
+/**
+ * Get the printable name of a filter type
+ * 
+ * @param type Filter type
+ * @return "peaking", "lowshelf", "highshelf", "lowpass", "highpass" or "notch"
+ */
+const char *equalizer_type_name(eq_filter_type_t type);
+
+/**
+ * Parse a filter type name (as returned by equalizer_type_name)
+ * 
+ * @param name Type name
+ * @param type Set to the parsed type
+ * @return true if name is a known type
+ */
+bool equalizer_type_from_name(const char *name, eq_filter_type_t *type);
+
 /**
  * Process audio through equalizer
  * 
@@ -64,6 +218,95 @@ bool equalizer_set_band_gain(equalizer_t *eq, int band, float gain_db, uint32_t
  */
 void equalizer_process(equalizer_t *eq, int32_t *buffer, int num_samples);
 
+/**
+ * Latch the published parameters for one block (audio task only)
+ * 
+ * Also services a pending equalizer_reset. Must be paired with
+ * equalizer_end_block.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @return Parameters to use for this block
+ */
+const equalizer_params_t *equalizer_begin_block(equalizer_t *eq);
+
+/**
+ * Release the parameters latched by equalizer_begin_block (audio task only)
+ * 
+ * @param eq Pointer to equalizer structure
+ */
+void equalizer_end_block(equalizer_t *eq);
+
+/**
+ * Filter a block with already-latched parameters (block kernel)
+ * 
+ * Ignores the enable flag; only the bands in the cascade are processed, and
+ * nothing is done when the cascade is empty and no ramp is in progress.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param params Parameters returned by equalizer_begin_block
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void equalizer_process_block(equalizer_t *eq, const equalizer_params_t *params,
+                             int32_t *buffer, int num_samples);
+
+/**
+ * Process a float block through the equalizer (float32 chain)
+ * 
+ * Always uses the esp-dsp float kernel and its filter state, whichever
+ * kernel the integer path was built with. Samples are on the 24-bit scale
+ * (full-scale = 8388608.0f).
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void equalizer_process_f32(equalizer_t *eq, float *buffer, int num_samples);
+
+/**
+ * Check for newly published coefficients and start a ramp towards them
+ * 
+ * Called once per block by equalizer_process_block; exposed for the fused
+ * chain, which filters frame by frame (audio task only).
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param params Parameters returned by equalizer_begin_block
+ * @return true while a ramp is in progress
+ */
+bool equalizer_ramp_begin(equalizer_t *eq, const equalizer_params_t *params);
+
+/**
+ * Get the coefficients for the next PARAM_RAMP_SEGMENT_FRAMES frames of a ramp
+ * 
+ * Only valid in a block for which equalizer_ramp_begin returned true; the
+ * returned set (and its cascade) stays the same object for the whole block
+ * (audio task only).
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param params Parameters returned by equalizer_begin_block
+ * @return Coefficient set to apply to the next segment
+ */
+const equalizer_params_t *equalizer_ramp_next(equalizer_t *eq, const equalizer_params_t *params);
+
+/**
+ * Get the name of the kernel selected at build time
+ * 
+ * @return "esp-dsp f32 (SIMD)" or "scalar Q24"
+ */
+const char *equalizer_kernel_name(void);
+
+/**
+ * Check the SIMD kernel against the scalar Q24 reference
+ * 
+ * Runs both kernels on private equalizer instances with non-flat band gains
+ * and compares the steady-state gain at a set of test frequencies; live
+ * audio is untouched.
+ * 
+ * @param max_deviation_db Set to the largest response difference in dB (may be NULL)
+ * @return ESP_OK if within EQ_SELFTEST_MAX_DEVIATION_DB, ESP_FAIL otherwise
+ */
+esp_err_t equalizer_kernel_selftest(float *max_deviation_db);
+
 /**
  * Enable or disable equalizer
  * 
@@ -72,23 +315,96 @@ void equalizer_process(equalizer_t *eq, int32_t *buffer, int num_samples);
  */
 void equalizer_set_enabled(equalizer_t *eq, bool enabled);
 
+/**
+ * Redesign every band for a new sample rate
+ * 
+ * Band frequencies above the new limit (0.45 x sample rate) are lowered to
+ * it. Only while the audio path is stopped (see audio_rate.h): the new
+ * coefficients apply without a ramp and the filter history is cleared.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param sample_rate Sample rate in Hz
+ */
+void equalizer_set_sample_rate(equalizer_t *eq, uint32_t sample_rate);
+
 /**
  * Reset equalizer state (clear filter history)
  * 
+ * The reset is performed by the audio task at its next block boundary.
+ * 
  * @param eq Pointer to equalizer structure
  */
 void equalizer_reset(equalizer_t *eq);
 
 /**
- * Save equalizer settings to NVS flash storage
+ * Copy the persistent settings
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param settings Destination
+ */
+void equalizer_get_settings(const equalizer_t *eq, equalizer_settings_t *settings);
+
+/**
+ * Compute the coefficients equalizer_apply_settings would compute
+ * 
+ * @param settings Settings from equalizer_get_settings
+ * @param sample_rate Sample rate in Hz
+ * @param cache Destination
+ */
+void equalizer_bake_coeff_cache(const equalizer_settings_t *settings, uint32_t sample_rate,
+                                equalizer_coeff_cache_t *cache);
+
+/**
+ * Apply persistent settings in one publish
+ * 
+ * With a cache that matches the sample rate and EQ_COEFF_CACHE_VERSION the
+ * coefficients are copied instead of computed.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param settings Settings from equalizer_get_settings
+ * @param cache Coefficients from equalizer_bake_coeff_cache, or NULL
+ * @param sample_rate Sample rate in Hz
+ * @return true if the cache was used
+ */
+bool equalizer_apply_settings(equalizer_t *eq, const equalizer_settings_t *settings,
+                              const equalizer_coeff_cache_t *cache, uint32_t sample_rate);
+
+/**
+ * Apply some bands of a settings set in one publish (dsp_control)
+ * 
+ * Only the bands in band_mask are designed again, with the usual ramp; the
+ * other bands and the enable flag are left as they are.
  * 
  * @param eq Pointer to equalizer structure
- * @return ESP_OK on success, error code otherwise
+ * @param settings Settings from equalizer_get_settings, edited
+ * @param band_mask Bit n set to apply band n
+ * @param sample_rate Sample rate in Hz
+ */
+void equalizer_apply_bands(equalizer_t *eq, const equalizer_settings_t *settings,
+                           uint32_t band_mask, uint32_t sample_rate);
+
+/**
+ * Apply settings with coefficients baked by equalizer_bake_coeff_cache (see
+ * preset_bank.h)
+ * 
+ * As equalizer_apply_settings, with a choice of transition, and the enable
+ * flag set through coeff_bank_set_flag so that inside a group it changes in
+ * the same block as the coefficients.
+ * 
+ * @param eq Pointer to equalizer structure
+ * @param settings Settings the coefficients were baked from
+ * @param cache Baked coefficients (recomputed if they do not match sample_rate)
+ * @param sample_rate Sample rate in Hz
+ * @param crossfade true to ramp to the new coefficients, false to switch at the block boundary
+ * @return true if the cache was used
  */
-esp_err_t equalizer_save_settings(equalizer_t *eq);
+bool equalizer_apply_baked(equalizer_t *eq, const equalizer_settings_t *settings,
+                           const equalizer_coeff_cache_t *cache, uint32_t sample_rate,
+                           bool crossfade);
 
 /**
- * Load equalizer settings from NVS flash storage
+ * Load equalizer settings saved as separate NVS keys (firmware before the
+ * settings blob; used once to migrate)
  * 
  * @param eq Pointer to equalizer structure
  * @param sample_rate Sample rate in Hz
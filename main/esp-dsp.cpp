@@ -12,6 +12,27 @@
 #include "pregain.h"
 #include "equalizer.h"
 #include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "dsp_chain.h"
+#include "dsp_perf.h"
+#include "dsp_attr.h"
+#include "dsp_bench.h"
+#include "level_meter.h"
+#include "spectrum.h"
+#include "audio_tap.h"
+#include "dsp_control.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "audio_i2s.h"
+#include "audio_rate.h"
+#include "audio_xrun.h"
+#include "coeff_bank.h"
+#include "persist.h"
+#include "settings_blob.h"
+#include "preset_bank.h"
 #include "serial_commands.h"
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
@@ -21,26 +42,60 @@
 
 static const char *TAG = "ESP-DSP";
 
+#if !AUDIO_LOWLAT_ENABLED
 // I2S Handles - both on same peripheral
 static i2s_chan_handle_t rx_handle = NULL;
 static i2s_chan_handle_t tx_handle = NULL;
+#endif
 
 // Global instances accessible to serial_commands
 subsonic_t subsonic;    // Subsonic/DC protection filter
 pregain_t pregain;      // Pre-gain processor (applied before EQ)
 equalizer_t equalizer;  // Changed from 'eq' to 'equalizer' and made non-static
 limiter_t limiter;      // True-peak limiter for clipping prevention
+convolver_t convolver;  // FIR convolver (room correction, with CONVOLVER)
+crossover_t crossover;  // Active crossover into the output ways (with CROSSOVER)
+multiband_t multiband;  // Multiband dynamics before the limiter (with MULTIBAND)
+delay_line_t delay_line; // Output delay after the limiter (with DELAY_LINE)
 
-// Audio buffer
-static int32_t audio_buffer[DMA_BUFFER_SIZE];
+#if !AUDIO_PIPELINE_ENABLED && !AUDIO_LOWLAT_ENABLED
+// Audio buffer (the dual-core pipeline keeps its own blocks, low-latency
+// I/O processes in the DMA buffers), in internal DRAM like the modules
+static int32_t audio_buffer[DMA_BUFFER_SIZE] __attribute__((aligned(16)));
+#if CROSSOVER_ENABLED
+// The crossover ways, in the layout of the I2S outputs
+static int32_t output_buffer[AUDIO_I2S_OUT_SAMPLES] __attribute__((aligned(16)));
+#endif
+#endif
 
 // Neopixel (WS2812) configuration
 #define NEOPIXEL_GPIO GPIO_NUM_8
 #define NEOPIXEL_LED_COUNT 1
 
+// Level display: dark below LED_METER_FLOOR_DB, green brightening with the
+// output peak, amber above LED_METER_HOT_DB, red while the limiter works
+#define LED_METER_FLOOR_DB      -48.0f
+#define LED_METER_HOT_DB        -6.0f
+#define LED_METER_MAX_LEVEL     64
+
 static led_strip_handle_t neopixel_strip = NULL;
 
-// LED task: polls limiter.is_triggered and updates the neopixel
+static void meter_color(const level_meter_snapshot_t *meter, uint32_t *red, uint32_t *green)
+{
+    const float peak = (meter->peak_db[0] > meter->peak_db[1]) ? meter->peak_db[0] : meter->peak_db[1];
+    if (peak < LED_METER_FLOOR_DB) {
+        return;
+    }
+    const uint32_t level = 4 + (uint32_t)((LED_METER_MAX_LEVEL - 4) * (peak - LED_METER_FLOOR_DB) /
+                                          -LED_METER_FLOOR_DB);
+    *green = level;
+    if (peak > LED_METER_HOT_DB) {
+        *red = level;
+    }
+}
+
+// LED task: shows the output level from the meter mailbox and limiting
+// (only limiting with the VU meter off)
 static void neopixel_task(void *pvParameters)
 {
     // If neopixel couldn't be initialized, exit the task
@@ -50,15 +105,17 @@ static void neopixel_task(void *pvParameters)
     }
 
     while (1) {
-        bool triggered = limiter.is_triggered;
-
-        if (triggered) {
-            // Red (RGB order: red, green, blue)
-            led_strip_set_pixel(neopixel_strip, 0, 255, 0, 0);
-        } else {
-            // Off
-            led_strip_set_pixel(neopixel_strip, 0, 0, 0, 0);
+        uint32_t red = 0;
+        uint32_t green = 0;
+        level_meter_snapshot_t meter;
+
+        if (limiter.is_triggered) {
+            red = 255;
+        } else if (is_vu_meter_enabled() && level_meter_get_snapshot(&meter) == ESP_OK) {
+            meter_color(&meter, &red, &green);
         }
+        // RGB order: red, green, blue
+        led_strip_set_pixel(neopixel_strip, 0, red, green, 0);
         // Refresh (flush to the strip)
         led_strip_refresh(neopixel_strip);
 
@@ -67,88 +124,47 @@ static void neopixel_task(void *pvParameters)
     }
 }
 
+#if !AUDIO_LOWLAT_ENABLED
 /**
  * Initialize I2S channels for ADC and DAC on same peripheral
  */
 static esp_err_t init_i2s(void)
 {
-    ESP_LOGI(TAG, "Initializing I2S channels...");
-    
-    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
-    chan_cfg.dma_desc_num = DMA_BUFFER_COUNT;
-    chan_cfg.dma_frame_num = DMA_BUFFER_SIZE;
-    chan_cfg.auto_clear = true;
-    
-    esp_err_t ret = i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create I2S channels: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ESP_LOGI(TAG, "I2S channels created - RX: %p, TX: %p", rx_handle, tx_handle);
-    
-    // Configure RX channel without MCLK
-    i2s_std_config_t std_cfg = {
-        .clk_cfg = {
-            .sample_rate_hz = SAMPLE_RATE,
-            .clk_src = I2S_CLK_SRC_DEFAULT,
-            .ext_clk_freq_hz = 0, // No external clock
-            .mclk_multiple = I2S_MCLK_MULTIPLE_384,  // Still set for internal calculation
-        },
-        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO),
-        .gpio_cfg = {
-            .mclk = I2S_MCLK, 
-            .bclk = I2S_DAC_BCLK,
-            .ws = I2S_DAC_WS,
-            .dout = I2S_DAC_DOUT,
-            .din = I2S_ADC_DIN,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv = false,
-            },
-        },
-    };
-    
-    // Initialize TX channel
-    ret = i2s_channel_init_std_mode(tx_handle, &std_cfg);
+    esp_err_t ret = audio_i2s_create(DMA_BUFFER_COUNT, DMA_BUFFER_SIZE, &tx_handle, &rx_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize I2S TX: %s", esp_err_to_name(ret));
         return ret;
     }
-    
-    // Initialize RX channel with SAME config (clocks already shared)
-    ret = i2s_channel_init_std_mode(rx_handle, &std_cfg);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize I2S RX: %s", esp_err_to_name(ret));
-        return ret;
+    // Dropout callbacks must be registered before the channels run
+    if (audio_xrun_attach(tx_handle, rx_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "RX overflows and TX underruns will not be counted");
     }
-    
-    // Enable TX first, then RX
-    ret = i2s_channel_enable(tx_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to enable I2S TX: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = i2s_channel_enable(rx_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to enable I2S RX: %s", esp_err_to_name(ret));
-        return ret;
+    return audio_i2s_enable(tx_handle, rx_handle);
+}
+#endif
+
+#if !AUDIO_PIPELINE_ENABLED && !AUDIO_LOWLAT_ENABLED
+/**
+ * Queue silence ahead of the first block (at start and after a rate change)
+ */
+static void prefill_tx(void)
+{
+#if CROSSOVER_ENABLED
+    int32_t *silence = output_buffer;
+#else
+    int32_t *silence = audio_buffer;
+#endif
+    memset(silence, 0, AUDIO_I2S_OUT_SAMPLES * sizeof(int32_t));
+    for (int i = 0; i < 4; i++) {
+        audio_i2s_write_output(tx_handle, silence, DMA_BUFFER_SIZE / I2S_NUM_CHANNELS);
     }
-    
-    ESP_LOGI(TAG, "I2S initialized successfully with shared clock domain and MCLK");
-    ESP_LOGI(TAG, "MCLK: %d Hz (48kHz * 384 = 18.432MHz)", SAMPLE_RATE * 384);
-    return ESP_OK;
 }
 
 /**
  * Audio pass-through task with monitoring
  */
-static void audio_task(void *pvParameters)
+static void DSP_HOT audio_task(void *pvParameters)
 {
     size_t bytes_read = 0;
-    size_t bytes_written = 0;
     
     ESP_LOGI(TAG, "Audio pass-through task started");
     
@@ -156,10 +172,7 @@ static void audio_task(void *pvParameters)
     vTaskDelay(pdMS_TO_TICKS(500));
     
     // Pre-fill TX buffer with silence
-    memset(audio_buffer, 0, sizeof(audio_buffer));
-    for (int i = 0; i < 4; i++) {
-        i2s_channel_write(tx_handle, audio_buffer, sizeof(audio_buffer), &bytes_written, portMAX_DELAY);
-    }
+    prefill_tx();
     ESP_LOGI(TAG, "TX buffer pre-filled");
     
     // Register this task with the task watchdog so long processing won't trigger
@@ -174,7 +187,25 @@ static void audio_task(void *pvParameters)
     }
 
     while (1) {
+        // 'bench run' measurements replace the I2S round trip while they run
+        if (dsp_bench_pending()) {
+            audio_xrun_suspend();
+            dsp_bench_service();
+            esp_task_wdt_reset();
+            continue;
+        }
+
+        // Sample rate changes are applied between two blocks
+        if (audio_rate_pending()) {
+            audio_xrun_suspend();
+            audio_rate_service(tx_handle, rx_handle);
+            prefill_tx();
+            esp_task_wdt_reset();
+            continue;
+        }
+
         // Read from ADC
+        uint32_t t_read = dsp_perf_now();
         esp_err_t ret = i2s_channel_read(rx_handle, audio_buffer, 
                                          sizeof(audio_buffer), &bytes_read, portMAX_DELAY);
         
@@ -185,60 +216,92 @@ static void audio_task(void *pvParameters)
         
         int num_samples = bytes_read / sizeof(int32_t);
 
-        for(int i = 0; i < num_samples; i++) {
-            audio_buffer[i] = audio_buffer[i] >> 8;
-            // audio_buffer[i] = __builtin_bswap32(audio_buffer[i]);
-        }
-
-        // Apply subsonic filter first (DC/subsonic protection)
-        subsonic_process(&subsonic, audio_buffer, num_samples);
-        
-        // Apply pre-gain before EQ
-        pregain_process(&pregain, audio_buffer, num_samples);
-        
-        // Apply equalizer
-        equalizer_process(&equalizer, audio_buffer, num_samples);
-        
-    // Apply limiter after EQ to prevent clipping
-    limiter_process(&limiter, audio_buffer, num_samples);
-
-    // Kick the task watchdog to indicate we're alive and processing. This
-    // prevents a watchdog reset if DSP processing occasionally takes more
-    // time than expected. If the WDT wasn't added, this call is harmless.
-    esp_task_wdt_reset();
+        audio_xrun_block_begin();
+        dsp_perf_block_begin(num_samples / I2S_NUM_CHANNELS);
+        dsp_perf_record(DSP_PERF_I2S_READ, dsp_perf_now() - t_read);
 
-        // // Debug: Log first sample before and after EQ (only occasionally)
-        // static int debug_counter = 0;
-        // if (debug_counter == 0) {
+        // Unpack → Subsonic → Pre-Gain → Equalizer → Limiter → repack
+        dsp_chain_process(audio_buffer, num_samples);
 
-        //     ESP_LOGI(TAG, "[ 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X 0x%08X ]", 
-        //         ((unsigned int)audio_buffer[0]), ((unsigned int)audio_buffer[2]), ((unsigned int)audio_buffer[4]), ((unsigned int)audio_buffer[6]), ((unsigned int)audio_buffer[8]),
-        //         ((unsigned int)audio_buffer[10]), ((unsigned int)audio_buffer[12]), ((unsigned int)audio_buffer[14]), ((unsigned int)audio_buffer[16]), ((unsigned int)audio_buffer[18]) );
-        // }
+        // Deadline check, dropout log and fade-in after a gap
+        audio_xrun_block_end(audio_buffer, num_samples);
 
-        
-        // debug_counter = (debug_counter + 1) % 10;  // Log every 100th buffer
-                
+        // Kick the task watchdog to indicate we're alive and processing. This
+        // prevents a watchdog reset if DSP processing occasionally takes more
+        // time than expected. If the WDT wasn't added, this call is harmless.
+        esp_task_wdt_reset();
 
-        for(int i = 0; i < num_samples; i++) {
-            audio_buffer[i] = audio_buffer[i] << 8;
-            // audio_buffer[i] = __builtin_bswap32(audio_buffer[i]);
-        }
+#if CROSSOVER_ENABLED
+        // Split into the output ways (after the fade, which works on stereo)
+        uint32_t t_xover = dsp_perf_now();
+        crossover_process(&crossover, audio_buffer, output_buffer, num_samples);
+        dsp_perf_record(DSP_PERF_XOVER, dsp_perf_now() - t_xover);
+        const int32_t *output = output_buffer;
+#else
+        const int32_t *output = audio_buffer;
+#endif
 
         // Write to DAC
-        ret = i2s_channel_write(tx_handle, audio_buffer, bytes_read, &bytes_written, portMAX_DELAY);
+        uint32_t t_write = dsp_perf_now();
+        ret = audio_i2s_write_output(tx_handle, output, num_samples / I2S_NUM_CHANNELS);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "I2S write error: %s", esp_err_to_name(ret));
         }
-        
+        dsp_perf_record(DSP_PERF_I2S_WRITE, dsp_perf_now() - t_write);
+        dsp_perf_block_end();
 
     }
 }
+#endif
+
+// Settings saved as separate NVS keys by firmware before the settings blob.
+// Returns true if any module had saved settings.
+static bool load_legacy_settings(void)
+{
+    bool found = false;
+    
+    // Try to load saved subsonic settings from flash
+    if (subsonic_load_settings(&subsonic, audio_rate_get()) == ESP_OK) {
+        found = true;
+    } else {
+        // No saved settings, use defaults
+        subsonic_set_enabled(&subsonic, true);
+        ESP_LOGI(TAG, "Using default subsonic filter settings");
+    }
+    
+    // Try to load saved pre-gain settings from flash
+    if (pregain_load_settings(&pregain) == ESP_OK) {
+        found = true;
+    } else {
+        // No saved settings, use defaults
+        pregain_set_enabled(&pregain, true);
+        ESP_LOGI(TAG, "Using default pre-gain settings");
+    }
+    
+    // Try to load saved settings from flash
+    if (equalizer_load_settings(&equalizer, audio_rate_get()) == ESP_OK) {
+        found = true;
+    } else {
+        // No saved settings, use defaults
+        equalizer_set_enabled(&equalizer, true);
+        ESP_LOGI(TAG, "Using default equalizer settings");
+    }
+    
+    // Try to load saved limiter settings from flash
+    if (limiter_load_settings(&limiter, audio_rate_get()) == ESP_OK) {
+        found = true;
+    } else {
+        // No saved settings, use defaults
+        limiter_set_enabled(&limiter, true);
+        ESP_LOGI(TAG, "Using default limiter settings");
+    }
+    
+    return found;
+}
 
 extern "C" void app_main(void)
 {
     ESP_LOGI(TAG, "ESP32 Audio Pass-Through Starting...");
-    ESP_LOGI(TAG, "Sample Rate: %d Hz", SAMPLE_RATE);
     ESP_LOGI(TAG, "Buffer Size: %d samples", DMA_BUFFER_SIZE);
     
     // Initialize NVS
@@ -251,6 +314,10 @@ extern "C" void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS initialized");
+
+    // Saved sample rate (before the I2S channels and the modules are created)
+    audio_rate_init();
+    ESP_LOGI(TAG, "Sample Rate: %lu Hz", (unsigned long)audio_rate_get());
     
     // Power management configuration
     esp_pm_config_t pm_config = {
@@ -260,57 +327,77 @@ extern "C" void app_main(void)
     };
     esp_pm_configure(&pm_config);
     
-    // Initialize I2S
+#if !AUDIO_LOWLAT_ENABLED
+    // Initialize I2S (low-latency I/O creates the channels in its own task)
     ret = init_i2s();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize I2S");
         return;
     }
+#endif
+
+    // Writer lock for the double-buffered DSP parameters (before any *_set_*)
+    coeff_bank_init();
 
-    // Initialize subsonic filter with defaults
-    subsonic_init(&subsonic, SAMPLE_RATE);
+    // Initialize the DSP processors with defaults
+    subsonic_init(&subsonic, audio_rate_get());
+    pregain_init(&pregain);
+    equalizer_init(&equalizer, audio_rate_get());
+    limiter_init(&limiter, audio_rate_get());
+    // Loads the stored impulse response; the audio path stays a bypass without one
+    if (convolver_init(&convolver, audio_rate_get()) != ESP_OK) {
+        ESP_LOGW(TAG, "Convolver unavailable (not enough memory)");
+    }
+    if (crossover_init(&crossover, audio_rate_get()) != ESP_OK) {
+        ESP_LOGE(TAG, "Crossover unavailable (not enough memory), outputs muted");
+    }
+    if (multiband_init(&multiband, audio_rate_get()) != ESP_OK) {
+        ESP_LOGW(TAG, "Multiband dynamics unavailable (not enough memory)");
+    }
+    if (delay_line_init(&delay_line, audio_rate_get()) != ESP_OK) {
+        ESP_LOGW(TAG, "Output delay unavailable (not enough PSRAM)");
+    }
     
-    // Try to load saved subsonic settings from flash
-    ret = subsonic_load_settings(&subsonic, SAMPLE_RATE);
+    // Saved settings: one blob read, or the per-key settings of older firmware
+    ret = settings_blob_load(audio_rate_get());
     if (ret != ESP_OK) {
-        // No saved settings, use defaults
-        subsonic_set_enabled(&subsonic, true);
-        ESP_LOGI(TAG, "Using default subsonic filter settings");
+        if (load_legacy_settings()) {
+            // Migrate: written as a blob once the persistence task starts
+            ESP_LOGI(TAG, "Converting saved settings to the settings blob");
+            for (int i = 0; i < PERSIST_MODULE_COUNT; i++) {
+                persist_mark_dirty((persist_module_t)i);
+            }
+        }
     }
     
-    // Initialize pre-gain with defaults
-    pregain_init(&pregain);
+    // Stored scene snapshots, baked for the current rate
+    preset_bank_init(audio_rate_get());
     
-    // Try to load saved pre-gain settings from flash
-    ret = pregain_load_settings(&pregain);
+    // Select staged or fused processing
+    dsp_chain_init();
+    level_meter_init(audio_rate_get());
+    ret = audio_xrun_init();
     if (ret != ESP_OK) {
-        // No saved settings, use defaults
-        pregain_set_enabled(&pregain, true);
-        ESP_LOGI(TAG, "Using default pre-gain settings");
+        ESP_LOGW(TAG, "Dropout log not available");
     }
-    
-    // Initialize equalizer with defaults
-    equalizer_init(&equalizer, SAMPLE_RATE);
-    
-    // Try to load saved settings from flash
-    ret = equalizer_load_settings(&equalizer, SAMPLE_RATE);
+    ret = spectrum_init(audio_rate_get());
     if (ret != ESP_OK) {
-        // No saved settings, use defaults
-        equalizer_set_enabled(&equalizer, true);
-        ESP_LOGI(TAG, "Using default equalizer settings");
+        ESP_LOGW(TAG, "Spectrum analyzer not available");
+    }
+    ret = audio_tap_init(audio_rate_get());
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Audio tap not available");
     }
     
-    // Initialize limiter with defaults
-    limiter_init(&limiter, SAMPLE_RATE);
-    
-    // Try to load saved limiter settings from flash
-    ret = limiter_load_settings(&limiter, SAMPLE_RATE);
+    // Debounced settings saves (before anything can issue commands)
+    ret = persist_init();
     if (ret != ESP_OK) {
-        // No saved settings, use defaults
-        limiter_set_enabled(&limiter, true);
-        ESP_LOGI(TAG, "Using default limiter settings");
+        ESP_LOGW(TAG, "Settings persistence not available");
     }
     
+    // Command registry shared by MQTT and serial
+    dsp_control_init();
+    
     // Initialize WiFi Manager
     ret = wifi_manager_init();
     if (ret != ESP_OK) {
@@ -353,6 +440,21 @@ extern "C" void app_main(void)
         ESP_LOGW(TAG, "Failed to initialize neopixel strip instance: %s", esp_err_to_name(ret));
     }
     
+#if AUDIO_LOWLAT_ENABLED
+    // DMA-event driven I/O, processing in the TX DMA buffers
+    ret = audio_lowlat_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start low-latency I/O");
+        return;
+    }
+#elif AUDIO_PIPELINE_ENABLED
+    // I2S on core 0, DSP chain on core 1
+    ret = audio_pipeline_start(rx_handle, tx_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start audio pipeline");
+        return;
+    }
+#else
     // Create audio task with high priority
     BaseType_t task_created = xTaskCreatePinnedToCore(
         audio_task, 
@@ -368,6 +470,7 @@ extern "C" void app_main(void)
         ESP_LOGE(TAG, "Failed to create audio task");
         return;
     }
+#endif
     
     ESP_LOGI(TAG, "Audio pass-through initialized");
     ESP_LOGI(TAG, "Connect audio source to ADC and speakers to DAC");
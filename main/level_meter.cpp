@@ -0,0 +1,376 @@
+#include "level_meter.h"
+#include "dsp_attr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+#if LEVEL_METER_ENABLED
+
+static const char *TAG = "METER";
+
+// 24-bit full scale; the chain saturates its output to [-FULL_SCALE, SAMPLE_MAX]
+#define FULL_SCALE      8388608.0f
+#define SAMPLE_MAX      8388607
+
+// BS.1770 channel-sum offset: a 997 Hz full-scale sine reads -3.01 LUFS
+#define LOUDNESS_OFFSET -0.691f
+
+// Raw sums of one window, as published to the mailbox
+typedef struct {
+    uint32_t windows;
+    int32_t peak[LEVEL_METER_CHANNELS];             // Largest magnitude, 24-bit units
+    float mean_square[LEVEL_METER_CHANNELS];        // Relative to full scale
+    int32_t peak_max[LEVEL_METER_CHANNELS];
+    uint32_t clips[LEVEL_METER_CHANNELS];
+    float momentary;                                // K-weighted mean square, channels summed
+    float short_term;
+    int bands;                                      // Bands reported in this window
+    float band_reduction[LEVEL_METER_BANDS];        // dB
+} meter_window_t;
+
+// Metering state, written only by the audio task
+static uint32_t s_window_frames = 1;
+static uint32_t s_frames = 0;                       // Frames in the current window
+static int32_t s_peak[LEVEL_METER_CHANNELS];
+static float s_sum_sq[LEVEL_METER_CHANNELS];
+static int32_t s_peak_max[LEVEL_METER_CHANNELS];
+static uint32_t s_clips[LEVEL_METER_CHANNELS];
+static uint32_t s_windows = 0;
+static int s_bands = 0;                             // Bands reported in the current window
+static float s_band_reduction[LEVEL_METER_BANDS];
+
+#if LEVEL_METER_LOUDNESS
+// K-weighting (BS.1770 pre-filter: high shelf, then RLB high-pass), float DF2T
+typedef struct {
+    float b0, b1, b2, a1, a2;
+} kw_coeffs_t;
+
+typedef struct {
+    float z1, z2;
+} kw_state_t;
+
+static kw_coeffs_t s_shelf;
+static kw_coeffs_t s_highpass;
+static kw_state_t s_shelf_state[LEVEL_METER_CHANNELS];
+static kw_state_t s_hp_state[LEVEL_METER_CHANNELS];
+static float s_kw_sum[LEVEL_METER_CHANNELS];
+
+// K-weighted energy of the last windows (ring, newest at s_energy_pos - 1)
+static float s_energy[LEVEL_METER_SHORT_TERM_WINDOWS];
+static int s_energy_pos = 0;
+static uint32_t s_energy_count = 0;
+#endif
+
+// Mailbox, sequence lock: odd while the audio task is writing it
+static meter_window_t s_mailbox;
+static volatile uint32_t s_seq = 0;
+
+// Set by level_meter_reset, serviced by the audio task at the next block
+static volatile bool s_reset_pending = false;
+
+#if LEVEL_METER_LOUDNESS
+static DSP_HOT_INLINE float kw_process(const kw_coeffs_t *c, kw_state_t *s, float x)
+{
+    const float y = c->b0 * x + s->z1;
+    s->z1 = c->b1 * x - c->a1 * y + s->z2;
+    s->z2 = c->b2 * x - c->a2 * y;
+    return y;
+}
+
+// Filter constants from ITU-R BS.1770-4, re-derived for any sample rate
+// (the standard's tables are for 48 kHz only)
+static void design_k_weighting(uint32_t sample_rate)
+{
+    const double fs = (double)sample_rate;
+
+    // Stage 1: +4 dB high shelf at 1682 Hz (head acoustics)
+    double k = tan(M_PI * 1681.974450955533 / fs);
+    double q = 0.7071752369554196;
+    const double vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    s_shelf.b0 = (float)((vh + vb * k / q + k * k) / a0);
+    s_shelf.b1 = (float)(2.0 * (k * k - vh) / a0);
+    s_shelf.b2 = (float)((vh - vb * k / q + k * k) / a0);
+    s_shelf.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+    s_shelf.a2 = (float)((1.0 - k / q + k * k) / a0);
+
+    // Stage 2: 38 Hz high-pass (revised low-frequency B-curve)
+    k = tan(M_PI * 38.13547087602444 / fs);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    s_highpass.b0 = 1.0f;
+    s_highpass.b1 = -2.0f;
+    s_highpass.b2 = 1.0f;
+    s_highpass.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+    s_highpass.a2 = (float)((1.0 - k / q + k * k) / a0);
+}
+#endif
+
+static void DSP_HOT clear_window(void)
+{
+    s_frames = 0;
+    s_bands = 0;
+    memset(s_band_reduction, 0, sizeof(s_band_reduction));
+    for (int ch = 0; ch < LEVEL_METER_CHANNELS; ch++) {
+        s_peak[ch] = 0;
+        s_sum_sq[ch] = 0.0f;
+#if LEVEL_METER_LOUDNESS
+        s_kw_sum[ch] = 0.0f;
+#endif
+    }
+}
+
+void level_meter_set_sample_rate(uint32_t sample_rate)
+{
+    s_window_frames = sample_rate * LEVEL_METER_WINDOW_MS / 1000;
+    if (s_window_frames == 0) {
+        s_window_frames = 1;
+    }
+    clear_window();
+
+#if LEVEL_METER_LOUDNESS
+    // Loudness history measured at another rate no longer applies
+    design_k_weighting(sample_rate);
+    memset(s_shelf_state, 0, sizeof(s_shelf_state));
+    memset(s_hp_state, 0, sizeof(s_hp_state));
+    memset(s_energy, 0, sizeof(s_energy));
+    s_energy_pos = 0;
+    s_energy_count = 0;
+#endif
+}
+
+void level_meter_init(uint32_t sample_rate)
+{
+    memset(s_peak_max, 0, sizeof(s_peak_max));
+    memset(s_clips, 0, sizeof(s_clips));
+    level_meter_set_sample_rate(sample_rate);
+
+    ESP_LOGI(TAG, "Level meter: %d ms windows (%lu frames), loudness %s", LEVEL_METER_WINDOW_MS,
+             (unsigned long)s_window_frames, LEVEL_METER_LOUDNESS ? "on" : "off");
+}
+
+// Fold frames into the current window (never past its end)
+static void DSP_HOT accumulate(const int32_t *buffer, int frames)
+{
+    int32_t peak_l = s_peak[0];
+    int32_t peak_r = s_peak[1];
+    uint32_t clips_l = 0;
+    uint32_t clips_r = 0;
+    float sq_l = 0.0f;
+    float sq_r = 0.0f;
+#if LEVEL_METER_LOUDNESS
+    const kw_coeffs_t shelf = s_shelf;
+    const kw_coeffs_t hp = s_highpass;
+    kw_state_t shelf_l = s_shelf_state[0];
+    kw_state_t shelf_r = s_shelf_state[1];
+    kw_state_t hp_l = s_hp_state[0];
+    kw_state_t hp_r = s_hp_state[1];
+    float kw_l = 0.0f;
+    float kw_r = 0.0f;
+#endif
+
+    for (int f = 0; f < frames; f++) {
+        const int32_t l = buffer[2 * f] >> 8;
+        const int32_t r = buffer[2 * f + 1] >> 8;
+        const int32_t mag_l = (l < 0) ? -l : l;
+        const int32_t mag_r = (r < 0) ? -r : r;
+
+        if (mag_l > peak_l) {
+            peak_l = mag_l;
+        }
+        if (mag_r > peak_r) {
+            peak_r = mag_r;
+        }
+        clips_l += (mag_l >= SAMPLE_MAX);
+        clips_r += (mag_r >= SAMPLE_MAX);
+
+        const float xl = (float)l * (1.0f / FULL_SCALE);
+        const float xr = (float)r * (1.0f / FULL_SCALE);
+        sq_l += xl * xl;
+        sq_r += xr * xr;
+
+#if LEVEL_METER_LOUDNESS
+        const float kl = kw_process(&hp, &hp_l, kw_process(&shelf, &shelf_l, xl));
+        const float kr = kw_process(&hp, &hp_r, kw_process(&shelf, &shelf_r, xr));
+        kw_l += kl * kl;
+        kw_r += kr * kr;
+#endif
+    }
+
+    s_peak[0] = peak_l;
+    s_peak[1] = peak_r;
+    s_clips[0] += clips_l;
+    s_clips[1] += clips_r;
+    s_sum_sq[0] += sq_l;
+    s_sum_sq[1] += sq_r;
+#if LEVEL_METER_LOUDNESS
+    s_shelf_state[0] = shelf_l;
+    s_shelf_state[1] = shelf_r;
+    s_hp_state[0] = hp_l;
+    s_hp_state[1] = hp_r;
+    s_kw_sum[0] += kw_l;
+    s_kw_sum[1] += kw_r;
+#endif
+}
+
+#if LEVEL_METER_LOUDNESS
+// Mean of the newest n window energies
+static float DSP_HOT energy_mean(int n)
+{
+    float sum = 0.0f;
+    int pos = s_energy_pos;
+    for (int i = 0; i < n; i++) {
+        pos = (pos == 0) ? LEVEL_METER_SHORT_TERM_WINDOWS - 1 : pos - 1;
+        sum += s_energy[pos];
+    }
+    return sum / (float)n;
+}
+#endif
+
+static void DSP_HOT publish_window(void)
+{
+    const float inv_frames = 1.0f / (float)s_frames;
+
+    s_windows++;
+    for (int ch = 0; ch < LEVEL_METER_CHANNELS; ch++) {
+        if (s_peak[ch] > s_peak_max[ch]) {
+            s_peak_max[ch] = s_peak[ch];
+        }
+    }
+#if LEVEL_METER_LOUDNESS
+    s_energy[s_energy_pos] = (s_kw_sum[0] + s_kw_sum[1]) * inv_frames;
+    s_energy_pos = (s_energy_pos + 1) % LEVEL_METER_SHORT_TERM_WINDOWS;
+    if (s_energy_count < LEVEL_METER_SHORT_TERM_WINDOWS) {
+        s_energy_count++;
+    }
+#endif
+
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+    s_mailbox.windows = s_windows;
+    for (int ch = 0; ch < LEVEL_METER_CHANNELS; ch++) {
+        s_mailbox.peak[ch] = s_peak[ch];
+        s_mailbox.mean_square[ch] = s_sum_sq[ch] * inv_frames;
+        s_mailbox.peak_max[ch] = s_peak_max[ch];
+        s_mailbox.clips[ch] = s_clips[ch];
+    }
+#if LEVEL_METER_LOUDNESS
+    s_mailbox.momentary = (s_energy_count >= LEVEL_METER_MOMENTARY_WINDOWS)
+                              ? energy_mean(LEVEL_METER_MOMENTARY_WINDOWS) : 0.0f;
+    s_mailbox.short_term = (s_energy_count >= LEVEL_METER_SHORT_TERM_WINDOWS)
+                               ? energy_mean(LEVEL_METER_SHORT_TERM_WINDOWS) : 0.0f;
+#endif
+    s_mailbox.bands = s_bands;
+    memcpy(s_mailbox.band_reduction, s_band_reduction, sizeof(s_band_reduction));
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+
+    clear_window();
+}
+
+void DSP_HOT level_meter_process(const int32_t *buffer, int num_samples)
+{
+    if (s_reset_pending) {
+        s_reset_pending = false;
+        memset(s_peak_max, 0, sizeof(s_peak_max));
+        memset(s_clips, 0, sizeof(s_clips));
+    }
+
+    // Blocks need not divide the window: split at the window boundary
+    int i = 0;
+    while (i + 1 < num_samples) {
+        uint32_t frames = (uint32_t)(num_samples - i) / 2;
+        if (frames > s_window_frames - s_frames) {
+            frames = s_window_frames - s_frames;
+        }
+        accumulate(buffer + i, (int)frames);
+        i += 2 * (int)frames;
+        s_frames += frames;
+        if (s_frames >= s_window_frames) {
+            publish_window();
+        }
+    }
+}
+
+void DSP_HOT level_meter_band_reduction(const float *reduction_db, int bands)
+{
+    if (bands > LEVEL_METER_BANDS) {
+        bands = LEVEL_METER_BANDS;
+    }
+    for (int b = 0; b < bands; b++) {
+        s_band_reduction[b] = fmaxf(s_band_reduction[b], reduction_db[b]);
+    }
+    s_bands = bands;
+}
+
+void level_meter_reset(void)
+{
+    s_reset_pending = true;
+}
+
+static float amplitude_db(int32_t peak)
+{
+    if (peak <= 0) {
+        return LEVEL_METER_FLOOR_DB;
+    }
+    const float db = 20.0f * log10f((float)peak / FULL_SCALE);
+    return (db < LEVEL_METER_FLOOR_DB) ? LEVEL_METER_FLOOR_DB : db;
+}
+
+static float power_db(float mean_square, float offset)
+{
+    if (mean_square <= 0.0f) {
+        return LEVEL_METER_FLOOR_DB;
+    }
+    const float db = offset + 10.0f * log10f(mean_square);
+    return (db < LEVEL_METER_FLOOR_DB) ? LEVEL_METER_FLOOR_DB : db;
+}
+
+esp_err_t level_meter_get_snapshot(level_meter_snapshot_t *snapshot)
+{
+    meter_window_t window;
+    bool copied = false;
+
+    // A window takes 100 ms and the copy microseconds, so a retry is rare
+    for (int attempt = 0; attempt < 8 && !copied; attempt++) {
+        const uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_SEQ_CST);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(&window, &s_mailbox, sizeof(window));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        copied = (__atomic_load_n(&s_seq, __ATOMIC_SEQ_CST) == seq);
+    }
+    if (!copied) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    snapshot->windows = window.windows;
+    for (int ch = 0; ch < LEVEL_METER_CHANNELS; ch++) {
+        snapshot->peak_db[ch] = amplitude_db(window.peak[ch]);
+        snapshot->rms_db[ch] = power_db(window.mean_square[ch], 0.0f);
+        snapshot->peak_max_db[ch] = amplitude_db(window.peak_max[ch]);
+        snapshot->clips[ch] = window.clips[ch];
+    }
+    snapshot->loudness = LEVEL_METER_LOUDNESS;
+    snapshot->momentary_lufs = power_db(window.momentary, LOUDNESS_OFFSET);
+    snapshot->short_term_lufs = power_db(window.short_term, LOUDNESS_OFFSET);
+    snapshot->bands = window.bands;
+    for (int b = 0; b < LEVEL_METER_BANDS; b++) {
+        snapshot->band_reduction_db[b] = (b < window.bands) ? window.band_reduction[b] : 0.0f;
+    }
+    return ESP_OK;
+}
+
+#else
+
+void level_meter_reset(void)
+{
+}
+
+esp_err_t level_meter_get_snapshot(level_meter_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
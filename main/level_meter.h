@@ -0,0 +1,123 @@
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Output level meter
+// The audio task folds every block leaving the chain into running sums: the
+// sample peak and sum of squares per channel and, optionally, the K-weighted
+// energy of ITU-R BS.1770 loudness. Every LEVEL_METER_WINDOW_MS it publishes
+// the raw sums of the window just finished to a mailbox (sequence lock, as in
+// dsp_perf) and starts the next one. Readers (serial, MQTT, LED task) copy the
+// mailbox and do the dB conversion themselves; they never touch audio state
+// or block the audio task. The multiband processor adds the largest gain
+// reduction of each of its bands per window.
+
+#ifdef CONFIG_LEVEL_METER
+#define LEVEL_METER_ENABLED     1
+#else
+#define LEVEL_METER_ENABLED     0
+#endif
+
+#ifdef CONFIG_LEVEL_METER_LOUDNESS
+#define LEVEL_METER_LOUDNESS    1
+#else
+#define LEVEL_METER_LOUDNESS    0
+#endif
+
+#define LEVEL_METER_CHANNELS    2
+
+// Metering window, also the 100 ms step of the BS.1770 gating blocks
+#define LEVEL_METER_WINDOW_MS   100
+
+// Loudness integration times, in windows
+#define LEVEL_METER_MOMENTARY_WINDOWS   4       // 400 ms
+#define LEVEL_METER_SHORT_TERM_WINDOWS  30      // 3 s
+
+// Bands of the gain reduction report (multiband processor)
+#define LEVEL_METER_BANDS       4
+
+// Reported for silence (and for loudness before its first full window)
+#define LEVEL_METER_FLOOR_DB    -120.0f
+
+// Levels of the last completed window
+typedef struct {
+    uint32_t windows;                               // Windows completed since boot (changes with each new snapshot)
+    float peak_db[LEVEL_METER_CHANNELS];            // Sample peak, dBFS
+    float rms_db[LEVEL_METER_CHANNELS];             // RMS, dBFS (full-scale square wave = 0)
+    float peak_max_db[LEVEL_METER_CHANNELS];        // Highest sample peak since the last reset, dBFS
+    uint32_t clips[LEVEL_METER_CHANNELS];           // Full-scale samples since the last reset
+    bool loudness;                                  // momentary/short_term are measured
+    float momentary_lufs;                           // K-weighted loudness over 400 ms, LUFS
+    float short_term_lufs;                          // K-weighted loudness over 3 s, LUFS
+    int bands;                                      // Bands reported by the multiband processor (0 = not running)
+    float band_reduction_db[LEVEL_METER_BANDS];     // Largest gain reduction per band, dB (positive)
+} level_meter_snapshot_t;
+
+#if LEVEL_METER_ENABLED
+
+/**
+ * Set up the meter for a sample rate (before the audio task starts)
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void level_meter_init(uint32_t sample_rate);
+
+/**
+ * Re-tune the window length and K-weighting filters for a new rate
+ *
+ * Only while no block is being processed (audio_rate_set, with the I/O task parked).
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void level_meter_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * Meter one block leaving the chain (audio task only)
+ *
+ * @param buffer Left-justified 32-bit I2S words (interleaved stereo)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void level_meter_process(const int32_t *buffer, int num_samples);
+
+/**
+ * Report the gain reduction of one block per band (audio task only)
+ *
+ * Folded into the largest reduction of the current window; call before
+ * level_meter_process for the same block.
+ *
+ * @param reduction_db Gain reduction per band, dB (positive)
+ * @param bands Number of bands (at most LEVEL_METER_BANDS)
+ */
+void level_meter_band_reduction(const float *reduction_db, int bands);
+
+#else
+
+static inline void level_meter_init(uint32_t sample_rate) { (void)sample_rate; }
+static inline void level_meter_set_sample_rate(uint32_t sample_rate) { (void)sample_rate; }
+static inline void level_meter_process(const int32_t *buffer, int num_samples) { (void)buffer; (void)num_samples; }
+static inline void level_meter_band_reduction(const float *reduction_db, int bands) { (void)reduction_db; (void)bands; }
+
+#endif
+
+/**
+ * Clear the peak hold and clip counters (takes effect at the next block)
+ */
+void level_meter_reset(void);
+
+/**
+ * Copy the levels of the last completed window
+ *
+ * Never blocks the audio task; retries if a window was published during the
+ * copy. Before the first window every level is LEVEL_METER_FLOOR_DB.
+ *
+ * @param snapshot Destination
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if the meter is compiled out,
+ *         ESP_ERR_TIMEOUT if no consistent copy could be taken
+ */
+esp_err_t level_meter_get_snapshot(level_meter_snapshot_t *snapshot);
+
+#endif // LEVEL_METER_H
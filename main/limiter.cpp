@@ -3,62 +3,86 @@
 #include <math.h>
 #include <nvs.h>
 #include "esp_log.h"
+#include "sdkconfig.h"
+#include "dsp_perf.h"
+#include "dsp_tables.h"
 
 // NVS storage keys
 #define NVS_NAMESPACE "limiter_set"
 #define NVS_KEY_ENABLED "enabled"
 #define NVS_KEY_THRESHOLD "threshold"
+#define NVS_KEY_TRUE_PEAK "true_peak"
 
 static const char *TAG = "LIMITER";
 
+// ITU-R BS.1770-4 Annex 2 true-peak interpolator: 48-tap 4x polyphase FIR,
+// one 12-tap phase per output position. Each phase has unity DC gain; phases
+// 2 and 3 are phases 1 and 0 reversed.
+static const float s_tp_coeffs[LIMITER_TP_PHASES][LIMITER_TP_TAPS] DSP_HOT_RODATA = {
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+      -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+       0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+      -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+       0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+      -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+       0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+      -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+       0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
 // Convert dB to linear
 static inline float db_to_linear(float db) {
-    return powf(10.0f, db / 20.0f);
-}
-
-// Convert linear to dB
-static inline float linear_to_db(float linear) {
-    return 20.0f * log10f(linear);
-}
-
-// Fast approximation of maximum absolute value
-static inline float fast_abs_max(int32_t a, int32_t b) {
-    // Use integer absolute to avoid unnecessary float ops per-sample
-    uint32_t ua = (a < 0) ? (uint32_t)(-a) : (uint32_t)a;
-    uint32_t ub = (b < 0) ? (uint32_t)(-b) : (uint32_t)b;
-    uint32_t m = (ua > ub) ? ua : ub;
-    return (float)m;
+    return dsp_db_to_linear(db);
 }
 
-void limiter_init(limiter_t *limiter, uint32_t sample_rate)
+// Lookahead length and envelope time constants for a sample rate
+static void compute_timing(limiter_t *limiter, limiter_params_t *params, uint32_t sample_rate)
 {
-    memset(limiter, 0, sizeof(limiter_t));
-    
-    // Set default threshold
-    limiter->threshold_db = LIMITER_THRESHOLD_DB;
-    limiter->threshold = db_to_linear(LIMITER_THRESHOLD_DB);
-    
     // Calculate lookahead buffer size (in samples, stereo)
     // lookahead_ms * sample_rate * 2 channels / 1000
     limiter->lookahead_samples = (int)((LIMITER_LOOKAHEAD_MS * sample_rate * 2.0f) / 1000.0f);
     if (limiter->lookahead_samples > MAX_LOOKAHEAD_SAMPLES) {
         limiter->lookahead_samples = MAX_LOOKAHEAD_SAMPLES;
     }
+    // Whole stereo frames (441 samples at 44.1 kHz)
+    limiter->lookahead_samples &= ~1;
     
     // Calculate attack coefficient
     // attack_coeff = exp(-1 / (attack_time_sec * sample_rate))
     float attack_time_sec = LIMITER_ATTACK_MS / 1000.0f;
-    limiter->attack_coeff = expf(-1.0f / (attack_time_sec * sample_rate));
+    params->attack_coeff = expf(-1.0f / (attack_time_sec * sample_rate));
     
     // Calculate release coefficient
     float release_time_sec = LIMITER_RELEASE_MS / 1000.0f;
-    limiter->release_coeff = expf(-1.0f / (release_time_sec * sample_rate));
+    params->release_coeff = expf(-1.0f / (release_time_sec * sample_rate));
+}
+
+void limiter_init(limiter_t *limiter, uint32_t sample_rate)
+{
+    memset(limiter, 0, sizeof(limiter_t));
+    coeff_bank_reset(&limiter->bank);
+    limiter_params_t *params = &limiter->params[0];
+    
+    // Set default threshold
+    limiter->threshold_db = LIMITER_THRESHOLD_DB;
+    limiter->threshold = db_to_linear(LIMITER_THRESHOLD_DB);
+    params->threshold_scaled = limiter->threshold * LIMITER_FULL_SCALE;
+    
+    // Lookahead length and envelope time constants
+    compute_timing(limiter, params, sample_rate);
     
     // Initialize envelope to 1.0 (no gain reduction)
     limiter->envelope = 1.0f;
     limiter->write_index = 0;
     
     limiter->enabled = true;
+#ifdef CONFIG_LIMITER_TRUE_PEAK
+    limiter->true_peak = true;
+#endif
+    params->true_peak = limiter->true_peak;
     limiter->peak_reduction_db = 0.0f;
     limiter->clip_prevented_count = 0;
     // initialize throttling counters
@@ -72,125 +96,248 @@ void limiter_init(limiter_t *limiter, uint32_t sample_rate)
     ESP_LOGI(TAG, "Limiter initialized:");
     ESP_LOGI(TAG, "  Threshold: %.1f dB", limiter->threshold_db);
     ESP_LOGI(TAG, "  Lookahead: %.1f ms (%d samples)", LIMITER_LOOKAHEAD_MS, limiter->lookahead_samples);
-    ESP_LOGI(TAG, "  Attack: %.1f ms (coeff: %.6f)", LIMITER_ATTACK_MS, limiter->attack_coeff);
-    ESP_LOGI(TAG, "  Release: %.1f ms (coeff: %.6f)", LIMITER_RELEASE_MS, limiter->release_coeff);
+    ESP_LOGI(TAG, "  Attack: %.1f ms (coeff: %.6f)", LIMITER_ATTACK_MS, params->attack_coeff);
+    ESP_LOGI(TAG, "  Release: %.1f ms (coeff: %.6f)", LIMITER_RELEASE_MS, params->release_coeff);
+    ESP_LOGI(TAG, "  Detection: %s", limiter->true_peak ? "true peak (4x)" : "sample peak");
 }
 
-void limiter_process(limiter_t *limiter, int32_t *buffer, int num_samples)
+float DSP_HOT limiter_true_peak(limiter_t *limiter, float left, float right)
 {
-    if (!limiter->enabled) {
-        return;  // Bypass
+    // Newest sample first; every sample is stored twice so that the taps
+    // h[pos] .. h[pos + LIMITER_TP_TAPS - 1] never wrap
+    int pos = limiter->tp_pos - 1;
+    if (pos < 0) {
+        pos = LIMITER_TP_TAPS - 1;
     }
+    limiter->tp_pos = pos;
+
+    float *hl = &limiter->tp_history[0][pos];
+    float *hr = &limiter->tp_history[1][pos];
+    hl[0] = hl[LIMITER_TP_TAPS] = left;
+    hr[0] = hr[LIMITER_TP_TAPS] = right;
+
+    float peak = fmaxf(fabsf(left), fabsf(right));
+    for (int phase = 0; phase < LIMITER_TP_PHASES; phase++) {
+        const float *c = s_tp_coeffs[phase];
+        float yl = 0.0f;
+        float yr = 0.0f;
+        for (int j = 0; j < LIMITER_TP_TAPS; j++) {
+            yl += c[j] * hl[j];
+            yr += c[j] * hr[j];
+        }
+        peak = fmaxf(peak, fmaxf(fabsf(yl), fabsf(yr)));
+    }
+    return peak;
+}
 
-    // Processing runs on right-justified 24-bit samples (audio was >> 8 in the task),
-    // so treat full-scale as 24-bit (2^23). This ensures the threshold comparison
-    // matches the scale seen by the limiter when the buffer is processed.
-    const float FULL_SCALE = 8388608.0f;  // 2^23
-    const float THRESHOLD_LINEAR = limiter->threshold * FULL_SCALE;
-
-    // Minimum allowed envelope to avoid log10f(0) and NaNs
-    const float MIN_ENVELOPE = 1e-8f;
+// A block needs no gain computation when no reduction is in progress and
+// nothing above the threshold is in the delay line or the block; the frame
+// kernel would then only delay it
+static DSP_HOT_INLINE bool block_is_idle(const limiter_t *limiter, const limiter_params_t *params, float block_peak)
+{
+    return limiter->envelope == 1.0f && limiter->peak_count == 0 &&
+           block_peak <= params->threshold_scaled;
+}
 
-    // Throttle expensive stats updates: compute dB only every N changes
-    const uint16_t STATS_UPDATE_INTERVAL = 16;
+// Swap the block through the delay line
+static void DSP_HOT delay_block(limiter_t *limiter, int32_t *buffer, int num_samples)
+{
+    int index = limiter->write_index;
+    for (int i = 0; i < num_samples; i++) {
+        const int32_t delayed = limiter->lookahead_buffer[index];
+        limiter->lookahead_buffer[index] = buffer[i];
+        buffer[i] = delayed;
+        if (++index >= limiter->lookahead_samples) {
+            index = 0;
+        }
+    }
+    limiter->write_index = index;
+    limiter->frame_count += num_samples / 2;
+}
 
-    // Process samples
-    for (int i = 0; i < num_samples; i += 2) {
-        // Read from lookahead buffer (this is our delayed output)
-        int32_t delayed_left = limiter->lookahead_buffer[limiter->write_index];
-        int32_t delayed_right = limiter->lookahead_buffer[limiter->write_index + 1];
+static void DSP_HOT delay_block_f32(limiter_t *limiter, float *buffer, int num_samples)
+{
+    int index = limiter->write_index;
+    for (int i = 0; i < num_samples; i++) {
+        const float delayed = limiter->lookahead_f32[index];
+        limiter->lookahead_f32[index] = buffer[i];
+        buffer[i] = delayed;
+        if (++index >= limiter->lookahead_samples) {
+            index = 0;
+        }
+    }
+    limiter->write_index = index;
+    limiter->frame_count += num_samples / 2;
+}
 
-        // Store current input in lookahead buffer
-        limiter->lookahead_buffer[limiter->write_index] = buffer[i];
-        limiter->lookahead_buffer[limiter->write_index + 1] = buffer[i + 1];
+// True-peak detection, in passes of up to LIMITER_SCAN_FRAMES: the sidechain
+// runs over the whole pass first (timed for the profiler), then the pass is
+// either delayed or limited with the precomputed peaks
+static void DSP_HOT process_true_peak(limiter_t *limiter, const limiter_params_t *params,
+                                      int32_t *buffer, int num_samples)
+{
+    uint32_t cycles = 0;
+
+    for (int offset = 0; offset < num_samples; offset += 2 * LIMITER_SCAN_FRAMES) {
+        int32_t *pass = buffer + offset;
+        const int n = (num_samples - offset < 2 * LIMITER_SCAN_FRAMES) ?
+                      num_samples - offset : 2 * LIMITER_SCAN_FRAMES;
+
+        const uint32_t t = dsp_perf_now();
+        float pass_peak = 0.0f;
+        for (int i = 0; i < n; i += 2) {
+            const float peak = limiter_true_peak(limiter, (float)pass[i], (float)pass[i + 1]);
+            limiter->tp_peaks[i / 2] = peak;
+            pass_peak = fmaxf(pass_peak, peak);
+        }
+        cycles += dsp_perf_now() - t;
 
-        // Advance write index (circular buffer)
-        limiter->write_index += 2;
-        if (limiter->write_index >= limiter->lookahead_samples) {
-            limiter->write_index = 0;
+        if (block_is_idle(limiter, params, pass_peak)) {
+            delay_block(limiter, pass, n);
+        } else {
+            for (int i = 0; i < n; i += 2) {
+                limiter_apply_frame(limiter, params, &pass[i], &pass[i + 1], limiter->tp_peaks[i / 2]);
+            }
         }
+    }
 
-        // Detect peak of current input (before delay)
-        float peak = fast_abs_max(buffer[i], buffer[i + 1]);
+    limiter->tp_cycles = cycles;
+}
 
-        // Calculate desired gain (protect against divide-by-zero)
-        float desired_gain = 1.0f;
-        if (peak > THRESHOLD_LINEAR && peak > 0.0f) {
-            desired_gain = THRESHOLD_LINEAR / peak;
-            if (desired_gain < MIN_ENVELOPE) desired_gain = MIN_ENVELOPE;
-            limiter->clip_prevented_count++;
+static void DSP_HOT process_true_peak_f32(limiter_t *limiter, const limiter_params_t *params,
+                                          float *buffer, int num_samples)
+{
+    uint32_t cycles = 0;
+
+    for (int offset = 0; offset < num_samples; offset += 2 * LIMITER_SCAN_FRAMES) {
+        float *pass = buffer + offset;
+        const int n = (num_samples - offset < 2 * LIMITER_SCAN_FRAMES) ?
+                      num_samples - offset : 2 * LIMITER_SCAN_FRAMES;
+
+        const uint32_t t = dsp_perf_now();
+        float pass_peak = 0.0f;
+        for (int i = 0; i < n; i += 2) {
+            const float peak = limiter_true_peak(limiter, pass[i], pass[i + 1]);
+            limiter->tp_peaks[i / 2] = peak;
+            pass_peak = fmaxf(pass_peak, peak);
         }
+        cycles += dsp_perf_now() - t;
 
-        // Smooth envelope follower
-        float prev_envelope = limiter->envelope;
-        if (desired_gain < limiter->envelope) {
-            // Attack: Fast reduction
-            limiter->envelope = limiter->attack_coeff * limiter->envelope + 
-                               (1.0f - limiter->attack_coeff) * desired_gain;
+        if (block_is_idle(limiter, params, pass_peak)) {
+            delay_block_f32(limiter, pass, n);
         } else {
-            // Release: Slow recovery
-            limiter->envelope = limiter->release_coeff * limiter->envelope + 
-                               (1.0f - limiter->release_coeff) * desired_gain;
+            for (int i = 0; i < n; i += 2) {
+                limiter_apply_frame_f32(limiter, params, &pass[i], &pass[i + 1], limiter->tp_peaks[i / 2]);
+            }
         }
+    }
 
-        // Ensure envelope never becomes zero or NaN
-        if (!isfinite(limiter->envelope) || limiter->envelope < MIN_ENVELOPE) {
-            limiter->envelope = MIN_ENVELOPE;
-        }
+    limiter->tp_cycles = cycles;
+}
 
-        // Track peak reduction for monitoring only when envelope changed noticeably
-        if (fabsf(prev_envelope - limiter->envelope) > 1e-6f) {
-            limiter->stats_update_counter++;
-            if (limiter->stats_update_counter >= STATS_UPDATE_INTERVAL) {
-                limiter->stats_update_counter = 0;
-                // update minimal envelope and convert to dB (infrequent)
-                if (limiter->envelope < limiter->min_envelope) {
-                    limiter->min_envelope = limiter->envelope;
-                    float reduction_db = linear_to_db(limiter->min_envelope);
-                    if (reduction_db < limiter->peak_reduction_db) {
-                        limiter->peak_reduction_db = reduction_db;
-                    }
-                }
-            }
+void DSP_HOT limiter_process(limiter_t *limiter, int32_t *buffer, int num_samples)
+{
+    limiter->tp_cycles = 0;
+    if (!limiter->enabled) {
+        return;  // Bypass
+    }
+
+    const limiter_params_t *params = limiter_begin_block(limiter);
+
+    if (params->true_peak) {
+        process_true_peak(limiter, params, buffer, num_samples);
+        limiter_end_block(limiter);
+        return;
+    }
+
+    // Pre-scan: most blocks are well below the threshold
+    uint32_t block_peak = 0;
+    for (int i = 0; i < num_samples; i++) {
+        uint32_t a = (buffer[i] < 0) ? (uint32_t)(-buffer[i]) : (uint32_t)buffer[i];
+        block_peak = (a > block_peak) ? a : block_peak;
+    }
+
+    if (block_is_idle(limiter, params, (float)block_peak)) {
+        delay_block(limiter, buffer, num_samples);
+    } else {
+        // Process samples
+        for (int i = 0; i < num_samples; i += 2) {
+            limiter_process_frame(limiter, params, &buffer[i], &buffer[i + 1]);
         }
+    }
 
-        // Invoke trigger callback when limiter begins to reduce gain (transition)
-        // We consider the limiter 'triggered' if envelope becomes noticeably < 0.999
-        bool now_triggered = (limiter->envelope < 0.999f);
-        if (!limiter->is_triggered && now_triggered) {
-            limiter->is_triggered = true;
-            if (limiter->trigger_cb) {
-                // Call user callback; avoid heavy work here
-                limiter->trigger_cb(limiter, limiter->trigger_user_ctx);
-            }
-        } else if (limiter->is_triggered && !now_triggered) {
-            // Reset triggered state when envelope recovers
-            limiter->is_triggered = false;
+    limiter_end_block(limiter);
+}
+
+void DSP_HOT limiter_process_f32(limiter_t *limiter, float *buffer, int num_samples)
+{
+    limiter->tp_cycles = 0;
+    if (!limiter->enabled) {
+        return;  // Bypass
+    }
+
+    const limiter_params_t *params = limiter_begin_block(limiter);
+
+    if (params->true_peak) {
+        process_true_peak_f32(limiter, params, buffer, num_samples);
+        limiter_end_block(limiter);
+        return;
+    }
+
+    float block_peak = 0.0f;
+    for (int i = 0; i < num_samples; i++) {
+        block_peak = fmaxf(block_peak, fabsf(buffer[i]));
+    }
+
+    if (block_is_idle(limiter, params, block_peak)) {
+        delay_block_f32(limiter, buffer, num_samples);
+    } else {
+        for (int i = 0; i < num_samples; i += 2) {
+            limiter_process_frame_f32(limiter, params, &buffer[i], &buffer[i + 1]);
         }
+    }
 
-        // Apply gain to delayed signal using Q16 multiplier (faster integer multiply)
-        int32_t gain_q16 = (int32_t)(limiter->envelope * 65536.0f + 0.5f);
-        int64_t output_left = ((int64_t)delayed_left * (int64_t)gain_q16) >> 16;
-        int64_t output_right = ((int64_t)delayed_right * (int64_t)gain_q16) >> 16;
+    limiter_end_block(limiter);
+}
 
-        // Clamp to prevent overflow (safety)
-        if (output_left > 2147483647LL) output_left = 2147483647LL;
-        if (output_left < -2147483648LL) output_left = -2147483648LL;
-        if (output_right > 2147483647LL) output_right = 2147483647LL;
-        if (output_right < -2147483648LL) output_right = -2147483648LL;
+DSP_HOT const limiter_params_t *limiter_begin_block(limiter_t *limiter)
+{
+    if (limiter->reset_pending) {
+        limiter->reset_pending = false;
+        memset(limiter->lookahead_buffer, 0, sizeof(limiter->lookahead_buffer));
+        memset(limiter->lookahead_f32, 0, sizeof(limiter->lookahead_f32));
+        limiter->write_index = 0;
+        limiter->peak_head = 0;
+        limiter->peak_count = 0;
+        limiter->frame_count = 0;
+        limiter->envelope = 1.0f;
+        limiter->stats_update_counter = 0;
+        limiter->min_envelope = 1.0f;
+        limiter->tp_active = false;
+    }
+    const limiter_params_t *params = &limiter->params[coeff_bank_acquire(&limiter->bank)];
 
-        buffer[i] = (int32_t)output_left;
-        buffer[i + 1] = (int32_t)output_right;
+    // The interpolator history is stale after a block without it
+    if (params->true_peak && !limiter->tp_active) {
+        memset(limiter->tp_history, 0, sizeof(limiter->tp_history));
+        limiter->tp_pos = 0;
     }
+    limiter->tp_active = params->true_peak;
+    return params;
+}
+
+void DSP_HOT limiter_end_block(limiter_t *limiter)
+{
+    coeff_bank_release(&limiter->bank);
 }
 
 void limiter_set_enabled(limiter_t *limiter, bool enabled)
 {
-    limiter->enabled = enabled;
+    coeff_bank_set_flag(&limiter->enabled, enabled);
     if (enabled) {
-        ESP_LOGI(TAG, "Limiter enabled");
+        ESP_LOGD(TAG, "Limiter enabled");
     } else {
-        ESP_LOGI(TAG, "Limiter bypassed");
+        ESP_LOGD(TAG, "Limiter bypassed");
     }
 }
 
@@ -210,25 +357,58 @@ bool limiter_set_threshold(limiter_t *limiter, float threshold_db)
     limiter->threshold_db = threshold_db;
     limiter->threshold = db_to_linear(threshold_db);
     
-    ESP_LOGI(TAG, "Threshold set to %.1f dB (linear: %.4f)", threshold_db, limiter->threshold);
+    // Publish to the audio path (threshold on the 24-bit processing scale)
+    limiter_params_t *params = (limiter_params_t *)coeff_bank_begin_write(
+        &limiter->bank, limiter->params, sizeof(limiter_params_t));
+    params->threshold_scaled = limiter->threshold * LIMITER_FULL_SCALE;
+    coeff_bank_publish(&limiter->bank);
+    
+    ESP_LOGD(TAG, "Threshold set to %.1f dB (linear: %.4f)", threshold_db, limiter->threshold);
     return true;
 }
 
+void limiter_set_true_peak(limiter_t *limiter, bool enabled)
+{
+    limiter->true_peak = enabled;
+    
+    limiter_params_t *params = (limiter_params_t *)coeff_bank_begin_write(
+        &limiter->bank, limiter->params, sizeof(limiter_params_t));
+    params->true_peak = enabled;
+    coeff_bank_publish(&limiter->bank);
+    
+    ESP_LOGD(TAG, "Detection set to %s", enabled ? "true peak (4x)" : "sample peak");
+}
+
+bool limiter_get_true_peak(limiter_t *limiter)
+{
+    return limiter->true_peak;
+}
+
 float limiter_get_threshold(limiter_t *limiter)
 {
     return limiter->threshold_db;
 }
 
+void limiter_set_sample_rate(limiter_t *limiter, uint32_t sample_rate)
+{
+    limiter_params_t *p = (limiter_params_t *)coeff_bank_begin_write(
+        &limiter->bank, limiter->params, sizeof(limiter_params_t));
+    compute_timing(limiter, p, sample_rate);
+    coeff_bank_publish(&limiter->bank);
+    
+    // The delay line changes length
+    limiter->reset_pending = true;
+    
+    ESP_LOGI(TAG, "Lookahead %d samples at %lu Hz", limiter->lookahead_samples, (unsigned long)sample_rate);
+}
+
 void limiter_reset(limiter_t *limiter)
 {
-    // Clear lookahead buffer
-    memset(limiter->lookahead_buffer, 0, sizeof(limiter->lookahead_buffer));
-    limiter->write_index = 0;
-    limiter->envelope = 1.0f;
-    limiter->stats_update_counter = 0;
-    limiter->min_envelope = 1.0f;
+    // Lookahead buffer and envelope belong to the audio task; it clears them
+    // at its next block
+    coeff_bank_set_flag(&limiter->reset_pending, true);
     
-    ESP_LOGI(TAG, "Limiter state reset");
+    ESP_LOGD(TAG, "Limiter state reset");
 }
 
 float limiter_get_peak_reduction(limiter_t *limiter)
@@ -248,44 +428,46 @@ void limiter_reset_stats(limiter_t *limiter)
     ESP_LOGI(TAG, "Statistics reset");
 }
 
-esp_err_t limiter_save_settings(limiter_t *limiter)
+void limiter_get_settings(const limiter_t *limiter, limiter_settings_t *settings)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-    
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    // Save enabled state
-    err = nvs_set_u8(nvs_handle, NVS_KEY_ENABLED, limiter->enabled ? 1 : 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save enabled state: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
+    memset(settings, 0, sizeof(*settings));
+    settings->threshold_db = limiter->threshold_db;
+    settings->enabled = limiter->enabled ? 1 : 0;
+    settings->true_peak = limiter->true_peak ? 1 : 0;
+}
+
+void limiter_apply_settings(limiter_t *limiter, const limiter_settings_t *settings)
+{
+    limiter_set_threshold(limiter, settings->threshold_db);
+    limiter_set_true_peak(limiter, settings->true_peak != 0);
+    coeff_bank_set_flag(&limiter->enabled, settings->enabled != 0);
+}
+
+void limiter_bake_params(const limiter_settings_t *settings, limiter_params_t *params)
+{
+    float threshold_db = settings->threshold_db;
+    if (threshold_db < -12.0f) threshold_db = -12.0f;
+    if (threshold_db > 0.0f) threshold_db = 0.0f;
     
-    // Save threshold
-    err = nvs_set_i32(nvs_handle, NVS_KEY_THRESHOLD, (int32_t)(limiter->threshold_db * 100.0f));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save threshold: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
+    memset(params, 0, sizeof(*params));
+    params->threshold_scaled = db_to_linear(threshold_db) * LIMITER_FULL_SCALE;
+    params->true_peak = (settings->true_peak != 0);
+}
+
+void limiter_apply_baked(limiter_t *limiter, const limiter_settings_t *settings,
+                         const limiter_params_t *params)
+{
+    limiter->threshold_db = settings->threshold_db;
+    limiter->threshold = params->threshold_scaled / LIMITER_FULL_SCALE;
+    limiter->true_peak = params->true_peak;
     
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Settings saved to NVS");
-    }
+    limiter_params_t *p = (limiter_params_t *)coeff_bank_begin_write(
+        &limiter->bank, limiter->params, sizeof(limiter_params_t));
+    p->threshold_scaled = params->threshold_scaled;
+    p->true_peak = params->true_peak;
+    coeff_bank_publish(&limiter->bank);
     
-    nvs_close(nvs_handle);
-    return err;
+    coeff_bank_set_flag(&limiter->enabled, settings->enabled != 0);
 }
 
 esp_err_t limiter_load_settings(limiter_t *limiter, uint32_t sample_rate)
@@ -315,11 +497,19 @@ esp_err_t limiter_load_settings(limiter_t *limiter, uint32_t sample_rate)
         limiter_set_threshold(limiter, threshold_db);
     }
     
+    // Load detection mode
+    uint8_t true_peak = 0;
+    err = nvs_get_u8(nvs_handle, NVS_KEY_TRUE_PEAK, &true_peak);
+    if (err == ESP_OK) {
+        limiter_set_true_peak(limiter, true_peak != 0);
+    }
+    
     nvs_close(nvs_handle);
     
     ESP_LOGI(TAG, "Settings loaded from NVS");
     ESP_LOGI(TAG, "  Enabled: %s", limiter->enabled ? "yes" : "no");
     ESP_LOGI(TAG, "  Threshold: %.1f dB", limiter->threshold_db);
+    ESP_LOGI(TAG, "  True peak: %s", limiter->true_peak ? "on" : "off");
     
     return ESP_OK;
 }
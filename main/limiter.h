@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <math.h>
 #include "esp_err.h"
+#include "coeff_bank.h"
+#include "dsp_attr.h"
 
 // Limiter configuration
 #define LIMITER_LOOKAHEAD_MS    5.0f       // Lookahead time in milliseconds
@@ -11,9 +14,33 @@
 #define LIMITER_RELEASE_MS      50.0f      // Release time in milliseconds
 #define LIMITER_THRESHOLD_DB    -0.5f      // Threshold in dB (slightly below 0dBFS)
 
-// Maximum lookahead buffer size (calculated for 48kHz)
-// 5ms at 48kHz stereo = 5 * 48 * 2 = 480 samples
-#define MAX_LOOKAHEAD_SAMPLES   512
+// Maximum lookahead buffer size (calculated for 192kHz, the highest rate)
+// 5ms at 192kHz stereo = 5 * 192 * 2 = 1920 samples
+#define MAX_LOOKAHEAD_SAMPLES   1920
+
+// Lookahead peak queue: every frame in the delay line plus the one leaving it
+#define LIMITER_PEAK_QUEUE_SIZE (MAX_LOOKAHEAD_SAMPLES / 2 + 1)
+
+// Processing runs on right-justified 24-bit samples (audio is >> 8 in the task),
+// so full-scale is 24-bit (2^23)
+#define LIMITER_FULL_SCALE      8388608.0f
+
+// Minimum allowed envelope to avoid log10f(0) and NaNs
+#define LIMITER_MIN_ENVELOPE    1e-8f
+
+// True-peak detection: ITU-R BS.1770 4x polyphase interpolator (48 taps)
+#define LIMITER_TP_PHASES       4
+#define LIMITER_TP_TAPS         12
+
+// Frames per sidechain pass in limiter_process (blocks are split if longer)
+#define LIMITER_SCAN_FRAMES     256
+
+// Releasing envelopes above this snap to unity (less than one Q16 gain step),
+// so that the idle fast paths take over again after limiting
+#define LIMITER_UNITY_SNAP      0.99999f
+
+// Throttle expensive stats updates: compute dB only every N changes
+#define LIMITER_STATS_UPDATE_INTERVAL 16
 
 // Forward declare struct name so callback can reference it
 typedef struct limiter_t limiter_t;
@@ -23,19 +50,41 @@ typedef struct limiter_t limiter_t;
 // @param user_ctx User-provided context pointer set when registering the callback
 typedef void (*limiter_trigger_cb_t)(limiter_t *limiter, void *user_ctx);
 
-// Limiter structure
-typedef struct limiter_t {
-    // Configuration
-    float threshold;                        // Linear threshold (0.0 to 1.0)
-    float threshold_db;                     // Threshold in dB
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
+typedef struct {
+    float threshold_scaled;                 // Threshold on the 24-bit scale (threshold * LIMITER_FULL_SCALE)
     float attack_coeff;                     // Attack coefficient for envelope follower
     float release_coeff;                    // Release coefficient for envelope follower
-    int lookahead_samples;                  // Lookahead buffer size in samples
-    
-    // State
+    bool true_peak;                         // Detect on the 4x oversampled sidechain
+} limiter_params_t;
+
+// Limiter structure (audio task fields first, see dsp_attr.h)
+typedef struct limiter_t {
+    limiter_params_t params[2];             // Published / shadow parameter sets
     float envelope;                         // Current gain reduction envelope
-    int32_t lookahead_buffer[MAX_LOOKAHEAD_SAMPLES];  // Circular buffer for lookahead
     int write_index;                        // Write position in circular buffer
+    int lookahead_samples;                  // Lookahead buffer size in samples
+    int32_t lookahead_buffer[MAX_LOOKAHEAD_SAMPLES] __attribute__((aligned(16)));  // Circular buffer for lookahead
+    float lookahead_f32[MAX_LOOKAHEAD_SAMPLES] __attribute__((aligned(16)));       // Lookahead buffer for the float32 chain
+    
+    // Lookahead peak detector: the frame peaks above the threshold that are
+    // still in the delay line, as a monotonic queue (peaks decreasing from
+    // the head, which is the oldest)
+    float peak_value[LIMITER_PEAK_QUEUE_SIZE] __attribute__((aligned(16)));    // Frame peak (24-bit scale)
+    uint32_t peak_frame[LIMITER_PEAK_QUEUE_SIZE];   // frame_count when it entered
+    int peak_head;                          // Index of the largest peak
+    int peak_count;                         // Queued peaks (0 = nothing to limit)
+    uint32_t frame_count;                   // Frames processed (detector clock, wraps)
+    
+    // True-peak sidechain (detection only, the audio is never resampled)
+    float tp_history[2][2 * LIMITER_TP_TAPS] __attribute__((aligned(16)));    // Per channel, doubled so the taps are contiguous
+    int tp_pos;                             // Newest sample in tp_history
+    bool tp_active;                         // History valid (detection was on last block)
+    float tp_peaks[LIMITER_SCAN_FRAMES];    // Per-frame true peaks of the current pass
+    uint32_t tp_cycles;                     // Sidechain cycles in the last block (staged/float)
+    
+    coeff_bank_t bank;                      // Publish state for params
+    volatile bool reset_pending;            // Clear lookahead/envelope at next block
     
     // Statistics
     float peak_reduction_db;                // Maximum reduction applied (for monitoring)
@@ -44,13 +93,26 @@ typedef struct limiter_t {
     uint16_t stats_update_counter;
     float min_envelope;                     // Minimum envelope observed (linear)
     
-    bool enabled;                           // Enable/disable limiter
     // Trigger callback (optional)
     limiter_trigger_cb_t trigger_cb;        // Called when limiter starts limiting
     void *trigger_user_ctx;                 // User context passed to callback
     bool is_triggered;                      // Internal state: currently limiting
+    
+    // Configuration (control side)
+    float threshold;                        // Linear threshold (0.0 to 1.0)
+    float threshold_db;                     // Threshold in dB
+    bool true_peak;                         // True-peak detection requested
+    bool enabled;                           // Enable/disable limiter
 } limiter_t;
 
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float threshold_db;                     // Threshold in dB
+    uint8_t enabled;                        // Limiter enabled
+    uint8_t true_peak;                      // True-peak detection
+    uint8_t reserved[2];
+} limiter_settings_t;
+
 /**
  * Initialize limiter with default settings
  * 
@@ -62,12 +124,339 @@ void limiter_init(limiter_t *limiter, uint32_t sample_rate);
 /**
  * Process audio through limiter
  * 
+ * Blocks with nothing to limit (no reduction in progress, nothing above the
+ * threshold in the block or the delay line) only pass through the delay.
+ * 
  * @param limiter Pointer to limiter structure
  * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
  * @param num_samples Number of samples (total, not per channel)
  */
 void limiter_process(limiter_t *limiter, int32_t *buffer, int num_samples);
 
+/**
+ * Process a float block through the limiter (float32 chain)
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param buffer Audio buffer (interleaved stereo, 24-bit scale)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void limiter_process_f32(limiter_t *limiter, float *buffer, int num_samples);
+
+/**
+ * Feed the peak of one input frame to the lookahead detector
+ * 
+ * Returns the largest peak among the frames in the delay line, including the
+ * one being output now, in amortized O(1): a new peak drops every smaller
+ * peak queued behind it (they can never be the maximum again), and the head
+ * leaves once its frame has left the delay. Only peaks above the threshold
+ * are queued; a lowered threshold applies to frames that enter after the
+ * change.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param peak Absolute peak of the frame on the 24-bit scale
+ * @return Largest peak in the lookahead window, 0 if none is above threshold
+ */
+static DSP_HOT_INLINE float limiter_detect_peak(limiter_t *limiter, const limiter_params_t *params, float peak)
+{
+    const uint32_t frame = limiter->frame_count++;
+
+    if (peak > params->threshold_scaled) {
+        limiter->clip_prevented_count++;
+
+        while (limiter->peak_count > 0) {
+            int back = limiter->peak_head + limiter->peak_count - 1;
+            if (back >= LIMITER_PEAK_QUEUE_SIZE) back -= LIMITER_PEAK_QUEUE_SIZE;
+            if (limiter->peak_value[back] > peak) break;
+            limiter->peak_count--;
+        }
+
+        int tail = limiter->peak_head + limiter->peak_count;
+        if (tail >= LIMITER_PEAK_QUEUE_SIZE) tail -= LIMITER_PEAK_QUEUE_SIZE;
+        limiter->peak_value[tail] = peak;
+        limiter->peak_frame[tail] = frame;
+        limiter->peak_count++;
+    }
+
+    if (limiter->peak_count == 0) {
+        return 0.0f;
+    }
+
+    // A frame is output lookahead_samples / 2 frames after it entered; the
+    // gain must cover it until then
+    const uint32_t window = (uint32_t)(limiter->lookahead_samples / 2);
+    if (frame - limiter->peak_frame[limiter->peak_head] > window) {
+        limiter->peak_head++;
+        if (limiter->peak_head >= LIMITER_PEAK_QUEUE_SIZE) limiter->peak_head = 0;
+        limiter->peak_count--;
+        if (limiter->peak_count == 0) {
+            return 0.0f;
+        }
+    }
+    return limiter->peak_value[limiter->peak_head];
+}
+
+/**
+ * Update the gain envelope from the lookahead window peak
+ * 
+ * Shared by the integer and float frame kernels; also keeps the statistics
+ * and fires the trigger callback. The attack (LIMITER_ATTACK_MS) settles
+ * well within the lookahead, so the gain is fully reduced before the peak
+ * leaves the delay.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param peak Peak returned by limiter_detect_peak
+ */
+static DSP_HOT_INLINE void limiter_update_envelope(limiter_t *limiter, const limiter_params_t *params, float peak)
+{
+    const float threshold_linear = params->threshold_scaled;
+
+    // Calculate desired gain (protect against divide-by-zero)
+    float desired_gain = 1.0f;
+    if (peak > threshold_linear && peak > 0.0f) {
+        desired_gain = threshold_linear / peak;
+        if (desired_gain < LIMITER_MIN_ENVELOPE) desired_gain = LIMITER_MIN_ENVELOPE;
+    }
+
+    // Smooth envelope follower
+    float prev_envelope = limiter->envelope;
+    if (desired_gain < limiter->envelope) {
+        // Attack: Fast reduction
+        limiter->envelope = params->attack_coeff * limiter->envelope + 
+                           (1.0f - params->attack_coeff) * desired_gain;
+    } else {
+        // Release: Slow recovery
+        limiter->envelope = params->release_coeff * limiter->envelope + 
+                           (1.0f - params->release_coeff) * desired_gain;
+        if (limiter->envelope > LIMITER_UNITY_SNAP) {
+            limiter->envelope = 1.0f;
+        }
+    }
+
+    // Ensure envelope never becomes zero or NaN
+    if (!isfinite(limiter->envelope) || limiter->envelope < LIMITER_MIN_ENVELOPE) {
+        limiter->envelope = LIMITER_MIN_ENVELOPE;
+    }
+
+    // Track peak reduction for monitoring only when envelope changed noticeably
+    if (fabsf(prev_envelope - limiter->envelope) > 1e-6f) {
+        limiter->stats_update_counter++;
+        if (limiter->stats_update_counter >= LIMITER_STATS_UPDATE_INTERVAL) {
+            limiter->stats_update_counter = 0;
+            // update minimal envelope and convert to dB (infrequent)
+            if (limiter->envelope < limiter->min_envelope) {
+                limiter->min_envelope = limiter->envelope;
+                float reduction_db = 20.0f * log10f(limiter->min_envelope);
+                if (reduction_db < limiter->peak_reduction_db) {
+                    limiter->peak_reduction_db = reduction_db;
+                }
+            }
+        }
+    }
+
+    // Invoke trigger callback when limiter begins to reduce gain (transition)
+    // We consider the limiter 'triggered' if envelope becomes noticeably < 0.999
+    bool now_triggered = (limiter->envelope < 0.999f);
+    if (!limiter->is_triggered && now_triggered) {
+        limiter->is_triggered = true;
+        if (limiter->trigger_cb) {
+            // Call user callback; avoid heavy work here
+            limiter->trigger_cb(limiter, limiter->trigger_user_ctx);
+        }
+    } else if (limiter->is_triggered && !now_triggered) {
+        // Reset triggered state when envelope recovers
+        limiter->is_triggered = false;
+    }
+}
+
+/**
+ * True peak of one stereo frame (4x oversampled, both channels)
+ * 
+ * Feeds the frame to the BS.1770 interpolator and returns the largest
+ * magnitude of the four interpolated phases and of the samples themselves.
+ * Out of line so that the staged, fused and float paths compute exactly the
+ * same peaks.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param left Left sample, 24-bit scale
+ * @param right Right sample, 24-bit scale
+ * @return True peak on the 24-bit scale
+ */
+float limiter_true_peak(limiter_t *limiter, float left, float right);
+
+/**
+ * Delay one stereo frame and apply the gain for its detection peak
+ * 
+ * Shared tail of limiter_process_frame and the block path of
+ * limiter_process, which computes the peaks in a separate sidechain pass.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param left Left sample (in/out)
+ * @param right Right sample (in/out)
+ * @param frame_peak Sample or true peak of the input frame (24-bit scale)
+ */
+static DSP_HOT_INLINE void limiter_apply_frame(limiter_t *limiter, const limiter_params_t *params,
+                                               int32_t *left, int32_t *right, float frame_peak)
+{
+    int32_t input_left = *left;
+    int32_t input_right = *right;
+
+    // Read from lookahead buffer (this is our delayed output)
+    int32_t delayed_left = limiter->lookahead_buffer[limiter->write_index];
+    int32_t delayed_right = limiter->lookahead_buffer[limiter->write_index + 1];
+
+    // Store current input in lookahead buffer
+    limiter->lookahead_buffer[limiter->write_index] = input_left;
+    limiter->lookahead_buffer[limiter->write_index + 1] = input_right;
+
+    // Advance write index (circular buffer)
+    limiter->write_index += 2;
+    if (limiter->write_index >= limiter->lookahead_samples) {
+        limiter->write_index = 0;
+    }
+
+    float peak = limiter_detect_peak(limiter, params, frame_peak);
+
+    // Nothing to limit in the window and no reduction left: pure delay
+    // (the envelope update and Q16 gain below would leave it unchanged)
+    if (peak == 0.0f && limiter->envelope == 1.0f) {
+        *left = delayed_left;
+        *right = delayed_right;
+        return;
+    }
+
+    limiter_update_envelope(limiter, params, peak);
+
+    // Apply gain to delayed signal using Q16 multiplier (faster integer multiply)
+    int32_t gain_q16 = (int32_t)(limiter->envelope * 65536.0f + 0.5f);
+    int64_t output_left = ((int64_t)delayed_left * (int64_t)gain_q16) >> 16;
+    int64_t output_right = ((int64_t)delayed_right * (int64_t)gain_q16) >> 16;
+
+    // Clamp to prevent overflow (safety)
+    if (output_left > 2147483647LL) output_left = 2147483647LL;
+    if (output_left < -2147483648LL) output_left = -2147483648LL;
+    if (output_right > 2147483647LL) output_right = 2147483647LL;
+    if (output_right < -2147483648LL) output_right = -2147483648LL;
+
+    *left = (int32_t)output_left;
+    *right = (int32_t)output_right;
+}
+
+/**
+ * Sample peak of one stereo frame
+ * 
+ * @param left Left sample
+ * @param right Right sample
+ * @return Larger magnitude as float
+ */
+static DSP_HOT_INLINE float limiter_sample_peak(int32_t left, int32_t right)
+{
+    // Use integer absolute to avoid unnecessary float ops per-sample
+    uint32_t ua = (left < 0) ? (uint32_t)(-left) : (uint32_t)left;
+    uint32_t ub = (right < 0) ? (uint32_t)(-right) : (uint32_t)right;
+    return (float)((ua > ub) ? ua : ub);
+}
+
+/**
+ * Process one stereo frame through the limiter
+ * 
+ * This is the per-frame kernel behind limiter_process, exposed so the fused
+ * DSP chain can run it without a separate pass over the buffer. Callers must
+ * check limiter->enabled themselves and bracket the block with
+ * limiter_begin_block / limiter_end_block.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param left Left sample (in/out)
+ * @param right Right sample (in/out)
+ */
+static DSP_HOT_INLINE void limiter_process_frame(limiter_t *limiter, const limiter_params_t *params,
+                                                 int32_t *left, int32_t *right)
+{
+    // Detect peak of current input (before delay)
+    const float peak = params->true_peak ? limiter_true_peak(limiter, (float)*left, (float)*right)
+                                         : limiter_sample_peak(*left, *right);
+    limiter_apply_frame(limiter, params, left, right, peak);
+}
+
+/**
+ * Delay one stereo frame and apply the gain for its detection peak (float32 chain)
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param left Left sample, 24-bit scale (in/out)
+ * @param right Right sample, 24-bit scale (in/out)
+ * @param frame_peak Sample or true peak of the input frame (24-bit scale)
+ */
+static DSP_HOT_INLINE void limiter_apply_frame_f32(limiter_t *limiter, const limiter_params_t *params,
+                                                   float *left, float *right, float frame_peak)
+{
+    const float input_left = *left;
+    const float input_right = *right;
+
+    // Read the delayed output and store the current input
+    const float delayed_left = limiter->lookahead_f32[limiter->write_index];
+    const float delayed_right = limiter->lookahead_f32[limiter->write_index + 1];
+    limiter->lookahead_f32[limiter->write_index] = input_left;
+    limiter->lookahead_f32[limiter->write_index + 1] = input_right;
+
+    limiter->write_index += 2;
+    if (limiter->write_index >= limiter->lookahead_samples) {
+        limiter->write_index = 0;
+    }
+
+    const float peak = limiter_detect_peak(limiter, params, frame_peak);
+    if (peak == 0.0f && limiter->envelope == 1.0f) {
+        *left = delayed_left;
+        *right = delayed_right;
+        return;
+    }
+
+    limiter_update_envelope(limiter, params, peak);
+
+    *left = delayed_left * limiter->envelope;
+    *right = delayed_right * limiter->envelope;
+}
+
+/**
+ * Process one stereo frame through the limiter (float32 chain)
+ * 
+ * Same envelope as limiter_process_frame; the delayed signal is scaled in
+ * float and is not clamped (the chain saturates once when converting back).
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param params Parameters returned by limiter_begin_block
+ * @param left Left sample, 24-bit scale (in/out)
+ * @param right Right sample, 24-bit scale (in/out)
+ */
+static DSP_HOT_INLINE void limiter_process_frame_f32(limiter_t *limiter, const limiter_params_t *params,
+                                                     float *left, float *right)
+{
+    const float peak = params->true_peak ? limiter_true_peak(limiter, *left, *right)
+                                         : fmaxf(fabsf(*left), fabsf(*right));
+    limiter_apply_frame_f32(limiter, params, left, right, peak);
+}
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ * 
+ * Also services a pending limiter_reset. Must be paired with
+ * limiter_end_block.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @return Parameters to use for this block
+ */
+const limiter_params_t *limiter_begin_block(limiter_t *limiter);
+
+/**
+ * Release the parameters latched by limiter_begin_block (audio task only)
+ * 
+ * @param limiter Pointer to limiter structure
+ */
+void limiter_end_block(limiter_t *limiter);
+
 /**
  * Enable or disable limiter
  * 
@@ -85,6 +474,25 @@ void limiter_set_enabled(limiter_t *limiter, bool enabled);
  */
 bool limiter_set_threshold(limiter_t *limiter, float threshold_db);
 
+/**
+ * Enable or disable true-peak (4x oversampled) detection
+ * 
+ * Takes effect at the next block. Costs about 100 multiply-adds per stereo
+ * frame on the detection path; the audio path is unchanged.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param enabled true to detect inter-sample peaks, false for sample peaks
+ */
+void limiter_set_true_peak(limiter_t *limiter, bool enabled);
+
+/**
+ * Get the detection mode
+ * 
+ * @param limiter Pointer to limiter structure
+ * @return true if true-peak detection is on
+ */
+bool limiter_get_true_peak(limiter_t *limiter);
+
 /**
  * Get current threshold value
  * 
@@ -93,9 +501,22 @@ bool limiter_set_threshold(limiter_t *limiter, float threshold_db);
  */
 float limiter_get_threshold(limiter_t *limiter);
 
+/**
+ * Recompute the lookahead and envelope time constants for a new sample rate
+ * 
+ * Only while the audio path is stopped (see audio_rate.h): the delay line
+ * changes length, and its state is cleared at the next block.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param sample_rate Sample rate in Hz (at most 192000)
+ */
+void limiter_set_sample_rate(limiter_t *limiter, uint32_t sample_rate);
+
 /**
  * Reset limiter state
  * 
+ * The reset is performed by the audio task at its next block boundary.
+ * 
  * @param limiter Pointer to limiter structure
  */
 void limiter_reset(limiter_t *limiter);
@@ -124,15 +545,48 @@ uint32_t limiter_get_clips_prevented(limiter_t *limiter);
 void limiter_reset_stats(limiter_t *limiter);
 
 /**
- * Save limiter settings to NVS
+ * Copy the persistent settings
  * 
  * @param limiter Pointer to limiter structure
- * @return ESP_OK on success, error code otherwise
+ * @param settings Destination
+ */
+void limiter_get_settings(const limiter_t *limiter, limiter_settings_t *settings);
+
+/**
+ * Apply persistent settings
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param settings Settings from limiter_get_settings
+ */
+void limiter_apply_settings(limiter_t *limiter, const limiter_settings_t *settings);
+
+/**
+ * Compute the threshold and detection parameters limiter_apply_settings
+ * would publish (the time constants depend on the sample rate only and are
+ * left zero)
+ * 
+ * @param settings Settings from limiter_get_settings (threshold clamped like limiter_set_threshold)
+ * @param params Destination
+ */
+void limiter_bake_params(const limiter_settings_t *settings, limiter_params_t *params);
+
+/**
+ * Apply settings with parameters baked by limiter_bake_params (see preset_bank.h)
+ * 
+ * Only the threshold and detection mode are taken from params. The enable
+ * flag goes through coeff_bank_set_flag, so inside a group it changes in
+ * the same block as the parameters.
+ * 
+ * @param limiter Pointer to limiter structure
+ * @param settings Settings the parameters were baked from
+ * @param params Baked parameters
  */
-esp_err_t limiter_save_settings(limiter_t *limiter);
+void limiter_apply_baked(limiter_t *limiter, const limiter_settings_t *settings,
+                         const limiter_params_t *params);
 
 /**
- * Load limiter settings from NVS
+ * Load limiter settings saved as separate NVS keys (firmware before the
+ * settings blob; used once to migrate)
  * 
  * @param limiter Pointer to limiter structure
  * @param sample_rate Sample rate in Hz (needed for recalculation)
@@ -4,12 +4,29 @@
 #include "pregain.h"
 #include "equalizer.h"
 #include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "preset_bank.h"
+#include "audio_tap.h"
+#include "persist.h"
+#include "dsp_perf.h"
+#include "level_meter.h"
+#include "spectrum.h"
+#include "audio_xrun.h"
+#include "dsp_control.h"
 #include "audio_config.h"
+#include "audio_rate.h"
+#include "telemetry.h"
 #include "mqtt_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <nvs.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
 
 static const char *TAG = "MQTT";
 
@@ -18,11 +35,24 @@ extern subsonic_t subsonic;
 extern pregain_t pregain;
 extern equalizer_t equalizer;
 extern limiter_t limiter;
+extern convolver_t convolver;
+extern crossover_t crossover;
+extern multiband_t multiband;
+extern delay_line_t delay_line;
 
 static esp_mqtt_client_handle_t s_mqtt_client = NULL;
 static bool s_is_connected = false;
 static char s_broker_uri[MQTT_BROKER_MAX_LEN] = {0};
 
+// Messages received since boot, published with the xrun state so that
+// dropouts can be matched against command traffic
+static volatile uint32_t s_rx_messages = 0;
+
+// Impulse response upload in progress (MQTT_TOPIC_CONV_IR arrives in
+// fragments; only the first one carries the topic)
+static bool s_ir_upload = false;
+static esp_err_t s_ir_result = ESP_OK;
+
 // NVS keys for MQTT configuration
 #define NVS_NAMESPACE   "mqtt_config"
 #define NVS_KEY_BROKER  "broker_uri"
@@ -76,130 +106,105 @@ static esp_err_t save_mqtt_broker(const char* broker_uri)
 }
 
 /**
- * Process MQTT command messages
+ * Feed one fragment of an impulse response upload to the convolver
+ *
+ * The payload is a convolver_ir_header_t followed by the taps (see
+ * convolver.h); it is far larger than the receive buffer, so the client
+ * delivers it in fragments that are written straight into the staging
+ * buffer. An empty payload clears the response and its flash copy.
  */
-static void process_mqtt_command(const char* topic, const char* data, int data_len)
+static void process_ir_fragment(const esp_mqtt_event_handle_t event)
 {
-    char value[128] = {0};
-    if (data_len > 0 && data_len < sizeof(value)) {
-        strncpy(value, data, data_len);
-        value[data_len] = '\0';
-    }
-    
-    ESP_LOGI(TAG, "Command: topic=%s, value=%s", topic, value);
-    
-    // Subsonic filter commands
-    if (strcmp(topic, MQTT_TOPIC_SUB_FREQ) == 0) {
-        float freq = atof(value);
-        if (subsonic_set_frequency(&subsonic, freq, SAMPLE_RATE)) {
-            subsonic_save_settings(&subsonic);
-            mqtt_manager_publish_subsonic_state();
-            ESP_LOGI(TAG, "Subsonic frequency set to %.1f Hz", freq);
-        }
-    }
-    else if (strcmp(topic, MQTT_TOPIC_SUB_ENABLE) == 0) {
-        bool enable = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-        subsonic_set_enabled(&subsonic, enable);
-        subsonic_save_settings(&subsonic);
-        mqtt_manager_publish_subsonic_state();
-        ESP_LOGI(TAG, "Subsonic filter %s", enable ? "enabled" : "disabled");
-    }
-    
-    // Pre-gain commands
-    else if (strcmp(topic, MQTT_TOPIC_GAIN_SET) == 0) {
-        float gain = atof(value);
-        if (pregain_set_gain(&pregain, gain)) {
-            pregain_save_settings(&pregain);
-            mqtt_manager_publish_pregain_state();
-            ESP_LOGI(TAG, "Pre-gain set to %.1f dB", gain);
-        }
-    }
-    else if (strcmp(topic, MQTT_TOPIC_GAIN_ENABLE) == 0) {
-        bool enable = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-        pregain_set_enabled(&pregain, enable);
-        pregain_save_settings(&pregain);
-        mqtt_manager_publish_pregain_state();
-        ESP_LOGI(TAG, "Pre-gain %s", enable ? "enabled" : "disabled");
-    }
-    
-    // Equalizer commands
-    else if (strncmp(topic, MQTT_TOPIC_EQ_BAND, strlen(MQTT_TOPIC_EQ_BAND)) == 0) {
-        // Topic format: esp-dsp/eq/band/<band_num>
-        const char* band_str = topic + strlen(MQTT_TOPIC_EQ_BAND);
-        if (*band_str == '/') {
-            int band = atoi(band_str + 1);
-            float gain = atof(value);
-            if (band >= 0 && band < 5) {
-                if (equalizer_set_band_gain(&equalizer, band, gain, SAMPLE_RATE)) {
-                    equalizer_save_settings(&equalizer);
-                    mqtt_manager_publish_eq_state();
-                    ESP_LOGI(TAG, "EQ band %d set to %.1f dB", band, gain);
-                }
-            }
-        }
-    }
-    else if (strcmp(topic, MQTT_TOPIC_EQ_ENABLE) == 0) {
-        bool enable = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-        equalizer_set_enabled(&equalizer, enable);
-        equalizer_save_settings(&equalizer);
-        mqtt_manager_publish_eq_state();
-        ESP_LOGI(TAG, "Equalizer %s", enable ? "enabled" : "disabled");
-    }
-    else if (strcmp(topic, MQTT_TOPIC_EQ_PRESET) == 0) {
-        // Apply preset
-        if (strcmp(value, "flat") == 0) {
-            for (int i = 0; i < 5; i++) {
-                equalizer_set_band_gain(&equalizer, i, 0.0f, SAMPLE_RATE);
+    const int offset = event->current_data_offset;
+    const int total = event->total_data_len;
+    const char *data = event->data;
+    int len = event->data_len;
+    const int header_len = (int)sizeof(convolver_ir_header_t);
+
+    if (offset == 0) {
+        if (total == 0) {
+            esp_err_t err = convolver_ir_clear(&convolver, true);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Impulse response not cleared: %s", esp_err_to_name(err));
             }
+            mqtt_manager_publish_conv_state();
+            return;
         }
-        else if (strcmp(value, "bass") == 0) {
-            equalizer_set_band_gain(&equalizer, 0, 6.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 1, 4.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 2, 0.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 3, 0.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 4, 0.0f, SAMPLE_RATE);
+        convolver_ir_header_t header;
+        if (len < header_len) {
+            ESP_LOGW(TAG, "Impulse response upload too short (%d bytes)", total);
+            return;
         }
-        else if (strcmp(value, "vocal") == 0) {
-            equalizer_set_band_gain(&equalizer, 0, -2.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 1, 0.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 2, 4.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 3, 3.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 4, -1.0f, SAMPLE_RATE);
+        memcpy(&header, data, sizeof(header));
+        s_ir_result = convolver_ir_begin(&convolver, &header);
+        if (s_ir_result == ESP_OK &&
+            (size_t)total != sizeof(header) + (size_t)header.taps * header.channels * sizeof(float)) {
+            s_ir_result = ESP_ERR_INVALID_SIZE;
         }
-        else if (strcmp(value, "rock") == 0) {
-            equalizer_set_band_gain(&equalizer, 0, 5.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 1, 3.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 2, -2.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 3, 2.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 4, 4.0f, SAMPLE_RATE);
+        s_ir_upload = true;
+        data += header_len;
+        len -= header_len;
+    } else if (!s_ir_upload) {
+        return;
+    }
+
+    if (s_ir_result == ESP_OK && len > 0) {
+        const int taps_offset = (offset == 0) ? 0 : offset - header_len;
+        s_ir_result = convolver_ir_write(&convolver, (uint32_t)taps_offset, data, (size_t)len);
+    }
+
+    if (offset + event->data_len >= total) {
+        s_ir_upload = false;
+        if (s_ir_result == ESP_OK) {
+            s_ir_result = convolver_ir_commit(&convolver, true);
+        } else {
+            convolver_ir_abort(&convolver);
         }
-        else if (strcmp(value, "jazz") == 0) {
-            equalizer_set_band_gain(&equalizer, 0, 3.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 1, 2.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 2, 0.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 3, 2.0f, SAMPLE_RATE);
-            equalizer_set_band_gain(&equalizer, 4, 3.0f, SAMPLE_RATE);
+        if (s_ir_result == ESP_OK) {
+            ESP_LOGI(TAG, "Impulse response received (%d bytes)", total);
+        } else {
+            ESP_LOGW(TAG, "Impulse response upload failed: %s", esp_err_to_name(s_ir_result));
         }
-        equalizer_save_settings(&equalizer);
-        mqtt_manager_publish_eq_state();
-        ESP_LOGI(TAG, "EQ preset '%s' applied", value);
-    }
-    
-    // Limiter commands
-    else if (strcmp(topic, MQTT_TOPIC_LIM_THRESHOLD) == 0) {
-        float threshold = atof(value);
-        if (limiter_set_threshold(&limiter, threshold)) {
-            limiter_save_settings(&limiter);
-            mqtt_manager_publish_limiter_state();
-            ESP_LOGI(TAG, "Limiter threshold set to %.1f dB", threshold);
+        mqtt_manager_publish_conv_state();
+    }
+}
+
+/**
+ * Process MQTT command messages
+ *
+ * Topic and payload are parsed in place in the client's receive buffer
+ * (neither is NUL-terminated).
+ */
+static void process_mqtt_command(const char* topic, int topic_len, const char* data, int data_len)
+{
+    const size_t prefix_len = strlen(MQTT_BASE_TOPIC "/");
+    if (topic_len <= (int)prefix_len || strncmp(topic, MQTT_BASE_TOPIC "/", prefix_len) != 0) {
+        return;
+    }
+    const char* path = topic + prefix_len;
+    const size_t path_len = (size_t)topic_len - prefix_len;
+    
+    ESP_LOGD(TAG, "Command: topic=%.*s, value=%.*s", topic_len, topic, data_len, data);
+    
+    uint32_t changed = 0;
+    esp_err_t err;
+    if (path_len == strlen(MQTT_BATCH_PATH) && memcmp(path, MQTT_BATCH_PATH, path_len) == 0) {
+        int count = 0;
+        err = dsp_control_apply_batch(data, (size_t)data_len, &changed, &count);
+        if (err == ESP_OK) {
+            ESP_LOGD(TAG, "Batch of %d command(s) applied", count);
         }
+    } else {
+        err = dsp_control_apply(path, path_len, data, (size_t)data_len, &changed);
+    }
+    
+    // A failed save can follow applied edits: their topics are still republished
+    if (changed != 0) {
+        telemetry_request_changed(changed);
     }
-    else if (strcmp(topic, MQTT_TOPIC_LIM_ENABLE) == 0) {
-        bool enable = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-        limiter_set_enabled(&limiter, enable);
-        limiter_save_settings(&limiter);
-        mqtt_manager_publish_limiter_state();
-        ESP_LOGI(TAG, "Limiter %s", enable ? "enabled" : "disabled");
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Command %.*s %s: %s", topic_len, topic,
+                 (changed != 0) ? "applied, save failed" : "not applied", esp_err_to_name(err));
     }
 }
 
@@ -223,20 +228,56 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_GAIN_SET, 1);
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_GAIN_ENABLE, 1);
             
-            // Subscribe to individual band topics (0-4)
-            for (int i = 0; i < 5; i++) {
-                char topic[64];
-                snprintf(topic, sizeof(topic), "%s/%d", MQTT_TOPIC_EQ_BAND, i);
-                esp_mqtt_client_subscribe(s_mqtt_client, topic, 1);
-            }
+            // All band topics (gain and per-band fields) with one wildcard
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_EQ_BAND "/#", 1);
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_EQ_ENABLE, 1);
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_EQ_PRESET, 1);
             
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_LIM_THRESHOLD, 1);
             esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_LIM_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_LIM_TRUE_PEAK, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_CONV_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_CONV_GAIN, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_CONV_IR, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_XOVER_FREQ "/#", 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_XOVER_WAY "/#", 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_MB_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_MB_BANDS, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_MB_FREQ "/#", 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_MB_BAND "/#", 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_DELAY_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_DELAY_LEFT, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_DELAY_RIGHT, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_PRESET_RECALL, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_PRESET_STORE "/#", 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_PRESET_CLEAR, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_PRESET_CROSSFADE, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_HOST, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_PORT, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_POINT, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_FORMAT, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_DECIMATION, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_TAP_SAVE, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_AUDIO_RATE, 1);
+            
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_PERF_RESET, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_METER_RESET, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_SPECTRUM_ENABLE, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_SPECTRUM_RESET, 1);
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_XRUN_RESET, 1);
             
-            // Publish initial states
-            mqtt_manager_publish_all_states();
+            esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_BATCH, 1);
+            
+            // Publish every state again (the telemetry task, on its next wake-up)
+            telemetry_connected();
             break;
             
         case MQTT_EVENT_DISCONNECTED:
@@ -248,16 +289,26 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             ESP_LOGI(TAG, "Subscribed to topic, msg_id=%d", event->msg_id);
             break;
             
-        case MQTT_EVENT_DATA: {
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            char topic[128] = {0};
-            if (event->topic_len < sizeof(topic)) {
-                strncpy(topic, event->topic, event->topic_len);
-                topic[event->topic_len] = '\0';
-                process_mqtt_command(topic, event->data, event->data_len);
+        case MQTT_EVENT_DATA:
+            // Messages split over several events (larger than the client's
+            // buffer) are only accepted for impulse response uploads
+            if (event->current_data_offset == 0) {
+                s_rx_messages++;
+                if (s_ir_upload) {
+                    // The previous upload was cut short
+                    convolver_ir_abort(&convolver);
+                    s_ir_upload = false;
+                }
+                if (event->topic_len == (int)strlen(MQTT_TOPIC_CONV_IR) &&
+                    memcmp(event->topic, MQTT_TOPIC_CONV_IR, event->topic_len) == 0) {
+                    process_ir_fragment(event);
+                } else if (event->data_len == event->total_data_len) {
+                    process_mqtt_command(event->topic, event->topic_len, event->data, event->data_len);
+                }
+            } else if (s_ir_upload) {
+                process_ir_fragment(event);
             }
             break;
-        }
             
         case MQTT_EVENT_ERROR:
             ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
@@ -291,6 +342,7 @@ static esp_err_t start_mqtt_client(const char* broker_uri)
     mqtt_cfg.session.keepalive = 60;
     mqtt_cfg.network.timeout_ms = 5000;
     mqtt_cfg.credentials.client_id = MQTT_CLIENT_ID;
+    mqtt_cfg.buffer.size = MQTT_RX_BUFFER_SIZE;
     
     s_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (s_mqtt_client == NULL) {
@@ -309,6 +361,12 @@ static esp_err_t start_mqtt_client(const char* broker_uri)
     strncpy(s_broker_uri, broker_uri, MQTT_BROKER_MAX_LEN - 1);
     ESP_LOGI(TAG, "MQTT client started, connecting to: %s", broker_uri);
     
+    // All states and periodic topics are published by the telemetry task
+    err = telemetry_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Telemetry not started: %s", esp_err_to_name(err));
+    }
+    
     return ESP_OK;
 }
 
@@ -378,90 +436,576 @@ bool mqtt_manager_is_connected(void)
 }
 
 esp_err_t mqtt_manager_publish(const char* topic, const char* data, int qos, bool retain)
+{
+    esp_err_t err = mqtt_manager_publish_data(topic, data, (int)strlen(data), qos, retain);
+    if (err == ESP_FAIL) {
+        ESP_LOGE(TAG, "Failed to publish to topic: %s", topic);
+    }
+    return err;
+}
+
+esp_err_t mqtt_manager_publish_data(const char* topic, const void* data, int len, int qos, bool retain)
 {
     if (!s_is_connected || s_mqtt_client == NULL) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    int msg_id = esp_mqtt_client_publish(s_mqtt_client, topic, data, 0, qos, retain ? 1 : 0);
-    if (msg_id < 0) {
-        ESP_LOGE(TAG, "Failed to publish to topic: %s", topic);
-        return ESP_FAIL;
+    // A length of 0 would make the client take strlen() of binary data
+    if (len <= 0) {
+        return ESP_ERR_INVALID_SIZE;
     }
     
-    return ESP_OK;
+    int msg_id = esp_mqtt_client_publish(s_mqtt_client, topic, (const char *)data, len, qos, retain ? 1 : 0);
+    return (msg_id < 0) ? ESP_FAIL : ESP_OK;
 }
 
-esp_err_t mqtt_manager_publish_status(void)
+/**
+ * Append formatted text to a state payload
+ *
+ * @return New length, or size once the payload has been cut off (further
+ *         appends then do nothing)
+ */
+static int append(char *buf, size_t size, int len, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+static int append(char *buf, size_t size, int len, const char *fmt, ...)
+{
+    if ((size_t)len >= size) {
+        return (int)size;
+    }
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)(len + n) >= size) {
+        return (int)size;
+    }
+    return len + n;
+}
+
+static int render_status(char *buf, size_t size)
 {
-    char status[512];
-    snprintf(status, sizeof(status),
-             "{\"sample_rate\":%d,\"channels\":%d,\"subsonic\":%s,\"pregain\":%s,\"eq\":%s,\"limiter\":%s}",
-             SAMPLE_RATE,
-             I2S_NUM_CHANNELS,
-             subsonic_get_enabled(&subsonic) ? "true" : "false",
-             pregain_is_enabled(&pregain) ? "true" : "false",
-             equalizer.enabled ? "true" : "false",
-             limiter.enabled ? "true" : "false");
+    return append(buf, size, 0,
+                  "{\"sample_rate\":%lu,\"channels\":%d,\"subsonic\":%s,\"pregain\":%s,\"eq\":%s,\"limiter\":%s}",
+                  (unsigned long)audio_rate_get(),
+                  I2S_NUM_CHANNELS,
+                  subsonic_get_enabled(&subsonic) ? "true" : "false",
+                  pregain_is_enabled(&pregain) ? "true" : "false",
+                  equalizer.enabled ? "true" : "false",
+                  limiter.enabled ? "true" : "false");
+}
+
+static int render_subsonic(char *buf, size_t size)
+{
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"freq\":%.1f}",
+                  subsonic_get_enabled(&subsonic) ? "true" : "false",
+                  subsonic_get_frequency(&subsonic));
+}
+
+static int render_pregain(char *buf, size_t size)
+{
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"gain\":%.1f}",
+                  pregain_is_enabled(&pregain) ? "true" : "false",
+                  pregain_get_gain(&pregain));
+}
+
+static_assert(96 + EQ_MAX_BANDS * 96 <= TELEMETRY_BUFFER_SIZE, "eq state does not fit the telemetry buffer");
+
+static int render_eq(char *buf, size_t size)
+{
+    // "bands" keeps the gain-per-index array of the 5-band firmware (now one
+    // entry per pool band); "config" describes the enabled bands in full
+    int len = append(buf, size, 0, "{\"enabled\":%s,\"bands\":[",
+                     equalizer.enabled ? "true" : "false");
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        len = append(buf, size, len, "%s%.1f", i ? "," : "", equalizer.bands[i].gain_db);
+    }
+    len = append(buf, size, len, "],\"config\":[");
+    bool first = true;
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        const eq_band_t *b = &equalizer.bands[i];
+        if (!b->enabled) {
+            continue;
+        }
+        len = append(buf, size, len,
+                     "%s{\"band\":%d,\"type\":\"%s\",\"freq\":%.1f,\"q\":%.3f,\"gain\":%.1f}",
+                     first ? "" : ",", i, equalizer_type_name(b->type), b->freq, b->q, b->gain_db);
+        first = false;
+    }
+    return append(buf, size, len, "]}");
+}
+
+static int render_limiter(char *buf, size_t size)
+{
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"threshold\":%.1f,\"true_peak\":%s}",
+                  limiter.enabled ? "true" : "false",
+                  limiter_get_threshold(&limiter),
+                  limiter_get_true_peak(&limiter) ? "true" : "false");
+}
+
+static int render_conv(char *buf, size_t size)
+{
+#if CONVOLVER_ENABLED
+    convolver_info_t info;
+    convolver_get_info(&convolver, &info);
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"gain\":%.1f,\"loaded\":%s,\"stored\":%s,\"taps\":%lu,"
+                  "\"channels\":%d,\"partitions\":%d,\"ir_rate\":%lu,\"rate_mismatch\":%s,"
+                  "\"memory\":%u,\"blocks\":%lu,\"skipped\":%lu,\"late\":%lu}",
+                  convolver.enabled ? "true" : "false",
+                  convolver.gain_db,
+                  info.loaded ? "true" : "false",
+                  info.stored ? "true" : "false",
+                  (unsigned long)info.taps, info.channels, info.partitions,
+                  (unsigned long)info.sample_rate,
+                  info.rate_mismatch ? "true" : "false",
+                  (unsigned)info.memory,
+                  (unsigned long)info.blocks, (unsigned long)info.skipped, (unsigned long)info.late);
+#else
+    return -1;
+#endif
+}
+
+static int render_xover(char *buf, size_t size)
+{
+#if CROSSOVER_ENABLED
+    static_assert(96 + CROSSOVER_WAYS * 224 <= TELEMETRY_BUFFER_SIZE, "crossover state does not fit the telemetry buffer");
+    crossover_settings_t settings;
+    crossover_get_settings(&crossover, &settings);
+    int len = append(buf, size, 0, "{\"output\":\"%s\",\"freq\":[", crossover_output_name());
+    for (int i = 0; i < CROSSOVER_POINTS; i++) {
+        len = append(buf, size, len, "%s%.1f", i ? "," : "", settings.freq[i]);
+    }
+    len = append(buf, size, len, "],\"ways\":[");
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        const crossover_way_settings_t *way = &settings.ways[w];
+        crossover_way_info_t info;
+        crossover_get_way_info(&crossover, w, &info);
+        len = append(buf, size, len,
+                     "%s{\"name\":\"%s\",\"gain\":%.1f,\"delay_ms\":%.3f,\"delay_frames\":%lu,"
+                     "\"invert\":%s,\"limit\":%.1f,\"true_peak\":%s,\"reduction\":%.1f,\"clips\":%lu}",
+                     w ? "," : "", info.name, way->gain_db, way->delay_ms,
+                     (unsigned long)info.delay_frames, way->invert ? "true" : "false",
+                     way->limit_db, way->true_peak ? "true" : "false",
+                     info.peak_reduction_db, (unsigned long)info.clips_prevented);
+    }
+    return append(buf, size, len, "]}");
+#else
+    return -1;
+#endif
+}
+
+static int render_mb(char *buf, size_t size)
+{
+#if MULTIBAND_ENABLED
+    static_assert(96 + MULTIBAND_MAX_BANDS * 192 <= TELEMETRY_BUFFER_SIZE, "multiband state does not fit the telemetry buffer");
+    multiband_settings_t settings;
+    multiband_get_settings(&multiband, &settings);
+    int len = append(buf, size, 0, "{\"enabled\":%s,\"bands\":%d,\"freq\":[",
+                     settings.enabled ? "true" : "false", settings.num_bands);
+    for (int i = 0; i < settings.num_bands - 1; i++) {
+        len = append(buf, size, len, "%s%.1f", i ? "," : "", settings.freq[i]);
+    }
+    len = append(buf, size, len, "],\"config\":[");
+    for (int b = 0; b < settings.num_bands; b++) {
+        const multiband_band_settings_t *band = &settings.bands[b];
+        len = append(buf, size, len,
+                     "%s{\"threshold\":%.1f,\"ratio\":%.2f,\"attack\":%.1f,\"release\":%.0f,"
+                     "\"makeup\":%.1f,\"exp_threshold\":%.1f,\"exp_ratio\":%.2f}",
+                     b ? "," : "", band->threshold_db, band->ratio, band->attack_ms,
+                     band->release_ms, band->makeup_db, band->exp_threshold_db, band->exp_ratio);
+    }
+    return append(buf, size, len, "]}");
+#else
+    return -1;
+#endif
+}
+
+static int render_delay(char *buf, size_t size)
+{
+#if DELAY_LINE_ENABLED
+    delay_line_settings_t settings;
+    delay_line_get_settings(&delay_line, &settings);
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"available\":%s,\"left\":%.3f,\"right\":%.3f,"
+                  "\"left_frames\":%.2f,\"right_frames\":%.2f,\"max_ms\":%d}",
+                  settings.enabled ? "true" : "false",
+                  delay_line.line != NULL ? "true" : "false",
+                  settings.delay_ms[0], settings.delay_ms[1],
+                  delay_line_get_frames(&delay_line, 0), delay_line_get_frames(&delay_line, 1),
+                  DELAY_LINE_MAX_MS);
+#else
+    return -1;
+#endif
+}
+
+static int render_preset(char *buf, size_t size)
+{
+#if PRESET_BANK_ENABLED
+    static_assert(192 + PRESET_BANK_SLOTS * (PRESET_BANK_NAME_LEN + 48) <= TELEMETRY_BUFFER_SIZE,
+                  "preset state does not fit the telemetry buffer");
+    preset_bank_stats_t stats;
+    preset_bank_get_stats(&stats);
+    
+    int len = append(buf, size, 0, "{\"active\":%d,\"crossfade\":%s,\"recalls\":%lu,"
+                     "\"last_recall_us\":%lu,\"max_recall_us\":%lu,\"slots\":[",
+                     stats.active, stats.crossfade ? "true" : "false",
+                     (unsigned long)stats.recalls, (unsigned long)stats.last_recall_us,
+                     (unsigned long)stats.max_recall_us);
+    bool first = true;
+    for (int i = 0; i < PRESET_BANK_SLOTS; i++) {
+        preset_bank_info_t info;
+        if (preset_bank_get_info(i, &info) != ESP_OK || !info.used) {
+            continue;
+        }
+        // Names are restricted to what needs no JSON escaping (dsp_control)
+        len = append(buf, size, len, "%s{\"slot\":%d,\"name\":\"%s\"}",
+                     first ? "" : ",", i, info.name);
+        first = false;
+    }
+    return append(buf, size, len, "]}");
+#else
+    return -1;
+#endif
+}
+
+static int render_tap(char *buf, size_t size)
+{
+#if AUDIO_TAP_ENABLED
+    audio_tap_settings_t settings;
+    audio_tap_stats_t stats;
+    audio_tap_get_settings(&settings);
+    audio_tap_get_stats(&stats);
+    
+    char host[16];
+    audio_tap_format_host(settings.host, host);
+    return append(buf, size, 0,
+                  "{\"enabled\":%s,\"host\":\"%s\",\"port\":%u,\"point\":\"%s\",\"format\":\"%s\","
+                  "\"decimation\":%u,\"streaming\":%s,\"stream_rate\":%lu,\"blocks\":%lu,"
+                  "\"dropped_blocks\":%lu,\"packets\":%lu,\"dropped_packets\":%lu,\"kbytes\":%lu}",
+                  settings.enabled ? "true" : "false", host, (unsigned)settings.port,
+                  audio_tap_point_name((audio_tap_point_t)settings.point),
+                  audio_tap_format_name((audio_tap_format_t)settings.format),
+                  (unsigned)settings.decimation, stats.streaming ? "true" : "false",
+                  (unsigned long)stats.stream_rate, (unsigned long)stats.blocks,
+                  (unsigned long)stats.dropped_blocks, (unsigned long)stats.packets,
+                  (unsigned long)stats.dropped_packets, (unsigned long)stats.kbytes);
+#else
+    return -1;
+#endif
+}
+
+static int render_tap_sdp(char *buf, size_t size)
+{
+    return (audio_tap_get_sdp(buf, size) == ESP_OK) ? (int)strlen(buf) : -1;
+}
+
+static_assert(256 + DSP_PERF_STAGE_COUNT * 160 <= TELEMETRY_BUFFER_SIZE, "profiler state does not fit the telemetry buffer");
+
+static int render_perf(char *buf, size_t size)
+{
+    dsp_perf_snapshot_t snap;
+    if (dsp_perf_get_snapshot(&snap) != ESP_OK) {
+        return -1;
+    }
     
-    return mqtt_manager_publish(MQTT_TOPIC_STATUS, status, 0, true);
+    const dsp_perf_stage_stats_t *chain = &snap.stages[DSP_PERF_CHAIN];
+    float load_max = snap.deadline_cycles ? 100.0f * chain->max / snap.deadline_cycles : 0.0f;
+    int len = append(buf, size, 0,
+                     "{\"load\":%.1f,\"load_max\":%.1f,\"blocks\":%lu,\"overruns\":%lu,"
+                     "\"deadline_us\":%.0f,\"stages\":{",
+                     dsp_perf_avg_load(&snap, DSP_PERF_CHAIN), load_max,
+                     (unsigned long)snap.blocks, (unsigned long)snap.overruns,
+                     dsp_perf_cycles_to_us(&snap, snap.deadline_cycles));
+    
+    // Only sections that were timed (per-stage entries need staged mode)
+    bool first = true;
+    for (int i = 0; i < DSP_PERF_STAGE_COUNT; i++) {
+        const dsp_perf_stage_stats_t *st = &snap.stages[i];
+        if (st->count == 0) {
+            continue;
+        }
+        len = append(buf, size, len,
+                     "%s\"%s\":{\"min_us\":%.1f,\"avg_us\":%.1f,\"max_us\":%.1f,\"hist\":[",
+                     first ? "" : ",", dsp_perf_stage_name((dsp_perf_stage_t)i),
+                     dsp_perf_cycles_to_us(&snap, st->min),
+                     dsp_perf_cycles_to_us(&snap, st->total) / st->count,
+                     dsp_perf_cycles_to_us(&snap, st->max));
+        for (int b = 0; b < DSP_PERF_HIST_BINS; b++) {
+            len = append(buf, size, len, "%s%lu", b ? "," : "", (unsigned long)st->hist[b]);
+        }
+        len = append(buf, size, len, "]}");
+        first = false;
+    }
+    return append(buf, size, len, "}}");
 }
 
-esp_err_t mqtt_manager_publish_subsonic_state(void)
+static int render_meter(char *buf, size_t size)
 {
-    char state[128];
-    snprintf(state, sizeof(state),
-             "{\"enabled\":%s,\"freq\":%.1f}",
-             subsonic_get_enabled(&subsonic) ? "true" : "false",
-             subsonic_get_frequency(&subsonic));
+    level_meter_snapshot_t meter;
+    if (level_meter_get_snapshot(&meter) != ESP_OK) {
+        return -1;
+    }
     
-    return mqtt_manager_publish(MQTT_TOPIC_SUB_STATE, state, 0, true);
+    int len = append(buf, size, 0,
+                     "{\"peak\":[%.1f,%.1f],\"rms\":[%.1f,%.1f],\"peak_max\":[%.1f,%.1f],"
+                     "\"clips\":[%lu,%lu]",
+                     meter.peak_db[0], meter.peak_db[1], meter.rms_db[0], meter.rms_db[1],
+                     meter.peak_max_db[0], meter.peak_max_db[1],
+                     (unsigned long)meter.clips[0], (unsigned long)meter.clips[1]);
+    if (meter.loudness) {
+        len = append(buf, size, len, ",\"momentary\":%.1f,\"short_term\":%.1f",
+                     meter.momentary_lufs, meter.short_term_lufs);
+    }
+    if (meter.bands > 0) {
+        len = append(buf, size, len, ",\"reduction\":[");
+        for (int b = 0; b < meter.bands; b++) {
+            len = append(buf, size, len, "%s%.1f", b ? "," : "", meter.band_reduction_db[b]);
+        }
+        len = append(buf, size, len, "]");
+    }
+    return append(buf, size, len, "}");
 }
 
-esp_err_t mqtt_manager_publish_pregain_state(void)
+static_assert(128 + 2 * SPECTRUM_BANDS * 8 <= TELEMETRY_BUFFER_SIZE, "spectrum state does not fit the telemetry buffer");
+
+static int render_spectrum(char *buf, size_t size)
 {
-    char state[128];
-    snprintf(state, sizeof(state),
-             "{\"enabled\":%s,\"gain\":%.1f}",
-             pregain_is_enabled(&pregain) ? "true" : "false",
-             pregain_get_gain(&pregain));
+    spectrum_snapshot_t snap;
+    if (spectrum_get_snapshot(&snap) != ESP_OK) {
+        return -1;
+    }
+    
+    // Bands are listed from 20 Hz up to the highest one below Nyquist
+    int bands = 0;
+    while (bands < SPECTRUM_BANDS && spectrum_band_freq(bands) < 0.5f * (float)snap.analysis_rate) {
+        bands++;
+    }
     
-    return mqtt_manager_publish(MQTT_TOPIC_GAIN_STATE, state, 0, true);
+    int len = append(buf, size, 0, "{\"rate\":%lu,\"frames\":%lu,\"dropped\":%lu,\"level\":[",
+                     (unsigned long)snap.analysis_rate, (unsigned long)snap.frames,
+                     (unsigned long)snap.dropped);
+    for (int b = 0; b < bands; b++) {
+        len = append(buf, size, len, "%s%.1f", b ? "," : "", snap.level_db[b]);
+    }
+    len = append(buf, size, len, "],\"avg\":[");
+    for (int b = 0; b < bands; b++) {
+        len = append(buf, size, len, "%s%.1f", b ? "," : "", snap.average_db[b]);
+    }
+    return append(buf, size, len, "]}");
 }
 
-esp_err_t mqtt_manager_publish_eq_state(void)
+static_assert(384 + AUDIO_XRUN_LOG_SIZE * 96 <= TELEMETRY_BUFFER_SIZE, "xrun state does not fit the telemetry buffer");
+
+static int render_xrun(char *buf, size_t size)
 {
-    char state[256];
-    snprintf(state, sizeof(state),
-             "{\"enabled\":%s,\"bands\":[%.1f,%.1f,%.1f,%.1f,%.1f]}",
-             equalizer.enabled ? "true" : "false",
-             equalizer.gain_db[0],
-             equalizer.gain_db[1],
-             equalizer.gain_db[2],
-             equalizer.gain_db[3],
-             equalizer.gain_db[4]);
+    audio_xrun_snapshot_t snap;
+    if (audio_xrun_get_snapshot(&snap) != ESP_OK) {
+        return -1;
+    }
+    
+    // Times are milliseconds since boot, the clock of the log lines
+    int len = append(buf, size, 0, "{\"uptime_ms\":%lld,\"blocks\":%lu,\"period_us\":%lu,"
+                     "\"fades\":%lu,\"max_late_us\":%lu,\"mqtt_rx\":%lu",
+                     (long long)(esp_timer_get_time() / 1000), (unsigned long)snap.blocks,
+                     (unsigned long)snap.period_us, (unsigned long)snap.fades,
+                     (unsigned long)snap.max_late_us, (unsigned long)s_rx_messages);
+    for (int t = 0; t < AUDIO_XRUN_TYPE_COUNT; t++) {
+        len = append(buf, size, len, ",\"%s\":{\"events\":%lu,\"lost\":%lu,\"last_ms\":%lld}",
+                     audio_xrun_type_name((audio_xrun_type_t)t), (unsigned long)snap.events[t],
+                     (unsigned long)snap.lost[t], (long long)(snap.last_us[t] / 1000));
+    }
     
-    return mqtt_manager_publish(MQTT_TOPIC_EQ_STATE, state, 0, true);
+    // Most recent dropouts, oldest first
+    len = append(buf, size, len, ",\"recent\":[");
+    const uint32_t first = snap.total > AUDIO_XRUN_LOG_SIZE ? snap.total - AUDIO_XRUN_LOG_SIZE : 0;
+    for (uint32_t n = first; n < snap.total; n++) {
+        const audio_xrun_event_t *ev = &snap.log[n % AUDIO_XRUN_LOG_SIZE];
+        len = append(buf, size, len, "%s{\"t_ms\":%lld,\"type\":\"%s\",\"count\":%lu",
+                     n == first ? "" : ",", (long long)(ev->time_us / 1000),
+                     audio_xrun_type_name((audio_xrun_type_t)ev->type), (unsigned long)ev->count);
+        if (ev->type == AUDIO_XRUN_DEADLINE) {
+            len = append(buf, size, len, ",\"late_us\":%lu,\"stage\":\"%s\"",
+                         (unsigned long)ev->late_us, dsp_perf_stage_name((dsp_perf_stage_t)ev->stage));
+        }
+        len = append(buf, size, len, "}");
+    }
+    return append(buf, size, len, "]}");
+}
+
+// State topics in telemetry_topic_t order
+static const struct {
+    const char *topic;
+    bool retain;
+    int (*render)(char *buf, size_t size);
+} s_states[TELEMETRY_TOPIC_COUNT] = {
+    { MQTT_TOPIC_STATUS,         true,  render_status },
+    { MQTT_TOPIC_SUB_STATE,      true,  render_subsonic },
+    { MQTT_TOPIC_GAIN_STATE,     true,  render_pregain },
+    { MQTT_TOPIC_EQ_STATE,       true,  render_eq },
+    { MQTT_TOPIC_LIM_STATE,      true,  render_limiter },
+    { MQTT_TOPIC_CONV_STATE,     true,  render_conv },
+    { MQTT_TOPIC_XOVER_STATE,    true,  render_xover },
+    { MQTT_TOPIC_MB_STATE,       true,  render_mb },
+    { MQTT_TOPIC_DELAY_STATE,    true,  render_delay },
+    { MQTT_TOPIC_PRESET_STATE,   true,  render_preset },
+    { MQTT_TOPIC_TAP_STATE,      true,  render_tap },
+    { MQTT_TOPIC_TAP_SDP,        true,  render_tap_sdp },
+    { MQTT_TOPIC_PERF_STATE,     true,  render_perf },
+    { MQTT_TOPIC_METER_STATE,    false, render_meter },
+    { MQTT_TOPIC_SPECTRUM_STATE, false, render_spectrum },
+    { MQTT_TOPIC_XRUN_STATE,     true,  render_xrun },
+};
+
+int mqtt_manager_render_state(telemetry_topic_t topic, char *buf, size_t size, const char **name, bool *retain)
+{
+    if ((unsigned)topic >= TELEMETRY_TOPIC_COUNT) {
+        return -1;
+    }
+    *name = s_states[topic].topic;
+    *retain = s_states[topic].retain;
+    const int len = s_states[topic].render(buf, size);
+    if (len >= (int)size) {
+        ESP_LOGW(TAG, "%s does not fit in %u bytes", *name, (unsigned)size);
+        return -1;
+    }
+    return len;
+}
+
+esp_err_t mqtt_manager_publish_status(void)
+{
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_STATUS));
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_publish_subsonic_state(void)
+{
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_SUBSONIC));
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_publish_pregain_state(void)
+{
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_PREGAIN));
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_publish_eq_state(void)
+{
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_EQ));
+    return ESP_OK;
 }
 
 esp_err_t mqtt_manager_publish_limiter_state(void)
 {
-    char state[128];
-    snprintf(state, sizeof(state),
-             "{\"enabled\":%s,\"threshold\":%.1f}",
-             limiter.enabled ? "true" : "false",
-             limiter_get_threshold(&limiter));
-    
-    return mqtt_manager_publish(MQTT_TOPIC_LIM_STATE, state, 0, true);
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_LIMITER));
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_publish_conv_state(void)
+{
+#if CONVOLVER_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_CONV));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_xover_state(void)
+{
+#if CROSSOVER_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_XOVER));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_mb_state(void)
+{
+#if MULTIBAND_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_MB));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_delay_state(void)
+{
+#if DELAY_LINE_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_DELAY));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_preset_state(void)
+{
+#if PRESET_BANK_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_PRESET));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_tap_state(void)
+{
+#if AUDIO_TAP_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_TAP) | TELEMETRY_BIT(TELEMETRY_TAP_SDP));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_perf_state(void)
+{
+#if DSP_PERF_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_PERF));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_meter_state(void)
+{
+#if LEVEL_METER_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_METER));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_spectrum_state(void)
+{
+#if SPECTRUM_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_SPECTRUM));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mqtt_manager_publish_xrun_state(void)
+{
+#if AUDIO_XRUN_ENABLED
+    telemetry_request(TELEMETRY_BIT(TELEMETRY_XRUN));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 esp_err_t mqtt_manager_publish_all_states(void)
 {
-    mqtt_manager_publish_status();
-    mqtt_manager_publish_subsonic_state();
-    mqtt_manager_publish_pregain_state();
-    mqtt_manager_publish_eq_state();
-    mqtt_manager_publish_limiter_state();
-    
+    telemetry_request(TELEMETRY_ALL_STATES);
     return ESP_OK;
 }
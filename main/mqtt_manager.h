@@ -2,7 +2,10 @@
 #define MQTT_MANAGER_H
 
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include "telemetry.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * MQTT Manager Configuration
@@ -11,10 +14,18 @@
 #define MQTT_CLIENT_ID          "esp-dsp"
 #define MQTT_BASE_TOPIC         "esp-dsp"
 
+// Client receive buffer; a batch message must fit in one buffer
+#define MQTT_RX_BUFFER_SIZE     2048
+
 // MQTT Topics
 #define MQTT_TOPIC_STATUS       MQTT_BASE_TOPIC"/status"
 #define MQTT_TOPIC_COMMAND      MQTT_BASE_TOPIC"/command"
 
+// Batch of commands: JSON object of topic paths (without the base topic) to
+// values, applied together (see dsp_control.h)
+#define MQTT_BATCH_PATH         "batch"
+#define MQTT_TOPIC_BATCH        MQTT_BASE_TOPIC"/" MQTT_BATCH_PATH
+
 // Subsonic topics
 #define MQTT_TOPIC_SUB_FREQ     MQTT_BASE_TOPIC"/subsonic/freq"
 #define MQTT_TOPIC_SUB_ENABLE   MQTT_BASE_TOPIC"/subsonic/enable"
@@ -26,7 +37,8 @@
 #define MQTT_TOPIC_GAIN_STATE   MQTT_BASE_TOPIC"/pregain/state"
 
 // Equalizer topics
-#define MQTT_TOPIC_EQ_BAND      MQTT_BASE_TOPIC"/eq/band"
+#define MQTT_TOPIC_EQ_BAND      MQTT_BASE_TOPIC"/eq/band"      // /<n> = gain in dB
+// Per-band fields: MQTT_TOPIC_EQ_BAND"/<n>/type|freq|q|enable"
 #define MQTT_TOPIC_EQ_ENABLE    MQTT_BASE_TOPIC"/eq/enable"
 #define MQTT_TOPIC_EQ_PRESET    MQTT_BASE_TOPIC"/eq/preset"
 #define MQTT_TOPIC_EQ_STATE     MQTT_BASE_TOPIC"/eq/state"
@@ -34,8 +46,103 @@
 // Limiter topics
 #define MQTT_TOPIC_LIM_THRESHOLD MQTT_BASE_TOPIC"/limiter/threshold"
 #define MQTT_TOPIC_LIM_ENABLE    MQTT_BASE_TOPIC"/limiter/enable"
+#define MQTT_TOPIC_LIM_TRUE_PEAK MQTT_BASE_TOPIC"/limiter/true_peak"
 #define MQTT_TOPIC_LIM_STATE     MQTT_BASE_TOPIC"/limiter/state"
 
+// Convolver topics
+#define MQTT_TOPIC_CONV_ENABLE   MQTT_BASE_TOPIC"/conv/enable"
+#define MQTT_TOPIC_CONV_GAIN     MQTT_BASE_TOPIC"/conv/gain"     // Output gain in dB
+#define MQTT_TOPIC_CONV_IR       MQTT_BASE_TOPIC"/conv/ir"       // Binary response (convolver_ir_header_t + taps), not retained
+#define MQTT_TOPIC_CONV_STATE    MQTT_BASE_TOPIC"/conv/state"
+
+// Crossover topics (point or way index after the prefix: xover/freq/0, xover/way/1/gain, ...)
+#define MQTT_TOPIC_XOVER_FREQ    MQTT_BASE_TOPIC"/xover/freq"    // Crossover point in Hz
+#define MQTT_TOPIC_XOVER_WAY     MQTT_BASE_TOPIC"/xover/way"     // gain, delay, invert, limit, true_peak
+#define MQTT_TOPIC_XOVER_STATE   MQTT_BASE_TOPIC"/xover/state"
+
+// Multiband dynamics topics (point or band index after the prefix: mb/freq/0, mb/band/1/ratio, ...)
+#define MQTT_TOPIC_MB_ENABLE     MQTT_BASE_TOPIC"/mb/enable"
+#define MQTT_TOPIC_MB_BANDS      MQTT_BASE_TOPIC"/mb/bands"      // Number of bands
+#define MQTT_TOPIC_MB_FREQ       MQTT_BASE_TOPIC"/mb/freq"       // Split point in Hz
+#define MQTT_TOPIC_MB_BAND       MQTT_BASE_TOPIC"/mb/band"       // threshold, ratio, attack, release, makeup, exp_threshold, exp_ratio
+#define MQTT_TOPIC_MB_STATE      MQTT_BASE_TOPIC"/mb/state"
+
+// Output delay topics
+#define MQTT_TOPIC_DELAY_ENABLE  MQTT_BASE_TOPIC"/delay/enable"
+#define MQTT_TOPIC_DELAY_LEFT    MQTT_BASE_TOPIC"/delay/left"    // Delay in ms
+#define MQTT_TOPIC_DELAY_RIGHT   MQTT_BASE_TOPIC"/delay/right"   // Delay in ms
+#define MQTT_TOPIC_DELAY_STATE   MQTT_BASE_TOPIC"/delay/state"
+
+// Preset bank topics (slot number after the store prefix: preset/store/3, payload = name)
+#define MQTT_TOPIC_PRESET_RECALL    MQTT_BASE_TOPIC"/preset/recall"     // Slot number or name
+#define MQTT_TOPIC_PRESET_STORE     MQTT_BASE_TOPIC"/preset/store"
+#define MQTT_TOPIC_PRESET_CLEAR     MQTT_BASE_TOPIC"/preset/clear"      // Slot number or name
+#define MQTT_TOPIC_PRESET_CROSSFADE MQTT_BASE_TOPIC"/preset/crossfade"
+#define MQTT_TOPIC_PRESET_STATE     MQTT_BASE_TOPIC"/preset/state"
+
+// Audio tap topics (settings are saved only by tap/save)
+#define MQTT_TOPIC_TAP_ENABLE       MQTT_BASE_TOPIC"/tap/enable"
+#define MQTT_TOPIC_TAP_HOST         MQTT_BASE_TOPIC"/tap/host"          // Dotted IPv4 address
+#define MQTT_TOPIC_TAP_PORT         MQTT_BASE_TOPIC"/tap/port"          // UDP port
+#define MQTT_TOPIC_TAP_POINT        MQTT_BASE_TOPIC"/tap/point"         // post or prelimiter
+#define MQTT_TOPIC_TAP_FORMAT       MQTT_BASE_TOPIC"/tap/format"        // L24 or L16
+#define MQTT_TOPIC_TAP_DECIMATION   MQTT_BASE_TOPIC"/tap/decimation"    // 1, 2, 3, 4 or 6
+#define MQTT_TOPIC_TAP_SAVE         MQTT_BASE_TOPIC"/tap/save"
+#define MQTT_TOPIC_TAP_STATE        MQTT_BASE_TOPIC"/tap/state"
+#define MQTT_TOPIC_TAP_SDP          MQTT_BASE_TOPIC"/tap/sdp"           // Retained session description
+
+// Audio topics
+#define MQTT_TOPIC_AUDIO_RATE    MQTT_BASE_TOPIC"/audio/rate"    // Sample rate in Hz
+
+// Profiler topics
+#define MQTT_TOPIC_PERF_STATE    MQTT_BASE_TOPIC"/perf/state"    // Retained, republished periodically
+#define MQTT_TOPIC_PERF_RESET    MQTT_BASE_TOPIC"/perf/reset"
+
+// Level meter topics
+#define MQTT_TOPIC_METER_STATE   MQTT_BASE_TOPIC"/meter/state"   // Not retained, published periodically
+#define MQTT_TOPIC_METER_RESET   MQTT_BASE_TOPIC"/meter/reset"
+
+// Spectrum analyzer topics
+#define MQTT_TOPIC_SPECTRUM_STATE   MQTT_BASE_TOPIC"/spectrum/state"    // Not retained, published periodically
+#define MQTT_TOPIC_SPECTRUM_ENABLE  MQTT_BASE_TOPIC"/spectrum/enable"
+#define MQTT_TOPIC_SPECTRUM_RESET   MQTT_BASE_TOPIC"/spectrum/reset"
+
+// Xrun (dropout) monitor topics
+#define MQTT_TOPIC_XRUN_STATE    MQTT_BASE_TOPIC"/xrun/state"    // Retained, published after new dropouts
+#define MQTT_TOPIC_XRUN_RESET    MQTT_BASE_TOPIC"/xrun/reset"
+
+// Telemetry snapshot topics (changed fields only, see telemetry.h), not retained
+#define MQTT_TOPIC_TELEMETRY        MQTT_BASE_TOPIC"/telemetry"         // JSON
+#define MQTT_TOPIC_TELEMETRY_CBOR   MQTT_BASE_TOPIC"/telemetry/cbor"    // CBOR (CONFIG_TELEMETRY_FORMAT_CBOR)
+
+// Interval between level meter publishes
+#ifdef CONFIG_LEVEL_METER_MQTT_INTERVAL_MS
+#define MQTT_METER_INTERVAL_MS   CONFIG_LEVEL_METER_MQTT_INTERVAL_MS
+#else
+#define MQTT_METER_INTERVAL_MS   1000
+#endif
+
+// Interval between spectrum publishes
+#ifdef CONFIG_SPECTRUM_MQTT_INTERVAL_MS
+#define MQTT_SPECTRUM_INTERVAL_MS   CONFIG_SPECTRUM_MQTT_INTERVAL_MS
+#else
+#define MQTT_SPECTRUM_INTERVAL_MS   1000
+#endif
+
+// Shortest interval between xrun state publishes
+#ifdef CONFIG_AUDIO_XRUN_MQTT_INTERVAL_MS
+#define MQTT_XRUN_INTERVAL_MS    CONFIG_AUDIO_XRUN_MQTT_INTERVAL_MS
+#else
+#define MQTT_XRUN_INTERVAL_MS    1000
+#endif
+
+// Interval between profiler state publishes
+#ifdef CONFIG_DSP_PERF_MQTT_INTERVAL_S
+#define MQTT_PERF_INTERVAL_S     CONFIG_DSP_PERF_MQTT_INTERVAL_S
+#else
+#define MQTT_PERF_INTERVAL_S     10
+#endif
+
 /**
  * Initialize MQTT Manager
  * Loads MQTT broker configuration from NVS and connects
@@ -77,6 +184,39 @@ bool mqtt_manager_is_connected(void);
  */
 esp_err_t mqtt_manager_publish(const char* topic, const char* data, int qos, bool retain);
 
+/**
+ * Publish a payload of known length (may be binary)
+ * 
+ * @param topic MQTT topic
+ * @param data Message payload
+ * @param len Payload length in bytes (at least 1)
+ * @param qos Quality of Service (0, 1, or 2)
+ * @param retain Retain message flag
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while disconnected, or
+ *         ESP_FAIL if the client did not take the message
+ */
+esp_err_t mqtt_manager_publish_data(const char* topic, const void* data, int len, int qos, bool retain);
+
+/**
+ * Render the payload of a state topic (telemetry task)
+ * 
+ * @param topic State topic
+ * @param buf Destination
+ * @param size Size of buf
+ * @param name Set to the MQTT topic
+ * @param retain Set to whether the topic is retained
+ * @return Payload length, or -1 if the state is not available (module not
+ *         built in, no data yet) or does not fit
+ */
+int mqtt_manager_render_state(telemetry_topic_t topic, char *buf, size_t size, const char **name, bool *retain);
+
+/*
+ * The state publishers below only queue their topic for the telemetry task,
+ * which publishes it within TELEMETRY_INTERVAL_MS (together with any other
+ * change to it in the meantime, and not at all if the retained payload is
+ * unchanged).
+ */
+
 /**
  * Publish current system status
  * 
@@ -112,6 +252,76 @@ esp_err_t mqtt_manager_publish_eq_state(void);
  */
 esp_err_t mqtt_manager_publish_limiter_state(void);
 
+/**
+ * Publish convolver state (settings and the loaded impulse response)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CONVOLVER
+ */
+esp_err_t mqtt_manager_publish_conv_state(void);
+
+/**
+ * Publish crossover state (points, way settings and limiter statistics)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without CROSSOVER
+ */
+esp_err_t mqtt_manager_publish_xover_state(void);
+
+/**
+ * Publish multiband dynamics state (points and band settings)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without MULTIBAND
+ */
+esp_err_t mqtt_manager_publish_mb_state(void);
+
+/**
+ * Publish output delay state (delays in ms and frames)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without DELAY_LINE
+ */
+esp_err_t mqtt_manager_publish_delay_state(void);
+
+/**
+ * Publish preset bank state (slots, active slot, recall mode and timing)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without PRESET_BANK
+ */
+esp_err_t mqtt_manager_publish_preset_state(void);
+
+/**
+ * Publish audio tap state (settings and stream counters) and its SDP
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without AUDIO_TAP
+ */
+esp_err_t mqtt_manager_publish_tap_state(void);
+
+/**
+ * Publish DSP profiler statistics (per-stage min/avg/max and load)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without DSP_PERF
+ */
+esp_err_t mqtt_manager_publish_perf_state(void);
+
+/**
+ * Publish the output levels of the last meter window
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without LEVEL_METER
+ */
+esp_err_t mqtt_manager_publish_meter_state(void);
+
+/**
+ * Publish the 1/3-octave output spectrum (fast and slow averages)
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without SPECTRUM
+ */
+esp_err_t mqtt_manager_publish_spectrum_state(void);
+
+/**
+ * Publish dropout counters and the most recent dropouts
+ * 
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without AUDIO_XRUN
+ */
+esp_err_t mqtt_manager_publish_xrun_state(void);
+
 /**
  * Publish all states
  * 
@@ -0,0 +1,480 @@
+#include "multiband.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "MULTIBAND";
+
+// Default points: a number of bands uses the first bands - 1
+static const float s_default_freq[MULTIBAND_MAX_BANDS - 1] = { 200.0f, 2500.0f, 8000.0f };
+
+// Default dynamics, lowest band first: slower time constants for the bass
+static const multiband_band_settings_t s_default_bands[MULTIBAND_MAX_BANDS] = {
+    { -20.0f, 2.0f, 20.0f, 250.0f, 0.0f, -70.0f, 1.0f },
+    { -20.0f, 2.0f, 10.0f, 150.0f, 0.0f, -70.0f, 1.0f },
+    { -20.0f, 2.0f, 5.0f, 100.0f, 0.0f, -70.0f, 1.0f },
+    { -20.0f, 2.0f, 3.0f, 80.0f, 0.0f, -70.0f, 1.0f },
+};
+
+static void default_settings(multiband_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->num_bands = MULTIBAND_DEFAULT_BANDS;
+    for (int i = 0; i < MULTIBAND_MAX_BANDS - 1; i++) {
+        settings->freq[i] = s_default_freq[i];
+    }
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        settings->bands[b] = s_default_bands[b];
+    }
+}
+
+#if MULTIBAND_ENABLED
+#include "dsp_tables.h"
+#include "level_meter.h"
+#include "esp_heap_caps.h"
+
+static_assert(MULTIBAND_MAX_BANDS <= LEVEL_METER_BANDS, "the meter reports every band");
+
+#define SEGMENT         MULTIBAND_SEGMENT_FRAMES
+#define KNEE            MULTIBAND_KNEE_DB
+
+// 24-bit full scale (both sample formats are at 24-bit scale)
+#define FULL_SCALE      8388608.0f
+
+static DSP_HOT_INLINE float clampf(float x, float lo, float hi)
+{
+    if (!(x >= lo)) x = lo;
+    if (x > hi) x = hi;
+    return x;
+}
+
+/* Audio path */
+
+static inline float load_sample(int32_t v) { return (float)v; }
+static inline float load_sample(float v) { return v; }
+
+static DSP_HOT_INLINE void store_sample(int32_t *dst, float y)
+{
+    if (y > 2147483520.0f) y = 2147483520.0f;
+    if (y < -2147483648.0f) y = -2147483648.0f;
+    *dst = (int32_t)lrintf(y);
+}
+
+static DSP_HOT_INLINE void store_sample(float *dst, float y)
+{
+    *dst = y;
+}
+
+// Detect, compute and apply the band gains one segment at a time, summing
+// the bands into out (which may be the block the bands were split from)
+template <typename B, typename O>
+static DSP_HOT_INLINE void dynamics(multiband_state_t *st, const multiband_params_t *p, B *const *band,
+                                    O *out, int num_samples)
+{
+    const int bands = p->split.bands;
+    const int frames = num_samples / 2;
+    float *acc = st->input;
+    float env[MULTIBAND_MAX_BANDS];
+    float gain[MULTIBAND_MAX_BANDS];
+    float peak[MULTIBAND_MAX_BANDS];
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        env[b] = st->envelope[b];
+        gain[b] = st->gain[b];
+        peak[b] = 0.0f;
+    }
+
+    for (int f0 = 0; f0 < frames; f0 += SEGMENT) {
+        const int n = (frames - f0 < SEGMENT) ? frames - f0 : SEGMENT;
+        const int s0 = 2 * f0;
+
+        // Stereo linked mean square of each band (unused bands stay silent)
+        float ms[MULTIBAND_MAX_BANDS] = { 0 };
+        for (int b = 0; b < bands; b++) {
+            const B *x = band[b] + s0;
+            float sum = 0.0f;
+            for (int i = 0; i < 2 * n; i++) {
+                const float v = load_sample(x[i]);
+                sum += v * v;
+            }
+            ms[b] = sum;
+        }
+        const float scale = 0.5f / ((float)n * FULL_SCALE * FULL_SCALE);
+
+        // Gain computer: fixed length, no branches (selects and min/max only)
+        float target[MULTIBAND_MAX_BANDS];
+        for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+            const float x = ms[b] * scale;
+            const float rising = (float)(x > env[b]);
+            const float c = p->release[b] + (p->attack[b] - p->release[b]) * rising;
+            env[b] += c * (x - env[b]);
+
+            const float level = dsp_power_to_db(env[b]);
+            const float over = level - p->threshold_db[b];
+            const float k = fminf(fmaxf(over + 0.5f * KNEE, 0.0f), KNEE);
+            const float comp = p->slope[b] * (k * k * (0.5f / KNEE) + fmaxf(over - 0.5f * KNEE, 0.0f));
+            const float expand = p->exp_slope[b] * fmaxf(p->exp_threshold_db[b] - level, 0.0f);
+            const float reduction = fminf(comp + expand, MULTIBAND_MAX_REDUCTION_DB);
+            peak[b] = fmaxf(peak[b], reduction);
+            target[b] = dsp_db_to_linear(p->makeup_db[b] - reduction);
+        }
+
+        // Sum the bands, each gain ramped from the last segment's
+        const float inv_n = 1.0f / (float)n;
+        for (int b = 0; b < bands; b++) {
+            const B *x = band[b] + s0;
+            const float g0 = gain[b];
+            const float step = (target[b] - g0) * inv_n;
+            if (b == 0) {
+                for (int i = 0; i < n; i++) {
+                    const float g = g0 + step * (float)(i + 1);
+                    acc[2 * i] = g * load_sample(x[2 * i]);
+                    acc[2 * i + 1] = g * load_sample(x[2 * i + 1]);
+                }
+            } else {
+                for (int i = 0; i < n; i++) {
+                    const float g = g0 + step * (float)(i + 1);
+                    acc[2 * i] += g * load_sample(x[2 * i]);
+                    acc[2 * i + 1] += g * load_sample(x[2 * i + 1]);
+                }
+            }
+        }
+        for (int i = 0; i < 2 * n; i++) {
+            store_sample(&out[s0 + i], acc[i]);
+        }
+        for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+            gain[b] = target[b];
+        }
+    }
+
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        st->envelope[b] = env[b];
+        st->gain[b] = gain[b];
+        st->reduction_db[b] = peak[b];
+    }
+}
+
+static void clear_history(multiband_t *mb)
+{
+    multiband_state_t *st = mb->state;
+    band_split_reset(&st->split);
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        st->envelope[b] = 0.0f;
+        st->gain[b] = 1.0f;
+    }
+}
+
+// Reduction of this block to the statistics and the meter
+static void DSP_HOT report(multiband_t *mb, int bands)
+{
+    const multiband_state_t *st = mb->state;
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        mb->reduction_db[b] = (b < bands) ? st->reduction_db[b] : 0.0f;
+    }
+    level_meter_band_reduction(st->reduction_db, bands);
+}
+
+bool DSP_HOT multiband_block_active(const multiband_t *multiband)
+{
+    return multiband->enabled && multiband->state != NULL;
+}
+
+DSP_HOT const multiband_params_t *multiband_begin_block(multiband_t *multiband)
+{
+    const multiband_params_t *p = &multiband->params[coeff_bank_acquire(&multiband->bank)];
+    if (multiband->reset_pending && multiband->state != NULL) {
+        multiband->reset_pending = false;
+        clear_history(multiband);
+    }
+    return p;
+}
+
+void DSP_HOT multiband_end_block(multiband_t *multiband)
+{
+    coeff_bank_release(&multiband->bank);
+}
+
+void DSP_HOT multiband_process_block(multiband_t *multiband, const multiband_params_t *params,
+                                     int32_t *buffer, int num_samples)
+{
+    multiband_state_t *st = multiband->state;
+    if (num_samples > DMA_BUFFER_SIZE) {
+        num_samples = DMA_BUFFER_SIZE;
+    }
+
+#if MULTIBAND_FLOAT_KERNEL
+    float *bands[MULTIBAND_MAX_BANDS];
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        bands[b] = st->bands.f32[b];
+    }
+    for (int i = 0; i < num_samples; i++) {
+        st->input[i] = (float)buffer[i];
+    }
+    band_split_process_f32(&params->split, &st->split, st->input, bands, num_samples);
+#else
+    int32_t *bands[MULTIBAND_MAX_BANDS];
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        bands[b] = st->bands.q24[b];
+    }
+    band_split_process(&params->split, &st->split, buffer, bands, num_samples);
+#endif
+    dynamics(st, params, bands, buffer, num_samples);
+    report(multiband, params->split.bands);
+}
+
+void DSP_HOT multiband_process(multiband_t *multiband, int32_t *buffer, int num_samples)
+{
+    if (!multiband_block_active(multiband)) {
+        return;  // Bypass
+    }
+
+    const multiband_params_t *p = multiband_begin_block(multiband);
+    multiband_process_block(multiband, p, buffer, num_samples);
+    multiband_end_block(multiband);
+}
+
+void DSP_HOT multiband_process_f32(multiband_t *multiband, float *buffer, int num_samples)
+{
+    if (!multiband_block_active(multiband)) {
+        return;  // Bypass
+    }
+    if (num_samples > DMA_BUFFER_SIZE) {
+        num_samples = DMA_BUFFER_SIZE;
+    }
+
+    const multiband_params_t *p = multiband_begin_block(multiband);
+    multiband_state_t *st = multiband->state;
+    float *bands[MULTIBAND_MAX_BANDS];
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        bands[b] = st->bands.f32[b];
+    }
+    band_split_process_f32(&p->split, &st->split, buffer, bands, num_samples);
+    dynamics(st, p, bands, buffer, num_samples);
+    report(multiband, p->split.bands);
+    multiband_end_block(multiband);
+}
+
+/* Control */
+
+// Envelope coefficient per segment for a time constant
+static float segment_coeff(float ms, uint32_t sample_rate)
+{
+    const float segments = ms * 0.001f * (float)sample_rate / (float)SEGMENT;
+    return 1.0f - expf(-1.0f / segments);
+}
+
+// Bake the whole parameter set from the configuration
+static void bake(const multiband_t *mb, multiband_params_t *p)
+{
+    const multiband_settings_t *cfg = &mb->config;
+    band_split_design(&p->split, cfg->num_bands, cfg->freq, mb->sample_rate);
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        const multiband_band_settings_t *band = &cfg->bands[b];
+        const bool used = b < cfg->num_bands;
+        // Unused bands are neutral: no reduction, no makeup
+        p->threshold_db[b] = band->threshold_db;
+        p->slope[b] = used ? 1.0f - 1.0f / band->ratio : 0.0f;
+        p->exp_threshold_db[b] = band->exp_threshold_db;
+        p->exp_slope[b] = used ? band->exp_ratio - 1.0f : 0.0f;
+        p->makeup_db[b] = used ? band->makeup_db : 0.0f;
+        p->attack[b] = segment_coeff(band->attack_ms, mb->sample_rate);
+        p->release[b] = segment_coeff(band->release_ms, mb->sample_rate);
+    }
+}
+
+static void publish(multiband_t *mb)
+{
+    multiband_params_t *p = (multiband_params_t *)coeff_bank_begin_write(
+        &mb->bank, mb->params, sizeof(multiband_params_t));
+    bake(mb, p);
+    coeff_bank_publish(&mb->bank);
+}
+
+static void clamp_band(multiband_band_settings_t *band)
+{
+    band->threshold_db = clampf(band->threshold_db, MULTIBAND_MIN_THRESHOLD_DB, MULTIBAND_MAX_THRESHOLD_DB);
+    band->ratio = clampf(band->ratio, MULTIBAND_MIN_RATIO, MULTIBAND_MAX_RATIO);
+    band->attack_ms = clampf(band->attack_ms, MULTIBAND_MIN_ATTACK_MS, MULTIBAND_MAX_ATTACK_MS);
+    band->release_ms = clampf(band->release_ms, MULTIBAND_MIN_RELEASE_MS, MULTIBAND_MAX_RELEASE_MS);
+    band->makeup_db = clampf(band->makeup_db, MULTIBAND_MIN_MAKEUP_DB, MULTIBAND_MAX_MAKEUP_DB);
+    band->exp_threshold_db = clampf(band->exp_threshold_db, MULTIBAND_MIN_EXP_THRESHOLD_DB,
+                                    MULTIBAND_MAX_EXP_THRESHOLD_DB);
+    band->exp_ratio = clampf(band->exp_ratio, MULTIBAND_MIN_EXP_RATIO, MULTIBAND_MAX_EXP_RATIO);
+}
+
+static void *alloc_prefer(size_t bytes, uint32_t first, uint32_t fallback)
+{
+    void *p = heap_caps_aligned_calloc(16, 1, bytes, first);
+    if (p == NULL) {
+        p = heap_caps_aligned_calloc(16, 1, bytes, fallback);
+    }
+    return p;
+}
+
+esp_err_t multiband_init(multiband_t *multiband, uint32_t sample_rate)
+{
+    memset(multiband, 0, sizeof(multiband_t));
+    coeff_bank_reset(&multiband->bank);
+    default_settings(&multiband->config);
+    multiband->sample_rate = sample_rate;
+    bake(multiband, &multiband->params[0]);
+    multiband->reset_pending = true;
+
+    // Read every block: internal RAM if it fits
+    multiband_state_t *st = (multiband_state_t *)alloc_prefer(
+        sizeof(multiband_state_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM);
+    if (st == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes of multiband state, bypassed",
+                 (unsigned)sizeof(multiband_state_t));
+        return ESP_ERR_NO_MEM;
+    }
+    multiband->state = st;
+    clear_history(multiband);
+
+    ESP_LOGI(TAG, "Multiband dynamics: up to %d bands, %d-frame segments (%u bytes of state)",
+             MULTIBAND_MAX_BANDS, SEGMENT, (unsigned)sizeof(multiband_state_t));
+    return ESP_OK;
+}
+
+void multiband_set_sample_rate(multiband_t *multiband, uint32_t sample_rate)
+{
+    multiband->sample_rate = sample_rate;
+    publish(multiband);
+    multiband->reset_pending = true;
+}
+
+void multiband_set_enabled(multiband_t *multiband, bool enabled)
+{
+    if (enabled && !multiband->enabled) {
+        coeff_bank_set_flag(&multiband->reset_pending, true);
+    }
+    coeff_bank_set_flag(&multiband->enabled, enabled);
+    multiband->config.enabled = enabled ? 1 : 0;
+    if (!enabled) {
+        for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+            multiband->reduction_db[b] = 0.0f;
+        }
+    }
+}
+
+bool multiband_set_bands(multiband_t *multiband, int bands)
+{
+    if (bands < MULTIBAND_MIN_BANDS || bands > MULTIBAND_MAX_BANDS) {
+        return false;
+    }
+    // Points that come into use may be out of order: sorted when applied
+    multiband_settings_t settings = multiband->config;
+    settings.num_bands = (uint8_t)bands;
+    multiband_apply_settings(multiband, &settings);
+    return true;
+}
+
+static bool freq_valid(const multiband_t *mb, int point, float freq)
+{
+    const int points = mb->config.num_bands - 1;
+    if (point < 0 || point >= points) {
+        return false;
+    }
+    if (freq < MULTIBAND_MIN_FREQ || freq > MULTIBAND_MAX_FREQ ||
+        freq > BAND_SPLIT_MAX_FREQ_RATIO * (float)mb->sample_rate) {
+        return false;
+    }
+    if (point > 0 && freq <= mb->config.freq[point - 1]) {
+        return false;
+    }
+    if (point < points - 1 && freq >= mb->config.freq[point + 1]) {
+        return false;
+    }
+    return true;
+}
+
+bool multiband_set_freq(multiband_t *multiband, int point, float freq)
+{
+    if (!freq_valid(multiband, point, freq)) {
+        return false;
+    }
+    multiband->config.freq[point] = freq;
+    publish(multiband);
+    return true;
+}
+
+bool multiband_set_band(multiband_t *multiband, int band, const multiband_band_settings_t *settings)
+{
+    if (band < 0 || band >= MULTIBAND_MAX_BANDS) {
+        return false;
+    }
+    multiband_band_settings_t b = *settings;
+    clamp_band(&b);
+    multiband->config.bands[band] = b;
+    publish(multiband);
+    return true;
+}
+
+void multiband_reset(multiband_t *multiband)
+{
+    coeff_bank_set_flag(&multiband->reset_pending, true);
+}
+
+void multiband_get_settings(const multiband_t *multiband, multiband_settings_t *settings)
+{
+    *settings = multiband->config;
+}
+
+void multiband_apply_settings(multiband_t *multiband, const multiband_settings_t *settings)
+{
+    multiband_settings_t *cfg = &multiband->config;
+    int bands = settings->num_bands;
+    if (bands < MULTIBAND_MIN_BANDS || bands > MULTIBAND_MAX_BANDS) {
+        ESP_LOGW(TAG, "Settings for %d bands ignored, keeping %u", bands, (unsigned)cfg->num_bands);
+        bands = cfg->num_bands;
+    }
+    if (bands != cfg->num_bands) {
+        coeff_bank_set_flag(&multiband->reset_pending, true);
+    }
+    cfg->num_bands = (uint8_t)bands;
+
+    // Clamp, then restore the order (the band split relies on it)
+    float freq[MULTIBAND_MAX_BANDS - 1];
+    for (int i = 0; i < MULTIBAND_MAX_BANDS - 1; i++) {
+        freq[i] = clampf(settings->freq[i], MULTIBAND_MIN_FREQ, MULTIBAND_MAX_FREQ);
+    }
+    for (int i = 1; i < bands - 1; i++) {
+        for (int j = i; j > 0 && freq[j] < freq[j - 1]; j--) {
+            const float t = freq[j];
+            freq[j] = freq[j - 1];
+            freq[j - 1] = t;
+        }
+    }
+    for (int i = 0; i < MULTIBAND_MAX_BANDS - 1; i++) {
+        cfg->freq[i] = freq[i];
+    }
+
+    for (int b = 0; b < MULTIBAND_MAX_BANDS; b++) {
+        cfg->bands[b] = settings->bands[b];
+        clamp_band(&cfg->bands[b]);
+    }
+    publish(multiband);
+    multiband_set_enabled(multiband, settings->enabled != 0);
+}
+
+#else
+
+void multiband_set_enabled(multiband_t *multiband, bool enabled) {}
+bool multiband_set_bands(multiband_t *multiband, int bands) { return false; }
+bool multiband_set_freq(multiband_t *multiband, int point, float freq) { return false; }
+
+bool multiband_set_band(multiband_t *multiband, int band, const multiband_band_settings_t *settings)
+{
+    return false;
+}
+
+void multiband_reset(multiband_t *multiband) {}
+
+void multiband_get_settings(const multiband_t *multiband, multiband_settings_t *settings)
+{
+    // The defaults of a build with the processor, so switching builds keeps them
+    default_settings(settings);
+}
+
+void multiband_apply_settings(multiband_t *multiband, const multiband_settings_t *settings) {}
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef MULTIBAND_H
+#define MULTIBAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_config.h"
+#include "band_split.h"
+#include "coeff_bank.h"
+#include "equalizer.h"
+
+// Multiband dynamics processor
+// Splits the signal into 2 to MULTIBAND_MAX_BANDS bands with the band split
+// of the crossover (band_split.h: one Linkwitz-Riley tree, the bands sum back
+// flat), runs a soft-knee compressor and a downward expander on each band
+// and sums the bands again. Runs in the chain between the convolver and the
+// limiter, on whole blocks, with the equalizer's filter kernel (the esp-dsp
+// stereo float biquad with CONFIG_EQ_SIMD_KERNEL, the Q24 biquad otherwise).
+//
+// Detection is per segment of MULTIBAND_SEGMENT_FRAMES frames: the stereo
+// linked mean square of each band drives a power envelope (attack / release),
+// whose level in dB goes through the knee and expander curves. The gain
+// computer works on fixed arrays of MULTIBAND_MAX_BANDS without branches, so
+// each step is one short loop over the bands; the log and exp conversions
+// are table lookups (dsp_power_to_db, dsp_db_to_linear). The band gain is
+// ramped linearly across the segment. The largest gain reduction of each
+// band per metering window is published through the level meter mailbox.
+
+#ifdef CONFIG_MULTIBAND
+#define MULTIBAND_ENABLED           1
+#else
+#define MULTIBAND_ENABLED           0
+#endif
+
+// Filter kernel: follows the equalizer's
+#define MULTIBAND_FLOAT_KERNEL      EQUALIZER_BLOCK_KERNEL
+
+#define MULTIBAND_MAX_BANDS         BAND_SPLIT_MAX_BANDS
+#define MULTIBAND_MIN_BANDS         2
+#define MULTIBAND_DEFAULT_BANDS     3
+
+// Frames per gain computer step
+#define MULTIBAND_SEGMENT_FRAMES    16
+
+// Parameter ranges
+#define MULTIBAND_MIN_FREQ          40.0f
+#define MULTIBAND_MAX_FREQ          16000.0f
+#define MULTIBAND_MIN_THRESHOLD_DB  -60.0f
+#define MULTIBAND_MAX_THRESHOLD_DB  0.0f
+#define MULTIBAND_MIN_RATIO         1.0f
+#define MULTIBAND_MAX_RATIO         20.0f
+#define MULTIBAND_MIN_ATTACK_MS     0.5f
+#define MULTIBAND_MAX_ATTACK_MS     200.0f
+#define MULTIBAND_MIN_RELEASE_MS    5.0f
+#define MULTIBAND_MAX_RELEASE_MS    2000.0f
+#define MULTIBAND_MIN_MAKEUP_DB     0.0f
+#define MULTIBAND_MAX_MAKEUP_DB     24.0f
+#define MULTIBAND_MIN_EXP_THRESHOLD_DB  -96.0f
+#define MULTIBAND_MAX_EXP_THRESHOLD_DB  -20.0f
+#define MULTIBAND_MIN_EXP_RATIO     1.0f
+#define MULTIBAND_MAX_EXP_RATIO     4.0f
+
+// Compressor knee width (centred on the threshold)
+#define MULTIBAND_KNEE_DB           6.0f
+
+// Largest gain reduction of one band (compressor and expander together)
+#define MULTIBAND_MAX_REDUCTION_DB  40.0f
+
+// Parameters read by the audio path (double-buffered, see coeff_bank.h).
+// Per-band arrays are filled for all MULTIBAND_MAX_BANDS (unused bands
+// neutral), so the gain computer loops have a fixed length.
+typedef struct {
+    band_split_coeffs_t split;
+    float threshold_db[MULTIBAND_MAX_BANDS];
+    float slope[MULTIBAND_MAX_BANDS];                   // 1 - 1 / ratio
+    float exp_threshold_db[MULTIBAND_MAX_BANDS];
+    float exp_slope[MULTIBAND_MAX_BANDS];              // Expander ratio - 1
+    float makeup_db[MULTIBAND_MAX_BANDS];
+    float attack[MULTIBAND_MAX_BANDS];                 // Envelope coefficients per segment
+    float release[MULTIBAND_MAX_BANDS];
+} multiband_params_t;
+
+// Audio state (allocated by multiband_init)
+typedef struct {
+    union {
+        int32_t q24[MULTIBAND_MAX_BANDS][DMA_BUFFER_SIZE];     // Q24 kernel
+        float f32[MULTIBAND_MAX_BANDS][DMA_BUFFER_SIZE];       // Float kernel and float chain
+    } bands __attribute__((aligned(16)));
+    float input[DMA_BUFFER_SIZE] __attribute__((aligned(16)));  // Int chain with the float kernel
+    band_split_state_t split;
+    float envelope[MULTIBAND_MAX_BANDS];               // Mean square, full scale = 1
+    float gain[MULTIBAND_MAX_BANDS];                   // Band gain at the end of the last segment
+    float reduction_db[MULTIBAND_MAX_BANDS];           // Largest reduction of the current block
+} multiband_state_t;
+
+// Persistent configuration of one band
+typedef struct {
+    float threshold_db;                     // Compressor threshold, dBFS
+    float ratio;                            // Compression ratio (1 = off)
+    float attack_ms;
+    float release_ms;
+    float makeup_db;                        // Gain after compression
+    float exp_threshold_db;                 // Expander threshold, dBFS
+    float exp_ratio;                        // Expansion ratio (1 = off)
+} multiband_band_settings_t;
+
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float freq[MULTIBAND_MAX_BANDS - 1];                // Split points in Hz, ascending
+    multiband_band_settings_t bands[MULTIBAND_MAX_BANDS];
+    uint8_t enabled;
+    uint8_t num_bands;
+    uint8_t reserved[2];
+} multiband_settings_t;
+
+// Multiband structure
+typedef struct {
+    multiband_params_t params[2];           // Published / shadow parameter sets
+    coeff_bank_t bank;                      // Publish state for params
+    multiband_settings_t config;            // Current configuration (control side)
+    uint32_t sample_rate;                   // Rate the parameters are designed for
+    bool enabled;                           // Enable/disable processing
+    volatile bool reset_pending;            // Clear filter and envelope history at the next block
+    multiband_state_t *state;               // NULL until multiband_init succeeded (bypassed)
+    volatile float reduction_db[MULTIBAND_MAX_BANDS];  // Reduction of the last block (statistics)
+} multiband_t;
+
+#if MULTIBAND_ENABLED
+
+/**
+ * Initialize the multiband processor (disabled, default bands) and allocate
+ * its state
+ *
+ * @param multiband Pointer to multiband structure
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK or ESP_ERR_NO_MEM (the processor then stays bypassed)
+ */
+esp_err_t multiband_init(multiband_t *multiband, uint32_t sample_rate);
+
+/**
+ * Redesign the band split and time constants for a new sample rate
+ * (between blocks)
+ *
+ * @param multiband Pointer to multiband structure
+ * @param sample_rate New rate in Hz
+ */
+void multiband_set_sample_rate(multiband_t *multiband, uint32_t sample_rate);
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ *
+ * Must be paired with multiband_end_block.
+ *
+ * @param multiband Pointer to multiband structure
+ * @return Parameters to use for this block
+ */
+const multiband_params_t *multiband_begin_block(multiband_t *multiband);
+
+/**
+ * Release the parameters latched by multiband_begin_block (audio task only)
+ *
+ * @param multiband Pointer to multiband structure
+ */
+void multiband_end_block(multiband_t *multiband);
+
+/**
+ * Check whether blocks are processed
+ *
+ * @param multiband Pointer to multiband structure
+ * @return true if enabled and the state is allocated
+ */
+bool multiband_block_active(const multiband_t *multiband);
+
+/**
+ * Process one block with latched parameters (24-bit samples, in place)
+ *
+ * Shared by multiband_process and the fused DSP chain.
+ *
+ * @param multiband Pointer to multiband structure
+ * @param params Parameters from multiband_begin_block
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void multiband_process_block(multiband_t *multiband, const multiband_params_t *params,
+                             int32_t *buffer, int num_samples);
+
+/**
+ * Process audio through the multiband processor
+ *
+ * @param multiband Pointer to multiband structure
+ * @param buffer Audio buffer (interleaved stereo: L, R, L, R, ...)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void multiband_process(multiband_t *multiband, int32_t *buffer, int num_samples);
+
+/**
+ * Process a float block through the multiband processor (float32 chain)
+ *
+ * @param multiband Pointer to multiband structure
+ * @param buffer Audio buffer (interleaved stereo, 24-bit scale)
+ * @param num_samples Number of samples (total, at most DMA_BUFFER_SIZE)
+ */
+void multiband_process_f32(multiband_t *multiband, float *buffer, int num_samples);
+
+#else
+
+static inline esp_err_t multiband_init(multiband_t *multiband, uint32_t sample_rate) { (void)multiband; (void)sample_rate; return ESP_OK; }
+static inline void multiband_set_sample_rate(multiband_t *multiband, uint32_t sample_rate) { (void)multiband; (void)sample_rate; }
+
+#endif
+
+/**
+ * Enable or disable the processor (enabling starts from a clear history)
+ *
+ * @param multiband Pointer to multiband structure
+ * @param enabled true to enable, false to bypass
+ */
+void multiband_set_enabled(multiband_t *multiband, bool enabled);
+
+/**
+ * Set the number of bands
+ *
+ * The points and band settings are kept (points that come into use are
+ * sorted in).
+ *
+ * @param multiband Pointer to multiband structure
+ * @param bands MULTIBAND_MIN_BANDS to MULTIBAND_MAX_BANDS
+ * @return true if successful, false if out of range or compiled out
+ */
+bool multiband_set_bands(multiband_t *multiband, int bands);
+
+/**
+ * Set a split point
+ *
+ * @param multiband Pointer to multiband structure
+ * @param point 0 to bands - 2
+ * @param freq Frequency in Hz (MULTIBAND_MIN_FREQ..MULTIBAND_MAX_FREQ, below 45% of the sample rate)
+ * @return true if successful, false if out of range, not above the point
+ *         below or not below the point above, or compiled out
+ */
+bool multiband_set_freq(multiband_t *multiband, int point, float freq);
+
+/**
+ * Configure the dynamics of one band
+ *
+ * Values are clamped to the MULTIBAND_MIN_* / MULTIBAND_MAX_* ranges.
+ *
+ * @param multiband Pointer to multiband structure
+ * @param band 0 (lowest) to MULTIBAND_MAX_BANDS - 1
+ * @param settings Band settings
+ * @return true if successful, false if the band is invalid or compiled out
+ */
+bool multiband_set_band(multiband_t *multiband, int band, const multiband_band_settings_t *settings);
+
+/**
+ * Clear the filter and envelope history (next block)
+ *
+ * @param multiband Pointer to multiband structure
+ */
+void multiband_reset(multiband_t *multiband);
+
+/**
+ * Copy the persistent settings
+ *
+ * @param multiband Pointer to multiband structure
+ * @param settings Destination
+ */
+void multiband_get_settings(const multiband_t *multiband, multiband_settings_t *settings);
+
+/**
+ * Apply persistent settings
+ *
+ * Values are clamped and the points sorted.
+ *
+ * @param multiband Pointer to multiband structure
+ * @param settings Settings from multiband_get_settings
+ */
+void multiband_apply_settings(multiband_t *multiband, const multiband_settings_t *settings);
+
+#endif // MULTIBAND_H
@@ -0,0 +1,92 @@
+#ifndef PARAM_RAMP_H
+#define PARAM_RAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "dsp_attr.h"
+
+// Parameter smoothing
+// A published gain or coefficient change is not applied in one step: the
+// audio task moves from the old value to the new one over PARAM_RAMP_FRAMES
+// stereo frames. The new target is computed once by the control task, so the
+// ramp itself is only linear interpolation (no powf/cosf in the audio path),
+// and a module that is not ramping runs exactly its steady-state code.
+
+#ifdef CONFIG_DSP_PARAM_RAMP_FRAMES
+#define PARAM_RAMP_FRAMES           CONFIG_DSP_PARAM_RAMP_FRAMES
+#else
+#define PARAM_RAMP_FRAMES           480     // 10ms at 48kHz
+#endif
+
+// Filter coefficients are re-interpolated once per segment instead of every frame
+#define PARAM_RAMP_SEGMENT_FRAMES   32
+#define PARAM_RAMP_SEGMENTS         ((PARAM_RAMP_FRAMES + PARAM_RAMP_SEGMENT_FRAMES - 1) / PARAM_RAMP_SEGMENT_FRAMES)
+
+// Linear ramp for a single scalar (audio task only)
+typedef struct {
+    float value;        // Value applied to the most recent frame
+    float target;       // Value the ramp is heading to
+    float step;         // Increment per frame
+    int frames_left;    // Frames until value == target (0 = settled)
+} param_ramp_t;
+
+/**
+ * Set a ramp to a settled value
+ *
+ * @param ramp Pointer to ramp
+ * @param value Initial value
+ */
+static inline void param_ramp_init(param_ramp_t *ramp, float value)
+{
+    ramp->value = value;
+    ramp->target = value;
+    ramp->step = 0.0f;
+    ramp->frames_left = 0;
+}
+
+/**
+ * Point the ramp at the latest published value (call once per block)
+ *
+ * Starts a new ramp from the current value when the target changed,
+ * including in the middle of a ramp.
+ *
+ * @param ramp Pointer to ramp
+ * @param target Published target value
+ * @return true while a ramp is in progress (use param_ramp_next per frame)
+ */
+static DSP_HOT_INLINE bool param_ramp_retarget(param_ramp_t *ramp, float target)
+{
+    if (target != ramp->target) {
+        ramp->target = target;
+        if (PARAM_RAMP_FRAMES > 0) {
+            ramp->step = (target - ramp->value) / (float)PARAM_RAMP_FRAMES;
+            ramp->frames_left = PARAM_RAMP_FRAMES;
+        } else {
+            ramp->value = target;
+        }
+    }
+    return ramp->frames_left > 0;
+}
+
+/**
+ * Advance the ramp by one frame
+ *
+ * Lands exactly on the target on the last frame and stays there.
+ *
+ * @param ramp Pointer to ramp
+ * @return Value to apply to this frame
+ */
+static DSP_HOT_INLINE float param_ramp_next(param_ramp_t *ramp)
+{
+    if (ramp->frames_left > 0) {
+        if (--ramp->frames_left == 0) {
+            ramp->value = ramp->target;
+        } else {
+            ramp->value += ramp->step;
+        }
+    }
+    return ramp->value;
+}
+
+#endif // PARAM_RAMP_H
@@ -0,0 +1,176 @@
+#include "persist.h"
+#include "settings_blob.h"
+#include "audio_rate.h"
+#include "audio_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "PERSIST";
+
+static const char *s_module_names[PERSIST_MODULE_COUNT] = {
+    "subsonic", "pregain", "eq", "limiter", "conv", "xover", "mb", "delay",
+};
+
+static TaskHandle_t s_task = NULL;
+
+// One blob write at a time (task, explicit saves and flushes)
+static SemaphoreHandle_t s_write_lock = NULL;
+
+// Dirty bits and counters, set from the command tasks
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_dirty = 0;
+static uint32_t s_changes = 0;
+static uint32_t s_writes = 0;
+static uint32_t s_errors = 0;
+
+// Write the settings blob (write lock held). All modules are written
+// together; on failure the given modules stay dirty and are retried with the
+// next change.
+static esp_err_t save_modules(uint32_t modules)
+{
+    if (modules == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = settings_blob_save(audio_rate_get());
+
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK) {
+        s_writes++;
+    } else {
+        s_errors++;
+        s_dirty |= modules;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save settings: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static uint32_t take_dirty(uint32_t mask)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t modules = s_dirty & mask;
+    s_dirty &= ~mask;
+    portEXIT_CRITICAL(&s_lock);
+    return modules;
+}
+
+static void persist_task(void *pvParameters)
+{
+    const TickType_t quiet = pdMS_TO_TICKS(CONFIG_PERSIST_QUIET_MS);
+    const TickType_t max_delay = pdMS_TO_TICKS(CONFIG_PERSIST_MAX_DELAY_MS);
+
+    while (1) {
+        // Wait for the first change
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const TickType_t first = xTaskGetTickCount();
+
+        // Every further change restarts the quiet period, up to max_delay
+        while (1) {
+            const TickType_t elapsed = xTaskGetTickCount() - first;
+            if (elapsed >= max_delay) {
+                break;
+            }
+            const TickType_t wait = (max_delay - elapsed < quiet) ? max_delay - elapsed : quiet;
+            if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+                break;
+            }
+        }
+
+        xSemaphoreTake(s_write_lock, portMAX_DELAY);
+        const uint32_t modules = take_dirty(UINT32_MAX);
+        if (modules != 0) {
+            save_modules(modules);
+            ESP_LOGD(TAG, "Saved modules 0x%02lx", (unsigned long)modules);
+        }
+        xSemaphoreGive(s_write_lock);
+    }
+}
+
+esp_err_t persist_init(void)
+{
+    s_write_lock = xSemaphoreCreateMutex();
+    if (s_write_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create write lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t created = xTaskCreate(persist_task, "persist", 3072, NULL, tskIDLE_PRIORITY + 1, &s_task);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create persistence task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Changes marked before the task existed
+    if (s_dirty != 0) {
+        xTaskNotifyGive(s_task);
+    }
+
+    ESP_LOGI(TAG, "Settings saved %d ms after the last change (at most %d ms)",
+             CONFIG_PERSIST_QUIET_MS, CONFIG_PERSIST_MAX_DELAY_MS);
+    return ESP_OK;
+}
+
+void persist_mark_dirty(persist_module_t module)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_dirty |= (1u << module);
+    s_changes++;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+esp_err_t persist_save_now(persist_module_t module)
+{
+    if (module >= PERSIST_MODULE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_write_lock != NULL) {
+        xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    }
+    // The blob holds every module, so pending changes of the others go too
+    esp_err_t err = save_modules(take_dirty(UINT32_MAX) | (1u << module));
+    if (s_write_lock != NULL) {
+        xSemaphoreGive(s_write_lock);
+    }
+    return err;
+}
+
+esp_err_t persist_flush(void)
+{
+    if (s_write_lock != NULL) {
+        xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    }
+    esp_err_t err = save_modules(take_dirty(UINT32_MAX));
+    if (s_write_lock != NULL) {
+        xSemaphoreGive(s_write_lock);
+    }
+    return err;
+}
+
+const char *persist_module_name(persist_module_t module)
+{
+    if (module >= PERSIST_MODULE_COUNT) {
+        return "?";
+    }
+    return s_module_names[module];
+}
+
+void persist_get_stats(persist_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    stats->running = (s_task != NULL);
+    stats->pending = s_dirty;
+    stats->changes = s_changes;
+    stats->writes = s_writes;
+    stats->errors = s_errors;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,89 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Debounced settings persistence
+// Commands only mark a module dirty; a low-priority task writes the settings
+// blob (settings_blob.h) once no change has arrived for CONFIG_PERSIST_QUIET_MS (and no
+// later than CONFIG_PERSIST_MAX_DELAY_MS after the first change). A slider
+// drag over MQTT then costs one NVS commit instead of dozens per
+// second, and the flash erase/write stalls (cache disabled on both cores)
+// move out of the MQTT and serial command handlers.
+
+// Modules with persistent settings
+typedef enum {
+    PERSIST_SUBSONIC = 0,
+    PERSIST_PREGAIN,
+    PERSIST_EQUALIZER,
+    PERSIST_LIMITER,
+    PERSIST_CONVOLVER,
+    PERSIST_CROSSOVER,
+    PERSIST_MULTIBAND,
+    PERSIST_DELAY,
+    PERSIST_MODULE_COUNT
+} persist_module_t;
+
+typedef struct {
+    bool running;               // Persistence task started
+    uint32_t pending;           // Dirty modules (bit per persist_module_t)
+    uint32_t changes;           // persist_mark_dirty calls
+    uint32_t writes;            // Settings blob writes performed
+    uint32_t errors;            // Blob writes that failed (retried on the next change)
+} persist_stats_t;
+
+/**
+ * Start the persistence task
+ *
+ * Changes marked before this are written after the first quiet period.
+ *
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t persist_init(void);
+
+/**
+ * Schedule a module's settings to be saved
+ *
+ * Cheap and non-blocking; safe from any task.
+ *
+ * @param module Module whose settings changed
+ */
+void persist_mark_dirty(persist_module_t module);
+
+/**
+ * Save a module now, in the calling task
+ *
+ * For explicit save commands. The blob holds all modules, so this also
+ * writes (and cancels the debounced save of) every other pending change.
+ *
+ * @param module Module to save
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t persist_save_now(persist_module_t module);
+
+/**
+ * Write all dirty modules now, in the calling task
+ *
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t persist_flush(void);
+
+/**
+ * Get the printable name of a module
+ *
+ * @param module Module
+ * @return Name such as "eq"
+ */
+const char *persist_module_name(persist_module_t module);
+
+/**
+ * Get persistence counters
+ *
+ * @param stats Destination
+ */
+void persist_get_stats(persist_stats_t *stats);
+
+#endif // PERSIST_H
@@ -3,6 +3,7 @@
 #include <math.h>
 #include <nvs.h>
 #include "esp_log.h"
+#include "dsp_tables.h"
 
 // NVS storage keys
 #define NVS_NAMESPACE "pregain_conf"
@@ -14,10 +15,14 @@ static const char *TAG = "PREGAIN";
 void pregain_init(pregain_t *pregain)
 {
     memset(pregain, 0, sizeof(pregain_t));
+    coeff_bank_reset(&pregain->bank);
     
     // Set default gain to 0dB (unity gain)
     pregain->gain_db = PREGAIN_DEFAULT_DB;
     pregain->gain_linear = 1.0f;  // 0dB = 10^(0/20) = 1.0
+    pregain->params[0].gain_linear = 1.0f;
+    pregain->params[0].unity = true;
+    param_ramp_init(&pregain->ramp, 1.0f);
     pregain->enabled = true;
 }
 
@@ -30,7 +35,14 @@ bool pregain_set_gain(pregain_t *pregain, float gain_db)
     pregain->gain_db = gain_db;
     
     // Convert dB to linear gain: linear = 10^(dB/20)
-    pregain->gain_linear = powf(10.0f, gain_db / 20.0f);
+    pregain->gain_linear = dsp_db_to_linear(gain_db);
+    
+    // Publish to the audio path
+    pregain_params_t *p = (pregain_params_t *)coeff_bank_begin_write(
+        &pregain->bank, pregain->params, sizeof(pregain_params_t));
+    p->gain_linear = pregain->gain_linear;
+    p->unity = (gain_db == 0.0f);
+    coeff_bank_publish(&pregain->bank);
     
     return true;
 }
@@ -40,32 +52,74 @@ float pregain_get_gain(pregain_t *pregain)
     return pregain->gain_db;
 }
 
-void pregain_process(pregain_t *pregain, int32_t *buffer, int num_samples)
+void DSP_HOT pregain_process(pregain_t *pregain, int32_t *buffer, int num_samples)
 {
     if (!pregain->enabled) {
         return;  // Bypass
     }
     
-    // If gain is 0dB (unity gain), skip processing
-    if (pregain->gain_db == 0.0f) {
-        return;
+    const pregain_params_t *p = pregain_begin_block(pregain);
+    
+    if (pregain_ramp_begin(pregain, p)) {
+        // Glide to the new gain one frame at a time (both channels share a step)
+        param_ramp_t ramp = pregain->ramp;
+        for (int i = 0; i < num_samples; i += 2) {
+            const float gain_linear = param_ramp_next(&ramp);
+            buffer[i] = pregain_apply_sample(gain_linear, buffer[i]);
+            buffer[i + 1] = pregain_apply_sample(gain_linear, buffer[i + 1]);
+        }
+        pregain->ramp = ramp;
+    } else if (!p->unity) {
+        // Steady state (at 0dB / unity gain processing is skipped)
+        // Apply gain to all samples
+        const float gain_linear = p->gain_linear;
+        for (int i = 0; i < num_samples; i++) {
+            buffer[i] = pregain_apply_sample(gain_linear, buffer[i]);
+        }
     }
     
-    // Apply gain to all samples
-    for (int i = 0; i < num_samples; i++) {
-        int64_t temp = (int64_t)(buffer[i] * pregain->gain_linear);
-        
-        // Clamp to prevent overflow
-        if (temp > 2147483647LL) temp = 2147483647LL;
-        if (temp < -2147483648LL) temp = -2147483648LL;
-        
-        buffer[i] = (int32_t)temp;
+    pregain_end_block(pregain);
+}
+
+void DSP_HOT pregain_process_f32(pregain_t *pregain, float *buffer, int num_samples)
+{
+    if (!pregain->enabled) {
+        return;  // Bypass
     }
+    
+    const pregain_params_t *p = pregain_begin_block(pregain);
+    
+    if (pregain_ramp_begin(pregain, p)) {
+        param_ramp_t ramp = pregain->ramp;
+        for (int i = 0; i < num_samples; i += 2) {
+            const float gain_linear = param_ramp_next(&ramp);
+            buffer[i] *= gain_linear;
+            buffer[i + 1] *= gain_linear;
+        }
+        pregain->ramp = ramp;
+    } else if (!p->unity) {
+        const float gain_linear = p->gain_linear;
+        for (int i = 0; i < num_samples; i++) {
+            buffer[i] *= gain_linear;
+        }
+    }
+    
+    pregain_end_block(pregain);
+}
+
+DSP_HOT const pregain_params_t *pregain_begin_block(pregain_t *pregain)
+{
+    return &pregain->params[coeff_bank_acquire(&pregain->bank)];
+}
+
+void DSP_HOT pregain_end_block(pregain_t *pregain)
+{
+    coeff_bank_release(&pregain->bank);
 }
 
 void pregain_set_enabled(pregain_t *pregain, bool enabled)
 {
-    pregain->enabled = enabled;
+    coeff_bank_set_flag(&pregain->enabled, enabled);
 }
 
 bool pregain_is_enabled(pregain_t *pregain)
@@ -73,45 +127,44 @@ bool pregain_is_enabled(pregain_t *pregain)
     return pregain->enabled;
 }
 
-esp_err_t pregain_save_settings(pregain_t *pregain)
+void pregain_get_settings(const pregain_t *pregain, pregain_settings_t *settings)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-    
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    // Save enabled state
-    err = nvs_set_u8(nvs_handle, NVS_KEY_ENABLED, pregain->enabled ? 1 : 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving enabled state: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
+    memset(settings, 0, sizeof(*settings));
+    settings->gain_db = pregain->gain_db;
+    settings->enabled = pregain->enabled ? 1 : 0;
+}
+
+void pregain_apply_settings(pregain_t *pregain, const pregain_settings_t *settings)
+{
+    pregain_set_gain(pregain, settings->gain_db);
+    coeff_bank_set_flag(&pregain->enabled, settings->enabled != 0);
+}
+
+void pregain_bake_params(const pregain_settings_t *settings, pregain_params_t *params)
+{
+    float gain_db = settings->gain_db;
+    if (gain_db < PREGAIN_MIN_DB) gain_db = PREGAIN_MIN_DB;
+    if (gain_db > PREGAIN_MAX_DB) gain_db = PREGAIN_MAX_DB;
     
-    // Save gain (convert float to int32 to store in NVS)
-    int32_t gain_fixed = (int32_t)(pregain->gain_db * 100.0f);
-    err = nvs_set_i32(nvs_handle, NVS_KEY_GAIN, gain_fixed);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving gain: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
+    memset(params, 0, sizeof(*params));
+    params->gain_linear = dsp_db_to_linear(gain_db);
+    params->unity = (gain_db == 0.0f);
+}
+
+void pregain_apply_baked(pregain_t *pregain, const pregain_settings_t *settings,
+                         const pregain_params_t *params, bool crossfade)
+{
+    pregain->gain_db = settings->gain_db;
+    pregain->gain_linear = params->gain_linear;
     
-    // Commit changes to flash
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing to NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Pre-gain settings saved to flash");
-    }
+    pregain_params_t *p = (pregain_params_t *)coeff_bank_begin_write(
+        &pregain->bank, pregain->params, sizeof(pregain_params_t));
+    const uint8_t cut = p->cut;
+    *p = *params;
+    p->cut = crossfade ? cut : (uint8_t)(cut + 1);
+    coeff_bank_publish(&pregain->bank);
     
-    nvs_close(nvs_handle);
-    return err;
+    coeff_bank_set_flag(&pregain->enabled, settings->enabled != 0);
 }
 
 esp_err_t pregain_load_settings(pregain_t *pregain)
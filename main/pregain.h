@@ -4,19 +4,41 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "coeff_bank.h"
+#include "param_ramp.h"
+#include "dsp_attr.h"
 
 // Pre-gain configuration
 #define PREGAIN_MIN_DB          -12.0f     // Minimum pre-gain in dB
 #define PREGAIN_MAX_DB          12.0f      // Maximum pre-gain in dB
 #define PREGAIN_DEFAULT_DB      0.0f       // Default pre-gain in dB (unity gain)
 
-// Pre-gain structure
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
 typedef struct {
+    float gain_linear;                      // Linear gain multiplier
+    bool unity;                             // Gain is exactly 0dB (processing skipped)
+    uint8_t cut;                            // Bumped to take gain_linear without a ramp
+} pregain_params_t;
+
+// Pre-gain structure (audio task fields first, see dsp_attr.h)
+typedef struct {
+    pregain_params_t params[2] __attribute__((aligned(16)));    // Published / shadow parameter sets
+    param_ramp_t ramp;                      // Gain actually applied (audio task only)
+    uint8_t cut_seen;                       // params cut last taken (audio task only)
+    coeff_bank_t bank;                      // Publish state for params
+    // Control side
     float gain_db;                          // Gain in dB (-12.0 to +12.0)
     float gain_linear;                      // Linear gain multiplier (calculated from gain_db)
     bool enabled;                           // Enable/disable pre-gain
 } pregain_t;
 
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float gain_db;                          // Gain in dB
+    uint8_t enabled;                        // Pre-gain enabled
+    uint8_t reserved[3];
+} pregain_settings_t;
+
 /**
  * Initialize pre-gain with default settings (0dB = unity gain)
  * 
@@ -41,6 +63,63 @@ bool pregain_set_gain(pregain_t *pregain, float gain_db);
  */
 float pregain_get_gain(pregain_t *pregain);
 
+/**
+ * Apply a linear gain to one sample with saturation
+ * 
+ * Shared by pregain_process and the fused DSP chain.
+ * 
+ * @param gain_linear Linear gain multiplier
+ * @param sample Input sample
+ * @return Scaled and clamped sample
+ */
+static DSP_HOT_INLINE int32_t pregain_apply_sample(float gain_linear, int32_t sample)
+{
+    int64_t temp = (int64_t)(sample * gain_linear);
+    
+    // Clamp to prevent overflow
+    if (temp > 2147483647LL) temp = 2147483647LL;
+    if (temp < -2147483648LL) temp = -2147483648LL;
+    
+    return (int32_t)temp;
+}
+
+/**
+ * Point the gain ramp at the published gain (audio task only, once per block)
+ * 
+ * A set published by pregain_apply_baked without crossfade is taken at
+ * once. Shared by pregain_process, pregain_process_f32 and the fused chain.
+ * 
+ * @param pregain Pointer to pre-gain structure
+ * @param p Parameters returned by pregain_begin_block
+ * @return true while a ramp is in progress (use param_ramp_next per frame)
+ */
+static DSP_HOT_INLINE bool pregain_ramp_begin(pregain_t *pregain, const pregain_params_t *p)
+{
+    if (p->cut != pregain->cut_seen) {
+        pregain->cut_seen = p->cut;
+        param_ramp_init(&pregain->ramp, p->gain_linear);
+        return false;
+    }
+    return param_ramp_retarget(&pregain->ramp, p->gain_linear);
+}
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ * 
+ * Must be paired with pregain_end_block.
+ * 
+ * @param pregain Pointer to pre-gain structure
+ * @return Parameters to use for this block
+ */
+const pregain_params_t *pregain_begin_block(pregain_t *pregain);
+
+/**
+ * Release the parameters latched by pregain_begin_block (audio task only)
+ * 
+ * @param pregain Pointer to pre-gain structure
+ */
+void pregain_end_block(pregain_t *pregain);
+
 /**
  * Process audio through pre-gain
  * 
@@ -50,6 +129,18 @@ float pregain_get_gain(pregain_t *pregain);
  */
 void pregain_process(pregain_t *pregain, int32_t *buffer, int num_samples);
 
+/**
+ * Process a float block through pre-gain (float32 chain)
+ * 
+ * No clamping: the float chain keeps the headroom until the final
+ * conversion back to 24-bit.
+ * 
+ * @param pregain Pointer to pre-gain structure
+ * @param buffer Audio buffer (interleaved stereo, 24-bit scale)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void pregain_process_f32(pregain_t *pregain, float *buffer, int num_samples);
+
 /**
  * Enable or disable pre-gain
  * 
@@ -67,15 +158,46 @@ void pregain_set_enabled(pregain_t *pregain, bool enabled);
 bool pregain_is_enabled(pregain_t *pregain);
 
 /**
- * Save pre-gain settings to NVS flash storage
+ * Copy the persistent settings
+ * 
+ * @param pregain Pointer to pre-gain structure
+ * @param settings Destination
+ */
+void pregain_get_settings(const pregain_t *pregain, pregain_settings_t *settings);
+
+/**
+ * Apply persistent settings
+ * 
+ * @param pregain Pointer to pre-gain structure
+ * @param settings Settings from pregain_get_settings
+ */
+void pregain_apply_settings(pregain_t *pregain, const pregain_settings_t *settings);
+
+/**
+ * Compute the parameters pregain_apply_settings would publish
+ * 
+ * @param settings Settings from pregain_get_settings (gain clamped like pregain_set_gain)
+ * @param params Destination
+ */
+void pregain_bake_params(const pregain_settings_t *settings, pregain_params_t *params);
+
+/**
+ * Apply settings with parameters baked by pregain_bake_params (see preset_bank.h)
+ * 
+ * The enable flag goes through coeff_bank_set_flag, so inside a group it
+ * changes in the same block as the gain.
  * 
  * @param pregain Pointer to pre-gain structure
- * @return ESP_OK on success, error code otherwise
+ * @param settings Settings the parameters were baked from
+ * @param params Baked parameters
+ * @param crossfade true to ramp to the new gain, false to switch at the block boundary
  */
-esp_err_t pregain_save_settings(pregain_t *pregain);
+void pregain_apply_baked(pregain_t *pregain, const pregain_settings_t *settings,
+                         const pregain_params_t *params, bool crossfade);
 
 /**
- * Load pre-gain settings from NVS flash storage
+ * Load pre-gain settings saved as separate NVS keys (firmware before the
+ * settings blob; used once to migrate)
  * 
  * @param pregain Pointer to pre-gain structure
  * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if no saved settings, error code otherwise
@@ -0,0 +1,326 @@
+#include "preset_bank.h"
+#include "settings_blob.h"
+#include "coeff_bank.h"
+#include "nvs.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdio.h>
+
+#if PRESET_BANK_ENABLED
+
+static const char *TAG = "PRESET";
+
+#define NVS_NAMESPACE       "presets"
+#define NVS_KEY_CROSSFADE   "crossfade"
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern pregain_t pregain;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+
+// A slot: the stored record and the parameter sets baked from it
+typedef struct {
+    subsonic_params_t subsonic;             // Baked for sample_rate
+    pregain_params_t pregain;
+    limiter_params_t limiter;
+    preset_bank_record_t record;            // Settings and equalizer coefficients
+    uint32_t sample_rate;
+    bool used;
+} slot_t;
+
+// Stored record: header and record, as in the settings blob
+typedef struct {
+    settings_blob_header_t header;
+    preset_bank_record_t record;
+} stored_t;
+
+static slot_t s_slots[PRESET_BANK_SLOTS];
+static stored_t s_stored;                   // NVS read/write buffer (too large for the callers' stacks)
+static bool s_crossfade = true;
+static preset_bank_stats_t s_stats = {};
+
+static void slot_key(int slot, char *key, size_t size)
+{
+    snprintf(key, size, "slot%d", slot);
+}
+
+// Everything recall needs, for one sample rate
+static void bake_slot(slot_t *s, uint32_t sample_rate)
+{
+    const preset_bank_record_t *r = &s->record;
+    subsonic_bake_params(&r->subsonic, sample_rate, &s->subsonic);
+    pregain_bake_params(&r->pregain, &s->pregain);
+    limiter_bake_params(&r->limiter, &s->limiter);
+    if (r->eq_coeffs.sample_rate != sample_rate || r->eq_coeffs.version != EQ_COEFF_CACHE_VERSION) {
+        equalizer_bake_coeff_cache(&r->equalizer, sample_rate, &s->record.eq_coeffs);
+    }
+    s->sample_rate = sample_rate;
+}
+
+static esp_err_t save_slot(int slot)
+{
+    memset(&s_stored, 0, sizeof(s_stored));
+    s_stored.record = s_slots[slot].record;
+    s_stored.header.magic = PRESET_BANK_MAGIC;
+    s_stored.header.version = PRESET_BANK_VERSION;
+    s_stored.header.size = sizeof(preset_bank_record_t);
+    s_stored.header.crc32 = esp_crc32_le(0, (const uint8_t *)&s_stored.record, sizeof(preset_bank_record_t));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char key[16];
+    slot_key(slot, key, sizeof(key));
+    err = nvs_set_blob(nvs_handle, key, &s_stored, sizeof(s_stored));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+static bool load_slot(nvs_handle_t nvs_handle, int slot)
+{
+    char key[16];
+    slot_key(slot, key, sizeof(key));
+    size_t length = sizeof(s_stored);
+    if (nvs_get_blob(nvs_handle, key, &s_stored, &length) != ESP_OK) {
+        return false;
+    }
+    const settings_blob_header_t *header = &s_stored.header;
+    if (length != sizeof(s_stored) || header->magic != PRESET_BANK_MAGIC ||
+        header->version != PRESET_BANK_VERSION || header->size != sizeof(preset_bank_record_t) ||
+        esp_crc32_le(0, (const uint8_t *)&s_stored.record, sizeof(preset_bank_record_t)) != header->crc32) {
+        ESP_LOGW(TAG, "Slot %d: stored record not valid, slot left empty", slot);
+        return false;
+    }
+    s_slots[slot].record = s_stored.record;
+    s_slots[slot].record.name[PRESET_BANK_NAME_LEN] = '\0';
+    return true;
+}
+
+esp_err_t preset_bank_init(uint32_t sample_rate)
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    s_stats.active = -1;
+
+    nvs_handle_t nvs_handle;
+    int loaded = 0;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        uint8_t crossfade = 1;
+        if (nvs_get_u8(nvs_handle, NVS_KEY_CROSSFADE, &crossfade) == ESP_OK) {
+            s_crossfade = (crossfade != 0);
+        }
+        for (int i = 0; i < PRESET_BANK_SLOTS; i++) {
+            if (load_slot(nvs_handle, i)) {
+                bake_slot(&s_slots[i], sample_rate);
+                s_slots[i].used = true;
+                loaded++;
+            }
+        }
+        nvs_close(nvs_handle);
+    }
+
+    ESP_LOGI(TAG, "Preset bank: %d of %d slots stored, %s recall", loaded, PRESET_BANK_SLOTS,
+             s_crossfade ? "crossfaded" : "instant");
+    return ESP_OK;
+}
+
+esp_err_t preset_bank_store(int slot, const char *name, size_t name_len, uint32_t sample_rate)
+{
+    if (slot < 0 || slot >= PRESET_BANK_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    slot_t *s = &s_slots[slot];
+    preset_bank_record_t *r = &s->record;
+
+    if (name_len > 0) {
+        if (name_len > PRESET_BANK_NAME_LEN) {
+            name_len = PRESET_BANK_NAME_LEN;
+        }
+        memset(r->name, 0, sizeof(r->name));
+        memcpy(r->name, name, name_len);
+    } else if (!s->used) {
+        snprintf(r->name, sizeof(r->name), "preset%d", slot);
+    }
+
+    subsonic_get_settings(&subsonic, &r->subsonic);
+    pregain_get_settings(&pregain, &r->pregain);
+    equalizer_get_settings(&equalizer, &r->equalizer);
+    limiter_get_settings(&limiter, &r->limiter);
+    equalizer_bake_coeff_cache(&r->equalizer, sample_rate, &r->eq_coeffs);
+    bake_slot(s, sample_rate);
+    s->used = true;
+
+    esp_err_t err = save_slot(slot);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Slot %d stored in RAM only: %s", slot, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Slot %d '%s' stored", slot, r->name);
+    return ESP_OK;
+}
+
+esp_err_t preset_bank_recall(int slot, uint32_t sample_rate)
+{
+    if (slot < 0 || slot >= PRESET_BANK_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    slot_t *s = &s_slots[slot];
+    if (!s->used) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s->sample_rate != sample_rate) {
+        // Only if preset_bank_set_sample_rate was missed
+        ESP_LOGW(TAG, "Slot %d baked for %lu Hz, baking for %lu Hz", slot,
+                 (unsigned long)s->sample_rate, (unsigned long)sample_rate);
+        bake_slot(s, sample_rate);
+        s_stats.rebakes++;
+    }
+
+    // Copies of baked sets into the shadows, then one swap at a block boundary
+    const int64_t start = esp_timer_get_time();
+    const preset_bank_record_t *r = &s->record;
+    coeff_bank_group_begin();
+    subsonic_apply_baked(&subsonic, &r->subsonic, &s->subsonic);
+    pregain_apply_baked(&pregain, &r->pregain, &s->pregain, s_crossfade);
+    equalizer_apply_baked(&equalizer, &r->equalizer, &r->eq_coeffs, sample_rate, s_crossfade);
+    limiter_apply_baked(&limiter, &r->limiter, &s->limiter);
+    const bool at_boundary = coeff_bank_group_commit();
+    const uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    s_stats.active = slot;
+    s_stats.recalls++;
+    if (at_boundary) {
+        s_stats.boundary_swaps++;
+    }
+    s_stats.last_recall_us = elapsed;
+    if (elapsed > s_stats.max_recall_us) {
+        s_stats.max_recall_us = elapsed;
+    }
+    ESP_LOGI(TAG, "Slot %d '%s' recalled in %lu us%s", slot, r->name, (unsigned long)elapsed,
+             at_boundary ? "" : " (audio not running)");
+    return ESP_OK;
+}
+
+esp_err_t preset_bank_clear(int slot)
+{
+    if (slot < 0 || slot >= PRESET_BANK_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&s_slots[slot], 0, sizeof(s_slots[slot]));
+    if (s_stats.active == slot) {
+        s_stats.active = -1;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char key[16];
+    slot_key(slot, key, sizeof(key));
+    err = nvs_erase_key(nvs_handle, key);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    ESP_LOGI(TAG, "Slot %d cleared", slot);
+    return err;
+}
+
+int preset_bank_find(const char *name, size_t len)
+{
+    for (int i = 0; i < PRESET_BANK_SLOTS; i++) {
+        const char *slot_name = s_slots[i].record.name;
+        if (s_slots[i].used && strlen(slot_name) == len && memcmp(slot_name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const preset_bank_record_t *preset_bank_get_record(int slot)
+{
+    if (slot < 0 || slot >= PRESET_BANK_SLOTS || !s_slots[slot].used) {
+        return NULL;
+    }
+    return &s_slots[slot].record;
+}
+
+esp_err_t preset_bank_get_info(int slot, preset_bank_info_t *info)
+{
+    if (slot < 0 || slot >= PRESET_BANK_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(info, 0, sizeof(*info));
+    info->used = s_slots[slot].used;
+    if (info->used) {
+        memcpy(info->name, s_slots[slot].record.name, sizeof(info->name));
+        info->sample_rate = s_slots[slot].sample_rate;
+    }
+    return ESP_OK;
+}
+
+void preset_bank_set_crossfade(bool crossfade)
+{
+    s_crossfade = crossfade;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_set_u8(nvs_handle, NVS_KEY_CROSSFADE, crossfade ? 1 : 0) == ESP_OK) {
+            nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "Recall %s", crossfade ? "crossfaded" : "instant");
+}
+
+void preset_bank_set_sample_rate(uint32_t sample_rate)
+{
+    for (int i = 0; i < PRESET_BANK_SLOTS; i++) {
+        if (s_slots[i].used && s_slots[i].sample_rate != sample_rate) {
+            bake_slot(&s_slots[i], sample_rate);
+            s_stats.rebakes++;
+        }
+    }
+}
+
+void preset_bank_get_stats(preset_bank_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->crossfade = s_crossfade;
+}
+
+#else
+
+esp_err_t preset_bank_init(uint32_t sample_rate) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t preset_bank_store(int slot, const char *name, size_t name_len, uint32_t sample_rate)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t preset_bank_recall(int slot, uint32_t sample_rate) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t preset_bank_clear(int slot) { return ESP_ERR_NOT_SUPPORTED; }
+int preset_bank_find(const char *name, size_t len) { return -1; }
+const preset_bank_record_t *preset_bank_get_record(int slot) { return NULL; }
+esp_err_t preset_bank_get_info(int slot, preset_bank_info_t *info) { return ESP_ERR_NOT_SUPPORTED; }
+void preset_bank_set_crossfade(bool crossfade) {}
+void preset_bank_set_sample_rate(uint32_t sample_rate) {}
+
+void preset_bank_get_stats(preset_bank_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->active = -1;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef PRESET_BANK_H
+#define PRESET_BANK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "limiter.h"
+
+// Preset bank (scene snapshots)
+// User-storable slots holding the complete state of subsonic, pre-gain,
+// equalizer and limiter. Storing a slot captures the live settings and
+// bakes everything the audio path reads (biquad coefficients, linear gains,
+// the limiter threshold) once, into RAM; the slot is also written to NVS so
+// it survives a reboot.
+//
+// Recalling a slot does no filter design and no flash access: the baked
+// parameter sets are copied into the modules' shadow sets and published as
+// one coeff_bank group, which the live chain swaps in at a single block
+// boundary, enable flags included (from a dsp_control batch, the batch's
+// group, together with its other edits). With crossfade on, pre-gain and
+// equalizer glide to the new values over the usual parameter ramp
+// (PARAM_RAMP_FRAMES); with it off they switch at the block boundary.
+// The recalled settings are then saved by the persistence task like any
+// other change.
+//
+// Slots are baked for one sample rate; after a rate change they are baked
+// again (preset_bank_set_sample_rate), before any recall needs them.
+//
+// Store, recall and clear are not reentrant; dsp_control serializes them
+// (preset/store/#, preset/recall, preset/clear, preset/crossfade).
+
+#ifdef CONFIG_PRESET_BANK
+#define PRESET_BANK_ENABLED     1
+#define PRESET_BANK_SLOTS       CONFIG_PRESET_BANK_SLOTS
+#else
+#define PRESET_BANK_ENABLED     0
+#define PRESET_BANK_SLOTS       0
+#endif
+
+// Longest slot name (bytes, without the terminating NUL)
+#define PRESET_BANK_NAME_LEN    23
+
+#define PRESET_BANK_MAGIC       0x54455350u     // "PSET"
+#define PRESET_BANK_VERSION     1
+
+// One stored slot (the NVS record, after a settings_blob_header_t)
+typedef struct {
+    char name[PRESET_BANK_NAME_LEN + 1];        // NUL-terminated
+    subsonic_settings_t subsonic;
+    pregain_settings_t pregain;
+    equalizer_settings_t equalizer;
+    limiter_settings_t limiter;
+    equalizer_coeff_cache_t eq_coeffs;          // Baked when stored (or after a rate change)
+} preset_bank_record_t;
+
+// Slot information for listings
+typedef struct {
+    bool used;                                  // Slot holds a preset
+    char name[PRESET_BANK_NAME_LEN + 1];
+    uint32_t sample_rate;                       // Rate the slot is baked for
+} preset_bank_info_t;
+
+typedef struct {
+    int active;                                 // Slot last recalled (-1 = none)
+    bool crossfade;                             // Recall mode
+    uint32_t recalls;                           // Recalls carried out
+    uint32_t boundary_swaps;                    // Recalls swapped in by the running chain
+    uint32_t rebakes;                           // Slots baked again for a new sample rate
+    uint32_t last_recall_us;                    // Command to swap, including the wait for the block boundary
+    uint32_t max_recall_us;
+} preset_bank_stats_t;
+
+/**
+ * Load the stored slots and bake them (at boot, after settings_blob_load)
+ *
+ * Records that are missing, corrupt or of another format leave their slot
+ * empty.
+ *
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK, or ESP_ERR_NOT_SUPPORTED without PRESET_BANK
+ */
+esp_err_t preset_bank_init(uint32_t sample_rate);
+
+/**
+ * Store the live chain state in a slot
+ *
+ * @param slot Slot (0 to PRESET_BANK_SLOTS-1)
+ * @param name Name (not necessarily NUL-terminated; truncated to
+ *             PRESET_BANK_NAME_LEN), or empty to keep the slot's name
+ * @param name_len Length of name
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad slot, ESP_ERR_NOT_SUPPORTED
+ *         without PRESET_BANK, or the NVS error (the slot is usable from
+ *         RAM until reboot)
+ */
+esp_err_t preset_bank_store(int slot, const char *name, size_t name_len, uint32_t sample_rate);
+
+/**
+ * Recall a slot into the chain (one block-boundary swap, no coefficient
+ * math, no flash access)
+ *
+ * @param slot Slot (0 to PRESET_BANK_SLOTS-1)
+ * @param sample_rate Current sample rate in Hz
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad slot, ESP_ERR_NOT_FOUND for
+ *         an empty slot, or ESP_ERR_NOT_SUPPORTED without PRESET_BANK
+ */
+esp_err_t preset_bank_recall(int slot, uint32_t sample_rate);
+
+/**
+ * Empty a slot and erase its NVS record
+ *
+ * @param slot Slot (0 to PRESET_BANK_SLOTS-1)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad slot, ESP_ERR_NOT_SUPPORTED
+ *         without PRESET_BANK, or the NVS error
+ */
+esp_err_t preset_bank_clear(int slot);
+
+/**
+ * Find a slot by name
+ *
+ * @param name Name (not necessarily NUL-terminated)
+ * @param len Length of name
+ * @return Slot, or -1 if no slot has that name
+ */
+int preset_bank_find(const char *name, size_t len);
+
+/**
+ * Get a stored slot (for staging its settings in a dsp_control batch)
+ *
+ * @param slot Slot (0 to PRESET_BANK_SLOTS-1)
+ * @return Record, or NULL if the slot is empty or invalid
+ */
+const preset_bank_record_t *preset_bank_get_record(int slot);
+
+/**
+ * Get slot information (for listings)
+ *
+ * @param slot Slot (0 to PRESET_BANK_SLOTS-1)
+ * @param info Destination
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad slot, or ESP_ERR_NOT_SUPPORTED
+ */
+esp_err_t preset_bank_get_info(int slot, preset_bank_info_t *info);
+
+/**
+ * Choose how recalls change pre-gain and equalizer (saved to NVS)
+ *
+ * @param crossfade true to ramp over PARAM_RAMP_FRAMES, false to switch at the block boundary
+ */
+void preset_bank_set_crossfade(bool crossfade);
+
+/**
+ * Bake every slot for a new sample rate (after audio_rate_set)
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void preset_bank_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * Get recall statistics
+ *
+ * @param stats Destination
+ */
+void preset_bank_get_stats(preset_bank_stats_t *stats);
+
+#endif // PRESET_BANK_H
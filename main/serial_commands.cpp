@@ -3,15 +3,35 @@
 #include "pregain.h"
 #include "equalizer.h"
 #include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+#include "dsp_chain.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "dsp_perf.h"
+#include "dsp_bench.h"
+#include "level_meter.h"
+#include "audio_xrun.h"
+#include "spectrum.h"
+#include "dsp_control.h"
+#include "preset_bank.h"
+#include "audio_tap.h"
+#include "persist.h"
 #include "audio_config.h"
+#include "audio_rate.h"
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
+#include "telemetry.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 static const char *TAG = "CMD";
 
@@ -20,8 +40,12 @@ extern subsonic_t subsonic;
 extern pregain_t pregain;
 extern equalizer_t equalizer;
 extern limiter_t limiter;
+extern convolver_t convolver;
+extern crossover_t crossover;
+extern multiband_t multiband;
+extern delay_line_t delay_line;
 
-// VU meter state (add near the top with other external variables)
+// NeoPixel level display ('meter led on|off'); limiting is always shown
 static bool vu_meter_enabled = true;
 
 void serial_commands_print_help(void)
@@ -34,6 +58,48 @@ void serial_commands_print_help(void)
     printf("System Commands:\n");
     printf("  help          - Show this help message\n");
     printf("  status        - Show system status\n");
+    printf("  set <path> <value> [<path> <value> ...]\n");
+    printf("                - Set parameters by MQTT topic path, all at once\n");
+    printf("                  (e.g. set eq/band/0 6 eq/band/0/q 0.9)\n");
+    printf("\n");
+    printf("DSP Chain Commands:\n");
+    printf("  chain show    - Show current chain execution mode\n");
+    printf("  chain fused   - Run all stages in one pass per frame\n");
+    printf("  chain staged  - Run one buffer pass per stage (reference)\n");
+    printf("  chain float   - Run every stage on a float32 block (esp-dsp)\n");
+    printf("  chain verify  - Check fused output is bit-identical to staged\n");
+    printf("\n");
+    printf("Profiler Commands:\n");
+    printf("  perf          - Show per-stage DSP timing and load\n");
+    printf("                  (per-stage rows need 'chain staged' or 'chain float')\n");
+    printf("  perf reset    - Clear profiler statistics\n");
+    printf("  bench run     - Measure DSP headroom on this board (interrupts audio ~1s)\n");
+    printf("  xrun          - Show dropouts (RX overflow, TX underrun, deadline miss)\n");
+    printf("  xrun reset    - Clear dropout counters and log\n");
+    printf("\n");
+    printf("Level Meter Commands:\n");
+    printf("  meter         - Show output peak, RMS and loudness\n");
+    printf("  meter reset   - Clear peak hold and clip counters\n");
+    printf("  meter led on|off - Show the level on the NeoPixel\n");
+    printf("\n");
+    printf("Spectrum Analyzer Commands:\n");
+    printf("  spectrum      - Show 1/3-octave output spectrum\n");
+    printf("  spectrum on|off - Start or stop the analysis\n");
+    printf("  spectrum reset - Clear the averages\n");
+    printf("  spectrum suggest [apply] - Suggest EQ gains from the long-term spectrum\n");
+    printf("\n");
+    printf("Audio I/O Commands (low-latency I/O builds):\n");
+    printf("  io show       - Show DMA geometry and measured latency\n");
+    printf("  io geometry <frames> <buffers>\n");
+    printf("                - Rebuild the DMA buffers (%d-%d frames, %d-%d buffers)\n",
+           AUDIO_LOWLAT_MIN_FRAMES, AUDIO_LOWLAT_MAX_FRAMES, AUDIO_LOWLAT_MIN_DESCS, AUDIO_LOWLAT_MAX_DESCS);
+    printf("  io reset      - Clear latency and missed-block statistics\n");
+    printf("  io save       - Save DMA geometry to flash\n");
+    printf("\n");
+    printf("Sample Rate Commands:\n");
+    printf("  rate show     - Show the current sample rate\n");
+    printf("  rate <hz>     - Switch rate (44100, 48000, 88200, 96000, 176400, 192000)\n");
+    printf("  rate save     - Save sample rate to flash\n");
     printf("\n");
     printf("WiFi Commands:\n");
     printf("  wifi status   - Show WiFi connection status\n");
@@ -42,7 +108,7 @@ void serial_commands_print_help(void)
     printf("  wifi disconnect - Disconnect from WiFi\n");
     printf("\n");
     printf("MQTT Commands:\n");
-    printf("  mqtt status   - Show MQTT connection status\n");
+    printf("  mqtt status   - Show MQTT connection and telemetry status\n");
     printf("  mqtt set <broker_uri>\n");
     printf("                - Connect to MQTT broker (e.g., mqtt://192.168.1.100:1883)\n");
     printf("  mqtt disconnect - Disconnect from MQTT broker\n");
@@ -67,15 +133,21 @@ void serial_commands_print_help(void)
     printf("Equalizer Commands:\n");
     printf("  eq show       - Display current EQ settings\n");
     printf("  eq set <band> <gain>\n");
-    printf("                - Set band gain (band: 0-4, gain: -12 to +12 dB)\n");
-    printf("                  Bands: 0=60Hz, 1=250Hz, 2=1kHz, 3=4kHz, 4=12kHz\n");
+    printf("                - Set band gain (band: 0-%d, gain: -12 to +12 dB)\n", EQ_MAX_BANDS - 1);
+    printf("                  Default bands: 0=60Hz, 1=250Hz, 2=1kHz, 3=4kHz, 4=12kHz\n");
     printf("                  (Settings are automatically saved to flash)\n");
+    printf("  eq band <band> <type> <freq> [q] [gain]\n");
+    printf("                - Configure and enable a band\n");
+    printf("                  Types: peaking, lowshelf, highshelf, lowpass, highpass, notch\n");
+    printf("  eq band <band> on|off\n");
+    printf("                - Enable or disable a band (disabled bands cost no CPU)\n");
     printf("  eq enable     - Enable equalizer processing\n");
     printf("  eq disable    - Disable equalizer (bypass)\n");
     printf("  eq reset      - Reset EQ filter state (temporary)\n");
     printf("  eq preset <name>\n");
     printf("                - Load EQ preset (flat, bass, vocal, rock, jazz)\n");
     printf("  eq save       - Manually save current settings to flash\n");
+    printf("  eq selftest   - Check SIMD kernel output against scalar Q24\n");
     printf("\n");
     printf("Limiter Commands:\n");
     printf("  lim show      - Display current limiter settings\n");
@@ -83,14 +155,101 @@ void serial_commands_print_help(void)
     printf("                - Set limiter threshold (-12 to 0 dB, default -0.5)\n");
     printf("  lim enable    - Enable limiter (clipping protection)\n");
     printf("  lim disable   - Disable limiter (bypass)\n");
+    printf("  lim truepeak <on|off>\n");
+    printf("                - Detect inter-sample peaks (4x oversampled sidechain)\n");
     printf("  lim reset     - Reset limiter state\n");
     printf("  lim stats     - Show limiter statistics\n");
     printf("  lim save      - Manually save limiter settings to flash\n");
     printf("\n");
+    printf("Convolver Commands (FIR room correction):\n");
+    printf("  conv show     - Show the loaded impulse response and statistics\n");
+    printf("  conv enable   - Enable convolution\n");
+    printf("  conv disable  - Disable convolution (bypass)\n");
+    printf("  conv gain <db> - Set output gain (%.0f to %+.0f dB, default 0)\n",
+           CONVOLVER_MIN_DB, CONVOLVER_MAX_DB);
+    printf("  conv reset    - Clear the convolution history\n");
+    printf("  conv save     - Manually save gain and enable to flash\n");
+    printf("  conv ir begin <taps> [channels] [rate]\n");
+    printf("                - Start an upload (1 or 2 channels, rate 0 = any)\n");
+    printf("  conv ir data <index> <tap> [tap ...]\n");
+    printf("                - Taps from index on (left channel first, then right)\n");
+    printf("  conv ir end [save] - Load the uploaded response (save: also to flash)\n");
+    printf("  conv ir abort - Discard the upload\n");
+    printf("  conv ir clear [erase] - Unload the response (erase: also from flash)\n");
+    printf("\n");
+    printf("Crossover Commands (multi-way output):\n");
+    printf("  xover show    - Show crossover points, ways and limiter statistics\n");
+    printf("  xover freq <point> <hz>\n");
+    printf("                - Set a crossover point (0 = lowest, %.0f to %.0f Hz)\n",
+           CROSSOVER_MIN_FREQ, CROSSOVER_MAX_FREQ);
+    printf("  xover gain <way> <db>\n");
+    printf("                - Set way gain (%.0f to %+.0f dB, way 0 = low)\n",
+           CROSSOVER_MIN_DB, CROSSOVER_MAX_DB);
+    printf("  xover delay <way> <ms>\n");
+    printf("                - Delay a way for time alignment (0 to %.0f ms)\n", CROSSOVER_MAX_DELAY_MS);
+    printf("  xover invert <way> <on|off>\n");
+    printf("                - Invert the polarity of a way\n");
+    printf("  xover limit <way> <db> [truepeak <on|off>]\n");
+    printf("                - Set the limiter threshold of a way\n");
+    printf("  xover reset   - Clear filter, delay and limiter history\n");
+    printf("  xover save    - Manually save crossover settings to flash\n");
+    printf("\n");
+    printf("Multiband Dynamics Commands:\n");
+    printf("  mb show       - Show bands, settings and gain reduction\n");
+    printf("  mb enable     - Enable multiband dynamics\n");
+    printf("  mb disable    - Disable multiband dynamics (bypass)\n");
+    printf("  mb bands <n>  - Set the number of bands (%d to %d)\n",
+           MULTIBAND_MIN_BANDS, MULTIBAND_MAX_BANDS);
+    printf("  mb freq <point> <hz>\n");
+    printf("                - Set a split point (0 = lowest, %.0f to %.0f Hz)\n",
+           MULTIBAND_MIN_FREQ, MULTIBAND_MAX_FREQ);
+    printf("  mb band <band> <threshold> <ratio> [attack] [release] [makeup]\n");
+    printf("                - Set the compressor of a band (dBFS, ratio, ms, ms, dB)\n");
+    printf("  mb expander <band> <threshold> <ratio>\n");
+    printf("                - Set the downward expander of a band (ratio 1 = off)\n");
+    printf("  mb reset      - Clear filter and envelope history\n");
+    printf("  mb save       - Manually save multiband settings to flash\n");
+    printf("\n");
+    printf("Output Delay Commands:\n");
+    printf("  delay show    - Show the delay of each channel\n");
+    printf("  delay enable  - Enable the output delay\n");
+    printf("  delay disable - Disable the output delay (bypass)\n");
+    printf("  delay left <ms>\n");
+    printf("  delay right <ms>\n");
+    printf("                - Set the delay of a channel (0 to %d ms, fractional)\n", DELAY_LINE_MAX_MS);
+    printf("  delay reset   - Clear the delay lines\n");
+    printf("  delay save    - Manually save delay settings to flash\n");
+    printf("\n");
+    printf("Preset Bank Commands:\n");
+    printf("  preset list   - Show the stored slots and recall statistics\n");
+    printf("  preset store <slot> [name]\n");
+    printf("                - Store the current chain in a slot (0 to %d)\n", PRESET_BANK_SLOTS - 1);
+    printf("  preset recall <slot|name>\n");
+    printf("                - Recall a slot (switches at one block boundary)\n");
+    printf("  preset clear <slot|name>\n");
+    printf("                - Empty a slot\n");
+    printf("  preset crossfade <on|off>\n");
+    printf("                - Ramp pre-gain and EQ on recall, or switch instantly\n");
+    printf("\n");
+    printf("Audio Tap Commands:\n");
+    printf("  tap show      - Show the stream destination and counters\n");
+    printf("  tap start <host> [port]\n");
+    printf("                - Stream RTP to a host or multicast group (default port %d)\n",
+           AUDIO_TAP_DEFAULT_PORT);
+    printf("  tap stop      - Stop streaming\n");
+    printf("  tap point post|prelimiter\n");
+    printf("                - Tap the chain output or the limiter input\n");
+    printf("  tap format l24|l16\n");
+    printf("                - Stream 24-bit or 16-bit samples\n");
+    printf("  tap decim <n> - Lower the stream rate by 1, 2, 3, 4 or 6\n");
+    printf("  tap sdp       - Print the session description for the receiver\n");
+    printf("  tap save      - Save tap settings to flash (streaming after boot)\n");
+    printf("\n");
     printf("Examples:\n");
     printf("  sub freq 28.0  - Set subsonic cutoff to 28Hz\n");
     printf("  gain set 3.0   - Apply 3dB pre-gain\n");
     printf("  eq set 0 6.0   - Boost 60Hz by 6dB\n");
+    printf("  eq band 5 notch 3150 8 - Notch out 3.15kHz with band 5\n");
     printf("  lim threshold -1.0 - Set limiter threshold to -1dB\n");
     printf("\n");
     printf("Note: Settings are saved to flash and restored at boot.\n");
@@ -98,80 +257,69 @@ void serial_commands_print_help(void)
     printf("\n");
 }
 
-static void apply_preset(const char* preset_name)
+// Format a band frequency for display ("60Hz", "12kHz", "3.15kHz")
+static const char* format_freq(float freq)
 {
-    if (strcmp(preset_name, "flat") == 0) {
-        // Flat - all bands at 0dB
-        for (int i = 0; i < 5; i++) {
-            equalizer_set_band_gain(&equalizer, i, 0.0f, SAMPLE_RATE);
-        }
-        printf("Applied 'Flat' preset (all bands at 0dB)\n");
-    }
-    else if (strcmp(preset_name, "bass") == 0) {
-        // Bass boost
-        equalizer_set_band_gain(&equalizer, 0, 6.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 1, 4.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 2, 0.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 3, 0.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 4, 0.0f, SAMPLE_RATE);
-        printf("Applied 'Bass Boost' preset\n");
-    }
-    else if (strcmp(preset_name, "vocal") == 0) {
-        // Vocal clarity
-        equalizer_set_band_gain(&equalizer, 0, -2.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 1, 0.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 2, 3.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 3, 5.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 4, 2.0f, SAMPLE_RATE);
-        printf("Applied 'Vocal Clarity' preset\n");
-    }
-    else if (strcmp(preset_name, "rock") == 0) {
-        // Rock - V-shaped
-        equalizer_set_band_gain(&equalizer, 0, 5.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 1, 3.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 2, -4.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 3, 2.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 4, 6.0f, SAMPLE_RATE);
-        printf("Applied 'Rock' preset\n");
-    }
-    else if (strcmp(preset_name, "jazz") == 0) {
-        // Jazz - natural with slight warmth
-        equalizer_set_band_gain(&equalizer, 0, 2.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 1, 1.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 2, 0.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 3, 1.0f, SAMPLE_RATE);
-        equalizer_set_band_gain(&equalizer, 4, 3.0f, SAMPLE_RATE);
-        printf("Applied 'Jazz' preset\n");
+    static char buf[16];
+    if (freq >= 1000.0f) {
+        snprintf(buf, sizeof(buf), "%gkHz", freq / 1000.0f);
+    } else {
+        snprintf(buf, sizeof(buf), "%gHz", freq);
     }
-    else {
+    return buf;
+}
+
+static void apply_preset(const char* preset_name)
+{
+    const dsp_control_preset_t* preset = dsp_control_find_preset(preset_name, strlen(preset_name));
+    if (preset == NULL) {
         printf("Unknown preset: %s\n", preset_name);
-        printf("Available presets: flat, bass, vocal, rock, jazz\n");
+        printf("Available presets:");
+        for (int i = 0; dsp_control_get_preset(i) != NULL; i++) {
+            printf(" %s", dsp_control_get_preset(i)->name);
+        }
+        printf("\n");
+        return;
+    }
+    
+    const char* path = "eq/preset";
+    if (dsp_control_apply(path, strlen(path), preset->name, strlen(preset->name), NULL) != ESP_OK) {
+        printf("Error: Failed to apply preset\n");
         return;
     }
+    printf("Applied '%s' preset%s\n", preset->label, preset->all_bands ? " (all bands at 0dB)" : "");
     
     // Show new settings
     printf("New EQ settings:\n");
-    printf("  60Hz:   %.1f dB\n", equalizer.gain_db[0]);
-    printf("  250Hz:  %.1f dB\n", equalizer.gain_db[1]);
-    printf("  1kHz:   %.1f dB\n", equalizer.gain_db[2]);
-    printf("  4kHz:   %.1f dB\n", equalizer.gain_db[3]);
-    printf("  12kHz:  %.1f dB\n", equalizer.gain_db[4]);
+    for (int i = 0; i < EQ_DEFAULT_BANDS; i++) {
+        const eq_band_t* b = equalizer_get_band(&equalizer, i);
+        printf("  %-7s %.1f dB\n", format_freq(b->freq), b->gain_db);
+    }
 }
 
 static void show_eq_settings(void)
 {
-    const char* band_names[] = {"60Hz", "250Hz", "1kHz", "4kHz", "12kHz"};
-    
     printf("\n");
     printf("Equalizer Settings:\n");
     printf("  Status: %s\n", equalizer.enabled ? "ENABLED" : "DISABLED (bypass)");
+    printf("  Kernel: %s\n", equalizer_kernel_name());
     printf("\n");
-    printf("  Band  | Frequency | Gain\n");
-    printf("  ------|-----------|--------\n");
-    for (int i = 0; i < 5; i++) {
-        printf("    %d   | %-9s | %+.1f dB\n", i, band_names[i], equalizer.gain_db[i]);
+    printf("  Band | Type      | Frequency | Q     | Gain\n");
+    printf("  -----|-----------|-----------|-------|--------\n");
+    int enabled_bands = 0;
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        const eq_band_t* b = equalizer_get_band(&equalizer, i);
+        if (!b->enabled) {
+            continue;
+        }
+        enabled_bands++;
+        printf("  %3d  | %-9s | %-9s | %5.2f | %+.1f dB\n", i, equalizer_type_name(b->type),
+               format_freq(b->freq), b->q, b->gain_db);
     }
     printf("\n");
+    printf("  %d of %d bands enabled, %d processed (0dB peaking/shelf bands are skipped)\n",
+           enabled_bands, EQ_MAX_BANDS, equalizer_get_active_bands(&equalizer));
+    printf("\n");
 }
 
 static void show_pregain_settings(void)
@@ -189,6 +337,7 @@ static void show_limiter_settings(void)
     printf("Limiter Settings:\n");
     printf("  Status: %s\n", limiter.enabled ? "ENABLED" : "DISABLED (bypass)");
     printf("  Threshold: %.1f dB\n", limiter_get_threshold(&limiter));
+    printf("  Detection: %s\n", limiter_get_true_peak(&limiter) ? "true peak (4x oversampled)" : "sample peak");
     printf("  Attack: %.1f ms\n", LIMITER_ATTACK_MS);
     printf("  Release: %.1f ms\n", LIMITER_RELEASE_MS);
     printf("  Lookahead: %.1f ms\n", LIMITER_LOOKAHEAD_MS);
@@ -204,6 +353,321 @@ static void show_limiter_stats(void)
     printf("\n");
 }
 
+static void show_conv_settings(void)
+{
+    convolver_info_t info;
+    convolver_get_info(&convolver, &info);
+    printf("\n=== FIR Convolver Settings ===\n");
+    if (!CONVOLVER_ENABLED) {
+        printf("  Not available (enable CONVOLVER in menuconfig)\n\n");
+        return;
+    }
+    printf("  Status: %s\n", convolver.enabled ? "ENABLED" : "DISABLED (bypass)");
+    printf("  Gain: %+.1f dB\n", convolver.gain_db);
+    if (info.loaded) {
+        printf("  Response: %lu taps x %d channel(s), %d partitions of %d frames\n",
+               (unsigned long)info.taps, info.channels, info.partitions, CONVOLVER_PARTITION_FRAMES);
+        if (info.sample_rate != 0) {
+            printf("  Measured at: %lu Hz%s\n", (unsigned long)info.sample_rate,
+                   info.rate_mismatch ? " (does not match the current rate: bypassed)" : "");
+        }
+    } else {
+        printf("  Response: none loaded (pass-through)\n");
+    }
+    printf("  Stored in flash: %s\n", info.stored ? "yes" : "no");
+    printf("  Memory: %u bytes\n", (unsigned)info.memory);
+    printf("  Blocks: %lu convolved, %lu passed through, %lu worker late\n",
+           (unsigned long)info.blocks, (unsigned long)info.skipped, (unsigned long)info.late);
+    printf("\n");
+}
+
+static void show_xover_settings(void)
+{
+    printf("\n=== Crossover Settings ===\n");
+    if (!CROSSOVER_ENABLED) {
+        printf("  Not available (enable CROSSOVER in menuconfig)\n\n");
+        return;
+    }
+    printf("  Output: %d ways, %s\n", CROSSOVER_WAYS, crossover_output_name());
+    printf("  Points:");
+    for (int p = 0; p < CROSSOVER_POINTS; p++) {
+        printf(" %d: %s", p, format_freq(crossover.config.freq[p]));
+    }
+    printf(" (LR4, 24 dB/octave)\n");
+    for (int w = 0; w < CROSSOVER_WAYS; w++) {
+        crossover_way_info_t info;
+        if (crossover_get_way_info(&crossover, w, &info) != ESP_OK) {
+            continue;
+        }
+        const crossover_way_settings_t *way = &crossover.config.ways[w];
+        printf("  Way %d (%s):", w, info.name);
+        printf(" %s", info.low_hz > 0.0f ? format_freq(info.low_hz) : "0Hz");
+        printf(" - %s\n", info.high_hz > 0.0f ? format_freq(info.high_hz) : "top");
+        printf("    Gain: %+.1f dB%s, delay: %.3f ms (%lu frames)\n", way->gain_db,
+               way->invert ? " (inverted)" : "", way->delay_ms, (unsigned long)info.delay_frames);
+        printf("    Limiter: %.1f dB%s, peak reduction %.1f dB, %lu clips prevented\n",
+               way->limit_db, way->true_peak ? " true-peak" : "",
+               info.peak_reduction_db, (unsigned long)info.clips_prevented);
+    }
+    printf("\n");
+}
+
+static void show_mb_settings(void)
+{
+    printf("\n=== Multiband Dynamics Settings ===\n");
+    if (!MULTIBAND_ENABLED) {
+        printf("  Not available (enable MULTIBAND in menuconfig)\n\n");
+        return;
+    }
+    const multiband_settings_t *cfg = &multiband.config;
+    printf("  Status: %s%s\n", multiband.enabled ? "ENABLED" : "DISABLED (bypass)",
+           multiband.state == NULL ? " (no memory: bypassed)" : "");
+    printf("  Bands: %d, points:", cfg->num_bands);
+    for (int p = 0; p < cfg->num_bands - 1; p++) {
+        printf(" %d: %s", p, format_freq(cfg->freq[p]));
+    }
+    printf(" (LR4)\n");
+    for (int b = 0; b < cfg->num_bands; b++) {
+        const multiband_band_settings_t *band = &cfg->bands[b];
+        printf("  Band %d: %s", b, b > 0 ? format_freq(cfg->freq[b - 1]) : "0Hz");
+        printf(" - %s\n", b < cfg->num_bands - 1 ? format_freq(cfg->freq[b]) : "top");
+        printf("    Compressor: %.1f dBFS %.1f:1, attack %.1f ms, release %.0f ms, makeup %+.1f dB\n",
+               band->threshold_db, band->ratio, band->attack_ms, band->release_ms, band->makeup_db);
+        printf("    Expander: %.1f dBFS 1:%.1f, gain reduction %.1f dB\n",
+               band->exp_threshold_db, band->exp_ratio, multiband.reduction_db[b]);
+    }
+    printf("\n");
+}
+
+// Speed of sound for the path lengths shown by 'delay show'
+#define SPEED_OF_SOUND_CM_PER_MS    34.3f
+
+static void show_delay_settings(void)
+{
+    printf("\n=== Output Delay Settings ===\n");
+    if (!DELAY_LINE_ENABLED) {
+        printf("  Not available (enable DELAY_LINE in menuconfig)\n\n");
+        return;
+    }
+    const delay_line_settings_t *cfg = &delay_line.config;
+    printf("  Status: %s%s\n", delay_line.enabled ? "ENABLED" : "DISABLED (bypass)",
+           delay_line.line == NULL ? " (no PSRAM: bypassed)" : "");
+    static const char *s_channels[DELAY_LINE_CHANNELS] = { "Left", "Right" };
+    for (int c = 0; c < DELAY_LINE_CHANNELS; c++) {
+        printf("  %-5s: %7.3f ms = %8.2f frames (%.1f cm)\n", s_channels[c], cfg->delay_ms[c],
+               delay_line_get_frames(&delay_line, c), cfg->delay_ms[c] * SPEED_OF_SOUND_CM_PER_MS);
+    }
+    printf("  Range: 0 to %d ms, plus 1 frame of interpolator latency on both channels\n",
+           DELAY_LINE_MAX_MS);
+    printf("\n");
+}
+
+static void show_presets(void)
+{
+    printf("\n=== Preset Bank ===\n");
+    if (!PRESET_BANK_ENABLED) {
+        printf("  Not available (enable PRESET_BANK in menuconfig)\n\n");
+        return;
+    }
+    preset_bank_stats_t stats;
+    preset_bank_get_stats(&stats);
+    for (int i = 0; i < PRESET_BANK_SLOTS; i++) {
+        preset_bank_info_t info;
+        preset_bank_get_info(i, &info);
+        if (info.used) {
+            printf("  %c%2d: %-*s (%lu Hz)\n", i == stats.active ? '*' : ' ', i,
+                   PRESET_BANK_NAME_LEN, info.name, (unsigned long)info.sample_rate);
+        } else {
+            printf("   %2d: (empty)\n", i);
+        }
+    }
+    printf("  Recall: %s, %lu recalls (%lu at a block boundary), last %lu us, max %lu us\n",
+           stats.crossfade ? "crossfade" : "instant", (unsigned long)stats.recalls,
+           (unsigned long)stats.boundary_swaps, (unsigned long)stats.last_recall_us,
+           (unsigned long)stats.max_recall_us);
+    printf("\n");
+}
+
+static void show_tap(void)
+{
+    printf("\n=== Audio Tap ===\n");
+    if (!AUDIO_TAP_ENABLED) {
+        printf("  Not available (enable AUDIO_TAP in menuconfig)\n\n");
+        return;
+    }
+    audio_tap_settings_t settings;
+    audio_tap_stats_t stats;
+    audio_tap_get_settings(&settings);
+    audio_tap_get_stats(&stats);
+    char host[16];
+    audio_tap_format_host(settings.host, host);
+    printf("  Destination: %s:%u (%s)\n", host, (unsigned)settings.port,
+           settings.enabled ? "enabled" : "disabled");
+    printf("  Stream: %s, %s, decimation %u", audio_tap_point_name((audio_tap_point_t)settings.point),
+           audio_tap_format_name((audio_tap_format_t)settings.format), (unsigned)settings.decimation);
+    if (stats.streaming) {
+        printf(" -> %lu Hz, streaming\n", (unsigned long)stats.stream_rate);
+    } else {
+        printf(", not streaming%s\n", (settings.enabled && !wifi_manager_is_connected()) ? " (no WiFi)" : "");
+    }
+    printf("  Blocks: %lu taken, %lu dropped (ring of %d)\n", (unsigned long)stats.blocks,
+           (unsigned long)stats.dropped_blocks, AUDIO_TAP_RING_BLOCKS);
+    printf("  Packets: %lu sent, %lu dropped, %lu KiB\n", (unsigned long)stats.packets,
+           (unsigned long)stats.dropped_packets, (unsigned long)stats.kbytes);
+    printf("\n");
+}
+
+// Run tap/... paths through dsp_control as one batch and report the error
+static void tap_command(const char* const* paths, const char* const* values, int count)
+{
+    esp_err_t err = ESP_OK;
+    dsp_control_begin();
+    for (int i = 0; i < count && err == ESP_OK; i++) {
+        err = dsp_control_set(paths[i], strlen(paths[i]), values[i], strlen(values[i]));
+    }
+    if (err != ESP_OK) {
+        dsp_control_abort();
+    } else {
+        esp_err_t save_err = ESP_OK;
+        err = dsp_control_commit(NULL, &save_err);
+        if (err == ESP_OK && save_err != ESP_OK) {
+            printf("Settings applied, but saving failed: %s\n", esp_err_to_name(save_err));
+            return;
+        }
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Error: Audio tap not available (enable AUDIO_TAP in menuconfig)\n");
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Error: Invalid value\n");
+    } else if (err != ESP_OK) {
+        printf("Error: %s\n", esp_err_to_name(err));
+    } else {
+        printf("OK\n");
+    }
+}
+
+// Run one preset/... path through dsp_control and report the error
+static void preset_command(const char* path, const char* value)
+{
+    esp_err_t err = dsp_control_apply(path, strlen(path), value, strlen(value), NULL);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Error: Preset bank not available (enable PRESET_BANK in menuconfig)\n");
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("Error: No stored preset '%s'\n", value);
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Error: Invalid value: %s\n", value);
+    } else if (err != ESP_OK) {
+        printf("Error: %s\n", esp_err_to_name(err));
+    } else {
+        printf("OK\n");
+    }
+}
+
+// Parse the band index of an mb subcommand
+static bool parse_mb_band(const char* band_str, int* band)
+{
+    if (band_str == NULL) {
+        return false;
+    }
+    char* end;
+    long b = strtol(band_str, &end, 10);
+    if (*end != '\0' || b < 0 || b >= multiband.config.num_bands) {
+        printf("Error: Band must be 0 to %d\n", multiband.config.num_bands - 1);
+        return false;
+    }
+    *band = (int)b;
+    return true;
+}
+
+// Parse the way index of an xover subcommand
+static bool parse_xover_way(const char* way_str, int* way)
+{
+    if (way_str == NULL) {
+        return false;
+    }
+    char* end;
+    long w = strtol(way_str, &end, 10);
+    if (*end != '\0' || w < 0 || w >= CROSSOVER_WAYS) {
+        printf("Error: Way must be 0 to %d\n", CROSSOVER_WAYS - 1);
+        return false;
+    }
+    *way = (int)w;
+    return true;
+}
+
+static void conv_ir_command(void)
+{
+    char* token = strtok(NULL, " ");
+    esp_err_t err;
+    if (token != NULL && strcmp(token, "begin") == 0) {
+        char* taps_str = strtok(NULL, " ");
+        char* channels_str = strtok(NULL, " ");
+        char* rate_str = strtok(NULL, " ");
+        if (taps_str == NULL) {
+            printf("Error: Usage: conv ir begin <taps> [channels] [rate]\n");
+            return;
+        }
+        convolver_ir_header_t header = {};
+        header.magic = CONVOLVER_IR_MAGIC;
+        header.taps = (uint32_t)strtoul(taps_str, NULL, 10);
+        header.channels = channels_str ? (uint16_t)atoi(channels_str) : 1;
+        header.sample_rate = rate_str ? (uint32_t)strtoul(rate_str, NULL, 10) : 0;
+        err = convolver_ir_begin(&convolver, &header);
+        if (err == ESP_OK) {
+            printf("Upload started: %lu taps x %d channel(s)\n", (unsigned long)header.taps, header.channels);
+        } else {
+            printf("Error: Upload not started: %s (taps 1-%d, channels 1 or 2)\n",
+                   esp_err_to_name(err), CONVOLVER_MAX_TAPS);
+        }
+    }
+    else if (token != NULL && strcmp(token, "data") == 0) {
+        char* index_str = strtok(NULL, " ");
+        if (index_str == NULL) {
+            printf("Error: Usage: conv ir data <index> <tap> [tap ...]\n");
+            return;
+        }
+        uint32_t index = (uint32_t)strtoul(index_str, NULL, 10);
+        int count = 0;
+        err = ESP_OK;
+        for (char* v = strtok(NULL, " "); v != NULL && err == ESP_OK; v = strtok(NULL, " ")) {
+            const float tap = strtof(v, NULL);
+            err = convolver_ir_write(&convolver, (index + count) * sizeof(float), &tap, sizeof(tap));
+            count += (err == ESP_OK) ? 1 : 0;
+        }
+        if (err != ESP_OK) {
+            printf("Error: Tap %lu not accepted: %s (send taps in order)\n",
+                   (unsigned long)(index + count), esp_err_to_name(err));
+        }
+    }
+    else if (token != NULL && strcmp(token, "end") == 0) {
+        char* save_str = strtok(NULL, " ");
+        const bool save = (save_str != NULL && strcmp(save_str, "save") == 0);
+        err = convolver_ir_commit(&convolver, save);
+        if (err == ESP_OK) {
+            printf("Impulse response loaded%s\n", save ? " and saved to flash" : "");
+        } else {
+            printf("Error: Impulse response not loaded: %s\n", esp_err_to_name(err));
+        }
+    }
+    else if (token != NULL && strcmp(token, "abort") == 0) {
+        convolver_ir_abort(&convolver);
+        printf("Upload discarded\n");
+    }
+    else if (token != NULL && strcmp(token, "clear") == 0) {
+        char* erase_str = strtok(NULL, " ");
+        const bool erase = (erase_str != NULL && strcmp(erase_str, "erase") == 0);
+        err = convolver_ir_clear(&convolver, erase);
+        if (err == ESP_OK) {
+            printf("Impulse response cleared%s\n", erase ? " and erased from flash" : "");
+        } else {
+            printf("Error: %s\n", esp_err_to_name(err));
+        }
+    }
+    else {
+        printf("Try: conv ir begin, conv ir data, conv ir end, conv ir abort, conv ir clear\n");
+    }
+}
+
 static void show_subsonic_settings(void)
 {
     printf("\n");
@@ -216,27 +680,407 @@ static void show_subsonic_settings(void)
     printf("\n");
 }
 
+static void show_meter(void)
+{
+    level_meter_snapshot_t meter;
+    esp_err_t err = level_meter_get_snapshot(&meter);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Level meter disabled (enable CONFIG_LEVEL_METER in menuconfig)\n");
+        return;
+    } else if (err != ESP_OK) {
+        printf("Error: Could not read the level meter: %s\n", esp_err_to_name(err));
+        return;
+    }
+
+    printf("\n");
+    printf("Output Level (last %d ms):\n", LEVEL_METER_WINDOW_MS);
+    printf("              Left        Right\n");
+    printf("  Peak:      %6.1f dBFS  %6.1f dBFS\n", meter.peak_db[0], meter.peak_db[1]);
+    printf("  RMS:       %6.1f dBFS  %6.1f dBFS\n", meter.rms_db[0], meter.rms_db[1]);
+    printf("  Peak hold: %6.1f dBFS  %6.1f dBFS\n", meter.peak_max_db[0], meter.peak_max_db[1]);
+    printf("  Clipped:   %6lu       %6lu   samples\n",
+           (unsigned long)meter.clips[0], (unsigned long)meter.clips[1]);
+    if (meter.loudness) {
+        printf("  Loudness:  %.1f LUFS momentary, %.1f LUFS short-term\n",
+               meter.momentary_lufs, meter.short_term_lufs);
+    }
+    if (meter.bands > 0) {
+        printf("  Band GR:  ");
+        for (int b = 0; b < meter.bands; b++) {
+            printf(" %5.1f", meter.band_reduction_db[b]);
+        }
+        printf(" dB (multiband dynamics)\n");
+    }
+    printf("  LED level display: %s\n", vu_meter_enabled ? "on" : "off");
+    printf("\n");
+}
+
+// Bar graph scale of 'spectrum show': one character per 3 dB
+#define SPECTRUM_BAR_DB         3.0f
+#define SPECTRUM_BAR_FLOOR_DB   -90.0f
+
+static void show_spectrum(void)
+{
+    spectrum_snapshot_t snap;
+    esp_err_t err = spectrum_get_snapshot(&snap);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Spectrum analyzer disabled (enable CONFIG_SPECTRUM in menuconfig)\n");
+        return;
+    } else if (err != ESP_OK) {
+        printf("Error: Could not read the spectrum analyzer: %s\n", esp_err_to_name(err));
+        return;
+    }
+
+    printf("\n");
+    printf("Output Spectrum (%s, %lu Hz analysis rate, %.1f Hz bins):\n",
+           spectrum_get_enabled() ? "running" : "stopped",
+           (unsigned long)snap.analysis_rate, snap.resolution_hz);
+    printf("  Analysed: %.1f s (%lu frames), dropped blocks: %lu\n",
+           snap.analysed_s, (unsigned long)snap.frames, (unsigned long)snap.dropped);
+    printf("  Band       Level    Avg\n");
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        const float freq = spectrum_band_freq(b);
+        if (freq >= 0.5f * (float)snap.analysis_rate) {
+            break;
+        }
+        const float level = snap.level_db[b];
+        int bar = (int)((level - SPECTRUM_BAR_FLOOR_DB) / SPECTRUM_BAR_DB);
+        if (bar < 0) {
+            bar = 0;
+        }
+        char bar_str[32];
+        const int bar_len = (bar < (int)sizeof(bar_str) - 1) ? bar : (int)sizeof(bar_str) - 1;
+        memset(bar_str, '#', bar_len);
+        bar_str[bar_len] = '\0';
+        printf("  %-8s %6.1f  %6.1f  %s\n", format_freq(freq), level, snap.average_db[b], bar_str);
+    }
+    printf("\n");
+}
+
+static void suggest_eq(bool apply)
+{
+    spectrum_snapshot_t snap;
+    float gains[EQ_MAX_BANDS];
+    esp_err_t err = spectrum_get_snapshot(&snap);
+    if (err == ESP_OK) {
+        err = spectrum_suggest_eq(&snap, &equalizer, gains);
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Spectrum analyzer disabled (enable CONFIG_SPECTRUM in menuconfig)\n");
+        return;
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        printf("Not enough signal yet: play typical program for at least %.0f s\n",
+               SPECTRUM_SUGGEST_MIN_S);
+        return;
+    } else if (err != ESP_OK) {
+        printf("Error: Could not read the spectrum analyzer: %s\n", esp_err_to_name(err));
+        return;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        const eq_band_t* b = equalizer_get_band(&equalizer, i);
+        if (isnan(gains[i]) || b == NULL || gains[i] == b->gain_db) {
+            continue;
+        }
+        printf("  eq set %d %.1f    (%s, now %+.1f dB)\n", i, gains[i], format_freq(b->freq), b->gain_db);
+        if (apply) {
+            equalizer_set_band_gain(&equalizer, i, gains[i], audio_rate_get());
+        }
+        changed++;
+    }
+
+    if (changed == 0) {
+        printf("No changes suggested: the long-term spectrum is smooth\n");
+    } else if (apply) {
+        persist_mark_dirty(PERSIST_EQUALIZER);
+        printf("Applied %d band gain(s); run again after the averages settle\n", changed);
+    } else {
+        printf("Run 'spectrum suggest apply' to apply\n");
+    }
+}
+
+static void show_xrun(void)
+{
+    audio_xrun_snapshot_t snap;
+    esp_err_t err = audio_xrun_get_snapshot(&snap);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Xrun monitor disabled (enable CONFIG_AUDIO_XRUN in menuconfig)\n");
+        return;
+    } else if (err != ESP_OK) {
+        printf("Error: Could not read the xrun monitor: %s\n", esp_err_to_name(err));
+        return;
+    }
+    
+    printf("\n");
+    printf("Dropouts (uptime %.3f s, %lu blocks of %lu us):\n", esp_timer_get_time() / 1e6,
+           (unsigned long)snap.blocks, (unsigned long)snap.period_us);
+    printf("  Type        | Events | Buffers | Last (s)\n");
+    printf("  ------------|--------|---------|---------\n");
+    for (int t = 0; t < AUDIO_XRUN_TYPE_COUNT; t++) {
+        printf("  %-11s | %6lu | %7lu | ", audio_xrun_type_name((audio_xrun_type_t)t),
+               (unsigned long)snap.events[t], (unsigned long)snap.lost[t]);
+        if (snap.events[t] != 0) {
+            printf("%8.3f\n", snap.last_us[t] / 1e6);
+        } else {
+            printf("%8s\n", "-");
+        }
+    }
+    printf("  Longest deadline overshoot: %lu us\n", (unsigned long)snap.max_late_us);
+    printf("  Fade-ins: %lu\n", (unsigned long)snap.fades);
+    
+    if (snap.total == 0) {
+        printf("\n");
+        return;
+    }
+    printf("\n  Most recent:\n");
+    const uint32_t first = snap.total > AUDIO_XRUN_LOG_SIZE ? snap.total - AUDIO_XRUN_LOG_SIZE : 0;
+    for (uint32_t n = first; n < snap.total; n++) {
+        const audio_xrun_event_t *ev = &snap.log[n % AUDIO_XRUN_LOG_SIZE];
+        printf("  %10.3f s  %-11s", ev->time_us / 1e6, audio_xrun_type_name((audio_xrun_type_t)ev->type));
+        if (ev->type == AUDIO_XRUN_DEADLINE) {
+            printf("  %lu us late in %s\n", (unsigned long)ev->late_us,
+                   dsp_perf_stage_name((dsp_perf_stage_t)ev->stage));
+        } else {
+            printf("  %lu buffer(s)\n", (unsigned long)ev->count);
+        }
+    }
+    printf("\n");
+}
+
+static void show_perf(void)
+{
+    dsp_perf_snapshot_t snap;
+    esp_err_t err = dsp_perf_get_snapshot(&snap);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        printf("Profiler disabled (enable CONFIG_DSP_PERF in menuconfig)\n");
+        return;
+    } else if (err != ESP_OK) {
+        printf("Error: Could not read profiler statistics: %s\n", esp_err_to_name(err));
+        return;
+    }
+    
+    const dsp_perf_stage_stats_t *chain = &snap.stages[DSP_PERF_CHAIN];
+    printf("\n");
+    printf("DSP Profiler (%s chain, %lu MHz):\n", dsp_chain_mode_name(dsp_chain_get_mode()),
+           (unsigned long)snap.cpu_mhz);
+    if (chain->count == 0) {
+        printf("  No blocks recorded yet\n\n");
+        return;
+    }
+    printf("  Blocks: %lu  Overruns: %lu  Deadline: %.0f us\n",
+           (unsigned long)snap.blocks, (unsigned long)snap.overruns,
+           dsp_perf_cycles_to_us(&snap, snap.deadline_cycles));
+    printf("  DSP load: avg %.1f%%  max %.1f%%\n", dsp_perf_avg_load(&snap, DSP_PERF_CHAIN),
+           100.0f * chain->max / snap.deadline_cycles);
+    printf("\n");
+    printf("  Section   |   Min us |   Avg us |   Max us | Avg load\n");
+    printf("  ----------|----------|----------|----------|---------\n");
+    for (int i = 0; i < DSP_PERF_STAGE_COUNT; i++) {
+        const dsp_perf_stage_stats_t *st = &snap.stages[i];
+        if (st->count == 0) {
+            continue;
+        }
+        printf("  %-9s | %8.1f | %8.1f | %8.1f | %6.1f%%\n", dsp_perf_stage_name((dsp_perf_stage_t)i),
+               dsp_perf_cycles_to_us(&snap, st->min),
+               dsp_perf_cycles_to_us(&snap, st->total) / st->count,
+               dsp_perf_cycles_to_us(&snap, st->max),
+               dsp_perf_avg_load(&snap, (dsp_perf_stage_t)i));
+    }
+    
+    printf("\n  Histogram (blocks per %% of deadline):\n");
+    printf("  %-9s", "");
+    for (int b = 0; b < DSP_PERF_HIST_BINS - 1; b++) {
+        printf(" %5d%%", (b + 1) * 10);
+    }
+    printf("  >100%%\n");
+    for (int i = 0; i < DSP_PERF_STAGE_COUNT; i++) {
+        const dsp_perf_stage_stats_t *st = &snap.stages[i];
+        if (st->count == 0) {
+            continue;
+        }
+        printf("  %-9s", dsp_perf_stage_name((dsp_perf_stage_t)i));
+        for (int b = 0; b < DSP_PERF_HIST_BINS; b++) {
+            printf(" %6lu", (unsigned long)st->hist[b]);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+static void run_bench(void)
+{
+    static dsp_bench_result_t result;  // Too large for the command task stack
+    
+    printf("Running DSP benchmark (audio is interrupted while it runs)...\n");
+    esp_err_t err = dsp_bench_run(&result);
+    if (err != ESP_OK) {
+        printf("Error: Benchmark failed: %s\n", esp_err_to_name(err));
+        return;
+    }
+    
+    printf("\n");
+    printf("DSP Benchmark:\n");
+    printf("  CPU: %lu MHz  PSRAM: ", (unsigned long)result.cpu_mhz);
+    if (result.psram_bytes > 0) {
+        printf("%u KB\n", (unsigned int)(result.psram_bytes / 1024));
+    } else {
+        printf("none\n");
+    }
+    printf("  Block: %d frames @ %lu Hz (deadline %.0f us)\n", result.block_frames, (unsigned long)audio_rate_get(),
+           (float)result.deadline_cycles / result.cpu_mhz);
+    printf("\n");
+    printf("  Current settings | Avg load | Worst load\n");
+    printf("  -----------------|----------|-----------\n");
+    printf("  staged           | %7.1f%% | %8.1f%%\n",
+           dsp_bench_load(&result, &result.staged, false), dsp_bench_load(&result, &result.staged, true));
+    printf("  fused            | %7.1f%% | %8.1f%%\n",
+           dsp_bench_load(&result, &result.fused, false), dsp_bench_load(&result, &result.fused, true));
+    printf("  float            | %7.1f%% | %8.1f%%\n",
+           dsp_bench_load(&result, &result.float32, false), dsp_bench_load(&result, &result.float32, true));
+    printf("\n");
+    printf("  EQ bands (%s) | Avg load | Worst load\n", dsp_chain_mode_name(result.mode));
+    printf("  ----------------|----------|-----------\n");
+    for (int n = 0; n <= EQ_MAX_BANDS; n++) {
+        printf("  %15d | %7.1f%% | %8.1f%%\n", n,
+               dsp_bench_load(&result, &result.bands[n], false), dsp_bench_load(&result, &result.bands[n], true));
+    }
+    printf("\n");
+    printf("  Within %d%% of the deadline (worst block):\n", DSP_BENCH_BUDGET_PCT);
+    printf("    Max sample rate: %lu Hz (current settings, %s)\n",
+           (unsigned long)result.max_sample_rate, dsp_chain_mode_name(result.mode));
+    if (result.max_bands >= 0) {
+        printf("    Max EQ bands:    %d at %lu Hz\n", result.max_bands, (unsigned long)audio_rate_get());
+    } else {
+        printf("    Max EQ bands:    none (chain over budget without EQ)\n");
+    }
+    printf("\n");
+}
+
+static void show_io(void)
+{
+    audio_lowlat_stats_t io;
+    audio_lowlat_get_stats(&io);
+    if (!io.running) {
+        printf("Low-latency I/O not running (enable CONFIG_AUDIO_LOW_LATENCY)\n");
+        return;
+    }
+
+    printf("\n");
+    printf("Low-latency I/O:\n");
+    printf("  DMA geometry: %lu buffers x %lu frames (%.2f ms per block)\n",
+           (unsigned long)io.descs, (unsigned long)io.frames, 1000.0f * io.frames / audio_rate_get());
+    printf("  Nominal latency: %.2f ms\n", io.nominal_ms);
+    if (io.blocks > 0) {
+        printf("  Measured latency: %.2f ms (min %.2f, max %.2f)\n",
+               io.latency_ms, io.latency_min_ms, io.latency_max_ms);
+        printf("  Worst slack: %.2f ms before the TX buffer was due\n", io.min_slack_ms);
+    }
+    printf("  Blocks: %lu (%lu missed, %lu late)\n",
+           (unsigned long)io.blocks, (unsigned long)io.missed, (unsigned long)io.late);
+    if (limiter.enabled) {
+        printf("  Limiter lookahead adds %.2f ms\n",
+               1000.0f * limiter.lookahead_samples / I2S_NUM_CHANNELS / audio_rate_get());
+    }
+    printf("  (converter delays of the ADC and DAC not included)\n");
+    printf("\n");
+}
+
 static void show_system_status(void)
 {
     printf("\n");
     printf("System Status:\n");
-    printf("  Sample Rate: %d Hz\n", SAMPLE_RATE);
+    printf("  Sample Rate: %lu Hz\n", (unsigned long)audio_rate_get());
     printf("  Channels: %d (Stereo)\n", I2S_NUM_CHANNELS);
     printf("  Buffer Size: %d samples\n", DMA_BUFFER_SIZE);
     printf("  Bit Depth: 24-bit\n");
+    audio_pipeline_stats_t pipe;
+    audio_pipeline_get_stats(&pipe);
+    audio_lowlat_stats_t io;
+    audio_lowlat_get_stats(&io);
+    if (io.running) {
+        printf("  Pipeline: low-latency, %lu x %lu frames (%.2f ms measured, %lu missed)\n",
+               (unsigned long)io.descs, (unsigned long)io.frames, io.latency_ms, (unsigned long)io.missed);
+    } else if (pipe.running) {
+        printf("  Pipeline: dual-core, depth %d (%lu blocks, %lu late, max %lu queued)\n", pipe.depth,
+               (unsigned long)pipe.blocks, (unsigned long)pipe.late, (unsigned long)pipe.max_queued);
+    } else {
+        printf("  Pipeline: single task\n");
+    }
+    printf("\n");
+    printf("DSP Processing Chain (%s):\n", dsp_chain_mode_name(dsp_chain_get_mode()));
+    for (int i = 0; i < dsp_chain_stage_count(); i++) {
+        switch (dsp_chain_stage_at(i)) {
+            case DSP_STAGE_SUBSONIC:
+                printf("  %d. Subsonic Filter: %s (%.1f Hz HPF)\n", i + 1,
+                       subsonic_get_enabled(&subsonic) ? "ON" : "OFF",
+                       subsonic_get_frequency(&subsonic));
+                break;
+            case DSP_STAGE_PREGAIN:
+                printf("  %d. Pre-Gain: %s (%+.1f dB)\n", i + 1,
+                       pregain_is_enabled(&pregain) ? "ON" : "OFF",
+                       pregain_get_gain(&pregain));
+                break;
+            case DSP_STAGE_EQUALIZER:
+                printf("  %d. Equalizer: %s (%d active bands)\n", i + 1,
+                       equalizer.enabled ? "ON" : "OFF",
+                       equalizer_get_active_bands(&equalizer));
+                break;
+            case DSP_STAGE_CONVOLVER: {
+                convolver_info_t conv;
+                convolver_get_info(&convolver, &conv);
+                if (conv.loaded) {
+                    printf("  %d. Convolver: %s (%lu taps%s)\n", i + 1,
+                           convolver.enabled ? "ON" : "OFF", (unsigned long)conv.taps,
+                           conv.rate_mismatch ? ", rate mismatch" : "");
+                } else {
+                    printf("  %d. Convolver: %s (no response loaded)\n", i + 1,
+                           convolver.enabled ? "ON" : "OFF");
+                }
+                break;
+            }
+            case DSP_STAGE_MULTIBAND:
+                printf("  %d. Multiband Dynamics: %s (%d bands)\n", i + 1,
+                       multiband.enabled ? "ON" : "OFF", multiband.config.num_bands);
+                break;
+            case DSP_STAGE_LIMITER:
+                printf("  %d. Limiter: %s (%.1f dB)\n", i + 1,
+                       limiter.enabled ? "ON" : "OFF",
+                       limiter_get_threshold(&limiter));
+                break;
+            case DSP_STAGE_DELAY:
+                printf("  %d. Output Delay: %s (L %.2f ms, R %.2f ms)\n", i + 1,
+                       delay_line.enabled ? "ON" : "OFF",
+                       delay_line.config.delay_ms[0], delay_line.config.delay_ms[1]);
+                break;
+            default:
+                break;
+        }
+    }
+    if (CROSSOVER_ENABLED) {
+        printf("  Crossover: %d ways on %s (", CROSSOVER_WAYS, crossover_output_name());
+        for (int p = 0; p < CROSSOVER_POINTS; p++) {
+            printf("%s%s", p > 0 ? ", " : "", format_freq(crossover.config.freq[p]));
+        }
+        printf(")\n");
+    }
+    dsp_perf_snapshot_t perf;
+    if (dsp_perf_get_snapshot(&perf) == ESP_OK && perf.stages[DSP_PERF_CHAIN].count > 0) {
+        printf("  DSP load: %.1f%% of block deadline (avg)\n", dsp_perf_avg_load(&perf, DSP_PERF_CHAIN));
+    }
     printf("\n");
-    printf("DSP Processing Chain:\n");
-    printf("  1. Subsonic Filter: %s (%.1f Hz HPF)\n", 
-           subsonic_get_enabled(&subsonic) ? "ON" : "OFF",
-           subsonic_get_frequency(&subsonic));
-    printf("  2. Pre-Gain: %s (%+.1f dB)\n", 
-           pregain_is_enabled(&pregain) ? "ON" : "OFF",
-           pregain_get_gain(&pregain));
-    printf("  3. Equalizer: %s (5-band)\n", 
-           equalizer.enabled ? "ON" : "OFF");
-    printf("  4. Limiter: %s (%.1f dB)\n", 
-           limiter.enabled ? "ON" : "OFF",
-           limiter_get_threshold(&limiter));
+    persist_stats_t saved;
+    persist_get_stats(&saved);
+    printf("  Settings: %lu changes, %lu flash writes, %lu failed",
+           (unsigned long)saved.changes, (unsigned long)saved.writes, (unsigned long)saved.errors);
+    if (saved.pending != 0) {
+        printf(", pending:");
+        for (int i = 0; i < PERSIST_MODULE_COUNT; i++) {
+            if (saved.pending & (1u << i)) {
+                printf(" %s", persist_module_name((persist_module_t)i));
+            }
+        }
+    }
     printf("\n");
     printf("  Free Heap: %d bytes\n", (int) esp_get_free_heap_size());
     printf("  Min Free Heap: %d bytes\n", (int) esp_get_minimum_free_heap_size());
@@ -274,6 +1118,46 @@ static void process_command(char* cmd)
     else if (strcmp(token, "status") == 0) {
         show_system_status();
     }
+    else if (strcmp(token, "set") == 0) {
+        // Same paths as the MQTT topics, all pairs applied together
+        char* path = strtok(NULL, " ");
+        if (path == NULL) {
+            printf("Error: Usage: set <path> <value> [<path> <value> ...]\n");
+            printf("Example: set eq/band/0 6.0 eq/band/0/q 0.9 limiter/threshold -1.5\n");
+            return;
+        }
+        
+        int count = 0;
+        esp_err_t err = ESP_OK;
+        dsp_control_begin();
+        for (; path != NULL && err == ESP_OK; path = strtok(NULL, " ")) {
+            char* value = strtok(NULL, " ");
+            if (value == NULL) {
+                printf("Error: No value for %s\n", path);
+                err = ESP_ERR_INVALID_ARG;
+                break;
+            }
+            err = dsp_control_set(path, strlen(path), value, strlen(value));
+            if (err == ESP_ERR_NOT_FOUND) {
+                printf("Error: Unknown path: %s\n", path);
+            } else if (err != ESP_OK) {
+                printf("Error: Invalid value for %s: %s\n", path, value);
+            }
+            count++;
+        }
+        
+        esp_err_t save_err = ESP_OK;
+        if (err != ESP_OK) {
+            dsp_control_abort();
+            printf("Nothing applied\n");
+        } else if (dsp_control_commit(NULL, &save_err) != ESP_OK) {
+            printf("Error: Sample rate change failed, nothing applied\n");
+        } else if (save_err != ESP_OK) {
+            printf("Applied %d setting(s), but saving failed: %s\n", count, esp_err_to_name(save_err));
+        } else {
+            printf("Applied %d setting(s)\n", count);
+        }
+    }
     else if (strcmp(token, "wifi") == 0) {
         token = strtok(NULL, " ");
         if (token == NULL) {
@@ -349,6 +1233,21 @@ static void process_command(char* cmd)
             } else {
                 printf("  State: Disconnected\n");
             }
+            telemetry_stats_t stats;
+            telemetry_get_stats(&stats);
+            printf("  Telemetry: every %d ms, up to %d topics at a time\n",
+                   TELEMETRY_INTERVAL_MS, TELEMETRY_BURST);
+            printf("  Published: %lu messages, %lu KiB, %lu failed\n",
+                   (unsigned long)stats.published, (unsigned long)stats.kbytes,
+                   (unsigned long)stats.failed);
+            printf("  Held back: %lu merged, %lu unchanged, %lu deferred\n",
+                   (unsigned long)stats.coalesced, (unsigned long)stats.unchanged,
+                   (unsigned long)stats.deferred);
+            if (TELEMETRY_SNAPSHOT_ENABLED) {
+                printf("  Snapshots: %lu (%lu full), last %lu bytes (%s)\n",
+                       (unsigned long)stats.snapshots, (unsigned long)stats.keyframes,
+                       (unsigned long)stats.last_snapshot_bytes, TELEMETRY_CBOR ? "CBOR" : "JSON");
+            }
             printf("\n");
         }
         else if (strcmp(token, "set") == 0) {
@@ -385,7 +1284,7 @@ static void process_command(char* cmd)
             
             esp_err_t err = mqtt_manager_publish_all_states();
             if (err == ESP_OK) {
-                printf("Published all states to MQTT\n");
+                printf("All states queued for publishing\n");
             } else {
                 printf("Error: Failed to publish states\n");
             }
@@ -399,7 +1298,7 @@ static void process_command(char* cmd)
         token = strtok(NULL, " ");
         if (token == NULL) {
             printf("Error: EQ command requires subcommand\n");
-            printf("Try: eq show, eq set, eq pregain, eq enable, eq disable, eq reset, eq preset, eq save\n");
+            printf("Try: eq show, eq set, eq band, eq enable, eq disable, eq reset, eq preset, eq save, eq selftest\n");
             return;
         }
         
@@ -419,8 +1318,8 @@ static void process_command(char* cmd)
             int band = atoi(band_str);
             float gain = atof(gain_str);
             
-            if (band < 0 || band >= 5) {
-                printf("Error: Band must be 0-4 (0=60Hz, 1=250Hz, 2=1kHz, 3=4kHz, 4=12kHz)\n");
+            if (band < 0 || band >= EQ_MAX_BANDS) {
+                printf("Error: Band must be 0-%d\n", EQ_MAX_BANDS - 1);
                 return;
             }
             
@@ -428,41 +1327,82 @@ static void process_command(char* cmd)
                 printf("Warning: Gain clamped to range -12.0 to +12.0 dB\n");
             }
             
-            bool success = equalizer_set_band_gain(&equalizer, band, gain, SAMPLE_RATE);
+            bool success = equalizer_set_band_gain(&equalizer, band, gain, audio_rate_get());
             if (success) {
-                const char* band_names[] = {"60Hz", "250Hz", "1kHz", "4kHz", "12kHz"};
-                printf("Set %s (band %d) to %.1f dB\n", band_names[band], band, equalizer.gain_db[band]);
+                const eq_band_t* b = equalizer_get_band(&equalizer, band);
+                printf("Set %s (band %d) to %.1f dB\n", format_freq(b->freq), band, b->gain_db);
                 
-                // Save settings to flash
-                esp_err_t err = equalizer_save_settings(&equalizer);
-                if (err != ESP_OK) {
-                    printf("Warning: Failed to save settings to flash\n");
-                }
+                // Saved to flash once the changes settle
+                persist_mark_dirty(PERSIST_EQUALIZER);
             } else {
                 printf("Error: Failed to set band gain\n");
             }
         }
-        else if (strcmp(token, "enable") == 0) {
-            equalizer_set_enabled(&equalizer, true);
-            printf("Equalizer enabled\n");
+        else if (strcmp(token, "band") == 0) {
+            char* band_str = strtok(NULL, " ");
+            char* type_str = strtok(NULL, " ");
             
-            // Save settings to flash
-            esp_err_t err = equalizer_save_settings(&equalizer);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
+            if (band_str == NULL || type_str == NULL) {
+                printf("Error: Usage: eq band <band> <type> <freq> [q] [gain] | eq band <band> on|off\n");
+                printf("Example: eq band 5 lowshelf 100 0.7 3.0\n");
+                return;
             }
-        }
-        else if (strcmp(token, "disable") == 0) {
-            equalizer_set_enabled(&equalizer, false);
-            printf("Equalizer disabled (bypass mode)\n");
             
-            // Save settings to flash
-            esp_err_t err = equalizer_save_settings(&equalizer);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
+            int band = atoi(band_str);
+            const eq_band_t* current = equalizer_get_band(&equalizer, band);
+            if (current == NULL) {
+                printf("Error: Band must be 0-%d\n", EQ_MAX_BANDS - 1);
+                return;
             }
-        }
-        else if (strcmp(token, "reset") == 0) {
+            
+            eq_band_t config = *current;
+            if (strcmp(type_str, "on") == 0 || strcmp(type_str, "off") == 0) {
+                config.enabled = (strcmp(type_str, "on") == 0);
+            } else {
+                if (!equalizer_type_from_name(type_str, &config.type)) {
+                    printf("Error: Unknown filter type: %s\n", type_str);
+                    printf("Types: peaking, lowshelf, highshelf, lowpass, highpass, notch\n");
+                    return;
+                }
+                char* freq_str = strtok(NULL, " ");
+                char* q_str = strtok(NULL, " ");
+                char* gain_str = strtok(NULL, " ");
+                if (freq_str == NULL) {
+                    printf("Error: Usage: eq band <band> <type> <freq> [q] [gain]\n");
+                    return;
+                }
+                config.freq = atof(freq_str);
+                if (q_str != NULL) config.q = atof(q_str);
+                if (gain_str != NULL) config.gain_db = atof(gain_str);
+                config.enabled = true;
+            }
+            
+            if (equalizer_set_band(&equalizer, band, &config, audio_rate_get())) {
+                const eq_band_t* b = equalizer_get_band(&equalizer, band);
+                printf("Band %d: %s %s Q %.2f %+.1f dB (%s)\n", band, equalizer_type_name(b->type),
+                       format_freq(b->freq), b->q, b->gain_db, b->enabled ? "on" : "off");
+                
+                // Saved to flash once the changes settle
+                persist_mark_dirty(PERSIST_EQUALIZER);
+            } else {
+                printf("Error: Failed to configure band\n");
+            }
+        }
+        else if (strcmp(token, "enable") == 0) {
+            equalizer_set_enabled(&equalizer, true);
+            printf("Equalizer enabled\n");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_EQUALIZER);
+        }
+        else if (strcmp(token, "disable") == 0) {
+            equalizer_set_enabled(&equalizer, false);
+            printf("Equalizer disabled (bypass mode)\n");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_EQUALIZER);
+        }
+        else if (strcmp(token, "reset") == 0) {
             equalizer_reset(&equalizer);
             printf("Equalizer state reset (filter history cleared)\n");
         }
@@ -473,32 +1413,33 @@ static void process_command(char* cmd)
                 printf("Available: flat, bass, vocal, rock, jazz\n");
                 return;
             }
+            // Saved to flash once the changes settle
             apply_preset(preset_name);
-            
-            // Save settings to flash
-            esp_err_t err = equalizer_save_settings(&equalizer);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
         }
         else if (strcmp(token, "save") == 0) {
-            esp_err_t err = equalizer_save_settings(&equalizer);
+            esp_err_t err = persist_save_now(PERSIST_EQUALIZER);
             if (err == ESP_OK) {
                 printf("Equalizer settings saved to flash successfully\n");
             } else {
                 printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
             }
         }
+        else if (strcmp(token, "selftest") == 0) {
+            float max_deviation_db = 0.0f;
+            esp_err_t err = equalizer_kernel_selftest(&max_deviation_db);
+            printf("EQ kernel self-test %s: max response deviation %.4f dB (limit %.2f dB)\n",
+                   err == ESP_OK ? "passed" : "FAILED", max_deviation_db, EQ_SELFTEST_MAX_DEVIATION_DB);
+        }
         else {
             printf("Unknown EQ subcommand: %s\n", token);
-            printf("Try: eq show, eq set, eq enable, eq disable, eq reset, eq preset, eq save\n");
+            printf("Try: eq show, eq set, eq band, eq enable, eq disable, eq reset, eq preset, eq save, eq selftest\n");
         }
     }
     else if (strcmp(token, "lim") == 0 || strcmp(token, "limiter") == 0) {
         token = strtok(NULL, " ");
         if (token == NULL) {
             printf("Error: Limiter command requires subcommand\n");
-            printf("Try: lim show, lim threshold, lim enable, lim disable, lim reset, lim stats, lim save\n");
+            printf("Try: lim show, lim threshold, lim enable, lim disable, lim truepeak, lim reset, lim stats, lim save\n");
             return;
         }
         
@@ -524,11 +1465,8 @@ static void process_command(char* cmd)
             if (success) {
                 printf("Set limiter threshold to %.1f dB\n", limiter_get_threshold(&limiter));
                 
-                // Save settings to flash
-                esp_err_t err = limiter_save_settings(&limiter);
-                if (err != ESP_OK) {
-                    printf("Warning: Failed to save settings to flash\n");
-                }
+                // Saved to flash once the changes settle
+                persist_mark_dirty(PERSIST_LIMITER);
             } else {
                 printf("Error: Failed to set threshold\n");
             }
@@ -537,21 +1475,29 @@ static void process_command(char* cmd)
             limiter_set_enabled(&limiter, true);
             printf("Limiter enabled\n");
             
-            // Save settings to flash
-            esp_err_t err = limiter_save_settings(&limiter);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_LIMITER);
         }
         else if (strcmp(token, "disable") == 0) {
             limiter_set_enabled(&limiter, false);
             printf("Limiter disabled (bypass mode)\n");
             
-            // Save settings to flash
-            esp_err_t err = limiter_save_settings(&limiter);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_LIMITER);
+        }
+        else if (strcmp(token, "truepeak") == 0) {
+            char* mode_str = strtok(NULL, " ");
+            
+            if (mode_str == NULL || (strcmp(mode_str, "on") != 0 && strcmp(mode_str, "off") != 0)) {
+                printf("Error: Usage: lim truepeak <on|off>\n");
+                return;
             }
+            
+            limiter_set_true_peak(&limiter, strcmp(mode_str, "on") == 0);
+            printf("Limiter detection: %s\n", limiter_get_true_peak(&limiter) ? "true peak (4x oversampled)" : "sample peak");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_LIMITER);
         }
         else if (strcmp(token, "reset") == 0) {
             limiter_reset(&limiter);
@@ -561,7 +1507,7 @@ static void process_command(char* cmd)
             show_limiter_stats();
         }
         else if (strcmp(token, "save") == 0) {
-            esp_err_t err = limiter_save_settings(&limiter);
+            esp_err_t err = persist_save_now(PERSIST_LIMITER);
             if (err == ESP_OK) {
                 printf("Limiter settings saved to flash successfully\n");
             } else {
@@ -570,7 +1516,421 @@ static void process_command(char* cmd)
         }
         else {
             printf("Unknown limiter subcommand: %s\n", token);
-            printf("Try: lim show, lim threshold, lim enable, lim disable, lim reset, lim stats, lim save\n");
+            printf("Try: lim show, lim threshold, lim enable, lim disable, lim truepeak, lim reset, lim stats, lim save\n");
+        }
+    }
+    else if (strcmp(token, "conv") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_conv_settings();
+        }
+        else if (strcmp(token, "enable") == 0 || strcmp(token, "disable") == 0) {
+            const bool enable = (strcmp(token, "enable") == 0);
+            convolver_set_enabled(&convolver, enable);
+            printf("Convolver %s\n", enable ? "enabled" : "disabled (bypass mode)");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CONVOLVER);
+        }
+        else if (strcmp(token, "gain") == 0) {
+            char* gain_str = strtok(NULL, " ");
+            if (gain_str == NULL) {
+                printf("Error: Usage: conv gain <db>\n");
+                return;
+            }
+            convolver_set_gain(&convolver, atof(gain_str));
+            printf("Set convolver gain to %+.1f dB\n", convolver.gain_db);
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CONVOLVER);
+        }
+        else if (strcmp(token, "reset") == 0) {
+            convolver_reset(&convolver);
+            printf("Convolver history cleared\n");
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = persist_save_now(PERSIST_CONVOLVER);
+            if (err == ESP_OK) {
+                printf("Convolver settings saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else if (strcmp(token, "ir") == 0) {
+            conv_ir_command();
+        }
+        else {
+            printf("Unknown convolver subcommand: %s\n", token);
+            printf("Try: conv show, conv enable, conv disable, conv gain, conv reset, conv save, conv ir\n");
+        }
+    }
+    else if (strcmp(token, "xover") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_xover_settings();
+        }
+        else if (!CROSSOVER_ENABLED) {
+            printf("Error: Crossover not available (enable CROSSOVER in menuconfig)\n");
+        }
+        else if (strcmp(token, "freq") == 0) {
+            char* point_str = strtok(NULL, " ");
+            char* freq_str = strtok(NULL, " ");
+            if (point_str == NULL || freq_str == NULL) {
+                printf("Error: Usage: xover freq <point> <hz>\n");
+                return;
+            }
+            int point = atoi(point_str);
+            float freq = atof(freq_str);
+            if (!crossover_set_freq(&crossover, point, freq)) {
+                printf("Error: Point must be 0 to %d, %.0f to %.0f Hz, below 45%% of the sample rate "
+                       "and between its neighbours\n",
+                       CROSSOVER_POINTS - 1, CROSSOVER_MIN_FREQ, CROSSOVER_MAX_FREQ);
+                return;
+            }
+            printf("Set crossover point %d to %s\n", point, format_freq(freq));
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CROSSOVER);
+        }
+        else if (strcmp(token, "gain") == 0 || strcmp(token, "delay") == 0) {
+            const bool gain = (strcmp(token, "gain") == 0);
+            int way;
+            if (!parse_xover_way(strtok(NULL, " "), &way)) {
+                printf("Error: Usage: xover %s <way> <%s>\n", token, gain ? "db" : "ms");
+                return;
+            }
+            char* value_str = strtok(NULL, " ");
+            if (value_str == NULL) {
+                printf("Error: Usage: xover %s <way> <%s>\n", token, gain ? "db" : "ms");
+                return;
+            }
+            if (gain) {
+                crossover_set_gain(&crossover, way, atof(value_str));
+                printf("Set way %d gain to %+.1f dB\n", way, crossover.config.ways[way].gain_db);
+            } else {
+                crossover_set_delay(&crossover, way, atof(value_str));
+                printf("Set way %d delay to %.3f ms\n", way, crossover.config.ways[way].delay_ms);
+            }
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CROSSOVER);
+        }
+        else if (strcmp(token, "invert") == 0) {
+            int way;
+            if (!parse_xover_way(strtok(NULL, " "), &way)) {
+                printf("Error: Usage: xover invert <way> <on|off>\n");
+                return;
+            }
+            char* mode_str = strtok(NULL, " ");
+            if (mode_str == NULL || (strcmp(mode_str, "on") != 0 && strcmp(mode_str, "off") != 0)) {
+                printf("Error: Usage: xover invert <way> <on|off>\n");
+                return;
+            }
+            crossover_set_invert(&crossover, way, strcmp(mode_str, "on") == 0);
+            printf("Way %d polarity %s\n", way, crossover.config.ways[way].invert ? "inverted" : "normal");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CROSSOVER);
+        }
+        else if (strcmp(token, "limit") == 0) {
+            int way;
+            if (!parse_xover_way(strtok(NULL, " "), &way)) {
+                printf("Error: Usage: xover limit <way> <db> [truepeak <on|off>]\n");
+                return;
+            }
+            char* db_str = strtok(NULL, " ");
+            if (db_str == NULL) {
+                printf("Error: Usage: xover limit <way> <db> [truepeak <on|off>]\n");
+                return;
+            }
+            bool true_peak = crossover.config.ways[way].true_peak != 0;
+            char* opt_str = strtok(NULL, " ");
+            if (opt_str != NULL) {
+                char* mode_str = strtok(NULL, " ");
+                if (strcmp(opt_str, "truepeak") != 0 || mode_str == NULL ||
+                    (strcmp(mode_str, "on") != 0 && strcmp(mode_str, "off") != 0)) {
+                    printf("Error: Usage: xover limit <way> <db> [truepeak <on|off>]\n");
+                    return;
+                }
+                true_peak = (strcmp(mode_str, "on") == 0);
+            }
+            if (!crossover_set_limit(&crossover, way, atof(db_str), true_peak)) {
+                printf("Error: Invalid limiter threshold: %s\n", db_str);
+                return;
+            }
+            printf("Set way %d limiter to %.1f dB%s\n", way, crossover.config.ways[way].limit_db,
+                   true_peak ? " (true-peak)" : "");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_CROSSOVER);
+        }
+        else if (strcmp(token, "reset") == 0) {
+            crossover_reset(&crossover);
+            printf("Crossover history cleared\n");
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = persist_save_now(PERSIST_CROSSOVER);
+            if (err == ESP_OK) {
+                printf("Crossover settings saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            printf("Unknown crossover subcommand: %s\n", token);
+            printf("Try: xover show, xover freq, xover gain, xover delay, xover invert, xover limit, xover reset, xover save\n");
+        }
+    }
+    else if (strcmp(token, "mb") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_mb_settings();
+        }
+        else if (!MULTIBAND_ENABLED) {
+            printf("Error: Multiband dynamics not available (enable MULTIBAND in menuconfig)\n");
+        }
+        else if (strcmp(token, "enable") == 0 || strcmp(token, "disable") == 0) {
+            const bool enable = (strcmp(token, "enable") == 0);
+            multiband_set_enabled(&multiband, enable);
+            printf("Multiband dynamics %s\n", enable ? "enabled" : "disabled (bypass mode)");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_MULTIBAND);
+        }
+        else if (strcmp(token, "bands") == 0) {
+            char* bands_str = strtok(NULL, " ");
+            if (bands_str == NULL) {
+                printf("Error: Usage: mb bands <n>\n");
+                return;
+            }
+            if (!multiband_set_bands(&multiband, atoi(bands_str))) {
+                printf("Error: Bands must be %d to %d\n", MULTIBAND_MIN_BANDS, MULTIBAND_MAX_BANDS);
+                return;
+            }
+            printf("Multiband dynamics on %d bands\n", multiband.config.num_bands);
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_MULTIBAND);
+        }
+        else if (strcmp(token, "freq") == 0) {
+            char* point_str = strtok(NULL, " ");
+            char* freq_str = strtok(NULL, " ");
+            if (point_str == NULL || freq_str == NULL) {
+                printf("Error: Usage: mb freq <point> <hz>\n");
+                return;
+            }
+            int point = atoi(point_str);
+            float freq = atof(freq_str);
+            if (!multiband_set_freq(&multiband, point, freq)) {
+                printf("Error: Point must be 0 to %d, %.0f to %.0f Hz, below 45%% of the sample rate "
+                       "and between its neighbours\n",
+                       multiband.config.num_bands - 2, MULTIBAND_MIN_FREQ, MULTIBAND_MAX_FREQ);
+                return;
+            }
+            printf("Set split point %d to %s\n", point, format_freq(freq));
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_MULTIBAND);
+        }
+        else if (strcmp(token, "band") == 0 || strcmp(token, "expander") == 0) {
+            const bool expander = (strcmp(token, "expander") == 0);
+            int b;
+            char* threshold_str = NULL;
+            char* ratio_str = NULL;
+            if (parse_mb_band(strtok(NULL, " "), &b)) {
+                threshold_str = strtok(NULL, " ");
+                ratio_str = strtok(NULL, " ");
+            }
+            if (threshold_str == NULL || ratio_str == NULL) {
+                printf("Error: Usage: %s\n", expander ? "mb expander <band> <threshold> <ratio>"
+                       : "mb band <band> <threshold> <ratio> [attack] [release] [makeup]");
+                return;
+            }
+            multiband_band_settings_t band = multiband.config.bands[b];
+            if (expander) {
+                band.exp_threshold_db = atof(threshold_str);
+                band.exp_ratio = atof(ratio_str);
+            } else {
+                band.threshold_db = atof(threshold_str);
+                band.ratio = atof(ratio_str);
+                char* attack_str = strtok(NULL, " ");
+                char* release_str = (attack_str != NULL) ? strtok(NULL, " ") : NULL;
+                char* makeup_str = (release_str != NULL) ? strtok(NULL, " ") : NULL;
+                if (attack_str != NULL) band.attack_ms = atof(attack_str);
+                if (release_str != NULL) band.release_ms = atof(release_str);
+                if (makeup_str != NULL) band.makeup_db = atof(makeup_str);
+            }
+            multiband_set_band(&multiband, b, &band);
+            const multiband_band_settings_t *set = &multiband.config.bands[b];
+            if (expander) {
+                printf("Band %d expander: %.1f dBFS 1:%.1f\n", b, set->exp_threshold_db, set->exp_ratio);
+            } else {
+                printf("Band %d compressor: %.1f dBFS %.1f:1, attack %.1f ms, release %.0f ms, makeup %+.1f dB\n",
+                       b, set->threshold_db, set->ratio, set->attack_ms, set->release_ms, set->makeup_db);
+            }
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_MULTIBAND);
+        }
+        else if (strcmp(token, "reset") == 0) {
+            multiband_reset(&multiband);
+            printf("Multiband history cleared\n");
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = persist_save_now(PERSIST_MULTIBAND);
+            if (err == ESP_OK) {
+                printf("Multiband settings saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            printf("Unknown multiband subcommand: %s\n", token);
+            printf("Try: mb show, mb enable, mb disable, mb bands, mb freq, mb band, mb expander, mb reset, mb save\n");
+        }
+    }
+    else if (strcmp(token, "delay") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_delay_settings();
+        }
+        else if (!DELAY_LINE_ENABLED) {
+            printf("Error: Output delay not available (enable DELAY_LINE in menuconfig)\n");
+        }
+        else if (strcmp(token, "enable") == 0 || strcmp(token, "disable") == 0) {
+            const bool enable = (strcmp(token, "enable") == 0);
+            delay_line_set_enabled(&delay_line, enable);
+            printf("Output delay %s\n", enable ? "enabled" : "disabled (bypass mode)");
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_DELAY);
+        }
+        else if (strcmp(token, "left") == 0 || strcmp(token, "right") == 0) {
+            const int channel = (strcmp(token, "left") == 0) ? 0 : 1;
+            char* ms_str = strtok(NULL, " ");
+            if (ms_str == NULL) {
+                printf("Error: Usage: delay %s <ms>\n", token);
+                return;
+            }
+            float ms = atof(ms_str);
+            if (ms < 0.0f || ms > (float)DELAY_LINE_MAX_MS) {
+                printf("Error: Delay must be 0 to %d ms\n", DELAY_LINE_MAX_MS);
+                return;
+            }
+            delay_line_set_delay(&delay_line, channel, ms);
+            printf("%s delay set to %.3f ms (%.2f frames)\n", channel == 0 ? "Left" : "Right",
+                   ms, delay_line_get_frames(&delay_line, channel));
+            
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_DELAY);
+        }
+        else if (strcmp(token, "reset") == 0) {
+            delay_line_reset(&delay_line);
+            printf("Delay lines cleared\n");
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = persist_save_now(PERSIST_DELAY);
+            if (err == ESP_OK) {
+                printf("Delay settings saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            printf("Unknown delay subcommand: %s\n", token);
+            printf("Try: delay show, delay enable, delay disable, delay left, delay right, delay reset, delay save\n");
+        }
+    }
+    else if (strcmp(token, "preset") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "list") == 0 || strcmp(token, "show") == 0) {
+            show_presets();
+        }
+        else if (strcmp(token, "store") == 0) {
+            char* slot_str = strtok(NULL, " ");
+            char* name = strtok(NULL, "");
+            if (slot_str == NULL) {
+                printf("Error: Usage: preset store <slot> [name]\n");
+                return;
+            }
+            char path[24];
+            snprintf(path, sizeof(path), "preset/store/%s", slot_str);
+            preset_command(path, name != NULL ? name : "");
+        }
+        else if (strcmp(token, "recall") == 0 || strcmp(token, "clear") == 0) {
+            const bool recall = (strcmp(token, "recall") == 0);
+            char* slot = strtok(NULL, "");
+            if (slot == NULL) {
+                printf("Error: Usage: preset %s <slot|name>\n", token);
+                return;
+            }
+            preset_command(recall ? "preset/recall" : "preset/clear", slot);
+        }
+        else if (strcmp(token, "crossfade") == 0) {
+            char* mode = strtok(NULL, " ");
+            if (mode == NULL || (strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0)) {
+                printf("Error: Usage: preset crossfade <on|off>\n");
+                return;
+            }
+            preset_command("preset/crossfade", strcmp(mode, "on") == 0 ? "1" : "0");
+        }
+        else {
+            printf("Unknown preset subcommand: %s\n", token);
+            printf("Try: preset list, preset store, preset recall, preset clear, preset crossfade\n");
+        }
+    }
+    else if (strcmp(token, "tap") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_tap();
+        }
+        else if (strcmp(token, "start") == 0) {
+            char* host = strtok(NULL, " ");
+            char* port = strtok(NULL, " ");
+            if (host == NULL) {
+                printf("Error: Usage: tap start <host> [port]\n");
+                return;
+            }
+            const char* paths[] = { "tap/host", "tap/enable", "tap/port" };
+            const char* values[] = { host, "1", port };
+            tap_command(paths, values, port != NULL ? 3 : 2);
+        }
+        else if (strcmp(token, "stop") == 0) {
+            const char* path = "tap/enable";
+            const char* value = "0";
+            tap_command(&path, &value, 1);
+        }
+        else if (strcmp(token, "point") == 0 || strcmp(token, "format") == 0 ||
+                 strcmp(token, "decim") == 0) {
+            char* value = strtok(NULL, " ");
+            if (value == NULL) {
+                printf("Error: Usage: tap point post|prelimiter, tap format l24|l16, tap decim <n>\n");
+                return;
+            }
+            const char* path = (strcmp(token, "point") == 0) ? "tap/point" :
+                               (strcmp(token, "format") == 0) ? "tap/format" : "tap/decimation";
+            const char* v = value;
+            tap_command(&path, &v, 1);
+        }
+        else if (strcmp(token, "sdp") == 0) {
+            char sdp[320];
+            if (audio_tap_get_sdp(sdp, sizeof(sdp)) == ESP_OK) {
+                printf("%s", sdp);
+            } else {
+                printf("Error: Audio tap not available (enable AUDIO_TAP in menuconfig)\n");
+            }
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = audio_tap_save_settings();
+            if (err == ESP_OK) {
+                printf("Tap settings saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            printf("Unknown tap subcommand: %s\n", token);
+            printf("Try: tap show, tap start, tap stop, tap point, tap format, tap decim, tap sdp, tap save\n");
         }
     }
     else if (strcmp(token, "gain") == 0 || strcmp(token, "pregain") == 0) {
@@ -603,11 +1963,8 @@ static void process_command(char* cmd)
             if (success) {
                 printf("Set pre-gain to %.1f dB (%.3fx linear)\n", pregain_get_gain(&pregain), pregain.gain_linear);
                 
-                // Save settings to flash
-                esp_err_t err = pregain_save_settings(&pregain);
-                if (err != ESP_OK) {
-                    printf("Warning: Failed to save settings to flash\n");
-                }
+                // Saved to flash once the changes settle
+                persist_mark_dirty(PERSIST_PREGAIN);
             } else {
                 printf("Error: Failed to set pre-gain\n");
             }
@@ -616,24 +1973,18 @@ static void process_command(char* cmd)
             pregain_set_enabled(&pregain, true);
             printf("Pre-gain enabled\n");
             
-            // Save settings to flash
-            esp_err_t err = pregain_save_settings(&pregain);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_PREGAIN);
         }
         else if (strcmp(token, "disable") == 0) {
             pregain_set_enabled(&pregain, false);
             printf("Pre-gain disabled (bypass mode)\n");
             
-            // Save settings to flash
-            esp_err_t err = pregain_save_settings(&pregain);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_PREGAIN);
         }
         else if (strcmp(token, "save") == 0) {
-            esp_err_t err = pregain_save_settings(&pregain);
+            esp_err_t err = persist_save_now(PERSIST_PREGAIN);
             if (err == ESP_OK) {
                 printf("Pre-gain settings saved to flash successfully\n");
             } else {
@@ -668,19 +2019,16 @@ static void process_command(char* cmd)
             
             float freq = atof(freq_str);
             
-            if (freq < 15.0f || freq > 50.0f) {
+            if (freq < SUBSONIC_MIN_FREQ || freq > SUBSONIC_MAX_FREQ) {
                 printf("Warning: Frequency out of recommended range (15-50 Hz)\n");
             }
             
-            bool success = subsonic_set_frequency(&subsonic, freq, SAMPLE_RATE);
+            bool success = subsonic_set_frequency(&subsonic, freq, audio_rate_get());
             if (success) {
                 printf("Set subsonic cutoff frequency to %.1f Hz\n", subsonic_get_frequency(&subsonic));
                 
-                // Save settings to flash
-                esp_err_t err = subsonic_save_settings(&subsonic);
-                if (err != ESP_OK) {
-                    printf("Warning: Failed to save settings to flash\n");
-                }
+                // Saved to flash once the changes settle
+                persist_mark_dirty(PERSIST_SUBSONIC);
             } else {
                 printf("Error: Failed to set frequency\n");
             }
@@ -689,28 +2037,22 @@ static void process_command(char* cmd)
             subsonic_set_enabled(&subsonic, true);
             printf("Subsonic filter enabled\n");
             
-            // Save settings to flash
-            esp_err_t err = subsonic_save_settings(&subsonic);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_SUBSONIC);
         }
         else if (strcmp(token, "disable") == 0) {
             subsonic_set_enabled(&subsonic, false);
             printf("Subsonic filter disabled (bypass mode)\n");
             
-            // Save settings to flash
-            esp_err_t err = subsonic_save_settings(&subsonic);
-            if (err != ESP_OK) {
-                printf("Warning: Failed to save settings to flash\n");
-            }
+            // Saved to flash once the changes settle
+            persist_mark_dirty(PERSIST_SUBSONIC);
         }
         else if (strcmp(token, "reset") == 0) {
             subsonic_reset(&subsonic);
             printf("Subsonic filter state reset (history cleared)\n");
         }
         else if (strcmp(token, "save") == 0) {
-            esp_err_t err = subsonic_save_settings(&subsonic);
+            esp_err_t err = persist_save_now(PERSIST_SUBSONIC);
             if (err == ESP_OK) {
                 printf("Subsonic filter settings saved to flash successfully\n");
             } else {
@@ -722,6 +2064,207 @@ static void process_command(char* cmd)
             printf("Try: sub show, sub freq, sub enable, sub disable, sub reset, sub save\n");
         }
     }
+    else if (strcmp(token, "chain") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            printf("DSP chain mode: %s\n", dsp_chain_mode_name(dsp_chain_get_mode()));
+            printf("Stage order:");
+            for (int i = 0; i < dsp_chain_stage_count(); i++) {
+                printf("%s%s", i == 0 ? " " : " > ", dsp_chain_stage_name(dsp_chain_stage_at(i)));
+            }
+            printf("\n");
+        }
+        else if (strcmp(token, "fused") == 0) {
+            dsp_chain_set_mode(DSP_CHAIN_MODE_FUSED);
+            printf("DSP chain set to fused (single pass per frame)\n");
+        }
+        else if (strcmp(token, "staged") == 0) {
+            dsp_chain_set_mode(DSP_CHAIN_MODE_STAGED);
+            printf("DSP chain set to staged (one pass per stage)\n");
+        }
+        else if (strcmp(token, "float") == 0) {
+            dsp_chain_set_mode(DSP_CHAIN_MODE_FLOAT);
+            printf("DSP chain set to float (float32 block per stage)\n");
+        }
+        else if (strcmp(token, "verify") == 0) {
+            int mismatch = -1;
+            if (dsp_chain_verify(&mismatch) == ESP_OK) {
+                printf("Fused and staged outputs are bit-identical\n");
+            } else {
+                printf("Error: Fused output differs from staged at sample %d\n", mismatch);
+            }
+        }
+        else {
+            printf("Unknown chain subcommand: %s\n", token);
+            printf("Try: chain show, chain fused, chain staged, chain float, chain verify\n");
+        }
+    }
+    else if (strcmp(token, "bench") == 0) {
+        token = strtok(NULL, " ");
+        if (token != NULL && strcmp(token, "run") == 0) {
+            run_bench();
+        }
+        else {
+            printf("Usage: bench run\n");
+        }
+    }
+    else if (strcmp(token, "io") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_io();
+        }
+        else if (strcmp(token, "geometry") == 0) {
+            char* frames_str = strtok(NULL, " ");
+            char* descs_str = strtok(NULL, " ");
+            if (frames_str == NULL || descs_str == NULL) {
+                printf("Error: Usage: io geometry <frames> <buffers>\n");
+                printf("Example: io geometry 64 3\n");
+                return;
+            }
+
+            int frames = atoi(frames_str);
+            int descs = atoi(descs_str);
+            esp_err_t err = audio_lowlat_set_geometry(frames, descs);
+            if (err == ESP_OK) {
+                printf("DMA geometry set to %d x %d frames (%.2f ms nominal)\n",
+                       descs, frames, 1000.0f * descs * frames / audio_rate_get());
+                printf("Use 'io save' to keep it after reboot\n");
+            } else if (err == ESP_ERR_INVALID_ARG) {
+                printf("Error: Frames must be %d-%d and buffers %d-%d\n",
+                       AUDIO_LOWLAT_MIN_FRAMES, AUDIO_LOWLAT_MAX_FRAMES,
+                       AUDIO_LOWLAT_MIN_DESCS, AUDIO_LOWLAT_MAX_DESCS);
+            } else if (err == ESP_ERR_NOT_SUPPORTED || err == ESP_ERR_INVALID_STATE) {
+                printf("Error: Low-latency I/O not running (enable CONFIG_AUDIO_LOW_LATENCY)\n");
+            } else {
+                printf("Error: Failed to apply geometry: %s\n", esp_err_to_name(err));
+            }
+        }
+        else if (strcmp(token, "reset") == 0) {
+            audio_lowlat_reset_stats();
+            printf("I/O statistics reset\n");
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = audio_lowlat_save_settings();
+            if (err == ESP_OK) {
+                printf("DMA geometry saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            printf("Unknown io subcommand: %s\n", token);
+            printf("Try: io show, io geometry, io reset, io save\n");
+        }
+    }
+    else if (strcmp(token, "meter") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_meter();
+        }
+        else if (strcmp(token, "reset") == 0) {
+            level_meter_reset();
+            printf("Peak hold and clip counters reset\n");
+        }
+        else if (strcmp(token, "led") == 0) {
+            token = strtok(NULL, " ");
+            if (token != NULL && (strcmp(token, "on") == 0 || strcmp(token, "off") == 0)) {
+                vu_meter_enabled = (strcmp(token, "on") == 0);
+                printf("LED level display %s\n", vu_meter_enabled ? "on" : "off");
+            } else {
+                printf("Usage: meter led on|off\n");
+            }
+        }
+        else {
+            printf("Unknown meter subcommand: %s\n", token);
+            printf("Try: meter show, meter reset, meter led on|off\n");
+        }
+    }
+    else if (strcmp(token, "spectrum") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_spectrum();
+        }
+        else if (strcmp(token, "on") == 0 || strcmp(token, "off") == 0) {
+            spectrum_set_enabled(strcmp(token, "on") == 0);
+            if (spectrum_get_enabled() != (strcmp(token, "on") == 0)) {
+                printf("Error: Spectrum analyzer not available\n");
+            } else {
+                printf("Spectrum analyzer %s\n", spectrum_get_enabled() ? "started" : "stopped");
+            }
+        }
+        else if (strcmp(token, "reset") == 0) {
+            spectrum_reset();
+            printf("Spectrum averages reset\n");
+        }
+        else if (strcmp(token, "suggest") == 0) {
+            token = strtok(NULL, " ");
+            suggest_eq(token != NULL && strcmp(token, "apply") == 0);
+        }
+        else {
+            printf("Unknown spectrum subcommand: %s\n", token);
+            printf("Try: spectrum show, spectrum on|off, spectrum reset, spectrum suggest [apply]\n");
+        }
+    }
+    else if (strcmp(token, "rate") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            printf("Sample rate: %lu Hz\n", (unsigned long)audio_rate_get());
+        }
+        else if (strcmp(token, "save") == 0) {
+            esp_err_t err = audio_rate_save_settings();
+            if (err == ESP_OK) {
+                printf("Sample rate saved to flash successfully\n");
+            } else {
+                printf("Error: Failed to save settings to flash: %s\n", esp_err_to_name(err));
+            }
+        }
+        else {
+            // Through dsp_control like every other parameter, so the presets
+            // are re-baked for the new rate; the status and tap topics follow
+            uint32_t changed = 0;
+            esp_err_t err = dsp_control_apply("audio/rate", strlen("audio/rate"),
+                                              token, strlen(token), &changed);
+            if (err == ESP_OK) {
+                telemetry_request_changed(changed);
+                printf("Sample rate set to %lu Hz\n", (unsigned long)audio_rate_get());
+                printf("Use 'rate save' to keep it after reboot\n");
+            } else if (err == ESP_ERR_INVALID_ARG) {
+                printf("Error: Rate must be 44100, 48000, 88200, 96000, 176400 or 192000\n");
+            } else if (err == ESP_ERR_TIMEOUT || err == ESP_ERR_INVALID_STATE) {
+                printf("Error: Audio task did not respond, rate unchanged\n");
+            } else {
+                printf("Error: Failed to reclock I2S: %s (rate unchanged)\n", esp_err_to_name(err));
+            }
+        }
+    }
+    else if (strcmp(token, "perf") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_perf();
+        }
+        else if (strcmp(token, "reset") == 0) {
+            dsp_perf_reset();
+            printf("Profiler statistics reset\n");
+        }
+        else {
+            printf("Unknown perf subcommand: %s\n", token);
+            printf("Try: perf, perf reset\n");
+        }
+    }
+    else if (strcmp(token, "xrun") == 0) {
+        token = strtok(NULL, " ");
+        if (token == NULL || strcmp(token, "show") == 0) {
+            show_xrun();
+        }
+        else if (strcmp(token, "reset") == 0) {
+            audio_xrun_reset();
+            printf("Dropout counters reset\n");
+        }
+        else {
+            printf("Unknown xrun subcommand: %s\n", token);
+            printf("Try: xrun, xrun reset\n");
+        }
+    }
     else {
         printf("Unknown command: %s\n", token);
         printf("Type 'help' for available commands\n");
@@ -15,7 +15,7 @@ void serial_commands_init(void);
 void serial_commands_print_help(void);
 
 /**
- * Check if VU meter is enabled
+ * Check if the NeoPixel level display is enabled ('meter led on|off')
  */
 bool is_vu_meter_enabled(void);
 
@@ -0,0 +1,173 @@
+#include "settings_blob.h"
+#include <string.h>
+#include <stddef.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "SETTINGS";
+
+#define NVS_NAMESPACE "settings"
+#define NVS_KEY_CHAIN "chain"
+
+static_assert(sizeof(settings_blob_header_t) + sizeof(settings_blob_payload_t) <= SETTINGS_BLOB_MAX_SIZE,
+              "settings blob payload exceeds SETTINGS_BLOB_MAX_SIZE");
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern pregain_t pregain;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+extern convolver_t convolver;
+extern crossover_t crossover;
+extern multiband_t multiband;
+extern delay_line_t delay_line;
+
+// Read/write buffer (too large for the callers' stacks)
+static uint32_t s_buffer[SETTINGS_BLOB_MAX_SIZE / sizeof(uint32_t)];
+
+static settings_blob_stats_t s_stats = {};
+
+// True if the section at offset fits in a payload of the given size
+#define HAS_SECTION(size, field) \
+    (offsetof(settings_blob_payload_t, field) + sizeof(((settings_blob_payload_t *)0)->field) <= (size))
+
+esp_err_t settings_blob_load(uint32_t sample_rate)
+{
+    const int64_t start = esp_timer_get_time();
+    nvs_handle_t nvs_handle;
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_ERR_NVS_NOT_FOUND : err;
+    }
+    size_t length = sizeof(s_buffer);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_CHAIN, s_buffer, &length);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Failed to read settings: %s", esp_err_to_name(err));
+        }
+        return err;
+    }
+
+    // Validate everything before touching a module
+    const settings_blob_header_t *header = (const settings_blob_header_t *)s_buffer;
+    const uint8_t *data = (const uint8_t *)s_buffer + sizeof(settings_blob_header_t);
+    if (length < sizeof(settings_blob_header_t) || header->magic != SETTINGS_BLOB_MAGIC ||
+        header->size > length - sizeof(settings_blob_header_t)) {
+        ESP_LOGW(TAG, "Settings blob truncated or not recognized (%u bytes)", (unsigned)length);
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (esp_crc32_le(0, data, header->size) != header->crc32) {
+        ESP_LOGW(TAG, "Settings blob CRC mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (header->version != SETTINGS_BLOB_VERSION) {
+        ESP_LOGW(TAG, "Settings blob format %u not supported (expected %d)",
+                 header->version, SETTINGS_BLOB_VERSION);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    // Known prefix only; sections past the stored size keep their defaults
+    static settings_blob_payload_t payload;
+    memset(&payload, 0, sizeof(payload));
+    const size_t size = header->size;
+    memcpy(&payload, data, (size < sizeof(payload)) ? size : sizeof(payload));
+
+    if (HAS_SECTION(size, subsonic)) {
+        subsonic_apply_settings(&subsonic, &payload.subsonic, sample_rate);
+    }
+    if (HAS_SECTION(size, pregain)) {
+        pregain_apply_settings(&pregain, &payload.pregain);
+    }
+    bool coeffs_cached = false;
+    if (HAS_SECTION(size, equalizer)) {
+        const bool has_coeffs = HAS_SECTION(size, eq_coeffs) &&
+                                (payload.flags & SETTINGS_BLOB_HAS_EQ_COEFFS) != 0;
+        coeffs_cached = equalizer_apply_settings(&equalizer, &payload.equalizer,
+                                                 has_coeffs ? &payload.eq_coeffs : NULL, sample_rate);
+    }
+    if (HAS_SECTION(size, limiter)) {
+        limiter_apply_settings(&limiter, &payload.limiter);
+    }
+    if (HAS_SECTION(size, convolver)) {
+        convolver_apply_settings(&convolver, &payload.convolver);
+    }
+    if (HAS_SECTION(size, crossover)) {
+        crossover_apply_settings(&crossover, &payload.crossover);
+    }
+    if (HAS_SECTION(size, multiband)) {
+        multiband_apply_settings(&multiband, &payload.multiband);
+    }
+    if (HAS_SECTION(size, delay)) {
+        delay_line_apply_settings(&delay_line, &payload.delay);
+    }
+
+    s_stats.loaded = true;
+    s_stats.coeffs_cached = coeffs_cached;
+    s_stats.load_us = (uint32_t)(esp_timer_get_time() - start);
+    s_stats.size = (uint32_t)length;
+
+    ESP_LOGI(TAG, "Settings loaded (%u bytes, format %u, %s) in %lu us",
+             (unsigned)length, header->version,
+             coeffs_cached ? "cached coefficients" : "coefficients computed",
+             (unsigned long)s_stats.load_us);
+    return ESP_OK;
+}
+
+esp_err_t settings_blob_save(uint32_t sample_rate)
+{
+    settings_blob_header_t *header = (settings_blob_header_t *)s_buffer;
+    settings_blob_payload_t *payload =
+        (settings_blob_payload_t *)((uint8_t *)s_buffer + sizeof(settings_blob_header_t));
+
+    memset(s_buffer, 0, sizeof(settings_blob_header_t) + sizeof(settings_blob_payload_t));
+    subsonic_get_settings(&subsonic, &payload->subsonic);
+    pregain_get_settings(&pregain, &payload->pregain);
+    equalizer_get_settings(&equalizer, &payload->equalizer);
+    limiter_get_settings(&limiter, &payload->limiter);
+    convolver_get_settings(&convolver, &payload->convolver);
+    crossover_get_settings(&crossover, &payload->crossover);
+    multiband_get_settings(&multiband, &payload->multiband);
+    delay_line_get_settings(&delay_line, &payload->delay);
+#ifdef CONFIG_SETTINGS_CACHE_COEFFS
+    equalizer_bake_coeff_cache(&payload->equalizer, sample_rate, &payload->eq_coeffs);
+    payload->flags |= SETTINGS_BLOB_HAS_EQ_COEFFS;
+#else
+    (void)sample_rate;
+#endif
+
+    header->magic = SETTINGS_BLOB_MAGIC;
+    header->version = SETTINGS_BLOB_VERSION;
+    header->size = sizeof(settings_blob_payload_t);
+    header->crc32 = esp_crc32_le(0, (const uint8_t *)payload, sizeof(settings_blob_payload_t));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    const size_t length = sizeof(settings_blob_header_t) + sizeof(settings_blob_payload_t);
+    err = nvs_set_blob(nvs_handle, NVS_KEY_CHAIN, s_buffer, length);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write settings: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_stats.size = (uint32_t)length;
+    ESP_LOGD(TAG, "Settings saved (%u bytes)", (unsigned)length);
+    return ESP_OK;
+}
+
+void settings_blob_get_stats(settings_blob_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,96 @@
+#ifndef SETTINGS_BLOB_H
+#define SETTINGS_BLOB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "convolver.h"
+#include "crossover.h"
+#include "multiband.h"
+#include "delay_line.h"
+
+// Packed settings blob
+// The settings of the whole chain are stored as one NVS blob: a header with
+// format version, payload size and CRC-32, then a fixed-layout payload with
+// one struct per module and, optionally, the equalizer coefficients baked for
+// the sample rate they were saved at. Boot is a single nvs_get_blob and a
+// copy into the modules instead of one NVS lookup per key plus the filter
+// design for every band.
+//
+// Layout rule: sections are only ever appended to settings_blob_payload_t.
+// A blob from older firmware is shorter and its missing sections keep their
+// defaults; a blob from newer firmware is longer and its extra sections are
+// ignored. SETTINGS_BLOB_VERSION is only bumped for a change that existing
+// sections cannot survive, and such a blob is rejected.
+
+#define SETTINGS_BLOB_MAGIC         0x51455345u     // "ESEQ"
+#define SETTINGS_BLOB_VERSION       1
+
+// Largest blob accepted on load (room for sections added by newer firmware)
+#define SETTINGS_BLOB_MAX_SIZE      2048
+
+// settings_blob_payload_t.flags
+#define SETTINGS_BLOB_HAS_EQ_COEFFS (1u << 0)
+
+typedef struct {
+    uint32_t magic;                             // SETTINGS_BLOB_MAGIC
+    uint16_t version;                           // SETTINGS_BLOB_VERSION
+    uint16_t size;                              // Payload bytes after the header
+    uint32_t crc32;                             // CRC-32 (little endian) of the payload
+} settings_blob_header_t;
+
+typedef struct {
+    subsonic_settings_t subsonic;
+    pregain_settings_t pregain;
+    equalizer_settings_t equalizer;
+    limiter_settings_t limiter;
+    uint32_t flags;                             // SETTINGS_BLOB_HAS_*
+    equalizer_coeff_cache_t eq_coeffs;          // Valid with SETTINGS_BLOB_HAS_EQ_COEFFS
+    convolver_settings_t convolver;             // Gain and enable only (the response is in its partition)
+    crossover_settings_t crossover;             // Points and ways (laid out for 3 ways in every build)
+    multiband_settings_t multiband;             // Points and dynamics of all MULTIBAND_MAX_BANDS bands
+    delay_line_settings_t delay;                // Left / right delay in ms
+} settings_blob_payload_t;
+
+typedef struct {
+    bool loaded;                                // Settings came from the blob at boot
+    bool coeffs_cached;                         // Equalizer coefficients were copied, not computed
+    uint32_t load_us;                           // Time spent in settings_blob_load
+    uint32_t size;                              // Bytes of the last blob read or written
+} settings_blob_stats_t;
+
+/**
+ * Load and apply the settings blob (at boot, after the modules' *_init)
+ *
+ * Nothing is applied unless the whole blob is valid.
+ *
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND if no blob was saved,
+ *         ESP_ERR_INVALID_CRC if it is corrupt, ESP_ERR_INVALID_VERSION if it
+ *         has an incompatible format, or the NVS error
+ */
+esp_err_t settings_blob_load(uint32_t sample_rate);
+
+/**
+ * Save the settings of all modules as one blob
+ *
+ * Not reentrant; the persistence task serializes callers.
+ *
+ * @param sample_rate Sample rate the equalizer coefficients are baked for
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t settings_blob_save(uint32_t sample_rate);
+
+/**
+ * Get load/save information
+ *
+ * @param stats Destination
+ */
+void settings_blob_get_stats(settings_blob_stats_t *stats);
+
+#endif // SETTINGS_BLOB_H
@@ -0,0 +1,530 @@
+#include "spectrum.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "dsp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+// Nominal band centres (IEC 61260 preferred numbers)
+static const float s_band_nominal[SPECTRUM_BANDS] = {
+    20, 25, 31.5f, 40, 50, 63, 80, 100, 125, 160, 200, 250, 315, 400, 500, 630,
+    800, 1000, 1250, 1600, 2000, 2500, 3150, 4000, 5000, 6300, 8000, 10000, 12500, 16000, 20000,
+};
+
+#if SPECTRUM_ENABLED
+#include "dsps_fft2r.h"
+#include "dsps_wind_hann.h"
+
+static const char *TAG = "SPECTRUM";
+
+static_assert((SPECTRUM_FFT_SIZE & (SPECTRUM_FFT_SIZE - 1)) == 0 && SPECTRUM_FFT_SIZE >= 256,
+              "CONFIG_SPECTRUM_FFT_SIZE must be a power of two");
+
+#define HOP_SAMPLES     (SPECTRUM_FFT_SIZE / 2)     // 50% overlap
+#define NUM_BINS        (SPECTRUM_FFT_SIZE / 2)
+#define RING_SIZE       (SPECTRUM_FFT_SIZE * 2)     // Power of two, two frames of slack
+#define RING_MASK       (RING_SIZE - 1)
+
+// Higher rates are decimated by an integer factor down to about this rate
+#define MAX_ANALYSIS_RATE   48000
+
+// How often the analyzer task looks for new samples (a hop is 21 ms at 2048)
+#define POLL_MS         10
+
+// Core that runs the chain; the analyzer takes the other one
+#if AUDIO_PIPELINE_ENABLED
+#define CHAIN_CORE      AUDIO_PIPELINE_DSP_CORE
+#elif AUDIO_LOWLAT_ENABLED
+#define CHAIN_CORE      AUDIO_LOWLAT_CORE
+#else
+#define CHAIN_CORE      0                           // audio_task
+#endif
+#ifdef CONFIG_FREERTOS_UNICORE
+#define SPECTRUM_CORE   0
+#else
+#define SPECTRUM_CORE   (1 - CHAIN_CORE)
+#endif
+
+// Suggestion fit: bands used for the tilt line, and the level below which a
+// band counts as silent
+#define FIT_MIN_HZ      40.0f
+#define FIT_MAX_HZ      16000.0f
+#define FIT_MIN_BANDS   6
+#define SILENCE_DB      -90.0f
+#define SUGGEST_STEP    0.5f
+
+// Sample ring: the audio task produces, the analyzer task consumes; head and
+// tail are free-running and each written by one side only (as block_ring.h)
+static float s_ring[RING_SIZE];
+static volatile uint32_t s_ring_head = 0;
+static volatile uint32_t s_ring_tail = 0;
+
+// Feed state (audio task)
+static uint32_t s_decim = 1;
+static uint32_t s_decim_count = 0;
+static float s_decim_acc = 0.0f;
+static float s_feed_scale = 1.0f;
+static volatile uint32_t s_dropped = 0;
+
+// Control (any task)
+static volatile bool s_enabled = true;
+static volatile bool s_reset_pending = true;
+static volatile uint32_t s_analysis_rate = MAX_ANALYSIS_RATE;
+static volatile uint32_t s_generation = 0;          // Bumped by spectrum_set_sample_rate
+
+// Analysis state (analyzer task; 16-byte aligned for esp-dsp)
+static float s_fft[2 * SPECTRUM_FFT_SIZE] __attribute__((aligned(16)));
+static float s_window[SPECTRUM_FFT_SIZE] __attribute__((aligned(16)));
+static float s_history[SPECTRUM_FFT_SIZE];
+static uint32_t s_history_fill = 0;
+static bool s_pair_pending = false;                 // First frame of a pair is in the real parts
+static uint16_t s_band_lo[SPECTRUM_BANDS];          // Bins summed per band (inclusive)
+static uint16_t s_band_hi[SPECTRUM_BANDS];
+static bool s_band_valid[SPECTRUM_BANDS];           // Band below Nyquist
+static float s_power_scale = 1.0f;                  // Bin power → full-scale sine = 1
+static float s_fast[SPECTRUM_BANDS];
+static float s_slow[SPECTRUM_BANDS];
+static float s_alpha_fast = 1.0f;
+static float s_alpha_slow = 1.0f;
+static uint32_t s_frames = 0;
+static uint32_t s_rate = MAX_ANALYSIS_RATE;         // Rate the bands are mapped for
+static uint32_t s_configured = 0;                   // s_generation the bands are mapped for
+
+// Mailbox, sequence lock: odd while the analyzer task is writing it
+static spectrum_snapshot_t s_mailbox;
+static volatile uint32_t s_seq = 0;
+
+static TaskHandle_t s_task = NULL;
+
+// Two real frames in one complex FFT: frame A in the real parts, B in the
+// imaginary parts; afterwards A's bins are at s_fft[0..N), B's at s_fft[N..2N)
+static void transform(void)
+{
+    dsps_fft2r_fc32(s_fft, SPECTRUM_FFT_SIZE);
+    dsps_bit_rev_fc32(s_fft, SPECTRUM_FFT_SIZE);
+    dsps_cplx2reC_fc32(s_fft, SPECTRUM_FFT_SIZE);
+}
+
+// Scale so that a full-scale sine sums to 1 over its band, whatever the
+// library's FFT normalization and the window's noise bandwidth
+static void calibrate(void)
+{
+    const int k0 = SPECTRUM_FFT_SIZE / 8;
+    for (int n = 0; n < SPECTRUM_FFT_SIZE; n++) {
+        s_fft[2 * n] = sinf(2.0f * (float)M_PI * k0 * n / SPECTRUM_FFT_SIZE) * s_window[n];
+        s_fft[2 * n + 1] = 0.0f;
+    }
+    transform();
+    float power = 0.0f;
+    for (int k = k0 - 2; k <= k0 + 2; k++) {
+        power += s_fft[2 * k] * s_fft[2 * k] + s_fft[2 * k + 1] * s_fft[2 * k + 1];
+    }
+    s_power_scale = (power > 0.0f) ? 1.0f / power : 1.0f;
+}
+
+// Bins of each band at the analysis rate; bands narrower than a bin use
+// the bin nearest their centre
+static void configure(uint32_t rate)
+{
+    const float df = (float)rate / SPECTRUM_FFT_SIZE;
+    const float edge = powf(2.0f, 1.0f / 6.0f);
+
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        const float fc = 1000.0f * powf(2.0f, (float)(b - SPECTRUM_BAND_1K) / 3.0f);
+        s_band_valid[b] = fc < 0.5f * (float)rate;
+
+        int lo = (int)ceilf(fc / edge / df);
+        int hi = (int)ceilf(fc * edge / df) - 1;
+        if (hi < lo) {
+            lo = hi = (int)lrintf(fc / df);
+        }
+        if (lo < 1) {
+            lo = 1;
+        }
+        if (hi > NUM_BINS - 1) {
+            hi = NUM_BINS - 1;
+        }
+        if (hi < lo) {
+            hi = lo;
+        }
+        s_band_lo[b] = (uint16_t)lo;
+        s_band_hi[b] = (uint16_t)hi;
+    }
+
+    const float hop_ms = 1000.0f * HOP_SAMPLES / (float)rate;
+    s_alpha_fast = 1.0f - expf(-hop_ms / SPECTRUM_FAST_MS);
+    s_alpha_slow = 1.0f - expf(-hop_ms / SPECTRUM_SLOW_MS);
+    s_rate = rate;
+}
+
+static float power_db(float power)
+{
+    if (power <= 0.0f) {
+        return SPECTRUM_FLOOR_DB;
+    }
+    const float db = 10.0f * log10f(power);
+    return (db < SPECTRUM_FLOOR_DB) ? SPECTRUM_FLOOR_DB : db;
+}
+
+static void publish(void)
+{
+    spectrum_snapshot_t snap;
+    snap.frames = s_frames;
+    snap.analysis_rate = s_rate;
+    snap.dropped = s_dropped;
+    snap.resolution_hz = (float)s_rate / SPECTRUM_FFT_SIZE;
+    snap.analysed_s = (float)s_frames * HOP_SAMPLES / (float)s_rate;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        snap.level_db[b] = s_band_valid[b] ? power_db(s_fast[b]) : SPECTRUM_FLOOR_DB;
+        snap.average_db[b] = s_band_valid[b] ? power_db(s_slow[b]) : SPECTRUM_FLOOR_DB;
+    }
+
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+    memcpy(&s_mailbox, &snap, sizeof(snap));
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_SEQ_CST);
+}
+
+static void clear_analysis(void)
+{
+    memset(s_fast, 0, sizeof(s_fast));
+    memset(s_slow, 0, sizeof(s_slow));
+    s_frames = 0;
+    s_history_fill = 0;
+    s_pair_pending = false;
+    // Drop what the ring holds (consumer side: only the tail moves)
+    __atomic_store_n(&s_ring_tail, __atomic_load_n(&s_ring_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// Fold one frame's band powers into the averages; until a time constant's
+// worth of frames has passed this is a plain running mean
+static void accumulate(const float *spectrum)
+{
+    s_frames++;
+    const float inv_frames = 1.0f / (float)s_frames;
+    const float fast = (s_alpha_fast > inv_frames) ? s_alpha_fast : inv_frames;
+    const float slow = (s_alpha_slow > inv_frames) ? s_alpha_slow : inv_frames;
+
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        float power = 0.0f;
+        for (int k = s_band_lo[b]; k <= s_band_hi[b]; k++) {
+            power += spectrum[2 * k] * spectrum[2 * k] + spectrum[2 * k + 1] * spectrum[2 * k + 1];
+        }
+        power *= s_power_scale;
+        s_fast[b] += fast * (power - s_fast[b]);
+        s_slow[b] += slow * (power - s_slow[b]);
+    }
+}
+
+static void analyse_frame(void)
+{
+    float *dst = s_fft + (s_pair_pending ? 1 : 0);
+    for (int n = 0; n < SPECTRUM_FFT_SIZE; n++) {
+        dst[2 * n] = s_history[n] * s_window[n];
+    }
+    if (!s_pair_pending) {
+        s_pair_pending = true;
+        return;
+    }
+    s_pair_pending = false;
+
+    transform();
+    accumulate(s_fft);
+    accumulate(s_fft + SPECTRUM_FFT_SIZE);
+    publish();
+}
+
+static void spectrum_task(void *pvParameters)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(POLL_MS));
+        if (!s_enabled) {
+            continue;
+        }
+
+        const uint32_t gen = __atomic_load_n(&s_generation, __ATOMIC_SEQ_CST);
+        if (gen != s_configured || s_reset_pending) {
+            if (gen != s_configured) {
+                s_configured = gen;
+                configure(s_analysis_rate);
+            }
+            s_reset_pending = false;
+            clear_analysis();
+            publish();
+        }
+
+        // Slide the history by one hop per hop of new samples
+        while (__atomic_load_n(&s_ring_head, __ATOMIC_ACQUIRE) - s_ring_tail >= HOP_SAMPLES) {
+            const uint32_t tail = s_ring_tail;
+            memmove(s_history, s_history + HOP_SAMPLES, (SPECTRUM_FFT_SIZE - HOP_SAMPLES) * sizeof(float));
+            for (int n = 0; n < HOP_SAMPLES; n++) {
+                s_history[SPECTRUM_FFT_SIZE - HOP_SAMPLES + n] = s_ring[(tail + n) & RING_MASK];
+            }
+            __atomic_store_n(&s_ring_tail, tail + HOP_SAMPLES, __ATOMIC_RELEASE);
+
+            if (s_history_fill < SPECTRUM_FFT_SIZE) {
+                s_history_fill += HOP_SAMPLES;
+                if (s_history_fill < SPECTRUM_FFT_SIZE) {
+                    continue;
+                }
+            }
+            analyse_frame();
+        }
+    }
+}
+
+void spectrum_set_sample_rate(uint32_t sample_rate)
+{
+    uint32_t decim = (sample_rate + MAX_ANALYSIS_RATE / 2) / MAX_ANALYSIS_RATE;
+    if (decim < 1) {
+        decim = 1;
+    }
+    s_decim = decim;
+    s_decim_count = 0;
+    s_decim_acc = 0.0f;
+    // Mono mix (L + R) / 2, normalized to full scale, averaged over the decimation
+    s_feed_scale = 0.5f / 8388608.0f / (float)decim;
+
+    s_analysis_rate = sample_rate / decim;
+    __atomic_fetch_add(&s_generation, 1, __ATOMIC_SEQ_CST);
+}
+
+esp_err_t spectrum_init(uint32_t sample_rate)
+{
+    esp_err_t err = dsps_fft2r_init_fc32(NULL, SPECTRUM_FFT_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize FFT tables: %s", esp_err_to_name(err));
+        s_enabled = false;
+        return err;
+    }
+    dsps_wind_hann_f32(s_window, SPECTRUM_FFT_SIZE);
+    calibrate();
+
+    spectrum_set_sample_rate(sample_rate);
+    s_configured = s_generation;
+    configure(s_analysis_rate);
+    clear_analysis();
+    publish();
+
+    BaseType_t created = xTaskCreatePinnedToCore(spectrum_task, "spectrum", 4096, NULL,
+                                                 tskIDLE_PRIORITY + 1, &s_task, SPECTRUM_CORE);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create spectrum task");
+        s_enabled = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Spectrum analyzer: %d-point FFT at %lu Hz (%.1f Hz bins) on core %d",
+             SPECTRUM_FFT_SIZE, (unsigned long)s_analysis_rate,
+             (float)s_analysis_rate / SPECTRUM_FFT_SIZE, SPECTRUM_CORE);
+    return ESP_OK;
+}
+
+void DSP_HOT spectrum_feed(const int32_t *buffer, int num_samples)
+{
+    if (!s_enabled) {
+        return;
+    }
+
+    const uint32_t frames = (uint32_t)num_samples / 2;
+    const uint32_t decim = s_decim;
+    const uint32_t head = s_ring_head;
+    const uint32_t outputs = (s_decim_count + frames) / decim;
+    if (head - __atomic_load_n(&s_ring_tail, __ATOMIC_ACQUIRE) + outputs > RING_SIZE) {
+        // Analyzer behind: never wait, lose the block
+        s_dropped++;
+        return;
+    }
+
+    const float scale = s_feed_scale;
+    uint32_t count = s_decim_count;
+    float acc = s_decim_acc;
+    uint32_t h = head;
+    for (uint32_t f = 0; f < frames; f++) {
+        acc += (float)((buffer[2 * f] >> 8) + (buffer[2 * f + 1] >> 8));
+        if (++count == decim) {
+            s_ring[h & RING_MASK] = acc * scale;
+            h++;
+            acc = 0.0f;
+            count = 0;
+        }
+    }
+    s_decim_count = count;
+    s_decim_acc = acc;
+    // The samples must be visible before the consumer sees the new head
+    __atomic_store_n(&s_ring_head, h, __ATOMIC_RELEASE);
+}
+
+void spectrum_set_enabled(bool enabled)
+{
+    if (enabled && !s_enabled) {
+        // Start from fresh averages rather than from before the pause
+        s_reset_pending = true;
+    }
+    s_enabled = enabled && s_task != NULL;
+}
+
+bool spectrum_get_enabled(void)
+{
+    return s_enabled;
+}
+
+void spectrum_reset(void)
+{
+    s_reset_pending = true;
+}
+
+esp_err_t spectrum_get_snapshot(spectrum_snapshot_t *snapshot)
+{
+    // A frame takes tens of milliseconds and the copy microseconds, so a retry is rare
+    for (int attempt = 0; attempt < 8; attempt++) {
+        const uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_SEQ_CST);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(snapshot, &s_mailbox, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s_seq, __ATOMIC_SEQ_CST) == seq) {
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spectrum_suggest_eq(const spectrum_snapshot_t *snapshot, const equalizer_t *eq,
+                              float gains[EQ_MAX_BANDS])
+{
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        gains[i] = NAN;
+    }
+    if (snapshot->analysed_s < SPECTRUM_SUGGEST_MIN_S) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Bands narrower than a bin read the whole bin; scale those to their own
+    // width so that broadband program is measured without a low-end bias
+    float level[SPECTRUM_BANDS];
+    const float band_width = powf(2.0f, 1.0f / 6.0f) - powf(2.0f, -1.0f / 6.0f);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        const float width = band_width * 1000.0f * powf(2.0f, (float)(b - SPECTRUM_BAND_1K) / 3.0f);
+        level[b] = snapshot->average_db[b];
+        if (width < snapshot->resolution_hz) {
+            level[b] += 10.0f * log10f(width / snapshot->resolution_hz);
+        }
+    }
+
+    // Least-squares tilt line through the long-term levels (x in octaves from 1 kHz)
+    bool use[SPECTRUM_BANDS];
+    float sx = 0.0f, sy = 0.0f, sxx = 0.0f, sxy = 0.0f;
+    int n = 0;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        const float f = s_band_nominal[b];
+        use[b] = f >= FIT_MIN_HZ && f <= FIT_MAX_HZ && f < 0.5f * (float)snapshot->analysis_rate &&
+                 snapshot->average_db[b] > SILENCE_DB;
+        if (use[b]) {
+            const float x = (float)(b - SPECTRUM_BAND_1K) / 3.0f;
+            sx += x;
+            sy += level[b];
+            sxx += x * x;
+            sxy += x * level[b];
+            n++;
+        }
+    }
+    const float det = n * sxx - sx * sx;
+    if (n < FIT_MIN_BANDS || det <= 0.0f) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const float slope = (n * sxy - sx * sy) / det;
+    const float offset = (sy - slope * sx) / n;
+
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        const eq_band_t *band = equalizer_get_band(eq, i);
+        if (band == NULL || !band->enabled) {
+            continue;
+        }
+
+        // Octave range the band acts on
+        const float xc = log2f(band->freq / 1000.0f);
+        float x_min = xc;
+        float x_max = xc;
+        if (band->type == EQ_FILTER_PEAKING) {
+            float half = asinhf(1.0f / (2.0f * band->q)) / logf(2.0f);
+            if (half < 1.0f / 6.0f) {
+                half = 1.0f / 6.0f;
+            }
+            x_min = xc - half;
+            x_max = xc + half;
+        } else if (band->type == EQ_FILTER_LOW_SHELF) {
+            x_min = -INFINITY;
+        } else if (band->type == EQ_FILTER_HIGH_SHELF) {
+            x_max = INFINITY;
+        } else {
+            continue;
+        }
+
+        float deviation = 0.0f;
+        int count = 0;
+        for (int b = 0; b < SPECTRUM_BANDS; b++) {
+            const float x = (float)(b - SPECTRUM_BAND_1K) / 3.0f;
+            if (use[b] && x >= x_min - 0.01f && x <= x_max + 0.01f) {
+                deviation += level[b] - (offset + slope * x);
+                count++;
+            }
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        float gain = band->gain_db - SUGGEST_STEP * deviation / count;
+        if (gain < EQ_MIN_GAIN_DB) {
+            gain = EQ_MIN_GAIN_DB;
+        }
+        if (gain > EQ_MAX_GAIN_DB) {
+            gain = EQ_MAX_GAIN_DB;
+        }
+        gains[i] = roundf(gain * 2.0f) / 2.0f + 0.0f;     // No -0.0
+    }
+    return ESP_OK;
+}
+
+#else
+
+void spectrum_set_enabled(bool enabled)
+{
+}
+
+bool spectrum_get_enabled(void)
+{
+    return false;
+}
+
+void spectrum_reset(void)
+{
+}
+
+esp_err_t spectrum_get_snapshot(spectrum_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t spectrum_suggest_eq(const spectrum_snapshot_t *snapshot, const equalizer_t *eq,
+                              float gains[EQ_MAX_BANDS])
+{
+    for (int i = 0; i < EQ_MAX_BANDS; i++) {
+        gains[i] = NAN;
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+float spectrum_band_freq(int band)
+{
+    if (band < 0 || band >= SPECTRUM_BANDS) {
+        return 0.0f;
+    }
+    return s_band_nominal[band];
+}
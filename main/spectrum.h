@@ -0,0 +1,144 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "equalizer.h"
+
+// Spectrum analyzer
+// The audio task copies every block leaving the chain, mixed to mono (and
+// decimated to 44.1/48 kHz at the higher rates), into a lock-free sample
+// ring; it never waits, and drops the block if the ring is full. A
+// low-priority task on the other core takes Hann-windowed frames with 50%
+// overlap from the ring, transforms two frames per esp-dsp complex FFT and
+// sums the bins into 1/3-octave bands, kept as a fast (display) and a slow
+// (long-term) exponential average. Readers copy the bands from a mailbox
+// (sequence lock, as in dsp_perf), so nothing on the real-time core depends
+// on the analysis.
+
+#ifdef CONFIG_SPECTRUM
+#define SPECTRUM_ENABLED        1
+#define SPECTRUM_FFT_SIZE       CONFIG_SPECTRUM_FFT_SIZE
+#else
+#define SPECTRUM_ENABLED        0
+#define SPECTRUM_FFT_SIZE       2048
+#endif
+
+// ISO 1/3-octave bands, 20 Hz ... 20 kHz (band 17 is 1 kHz)
+#define SPECTRUM_BANDS          31
+#define SPECTRUM_BAND_1K        17
+
+// Averaging time constants
+#define SPECTRUM_FAST_MS        300
+#define SPECTRUM_SLOW_MS        10000
+
+// Reported for empty bands (and before the first frame)
+#define SPECTRUM_FLOOR_DB       -120.0f
+
+// Signal needed before spectrum_suggest_eq trusts the slow average
+#define SPECTRUM_SUGGEST_MIN_S  10.0f
+
+typedef struct {
+    uint32_t frames;                        // Frames analysed since the last reset (changes with each update)
+    uint32_t analysis_rate;                 // Rate of the analysed signal in Hz (after decimation)
+    uint32_t dropped;                       // Blocks dropped because the ring was full
+    float resolution_hz;                    // FFT bin spacing
+    float analysed_s;                       // Signal time in the averages
+    float level_db[SPECTRUM_BANDS];         // Fast average per band, dBFS (full-scale sine = 0)
+    float average_db[SPECTRUM_BANDS];       // Slow average per band, dBFS
+} spectrum_snapshot_t;
+
+#if SPECTRUM_ENABLED
+
+/**
+ * Set up the analyzer and start its task (before the audio task starts)
+ *
+ * @param sample_rate Sample rate in Hz
+ * @return ESP_OK, or an error if the FFT tables or the task could not be created
+ */
+esp_err_t spectrum_init(uint32_t sample_rate);
+
+/**
+ * Copy one block leaving the chain into the analyzer ring (audio task only)
+ *
+ * @param buffer Left-justified 32-bit I2S words (interleaved stereo)
+ * @param num_samples Number of samples (total, not per channel)
+ */
+void spectrum_feed(const int32_t *buffer, int num_samples);
+
+/**
+ * Switch the analyzer to a new rate (clears the averages)
+ *
+ * Only while no block is being processed (audio_rate_set, with the I/O task parked).
+ *
+ * @param sample_rate Sample rate in Hz
+ */
+void spectrum_set_sample_rate(uint32_t sample_rate);
+
+#else
+
+static inline esp_err_t spectrum_init(uint32_t sample_rate) { (void)sample_rate; return ESP_OK; }
+static inline void spectrum_feed(const int32_t *buffer, int num_samples) { (void)buffer; (void)num_samples; }
+static inline void spectrum_set_sample_rate(uint32_t sample_rate) { (void)sample_rate; }
+
+#endif
+
+/**
+ * Start or stop the analysis (the audio task stops copying while off)
+ *
+ * @param enabled true to analyse
+ */
+void spectrum_set_enabled(bool enabled);
+
+/**
+ * Check whether the analyzer is running
+ *
+ * @return true if enabled (always false when compiled out)
+ */
+bool spectrum_get_enabled(void);
+
+/**
+ * Clear both averages (takes effect at the next frame)
+ */
+void spectrum_reset(void);
+
+/**
+ * Copy the current band levels
+ *
+ * @param snapshot Destination
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if the analyzer is compiled out,
+ *         ESP_ERR_TIMEOUT if no consistent copy could be taken
+ */
+esp_err_t spectrum_get_snapshot(spectrum_snapshot_t *snapshot);
+
+/**
+ * Get the nominal centre frequency of a band
+ *
+ * @param band Band index (0 to SPECTRUM_BANDS - 1)
+ * @return Frequency in Hz (20, 25, 31.5, ... 20000)
+ */
+float spectrum_band_freq(int band);
+
+/**
+ * Suggest equalizer gains from the long-term spectrum
+ *
+ * Fits a straight line (dB over log frequency) through the slow average as
+ * the program's overall tilt, and moves each enabled peaking or shelf band
+ * half-way towards cancelling the deviation from that line within its
+ * bandwidth. Half steps keep overlapping bands from over-correcting; run it
+ * again after the averages have settled for another pass.
+ *
+ * @param snapshot Snapshot from spectrum_get_snapshot
+ * @param eq Equalizer whose bands are adjusted
+ * @param gains Per band slot: suggested gain in dB, or NAN if the band is
+ *              disabled, has no gain or no measured band falls in its range
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if less than SPECTRUM_SUGGEST_MIN_S of
+ *         signal has been analysed or the signal is too quiet,
+ *         ESP_ERR_NOT_SUPPORTED if the analyzer is compiled out
+ */
+esp_err_t spectrum_suggest_eq(const spectrum_snapshot_t *snapshot, const equalizer_t *eq,
+                              float gains[EQ_MAX_BANDS]);
+
+#endif // SPECTRUM_H
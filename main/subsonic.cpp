@@ -3,6 +3,7 @@
 #include <math.h>
 #include <nvs.h>
 #include "esp_log.h"
+#include "dsps_biquad.h"
 
 // NVS storage keys
 #define NVS_NAMESPACE "subsonic_set"
@@ -17,7 +18,7 @@ static const char *TAG = "SUBSONIC";
  * with Q = 0.707 (Butterworth characteristic)
  * Coefficients are converted to Q24 fixed-point format
  */
-static void calculate_highpass_filter(subsonic_biquad_coeffs_t *coeffs, float freq, 
+static void calculate_highpass_filter(subsonic_params_t *p, float freq, 
                                       float sample_rate, float Q)
 {
     float w0 = 2.0f * M_PI * freq / sample_rate;  // Normalized frequency
@@ -34,12 +35,20 @@ static void calculate_highpass_filter(subsonic_biquad_coeffs_t *coeffs, float fr
     float a2_f = (1.0f - alpha) / a0;
     
     // Convert to Q24 fixed-point (multiply by 2^24)
+    subsonic_biquad_coeffs_t *coeffs = &p->coeffs;
     coeffs->b0 = (int32_t)(b0_f * 16777216.0f);
     coeffs->b1 = (int32_t)(b1_f * 16777216.0f);
     coeffs->b2 = (int32_t)(b2_f * 16777216.0f);
     coeffs->a1 = (int32_t)(a1_f * 16777216.0f);
     coeffs->a2 = (int32_t)(a2_f * 16777216.0f);
     
+    // Keep the unquantized set for the float32 chain
+    p->coeffs_f32[0] = b0_f;
+    p->coeffs_f32[1] = b1_f;
+    p->coeffs_f32[2] = b2_f;
+    p->coeffs_f32[3] = a1_f;
+    p->coeffs_f32[4] = a2_f;
+    
     ESP_LOGD(TAG, "Highpass filter calculated for %.1f Hz:", freq);
     ESP_LOGD(TAG, "  b0=%.6f, b1=%.6f, b2=%.6f", b0_f, b1_f, b2_f);
     ESP_LOGD(TAG, "  a1=%.6f, a2=%.6f", a1_f, a2_f);
@@ -48,12 +57,13 @@ static void calculate_highpass_filter(subsonic_biquad_coeffs_t *coeffs, float fr
 void subsonic_init(subsonic_t *subsonic, uint32_t sample_rate)
 {
     memset(subsonic, 0, sizeof(subsonic_t));
+    coeff_bank_reset(&subsonic->bank);
     
     // Set default cutoff frequency
     subsonic->cutoff_freq = SUBSONIC_FREQ_HZ;
     
     // Calculate filter coefficients
-    calculate_highpass_filter(&subsonic->coeffs, SUBSONIC_FREQ_HZ, 
+    calculate_highpass_filter(&subsonic->params[0], SUBSONIC_FREQ_HZ, 
                              (float)sample_rate, SUBSONIC_Q);
     
     subsonic->enabled = true;
@@ -68,81 +78,83 @@ void subsonic_init(subsonic_t *subsonic, uint32_t sample_rate)
 bool subsonic_set_frequency(subsonic_t *subsonic, float freq, uint32_t sample_rate)
 {
     // Validate frequency range (should be low, typically 20-35 Hz)
-    if (freq < 15.0f || freq > 50.0f) {
-        ESP_LOGW(TAG, "Frequency %.1f Hz out of recommended range (15-50 Hz)", freq);
+    if (freq < SUBSONIC_MIN_FREQ || freq > SUBSONIC_MAX_FREQ) {
+        ESP_LOGW(TAG, "Frequency %.1f Hz out of recommended range (%.0f-%.0f Hz)", freq,
+                 SUBSONIC_MIN_FREQ, SUBSONIC_MAX_FREQ);
         return false;
     }
     
     subsonic->cutoff_freq = freq;
     
-    // Recalculate filter coefficients
-    calculate_highpass_filter(&subsonic->coeffs, freq, (float)sample_rate, SUBSONIC_Q);
+    // Bake the new coefficients into the shadow set and publish it
+    subsonic_params_t *p = (subsonic_params_t *)coeff_bank_begin_write(
+        &subsonic->bank, subsonic->params, sizeof(subsonic_params_t));
+    calculate_highpass_filter(p, freq, (float)sample_rate, SUBSONIC_Q);
+    coeff_bank_publish(&subsonic->bank);
     
     // Reset filter state to avoid transients
     subsonic_reset(subsonic);
     
-    ESP_LOGI(TAG, "Cutoff frequency set to %.1f Hz", freq);
+    ESP_LOGD(TAG, "Cutoff frequency set to %.1f Hz", freq);
     return true;
 }
 
-void subsonic_process(subsonic_t *subsonic, int32_t *buffer, int num_samples)
+void DSP_HOT subsonic_process(subsonic_t *subsonic, int32_t *buffer, int num_samples)
 {
     if (!subsonic->enabled) {
         return;  // Bypass
     }
     
-    subsonic_biquad_coeffs_t *c = &subsonic->coeffs;
+    const subsonic_params_t *p = subsonic_begin_block(subsonic);
+    const subsonic_biquad_coeffs_t *c = &p->coeffs;
     subsonic_biquad_state_t *state_l = &subsonic->state_left;
     subsonic_biquad_state_t *state_r = &subsonic->state_right;
     
     // Process stereo interleaved samples
     for (int i = 0; i < num_samples; i += 2) {
-        // Left channel
-        int32_t input_l = buffer[i];
-        
-        // Biquad direct form II (transposed)
-        // Coefficients are Q24, shift right by 24 after multiplication
-        int64_t temp_l = ((int64_t)c->b0 * input_l) >> 24;
-        temp_l += ((int64_t)c->b1 * state_l->x1) >> 24;
-        temp_l += ((int64_t)c->b2 * state_l->x2) >> 24;
-        temp_l -= ((int64_t)c->a1 * state_l->y1) >> 24;
-        temp_l -= ((int64_t)c->a2 * state_l->y2) >> 24;
-        
-        int32_t output_l = (int32_t)temp_l;
-        
-        // Update state
-        state_l->x2 = state_l->x1;
-        state_l->x1 = input_l;
-        state_l->y2 = state_l->y1;
-        state_l->y1 = output_l;
-        
-        buffer[i] = output_l;
-        
-        // Right channel
-        int32_t input_r = buffer[i + 1];
-        
-        int64_t temp_r = ((int64_t)c->b0 * input_r) >> 24;
-        temp_r += ((int64_t)c->b1 * state_r->x1) >> 24;
-        temp_r += ((int64_t)c->b2 * state_r->x2) >> 24;
-        temp_r -= ((int64_t)c->a1 * state_r->y1) >> 24;
-        temp_r -= ((int64_t)c->a2 * state_r->y2) >> 24;
-        
-        int32_t output_r = (int32_t)temp_r;
-        
-        // Update state
-        state_r->x2 = state_r->x1;
-        state_r->x1 = input_r;
-        state_r->y2 = state_r->y1;
-        state_r->y1 = output_r;
-        
-        buffer[i + 1] = output_r;
+        buffer[i] = biquad_q24_process(c, state_l, buffer[i]);
+        buffer[i + 1] = biquad_q24_process(c, state_r, buffer[i + 1]);
+    }
+    
+    subsonic_end_block(subsonic);
+}
+
+void DSP_HOT subsonic_process_f32(subsonic_t *subsonic, float *buffer, int num_samples)
+{
+    if (!subsonic->enabled) {
+        return;  // Bypass
+    }
+    
+    const subsonic_params_t *p = subsonic_begin_block(subsonic);
+    
+    // Float state has no truncation bias; the Q24 direct form I leaves a
+    // small DC offset at this low a cutoff
+    // (esp-dsp takes a non-const coefficient pointer but only reads it)
+    dsps_biquad_sf32(buffer, buffer, num_samples / 2, (float *)p->coeffs_f32, subsonic->state_f32);
+    
+    subsonic_end_block(subsonic);
+}
+
+DSP_HOT const subsonic_params_t *subsonic_begin_block(subsonic_t *subsonic)
+{
+    if (subsonic->reset_pending) {
+        subsonic->reset_pending = false;
+        memset(&subsonic->state_left, 0, sizeof(subsonic_biquad_state_t));
+        memset(&subsonic->state_right, 0, sizeof(subsonic_biquad_state_t));
+        memset(subsonic->state_f32, 0, sizeof(subsonic->state_f32));
     }
+    return &subsonic->params[coeff_bank_acquire(&subsonic->bank)];
+}
+
+void DSP_HOT subsonic_end_block(subsonic_t *subsonic)
+{
+    coeff_bank_release(&subsonic->bank);
 }
 
 void subsonic_set_enabled(subsonic_t *subsonic, bool enable)
 {
-    subsonic->enabled = enable;
-    ESP_LOGI(TAG, "Subsonic filter %s", enable ? "enabled" : "disabled");
+    coeff_bank_set_flag(&subsonic->enabled, enable);
+    ESP_LOGD(TAG, "Subsonic filter %s", enable ? "enabled" : "disabled");
 }
 
 bool subsonic_get_enabled(subsonic_t *subsonic)
@@ -157,9 +169,53 @@ float subsonic_get_frequency(subsonic_t *subsonic)
 
 void subsonic_reset(subsonic_t *subsonic)
 {
-    memset(&subsonic->state_left, 0, sizeof(subsonic_biquad_state_t));
-    memset(&subsonic->state_right, 0, sizeof(subsonic_biquad_state_t));
-    ESP_LOGD(TAG, "Filter state reset");
+    // Filter history belongs to the audio task; it clears it at the next
+    // block (or at the swap of the group this is part of)
+    coeff_bank_set_flag(&subsonic->reset_pending, true);
+    ESP_LOGD(TAG, "Filter state reset requested");
+}
+
+void subsonic_get_settings(const subsonic_t *subsonic, subsonic_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->cutoff_freq = subsonic->cutoff_freq;
+    settings->enabled = subsonic->enabled ? 1 : 0;
+}
+
+void subsonic_apply_settings(subsonic_t *subsonic, const subsonic_settings_t *settings, uint32_t sample_rate)
+{
+    subsonic_set_frequency(subsonic, settings->cutoff_freq, sample_rate);
+    coeff_bank_set_flag(&subsonic->enabled, settings->enabled != 0);
+}
+
+void subsonic_bake_params(const subsonic_settings_t *settings, uint32_t sample_rate,
+                          subsonic_params_t *params)
+{
+    float freq = settings->cutoff_freq;
+    if (freq < SUBSONIC_MIN_FREQ) freq = SUBSONIC_MIN_FREQ;
+    if (freq > SUBSONIC_MAX_FREQ) freq = SUBSONIC_MAX_FREQ;
+    
+    memset(params, 0, sizeof(*params));
+    calculate_highpass_filter(params, freq, (float)sample_rate, SUBSONIC_Q);
+}
+
+void subsonic_apply_baked(subsonic_t *subsonic, const subsonic_settings_t *settings,
+                          const subsonic_params_t *params)
+{
+    subsonic->cutoff_freq = settings->cutoff_freq;
+    
+    // The shadow starts as a copy of the published set: a new cutoff starts
+    // from a clear history, like subsonic_set_frequency
+    subsonic_params_t *p = (subsonic_params_t *)coeff_bank_begin_write(
+        &subsonic->bank, subsonic->params, sizeof(subsonic_params_t));
+    const bool moved = memcmp(p, params, sizeof(*params)) != 0;
+    *p = *params;
+    coeff_bank_publish(&subsonic->bank);
+    
+    if (moved) {
+        coeff_bank_set_flag(&subsonic->reset_pending, true);
+    }
+    coeff_bank_set_flag(&subsonic->enabled, settings->enabled != 0);
 }
 
 esp_err_t subsonic_load_settings(subsonic_t *subsonic, uint32_t sample_rate)
@@ -195,41 +251,3 @@ esp_err_t subsonic_load_settings(subsonic_t *subsonic, uint32_t sample_rate)
     return ESP_OK;
 }
 
-esp_err_t subsonic_save_settings(subsonic_t *subsonic)
-{
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS handle: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    // Save enabled state
-    uint8_t enabled = subsonic->enabled ? 1 : 0;
-    err = nvs_set_u8(nvs_handle, NVS_KEY_ENABLED, enabled);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save enabled state: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
-    
-    // Save frequency
-    err = nvs_set_blob(nvs_handle, NVS_KEY_FREQUENCY, &subsonic->cutoff_freq, 
-                      sizeof(subsonic->cutoff_freq));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save frequency: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
-    
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Settings saved to NVS");
-    }
-    
-    nvs_close(nvs_handle);
-    return err;
-}
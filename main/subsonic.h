@@ -4,32 +4,45 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "biquad.h"
+#include "coeff_bank.h"
 
 // Subsonic filter configuration
 #define SUBSONIC_FREQ_HZ        25.0f      // Cutoff frequency (25-30 Hz range)
 #define SUBSONIC_Q              0.707f     // Q factor for Butterworth (0.707)
+#define SUBSONIC_MIN_FREQ       15.0f      // Accepted cutoff range in Hz
+#define SUBSONIC_MAX_FREQ       50.0f
 
-// Biquad filter coefficients structure (Q24 fixed-point format)
-typedef struct {
-    int32_t b0, b1, b2;  // Feedforward coefficients (Q24 fixed-point)
-    int32_t a1, a2;      // Feedback coefficients (Q24 fixed-point, a0 is normalized to 1)
-} subsonic_biquad_coeffs_t;
+// Biquad filter types (shared Q24 kernel, see biquad.h)
+typedef biquad_coeffs_t subsonic_biquad_coeffs_t;
+typedef biquad_state_t subsonic_biquad_state_t;
 
-// Biquad filter state (one per channel)
+// Parameters read by the audio path (double-buffered, see coeff_bank.h)
 typedef struct {
-    int32_t x1, x2;    // Previous input samples
-    int32_t y1, y2;    // Previous output samples
-} subsonic_biquad_state_t;
+    float coeffs_f32[5] __attribute__((aligned(16)));   // Float coefficients for the float32 chain (b0, b1, b2, a1, a2)
+    subsonic_biquad_coeffs_t coeffs;           // Filter coefficients
+} subsonic_params_t;
 
-// Subsonic filter structure
+// Subsonic filter structure (audio task fields first, see dsp_attr.h)
 typedef struct {
-    subsonic_biquad_coeffs_t coeffs;           // Filter coefficients
-    subsonic_biquad_state_t state_left;        // State for left channel
+    subsonic_params_t params[2];               // Published / shadow parameter sets
+    subsonic_biquad_state_t state_left __attribute__((aligned(16)));    // State for left channel
     subsonic_biquad_state_t state_right;       // State for right channel
+    float state_f32[4] __attribute__((aligned(16)));    // Float32 chain state (DF-II: L w0, L w1, R w0, R w1)
+    coeff_bank_t bank;                         // Publish state for params
+    volatile bool reset_pending;               // Clear filter history at next block
+    // Control side
     float cutoff_freq;                         // Cutoff frequency in Hz
     bool enabled;                               // Enable/disable subsonic filter
 } subsonic_t;
 
+// Persistent settings (packed into the settings blob, see settings_blob.h)
+typedef struct {
+    float cutoff_freq;                         // Cutoff frequency in Hz
+    uint8_t enabled;                           // Filter enabled
+    uint8_t reserved[3];
+} subsonic_settings_t;
+
 /**
  * Initialize subsonic filter with default settings
  * 
@@ -57,6 +70,36 @@ bool subsonic_set_frequency(subsonic_t *subsonic, float freq, uint32_t sample_ra
  */
 void subsonic_process(subsonic_t *subsonic, int32_t *buffer, int num_samples);
 
+/**
+ * Process a float block through the subsonic filter (float32 chain)
+ * 
+ * Uses the stereo esp-dsp biquad. Samples are on the 24-bit scale
+ * (full-scale = 8388608.0f) like the integer path.
+ * 
+ * @param subsonic Pointer to subsonic structure
+ * @param buffer Stereo interleaved float buffer
+ * @param num_samples Total number of samples (including both channels)
+ */
+void subsonic_process_f32(subsonic_t *subsonic, float *buffer, int num_samples);
+
+/**
+ * Latch the published parameters for one block (audio task only)
+ * 
+ * Also services a pending subsonic_reset. Must be paired with
+ * subsonic_end_block.
+ * 
+ * @param subsonic Pointer to subsonic structure
+ * @return Parameters to use for this block
+ */
+const subsonic_params_t *subsonic_begin_block(subsonic_t *subsonic);
+
+/**
+ * Release the parameters latched by subsonic_begin_block (audio task only)
+ * 
+ * @param subsonic Pointer to subsonic structure
+ */
+void subsonic_end_block(subsonic_t *subsonic);
+
 /**
  * Enable or disable subsonic filter
  * 
@@ -84,25 +127,63 @@ float subsonic_get_frequency(subsonic_t *subsonic);
 /**
  * Reset filter state (clears history)
  * 
+ * The reset is performed by the audio task at its next block boundary.
+ * 
  * @param subsonic Pointer to subsonic structure
  */
 void subsonic_reset(subsonic_t *subsonic);
 
 /**
- * Load subsonic settings from NVS
+ * Copy the persistent settings
+ * 
+ * @param subsonic Pointer to subsonic structure
+ * @param settings Destination
+ */
+void subsonic_get_settings(const subsonic_t *subsonic, subsonic_settings_t *settings);
+
+/**
+ * Apply persistent settings
  * 
  * @param subsonic Pointer to subsonic structure
+ * @param settings Settings from subsonic_get_settings
  * @param sample_rate Sample rate in Hz
- * @return ESP_OK on success
  */
-esp_err_t subsonic_load_settings(subsonic_t *subsonic, uint32_t sample_rate);
+void subsonic_apply_settings(subsonic_t *subsonic, const subsonic_settings_t *settings, uint32_t sample_rate);
 
 /**
- * Save subsonic settings to NVS
+ * Compute the parameters subsonic_apply_settings would publish
+ * 
+ * The cutoff is clamped to SUBSONIC_MIN_FREQ..SUBSONIC_MAX_FREQ.
+ * 
+ * @param settings Settings from subsonic_get_settings
+ * @param sample_rate Sample rate in Hz
+ * @param params Destination
+ */
+void subsonic_bake_params(const subsonic_settings_t *settings, uint32_t sample_rate,
+                          subsonic_params_t *params);
+
+/**
+ * Apply settings with parameters baked by subsonic_bake_params (no filter
+ * design; see preset_bank.h)
+ * 
+ * The enable flag goes through coeff_bank_set_flag, so inside a group it
+ * changes in the same block as the parameters.
  * 
  * @param subsonic Pointer to subsonic structure
+ * @param settings Settings the parameters were baked from
+ * @param params Baked parameters
+ */
+void subsonic_apply_baked(subsonic_t *subsonic, const subsonic_settings_t *settings,
+                          const subsonic_params_t *params);
+
+/**
+ * Load subsonic settings saved as separate NVS keys (firmware before the
+ * settings blob; used once to migrate)
+ * 
+ * @param subsonic Pointer to subsonic structure
+ * @param sample_rate Sample rate in Hz
  * @return ESP_OK on success
  */
-esp_err_t subsonic_save_settings(subsonic_t *subsonic);
+esp_err_t subsonic_load_settings(subsonic_t *subsonic, uint32_t sample_rate);
 
 #endif // SUBSONIC_H
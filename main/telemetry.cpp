@@ -0,0 +1,559 @@
+#include "telemetry.h"
+#include "mqtt_manager.h"
+#include "dsp_control.h"
+#include "subsonic.h"
+#include "pregain.h"
+#include "equalizer.h"
+#include "limiter.h"
+#include "preset_bank.h"
+#include "audio_tap.h"
+#include "dsp_perf.h"
+#include "level_meter.h"
+#include "spectrum.h"
+#include "audio_xrun.h"
+#include "audio_rate.h"
+#include "audio_pipeline.h"
+#include "audio_lowlat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static const char *TAG = "TELEMETRY";
+
+// External references to DSP processors
+extern subsonic_t subsonic;
+extern pregain_t pregain;
+extern equalizer_t equalizer;
+extern limiter_t limiter;
+
+// Core that runs the chain; the telemetry task takes the other one
+#if AUDIO_PIPELINE_ENABLED
+#define CHAIN_CORE          AUDIO_PIPELINE_DSP_CORE
+#elif AUDIO_LOWLAT_ENABLED
+#define CHAIN_CORE          AUDIO_LOWLAT_CORE
+#else
+#define CHAIN_CORE          0                       // audio_task
+#endif
+#ifdef CONFIG_FREERTOS_UNICORE
+#define TELEMETRY_CORE      0
+#else
+#define TELEMETRY_CORE      (1 - CHAIN_CORE)
+#endif
+
+static_assert(TELEMETRY_TOPIC_COUNT <= 32, "telemetry topics must fit a 32-bit mask");
+
+// DSP_CONTROL flags to the state topics they change
+static const struct {
+    uint32_t changed;
+    uint32_t topics;
+} s_changed_topics[] = {
+    { DSP_CONTROL_RATE,      TELEMETRY_BIT(TELEMETRY_STATUS) | TELEMETRY_BIT(TELEMETRY_TAP) |
+                             TELEMETRY_BIT(TELEMETRY_TAP_SDP) },
+    { DSP_CONTROL_SUBSONIC,  TELEMETRY_BIT(TELEMETRY_SUBSONIC) },
+    { DSP_CONTROL_PREGAIN,   TELEMETRY_BIT(TELEMETRY_PREGAIN) },
+    { DSP_CONTROL_EQUALIZER, TELEMETRY_BIT(TELEMETRY_EQ) },
+    { DSP_CONTROL_LIMITER,   TELEMETRY_BIT(TELEMETRY_LIMITER) },
+    { DSP_CONTROL_CONVOLVER, TELEMETRY_BIT(TELEMETRY_CONV) },
+    { DSP_CONTROL_CROSSOVER, TELEMETRY_BIT(TELEMETRY_XOVER) },
+    { DSP_CONTROL_MULTIBAND, TELEMETRY_BIT(TELEMETRY_MB) },
+    { DSP_CONTROL_DELAY,     TELEMETRY_BIT(TELEMETRY_DELAY) },
+    { DSP_CONTROL_PRESET,    TELEMETRY_BIT(TELEMETRY_PRESET) },
+    { DSP_CONTROL_TAP,       TELEMETRY_BIT(TELEMETRY_TAP) | TELEMETRY_BIT(TELEMETRY_TAP_SDP) },
+};
+
+static TaskHandle_t s_task = NULL;
+static uint32_t s_pending = 0;              // Topics requested (TELEMETRY_BIT mask), set by any task
+static bool s_restart = false;              // Connected to the broker since the last wake-up
+static telemetry_stats_t s_stats;
+static uint32_t s_bytes = 0;                // Payload bytes not yet counted in s_stats.kbytes
+
+// Telemetry task only
+static char s_buffer[TELEMETRY_BUFFER_SIZE];
+static uint32_t s_hash[TELEMETRY_TOPIC_COUNT];  // Last retained payload published (0 = none)
+
+/*
+ * Snapshot fields: quantized to integers of value * 10^decimals and sent
+ * again once they moved by min_delta of those units. The index is the CBOR
+ * key, so fields are only ever appended.
+ */
+typedef enum {
+    F_RATE = 0, F_LOAD, F_LOAD_MAX, F_OVERRUNS,
+    F_PEAK_L, F_PEAK_R, F_RMS_L, F_RMS_R, F_CLIPS_L, F_CLIPS_R, F_LUFS_M, F_LUFS_S,
+    F_XRUNS, F_LATE_US,
+    F_SUB_EN, F_SUB_FREQ, F_GAIN_EN, F_GAIN_DB, F_EQ_EN, F_LIM_EN, F_LIM_THR,
+    F_PRESET, F_TAP, F_TAP_DROPS, F_HEAP_KB,
+    FIELD_COUNT
+} field_t;
+
+static const struct {
+    const char *name;
+    uint8_t decimals;
+    bool flag;                              // true/false rather than a number
+    uint16_t min_delta;
+} s_fields[FIELD_COUNT] = {
+    { "rate",       0, false, 1 },
+    { "load",       1, false, 5 },          // % of the block period
+    { "load_max",   1, false, 5 },
+    { "overruns",   0, false, 1 },
+    { "peak_l",     1, false, 5 },          // dBFS
+    { "peak_r",     1, false, 5 },
+    { "rms_l",      1, false, 5 },
+    { "rms_r",      1, false, 5 },
+    { "clips_l",    0, false, 1 },
+    { "clips_r",    0, false, 1 },
+    { "lufs_m",     1, false, 5 },
+    { "lufs_s",     1, false, 5 },
+    { "xruns",      0, false, 1 },
+    { "late_us",    0, false, 1 },
+    { "sub_en",     0, true,  1 },
+    { "sub_freq",   1, false, 1 },
+    { "gain_en",    0, true,  1 },
+    { "gain_db",    1, false, 1 },
+    { "eq_en",      0, true,  1 },
+    { "lim_en",     0, true,  1 },
+    { "lim_thr",    1, false, 1 },
+    { "preset",     0, false, 1 },          // Active slot, -1 = none
+    { "tap",        0, true,  1 },          // Streaming
+    { "tap_drops",  0, false, 1 },          // Blocks and packets dropped
+    { "heap_kb",    0, false, 4 },          // Free internal RAM
+};
+
+static_assert(FIELD_COUNT <= 32, "snapshot fields must fit a 32-bit mask");
+
+static const int32_t s_scale[] = { 1, 10, 100 };
+
+// Snapshot state (telemetry task only)
+static int32_t s_sent[FIELD_COUNT];         // Values last published
+static uint32_t s_sent_mask = 0;            // Fields present in the last published snapshot
+static uint32_t s_seq = 0;
+static TickType_t s_last_keyframe = 0;
+static bool s_keyframe_due = true;
+
+/**
+ * FNV-1a hash of a payload (never 0, which marks "none")
+ */
+static uint32_t payload_hash(const char *data, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static void count_published(int len)
+{
+    s_stats.published++;
+    s_bytes += (uint32_t)len;
+    s_stats.kbytes += s_bytes >> 10;
+    s_bytes &= 1023;
+}
+
+/**
+ * Publish up to TELEMETRY_BURST of the requested topics, in topic order, and
+ * hold the rest over to the next wake-up
+ */
+static void publish_states(uint32_t topics)
+{
+    int sent = 0;
+    uint32_t retry = 0;
+    while (topics != 0) {
+        if (sent == TELEMETRY_BURST) {
+            s_stats.deferred += (uint32_t)__builtin_popcount(topics);
+            retry |= topics;
+            break;
+        }
+        const int t = __builtin_ctz(topics);
+        topics &= topics - 1;
+
+        const char *name;
+        bool retain;
+        const int len = mqtt_manager_render_state((telemetry_topic_t)t, s_buffer, sizeof(s_buffer),
+                                                  &name, &retain);
+        if (len <= 0) {
+            continue;
+        }
+
+        uint32_t hash = 0;
+        if (retain) {
+            hash = payload_hash(s_buffer, len);
+            if (hash == s_hash[t]) {
+                s_stats.unchanged++;
+                continue;
+            }
+        }
+        if (mqtt_manager_publish_data(name, s_buffer, len, 0, retain) != ESP_OK) {
+            s_stats.failed++;
+            retry |= TELEMETRY_BIT(t);
+            continue;
+        }
+        s_hash[t] = hash;
+        count_published(len);
+        sent++;
+    }
+    if (retry != 0) {
+        __atomic_fetch_or(&s_pending, retry, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void put_value(int32_t *q, uint32_t *present, field_t f, float value)
+{
+    const float scaled = value * (float)s_scale[s_fields[f].decimals];
+    q[f] = (int32_t)lrintf(fminf(fmaxf(scaled, -2147483520.0f), 2147483520.0f));
+    *present |= 1u << f;
+}
+
+static void put_count(int32_t *q, uint32_t *present, field_t f, int64_t value)
+{
+    q[f] = (int32_t)(value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : value));
+    *present |= 1u << f;
+}
+
+/**
+ * Read the current value of every snapshot field; fields of modules not
+ * built in (or without data yet) are left out
+ *
+ * @return Mask of the fields read
+ */
+static uint32_t read_fields(int32_t *q)
+{
+    uint32_t present = 0;
+    put_count(q, &present, F_RATE, audio_rate_get());
+
+    dsp_perf_snapshot_t perf;
+    if (dsp_perf_get_snapshot(&perf) == ESP_OK) {
+        const uint32_t chain_max = perf.stages[DSP_PERF_CHAIN].max;
+        put_value(q, &present, F_LOAD, dsp_perf_avg_load(&perf, DSP_PERF_CHAIN));
+        put_value(q, &present, F_LOAD_MAX, perf.deadline_cycles ? 100.0f * chain_max / perf.deadline_cycles : 0.0f);
+        put_count(q, &present, F_OVERRUNS, perf.overruns);
+    }
+
+    level_meter_snapshot_t meter;
+    if (level_meter_get_snapshot(&meter) == ESP_OK) {
+        put_value(q, &present, F_PEAK_L, meter.peak_db[0]);
+        put_value(q, &present, F_PEAK_R, meter.peak_db[1]);
+        put_value(q, &present, F_RMS_L, meter.rms_db[0]);
+        put_value(q, &present, F_RMS_R, meter.rms_db[1]);
+        put_count(q, &present, F_CLIPS_L, meter.clips[0]);
+        put_count(q, &present, F_CLIPS_R, meter.clips[1]);
+        if (meter.loudness) {
+            put_value(q, &present, F_LUFS_M, meter.momentary_lufs);
+            put_value(q, &present, F_LUFS_S, meter.short_term_lufs);
+        }
+    }
+
+    audio_xrun_snapshot_t xrun;
+    if (audio_xrun_get_snapshot(&xrun) == ESP_OK) {
+        put_count(q, &present, F_XRUNS, xrun.total);
+        put_count(q, &present, F_LATE_US, xrun.max_late_us);
+    }
+
+    put_count(q, &present, F_SUB_EN, subsonic_get_enabled(&subsonic));
+    put_value(q, &present, F_SUB_FREQ, subsonic_get_frequency(&subsonic));
+    put_count(q, &present, F_GAIN_EN, pregain_is_enabled(&pregain));
+    put_value(q, &present, F_GAIN_DB, pregain_get_gain(&pregain));
+    put_count(q, &present, F_EQ_EN, equalizer.enabled);
+    put_count(q, &present, F_LIM_EN, limiter.enabled);
+    put_value(q, &present, F_LIM_THR, limiter_get_threshold(&limiter));
+
+    if (PRESET_BANK_ENABLED) {
+        preset_bank_stats_t preset;
+        preset_bank_get_stats(&preset);
+        put_count(q, &present, F_PRESET, preset.active);
+    }
+    if (AUDIO_TAP_ENABLED) {
+        audio_tap_stats_t tap;
+        audio_tap_get_stats(&tap);
+        put_count(q, &present, F_TAP, tap.streaming);
+        put_count(q, &present, F_TAP_DROPS, (int64_t)tap.dropped_blocks + tap.dropped_packets);
+    }
+
+    put_count(q, &present, F_HEAP_KB, heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024);
+    return present;
+}
+
+/**
+ * Write a fixed-point value ("-12.5" for -125 with one decimal)
+ */
+static int format_fixed(char *buf, size_t size, int32_t q, int decimals)
+{
+    if (decimals == 0) {
+        return snprintf(buf, size, "%ld", (long)q);
+    }
+    const uint32_t mag = (q < 0) ? 0u - (uint32_t)q : (uint32_t)q;
+    const uint32_t scale = (uint32_t)s_scale[decimals];
+    return snprintf(buf, size, "%s%lu.%0*lu", q < 0 ? "-" : "", (unsigned long)(mag / scale),
+                    decimals, (unsigned long)(mag % scale));
+}
+
+static int render_json(const int32_t *q, uint32_t send, uint32_t gone, bool full, uint32_t seq, uint64_t t_ms)
+{
+    char *buf = s_buffer;
+    const size_t size = sizeof(s_buffer);
+    int len = snprintf(buf, size, "{\"seq\":%lu,\"t_ms\":%llu,\"full\":%s",
+                       (unsigned long)seq, (unsigned long long)t_ms, full ? "true" : "false");
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        const uint32_t bit = 1u << f;
+        if (!((send | gone) & bit)) {
+            continue;
+        }
+        len += snprintf(buf + len, size - len, ",\"%s\":", s_fields[f].name);
+        if (gone & bit) {
+            len += snprintf(buf + len, size - len, "null");
+        } else if (s_fields[f].flag) {
+            len += snprintf(buf + len, size - len, "%s", q[f] ? "true" : "false");
+        } else {
+            len += format_fixed(buf + len, size - len, q[f], s_fields[f].decimals);
+        }
+    }
+    len += snprintf(buf + len, size - len, "}");
+    return len;
+}
+
+/**
+ * Write a CBOR item head (major type and argument, shortest form)
+ */
+static int cbor_head(uint8_t *p, uint8_t major, uint64_t value)
+{
+    major <<= 5;
+    if (value < 24) {
+        p[0] = major | (uint8_t)value;
+        return 1;
+    }
+    int bytes;
+    if (value <= 0xff) {
+        p[0] = major | 24;
+        bytes = 1;
+    } else if (value <= 0xffff) {
+        p[0] = major | 25;
+        bytes = 2;
+    } else if (value <= 0xffffffffu) {
+        p[0] = major | 26;
+        bytes = 4;
+    } else {
+        p[0] = major | 27;
+        bytes = 8;
+    }
+    for (int i = 0; i < bytes; i++) {
+        p[1 + i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+    }
+    return 1 + bytes;
+}
+
+static int cbor_int(uint8_t *p, int64_t value)
+{
+    return (value >= 0) ? cbor_head(p, 0, (uint64_t)value) : cbor_head(p, 1, (uint64_t)(-1 - value));
+}
+
+// [seq, t_ms, full, {index: value | null}] with values as the quantized integers
+static int render_cbor(const int32_t *q, uint32_t send, uint32_t gone, bool full, uint32_t seq, uint64_t t_ms)
+{
+    // Header of at most 18 bytes, then at most 6 per field (1-byte key, int32 value)
+    static_assert(18 + FIELD_COUNT * 6 <= TELEMETRY_BUFFER_SIZE, "snapshot does not fit the telemetry buffer");
+    uint8_t *p = (uint8_t *)s_buffer;
+    int len = cbor_head(p, 4, 4);
+    len += cbor_head(p + len, 0, seq);
+    len += cbor_head(p + len, 0, t_ms);
+    p[len++] = full ? 0xf5 : 0xf4;
+    len += cbor_head(p + len, 5, (uint64_t)__builtin_popcount(send | gone));
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        const uint32_t bit = 1u << f;
+        if (!((send | gone) & bit)) {
+            continue;
+        }
+        len += cbor_head(p + len, 0, (uint64_t)f);
+        if (gone & bit) {
+            p[len++] = 0xf6;
+        } else if (s_fields[f].flag) {
+            p[len++] = q[f] ? 0xf5 : 0xf4;
+        } else {
+            len += cbor_int(p + len, q[f]);
+        }
+    }
+    return len;
+}
+
+/**
+ * Publish the fields that changed since the last snapshot (all of them in a
+ * keyframe); nothing if none did
+ */
+static void publish_snapshot(TickType_t now)
+{
+    int32_t q[FIELD_COUNT];
+    const uint32_t present = read_fields(q);
+
+    const bool full = s_keyframe_due ||
+                      now - s_last_keyframe >= pdMS_TO_TICKS(TELEMETRY_KEYFRAME_S * 1000);
+    uint32_t send = 0;
+    uint32_t gone = 0;
+    if (full) {
+        send = present;
+    } else {
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            const uint32_t bit = 1u << f;
+            if ((present & bit) &&
+                (!(s_sent_mask & bit) || llabs((int64_t)q[f] - s_sent[f]) >= s_fields[f].min_delta)) {
+                send |= bit;
+            }
+        }
+        gone = s_sent_mask & ~present;
+        if (send == 0 && gone == 0) {
+            return;
+        }
+    }
+
+    const uint64_t t_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    const int len = TELEMETRY_CBOR ? render_cbor(q, send, gone, full, s_seq, t_ms)
+                                   : render_json(q, send, gone, full, s_seq, t_ms);
+    const char *topic = TELEMETRY_CBOR ? MQTT_TOPIC_TELEMETRY_CBOR : MQTT_TOPIC_TELEMETRY;
+    if (mqtt_manager_publish_data(topic, s_buffer, len, 0, false) != ESP_OK) {
+        // The changes stay pending for the next snapshot
+        s_stats.failed++;
+        return;
+    }
+
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        if (send & (1u << f)) {
+            s_sent[f] = q[f];
+        }
+    }
+    s_sent_mask = present;
+    s_seq++;
+    if (full) {
+        s_keyframe_due = false;
+        s_last_keyframe = now;
+        s_stats.keyframes++;
+    }
+    s_stats.snapshots++;
+    s_stats.last_snapshot_bytes = (uint32_t)len;
+    count_published(len);
+}
+
+static bool interval_due(TickType_t now, TickType_t *last, uint32_t interval_ms)
+{
+    if (now - *last < pdMS_TO_TICKS(interval_ms)) {
+        return false;
+    }
+    *last = now;
+    return true;
+}
+
+static void telemetry_task(void *pvParameters)
+{
+    TickType_t last_meter = 0;
+    TickType_t last_spectrum = 0;
+    TickType_t last_xrun = 0;
+    TickType_t last_perf = 0;
+    TickType_t last_snapshot = 0;
+    uint32_t meter_windows = 0;
+    uint32_t spectrum_frames = 0;
+    uint32_t xrun_total = 0;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_INTERVAL_MS));
+        if (!mqtt_manager_is_connected()) {
+            continue;
+        }
+        const TickType_t now = xTaskGetTickCount();
+
+        uint32_t topics = 0;
+        if (__atomic_exchange_n(&s_restart, false, __ATOMIC_SEQ_CST)) {
+            // The broker may have lost the retained topics: send them all again
+            memset(s_hash, 0, sizeof(s_hash));
+            topics |= TELEMETRY_ALL_STATES;
+            s_keyframe_due = true;
+        }
+
+        // Periodic topics, only with new data
+        if (LEVEL_METER_ENABLED && interval_due(now, &last_meter, MQTT_METER_INTERVAL_MS)) {
+            level_meter_snapshot_t meter;
+            if (level_meter_get_snapshot(&meter) == ESP_OK && meter.windows != meter_windows) {
+                meter_windows = meter.windows;
+                topics |= TELEMETRY_BIT(TELEMETRY_METER);
+            }
+        }
+        if (SPECTRUM_ENABLED && interval_due(now, &last_spectrum, MQTT_SPECTRUM_INTERVAL_MS)) {
+            spectrum_snapshot_t snap;
+            if (spectrum_get_enabled() && spectrum_get_snapshot(&snap) == ESP_OK &&
+                snap.frames != spectrum_frames) {
+                spectrum_frames = snap.frames;
+                topics |= TELEMETRY_BIT(TELEMETRY_SPECTRUM);
+            }
+        }
+        if (AUDIO_XRUN_ENABLED && interval_due(now, &last_xrun, MQTT_XRUN_INTERVAL_MS)) {
+            audio_xrun_snapshot_t snap;
+            if (audio_xrun_get_snapshot(&snap) == ESP_OK && snap.total != xrun_total) {
+                xrun_total = snap.total;
+                topics |= TELEMETRY_BIT(TELEMETRY_XRUN);
+            }
+        }
+        if (DSP_PERF_ENABLED && interval_due(now, &last_perf, MQTT_PERF_INTERVAL_S * 1000)) {
+            topics |= TELEMETRY_BIT(TELEMETRY_PERF);
+        }
+
+        topics |= __atomic_exchange_n(&s_pending, 0, __ATOMIC_SEQ_CST);
+        publish_states(topics);
+
+        if (TELEMETRY_SNAPSHOT_ENABLED && interval_due(now, &last_snapshot, TELEMETRY_SNAPSHOT_MS)) {
+            publish_snapshot(now);
+        }
+    }
+}
+
+esp_err_t telemetry_init(void)
+{
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(telemetry_task, "telemetry", 6144, NULL,
+                                                 tskIDLE_PRIORITY + 1, &s_task, TELEMETRY_CORE);
+    if (created != pdPASS) {
+        s_task = NULL;
+        ESP_LOGE(TAG, "Failed to create telemetry task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Telemetry on core %d: every %d ms, up to %d topics at a time%s", TELEMETRY_CORE,
+             TELEMETRY_INTERVAL_MS, TELEMETRY_BURST,
+             !TELEMETRY_SNAPSHOT_ENABLED ? "" : (TELEMETRY_CBOR ? ", CBOR snapshot" : ", JSON snapshot"));
+    return ESP_OK;
+}
+
+void telemetry_request(uint32_t topics)
+{
+    const uint32_t before = __atomic_fetch_or(&s_pending, topics, __ATOMIC_SEQ_CST);
+    const uint32_t merged = before & topics;
+    if (merged != 0) {
+        __atomic_fetch_add(&s_stats.coalesced, (uint32_t)__builtin_popcount(merged), __ATOMIC_RELAXED);
+    }
+}
+
+void telemetry_request_changed(uint32_t changed)
+{
+    uint32_t topics = 0;
+    for (size_t i = 0; i < sizeof(s_changed_topics) / sizeof(s_changed_topics[0]); i++) {
+        if (changed & s_changed_topics[i].changed) {
+            topics |= s_changed_topics[i].topics;
+        }
+    }
+    if (topics != 0) {
+        telemetry_request(topics);
+    }
+}
+
+void telemetry_connected(void)
+{
+    __atomic_store_n(&s_restart, true, __ATOMIC_SEQ_CST);
+}
+
+void telemetry_get_stats(telemetry_stats_t *stats)
+{
+    *stats = s_stats;
+}
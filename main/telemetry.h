@@ -0,0 +1,123 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Telemetry publisher
+// One low-priority task, on the core the chain does not run on, does all
+// MQTT publishing. Command handlers only mark the state topics they changed
+// (telemetry_request); the task wakes every TELEMETRY_INTERVAL_MS, renders
+// the marked topics one after the other into a single static buffer and
+// publishes at most TELEMETRY_BURST of them per wake-up, so a burst of
+// slider moves costs one publish per topic and interval instead of one per
+// message. A retained payload identical to the one last published is not
+// sent again. The same task polls the meter, spectrum, xrun and profiler
+// topics at their own intervals.
+//
+// With TELEMETRY_SNAPSHOT it also publishes a compact summary of the
+// system (load, levels, dropouts and the main settings) every
+// TELEMETRY_SNAPSHOT_MS, holding only the fields that changed by more than
+// their resolution since the last one, with a full keyframe every
+// TELEMETRY_KEYFRAME_S, as JSON or CBOR (RFC 8949).
+
+#define TELEMETRY_INTERVAL_MS   CONFIG_TELEMETRY_INTERVAL_MS
+#define TELEMETRY_BURST         CONFIG_TELEMETRY_BURST
+
+#ifdef CONFIG_TELEMETRY_SNAPSHOT
+#define TELEMETRY_SNAPSHOT_ENABLED  1
+#define TELEMETRY_SNAPSHOT_MS       CONFIG_TELEMETRY_SNAPSHOT_MS
+#define TELEMETRY_KEYFRAME_S        CONFIG_TELEMETRY_KEYFRAME_S
+#else
+#define TELEMETRY_SNAPSHOT_ENABLED  0
+#define TELEMETRY_SNAPSHOT_MS       1000
+#define TELEMETRY_KEYFRAME_S        30
+#endif
+
+#ifdef CONFIG_TELEMETRY_FORMAT_CBOR
+#define TELEMETRY_CBOR              1
+#else
+#define TELEMETRY_CBOR              0
+#endif
+
+// Render buffer, shared by every topic (the largest state, the profiler
+// with all stages timed, needs 2.5 to 3 KB)
+#define TELEMETRY_BUFFER_SIZE   3072
+
+// Published state topics
+typedef enum {
+    TELEMETRY_STATUS = 0,
+    TELEMETRY_SUBSONIC,
+    TELEMETRY_PREGAIN,
+    TELEMETRY_EQ,
+    TELEMETRY_LIMITER,
+    TELEMETRY_CONV,
+    TELEMETRY_XOVER,
+    TELEMETRY_MB,
+    TELEMETRY_DELAY,
+    TELEMETRY_PRESET,
+    TELEMETRY_TAP,
+    TELEMETRY_TAP_SDP,
+    TELEMETRY_PERF,
+    TELEMETRY_METER,
+    TELEMETRY_SPECTRUM,
+    TELEMETRY_XRUN,
+    TELEMETRY_TOPIC_COUNT
+} telemetry_topic_t;
+
+#define TELEMETRY_BIT(topic)    (1u << (topic))
+
+// Everything published on connect and by 'mqtt publish' (the meter and
+// spectrum are only sent when they have new data)
+#define TELEMETRY_ALL_STATES    (((1u << TELEMETRY_TOPIC_COUNT) - 1) & \
+                                 ~(TELEMETRY_BIT(TELEMETRY_METER) | TELEMETRY_BIT(TELEMETRY_SPECTRUM)))
+
+typedef struct {
+    uint32_t published;             // Messages handed to the MQTT client
+    uint32_t kbytes;                // Payload published, in KiB
+    uint32_t coalesced;             // Requests merged into one already pending
+    uint32_t unchanged;             // Retained payloads not sent again (identical)
+    uint32_t deferred;              // Topics held over to the next interval (burst limit)
+    uint32_t failed;                // Publishes the client did not take (retried)
+    uint32_t snapshots;             // Snapshots published
+    uint32_t keyframes;             // ... of which full
+    uint32_t last_snapshot_bytes;   // Size of the most recent snapshot
+} telemetry_stats_t;
+
+/**
+ * Start the telemetry task (once; later calls do nothing)
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the task could not be created
+ */
+esp_err_t telemetry_init(void);
+
+/**
+ * Mark state topics for publishing (any task; returns at once)
+ *
+ * @param topics TELEMETRY_BIT() mask
+ */
+void telemetry_request(uint32_t topics);
+
+/**
+ * Mark the state topics of everything a command changed
+ *
+ * @param changed DSP_CONTROL_* flags (see dsp_control.h)
+ */
+void telemetry_request_changed(uint32_t changed);
+
+/**
+ * Start over after connecting to the broker: publish every state (even if
+ * unchanged) and a snapshot keyframe
+ */
+void telemetry_connected(void);
+
+/**
+ * Get the publisher counters
+ *
+ * @param stats Destination
+ */
+void telemetry_get_stats(telemetry_stats_t *stats);
+
+#endif // TELEMETRY_H
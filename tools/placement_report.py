@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+"""Hot-path memory placement report for ESP-DSP.
+
+Reads the linker map of an ESP-IDF build (build/esp-dsp.map) and reports
+where the audio hot path ended up (see main/dsp_attr.h and main/linker.lf):
+
+- every function marked DSP_HOT, DSP_HOT_INLINE or IRAM_ATTR in main/, and
+  every object mapped to noflash in main/linker.lf, that still has code in
+  flash
+- IRAM and DRAM bytes per object of the project and of esp-dsp
+- address and 16-byte alignment of the module globals in esp-dsp.cpp
+
+    python tools/placement_report.py build/esp-dsp.map
+    python tools/placement_report.py --strict build/esp-dsp.map
+
+With --strict the exit status is 1 if any hot-path code is in flash, e.g.
+for a CI check of a CONFIG_AUDIO_HOT_PATH_IRAM build. Functions that are
+static and in IRAM have no name in the map; they are only reported when
+found in flash.
+"""
+
+import argparse
+import os
+import re
+import sys
+from collections import defaultdict
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+MAIN_DIR = os.path.join(ROOT, 'main')
+
+PROJECT_ARCHIVE = 'libmain.a'
+DSP_ARCHIVE = 'libespressif__esp-dsp.a'
+GLOBALS_OBJECT = 'esp-dsp'
+
+# Output sections by memory, as named in the ESP32-S3 linker scripts
+MEMORY_PREFIXES = (
+    ('.iram0', 'IRAM'),
+    ('.flash.text', 'flash'),
+    ('.flash', 'flash rodata'),
+    ('.dram0', 'DRAM'),
+    ('.ext_ram', 'PSRAM'),
+    ('.rtc', 'RTC'),
+)
+
+HOT_DEF_RE = re.compile(r'\b(?:DSP_HOT|DSP_HOT_INLINE|IRAM_ATTR)\b[^(;=]*?\b(\w+)\s*\(')
+MAPPING_RE = re.compile(r'^\s*\[mapping:')
+ARCHIVE_RE = re.compile(r'^\s*archive:\s*(\S+)')
+NOFLASH_RE = re.compile(r'^\s*(\S+)\s*\(noflash\)')
+OUTPUT_RE = re.compile(r'^(\.[\w.]+)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+))?\s*$')
+INPUT_RE = re.compile(r'^ (\.?[^\s*(]+)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S+))?\s*$')
+INPUT_CONT_RE = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S+)\s*$')
+SYMBOL_RE = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+([A-Za-z_.$][\w.$]*)\s*$')
+MEMBER_RE = re.compile(r'([^/\\(]+)\(([^)]+)\)$')
+
+
+def memory_of(output_section):
+    for prefix, memory in MEMORY_PREFIXES:
+        if output_section.startswith(prefix):
+            return memory
+    return None
+
+
+def source_name(symbol):
+    """Function name of a (possibly mangled) symbol: _Z[L]<len><name>..."""
+    m = re.match(r'_ZL?(\d+)', symbol)
+    if m:
+        start = m.end()
+        return symbol[start:start + int(m.group(1))]
+    return symbol
+
+
+def object_stem(obj):
+    """dsp_chain.cpp.obj -> dsp_chain (the name linker fragments use)"""
+    return obj.split('.', 1)[0]
+
+
+class Piece:
+    """One input section of the map"""
+
+    def __init__(self, output, name, address, size, archive, obj):
+        self.output = output
+        self.memory = memory_of(output)
+        self.name = name
+        self.address = address
+        self.size = size
+        self.archive = archive
+        self.obj = obj
+        self.symbols = []
+
+
+def parse_map(path):
+    pieces = []
+    output = None
+    pending = None      # Input section whose name was on its own line
+    current = None
+    in_memory_map = False
+
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if not in_memory_map:
+                in_memory_map = line.startswith('Linker script and memory map')
+                continue
+
+            m = OUTPUT_RE.match(line)
+            if m:
+                output = m.group(1)
+                pending = current = None
+                continue
+            if output is None:
+                continue
+
+            if pending is not None:
+                m = INPUT_CONT_RE.match(line)
+                pending_name, pending = pending, None
+                if m:
+                    current = add_piece(pieces, output, pending_name, m.group(1), m.group(2), m.group(3))
+                    continue
+
+            m = INPUT_RE.match(line)
+            if m and m.group(1).startswith('.'):
+                if m.group(2):
+                    current = add_piece(pieces, output, m.group(1), m.group(2), m.group(3), m.group(4))
+                else:
+                    pending = m.group(1)
+                    current = None
+                continue
+
+            m = SYMBOL_RE.match(line)
+            if m and current is not None:
+                current.symbols.append((int(m.group(1), 16), m.group(2)))
+    return pieces
+
+
+def add_piece(pieces, output, name, address, size, member):
+    m = MEMBER_RE.search(member)
+    if not m:
+        return None     # Linker-generated or not from an archive
+    piece = Piece(output, name, int(address, 16), int(size, 16), m.group(1), m.group(2))
+    if piece.size == 0:
+        return None
+    pieces.append(piece)
+    return piece
+
+
+def hot_functions():
+    """(object stem, name) of the functions marked for IRAM in main/
+
+    Static functions of different files may share a name, so functions are
+    matched per object; header inlines ('*') in any object.
+    """
+    names = set()
+    for entry in sorted(os.listdir(MAIN_DIR)):
+        if not entry.endswith(('.cpp', '.h')) or entry == 'dsp_attr.h':
+            continue
+        owner = object_stem(entry) if entry.endswith('.cpp') else '*'
+        with open(os.path.join(MAIN_DIR, entry)) as f:
+            for line in f:
+                if line.startswith((' ', '\t', '#', '//')):
+                    continue
+                m = HOT_DEF_RE.search(line)
+                if m:
+                    names.add((owner, m.group(1)))
+    return names
+
+
+def noflash_objects():
+    """(archive, object stem or '*') pairs mapped to noflash in linker.lf"""
+    result = set()
+    archive = None
+    with open(os.path.join(MAIN_DIR, 'linker.lf')) as f:
+        for line in f:
+            if MAPPING_RE.match(line):
+                archive = None
+            m = ARCHIVE_RE.match(line)
+            if m:
+                archive = m.group(1)
+                continue
+            m = NOFLASH_RE.match(line)
+            if m and archive:
+                result.add((archive, m.group(1)))
+    return result
+
+
+def piece_functions(piece, hot):
+    """Names of the hot functions in a code input section"""
+    names = set()
+    for prefix in ('.text.', '.literal.'):
+        if piece.name.startswith(prefix):
+            names.add(source_name(piece.name[len(prefix):]))
+    for _, symbol in piece.symbols:
+        names.add(source_name(symbol))
+    owner = object_stem(piece.obj)
+    return {n for n in names if (owner, n) in hot or ('*', n) in hot}
+
+
+def report(pieces, strict):
+    ours = [p for p in pieces if p.archive in (PROJECT_ARCHIVE, DSP_ARCHIVE)]
+    if not ours:
+        print('No sections from %s or %s in the map' % (PROJECT_ARCHIVE, DSP_ARCHIVE))
+        return 2
+
+    hot = hot_functions()
+    mapped = noflash_objects()
+
+    # Hot-path code still in flash
+    misplaced = []
+    found_iram = set()
+    for p in ours:
+        if p.memory not in ('IRAM', 'flash'):
+            continue
+        in_object = ((p.archive, object_stem(p.obj)) in mapped or (p.archive, '*') in mapped)
+        names = piece_functions(p, hot)
+        if p.memory == 'IRAM':
+            found_iram |= names
+        elif in_object or names:
+            label = ', '.join(sorted(names)) or p.name
+            misplaced.append((p.obj, label, p.size))
+
+    print('Hot path: %d marked functions, %d noflash objects in linker.lf, %d named in IRAM'
+          % (len(hot), len(mapped), len(found_iram)))
+    if misplaced:
+        print('\nHot-path code in flash:')
+        for obj, label, size in sorted(misplaced):
+            print('  %-28s %6d  %s' % (obj, size, label))
+    else:
+        print('No hot-path code in flash')
+
+    # Bytes per object and memory
+    sizes = defaultdict(lambda: defaultdict(int))
+    for p in ours:
+        if p.memory:
+            key = p.obj if p.archive == PROJECT_ARCHIVE else 'esp-dsp: ' + p.obj
+            sizes[key][p.memory] += p.size
+    columns = ('IRAM', 'flash', 'DRAM', 'PSRAM')
+    print('\n  %-40s' % 'Object' + ''.join('%10s' % c for c in columns))
+    totals = defaultdict(int)
+    for key in sorted(sizes, key=lambda k: (-sizes[k]['IRAM'], k)):
+        if not any(sizes[key][c] for c in columns):
+            continue
+        print('  %-40s' % key + ''.join('%10d' % sizes[key][c] for c in columns))
+        for c in columns:
+            totals[c] += sizes[key][c]
+    print('  %-40s' % 'Total' + ''.join('%10d' % totals[c] for c in columns))
+
+    # Module globals
+    print('\nGlobals of %s.cpp:' % GLOBALS_OBJECT)
+    globals_found = False
+    for p in ours:
+        if p.archive != PROJECT_ARCHIVE or object_stem(p.obj) != GLOBALS_OBJECT:
+            continue
+        if p.memory not in ('DRAM', 'PSRAM') or p.name.startswith(('.rodata', '.dram0.rodata')):
+            continue
+        # Static variables have no symbol line, only their section name
+        symbols = p.symbols or [(p.address, p.name.split('.', 2)[-1])]
+        for address, symbol in symbols:
+            size = p.size if len(symbols) == 1 else 0
+            note = '' if address % 16 == 0 else '  (not 16-byte aligned)'
+            print('  %-24s 0x%08x %-6s %8s%s'
+                  % (source_name(symbol), address, p.memory, size or '', note))
+            globals_found = True
+    if not globals_found:
+        print('  (none listed: build with -fdata-sections, the ESP-IDF default)')
+
+    return 1 if strict and misplaced else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report the memory placement of the ESP-DSP audio hot path')
+    parser.add_argument('map', help='linker map, e.g. build/esp-dsp.map')
+    parser.add_argument('--strict', action='store_true',
+                        help='exit with status 1 if hot-path code is in flash')
+    args = parser.parse_args()
+
+    try:
+        pieces = parse_map(args.map)
+    except OSError as e:
+        print('Cannot read %s: %s' % (args.map, e), file=sys.stderr)
+        return 2
+    return report(pieces, args.strict)
+
+
+if __name__ == '__main__':
+    sys.exit(main())